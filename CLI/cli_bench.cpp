@@ -3,8 +3,39 @@
 #include <cstring> // memcmp
 
 #include <aes.hpp>
+#include <base64.hpp>
 #include <Benchmark.hpp>
+#include <Bigint.hpp>
+#include <deflate.hpp>
+#include <HttpRequest.hpp>
+#include <HttpRequestParser.hpp>
+#include <irBytecodeVm.hpp>
+#include <irVm.hpp>
+#include <json.hpp>
+#include <MemoryRefReader.hpp>
+#include <JsonObject.hpp>
+#include <JsonTape.hpp>
+#include <laPlutoFrontend.hpp>
+#include <laX64Backend.hpp>
+#include <MontgomeryContext.hpp>
+#include <RangeMap.hpp>
 #include <rand.hpp>
+#include <Regex.hpp>
+#include <wasm.hpp>
+
+static constexpr const char* lang_bench_sum = R"(
+function sum(n)
+	local i
+	local s
+	i = 0
+	s = 0
+	while i ~= n do
+		s = s + i
+		i = i + 1
+	end
+	return s
+end
+)";
 
 void cli_bench()
 {
@@ -83,4 +114,312 @@ void cli_bench()
 			SOUP_ASSERT(memcmp(data, og_data, sizeof(data)) == 0);
 		});
 	});
+	BENCHMARK("AES-GCM-128 (16 KiB records, GcmContext)", {
+		uint8_t data[0x4'000];
+		soup::rand.fill(data);
+		const uint8_t key[16] = { 'S', 'u', 'p', 'e', 'r', ' ', 'S', 'e', 'c', 'r', 'e', 't', ' ', 'K', 'e', 'y' };
+		uint8_t iv[12]{};
+		uint8_t aad[13]{};
+		uint8_t tag[16];
+		soup::aes::GcmContext ctx(key, sizeof(key));
+		_benchmark_state.bytes_per_it = sizeof(data);
+		BENCHMARK_LOOP({
+			++iv[11];
+			ctx.start(iv, sizeof(iv));
+			ctx.aad(aad, sizeof(aad));
+			ctx.encrypt(data, sizeof(data));
+			ctx.finish(tag);
+		});
+	});
+	BENCHMARK("AES-GCM-256 (16 KiB records, gcmEncrypt)", {
+		uint8_t data[0x4'000];
+		soup::rand.fill(data);
+		const char key[] = "My Super Secret Key For 256-Bit";
+		uint8_t iv[12]{};
+		uint8_t aad[13]{};
+		uint8_t tag[16];
+		_benchmark_state.bytes_per_it = sizeof(data);
+		BENCHMARK_LOOP({
+			++iv[11];
+			soup::aes::gcmEncrypt(data, sizeof(data), aad, sizeof(aad), reinterpret_cast<const uint8_t*>(key), 32, iv, sizeof(iv), tag);
+		});
+	});
+	// The modPow that RsaKeyMontgomeryData used before MontgomeryContext, for comparison.
+	BENCHMARK("modPow (2048-bit, modPowMontgomery)", {
+		soup::Bigint m = soup::Bigint::random(2048);
+		m.enableBit(0);
+		m.enableBit(2047);
+		const soup::Bigint x = soup::Bigint::random(2000);
+		const soup::Bigint e = soup::Bigint::random(2048);
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(x.modPowMontgomery(e, m) < m);
+		});
+	});
+	BENCHMARK("modPow (2048-bit, MontgomeryContext)", {
+		soup::Bigint m = soup::Bigint::random(2048);
+		m.enableBit(0);
+		m.enableBit(2047);
+		const soup::Bigint x = soup::Bigint::random(2000);
+		const soup::Bigint e = soup::Bigint::random(2048);
+		const soup::MontgomeryContext ctx(m);
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(ctx.modPow(x, e) < m);
+		});
+	});
+	BENCHMARK("multiply (2^20 bits)", {
+		const soup::Bigint a = soup::Bigint::random(1 << 20);
+		const soup::Bigint b = soup::Bigint::random(1 << 20);
+		BENCHMARK_LOOP({
+			SOUP_ASSERT((a * b).getBitLength() > (1 << 20));
+		});
+	});
+	BENCHMARK("deflate compress (level 6, 64 KiB)", {
+		std::string data;
+		for (int i = 0; data.size() < 0x10000; ++i)
+		{
+			data.append(std::to_string(i * i)).push_back(i % 7 == 0 ? '\n' : ' ');
+		}
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(!soup::deflate::compress(data, 6).empty());
+		});
+	});
+	BENCHMARK("deflate decompress (64 KiB)", {
+		std::string data;
+		for (int i = 0; data.size() < 0x10000; ++i)
+		{
+			data.append(std::to_string(i * i)).push_back(i % 7 == 0 ? '\n' : ' ');
+		}
+		const auto compressed = soup::deflate::compress(data, 6);
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(soup::deflate::decompress(compressed.data(), compressed.size(), data.size(), soup::deflate::RAW).decompressed.size() == data.size());
+		});
+	});
+	// The request parsing ServerWebService did before HttpRequestParser, for comparison.
+	BENCHMARK("HTTP request (MimeMessage)", {
+		const std::string data = "GET /index.html HTTP/1.1\r\nHost: example.com\r\nUser-Agent: Mozilla/5.0\r\nAccept: text/html\r\nAccept-Encoding: gzip, deflate\r\nConnection: keep-alive\r\n\r\n";
+		BENCHMARK_LOOP({
+			soup::HttpRequest req{};
+			auto method_end = data.find(' ');
+			req.method = data.substr(0, method_end);
+			method_end += 1;
+			auto path_end = data.find(' ', method_end);
+			req.path = data.substr(method_end, path_end - method_end);
+			path_end += 1;
+			auto message_start = data.find("\r\n", path_end) + 2;
+			req.loadMessage(data.substr(message_start));
+			SOUP_ASSERT(req.path == "/index.html");
+		});
+	});
+	BENCHMARK("HTTP request (HttpRequestParser)", {
+		const std::string data = "GET /index.html HTTP/1.1\r\nHost: example.com\r\nUser-Agent: Mozilla/5.0\r\nAccept: text/html\r\nAccept-Encoding: gzip, deflate\r\nConnection: keep-alive\r\n\r\n";
+		soup::HttpRequestParser parser;
+		BENCHMARK_LOOP({
+			parser.feed(data.data(), data.size());
+			SOUP_ASSERT(parser.parse() == soup::HttpRequestParser::COMPLETE);
+			SOUP_ASSERT(parser.getPath() == "/index.html");
+			parser.consume();
+		});
+	});
+
+	BENCHMARK("JSON decode (1 MiB, json::decode)", {
+		std::string data = "[";
+		while (data.size() < 0x100000)
+		{
+			data.append(R"({"id":12345,"name":"user","score":0.5,"tags":["a","b","c"],"active":true},)");
+		}
+		data.back() = ']';
+		_benchmark_state.bytes_per_it = data.size();
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(soup::json::decode(data));
+		});
+	});
+	BENCHMARK("JSON decode (1 MiB, JsonTape)", {
+		std::string data = "[";
+		while (data.size() < 0x100000)
+		{
+			data.append(R"({"id":12345,"name":"user","score":0.5,"tags":["a","b","c"],"active":true},)");
+		}
+		data.back() = ']';
+		soup::JsonTape tape;
+		_benchmark_state.bytes_per_it = data.size();
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(tape.parse(data));
+		});
+	});
+	BENCHMARK("JsonObject lookup (10000 members)", {
+		soup::JsonObject obj;
+		for (int i = 0; i != 10000; ++i)
+		{
+			obj.add(std::to_string(i), i);
+		}
+		int i = 0;
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(obj.contains(std::to_string(i++ % 10000)));
+		});
+	});
+
+	BENCHMARK("RangeMap lookup (2.8M ranges, binary search)", {
+		soup::RangeMap<uint32_t, uint32_t> map;
+		map.reserve(2'800'000);
+		for (uint32_t i = 0; i != 2'800'000; ++i)
+		{
+			map.emplace(i * 1500, i * 1500 + 1000, i);
+		}
+		uint32_t keys[1024];
+		for (auto& k : keys)
+		{
+			k = soup::rand.t<uint32_t>(0, 2'800'000 * 1500);
+		}
+		BENCHMARK_LOOP({
+			size_t found = 0;
+			for (const auto& k : keys)
+			{
+				found += (map.find(k) != nullptr);
+			}
+			SOUP_ASSERT(found != 0);
+		});
+	});
+	BENCHMARK("RangeMap lookup (2.8M ranges, frozen)", {
+		soup::RangeMap<uint32_t, uint32_t> map;
+		map.reserve(2'800'000);
+		for (uint32_t i = 0; i != 2'800'000; ++i)
+		{
+			map.emplace(i * 1500, i * 1500 + 1000, i);
+		}
+		map.freeze();
+		uint32_t keys[1024];
+		for (auto& k : keys)
+		{
+			k = soup::rand.t<uint32_t>(0, 2'800'000 * 1500);
+		}
+		BENCHMARK_LOOP({
+			size_t found = 0;
+			for (const auto& k : keys)
+			{
+				found += (map.find(k) != nullptr);
+			}
+			SOUP_ASSERT(found != 0);
+		});
+	});
+	BENCHMARK("RangeMap lookup (2.8M ranges, frozen, findMany)", {
+		soup::RangeMap<uint32_t, uint32_t> map;
+		map.reserve(2'800'000);
+		for (uint32_t i = 0; i != 2'800'000; ++i)
+		{
+			map.emplace(i * 1500, i * 1500 + 1000, i);
+		}
+		map.freeze();
+		uint32_t keys[1024];
+		for (auto& k : keys)
+		{
+			k = soup::rand.t<uint32_t>(0, 2'800'000 * 1500);
+		}
+		uint32_t* results[1024];
+		BENCHMARK_LOOP({
+			map.findMany(keys, results, 1024);
+			SOUP_ASSERT(results[0] == map.find(keys[0]));
+		});
+	});
+
+	BENCHMARK("WASM loop (interpreter)", {
+		soup::WasmScript scr;
+		SOUP_ASSERT(scr.load(soup::base64::decode("AGFzbQEAAAABBgFgAX8BfwMCAQAHBwEDc3VtAAAKIwEhAQF/AkADQCAARQ0BIAEgAGohASAAQQFrIQAMAAsLIAEL")));
+		auto code = scr.getExportedFuntion("sum");
+		BENCHMARK_LOOP({
+			soup::WasmVm vm(scr);
+			vm.locals.emplace_back(1000);
+			soup::MemoryRefReader r(*code);
+			SOUP_ASSERT(vm.run(r));
+			SOUP_ASSERT(vm.stack.top().i32 == 500500);
+		});
+	});
+	BENCHMARK("WASM loop (pre-decoded)", {
+		soup::WasmScript scr;
+		SOUP_ASSERT(scr.load(soup::base64::decode("AGFzbQEAAAABBgFgAX8BfwMCAQAHBwEDc3VtAAAKIwEhAQF/AkADQCAARQ0BIAEgAGohASAAQQFrIQAMAAsLIAEL")));
+		auto code = scr.getExportedFuntion("sum");
+		BENCHMARK_LOOP({
+			soup::WasmVm vm(scr);
+			vm.locals.emplace_back(1000);
+			SOUP_ASSERT(vm.run(*code));
+			SOUP_ASSERT(vm.stack.top().i32 == 500500);
+		});
+	});
+	BENCHMARK("WASM loop (JIT)", {
+		soup::WasmScript scr;
+		SOUP_ASSERT(scr.load(soup::base64::decode("AGFzbQEAAAABBgFgAX8BfwMCAQAHBwEDc3VtAAAKIwEhAQF/AkADQCAARQ0BIAEgAGohASAAQQFrIQAMAAsLIAEL")));
+		SOUP_ASSERT(scr.enableJit());
+		auto code = scr.getExportedFuntion("sum");
+		BENCHMARK_LOOP({
+			soup::WasmVm vm(scr);
+			vm.locals.emplace_back(1000);
+			SOUP_ASSERT(vm.run(*code));
+			SOUP_ASSERT(vm.stack.top().i32 == 500500);
+		});
+	});
+	BENCHMARK("WASM memory (pre-decoded)", {
+		soup::WasmScript scr;
+		SOUP_ASSERT(scr.load(soup::base64::decode("AGFzbQEAAAABBgFgAX8BfwMCAQAFAwEAAQcIAQRmaWxsAAAKLwEtAQJ/AkADQCABIABPDQEgASABNgIAIAIgASgCAGohAiABQQRqIQEMAAsLIAIL")));
+		auto code = scr.getExportedFuntion("fill");
+		BENCHMARK_LOOP({
+			soup::WasmVm vm(scr);
+			vm.locals.emplace_back(0x10000);
+			SOUP_ASSERT(vm.run(*code));
+			SOUP_ASSERT(vm.stack.top().i32 == 536838144);
+		});
+	});
+	BENCHMARK("WASM memory (JIT)", {
+		soup::WasmScript scr;
+		SOUP_ASSERT(scr.load(soup::base64::decode("AGFzbQEAAAABBgFgAX8BfwMCAQAFAwEAAQcIAQRmaWxsAAAKLwEtAQJ/AkADQCABIABPDQEgASABNgIAIAIgASgCAGohAiABQQRqIQEMAAsLIAIL")));
+		SOUP_ASSERT(scr.enableJit());
+		auto code = scr.getExportedFuntion("fill");
+		BENCHMARK_LOOP({
+			soup::WasmVm vm(scr);
+			vm.locals.emplace_back(0x10000);
+			SOUP_ASSERT(vm.run(*code));
+			SOUP_ASSERT(vm.stack.top().i32 == 536838144);
+		});
+	});
+
+	BENCHMARK("IR loop (irVm)", {
+		auto m = soup::laPlutoFrontend().parse(lang_bench_sum);
+		BENCHMARK_LOOP({
+			auto memory = m.getContiguousMemory();
+			soup::irVm vm(memory);
+			vm.locals.emplace_back(int64_t(1000));
+			SOUP_ASSERT(vm.execute(m, m.func_exports.at(0)).at(0).value.i64 == 499500);
+		});
+	});
+
+	BENCHMARK("IR loop (irBytecodeVm)", {
+		auto m = soup::laPlutoFrontend().parse(lang_bench_sum);
+		const auto bc = soup::irBytecode::compile(m);
+		auto memory = m.getContiguousMemory();
+		soup::irBytecodeVm vm(memory);
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(vm.execute(bc, 0, { soup::irVm::Variable(int64_t(1000)) }).at(0).value.i64 == 499500);
+		});
+	});
+
+#if SOUP_X86 && SOUP_BITS == 64
+	BENCHMARK("IR loop (laX64Backend)", {
+		auto m = soup::laPlutoFrontend().parse(lang_bench_sum);
+		auto exe = soup::laX64Backend().load(m);
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(exe.call<int64_t>(0, int64_t(1000)) == 499500);
+		});
+	});
+#endif
+
+	BENCHMARK("Regex search (1 MiB log)", {
+		std::string log{};
+		while (log.size() < 0x100000)
+		{
+			log.append("2024-01-01 12:00:00 INFO request handled in 3 ms\n");
+		}
+		log.append("2024-01-01 12:00:01 ERROR disk full\n");
+		soup::Regex r(R"([A-Z]+ (\w+) full)");
+		BENCHMARK_LOOP({
+			SOUP_ASSERT(r.search(log).isSuccess());
+		});
+	});
 }
@@ -15,6 +15,7 @@
 #include <base58.hpp>
 #include <base64.hpp>
 #include <cat.hpp>
+#include <deflate.hpp>
 #include <punycode.hpp>
 #include <ripemd160.hpp>
 #include <sha1.hpp>
@@ -23,12 +24,16 @@
 #include <sha512.hpp>
 #include <unicode.hpp>
 
+#include <InflateStream.hpp>
 #include <json.hpp>
 #include <JsonArray.hpp>
 #include <JsonBool.hpp>
 #include <JsonInt.hpp>
 #include <JsonObject.hpp>
+#include <JsonReader.hpp>
 #include <JsonString.hpp>
+#include <JsonTape.hpp>
+#include <JsonWriter.hpp>
 #include <MessageStream.hpp>
 #include <Regex.hpp>
 #include <xml.hpp>
@@ -40,11 +45,19 @@
 // io
 #include <BitReader.hpp>
 #include <BitWriter.hpp>
+#include <filesystem.hpp>
 #include <StringReader.hpp>
 #include <StringWriter.hpp>
+#include <MappedFileReader.hpp>
 #include <MemoryRefReader.hpp>
+#include <PreadFileReader.hpp>
 
 // lang
+#include <irBytecodeVm.hpp>
+#include <irVm.hpp>
+#include <laMathFrontend.hpp>
+#include <laPlutoFrontend.hpp>
+#include <laX64Backend.hpp>
 #include <MathExpr.hpp>
 #include <PhpState.hpp>
 #include <wasm.hpp>
@@ -59,19 +72,43 @@
 // math
 #include <Bigint.hpp>
 #include <math.hpp>
+#include <MontgomeryContext.hpp>
 
 // net.email
 #include <EmailAddress.hpp>
 
 // net.web
+#include <hpack.hpp>
+#include <HttpConnectionTask.hpp>
+#include <HttpRequest.hpp>
+#include <HttpRequestParser.hpp>
+#include <HttpRequestTask.hpp>
+#include <HttpResponseParser.hpp>
+#include <ServerWebService.hpp>
 #include <Uri.hpp>
 
 // net
+#include <ConnectionPool.hpp>
+#include <dnsCacheResolver.hpp>
+#include <netIntel.hpp>
+#include <netIntelSnapshot.hpp>
+#include <ServerCluster.hpp>
+#include <ServerService.hpp>
 #include <Socket.hpp>
+#include <TlsCipherSuite.hpp>
+#include <TlsSessionCache.hpp>
+
+// task
+#include <Scheduler.hpp>
+#include <Task.hpp>
+#include <Thread.hpp>
 
 #include <StringMatch.hpp>
 #include <format.hpp>
 
+#include <IpAddr.hpp>
+#include <os.hpp>
+#include <RangeMap.hpp>
 #include <string.hpp>
 #include <time.hpp>
 #include <version_compare.hpp>
@@ -212,6 +249,125 @@ static void unit_crypto()
 				assert(string::bin2hex((const char*)res, 16) == "B85388BE5704F782153B4FDCC1F16FF7");
 			}
 		});
+		test("gcm", []
+		{
+			// Test Case 4 from "The Galois/Counter Mode of Operation (GCM)"
+			const std::string key = string::hex2bin("feffe9928665731c6d6a8f9467308308");
+			const std::string iv = string::hex2bin("cafebabefacedbaddecaf888");
+			const std::string aad = string::hex2bin("feedfacedeadbeeffeedfacedeadbeefabaddad2");
+			const std::string plaintext = string::hex2bin("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39");
+			std::string data = plaintext;
+			uint8_t tag[16];
+			aes::gcmEncrypt(reinterpret_cast<uint8_t*>(data.data()), data.size(), reinterpret_cast<const uint8_t*>(aad.data()), aad.size(), reinterpret_cast<const uint8_t*>(key.data()), key.size(), reinterpret_cast<const uint8_t*>(iv.data()), iv.size(), tag);
+			assert(string::bin2hex(data) == "42831EC2217774244B7221B784D0D49CE3AA212F2C02A4E035C17E2329ACA12E21D514B25466931C7D8F6A5AAC84AA051BA30B396A0AAC973D58E091");
+			assert(string::bin2hex((const char*)tag, 16) == "5BC94FBC3221A5DB94FAE95AE7121A47");
+
+			// The same message fed in uneven pieces.
+			aes::GcmContext ctx(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+			ctx.start(reinterpret_cast<const uint8_t*>(iv.data()), iv.size());
+			ctx.aad(reinterpret_cast<const uint8_t*>(aad.data()), 7);
+			ctx.aad(reinterpret_cast<const uint8_t*>(aad.data()) + 7, aad.size() - 7);
+			ctx.decrypt(reinterpret_cast<uint8_t*>(data.data()), 5);
+			ctx.decrypt(reinterpret_cast<uint8_t*>(data.data()) + 5, 33);
+			ctx.decrypt(reinterpret_cast<uint8_t*>(data.data()) + 38, data.size() - 38);
+			assert(ctx.verify(tag));
+			assert(data == plaintext);
+
+			tag[0] ^= 1;
+			assert(!aes::gcmDecrypt(reinterpret_cast<uint8_t*>(data.data()), data.size(), reinterpret_cast<const uint8_t*>(aad.data()), aad.size(), reinterpret_cast<const uint8_t*>(key.data()), key.size(), reinterpret_cast<const uint8_t*>(iv.data()), iv.size(), tag));
+
+			const auto encrypt = [](std::string& data, const std::string& key, const std::string& iv, const std::string& aad)
+			{
+				uint8_t tag[16];
+				aes::gcmEncrypt(reinterpret_cast<uint8_t*>(data.data()), data.size(), reinterpret_cast<const uint8_t*>(aad.data()), aad.size(), reinterpret_cast<const uint8_t*>(key.data()), key.size(), reinterpret_cast<const uint8_t*>(iv.data()), iv.size(), tag);
+				return string::bin2hex((const char*)tag, 16);
+			};
+
+			// Test Cases 13-18 from "The Galois/Counter Mode of Operation (GCM)"
+			{
+				const std::string key256 = string::hex2bin("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308");
+				const std::string plaintext64 = string::hex2bin("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255");
+				const std::string plaintext60 = plaintext64.substr(0, 60);
+
+				data.clear();
+				assert(encrypt(data, std::string(32, '\0'), std::string(12, '\0'), {}) == "530F8AFBC74536B9A963B4F1C4CB738B");
+
+				data = std::string(16, '\0');
+				assert(encrypt(data, std::string(32, '\0'), std::string(12, '\0'), {}) == "D0D1C8A799996BF0265B98B5D48AB919");
+				assert(string::bin2hex(data) == "CEA7403D4D606B6E074EC5D3BAF39D18");
+
+				data = plaintext64;
+				assert(encrypt(data, key256, iv, {}) == "B094DAC5D93471BDEC1A502270E3CC6C");
+				assert(string::bin2hex(data) == "522DC1F099567D07F47F37A32A84427D643A8CDCBFE5C0C97598A2BD2555D1AA8CB08E48590DBB3DA7B08B1056828838C5F61E6393BA7A0ABCC9F662898015AD");
+
+				data = plaintext60;
+				assert(encrypt(data, key256, iv, aad) == "76FC6ECE0F4E1768CDDF8853BB2D551B");
+				assert(string::bin2hex(data) == "522DC1F099567D07F47F37A32A84427D643A8CDCBFE5C0C97598A2BD2555D1AA8CB08E48590DBB3DA7B08B1056828838C5F61E6393BA7A0ABCC9F662");
+
+				data = plaintext60;
+				assert(encrypt(data, key256, string::hex2bin("cafebabefacedbad"), aad) == "3A337DBF46A792C45E454913FE2EA8F2");
+				assert(string::bin2hex(data) == "C3762DF1CA787D32AE47C13BF19844CBAF1AE14D0B976AFAC52FF7D79BBA9DE0FEB582D33934A4F0954CC2363BC73F7862AC430E64ABE499F47C9B1F");
+
+				data = plaintext60;
+				assert(encrypt(data, key256, string::hex2bin("9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b"), aad) == "A44A8266EE1C8EB0C8B5D4CF5AE9F19A");
+				assert(string::bin2hex(data) == "5A8DEF2F0C9E53F1F75D7853659E2A20EEB2B22AAFDE6419A058AB4F6F746BF40FC0C3B780F244452DA3EBF1C5D82CDEA2418997200EF82E44AE7E3F");
+			}
+
+			// Messages long enough to go through the 8-block CTR and GHASH paths, with a partial tail. Expected values are from OpenSSL.
+			{
+				const std::string key256 = string::hex2bin("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308");
+				std::string long_plaintext(4133, '\0');
+				for (size_t i = 0; i != long_plaintext.size(); ++i)
+				{
+					long_plaintext[i] = static_cast<char>(i * 31 + 7);
+				}
+				std::string long_aad(200, '\0');
+				for (size_t i = 0; i != long_aad.size(); ++i)
+				{
+					long_aad[i] = static_cast<char>(i * 13 + 1);
+				}
+
+				struct LongTestCase
+				{
+					size_t key_len;
+					const char* short_sha256;
+					const char* short_tag;
+					const char* long_sha256;
+					const char* long_tag;
+				};
+				const LongTestCase long_test_cases[] = {
+					{ 16, "2B956C0C8B4DFC460F5D5DC9671E78D0EE946A2BF08AF7740C686EEEE08CE44C", "F3E9481FFDF8BE28480C174EFEAF5A61", "C911F61644A7F705156765CC68C75BCD61167C55DDEAD514448A36538DDEA9A4", "04B24CE584D76DC2821F7E4A4BA51092" },
+					{ 24, "B310BFCC7B7EE6681C043174A082812B6AA4100D8B7FCBEB72FB18DEF6FE1FAA", "2BAB9C5A6E6CDC2376F88D7F566C77A0", "0CEDBF39774487FC0B79C5046A3E3C860FF332DD5A761B6921E94F9C6B311F8B", "4F55E2F557A792774D76323B10F64AED" },
+					{ 32, "8A0A173CC4ACBD714F2F8B5C0D810430C5B8B7CD0DEFE62855E88AD442004BE5", "66C62A4FA9A87A2EF46F9C402738EC21", "2111E7828EC8D6914AB6547139B2ABE0BEDF37DA0634A599ECEF9C05451B5131", "182577E5B4E7FC684A9860132B1922B7" },
+				};
+				for (const auto& tc : long_test_cases)
+				{
+					const std::string key = key256.substr(0, tc.key_len);
+
+					// Exactly 8 blocks.
+					data = long_plaintext.substr(0, 128);
+					assert(encrypt(data, key, iv, {}) == tc.short_tag);
+					assert(string::bin2hex(sha256::hash(data)) == tc.short_sha256);
+
+					data = long_plaintext;
+					const std::string long_tag = encrypt(data, key, iv, long_aad);
+					assert(long_tag == tc.long_tag);
+					assert(string::bin2hex(sha256::hash(data)) == tc.long_sha256);
+
+					// Decrypt in pieces that straddle the 8-block boundaries.
+					const std::string long_tag_bin = string::hex2bin(long_tag);
+					aes::GcmContext ctx(reinterpret_cast<const uint8_t*>(key.data()), key.size());
+					ctx.start(reinterpret_cast<const uint8_t*>(iv.data()), iv.size());
+					ctx.aad(reinterpret_cast<const uint8_t*>(long_aad.data()), 7);
+					ctx.aad(reinterpret_cast<const uint8_t*>(long_aad.data()) + 7, long_aad.size() - 7);
+					ctx.decrypt(reinterpret_cast<uint8_t*>(data.data()), 5);
+					ctx.decrypt(reinterpret_cast<uint8_t*>(data.data()) + 5, 300);
+					ctx.decrypt(reinterpret_cast<uint8_t*>(data.data()) + 305, data.size() - 305);
+					assert(ctx.verify(reinterpret_cast<const uint8_t*>(long_tag_bin.data())));
+					assert(data == long_plaintext);
+				}
+			}
+		});
 	}
 
 	test("SegWitAddress", []
@@ -517,6 +673,50 @@ static void unit_data()
 		assert(tree->children.at(0)->value == "Look at this backslash: \\\r\nLook at this quote: \"");
 	});
 
+	test("deflate", []
+	{
+		auto res = deflate::decompress(std::string("\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\x03\xf3\x48\xcd\xc9\xc9\xd7\x51\x08\xcf\x2f\xca\x49\x51\x04\x00\xd0\xc3\x4a\xec\x0d\x00\x00\x00", 33));
+		assert(res.decompressed == "Hello, World!");
+		assert(res.compressed_size == 33);
+		assert(res.checksum_present);
+		assert(!res.checksum_mismatch);
+
+		std::string data;
+		for (int i = 0; i != 2000; ++i)
+		{
+			data.append(std::to_string(i * i)).push_back(i % 7 == 0 ? '\n' : ' ');
+		}
+		for (int level : { 0, 1, 6, 9 })
+		{
+			for (auto format : { deflate::RAW, deflate::ZLIB, deflate::GZIP })
+			{
+				const auto compressed = deflate::compress(data, level, format);
+				assert(level == 0 || compressed.size() < data.size() / 2);
+				res = deflate::decompress(compressed.data(), compressed.size(), data.size(), format);
+				assert(res.decompressed == data);
+				assert(res.compressed_size == compressed.size());
+				assert(!res.checksum_mismatch);
+
+				// Feed it 1 byte at a time, and read it in odd-sized pieces.
+				InflateStream inflater(format);
+				std::string out;
+				char buf[777];
+				for (char c : compressed)
+				{
+					inflater.feed(&c, 1);
+					while (const auto n = inflater.read(buf, sizeof(buf)))
+					{
+						out.append(buf, n);
+					}
+				}
+				assert(inflater.getStatus() == InflateStream::DONE);
+				assert(out == data);
+			}
+		}
+
+		assert(deflate::decompress(std::string("\x07garbage")).decompressed.empty());
+	});
+
 	test("ripemd160", []
 	{
 		assert(string::bin2hexLower(soup::ripemd160("The quick brown fox jumps over the lazy dog")) == "37f332f68db77bd9d7edd4969571ad671cf9dd3b");
@@ -658,6 +858,139 @@ spanning over multiple lines */
 			assert(tree->asObj().contains("hello"));
 			assert(tree->asObj().at("hello").asStr() == "world");
 		}
+
+		// Large objects use a hash index for lookups
+		{
+			JsonObject obj;
+			for (int i = 0; i != 100; ++i)
+			{
+				obj.add(std::to_string(i), i);
+			}
+			assert(obj.at("42").asInt() == 42);
+			obj.add("42", 1337); // Duplicate keys resolve to the first member, as before.
+			obj.add("100", 100);
+			assert(obj.at("42").asInt() == 42);
+			assert(obj.at("100").asInt() == 100);
+			obj.erase("42");
+			assert(obj.at("42").asInt() == 1337);
+			obj.children.emplace_back(soup::make_unique<JsonString>("direct"), soup::make_unique<JsonInt>(1));
+			obj.children.at(0).first->asStr().value = "renamed";
+			obj.invalidateIndex();
+			assert(obj.contains("direct"));
+			assert(!obj.contains("0"));
+			assert(obj.contains("renamed"));
+			assert(!obj.contains("nope"));
+			assert(obj.children.size() == 102);
+			assert(obj.children.at(1).first->asStr() == "1"); // Insertion order is unaffected.
+
+			// A stale index can't make lookups return the wrong member or go out of bounds, and invalidateIndex catches it up.
+			obj.children.erase(obj.children.begin());
+			assert(obj.at("1").asInt() == 1);
+			obj.children.pop_back();
+			assert(!obj.contains("direct"));
+			obj.children.emplace_back(soup::make_unique<JsonString>("replacement"), soup::make_unique<JsonInt>(2));
+			obj.invalidateIndex();
+			assert(obj.contains("replacement"));
+			assert(!obj.contains("renamed"));
+		}
+	});
+
+	test("json tape", []
+	{
+		const std::string data = R"({"name": "Soup", "tags": ["a", "b\n"], "version": {"major": 1, "minor": -2}, "ratio": 1.5e-1, "ok": true, "k\u0065y": null})";
+		JsonTape tape;
+		assert(tape.parse(data));
+		auto root = tape.root();
+		assert(root.isObj());
+		assert(root.size() == 6);
+		assert(root.at("name").getRawString() == "Soup");
+		assert(!root.at("name").hasEscapes());
+		assert(root.at("tags").size() == 2);
+		assert(root.at("tags").at(1).getRawString() == "b\\n");
+		assert(root.at("tags").at(1).getString() == "b\n");
+		assert(root.at("version").at("major").getInt() == 1);
+		assert(root.at("version").at("minor").getInt() == -2);
+		assert(root.at("ratio").getFloat() == 0.15);
+		assert(root.at("ok").getBool() == true);
+		assert(root.at("key").isNull());
+		assert(!root.contains("missing"));
+		assert(*root.toNode() == *json::decode(data));
+
+		assert(tape.parse(std::string("-9223372036854775808")) && tape.root().getInt() == INT64_MIN);
+		assert(tape.parse(std::string("9223372036854775808")) && tape.root().isFloat());
+		assert(tape.parse(std::string(" [ ] ")) && tape.root().size() == 0);
+
+		for (const char* invalid : { "", "[1,]", "{\"a\":1,}", "[1 2]", "{1:2}", "truex", "01", "1.", "\"abc", "\"a\tb\"", "[]]", "1 2", "{\"a\" 1}" })
+		{
+			assert(!tape.parse(std::string(invalid)));
+		}
+		assert(!tape.parse(std::string(JsonTape::max_depth + 1, '[') + std::string(JsonTape::max_depth + 1, ']')));
+	});
+
+	test("json streaming", []
+	{
+		StringWriter sw;
+		{
+			JsonWriter jw(sw, 16);
+			jw.beginArray();
+			for (int i = 0; i != 100; ++i)
+			{
+				jw.beginObject();
+				jw.key("id");
+				jw.integer(i);
+				jw.key("name");
+				jw.string("\"quoted\"\n");
+				jw.key("tags");
+				jw.beginArray();
+				jw.boolean(i % 2 == 0);
+				jw.null();
+				jw.number(0.5);
+				jw.endArray();
+				jw.endObject();
+			}
+			jw.endArray();
+		}
+		assert(sw.data.substr(0, 60) == R"([{"id":0,"name":"\"quoted\"\n","tags":[true,null,0.5]},{"id")");
+
+		// A tiny chunk size makes every token straddle buffer boundaries.
+		StringReader sr(std::string(sw.data));
+		JsonReader jr(sr, 3);
+		assert(jr.next() == JsonReader::ARRAY_BEGIN);
+		int64_t expected_id = 0;
+		UniquePtr<JsonNode> elm;
+		while (jr.nextElement(elm))
+		{
+			assert(elm->asObj().at("id").asInt() == expected_id);
+			assert(elm->asObj().at("name").asStr() == "\"quoted\"\n");
+			assert(elm->asObj().at("tags").asArr().at(0).asBool() == (expected_id % 2 == 0));
+			++expected_id;
+		}
+		assert(expected_id == 100);
+		assert(!jr.isMalformed());
+		assert(jr.next() == JsonReader::END_OF_DOCUMENT);
+
+		sr = R"({"skip": {"a": [1, 2, {"b": "c"}]}, "keep": -12})";
+		JsonReader jr2(sr, 5);
+		assert(jr2.next() == JsonReader::OBJECT_BEGIN);
+		assert(jr2.next() == JsonReader::KEY && jr2.str == "skip");
+		assert(jr2.next() == JsonReader::OBJECT_BEGIN);
+		assert(jr2.skip());
+		assert(jr2.next() == JsonReader::KEY && jr2.str == "keep");
+		assert(jr2.next() == JsonReader::INT && jr2.i == -12);
+		assert(jr2.next() == JsonReader::OBJECT_END);
+		assert(jr2.next() == JsonReader::END_OF_DOCUMENT);
+
+		for (const char* invalid : { "[1,]", "{\"a\" 1}", "[1 2]", "\"abc", "[", "{}}", "0x10" })
+		{
+			sr = invalid;
+			JsonReader jr3(sr);
+			JsonReader::Event e;
+			do
+			{
+				e = jr3.next();
+			} while (e != JsonReader::END_OF_DOCUMENT && e != JsonReader::MALFORMED);
+			assert(e == JsonReader::MALFORMED);
+		}
 	});
 
 	test("xml", []
@@ -920,6 +1253,47 @@ spanning over multiple lines */
 		assert(Regex("(.+a|b.+)").match("bca").toString() == R"(0="bca", 1="bca")");
 	});
 
+	test("Regex DFA", []
+	{
+		assert(Regex("b+").dfa.isSupported());
+		assert(!Regex(R"((\w)\1)").dfa.isSupported());
+		assert(!Regex("(?=a)a").dfa.isSupported());
+
+		assert(Regex("ab+c").dfa.prefix == "ab");
+		assert(Regex("ab+c").search("xxabbbcx").toString() == R"(0="abbbc")");
+		assert(Regex("(a|b)c").search("xxbcac").toString() == R"(0="bc", 1="b")");
+		assert(Regex("x*").search("aaa").isSuccess() == true);
+		assert(Regex(R"(\bcat\b)").search("concat cat").toString() == R"(0="cat")");
+		assert(Regex("^b").search("ab").isSuccess() == false);
+		assert(Regex("(?m)^b").search("a\nb").toString() == R"(0="b")");
+		assert(Regex("a$").search("a\n").toString() == R"(0="a")");
+
+		// Backtracking would take exponential time here.
+		std::string s(5000, 'a');
+		assert(Regex("(a*)*b").search(s).isSuccess() == false);
+		s.append("ERROR disk full\n");
+		assert(Regex(R"(ERROR (\w+) full)").search(s).toString() == R"(0="ERROR disk full", 1="disk")");
+
+		// States built by one search are reused by the next, and thrown away once there are too many.
+		{
+			Regex r(R"([a-z]{3}[0-9]+)");
+			assert(r.search("xx abc123 yy").toString() == R"(0="abc123")");
+			assert(r.search("!!zzz9").toString() == R"(0="zzz9")");
+			assert(r.search("ab12").isSuccess() == false);
+			std::string noise;
+			for (int i = 0; i != 0x4000; ++i)
+			{
+				noise.push_back("ab1 "[(i * 7 + i / 5) % 4]);
+			}
+			noise.append("end42");
+			assert(r.search(noise).toString() == R"(0="end42")");
+			assert(r.search("xx abc123 yy").toString() == R"(0="abc123")");
+		}
+
+		// Patterns the DFA can't handle still use the literal prefix to skip ahead.
+		assert(Regex(R"(ERROR (\w)\1)").search("xERROR aa").toString() == R"(0="ERROR aa", 1="a")");
+	});
+
 	test("MessageStream", []
 	{
 		MessageStream<std::string, int> ms{};
@@ -1113,6 +1487,37 @@ static void unit_io()
 		assert(line == "World");
 		assert(!sr.getLine(line));
 	});
+	test("file readers", []
+	{
+		const auto path = filesystem::tempfile();
+		string::toFile(path, std::string("\x01\x02\x03\x04Hello", 9));
+		{
+			MappedFileReader mr(path);
+			assert(mr.isOpen());
+			uint32_t u;
+			assert(mr.u32le(u) && u == 0x04030201);
+			assert(mr.getSpan(4, 5) && memcmp(mr.getSpan(4, 5), "Hello", 5) == 0);
+			assert(mr.getSpan(4, 6) == nullptr);
+			assert(mr.getRemainingBytes() == 5);
+			std::string str;
+			assert(!mr.str(6, str));
+		}
+		{
+			PreadFileReader pr(path);
+			assert(pr.isOpen());
+			std::string str;
+			pr.seek(4);
+			assert(pr.str(5, str) && str == "Hello");
+			assert(!pr.hasMore());
+			pr.seek(0);
+			uint32_t u;
+			assert(pr.u32le(u) && u == 0x04030201);
+			assert(!pr.str(6, str));
+		}
+		std::filesystem::remove(path);
+		assert(!MappedFileReader(path).isOpen());
+		assert(!PreadFileReader(path).isOpen());
+	});
 }
 
 static void unit_lang()
@@ -1229,6 +1634,109 @@ endif;)") == "");
 		});
 	}
 
+	unit("irBytecodeVm")
+	{
+		test("matches irVm", []
+		{
+			auto m = laPlutoFrontend().parse(R"(
+function gcd(a, b)
+	while b ~= 0 do
+		local t
+		t = b
+		b = a % b
+		a = t
+	end
+	return a
+end
+function f(n)
+	local i
+	local s
+	i = 0
+	s = 7 * 6 - 42
+	while i ~= n do
+		if i % 3 == 0 then
+			s = s + gcd(i, n) * 2
+		else
+			s = s - i
+		end
+		i = i + 1
+	end
+	return s
+end
+)");
+			const auto bc = irBytecode::compile(m);
+			for (int64_t n : { 0, 1, 12, 1000 })
+			{
+				auto memory = m.getContiguousMemory();
+				irVm vm(memory);
+				vm.locals.emplace_back(n);
+				irBytecodeVm bvm(memory);
+				assert(bvm.execute(bc, 1, { irVm::Variable(n) }).at(0).value.i64 == vm.execute(m, m.func_exports.at(1)).at(0).value.i64);
+			}
+		});
+	}
+
+#if SOUP_X86 && SOUP_BITS == 64
+	unit("laX64Backend")
+	{
+		test("MathExpr", []
+		{
+			for (const char* expr : { "3 - 2 + 1", "1 * 2 + 3 * 4", "100 / 7 % 5 * 3 - 9", "5 - 10 * 3" })
+			{
+				auto m = laMathFrontend().parse(expr);
+				auto exe = laX64Backend().load(m);
+				assert(exe.call<int64_t>(0) == MathExpr::evaluate(expr));
+			}
+		});
+		test("calls, loops, and spills", []
+		{
+			auto m = laPlutoFrontend().parse(R"(
+function gcd(a, b)
+	while b ~= 0 do
+		local t
+		t = b
+		b = a % b
+		a = t
+	end
+	return a
+end
+function mix(a, b)
+	local c
+	local d
+	local e
+	local f
+	local g
+	local h
+	local i
+	local j
+	c = a + b
+	d = a - b
+	e = a * b
+	f = c * d - e
+	g = f + gcd(a, b)
+	h = g - c * 3
+	i = h * d + f
+	j = i - gcd(e, c) * g
+	return a + b + c + d + e + f + g + h + i + j
+end
+)");
+			auto exe = laX64Backend().load(m);
+			for (int64_t a : { 12, 17, 1000000007 })
+			{
+				for (int64_t b : { 18, 5, 998244353 })
+				{
+					auto memory = m.getContiguousMemory();
+					irVm vm(memory);
+					vm.locals.emplace_back(a);
+					vm.locals.emplace_back(b);
+					assert(exe.call<int64_t>(1, a, b) == vm.execute(m, m.func_exports.at(1)).at(0).value.i64);
+				}
+			}
+			assert(exe.call<int64_t>(0, int64_t(48), int64_t(180)) == 12);
+		});
+	}
+#endif
+
 	unit("WASM")
 	{
 		test("addTwo", []
@@ -1386,6 +1894,330 @@ endif;)") == "");
 			assert(vm.stack.top().f64 == 120.0);
 			assert(vm.stack.pop(), vm.stack.empty());
 		});
+		test("Pre-decoded", []
+		{
+			// (module
+			//   (func $sum (export "sum") (param $n i32) (result i32) (local $acc i32)
+			//     (block $done
+			//       (loop $next
+			//         (br_if $done (i32.eqz (local.get $n)))
+			//         (local.set $acc (i32.add (local.get $acc) (local.get $n)))
+			//         (local.set $n (i32.sub (local.get $n) (i32.const 1)))
+			//         (br $next)))
+			//     (local.get $acc))
+			//   (func $fib (export "fib") (param $n i32) (result i32)
+			//     (if (result i32) (i32.lt_s (local.get $n) (i32.const 2))
+			//       (then (local.get $n))
+			//       (else (i32.add
+			//         (call $fib (i32.sub (local.get $n) (i32.const 1)))
+			//         (call $fib (i32.sub (local.get $n) (i32.const 2)))))))
+			//   (func $classify (export "classify") (param $n i32) (result i32)
+			//     (block (block (block (br_table 0 1 2 (local.get $n))) (return (i32.const 10))) (return (i32.const 20)))
+			//     (i32.const 30))
+			// )
+			WasmScript scr;
+			assert(scr.load(base64::decode("AGFzbQEAAAABBgFgAX8BfwMEAwAAAAcYAwNzdW0AAANmaWIAAQhjbGFzc2lmeQACClsDIQEBfwJAA0AgAEUNASABIABqIQEgAEEBayEADAALCyABCxwAIABBAkgEfyAABSAAQQFrEAEgAEECaxABagsLGgACQAJAAkAgAA4CAAECC0EKDwtBFA8LQR4L")));
+			for (const auto& fn : scr.compiled)
+			{
+				assert(!fn.insns.empty());
+			}
+			for (const auto& [name, arg, expected] : std::initializer_list<std::tuple<const char*, int32_t, int32_t>>{
+				{ "sum", 100, 5050 },
+				{ "fib", 20, 6765 },
+				{ "classify", 0, 10 },
+				{ "classify", 1, 20 },
+				{ "classify", 2, 30 },
+				{ "classify", 7, 30 },
+			})
+			{
+				auto code = scr.getExportedFuntion(name);
+				assert(code);
+				WasmVm vm(scr);
+				vm.locals.emplace_back(arg);
+				assert(vm.run(*code));
+				assert(!vm.stack.empty());
+				assert(vm.stack.top().i32 == expected);
+				assert(vm.stack.pop(), vm.stack.empty());
+
+				// The reader-based interpreter must agree with the pre-decoded code.
+				WasmVm ref(scr);
+				ref.locals.emplace_back(arg);
+				MemoryRefReader r(*code);
+				assert(ref.run(r));
+				assert(!ref.stack.empty());
+				assert(ref.stack.top().i32 == expected);
+			}
+		});
+		test("JIT", []
+		{
+			if (!WasmJit::isSupported())
+			{
+				return;
+			}
+			// Every export except the last few is named after the single instruction it wraps, e.g. (func (export "i32.add") (param i32 i32) (result i32) (i32.add (local.get 0) (local.get 1))).
+			// The module also has one page of memory with "80 ff 01 02 03 04 05 06 07 08" at 0x10, a mutable i32 global and a table of [i32.eqz, i32.popcnt, i64.eqz].
+			const auto bin = base64::decode("AGFzbQEAAAABVg9gAn9/AX9gAn5+AX5gAn19AX1gAnx8AXxgAn5+AX9gAn19AX9gAnx8AX9gAX8Bf2ABfgF/YAF/AX5gAn9+AX5gAn98AXxgA39/fwF/YAABf2ABfgF+A2BfAAAAAAAAAAAAAAAAAAEBAQEBAQEBAQEBAQECAgICAwMDAwAAAAAAAAAAAAAEBAQEBAQEBAQEBQUFBQUFBgYGBgYGBwgHCAkJBwkHBwcHCQkJCQcAAAoLDAcHDQAHDg0EBAFwAAMFAwEAAQYGAX8BQQALB7IIXwdpMzIuYWRkAAAHaTMyLnN1YgABB2kzMi5tdWwAAglpMzIuZGl2X3MAAwlpMzIuZGl2X3UABAlpMzIucmVtX3MABQlpMzIucmVtX3UABgdpMzIuYW5kAAcGaTMyLm9yAAgHaTMyLnhvcgAJB2kzMi5zaGwACglpMzIuc2hyX3MACwlpMzIuc2hyX3UADAdpNjQuYWRkAA0HaTY0LnN1YgAOB2k2NC5tdWwADwlpNjQuZGl2X3MAEAlpNjQuZGl2X3UAEQlpNjQucmVtX3MAEglpNjQucmVtX3UAEwdpNjQuYW5kABQGaTY0Lm9yABUHaTY0LnhvcgAWB2k2NC5zaGwAFwlpNjQuc2hyX3MAGAlpNjQuc2hyX3UAGQdmMzIuYWRkABoHZjMyLnN1YgAbB2YzMi5tdWwAHAdmMzIuZGl2AB0HZjY0LmFkZAAeB2Y2NC5zdWIAHwdmNjQubXVsACAHZjY0LmRpdgAhBmkzMi5lcQAiBmkzMi5uZQAjCGkzMi5sdF9zACQIaTMyLmx0X3UAJQhpMzIuZ3RfcwAmCGkzMi5ndF91ACcIaTMyLmxlX3MAKAhpMzIubGVfdQApCGkzMi5nZV9zACoIaTMyLmdlX3UAKwZpNjQuZXEALAZpNjQubmUALQhpNjQubHRfcwAuCGk2NC5sdF91AC8IaTY0Lmd0X3MAMAhpNjQuZ3RfdQAxCGk2NC5sZV9zADIIaTY0LmxlX3UAMwhpNjQuZ2VfcwA0CGk2NC5nZV91ADUGZjMyLmVxADYGZjMyLm5lADcGZjMyLmx0ADgGZjMyLmd0ADkGZjMyLmxlADoGZjMyLmdlADsGZjY0LmVxADwGZjY0Lm5lAD0GZjY0Lmx0AD4GZjY0Lmd0AD8GZjY0LmxlAEAGZjY0LmdlAEEHaTMyLmVxegBCB2k2NC5lcXoAQwppMzIucG9wY250AEQMaTMyLndyYXBfaTY0AEUQaTY0LmV4dGVuZF9pMzJfcwBGEGk2NC5leHRlbmRfaTMyX3UARwhpMzIubG9hZABICGk2NC5sb2FkAEkLaTMyLmxvYWQ4X3MASgtpMzIubG9hZDhfdQBLDGkzMi5sb2FkMTZfcwBMDGkzMi5sb2FkMTZfdQBNC2k2NC5sb2FkOF9zAE4MaTY0LmxvYWQxNl9zAE8MaTY0LmxvYWQzMl9zAFAMaTY0LmxvYWQzMl91AFERaTMyLmxvYWQgb2Zmc2V0PTQAUgppMzIuc3RvcmU4AFMLaTMyLnN0b3JlMTYAVAlpNjQuc3RvcmUAVQlmNjQuc3RvcmUAVgZzZWxlY3QAVwZnbG9iYWwAWAttZW1vcnkuZ3JvdwBZC21lbW9yeS5zaXplAFoNY2FsbF9pbmRpcmVjdABbCGJyX3ZhbHVlAFwFZmFjNjQAXQt1bnJlYWNoYWJsZQBeCQkBAEEACwNCREMKsQZfBwAgACABagsHACAAIAFrCwcAIAAgAWwLBwAgACABbQsHACAAIAFuCwcAIAAgAW8LBwAgACABcAsHACAAIAFxCwcAIAAgAXILBwAgACABcwsHACAAIAF0CwcAIAAgAXULBwAgACABdgsHACAAIAF8CwcAIAAgAX0LBwAgACABfgsHACAAIAF/CwcAIAAgAYALBwAgACABgQsHACAAIAGCCwcAIAAgAYMLBwAgACABhAsHACAAIAGFCwcAIAAgAYYLBwAgACABhwsHACAAIAGICwcAIAAgAZILBwAgACABkwsHACAAIAGUCwcAIAAgAZULBwAgACABoAsHACAAIAGhCwcAIAAgAaILBwAgACABowsHACAAIAFGCwcAIAAgAUcLBwAgACABSAsHACAAIAFJCwcAIAAgAUoLBwAgACABSwsHACAAIAFMCwcAIAAgAU0LBwAgACABTgsHACAAIAFPCwcAIAAgAVELBwAgACABUgsHACAAIAFTCwcAIAAgAVQLBwAgACABVQsHACAAIAFWCwcAIAAgAVcLBwAgACABWAsHACAAIAFZCwcAIAAgAVoLBwAgACABWwsHACAAIAFcCwcAIAAgAV0LBwAgACABXgsHACAAIAFfCwcAIAAgAWALBwAgACABYQsHACAAIAFiCwcAIAAgAWMLBwAgACABZAsHACAAIAFlCwcAIAAgAWYLBQAgAEULBQAgAFALBQAgAGkLBQAgAKcLBQAgAKwLBQAgAK0LBwAgACgCAAsHACAAKQMACwcAIAAsAAALBwAgAC0AAAsHACAALgEACwcAIAAvAQALBwAgADAAAAsHACAAMgEACwcAIAA0AgALBwAgADUCAAsHACAAKAIECw4AIAAgAToAACAAKAIACw4AIAAgATsBACAAKAIACw4AIAAgATcDACAAKQMACw4AIAAgATkDACAAKwMACwkAIAAgASACGwsLACMAIABqJAAjAAsGACAAQAALBAA/AAsJACAAIAERBwALEQBBAQJ/QSkgAA0AGkF+C2oLJQEBfkIBIQECQANAIABQDQEgASAAfiEBIABCAX0hAAwACwsgAQsDAAALCxABAEEQCwqA/wECAwQFBgcI");
+			struct Case
+			{
+				const char* name;
+				std::vector<WasmValue> args;
+				Optional<WasmValue> expected; // std::nullopt if it should trap
+				uint8_t result_size;
+			};
+			for (const auto& c : std::initializer_list<Case>{
+				{ "i32.div_s", { WasmValue(int32_t(-7)), WasmValue(int32_t(2)) }, WasmValue(int32_t(-3)), 4 },
+				{ "i32.div_u", { WasmValue(int32_t(-7)), WasmValue(int32_t(2)) }, WasmValue(int32_t(2147483644)), 4 },
+				{ "i32.rem_s", { WasmValue(int32_t(-7)), WasmValue(int32_t(2)) }, WasmValue(int32_t(-1)), 4 },
+				{ "i32.rem_u", { WasmValue(int32_t(-7)), WasmValue(int32_t(2)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.div_s", { WasmValue(int32_t(5)), WasmValue(int32_t(0)) }, std::nullopt, 0 },
+				{ "i32.div_u", { WasmValue(int32_t(5)), WasmValue(int32_t(0)) }, std::nullopt, 0 },
+				{ "i32.rem_s", { WasmValue(int32_t(5)), WasmValue(int32_t(0)) }, std::nullopt, 0 },
+				{ "i32.rem_u", { WasmValue(int32_t(5)), WasmValue(int32_t(0)) }, std::nullopt, 0 },
+				{ "i32.div_s", { WasmValue(INT32_MIN), WasmValue(int32_t(-1)) }, std::nullopt, 0 },
+				{ "i32.div_u", { WasmValue(INT32_MIN), WasmValue(int32_t(-1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.rem_s", { WasmValue(INT32_MIN), WasmValue(int32_t(-1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.rem_u", { WasmValue(INT32_MIN), WasmValue(int32_t(-1)) }, WasmValue(INT32_MIN), 4 },
+				{ "i32.add", { WasmValue(int32_t(2147483647)), WasmValue(int32_t(1)) }, WasmValue(INT32_MIN), 4 },
+				{ "i32.sub", { WasmValue(int32_t(2147483647)), WasmValue(int32_t(1)) }, WasmValue(int32_t(2147483646)), 4 },
+				{ "i32.mul", { WasmValue(int32_t(2147483647)), WasmValue(int32_t(1)) }, WasmValue(int32_t(2147483647)), 4 },
+				{ "i32.and", { WasmValue(int32_t(2147483647)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.or", { WasmValue(int32_t(2147483647)), WasmValue(int32_t(1)) }, WasmValue(int32_t(2147483647)), 4 },
+				{ "i32.xor", { WasmValue(int32_t(2147483647)), WasmValue(int32_t(1)) }, WasmValue(int32_t(2147483646)), 4 },
+				{ "i32.add", { WasmValue(int32_t(6)), WasmValue(int32_t(-7)) }, WasmValue(int32_t(-1)), 4 },
+				{ "i32.sub", { WasmValue(int32_t(6)), WasmValue(int32_t(-7)) }, WasmValue(int32_t(13)), 4 },
+				{ "i32.mul", { WasmValue(int32_t(6)), WasmValue(int32_t(-7)) }, WasmValue(int32_t(-42)), 4 },
+				{ "i32.and", { WasmValue(int32_t(6)), WasmValue(int32_t(-7)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.or", { WasmValue(int32_t(6)), WasmValue(int32_t(-7)) }, WasmValue(int32_t(-1)), 4 },
+				{ "i32.xor", { WasmValue(int32_t(6)), WasmValue(int32_t(-7)) }, WasmValue(int32_t(-1)), 4 },
+				{ "i32.shl", { WasmValue(int32_t(-8)), WasmValue(int32_t(33)) }, WasmValue(int32_t(-16)), 4 },
+				{ "i32.shr_s", { WasmValue(int32_t(-8)), WasmValue(int32_t(33)) }, WasmValue(int32_t(-4)), 4 },
+				{ "i32.shr_u", { WasmValue(int32_t(-8)), WasmValue(int32_t(33)) }, WasmValue(int32_t(2147483644)), 4 },
+				{ "i32.shl", { WasmValue(INT32_MIN), WasmValue(int32_t(31)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.shr_s", { WasmValue(INT32_MIN), WasmValue(int32_t(31)) }, WasmValue(int32_t(-1)), 4 },
+				{ "i32.shr_u", { WasmValue(INT32_MIN), WasmValue(int32_t(31)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.eq", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.eq", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.ne", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.ne", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.lt_s", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.lt_s", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.lt_u", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.lt_u", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.gt_s", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.gt_s", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.gt_u", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.gt_u", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.le_s", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.le_s", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.le_u", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.le_u", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.ge_s", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.ge_s", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.ge_u", { WasmValue(int32_t(-1)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.ge_u", { WasmValue(int64_t(-0x100000001ll)), WasmValue(int64_t(0x100000001ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.eq", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.eq", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.ne", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.ne", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.lt_s", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.lt_s", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.lt_u", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.lt_u", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.gt_s", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.gt_s", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.gt_u", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.gt_u", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.le_s", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.le_s", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.le_u", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.le_u", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.ge_s", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.ge_s", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.ge_u", { WasmValue(int32_t(3)), WasmValue(int32_t(3)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.ge_u", { WasmValue(int64_t(0x300000003ll)), WasmValue(int64_t(0x300000003ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.div_s", { WasmValue(INT64_MIN), WasmValue(int64_t(-1ll)) }, std::nullopt, 0 },
+				{ "i64.div_u", { WasmValue(INT64_MIN), WasmValue(int64_t(-1ll)) }, WasmValue(int64_t(0ll)), 8 },
+				{ "i64.rem_s", { WasmValue(INT64_MIN), WasmValue(int64_t(-1ll)) }, WasmValue(int64_t(0ll)), 8 },
+				{ "i64.rem_u", { WasmValue(INT64_MIN), WasmValue(int64_t(-1ll)) }, WasmValue(INT64_MIN), 8 },
+				{ "i64.div_s", { WasmValue(int64_t(5ll)), WasmValue(int64_t(0ll)) }, std::nullopt, 0 },
+				{ "i64.div_u", { WasmValue(int64_t(5ll)), WasmValue(int64_t(0ll)) }, std::nullopt, 0 },
+				{ "i64.rem_s", { WasmValue(int64_t(5ll)), WasmValue(int64_t(0ll)) }, std::nullopt, 0 },
+				{ "i64.rem_u", { WasmValue(int64_t(5ll)), WasmValue(int64_t(0ll)) }, std::nullopt, 0 },
+				{ "i64.div_s", { WasmValue(INT64_MIN), WasmValue(int64_t(3ll)) }, WasmValue(int64_t(-0x2aaaaaaaaaaaaaaall)), 8 },
+				{ "i64.div_u", { WasmValue(INT64_MIN), WasmValue(int64_t(3ll)) }, WasmValue(int64_t(0x2aaaaaaaaaaaaaaall)), 8 },
+				{ "i64.rem_s", { WasmValue(INT64_MIN), WasmValue(int64_t(3ll)) }, WasmValue(int64_t(-2ll)), 8 },
+				{ "i64.rem_u", { WasmValue(INT64_MIN), WasmValue(int64_t(3ll)) }, WasmValue(int64_t(2ll)), 8 },
+				{ "i64.add", { WasmValue(int64_t(0x7fffffffffffffffll)), WasmValue(int64_t(1ll)) }, WasmValue(INT64_MIN), 8 },
+				{ "i64.sub", { WasmValue(int64_t(0x7fffffffffffffffll)), WasmValue(int64_t(1ll)) }, WasmValue(int64_t(0x7ffffffffffffffell)), 8 },
+				{ "i64.mul", { WasmValue(int64_t(0x7fffffffffffffffll)), WasmValue(int64_t(1ll)) }, WasmValue(int64_t(0x7fffffffffffffffll)), 8 },
+				{ "i64.and", { WasmValue(int64_t(0x7fffffffffffffffll)), WasmValue(int64_t(1ll)) }, WasmValue(int64_t(1ll)), 8 },
+				{ "i64.or", { WasmValue(int64_t(0x7fffffffffffffffll)), WasmValue(int64_t(1ll)) }, WasmValue(int64_t(0x7fffffffffffffffll)), 8 },
+				{ "i64.xor", { WasmValue(int64_t(0x7fffffffffffffffll)), WasmValue(int64_t(1ll)) }, WasmValue(int64_t(0x7ffffffffffffffell)), 8 },
+				{ "i64.add", { WasmValue(int64_t(0x123456789ll)), WasmValue(int64_t(-0xfedcba987ll)) }, WasmValue(int64_t(-0xeca8641fell)), 8 },
+				{ "i64.sub", { WasmValue(int64_t(0x123456789ll)), WasmValue(int64_t(-0xfedcba987ll)) }, WasmValue(int64_t(0x1111111110ll)), 8 },
+				{ "i64.mul", { WasmValue(int64_t(0x123456789ll)), WasmValue(int64_t(-0xfedcba987ll)) }, WasmValue(int64_t(-0x1fa00acc59960a3fll)), 8 },
+				{ "i64.and", { WasmValue(int64_t(0x123456789ll)), WasmValue(int64_t(-0xfedcba987ll)) }, WasmValue(int64_t(33834505ll)), 8 },
+				{ "i64.or", { WasmValue(int64_t(0x123456789ll)), WasmValue(int64_t(-0xfedcba987ll)) }, WasmValue(int64_t(-0xecc8a8807ll)), 8 },
+				{ "i64.xor", { WasmValue(int64_t(0x123456789ll)), WasmValue(int64_t(-0xfedcba987ll)) }, WasmValue(int64_t(-0xece8ece10ll)), 8 },
+				{ "i64.shl", { WasmValue(int64_t(-8ll)), WasmValue(int64_t(65ll)) }, WasmValue(int64_t(-16ll)), 8 },
+				{ "i64.shr_s", { WasmValue(int64_t(-8ll)), WasmValue(int64_t(65ll)) }, WasmValue(int64_t(-4ll)), 8 },
+				{ "i64.shr_u", { WasmValue(int64_t(-8ll)), WasmValue(int64_t(65ll)) }, WasmValue(int64_t(0x7ffffffffffffffcll)), 8 },
+				{ "i64.shl", { WasmValue(INT64_MIN), WasmValue(int64_t(63ll)) }, WasmValue(int64_t(0ll)), 8 },
+				{ "i64.shr_s", { WasmValue(INT64_MIN), WasmValue(int64_t(63ll)) }, WasmValue(int64_t(-1ll)), 8 },
+				{ "i64.shr_u", { WasmValue(INT64_MIN), WasmValue(int64_t(63ll)) }, WasmValue(int64_t(1ll)), 8 },
+				{ "f32.add", { WasmValue(-3.0f), WasmValue(0.125f) }, WasmValue(-2.875f), 4 },
+				{ "f32.sub", { WasmValue(-3.0f), WasmValue(0.125f) }, WasmValue(-3.125f), 4 },
+				{ "f32.mul", { WasmValue(-3.0f), WasmValue(0.125f) }, WasmValue(-0.375f), 4 },
+				{ "f32.div", { WasmValue(-3.0f), WasmValue(0.125f) }, WasmValue(-24.0f), 4 },
+				{ "f64.add", { WasmValue(-3.0), WasmValue(0.125) }, WasmValue(-2.875), 8 },
+				{ "f64.sub", { WasmValue(-3.0), WasmValue(0.125) }, WasmValue(-3.125), 8 },
+				{ "f64.mul", { WasmValue(-3.0), WasmValue(0.125) }, WasmValue(-0.375), 8 },
+				{ "f64.div", { WasmValue(-3.0), WasmValue(0.125) }, WasmValue(-24.0), 8 },
+				{ "f32.eq", { WasmValue(1.0f), WasmValue(2.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.ne", { WasmValue(1.0f), WasmValue(2.0f) }, WasmValue(int32_t(1)), 4 },
+				{ "f32.lt", { WasmValue(1.0f), WasmValue(2.0f) }, WasmValue(int32_t(1)), 4 },
+				{ "f32.gt", { WasmValue(1.0f), WasmValue(2.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.le", { WasmValue(1.0f), WasmValue(2.0f) }, WasmValue(int32_t(1)), 4 },
+				{ "f32.ge", { WasmValue(1.0f), WasmValue(2.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.eq", { WasmValue(1.0), WasmValue(2.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.ne", { WasmValue(1.0), WasmValue(2.0) }, WasmValue(int32_t(1)), 4 },
+				{ "f64.lt", { WasmValue(1.0), WasmValue(2.0) }, WasmValue(int32_t(1)), 4 },
+				{ "f64.gt", { WasmValue(1.0), WasmValue(2.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.le", { WasmValue(1.0), WasmValue(2.0) }, WasmValue(int32_t(1)), 4 },
+				{ "f64.ge", { WasmValue(1.0), WasmValue(2.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.eq", { WasmValue(NAN), WasmValue(1.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.ne", { WasmValue(NAN), WasmValue(1.0f) }, WasmValue(int32_t(1)), 4 },
+				{ "f32.lt", { WasmValue(NAN), WasmValue(1.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.gt", { WasmValue(NAN), WasmValue(1.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.le", { WasmValue(NAN), WasmValue(1.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f32.ge", { WasmValue(NAN), WasmValue(1.0f) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.eq", { WasmValue(double(NAN)), WasmValue(1.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.ne", { WasmValue(double(NAN)), WasmValue(1.0) }, WasmValue(int32_t(1)), 4 },
+				{ "f64.lt", { WasmValue(double(NAN)), WasmValue(1.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.gt", { WasmValue(double(NAN)), WasmValue(1.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.le", { WasmValue(double(NAN)), WasmValue(1.0) }, WasmValue(int32_t(0)), 4 },
+				{ "f64.ge", { WasmValue(double(NAN)), WasmValue(1.0) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.eqz", { WasmValue(int32_t(0)) }, WasmValue(int32_t(1)), 4 },
+				{ "i32.eqz", { WasmValue(int32_t(-5)) }, WasmValue(int32_t(0)), 4 },
+				{ "i64.eqz", { WasmValue(int64_t(0ll)) }, WasmValue(int32_t(1)), 4 },
+				{ "i64.eqz", { WasmValue(int64_t(0x10000000000ll)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.popcnt", { WasmValue(int32_t(-1)) }, WasmValue(int32_t(32)), 4 },
+				{ "i32.popcnt", { WasmValue(int32_t(65793)) }, WasmValue(int32_t(3)), 4 },
+				{ "i32.wrap_i64", { WasmValue(int64_t(0x123456789ll)) }, WasmValue(int32_t(591751049)), 4 },
+				{ "i64.extend_i32_s", { WasmValue(int32_t(-2)) }, WasmValue(int64_t(-2ll)), 8 },
+				{ "i64.extend_i32_u", { WasmValue(int32_t(-2)) }, WasmValue(int64_t(0xfffffffell)), 8 },
+				{ "i32.load", { WasmValue(int32_t(16)) }, WasmValue(int32_t(33685376)), 4 },
+				{ "i64.load", { WasmValue(int32_t(16)) }, WasmValue(int64_t(0x60504030201ff80ll)), 8 },
+				{ "i32.load8_s", { WasmValue(int32_t(16)) }, WasmValue(int32_t(-128)), 4 },
+				{ "i32.load8_u", { WasmValue(int32_t(16)) }, WasmValue(int32_t(128)), 4 },
+				{ "i32.load16_s", { WasmValue(int32_t(16)) }, WasmValue(int32_t(-128)), 4 },
+				{ "i32.load16_u", { WasmValue(int32_t(16)) }, WasmValue(int32_t(65408)), 4 },
+				{ "i64.load8_s", { WasmValue(int32_t(17)) }, WasmValue(int64_t(-1ll)), 8 },
+				{ "i64.load16_s", { WasmValue(int32_t(16)) }, WasmValue(int64_t(-128ll)), 8 },
+				{ "i64.load32_u", { WasmValue(int32_t(18)) }, WasmValue(int64_t(67305985ll)), 8 },
+				{ "i32.load offset=4", { WasmValue(int32_t(16)) }, WasmValue(int32_t(100992003)), 4 },
+				{ "i32.load", { WasmValue(int32_t(65532)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.load", { WasmValue(int32_t(65533)) }, std::nullopt, 0 },
+				{ "i32.load", { WasmValue(int32_t(-1)) }, std::nullopt, 0 },
+				{ "i32.load offset=4", { WasmValue(int32_t(65528)) }, WasmValue(int32_t(0)), 4 },
+				{ "i32.load offset=4", { WasmValue(int32_t(65529)) }, std::nullopt, 0 },
+				{ "i32.load offset=4", { WasmValue(int32_t(-4)) }, std::nullopt, 0 },
+				{ "i32.store8", { WasmValue(int32_t(65532)), WasmValue(int32_t(7)) }, WasmValue(int32_t(7)), 4 },
+				{ "i32.store8", { WasmValue(int32_t(256)), WasmValue(int32_t(511)) }, WasmValue(int32_t(255)), 4 },
+				{ "i32.store16", { WasmValue(int32_t(512)), WasmValue(int32_t(74565)) }, WasmValue(int32_t(9029)), 4 },
+				{ "i64.store", { WasmValue(int32_t(768)), WasmValue(int64_t(-42ll)) }, WasmValue(int64_t(-42ll)), 8 },
+				{ "f64.store", { WasmValue(int32_t(1024)), WasmValue(2.5) }, WasmValue(2.5), 8 },
+				{ "i32.store8", { WasmValue(int32_t(65536)), WasmValue(int32_t(1)) }, std::nullopt, 0 },
+				{ "select", { WasmValue(int32_t(1)), WasmValue(int32_t(2)), WasmValue(int32_t(1)) }, WasmValue(int32_t(1)), 4 },
+				{ "select", { WasmValue(int32_t(1)), WasmValue(int32_t(2)), WasmValue(int32_t(0)) }, WasmValue(int32_t(2)), 4 },
+				{ "memory.size", {}, WasmValue(int32_t(1)), 4 },
+				{ "call_indirect", { WasmValue(int32_t(0)), WasmValue(int32_t(0)) }, WasmValue(int32_t(1)), 4 },
+				{ "call_indirect", { WasmValue(int32_t(7)), WasmValue(int32_t(1)) }, WasmValue(int32_t(3)), 4 },
+				{ "call_indirect", { WasmValue(int32_t(0)), WasmValue(int32_t(2)) }, std::nullopt, 0 },
+				{ "call_indirect", { WasmValue(int32_t(0)), WasmValue(int32_t(3)) }, std::nullopt, 0 },
+				{ "br_value", { WasmValue(int32_t(1)) }, WasmValue(int32_t(42)), 4 },
+				{ "br_value", { WasmValue(int32_t(0)) }, WasmValue(int32_t(-1)), 4 },
+				{ "fac64", { WasmValue(int64_t(20ll)) }, WasmValue(int64_t(0x21c3677c82b40000ll)), 8 },
+				{ "unreachable", {}, std::nullopt, 0 },
+			})
+			{
+				// Fresh instances since some cases change memory or globals.
+				WasmScript jitted;
+				assert(jitted.load(bin));
+				assert(jitted.enableJit());
+				assert(jitted.jit->getNumCompiledFunctions() + 2 >= jitted.code.size()); // popcnt is only compiled if the CPU has it
+				WasmScript interpreted;
+				assert(interpreted.load(bin));
+
+				auto code = jitted.getExportedFuntion(c.name);
+				assert(code);
+				auto ref_code = interpreted.getExportedFuntion(c.name);
+				assert(ref_code);
+				WasmVm vm(jitted);
+				WasmVm ref(interpreted);
+				for (const auto& arg : c.args)
+				{
+					vm.locals.emplace_back(arg);
+					ref.locals.emplace_back(arg);
+				}
+				if (!c.expected.has_value())
+				{
+					assert(!vm.run(*code));
+					assert(!ref.run(*ref_code));
+					continue;
+				}
+				assert(vm.run(*code));
+				assert(vm.stack.size() == 1);
+				assert(memcmp(&vm.stack.top(), &*c.expected, c.result_size) == 0);
+				assert(ref.run(*ref_code));
+				assert(ref.stack.size() == 1);
+				assert(memcmp(&ref.stack.top(), &*c.expected, c.result_size) == 0);
+			}
+		});
+		test("memory.grow", []
+		{
+			// (module (memory 1 3)
+			//   (func (export "grow") (param i32) (result i32) (memory.grow (local.get 0)))
+			//   (func (export "load") (param i32) (result i32) (i32.load (local.get 0)))
+			//   (func (export "store") (param i32 i32) (i32.store (local.get 0) (local.get 1)))
+			//   (func (export "size") (result i32) (memory.size))
+			// )
+			for (const bool jit : { false, true })
+			{
+				WasmScript scr;
+				assert(scr.load(base64::decode("AGFzbQEAAAABDwNgAX8Bf2ACf38AYAABfwMFBAAAAQIFBAEBAQMHHgQEZ3JvdwAABGxvYWQAAQVzdG9yZQACBHNpemUAAwofBAYAIABAAAsHACAAKAIACwkAIAAgATYCAAsEAD8ACw==")));
+				if (jit && !scr.enableJit())
+				{
+					continue;
+				}
+				const uint8_t* const memory = scr.memory;
+				auto call = [&scr](const char* name, std::vector<WasmValue> args) -> Optional<int32_t>
+				{
+					WasmVm vm(scr);
+					vm.locals = std::move(args);
+					if (!vm.run(*scr.getExportedFuntion(name)))
+					{
+						return std::nullopt;
+					}
+					return vm.stack.empty() ? 0 : vm.stack.top().i32;
+				};
+				assert(call("load", { 0xFFFC }) == 0);
+				assert(!call("load", { 0xFFFD }));
+				assert(!call("store", { 0x10000, 1 }));
+				assert(call("grow", { 1 }) == 1);
+				assert(call("size", {}) == 2);
+				assert(call("store", { 0x1FFFC, 42 }).has_value());
+				assert(call("load", { 0x1FFFC }) == 42);
+				assert(!call("load", { 0x20000 }));
+				assert(!call("load", { -1 }));
+				assert(call("grow", { 2 }) == -1); // would exceed the maximum of 3 pages
+				assert(call("grow", { 0 }) == 2);
+				if (scr.memory_region)
+				{
+					assert(scr.memory == memory); // grew in place
+				}
+			}
+		});
 	}
 
 	test("reflection", []
@@ -1471,6 +2303,42 @@ static void unit_math_bigint()
 		assert("2"_b.getTrailingZeroesBinary() == 1);
 		assert(Bigint::_2pow(100).getTrailingZeroesBinary() == 100);
 	});
+	test("multiplication", []
+	{
+		for (size_t bits : { 32, 1000, 5000, 20000, 100000 })
+		{
+			const Bigint a = Bigint::random(bits);
+			const Bigint b = Bigint::random(bits / 3 + 1);
+			const Bigint c = Bigint::random(bits);
+			const Bigint ac = a.multiplySimple(c);
+			assert(a.multiplyKaratsubaUnsigned(b) == a.multiplySimple(b));
+			assert(a.multiplyKaratsubaUnsigned(c) == ac);
+			assert(a.multiplyNtt(c) == ac);
+			assert((Bigint() - a) * c == Bigint() - ac);
+			assert(!(Bigint() * (Bigint() - a)).isNegative());
+			assert(!((Bigint() - a) * Bigint()).isNegative());
+			assert(((Bigint() - a) * Bigint()).toString() == "0");
+			const Bigint ones = Bigint::_2pow(bits) - 1_b;
+			assert(ones * ones == ones.multiplySimple(ones));
+		}
+	});
+	test("MontgomeryContext", []
+	{
+		for (size_t bits : { 61, 1024, 2048, 2500 })
+		{
+			Bigint m = Bigint::random(bits);
+			m.enableBit(0);
+			m.enableBit(bits - 1);
+			const MontgomeryContext ctx(m);
+			const Bigint x = Bigint::random(bits + 10);
+			assert(ctx.modPow(x, 65537_b) == x.modPowBasic(65537_b, m));
+			const Bigint e = Bigint::random(bits);
+			assert(ctx.modPow(x, e) == x.modPowBasic(e, m));
+			assert(ctx.modPow(x, Bigint()) == 1_b);
+			const Bigint a = x.modUnsigned(m);
+			assert(ctx.modMul(a, a) == (a * a).modUnsigned(m));
+		}
+	});
 }
 
 static void unit_math()
@@ -1632,6 +2500,272 @@ static void test_uri()
 	assert(uri.getRequestPath() == "/translate_a/t?client=dict-chrome-ex&sl=auto&tl=zh-CN&q=How+are+you%3F");
 }
 
+static void test_web_request_parser()
+{
+	{
+		// Fed byte by byte, with a pipelined request following.
+		const std::string data = "GET /a HTTP/1.1\r\nHost: example.com\r\nX-Padded:  value \r\n\r\nGET /b HTTP/1.0\r\n\r\n";
+		HttpRequestParser parser;
+		size_t i = 0;
+		HttpRequestParser::Status status;
+		do
+		{
+			parser.feed(&data[i++], 1);
+		} while (status = parser.parse(), status == HttpRequestParser::NEED_MORE_DATA);
+		assert(status == HttpRequestParser::COMPLETE);
+		assert(parser.getMethod() == "GET");
+		assert(parser.getPath() == "/a");
+		assert(parser.getNumHeaders() == 2);
+		std::string_view value;
+		assert(parser.findHeader("x-padded", value) && value == "value");
+		assert(parser.isKeepAlive());
+		auto req = parser.toHttpRequest();
+		assert(req.path == "/a");
+		assert(req.header_fields.at("Host") == "example.com");
+		parser.consume();
+
+		parser.feed(&data[i], data.size() - i);
+		assert(parser.parse() == HttpRequestParser::COMPLETE);
+		assert(parser.getPath() == "/b");
+		assert(!parser.isKeepAlive());
+		parser.consume();
+		assert(parser.parse() == HttpRequestParser::NEED_MORE_DATA);
+	}
+	{
+		HttpRequestParser parser;
+		parser.feed(std::string("POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\nhel"));
+		assert(parser.parse() == HttpRequestParser::NEED_MORE_DATA);
+		parser.feed(std::string("loGET"));
+		assert(parser.parse() == HttpRequestParser::COMPLETE);
+		assert(parser.getBody() == "hello");
+		parser.consume();
+		assert(parser.buf == "GET");
+	}
+	{
+		HttpRequestParser parser;
+		parser.feed(std::string("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nhello\r\n"));
+		assert(parser.parse() == HttpRequestParser::NEED_MORE_DATA);
+		parser.feed(std::string("7\r\n, world\r\n0\r\nX-Trailer: 1\r\n\r\n"));
+		assert(parser.parse() == HttpRequestParser::COMPLETE);
+		assert(parser.getBody() == "hello, world");
+		parser.consume();
+		assert(parser.buf.empty());
+	}
+	{
+		HttpRequestParser parser;
+		parser.limits.max_body_bytes = 4;
+		parser.feed(std::string("POST / HTTP/1.1\r\nContent-Length: 5\r\n\r\n"));
+		assert(parser.parse() == HttpRequestParser::BODY_TOO_LARGE);
+	}
+	{
+		// Would wrap around to 0 (the last chunk) if it wasn't checked digit by digit.
+		HttpRequestParser parser;
+		parser.feed(std::string("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n10000000000000000\r\n"));
+		assert(parser.parse() == HttpRequestParser::BODY_TOO_LARGE);
+	}
+	{
+		HttpRequestParser parser;
+		parser.limits.max_body_bytes = 0x10;
+		parser.feed(std::string("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n0010\r\n0123456789abcdef\r\n1\r\n"));
+		assert(parser.parse() == HttpRequestParser::BODY_TOO_LARGE);
+	}
+	{
+		HttpRequestParser parser;
+		parser.limits.max_header_bytes = 16;
+		parser.feed(std::string("GET / HTTP/1.1\r\nHost: example.com\r\n"));
+		assert(parser.parse() == HttpRequestParser::HEADERS_TOO_LARGE);
+	}
+	{
+		HttpRequestParser parser;
+		parser.feed(std::string("POST / HTTP/1.1\r\nContent-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+		assert(parser.parse() == HttpRequestParser::MALFORMED);
+	}
+	{
+		HttpRequestParser parser;
+		parser.feed(std::string("GET / HTTP/1.1\r\nBad : header\r\n\r\n"));
+		assert(parser.parse() == HttpRequestParser::MALFORMED);
+	}
+}
+
+static void test_web_response_parser()
+{
+	{
+		// Pipelined responses, fed byte by byte.
+		const std::string data = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhelloHTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 404 Not Found\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\nHTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n";
+		HttpResponseParser parser;
+		size_t i = 0;
+		HttpResponseParser::Status status;
+		do
+		{
+			parser.feed(&data[i++], 1);
+		} while (status = parser.parse(), status == HttpResponseParser::NEED_MORE_DATA);
+		assert(status == HttpResponseParser::COMPLETE);
+		assert(parser.resp.status_code == 200);
+		assert(parser.resp.body == "hello");
+		assert(parser.isKeepAlive());
+		parser.consume();
+
+		do
+		{
+			parser.feed(&data[i++], 1);
+		} while (status = parser.parse(), status == HttpResponseParser::NEED_MORE_DATA);
+		assert(status == HttpResponseParser::COMPLETE);
+		assert(parser.resp.status_code == 404);
+		assert(parser.resp.status_text == "Not Found");
+		assert(parser.resp.body == "abc");
+		parser.consume();
+
+		// The response to a HEAD request has no body.
+		parser.feed(&data[i], data.size() - i);
+		assert(parser.parse(true) == HttpResponseParser::COMPLETE);
+		assert(parser.resp.body.empty());
+		parser.consume();
+		assert(parser.buf.empty());
+	}
+	{
+		HttpResponseParser parser;
+		parser.feed(std::string("HTTP/1.0 200 OK\r\n\r\nuntil close"));
+		assert(parser.parse() == HttpResponseParser::NEED_MORE_DATA);
+		assert(parser.finish() == HttpResponseParser::COMPLETE);
+		assert(parser.resp.body == "until close");
+		assert(!parser.isKeepAlive());
+	}
+	{
+		HttpResponseParser parser;
+		parser.feed(std::string("HTTP/1.1 200 OK\r\nContent-Length: 1\r\nTransfer-Encoding: chunked\r\n\r\n"));
+		assert(parser.parse() == HttpResponseParser::MALFORMED);
+	}
+	{
+		HttpResponseParser parser;
+		parser.max_body_bytes = 4;
+		parser.feed(std::string("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n"));
+		assert(parser.parse() == HttpResponseParser::TOO_LARGE);
+	}
+}
+
+static void test_web_hpack()
+{
+	// RFC 7541, Appendix C.4: Requests with Huffman coding.
+	{
+		HpackDecoder decoder;
+		std::vector<hpack::header_t> headers;
+		assert(decoder.decode(std::string("\x82\x86\x84\x41\x8c\xf1\xe3\xc2\xe5\xf2\x3a\x6b\xa0\xab\x90\xf4\xff", 17), headers));
+		assert(headers.size() == 4);
+		assert(headers[3].first == ":authority" && headers[3].second == "www.example.com");
+		assert(decoder.table.size == 57);
+
+		headers.clear();
+		assert(decoder.decode(std::string("\x82\x86\x84\xbe\x58\x86\xa8\xeb\x10\x64\x9c\xbf", 12), headers));
+		assert(headers.size() == 5);
+		assert(headers[3].second == "www.example.com");
+		assert(headers[4].first == "cache-control" && headers[4].second == "no-cache");
+		assert(decoder.table.size == 110);
+
+		headers.clear();
+		assert(decoder.decode(std::string("\x82\x87\x85\xbf\x40\x88\x25\xa8\x49\xe9\x5b\xa9\x7d\x7f\x89\x25\xa8\x49\xe9\x5b\xb8\xe8\xb4\xbf", 24), headers));
+		assert(headers.size() == 5);
+		assert(headers[1].second == "https");
+		assert(headers[2].second == "/index.html");
+		assert(headers[4].first == "custom-key" && headers[4].second == "custom-value");
+		assert(decoder.table.size == 164);
+
+		// Index 0 is invalid.
+		assert(!decoder.decode(std::string(1, '\x80'), headers));
+	}
+	{
+		HpackEncoder encoder;
+		HpackDecoder decoder;
+		const std::vector<hpack::header_t> request = {
+			{ ":method", "GET" },
+			{ ":scheme", "https" },
+			{ ":authority", "example.com" },
+			{ ":path", "/?q=1" },
+			{ "user-agent", "Mozilla/5.0 (compatible; calamity-inc/Soup)" },
+			{ "authorization", "Bearer secret" },
+		};
+		const std::string first = encoder.encode(request);
+		const std::string second = encoder.encode(request);
+		assert(second.size() < first.size()); // Repeated headers are now indexed.
+		for (const auto& block : { first, second })
+		{
+			std::vector<hpack::header_t> headers;
+			assert(decoder.decode(block, headers));
+			assert(headers == request);
+		}
+	}
+}
+
+static void test_web_range()
+{
+	uint64_t first, last;
+	assert(ServerWebService::parseRange("bytes=0-499", 1000, first, last) == ServerWebService::RANGE_OK);
+	assert(first == 0 && last == 499);
+	assert(ServerWebService::parseRange("bytes=500-", 1000, first, last) == ServerWebService::RANGE_OK);
+	assert(first == 500 && last == 999);
+	assert(ServerWebService::parseRange("bytes=900-5000", 1000, first, last) == ServerWebService::RANGE_OK);
+	assert(first == 900 && last == 999);
+	assert(ServerWebService::parseRange("bytes=-100", 1000, first, last) == ServerWebService::RANGE_OK);
+	assert(first == 900 && last == 999);
+	assert(ServerWebService::parseRange("bytes=-5000", 1000, first, last) == ServerWebService::RANGE_OK);
+	assert(first == 0 && last == 999);
+	assert(ServerWebService::parseRange("bytes=1000-", 1000, first, last) == ServerWebService::RANGE_UNSATISFIABLE);
+	assert(ServerWebService::parseRange("bytes=-0", 1000, first, last) == ServerWebService::RANGE_UNSATISFIABLE);
+	assert(ServerWebService::parseRange("bytes=0-1,5-6", 1000, first, last) == ServerWebService::RANGE_NONE);
+	assert(ServerWebService::parseRange("bytes=5-1", 1000, first, last) == ServerWebService::RANGE_NONE);
+	assert(ServerWebService::parseRange("lines=0-1", 1000, first, last) == ServerWebService::RANGE_NONE);
+	assert(ServerWebService::parseRange("bytes=x-", 1000, first, last) == ServerWebService::RANGE_NONE);
+}
+
+struct TestDnsResolver : public dnsResolver
+{
+	mutable int num_lookups = 0;
+
+	[[nodiscard]] Optional<std::vector<UniquePtr<dnsRecord>>> lookup(dnsType qtype, const std::string& name) const final
+	{
+		++num_lookups;
+		std::vector<UniquePtr<dnsRecord>> res;
+		if (name != "nxdomain.example")
+		{
+			res.emplace_back(soup::make_unique<dnsARecord>(name, 300, SOUP_IPV4_NWE(127, 0, 0, 1)));
+		}
+		return res;
+	}
+};
+
+static void test_dns_cache()
+{
+	dnsCacheResolver resolv(soup::make_unique<TestDnsResolver>());
+	auto& underlying = static_cast<TestDnsResolver&>(*resolv.underlying);
+	resolv.max_entries = dnsCacheResolver::NUM_SHARDS;
+
+	assert(resolv.lookupIPv4("a.example").size() == 1);
+	assert(resolv.lookupIPv4("a.example").size() == 1);
+	assert(underlying.num_lookups == 1);
+
+	// Negative answers are cached as well.
+	assert(resolv.lookupIPv4("nxdomain.example").empty());
+	assert(resolv.lookupIPv4("nxdomain.example").empty());
+	assert(underlying.num_lookups == 2);
+
+	// Concurrent lookups of the same name are coalesced.
+	auto t1 = resolv.makeLookupTask(DNS_A, "b.example");
+	auto t2 = resolv.makeLookupTask(DNS_A, "b.example");
+	t1->run();
+	t2->run();
+	assert(t1->result.has_value() && t1->result->size() == 1);
+	assert(t2->result.has_value() && t2->result->size() == 1);
+	assert(underlying.num_lookups == 3);
+
+	// Size is capped.
+	for (int i = 0; i != 100; ++i)
+	{
+		std::string name = "host";
+		name.append(std::to_string(i));
+		SOUP_UNUSED(resolv.lookup(DNS_A, name));
+	}
+	assert(resolv.getNumEntries() <= dnsCacheResolver::NUM_SHARDS);
+}
+
 static void test_socket_raii_semantics()
 {
 	Socket s;
@@ -1648,6 +2782,674 @@ static void test_socket_raii_semantics()
 	s3.fd.setMovedAway(); // don't try to actually close() fd 1337 now lol
 }
 
+#if SOUP_POSIX
+static void test_socket_send_queue()
+{
+	int fds[2];
+	assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	Socket a, b;
+	a.fd = fds[0];
+	b.fd = fds[1];
+	a.setNonBlocking();
+
+	const std::string head = "head";
+	std::string big(4 * 1024 * 1024, 'x');
+	std::string expected = head + big + "tail";
+	{
+		Socket::SendSlice slices[] = {
+			head, // borrowed
+			std::move(big), // owned
+			std::string("tail"), // owned
+		};
+		assert(a.transport_send(slices, 3));
+	}
+	assert(a.hasPendingSend()); // The kernel's send buffer is way smaller than 4 MiB.
+
+	std::string received;
+	char buf[0x10000];
+	while (received.size() != expected.size())
+	{
+		assert(a.transport_flush());
+		auto ret = ::recv(b.fd, buf, sizeof(buf), 0);
+		assert(ret > 0);
+		received.append(buf, ret);
+	}
+	assert(!a.hasPendingSend());
+	assert(received == expected);
+}
+
+static void test_connection_pool()
+{
+	ConnectionPool pool;
+	pool.max_idle_per_host = 1;
+	pool.max_total_per_host = 2;
+	const ConnectionPool::Key key{ "example.com", 443, true };
+
+	int fds_a[2], fds_b[2];
+	assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_a) == 0);
+	assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_b) == 0);
+	auto a = soup::make_shared<Socket>();
+	auto b = soup::make_shared<Socket>();
+	a->fd = fds_a[0];
+	b->fd = fds_b[0];
+	a->setNonBlocking();
+	b->setNonBlocking();
+	Socket remote_a, remote_b;
+	remote_a.fd = fds_a[1];
+	remote_b.fd = fds_b[1];
+
+	assert(!pool.checkout(key));
+	assert(pool.reserve(key));
+	assert(pool.reserve(key));
+	assert(!pool.reserve(key)); // max_total_per_host
+	pool.add(key, *a);
+	pool.add(key, *b);
+	assert(pool.getNumBusy(key) == 2);
+
+	pool.checkin(a);
+	pool.checkin(b); // max_idle_per_host
+	assert(pool.getNumIdle(key) == 1);
+	assert(pool.getNumBusy(key) == 0);
+	assert(!b->hasConnection());
+	assert(!pool.checkout(ConnectionPool::Key{ "example.com", 80, false }));
+
+	auto c = pool.checkout(key);
+	assert(c.get() == a.get());
+	assert(pool.getNumIdle() == 0);
+	pool.checkin(c);
+	assert(pool.getNumIdle() == 1);
+
+	// The remote closed the idle connection, so it shouldn't be handed out.
+	remote_a.transport_close();
+	assert(!pool.checkout(key));
+	assert(pool.getNumIdle() == 0);
+	assert(pool.reserve(key));
+	pool.unreserve(key);
+	assert(pool.getNumHosts() == 0);
+
+	// A failed reservation doesn't leave an entry behind.
+	pool.max_total_per_host = 0;
+	assert(!pool.reserve(key));
+	assert(pool.getNumHosts() == 0);
+
+	// An idle connection that was closed is cleaned up even if an older one is still fine.
+	pool.max_idle_per_host = 2;
+	pool.max_total_per_host = 2;
+	int fds_d[2], fds_e[2];
+	assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_d) == 0);
+	assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_e) == 0);
+	auto d = soup::make_shared<Socket>();
+	auto e = soup::make_shared<Socket>();
+	d->fd = fds_d[0];
+	e->fd = fds_e[0];
+	d->setNonBlocking();
+	e->setNonBlocking();
+	Socket remote_d, remote_e;
+	remote_d.fd = fds_d[1];
+	remote_e.fd = fds_e[1];
+	assert(pool.reserve(key));
+	assert(pool.reserve(key));
+	pool.add(key, *d);
+	pool.add(key, *e);
+	pool.checkin(d);
+	pool.checkin(e);
+	assert(pool.getNumIdle(key) == 2);
+	e->transport_close();
+	pool.closeExpired();
+	assert(pool.getNumIdle(key) == 1);
+	assert(pool.getNumIdle() == 1);
+	assert(d->hasConnection());
+	pool.closeIdle();
+}
+
+static void test_http_request_task_pool()
+{
+	// Drives HttpRequestTasks from within the scheduler, so they can be destroyed mid-flight.
+	struct Driver : public Task
+	{
+		UniquePtr<HttpRequestTask> task;
+		int step = 0;
+
+		void onTick() final
+		{
+			auto& pool = Scheduler::get()->connection_pool;
+			const ConnectionPool::Key key{ "127.0.0.1", 80, false };
+			switch (step++)
+			{
+			case 0:
+				task = soup::make_unique<HttpRequestTask>(HttpRequest("127.0.0.1", "/"));
+				task->hr.use_tls = false;
+				task->hr.port = 80;
+				task->onTick();
+				assert(task->state == HttpRequestTask::CONNECTING);
+				assert(task->pooled);
+				assert(!pool.reserve(key));
+				task.reset();
+				assert(pool.reserve(key));
+				pool.unreserve(key);
+				break;
+
+			case 1:
+				pool.max_total_per_host = 0;
+				task = soup::make_unique<HttpRequestTask>(HttpRequest("127.0.0.1", "/"));
+				task->hr.use_tls = false;
+				task->hr.port = 80;
+				task->wait_to_reuse_timeout = 0;
+				task->onTick();
+				assert(task->state == HttpRequestTask::WAIT_TO_REUSE);
+				task->onTick();
+				assert(task->state == HttpRequestTask::CONNECTING);
+				assert(!task->pooled);
+				task.reset();
+				setWorkDone();
+				break;
+			}
+		}
+	};
+
+	Scheduler sched;
+	sched.connection_pool.max_total_per_host = 1;
+	sched.add<Driver>();
+	sched.run();
+}
+
+// Closes all sockets of the scheduler it's running on once done is set.
+struct TestStopServerTask : public Task
+{
+	const std::atomic_bool& done;
+
+	TestStopServerTask(const std::atomic_bool& done) noexcept
+		: done(done)
+	{
+	}
+
+	void onTick() final
+	{
+		if (done)
+		{
+			for (const auto& w : Scheduler::get()->workers)
+			{
+				if (w->type == WORKER_TYPE_SOCKET)
+				{
+					static_cast<Socket&>(*w).close();
+				}
+			}
+			setWorkDone();
+		}
+	}
+};
+
+static void test_server_cluster()
+{
+	// Once with SO_REUSEPORT and once with the first loop handing off accepted connections.
+	for (bool reuse_port : { true, false })
+	{
+		static ServerCluster* cluster;
+		static std::atomic_uint served[4];
+		static std::atomic_bool done;
+		ServerCluster c(4, reuse_port);
+		cluster = &c;
+		for (auto& n : served)
+		{
+			n = 0;
+		}
+		done = false;
+
+		ServerService echo([](Socket& s, ServerService&, Server& server)
+		{
+			for (size_t i = 0; i != cluster->getNumLoops(); ++i)
+			{
+				if (&cluster->getLoop(i) == &server)
+				{
+					++served[i];
+				}
+			}
+			s.recv([](Socket& s, std::string&& data, Capture&&)
+			{
+				s.send(data);
+			});
+		});
+		uint16_t port = 40000;
+		while (!c.bind(port, &echo))
+		{
+			assert(++port != 41000);
+		}
+
+		for (size_t i = 0; i != c.getNumLoops(); ++i)
+		{
+			c.add<TestStopServerTask>(i, done);
+		}
+		Thread t([](Capture&& cap)
+		{
+			cap.get<ServerCluster*>()->run();
+		}, &c);
+
+		for (int i = 0; i != 16; ++i)
+		{
+			Socket client;
+			assert(client.connect(IpAddr(SOUP_IPV4(127, 0, 0, 1)), port));
+			client.setBlocking();
+			assert(client.send("hi"));
+			char buf[2];
+			assert(::recv(client.fd, buf, sizeof(buf), MSG_WAITALL) == 2);
+		}
+		done = true;
+		t.awaitCompletion();
+
+		unsigned int total = 0, loops_used = 0;
+		for (const auto& n : served)
+		{
+			total += n;
+			loops_used += (n != 0);
+		}
+		assert(total == 16);
+		assert(loops_used > 1);
+	}
+}
+
+static void test_web_send_file()
+{
+	static std::filesystem::path path;
+	static std::atomic_bool done;
+	path = filesystem::tempfile();
+	done = false;
+
+	// Far more than the socket buffers hold, and read slowly, so the transfer takes much longer than the linger timeout.
+	std::string contents;
+	contents.reserve(20 * 1024 * 1024);
+	for (size_t i = 0; i != 20 * 1024 * 1024; ++i)
+	{
+		contents.push_back(static_cast<char>(i % 251));
+	}
+	string::toFile(path, contents);
+
+	Server serv;
+	serv.linger_timeout_ms = 100;
+	ServerWebService web([](Socket& s, HttpRequest&& req, ServerWebService&)
+	{
+		if (!ServerWebService::sendFile(s, req, path, "application/octet-stream"))
+		{
+			ServerWebService::send404(s);
+		}
+	});
+	uint16_t port = 41000;
+	while (!serv.bind(port, &web))
+	{
+		assert(++port != 42000);
+	}
+
+	serv.add<TestStopServerTask>(done);
+	Thread t([](Capture&& cap)
+	{
+		cap.get<Server*>()->run();
+	}, &serv);
+
+	Socket client;
+	assert(client.connect(IpAddr(SOUP_IPV4(127, 0, 0, 1)), port));
+	client.setBlocking();
+	assert(client.send("GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n"));
+	std::string resp;
+	char buf[0x10000];
+	for (ssize_t ret; (ret = ::recv(client.fd, buf, sizeof(buf), 0)) > 0; )
+	{
+		resp.append(buf, ret);
+		os::sleep(1);
+	}
+	done = true;
+	t.awaitCompletion();
+	std::filesystem::remove(path);
+
+	const auto body_offset = resp.find("\r\n\r\n");
+	assert(body_offset != std::string::npos);
+	assert(resp.substr(0, 12) == "HTTP/1.0 200");
+	assert(resp.size() - (body_offset + 4) == contents.size());
+	assert(resp.compare(body_offset + 4, std::string::npos, contents) == 0);
+}
+
+static void test_web_close_with_queued_data()
+{
+	static std::atomic_bool done;
+	done = false;
+
+	Server serv;
+	ServerWebService web([](Socket& s, HttpRequest&&, ServerWebService&)
+	{
+		// Too big for the socket buffers, so it's still queued when the connection is closed.
+		ServerWebService::sendText(s, std::string(8 * 1024 * 1024, 'x'));
+		s.close();
+	});
+	uint16_t port = 42000;
+	while (!serv.bind(port, &web))
+	{
+		assert(++port != 43000);
+	}
+	serv.add<TestStopServerTask>(done);
+	Thread t([](Capture&& cap)
+	{
+		cap.get<Server*>()->run();
+	}, &serv);
+
+	// The second request must not be processed since the connection was closed in response to the first.
+	Socket client;
+	assert(client.connect(IpAddr(SOUP_IPV4(127, 0, 0, 1)), port));
+	client.setBlocking();
+	assert(client.send("GET / HTTP/1.1\r\nHost: localhost\r\n\r\nGET / HTTP/1.1\r\nHost: localhost\r\n\r\n"));
+	std::string resp;
+	char buf[0x10000];
+	for (ssize_t ret; (ret = ::recv(client.fd, buf, sizeof(buf), 0)) > 0; )
+	{
+		resp.append(buf, ret);
+	}
+	done = true;
+	t.awaitCompletion();
+
+	const auto body_offset = resp.find("\r\n\r\n");
+	assert(body_offset != std::string::npos);
+	assert(resp.find("HTTP/1.0 200", body_offset) == std::string::npos);
+	assert(resp.size() - (body_offset + 4) == 8 * 1024 * 1024);
+}
+
+static void test_http_connection_task()
+{
+	enum Mode : uint8_t
+	{
+		PIPELINING,
+		FLOW_CONTROL,
+		CONTINUATION_FLOOD,
+	};
+	static Mode mode;
+	static std::vector<std::string> results;
+	static size_t expected_results;
+	static size_t protocol_error_goaways;
+	static std::atomic_bool done;
+
+	// Plays the server's part of the current mode on a raw socket.
+	struct FakeServer
+	{
+		struct State
+		{
+			std::string buf{};
+			std::vector<std::string> paths{};
+			bool got_preface = false;
+			HpackDecoder decoder{};
+			HpackEncoder encoder{};
+			size_t received = 0;
+			size_t window = 0xFFFF;
+		};
+
+		static void appendFrame(std::string& out, uint8_t type, uint8_t flags, uint32_t stream_id, const std::string& payload)
+		{
+			const uint32_t length = static_cast<uint32_t>(payload.size());
+			const char header[9] = {
+				static_cast<char>(length >> 16), static_cast<char>(length >> 8), static_cast<char>(length),
+				static_cast<char>(type), static_cast<char>(flags),
+				static_cast<char>(stream_id >> 24), static_cast<char>(stream_id >> 16), static_cast<char>(stream_id >> 8), static_cast<char>(stream_id),
+			};
+			out.append(header, sizeof(header));
+			out.append(payload);
+		}
+
+		[[nodiscard]] static uint32_t readU32(const char* p)
+		{
+			return (static_cast<uint32_t>(static_cast<uint8_t>(p[0])) << 24)
+				| (static_cast<uint32_t>(static_cast<uint8_t>(p[1])) << 16)
+				| (static_cast<uint32_t>(static_cast<uint8_t>(p[2])) << 8)
+				| static_cast<uint32_t>(static_cast<uint8_t>(p[3]))
+				;
+		}
+
+		static void respond(Socket& s, State& st, uint32_t stream_id, const std::string& body)
+		{
+			std::string out;
+			appendFrame(out, 0x1, 0x4, stream_id, st.encoder.encode({ { ":status", "200" } })); // HEADERS, END_HEADERS
+			appendFrame(out, 0x0, 0x1, stream_id, body); // DATA, END_STREAM
+			s.send(out);
+		}
+
+		static void onData(Socket& s, std::string&& data, Capture&& cap)
+		{
+			auto& st = cap.get<State>();
+			st.buf.append(data);
+			if (mode == PIPELINING)
+			{
+				for (size_t end; end = st.buf.find("\r\n\r\n"), end != std::string::npos; )
+				{
+					const auto path_begin = st.buf.find(' ') + 1;
+					st.paths.emplace_back(st.buf.substr(path_begin, st.buf.find(' ', path_begin) - path_begin));
+					st.buf.erase(0, end + 4);
+				}
+				// Only answering once all requests are in, which would never happen if they weren't pipelined.
+				if (st.paths.size() == 3)
+				{
+					std::string out;
+					for (const auto& path : st.paths)
+					{
+						out.append("HTTP/1.1 200 OK\r\nContent-Length: ").append(std::to_string(path.size())).append("\r\n\r\n").append(path);
+					}
+					st.paths.clear();
+					s.send(out);
+				}
+			}
+			else
+			{
+				if (!st.got_preface)
+				{
+					if (st.buf.size() < 24)
+					{
+						return s.recv(&onData, std::move(cap));
+					}
+					assert(st.buf.compare(0, 24, "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n") == 0);
+					st.buf.erase(0, 24);
+					st.got_preface = true;
+					std::string out;
+					appendFrame(out, 0x4, 0, 0, {}); // SETTINGS
+					s.send(out);
+				}
+				while (st.buf.size() >= 9)
+				{
+					const uint32_t length = (readU32(st.buf.data()) >> 8);
+					if (st.buf.size() < 9 + length)
+					{
+						break;
+					}
+					const uint8_t type = static_cast<uint8_t>(st.buf[3]);
+					const uint8_t flags = static_cast<uint8_t>(st.buf[4]);
+					const uint32_t stream_id = (readU32(st.buf.data() + 5) & 0x7FFFFFFF);
+					const std::string payload = st.buf.substr(9, length);
+					st.buf.erase(0, 9 + length);
+					assert(length <= 0x4000); // We didn't allow bigger frames.
+					switch (type)
+					{
+					case 0x0: // DATA
+						st.received += length;
+						assert(st.received <= st.window);
+						if (st.received == 0xFFFF)
+						{
+							// The client has to wait for more window before sending the rest.
+							std::string out;
+							char increment[4] = { 0, 0x01, static_cast<char>(0x86), static_cast<char>(0xA0) }; // 100000
+							appendFrame(out, 0x8, 0, 0, std::string(increment, 4));
+							appendFrame(out, 0x8, 0, stream_id, std::string(increment, 4));
+							st.window += 100000;
+							s.send(out);
+						}
+						if (flags & 0x1)
+						{
+							respond(s, st, stream_id, std::to_string(st.received));
+						}
+						break;
+
+					case 0x1: // HEADERS
+						{
+							std::vector<hpack::header_t> headers;
+							assert(flags & 0x4);
+							assert(st.decoder.decode(payload, headers));
+							if (mode == CONTINUATION_FLOOD)
+							{
+								// Never ending the header block.
+								std::string out;
+								appendFrame(out, 0x1, 0, stream_id, std::string(0x4000, 'x'));
+								for (int i = 0; i != 8; ++i)
+								{
+									appendFrame(out, 0x9, 0, stream_id, std::string(0x4000, 'x'));
+								}
+								s.send(out);
+							}
+							else if (flags & 0x1)
+							{
+								for (const auto& h : headers)
+								{
+									if (h.first == ":path")
+									{
+										respond(s, st, stream_id, h.second);
+									}
+								}
+							}
+						}
+						break;
+
+					case 0x4: // SETTINGS
+						if (!(flags & 0x1))
+						{
+							std::string out;
+							appendFrame(out, 0x4, 0x1, 0, {});
+							s.send(out);
+						}
+						break;
+
+					case 0x7: // GOAWAY
+						if (readU32(payload.data() + 4) == 0x1)
+						{
+							++protocol_error_goaways;
+						}
+						break;
+					}
+				}
+			}
+			s.recv(&onData, std::move(cap));
+		}
+	};
+
+	for (Mode m : { PIPELINING, FLOW_CONTROL, CONTINUATION_FLOOD })
+	{
+		mode = m;
+		results.clear();
+		protocol_error_goaways = 0;
+		done = false;
+
+		Server serv;
+		ServerService service([](Socket& s, ServerService&, Server&)
+		{
+			s.recv(&FakeServer::onData, FakeServer::State{});
+		});
+		uint16_t port = 43000;
+		while (!serv.bind(port, &service))
+		{
+			assert(++port != 44000);
+		}
+		serv.add<TestStopServerTask>(done);
+
+		auto conn = serv.add<HttpConnectionTask>(ConnectionPool::Key{ "127.0.0.1", port, false });
+		conn->http2_prior_knowledge = (mode != PIPELINING);
+		auto submit = [&](HttpRequest&& hr)
+		{
+			conn->submit(std::move(hr), [](Optional<HttpResponse>&& resp, Capture&&)
+			{
+				results.emplace_back(resp.has_value() ? resp->body : std::string("<failed>"));
+				if (results.size() == expected_results)
+				{
+					done = true;
+				}
+			});
+		};
+		if (mode == PIPELINING)
+		{
+			expected_results = 3;
+			submit(HttpRequest("127.0.0.1", "/a"));
+			submit(HttpRequest("127.0.0.1", "/b"));
+			submit(HttpRequest("127.0.0.1", "/c"));
+		}
+		else if (mode == FLOW_CONTROL)
+		{
+			expected_results = 2;
+			HttpRequest upload("POST", "127.0.0.1", "/upload");
+			upload.setPayload(std::string(100000, 'x'));
+			submit(std::move(upload));
+			submit(HttpRequest("127.0.0.1", "/x"));
+		}
+		else
+		{
+			expected_results = 1;
+			submit(HttpRequest("127.0.0.1", "/"));
+		}
+		serv.runFor(10'000);
+		assert(done);
+
+		if (mode == PIPELINING)
+		{
+			assert(results == std::vector<std::string>{ "/a", "/b", "/c" });
+		}
+		else if (mode == FLOW_CONTROL)
+		{
+			std::sort(results.begin(), results.end());
+			assert(results == std::vector<std::string>{ "/x", "100000" });
+		}
+		else
+		{
+			// The request is retried once on a new connection, where the server does the same thing again.
+			assert(results == std::vector<std::string>{ "<failed>" });
+			assert(protocol_error_goaways == 2);
+		}
+	}
+}
+#endif
+
+static void test_tls_session_cache()
+{
+	TlsSessionCache cache;
+	cache.max_entries = 2;
+	auto make_session = [](const char* master_secret)
+	{
+		TlsSession session;
+		session.master_secret = master_secret;
+		session.cipher_suite = TLS_RSA_WITH_AES_256_CBC_SHA256;
+		session.extended_master_secret = true;
+		session.created = time::unixSeconds();
+		return session;
+	};
+
+	cache.store("a", make_session("1"));
+	cache.store("b", make_session("2"));
+	assert(cache.find("a").has_value()); // Makes 'b' the least recently used entry.
+	cache.store("c", make_session("3"));
+	assert(cache.size() == 2);
+	assert(!cache.find("b").has_value());
+	assert(cache.find("a")->master_secret == "1");
+	assert(cache.find("c")->master_secret == "3");
+
+	auto expired = make_session("4");
+	expired.created -= cache.lifetime + 1;
+	cache.store("d", std::move(expired));
+	assert(!cache.find("d").has_value());
+	assert(cache.size() == 1);
+
+	auto ticket = cache.sealTicket(make_session("secret"));
+	auto session = cache.openTicket(ticket);
+	assert(session.has_value());
+	assert(session->master_secret == "secret");
+	assert(session->cipher_suite == TLS_RSA_WITH_AES_256_CBC_SHA256);
+	assert(session->extended_master_secret);
+	assert(session->server_name.empty());
+
+	auto named = make_session("secret");
+	named.server_name = "example.com";
+	assert(cache.openTicket(cache.sealTicket(named))->server_name == "example.com"); // So resumption can be refused for other names.
+
+	ticket[ticket.size() / 2] ^= 1;
+	assert(!cache.openTicket(ticket).has_value());
+	assert(!TlsSessionCache().openTicket(cache.sealTicket(make_session("secret"))).has_value()); // Different ticket key
+}
+
 static void test_SocketAddr_fromString()
 {
 	{
@@ -1677,6 +3479,347 @@ static void test_SocketAddr_fromString()
 	}
 }
 
+static void test_netintel_snapshot()
+{
+	netIntel intel;
+	auto as1 = intel.aslist.emplace(13335, soup::make_unique<netAs>(13335, intel.as_pool.emplace("CLOUDFLARENET"))).first->second.get();
+	auto as2 = intel.aslist.emplace(3320, soup::make_unique<netAs>(3320, intel.as_pool.emplace("DTAG"))).first->second.get();
+	intel.aslist.emplace(64512, soup::make_unique<netAs>(64512, nullptr)); // Stored as NO_STRING
+	intel.ipv4toas.emplace(SOUP_IPV4(1, 1, 1, 0), SOUP_IPV4(1, 1, 1, 255), as1);
+	intel.ipv4toas.emplace(SOUP_IPV4(80, 128, 0, 0), SOUP_IPV4(80, 159, 255, 255), as2);
+	IpAddr v6lower, v6upper;
+	assert(v6lower.fromString("2606:4700::"));
+	assert(v6upper.fromString("2606:4700:ffff:ffff:ffff:ffff:ffff:ffff"));
+	intel.ipv6toas.emplace(v6lower, v6upper, as1);
+	intel.ipv4tolocation.emplace(SOUP_IPV4(80, 128, 0, 0), SOUP_IPV4(80, 159, 255, 255), netIntelLocationData{ "DE", intel.location_pool.emplace("Hesse"), intel.location_pool.emplace("Frankfurt am Main") });
+	intel.ipv6tolocation.emplace(v6lower, v6upper, netIntelLocationData{ "US", intel.location_pool.emplace("California"), intel.location_pool.emplace("San Francisco") });
+	intel.extra_wasm = std::string("\0asm", 4);
+
+	const auto path = filesystem::tempfile();
+	intel.saveSnapshot(path);
+	{
+		netIntelSnapshot snapshot(path);
+		assert(snapshot.getNumAs() == 3);
+		assert(snapshot.getAsByNumber(64512)->handle == std::string());
+		assert(snapshot.getAsByNumber(64512)->name == std::string());
+		assert(snapshot.getAsByNumber(3320).has_value());
+		assert(snapshot.getAsByNumber(3320)->name == std::string("DTAG"));
+		assert(!snapshot.getAsByNumber(3321).has_value());
+		assert(snapshot.getAsByIp(IpAddr(SOUP_IPV4(1, 1, 1, 1)))->number == 13335);
+		assert(snapshot.getAsByIp(IpAddr(SOUP_IPV4(80, 130, 1, 2)))->number == 3320);
+		assert(!snapshot.getAsByIp(IpAddr(SOUP_IPV4(1, 1, 2, 0))).has_value());
+		IpAddr v6;
+		assert(v6.fromString("2606:4700::1111"));
+		assert(snapshot.getAsByIp(v6)->handle == std::string("CLOUDFLARENET"));
+		assert(snapshot.getLocationByIp(v6)->city == std::string("San Francisco"));
+		auto loc = snapshot.getLocationByIp(IpAddr(SOUP_IPV4(80, 159, 255, 255)));
+		assert(loc.has_value());
+		assert(loc->country_code.c_str() == std::string("DE"));
+		assert(loc->state == std::string("Hesse"));
+		assert(!snapshot.getLocationByIp(IpAddr(SOUP_IPV4(1, 1, 1, 1))).has_value());
+		assert(snapshot.getExtraWasm() == std::string_view("\0asm", 4));
+	}
+
+	// A string offset past the string section and an AS index past the AS section are caught by lookups.
+	{
+		std::string data = string::fromFile(path);
+		netIntelSnapshot::Header header;
+		memcpy(&header, data.data(), sizeof(header));
+		netIntelSnapshot::AsRecord rec;
+		memcpy(&rec, &data[header.sections[netIntelSnapshot::AS].offset], sizeof(rec));
+		rec.name = static_cast<uint32_t>(header.sections[netIntelSnapshot::STRINGS].count);
+		memcpy(&data[header.sections[netIntelSnapshot::AS].offset], &rec, sizeof(rec));
+		netIntelSnapshot::Ipv4AsRecord v4rec;
+		memcpy(&v4rec, &data[header.sections[netIntelSnapshot::IPV4_AS].offset], sizeof(v4rec));
+		v4rec.as = static_cast<uint32_t>(header.sections[netIntelSnapshot::AS].count);
+		memcpy(&data[header.sections[netIntelSnapshot::IPV4_AS].offset], &v4rec, sizeof(v4rec));
+		string::toFile(path, data);
+
+		netIntelSnapshot snapshot(path);
+		assert(snapshot.getAsByNumber(rec.number).has_value());
+		assert(snapshot.getAsByNumber(rec.number)->name == std::string());
+		assert(!snapshot.getAsByIp(IpAddr(SOUP_IPV4(1, 1, 1, 1))).has_value()); // The first IPv4 range
+		assert(snapshot.getAsByIp(IpAddr(SOUP_IPV4(80, 130, 1, 2)))->number == 3320);
+	}
+
+#if SOUP_EXCEPTIONS
+	auto throws = [&path]
+	{
+		SOUP_TRY
+		{
+			netIntelSnapshot snapshot(path);
+		}
+		SOUP_CATCH_ANY
+		{
+			return true;
+		}
+		return false;
+	};
+
+	string::toFile(path, "not a snapshot, just some text that is long enough to hold a header");
+	assert(throws());
+#endif
+	std::filesystem::remove(path);
+}
+
+static void unit_task()
+{
+	test("Scheduler deadlines", []
+	{
+		struct IdleTask : public Task
+		{
+			void onTick() final
+			{
+			}
+		};
+
+		static std::string order;
+		order.clear();
+
+		Scheduler sched;
+		auto a = sched.add<IdleTask>();
+		auto b = sched.add<IdleTask>();
+		auto c = sched.add<IdleTask>();
+		sched.armDeadline(*a, 30, [](Worker& w, Scheduler&)
+		{
+			order.push_back('a');
+			w.setWorkDone();
+		});
+		sched.armDeadline(*b, 10, [](Worker& w, Scheduler&)
+		{
+			order.push_back('b');
+			w.setWorkDone();
+		});
+		sched.armDeadline(*c, 20, [](Worker& w, Scheduler&)
+		{
+			order.push_back('c');
+			w.setWorkDone();
+		});
+		sched.cancelDeadline(*c);
+		assert(!Scheduler::hasDeadline(*c));
+		c->setWorkDone();
+		sched.run();
+		assert(order == "ba");
+	});
+#if SOUP_LINUX
+	test("Scheduler with epoll", []
+	{
+		static std::string received;
+		received.clear();
+
+		int fds[2];
+		assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		Scheduler sched;
+		assert(sched.useEpoll());
+		auto a = soup::make_shared<Socket>();
+		auto b = soup::make_shared<Socket>();
+		a->fd = fds[0];
+		b->fd = fds[1];
+		a->setNonBlocking();
+		b->setNonBlocking();
+		sched.addSocket(a);
+		sched.addSocket(b);
+
+		// The reply is too big for the kernel's send buffer, so it has to be flushed as the socket becomes writable.
+		a->recv([](Socket& s, std::string&& data, Capture&&)
+		{
+			assert(data == "ping");
+			s.send(std::string(4 * 1024 * 1024, 'x'));
+		});
+		struct Receiver
+		{
+			static void onRecv(Socket& s, std::string&& data, Capture&&)
+			{
+				received.append(data);
+				if (received.size() == 4 * 1024 * 1024)
+				{
+					s.close();
+					return;
+				}
+				s.recv(&onRecv);
+			}
+		};
+		b->recv(&Receiver::onRecv);
+		b->send("ping");
+		sched.run();
+		assert(received == std::string(4 * 1024 * 1024, 'x'));
+	});
+	test("Scheduler with epoll wakes parked sockets", []
+	{
+		static std::string received;
+		received.clear();
+
+		int fds[2];
+		assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		Scheduler sched;
+		assert(sched.useEpoll());
+		auto a = soup::make_shared<Socket>();
+		auto b = soup::make_shared<Socket>();
+		a->fd = fds[0];
+		b->fd = fds[1];
+		a->setNonBlocking();
+		b->setNonBlocking();
+		sched.addSocket(a);
+		sched.addSocket(b);
+
+		struct Receiver
+		{
+			static void onRecv(Socket& s, std::string&& data, Capture&&)
+			{
+				received.append(data);
+				if (received.size() == 4 * 1024 * 1024)
+				{
+					s.close();
+					return;
+				}
+				s.recv(&onRecv);
+			}
+		};
+		a->recv(&Receiver::onRecv);
+		b->recv([](Socket&, std::string&&, Capture&&)
+		{
+		});
+
+		// Both sockets are parked by the time the task sends, so b has to be woken up to flush what doesn't fit into the kernel's send buffer.
+		struct SendTask : public Task
+		{
+			SharedPtr<Socket> s;
+			int ticks = 0;
+
+			SendTask(SharedPtr<Socket> s)
+				: s(std::move(s))
+			{
+			}
+
+			void onTick() final
+			{
+				if (++ticks == 3)
+				{
+					s->send(std::string(4 * 1024 * 1024, 'x'));
+					setWorkDone();
+				}
+			}
+		};
+		sched.add<SendTask>(b);
+		sched.run();
+		assert(received == std::string(4 * 1024 * 1024, 'x'));
+	});
+	test("Scheduler linger", []
+	{
+		int fds[2];
+		assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		Scheduler sched;
+		sched.linger_timeout_ms = 100;
+		auto a = soup::make_shared<Socket>();
+		Socket b;
+		a->fd = fds[0];
+		b.fd = fds[1];
+		a->setNonBlocking();
+		sched.addSocket(a);
+
+		// b never reads, so this stays queued.
+		a->send(std::string(4 * 1024 * 1024, 'x'));
+		assert(a->hasPendingSend());
+		a->close();
+		sched.tick();
+		assert(a->lingering);
+		assert(Scheduler::hasDeadline(*a));
+
+		// The socket gets work again and that replaces the deadline, like ServerWebService::httpRecv would.
+		a->recv([](Socket&, std::string&&, Capture&&)
+		{
+		});
+		sched.tick();
+		assert(!a->lingering);
+		assert(!Scheduler::hasDeadline(*a));
+		sched.armDeadline(*a, 10'000, [](Worker&, Scheduler&)
+		{
+		});
+		sched.tick();
+		sched.cancelDeadline(*a);
+
+		// Once the work is done again, it has to linger with a deadline again.
+		a->setWorkDone();
+		sched.runFor(2000);
+		assert(!a->hasConnection());
+		assert(sched.getNumWorkers() == 0);
+	});
+	test("Scheduler add worker wakeup", []
+	{
+		for (bool epoll : { false, true })
+		{
+			static std::atomic<time_t> started_at;
+			started_at = 0;
+
+			int fds[2];
+			assert(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+			Scheduler sched;
+			if (epoll)
+			{
+				assert(sched.useEpoll());
+			}
+			assert(sched.enableAddWorkerWakeup());
+			auto a = soup::make_shared<Socket>();
+			Socket b;
+			a->fd = fds[0];
+			b.fd = fds[1];
+			a->setNonBlocking();
+			a->recv([](Socket&, std::string&&, Capture&&)
+			{
+			});
+			sched.addSocket(a);
+
+			Thread t([](Capture&& cap)
+			{
+				cap.get<Scheduler*>()->run();
+			}, &sched);
+			os::sleep(100); // Let the scheduler start waiting for socket activity.
+
+			// Without the wakeup, the task would only be started once the 50ms poll timeout is over.
+			struct StartTask : public Task
+			{
+				void onTick() final
+				{
+					started_at = time::millis();
+					setWorkDone();
+				}
+			};
+			time_t max_latency = 0;
+			for (int i = 0; i != 5; ++i)
+			{
+				started_at = 0;
+				const auto added_at = time::millis();
+				sched.add<StartTask>();
+				while (started_at == 0)
+				{
+					os::sleep(1);
+				}
+				max_latency = std::max(max_latency, started_at - added_at);
+			}
+
+			struct CloseTask : public Task
+			{
+				SharedPtr<Socket> s;
+
+				CloseTask(SharedPtr<Socket> s)
+					: s(std::move(s))
+				{
+				}
+
+				void onTick() final
+				{
+					s->close();
+					setWorkDone();
+				}
+			};
+			sched.add<CloseTask>(a);
+			t.awaitCompletion();
+			assert(max_latency < 25);
+		}
+	});
+#endif
+}
+
 static void unit_util_string()
 {
 	test("equalsIgnoreCase", []
@@ -1765,6 +3908,15 @@ static void unit_util_time()
 		assert(Datetime::fromIso8601("2024-04-25T00:00:00Z").value().toTimestamp() == 1714003200);
 		assert(Datetime::fromIso8601("2023-08-10T03:00:00.000Z").value().toTimestamp() == 1691636400);
 	});
+
+	test("RFC 2822", []
+	{
+		assert(Datetime::fromRfc2822("Thu, 25 Apr 2024 00:00:00 GMT").value().toTimestamp() == 1714003200);
+		assert(Datetime::fromRfc2822("Thu, 10 Aug 2023 03:00:00 GMT").value().toTimestamp() == 1691636400);
+		assert(Datetime::fromRfc2822(time::toRfc2822(1691636400).c_str()).value().toTimestamp() == 1691636400);
+		assert(!Datetime::fromRfc2822("Thu, 10 Aug 2023 03:00:00").has_value());
+		assert(!Datetime::fromRfc2822("Thursday, August 10, 2023").has_value());
+	});
 }
 
 static void unit_util()
@@ -1779,6 +3931,54 @@ static void unit_util()
 		assert(version_compare("0.1", "0") > 0);
 		assert(version_compare("1.0", "1.0-dev") > 0);
 	});
+	test("RangeMap", []
+	{
+		{
+			RangeMap<uint32_t, uint32_t> map;
+			for (uint32_t i = 1000; i-- != 0; )
+			{
+				map.emplace(i * 7, i * 7 + 3, i);
+			}
+			map.sort();
+			assert(map.isFrozen());
+			std::vector<uint32_t> keys;
+			for (uint32_t k = 0; k != 7010; ++k)
+			{
+				keys.emplace_back(k);
+			}
+			std::vector<uint32_t*> results(keys.size());
+			map.findMany(keys.data(), results.data(), keys.size());
+			for (uint32_t k = 0; k != 7010; ++k)
+			{
+				auto e = map.find(k);
+				assert(e == results[k]);
+				if (k < 7000 && (k % 7) <= 3)
+				{
+					assert(e != nullptr && *e == k / 7);
+				}
+				else
+				{
+					assert(e == nullptr);
+				}
+			}
+
+			map.emplace(7000, 7000, 1000);
+			assert(!map.isFrozen());
+			assert(map.find(6999) == nullptr);
+			assert(*map.find(6995) == 999);
+		}
+		{
+			RangeMap<IpAddr, int> map;
+			for (int i = 0; i != 250; ++i)
+			{
+				map.emplace(IpAddr(0x20, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, (uint8_t)i, 0x00), IpAddr(0x20, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, (uint8_t)i, 0x7f), i);
+			}
+			map.freeze();
+			assert(*map.find(IpAddr(0x20, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 200, 0x7f)) == 200);
+			assert(map.find(IpAddr(0x20, 0x01, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 200, 0x80)) == nullptr);
+			assert(map.find(IpAddr(0x20, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0)) == nullptr);
+		}
+	});
 }
 
 static void unit_vis()
@@ -1845,9 +4045,29 @@ void cli_test()
 			unit("web")
 			{
 				test("uri", &test_uri);
+				test("request parser", &test_web_request_parser);
+				test("response parser", &test_web_response_parser);
+				test("hpack", &test_web_hpack);
+				test("range", &test_web_range);
 			}
+			test("dns cache", &test_dns_cache);
 			test("socket raii semantics", &test_socket_raii_semantics);
+#if SOUP_POSIX
+			test("socket send queue", &test_socket_send_queue);
+			test("connection pool", &test_connection_pool);
+			test("http request task pool", &test_http_request_task_pool);
+			test("server cluster", &test_server_cluster);
+			test("web send file", &test_web_send_file);
+			test("web close with queued data", &test_web_close_with_queued_data);
+			test("http connection task", &test_http_connection_task);
+#endif
 			test("SocketAddr::fromString", &test_SocketAddr_fromString);
+			test("tls session cache", &test_tls_session_cache);
+			test("netIntel snapshot", &test_netintel_snapshot);
+		}
+		unit("task")
+		{
+			unit_task();
 		}
 		unit("util")
 		{
@@ -17,7 +17,10 @@ NAMESPACE_SOUP
 
 		~AllocRaiiVirtual()
 		{
-			memGuard::free(addr, size);
+			if (addr != nullptr)
+			{
+				memGuard::free(addr, size);
+			}
 		}
 	};
 }
@@ -8,6 +8,11 @@ NAMESPACE_SOUP
 	{
 		Benchmark::State state;
 		bm(state);
-		std::cout << name << ": " << ((float)state.its / num_millis) << " iterations/ms\n";
+		std::cout << name << ": " << ((float)state.its / num_millis) << " iterations/ms";
+		if (state.bytes_per_it != 0)
+		{
+			std::cout << " (" << ((double)state.its * state.bytes_per_it / num_millis / 1'000'000) << " GB/s)";
+		}
+		std::cout << "\n";
 	}
 }
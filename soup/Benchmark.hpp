@@ -13,6 +13,7 @@ NAMESPACE_SOUP
 		{
 			size_t its = 0;
 			time_t deadline = 0;
+			size_t bytes_per_it = 0; // If set, the throughput is reported as well.
 
 			[[nodiscard]] SOUP_FORCEINLINE bool canContinue() noexcept
 			{
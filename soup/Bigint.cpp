@@ -1,11 +1,16 @@
 #include "Bigint.hpp"
 
+#include <algorithm> // max, min
+#include <cstring> // memcpy, memset
+#include <vector>
+
 #include "Bitset.hpp"
 #include "bitutil.hpp"
 #include "branchless.hpp"
 #include "CpuInfo.hpp"
 #include "Endian.hpp"
 #include "Exception.hpp"
+#include "MontgomeryContext.hpp"
 #include "ObfusString.hpp"
 #include "rand.hpp"
 #include "RngInterface.hpp"
@@ -1226,15 +1231,534 @@ NAMESPACE_SOUP
 		return pre;
 	}
 
+	// Multiplication kernels on little-endian chunk arrays. The recursive ones take their temporaries from a caller-provided scratch buffer instead of allocating.
+
+	static constexpr size_t BIGINT_KARATSUBA_THRESHOLD = 32; // in chunks
+	static constexpr size_t BIGINT_TOOM3_THRESHOLD = 150;
+	static constexpr size_t BIGINT_NTT_THRESHOLD = 0x2800;
+
+	// res = a + b, where an >= bn. res may alias a. Returns the carry.
+	[[nodiscard]] static chunk_t bigint_add(chunk_t* res, const chunk_t* a, size_t an, const chunk_t* b, size_t bn) noexcept
+	{
+		chunk_t carry = 0;
+		size_t i = 0;
+		for (; i != bn; ++i)
+		{
+			const size_t sum = (size_t)a[i] + b[i] + carry;
+			res[i] = (chunk_t)sum;
+			carry = Bigint::getCarry(sum);
+		}
+		for (; i != an; ++i)
+		{
+			const size_t sum = (size_t)a[i] + carry;
+			res[i] = (chunk_t)sum;
+			carry = Bigint::getCarry(sum);
+		}
+		return carry;
+	}
+
+	// res += b, where rn >= bn. Returns the carry out of res[rn - 1].
+	static chunk_t bigint_addTo(chunk_t* res, size_t rn, const chunk_t* b, size_t bn) noexcept
+	{
+		chunk_t carry = 0;
+		size_t i = 0;
+		for (; i != bn; ++i)
+		{
+			const size_t sum = (size_t)res[i] + b[i] + carry;
+			res[i] = (chunk_t)sum;
+			carry = Bigint::getCarry(sum);
+		}
+		for (; carry != 0 && i != rn; ++i)
+		{
+			carry = (++res[i] == 0);
+		}
+		return carry;
+	}
+
+	// res -= b, where rn >= bn. Returns the borrow out of res[rn - 1].
+	static chunk_t bigint_subFrom(chunk_t* res, size_t rn, const chunk_t* b, size_t bn) noexcept
+	{
+		chunk_t borrow = 0;
+		size_t i = 0;
+		for (; i != bn; ++i)
+		{
+			const size_t diff = (size_t)res[i] - b[i] - borrow;
+			res[i] = (chunk_t)diff;
+			borrow = (Bigint::getCarry(diff) != 0);
+		}
+		for (; borrow != 0 && i != rn; ++i)
+		{
+			borrow = (res[i]-- == 0);
+		}
+		return borrow;
+	}
+
+	// Two's complement helpers for Toom-3's interpolation, where intermediates may be negative.
+
+	static void bigint_tcNegate(chunk_t* x, size_t n) noexcept
+	{
+		chunk_t carry = 1;
+		for (size_t i = 0; i != n; ++i)
+		{
+			const size_t sum = (size_t)(chunk_t)~x[i] + carry;
+			x[i] = (chunk_t)sum;
+			carry = Bigint::getCarry(sum);
+		}
+	}
+
+	[[nodiscard]] static bool bigint_tcIsNegative(const chunk_t* x, size_t n) noexcept
+	{
+		return (x[n - 1] >> (Bigint::getBitsPerChunk() - 1)) != 0;
+	}
+
+	static void bigint_tcShiftRightOne(chunk_t* x, size_t n) noexcept
+	{
+		for (size_t i = 0; i != n - 1; ++i)
+		{
+			x[i] = (x[i] >> 1) | (chunk_t)(x[i + 1] << (Bigint::getBitsPerChunk() - 1));
+		}
+		x[n - 1] = (chunk_t)((chunk_signed_t)x[n - 1] >> 1);
+	}
+
+	// x /= 3, assuming x is a multiple of 3. This is 2-adic division, so it also works for negative numbers.
+	static void bigint_tcDivideExact3(chunk_t* x, size_t n) noexcept
+	{
+		constexpr chunk_t inv3 = (chunk_t)(((chunk_t)~(chunk_t)0 / 3) * 2 + 1);
+		chunk_t borrow = 0;
+		for (size_t i = 0; i != n; ++i)
+		{
+			const chunk_t s = x[i];
+			const chunk_t l = (chunk_t)(s - borrow);
+			borrow = (l > s);
+			const chunk_t q = (chunk_t)(l * inv3);
+			x[i] = q;
+			borrow += Bigint::getCarry((size_t)q * 3);
+		}
+	}
+
+	static void bigint_mul(chunk_t* res, const chunk_t* a, size_t an, const chunk_t* b, size_t bn, chunk_t* scratch) noexcept;
+
+	static void bigint_mulSchoolbook(chunk_t* res, const chunk_t* a, size_t an, const chunk_t* b, size_t bn) noexcept
+	{
+		memset(res, 0, (an + bn) * sizeof(chunk_t));
+		for (size_t j = 0; j != bn; ++j)
+		{
+			const size_t y = b[j];
+			chunk_t carry = 0;
+			for (size_t i = 0; i != an; ++i)
+			{
+				const size_t prod = (size_t)a[i] * y + res[i + j] + carry;
+				res[i + j] = (chunk_t)prod;
+				carry = Bigint::getCarry(prod);
+			}
+			res[j + an] = carry;
+		}
+	}
+
+	static void bigint_mulKaratsuba(chunk_t* res, const chunk_t* a, const chunk_t* b, size_t n, chunk_t* scratch) noexcept
+	{
+		const size_t h = n / 2;
+		const size_t k = n - h;
+		chunk_t* const sa = scratch;
+		chunk_t* const sb = sa + (k + 1);
+		chunk_t* const z1 = sb + (k + 1);
+		chunk_t* const next = z1 + (2 * k + 2);
+
+		bigint_mul(res, a, h, b, h, next);
+		bigint_mul(res + 2 * h, a + h, k, b + h, k, next);
+
+		sa[k] = bigint_add(sa, a + h, k, a, h);
+		sb[k] = bigint_add(sb, b + h, k, b, h);
+		bigint_mul(z1, sa, k + 1, sb, k + 1, next);
+		bigint_subFrom(z1, 2 * k + 2, res, 2 * h);
+		bigint_subFrom(z1, 2 * k + 2, res + 2 * h, 2 * k);
+
+		bigint_addTo(res + h, 2 * n - h, z1, std::min(2 * k + 2, 2 * n - h));
+	}
+
+	// Evaluates a0 + a1*x + a2*x^2 at x = 1, -1 & -2, as two's complement numbers of k + 2 chunks.
+	static void bigint_toom3Evaluate(chunk_t* p1, chunk_t* pm1, chunk_t* pm2, const chunk_t* a, size_t k, size_t r) noexcept
+	{
+		const size_t e = k + 2;
+		const chunk_t* const a0 = a;
+		const chunk_t* const a1 = a + k;
+		const chunk_t* const a2 = a + 2 * k;
+
+		// pm1 = a0 + a2
+		memcpy(pm1, a0, k * sizeof(chunk_t));
+		pm1[k] = 0;
+		pm1[k + 1] = 0;
+		bigint_addTo(pm1, e, a2, r);
+
+		// p1 = (a0 + a2) + a1
+		memcpy(p1, pm1, e * sizeof(chunk_t));
+		bigint_addTo(p1, e, a1, k);
+
+		// pm1 = (a0 + a2) - a1
+		bigint_subFrom(pm1, e, a1, k);
+
+		// pm2 = ((pm1 + a2) * 2) - a0
+		memcpy(pm2, pm1, e * sizeof(chunk_t));
+		bigint_addTo(pm2, e, a2, r);
+		bigint_addTo(pm2, e, pm2, e);
+		bigint_subFrom(pm2, e, a0, k);
+	}
+
+	// Turns a two's complement number into its magnitude, returning true if it was negative.
+	static bool bigint_tcAbs(chunk_t* x, size_t n) noexcept
+	{
+		if (bigint_tcIsNegative(x, n))
+		{
+			bigint_tcNegate(x, n);
+			return true;
+		}
+		return false;
+	}
+
+	// Toom-Cook 3-way with evaluation points 0, 1, -1, -2 & infinity, and Bodrato's interpolation sequence.
+	static void bigint_mulToom3(chunk_t* res, const chunk_t* a, const chunk_t* b, size_t n, chunk_t* scratch) noexcept
+	{
+		const size_t k = (n + 2) / 3;
+		const size_t r = n - 2 * k;
+		const size_t e = k + 2;
+		const size_t w = 2 * k + 2;
+
+		chunk_t* const a1 = scratch;
+		chunk_t* const am1 = a1 + e;
+		chunk_t* const am2 = am1 + e;
+		chunk_t* const b1 = am2 + e;
+		chunk_t* const bm1 = b1 + e;
+		chunk_t* const bm2 = bm1 + e;
+		chunk_t* const v1 = bm2 + e;
+		chunk_t* const vm1 = v1 + w;
+		chunk_t* const vm2 = vm1 + w;
+		chunk_t* const next = vm2 + w;
+
+		bigint_toom3Evaluate(a1, am1, am2, a, k, r);
+		bigint_toom3Evaluate(b1, bm1, bm2, b, k, r);
+
+		// All evaluations are less than 5 * 2^(k chunks) in magnitude, so k + 1 chunks suffice for the products.
+		bigint_mul(v1, a1, k + 1, b1, k + 1, next);
+		const bool vm1_negative = (bigint_tcAbs(am1, e) ^ bigint_tcAbs(bm1, e));
+		bigint_mul(vm1, am1, k + 1, bm1, k + 1, next);
+		if (vm1_negative)
+		{
+			bigint_tcNegate(vm1, w);
+		}
+		const bool vm2_negative = (bigint_tcAbs(am2, e) ^ bigint_tcAbs(bm2, e));
+		bigint_mul(vm2, am2, k + 1, bm2, k + 1, next);
+		if (vm2_negative)
+		{
+			bigint_tcNegate(vm2, w);
+		}
+
+		// v0 & vinf go straight to where they belong in the result.
+		const chunk_t* const v0 = res;
+		const chunk_t* const vinf = res + 4 * k;
+		bigint_mul(res, a, k, b, k, next);
+		memset(res + 2 * k, 0, 2 * k * sizeof(chunk_t));
+		bigint_mul(res + 4 * k, a + 2 * k, r, b + 2 * k, r, next);
+
+		// r3 = (vm2 - v1) / 3
+		bigint_subFrom(vm2, w, v1, w);
+		bigint_tcDivideExact3(vm2, w);
+		// r1 = (v1 - vm1) / 2
+		bigint_subFrom(v1, w, vm1, w);
+		bigint_tcShiftRightOne(v1, w);
+		// r2 = vm1 - v0
+		bigint_subFrom(vm1, w, v0, 2 * k);
+		// r3 = (r2 - r3) / 2 + 2 * vinf
+		bigint_tcNegate(vm2, w);
+		bigint_addTo(vm2, w, vm1, w);
+		bigint_tcShiftRightOne(vm2, w);
+		bigint_addTo(vm2, w, vinf, 2 * r);
+		bigint_addTo(vm2, w, vinf, 2 * r);
+		// r2 = r2 + r1 - vinf
+		bigint_addTo(vm1, w, v1, w);
+		bigint_subFrom(vm1, w, vinf, 2 * r);
+		// r1 = r1 - r3
+		bigint_subFrom(v1, w, vm2, w);
+
+		// r1, r2 & r3 are non-negative now. Their high chunks beyond the result's size are zero.
+		bigint_addTo(res + k, 2 * n - k, v1, std::min(w, 2 * n - k));
+		bigint_addTo(res + 2 * k, 2 * n - 2 * k, vm1, std::min(w, 2 * n - 2 * k));
+		bigint_addTo(res + 3 * k, 2 * n - 3 * k, vm2, std::min(w, 2 * n - 3 * k));
+	}
+
+	// res = a * b, where res has an + bn chunks. Must be given at least bigint_mulScratchSize(an, bn) chunks of scratch space.
+	static void bigint_mul(chunk_t* res, const chunk_t* a, size_t an, const chunk_t* b, size_t bn, chunk_t* scratch) noexcept
+	{
+		if (an < bn)
+		{
+			std::swap(a, b);
+			std::swap(an, bn);
+		}
+		if (bn < BIGINT_KARATSUBA_THRESHOLD)
+		{
+			bigint_mulSchoolbook(res, a, an, b, bn);
+		}
+		else if (an != bn)
+		{
+			// Multiply bn-sized slices of a by b.
+			chunk_t* const tmp = scratch;
+			memset(res, 0, (an + bn) * sizeof(chunk_t));
+			for (size_t off = 0; off < an; off += bn)
+			{
+				const size_t len = std::min(bn, an - off);
+				bigint_mul(tmp, a + off, len, b, bn, tmp + 2 * bn);
+				bigint_addTo(res + off, an + bn - off, tmp, len + bn);
+			}
+		}
+		else if (an < BIGINT_TOOM3_THRESHOLD)
+		{
+			bigint_mulKaratsuba(res, a, b, an, scratch);
+		}
+		else
+		{
+			bigint_mulToom3(res, a, b, an, scratch);
+		}
+	}
+
+	// Mirrors the recursion of bigint_mul.
+	[[nodiscard]] static size_t bigint_mulScratchSize(size_t an, size_t bn) noexcept
+	{
+		if (an < bn)
+		{
+			std::swap(an, bn);
+		}
+		if (bn < BIGINT_KARATSUBA_THRESHOLD)
+		{
+			return 0;
+		}
+		if (an != bn)
+		{
+			size_t sub = bigint_mulScratchSize(bn, bn);
+			if (const size_t last = an % bn; last != 0)
+			{
+				sub = std::max(sub, bigint_mulScratchSize(last, bn));
+			}
+			return 2 * bn + sub;
+		}
+		if (an < BIGINT_TOOM3_THRESHOLD)
+		{
+			const size_t h = an / 2;
+			const size_t k = an - h;
+			return (4 * k + 4) + std::max({ bigint_mulScratchSize(h, h), bigint_mulScratchSize(k, k), bigint_mulScratchSize(k + 1, k + 1) });
+		}
+		const size_t k = (an + 2) / 3;
+		const size_t r = an - 2 * k;
+		return (6 * (k + 2) + 3 * (2 * k + 2)) + std::max({ bigint_mulScratchSize(k + 1, k + 1), bigint_mulScratchSize(k, k), bigint_mulScratchSize(r, r) });
+	}
+
+	// Number-theoretic transform over two ~30-bit primes, reconstructed with the CRT. Operands are split into 16-bit digits, so each
+	// convolution term is below 2^32 times the length, which stays below the product of the primes for all supported lengths.
+	struct BigintNttPrime
+	{
+		uint32_t p;
+		uint32_t p_inv_neg; // -p^-1 mod 2^32
+		uint32_t r2; // 2^64 mod p
+		uint32_t g; // primitive root
+		uint8_t max_log2;
+
+		[[nodiscard]] uint32_t reduce(uint64_t t) const noexcept // t * 2^-32 mod p, for t < p * 2^32
+		{
+			const uint32_t m = (uint32_t)t * p_inv_neg;
+			const uint32_t u = (uint32_t)((t + (uint64_t)m * p) >> 32);
+			return u >= p ? u - p : u;
+		}
+
+		[[nodiscard]] uint32_t toMont(uint32_t x) const noexcept
+		{
+			return reduce((uint64_t)x * r2);
+		}
+
+		[[nodiscard]] uint32_t mulMont(uint32_t x, uint32_t y_mont) const noexcept // x * y mod p
+		{
+			return reduce((uint64_t)x * y_mont);
+		}
+
+		[[nodiscard]] uint32_t pow(uint32_t base, uint64_t e) const noexcept
+		{
+			uint64_t res = 1;
+			uint64_t b = base;
+			for (; e != 0; e >>= 1)
+			{
+				if (e & 1)
+				{
+					res = (res * b) % p;
+				}
+				b = (b * b) % p;
+			}
+			return (uint32_t)res;
+		}
+
+		// Fills roots[len + j] with w^j in Montgomery form for each stage's half-length len, where w is a (2 * len)th root of unity.
+		void buildRoots(uint32_t* roots, size_t n, uint32_t w_n) const noexcept
+		{
+			const uint32_t w_mont = toMont(w_n);
+			uint32_t x = toMont(1);
+			for (size_t j = 0; j != n / 2; ++j)
+			{
+				roots[n / 2 + j] = x;
+				x = reduce((uint64_t)x * w_mont);
+			}
+			for (size_t len = n / 4; len != 0; len >>= 1)
+			{
+				for (size_t j = 0; j != len; ++j)
+				{
+					roots[len + j] = roots[2 * len + 2 * j];
+				}
+			}
+		}
+
+		// Gentleman-Sande; leaves the result in bit-reversed order.
+		void forward(uint32_t* a, size_t n, const uint32_t* roots) const noexcept
+		{
+			for (size_t len = n / 2; len != 0; len >>= 1)
+			{
+				for (size_t i = 0; i != n; i += 2 * len)
+				{
+					for (size_t j = 0; j != len; ++j)
+					{
+						const uint32_t u = a[i + j];
+						const uint32_t v = a[i + j + len];
+						const uint32_t sum = u + v;
+						a[i + j] = (sum >= p ? sum - p : sum);
+						a[i + j + len] = mulMont(u + p - v, roots[len + j]);
+					}
+				}
+			}
+		}
+
+		// Cooley-Tukey; takes bit-reversed input, as produced by forward.
+		void inverse(uint32_t* a, size_t n, const uint32_t* inv_roots) const noexcept
+		{
+			for (size_t len = 1; len != n; len <<= 1)
+			{
+				for (size_t i = 0; i != n; i += 2 * len)
+				{
+					for (size_t j = 0; j != len; ++j)
+					{
+						const uint32_t u = a[i + j];
+						const uint32_t v = mulMont(a[i + j + len], inv_roots[len + j]);
+						const uint32_t sum = u + v;
+						a[i + j] = (sum >= p ? sum - p : sum);
+						a[i + j + len] = (u >= v ? u - v : u + p - v);
+					}
+				}
+			}
+		}
+
+		void convolve(std::vector<uint32_t>& fa, std::vector<uint32_t>& fb) const SOUP_EXCAL
+		{
+			const size_t n = fa.size();
+			std::vector<uint32_t> roots(n);
+			const uint32_t w = pow(g, (p - 1) / n);
+			buildRoots(roots.data(), n, w);
+			forward(fa.data(), n, roots.data());
+			forward(fb.data(), n, roots.data());
+			buildRoots(roots.data(), n, pow(w, p - 2));
+			const uint32_t scale_mont = toMont(pow((uint32_t)n, p - 2));
+			for (size_t i = 0; i != n; ++i)
+			{
+				fa[i] = mulMont(mulMont(fa[i], toMont(fb[i])), scale_mont);
+			}
+			inverse(fa.data(), n, roots.data());
+		}
+	};
+
+	[[nodiscard]] static constexpr uint32_t bigint_nttPInvNeg(uint32_t p) noexcept
+	{
+		uint32_t inv = p; // Correct to 3 bits for odd p; each Newton step doubles that.
+		for (int i = 0; i != 4; ++i)
+		{
+			inv *= 2 - p * inv;
+		}
+		return (uint32_t)0 - inv;
+	}
+
+	[[nodiscard]] static constexpr uint32_t bigint_nttR2(uint32_t p) noexcept
+	{
+		const uint64_t r = ((uint64_t)1 << 32) % p;
+		return (uint32_t)((r * r) % p);
+	}
+
+	static constexpr BigintNttPrime bigint_ntt_p1 = { 998244353, bigint_nttPInvNeg(998244353), bigint_nttR2(998244353), 3, 23 };
+	static constexpr BigintNttPrime bigint_ntt_p2 = { 469762049, bigint_nttPInvNeg(469762049), bigint_nttR2(469762049), 3, 26 };
+
+	[[nodiscard]] static bool bigint_canUseNtt(size_t an, size_t bn) noexcept
+	{
+		constexpr size_t digits_per_chunk = sizeof(chunk_t) / 2;
+		const size_t digits = (an + bn) * digits_per_chunk;
+		return digits <= ((size_t)1 << bigint_ntt_p1.max_log2);
+	}
+
+	static void bigint_mulNtt(chunk_t* res, const chunk_t* a, size_t an, const chunk_t* b, size_t bn) SOUP_EXCAL
+	{
+		constexpr size_t digits_per_chunk = sizeof(chunk_t) / 2;
+		const size_t num_digits = (an + bn) * digits_per_chunk;
+		size_t n = 1;
+		while (n < num_digits)
+		{
+			n <<= 1;
+		}
+
+		auto split = [n](const chunk_t* x, size_t xn)
+		{
+			std::vector<uint32_t> digits(n);
+			for (size_t i = 0; i != xn; ++i)
+			{
+				for (size_t d = 0; d != digits_per_chunk; ++d)
+				{
+					digits[i * digits_per_chunk + d] = (uint16_t)(x[i] >> (d * 16));
+				}
+			}
+			return digits;
+		};
+
+		std::vector<uint32_t> r1 = split(a, an);
+		{
+			std::vector<uint32_t> fb = split(b, bn);
+			bigint_ntt_p1.convolve(r1, fb);
+		}
+		std::vector<uint32_t> r2 = split(a, an);
+		{
+			std::vector<uint32_t> fb = split(b, bn);
+			bigint_ntt_p2.convolve(r2, fb);
+		}
+
+		// Garner's algorithm: x = r1 + p1 * ((r2 - r1) * p1^-1 mod p2)
+		const uint64_t p1 = bigint_ntt_p1.p;
+		const uint64_t p2 = bigint_ntt_p2.p;
+		const uint64_t p1_inv = bigint_ntt_p2.pow((uint32_t)(p1 % p2), p2 - 2);
+		uint64_t carry = 0;
+		for (size_t i = 0; i != an + bn; ++i)
+		{
+			chunk_t chunk = 0;
+			for (size_t d = 0; d != digits_per_chunk; ++d)
+			{
+				const size_t idx = i * digits_per_chunk + d;
+				const uint64_t x1 = r1[idx];
+				const uint64_t t = (((r2[idx] + p2 - (x1 % p2)) % p2) * p1_inv) % p2;
+				carry += x1 + p1 * t;
+				chunk |= (chunk_t)((carry & 0xffff) << (d * 16));
+				carry >>= 16;
+			}
+			res[i] = chunk;
+		}
+	}
+
 	Bigint Bigint::operator*(const Bigint& b) const SOUP_EXCAL
 	{
-		// Karatsuba's method is supposed to be faster for 1024-bit integers, but here it seems to only be effective starting at 0x4000 bits.
-		SOUP_IF_UNLIKELY (getNumBits() >= 0x4000 && b.getNumBits() >= 0x4000)
+		SOUP_IF_UNLIKELY (std::min(getNumChunks(), b.getNumChunks()) >= BIGINT_NTT_THRESHOLD
+			&& bigint_canUseNtt(getNumChunks(), b.getNumChunks())
+			)
 		{
-			return multiplyKaratsuba(b);
+			return multiplyNtt(b);
 		}
 
-		return multiplySimple(b);
+		// Below the Karatsuba threshold, this is still faster than multiplySimple as it works on the chunks directly.
+		return multiplyKaratsuba(b);
 	}
 
 	Bigint Bigint::multiplySimple(const Bigint& b) const SOUP_EXCAL
@@ -1273,37 +1797,49 @@ NAMESPACE_SOUP
 	Bigint Bigint::multiplyKaratsuba(const Bigint& b) const SOUP_EXCAL
 	{
 		auto product = multiplyKaratsubaUnsigned(b);
-		product.negative = (negative ^ b.negative);
+		product.negative = ((negative ^ b.negative) && !product.isZero());
 		return product;
 	}
 
-	Bigint Bigint::multiplyKaratsubaUnsigned(const Bigint& b/*, size_t recursions*/) const SOUP_EXCAL
+	Bigint Bigint::multiplyKaratsubaUnsigned(const Bigint& b) const SOUP_EXCAL
 	{
-		//std::cout << std::string(recursions * 2, ' ') << toString() << " * " << b.toString() << "\n";
-
-		if (getNumBits() < 0x1000 || b.getNumBits() < 0x1000)
+		Bigint product{};
+		if (!isZero() && !b.isZero())
 		{
-			return multiplySimple(b);
+			const auto nc = getNumChunks();
+			const auto b_nc = b.getNumChunks();
+			std::vector<chunk_t> scratch(getMultiplyChunksScratchSize(nc, b_nc));
+			product.chunks.resize(nc + b_nc);
+			multiplyChunks(product.chunks.data(), chunks.data(), nc, b.chunks.data(), b_nc, scratch.data());
+			product.shrink();
 		}
+		return product;
+	}
 
-		size_t half = std::min<size_t>(getNumChunks(), b.getNumChunks()) >> 1;
-		size_t half_bits = (half * getBitsPerChunk());
-
-		auto [high1, low1] = splitAt(half);
-		auto [high2, low2] = b.splitAt(half);
-
-		Bigint p1 = high1.multiplyKaratsubaUnsigned(high2/*, recursions + 1*/);
-		Bigint p2 = low1.multiplyKaratsubaUnsigned(low2/*, recursions + 1*/);
-		Bigint p3 = (low1 + high1).multiplyKaratsubaUnsigned(low2 + high2/*, recursions + 1*/);
+	Bigint Bigint::multiplyNtt(const Bigint& b) const SOUP_EXCAL
+	{
+		Bigint product{};
+		if (!isZero() && !b.isZero())
+		{
+			const auto nc = getNumChunks();
+			const auto b_nc = b.getNumChunks();
+			SOUP_ASSERT(bigint_canUseNtt(nc, b_nc));
+			product.chunks.resize(nc + b_nc);
+			bigint_mulNtt(product.chunks.data(), chunks.data(), nc, b.chunks.data(), b_nc);
+			product.shrink();
+			product.negative = (negative ^ b.negative);
+		}
+		return product;
+	}
 
-		p3.subUnsigned(p1);
-		p3.subUnsigned(p2);
+	void Bigint::multiplyChunks(chunk_t* res, const chunk_t* a, size_t a_nc, const chunk_t* b, size_t b_nc, chunk_t* scratch) noexcept
+	{
+		bigint_mul(res, a, a_nc, b, b_nc, scratch);
+	}
 
-		p1 <<= half_bits;
-		p1.addUnsigned(p3);
-		p1 <<= half_bits;
-		p1.addUnsigned(p2);
-		return p1;
+	size_t Bigint::getMultiplyChunksScratchSize(size_t a_nc, size_t b_nc) noexcept
+	{
+		return bigint_mulScratchSize(a_nc, b_nc);
 	}
 
 	Bigint Bigint::operator/(const Bigint& b) const SOUP_EXCAL
@@ -1784,6 +2320,12 @@ NAMESPACE_SOUP
 
 	Bigint Bigint::modPow(const Bigint& e, const Bigint& m) const
 	{
+		if (MontgomeryContext::isSupportedModulus(m)
+			&& !isNegative()
+			)
+		{
+			return MontgomeryContext(m).modPow(*this, e);
+		}
 		if (m.isOdd()
 			&& e.getNumBits() > 32 // arbitrary choice
 			)
@@ -199,7 +199,11 @@ NAMESPACE_SOUP
 		[[nodiscard]] Bigint operator*(const Bigint& b) const SOUP_EXCAL;
 		[[nodiscard]] Bigint multiplySimple(const Bigint& b) const SOUP_EXCAL;
 		[[nodiscard]] Bigint multiplyKaratsuba(const Bigint& b) const SOUP_EXCAL;
-		[[nodiscard]] Bigint multiplyKaratsubaUnsigned(const Bigint& b/*, size_t recursions = 0*/) const SOUP_EXCAL;
+		[[nodiscard]] Bigint multiplyKaratsubaUnsigned(const Bigint& b) const SOUP_EXCAL; // Karatsuba, or Toom-3 for larger operands.
+		[[nodiscard]] Bigint multiplyNtt(const Bigint& b) const SOUP_EXCAL; // The product may be at most 2^23 16-bit digits.
+		// res = a * b, where res has space for a_nc + b_nc chunks. Doesn't allocate; scratch must have space for getMultiplyChunksScratchSize(a_nc, b_nc) chunks.
+		static void multiplyChunks(chunk_t* res, const chunk_t* a, size_t a_nc, const chunk_t* b, size_t b_nc, chunk_t* scratch) noexcept;
+		[[nodiscard]] static size_t getMultiplyChunksScratchSize(size_t a_nc, size_t b_nc) noexcept;
 		[[nodiscard]] Bigint operator/(const Bigint& b) const SOUP_EXCAL;
 		[[nodiscard]] Bigint operator%(const Bigint& b) const SOUP_EXCAL;
 		[[nodiscard]] Bigint operator<<(size_t b) const SOUP_EXCAL;
@@ -3,6 +3,7 @@
 #include "base.hpp"
 
 #include "rsa.hpp"
+#include "TlsSessionCache.hpp"
 #include "X509Certchain.hpp"
 
 NAMESPACE_SOUP
@@ -21,6 +22,7 @@ NAMESPACE_SOUP
 		};
 
 		std::vector<Entry> entries{};
+		TlsSessionCache sessions{}; // For resumption of sessions established by Socket::enableCryptoServer.
 
 		void add(X509Certchain&& certchain, RsaPrivateKey&& private_key)
 		{
@@ -0,0 +1,236 @@
+#include "ConnectionPool.hpp"
+
+#if !SOUP_WASM
+
+#include "HttpConnectionTask.hpp"
+#include "ReuseTag.hpp"
+#include "Socket.hpp"
+#include "time.hpp"
+
+NAMESPACE_SOUP
+{
+	size_t ConnectionPool::KeyHash::operator()(const Key& k) const noexcept
+	{
+		return std::hash<std::string>{}(k.host) ^ ((static_cast<size_t>(k.port) << 1) | k.tls);
+	}
+
+	ConnectionPool::ConnectionPool() noexcept = default;
+	ConnectionPool::~ConnectionPool() noexcept = default;
+
+	SharedPtr<Socket> ConnectionPool::checkout(const Key& key) SOUP_EXCAL
+	{
+		if (auto it = hosts.find(key); it != hosts.end())
+		{
+			auto& h = it->second;
+			while (!h.idle.empty())
+			{
+				auto sock = std::move(h.idle.back().sock);
+				h.idle.pop_back();
+				--num_idle;
+				if (sock->isIdleConnectionUsable())
+				{
+					sock->custom_data.getStructFromMap(ReuseTag).is_busy = true;
+					++h.num_busy;
+					return sock;
+				}
+				sock->close();
+			}
+			eraseIfUnused(it);
+		}
+		return {};
+	}
+
+	bool ConnectionPool::reserve(const Key& key) SOUP_EXCAL
+	{
+		auto it = hosts.find(key);
+		if (it == hosts.end())
+		{
+			if (max_total_per_host == 0)
+			{
+				return false;
+			}
+			it = hosts.emplace(key, Host{}).first;
+		}
+		else if (it->second.getTotal() >= max_total_per_host)
+		{
+			return false;
+		}
+		++it->second.num_connecting;
+		return true;
+	}
+
+	void ConnectionPool::unreserve(const Key& key) noexcept
+	{
+		if (auto it = hosts.find(key); it != hosts.end())
+		{
+			--it->second.num_connecting;
+			eraseIfUnused(it);
+		}
+	}
+
+	void ConnectionPool::add(const Key& key, Socket& sock) SOUP_EXCAL
+	{
+		auto& h = hosts.at(key);
+		--h.num_connecting;
+		++h.num_busy;
+		auto& tag = sock.custom_data.getStructFromMap(ReuseTag);
+		tag.host = key.host;
+		tag.port = key.port;
+		tag.tls = key.tls;
+		tag.is_busy = true;
+	}
+
+	void ConnectionPool::checkin(const SharedPtr<Socket>& sock) SOUP_EXCAL
+	{
+		if (!sock->custom_data.isStructInMap(ReuseTag))
+		{
+			return;
+		}
+		auto& tag = sock->custom_data.getStructFromMap(ReuseTag);
+		if (!tag.is_busy)
+		{
+			return;
+		}
+		tag.is_busy = false;
+		auto it = hosts.find(Key{ tag.host, tag.port, tag.tls });
+		SOUP_IF_UNLIKELY (it == hosts.end())
+		{
+			return;
+		}
+		auto& h = it->second;
+		--h.num_busy;
+		if (h.idle.size() < max_idle_per_host
+			&& !sock->remote_closed
+			&& sock->hasConnection()
+			)
+		{
+			sock->keepAlive();
+			h.idle.emplace_back(Idle{ sock, time::unixSeconds() });
+			++num_idle;
+		}
+		else
+		{
+			sock->close();
+			eraseIfUnused(it);
+		}
+	}
+
+	void ConnectionPool::discard(Socket& sock) SOUP_EXCAL
+	{
+		if (!sock.custom_data.isStructInMap(ReuseTag))
+		{
+			return;
+		}
+		auto& tag = sock.custom_data.getStructFromMapConst(ReuseTag);
+		if (!tag.is_busy)
+		{
+			return;
+		}
+		tag.is_busy = false;
+		if (auto it = hosts.find(Key{ tag.host, tag.port, tag.tls }); it != hosts.end())
+		{
+			--it->second.num_busy;
+			eraseIfUnused(it);
+		}
+	}
+
+	bool ConnectionPool::isPooled(const Socket& sock) noexcept
+	{
+		return sock.custom_data.isStructInMap(ReuseTag);
+	}
+
+	void ConnectionPool::closeIdle() SOUP_EXCAL
+	{
+		for (auto it = hosts.begin(); it != hosts.end(); )
+		{
+			for (auto& e : it->second.idle)
+			{
+				e.sock->close();
+			}
+			num_idle -= it->second.idle.size();
+			it->second.idle.clear();
+			if (it->second.getTotal() == 0)
+			{
+				it = hosts.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	void ConnectionPool::closeExpired() SOUP_EXCAL
+	{
+		const auto now = time::unixSeconds();
+		if (last_expiry_check == now)
+		{
+			return;
+		}
+		last_expiry_check = now;
+		for (auto it = hosts.begin(); it != hosts.end(); )
+		{
+			// Expired connections are at the front, but ones that were closed can be anywhere, so everything is checked.
+			auto& idle = it->second.idle;
+			auto end = idle.begin();
+			for (auto i = idle.begin(); i != idle.end(); ++i)
+			{
+				if (now - i->since >= static_cast<std::time_t>(idle_timeout)
+					|| i->sock->isWorkDoneOrClosed()
+					)
+				{
+					i->sock->close();
+				}
+				else
+				{
+					if (end != i)
+					{
+						*end = std::move(*i);
+					}
+					++end;
+				}
+			}
+			if (end != idle.end())
+			{
+				num_idle -= (idle.end() - end);
+				idle.erase(end, idle.end());
+			}
+			if (it->second.getTotal() == 0)
+			{
+				it = hosts.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	size_t ConnectionPool::getNumIdle(const Key& key) const noexcept
+	{
+		if (auto it = hosts.find(key); it != hosts.end())
+		{
+			return it->second.idle.size();
+		}
+		return 0;
+	}
+
+	size_t ConnectionPool::getNumBusy(const Key& key) const noexcept
+	{
+		if (auto it = hosts.find(key); it != hosts.end())
+		{
+			return it->second.num_busy;
+		}
+		return 0;
+	}
+
+	void ConnectionPool::eraseIfUnused(std::unordered_map<Key, Host, KeyHash>::iterator it) noexcept
+	{
+		if (it->second.getTotal() == 0)
+		{
+			hosts.erase(it);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base.hpp"
+#include "fwd.hpp"
+
+#include "SharedPtr.hpp"
+
+NAMESPACE_SOUP
+{
+	// Keeps connections to remotes, keyed by (host, port, tls), so they can be reused. All operations are O(1) on average.
+	// A pooled connection is busy from being added or checked out until it's checked in or discarded, at which point it becomes idle or goes away.
+	// Every successful reserve, add or checkout must therefore be matched with exactly one unreserve, checkin or discard.
+	class ConnectionPool
+	{
+	public:
+		struct Key
+		{
+			std::string host;
+			uint16_t port;
+			bool tls;
+
+			[[nodiscard]] bool operator==(const Key& b) const noexcept
+			{
+				return port == b.port && tls == b.tls && host == b.host;
+			}
+		};
+
+		struct KeyHash
+		{
+			[[nodiscard]] size_t operator()(const Key& k) const noexcept;
+		};
+
+		size_t max_idle_per_host = 6;
+		size_t max_total_per_host = 6; // Includes connections that are still being established.
+		unsigned int idle_timeout = 60; // Seconds after which idle connections are closed.
+
+		// Connections that many requests can be in flight on at once, see HttpConnectionTask::get.
+		std::unordered_map<Key, SharedPtr<HttpConnectionTask>, KeyHash> multiplexed;
+
+	protected:
+		struct Idle
+		{
+			SharedPtr<Socket> sock;
+			std::time_t since;
+		};
+
+		struct Host
+		{
+			std::vector<Idle> idle{}; // Oldest first.
+			size_t num_busy = 0;
+			size_t num_connecting = 0;
+
+			[[nodiscard]] size_t getTotal() const noexcept { return idle.size() + num_busy + num_connecting; }
+		};
+
+		std::unordered_map<Key, Host, KeyHash> hosts;
+		size_t num_idle = 0;
+		std::time_t last_expiry_check = 0;
+
+	public:
+		ConnectionPool() noexcept;
+		~ConnectionPool() noexcept; // Defined out-of-line so Socket may be incomplete where this is a member.
+
+		// Returns the most recently used idle connection to the remote that passes a health check, or nullptr. Unhealthy ones are closed on the way.
+		[[nodiscard]] SharedPtr<Socket> checkout(const Key& key) SOUP_EXCAL;
+
+		// Reserves room for a new connection to the remote. Returns false if max_total_per_host has been reached.
+		[[nodiscard]] bool reserve(const Key& key) SOUP_EXCAL;
+		void unreserve(const Key& key) noexcept; // The connection could not be established.
+		void add(const Key& key, Socket& sock) SOUP_EXCAL; // The connection was established and is now busy. Requires a reservation.
+
+		// Returns a busy connection to the pool, unless it's closed or max_idle_per_host has been reached, in which case it's closed & forgotten.
+		void checkin(const SharedPtr<Socket>& sock) SOUP_EXCAL;
+		// Forgets about a busy connection, e.g. because the remote closed it. The caller is responsible for closing it.
+		void discard(Socket& sock) SOUP_EXCAL;
+
+		[[nodiscard]] static bool isPooled(const Socket& sock) noexcept;
+
+		void closeIdle() SOUP_EXCAL;
+		void closeExpired() SOUP_EXCAL; // Does nothing if it was already called this second.
+
+		[[nodiscard]] size_t getNumIdle() const noexcept { return num_idle; }
+		[[nodiscard]] size_t getNumHosts() const noexcept { return hosts.size(); }
+		[[nodiscard]] size_t getNumIdle(const Key& key) const noexcept;
+		[[nodiscard]] size_t getNumBusy(const Key& key) const noexcept;
+
+	protected:
+		void eraseIfUnused(std::unordered_map<Key, Host, KeyHash>::iterator it) noexcept;
+	};
+}
@@ -154,6 +154,8 @@ NAMESPACE_SOUP
 		if (supportsAESNI()) { string::listAppend(misc_features, "AESNI"); }
 		if (supportsRDRAND()) { string::listAppend(misc_features, "RDRAND"); }
 		if (supportsRDSEED()) { string::listAppend(misc_features, "RDSEED"); }
+		if (supportsBMI2()) { string::listAppend(misc_features, "BMI2"); }
+		if (supportsADX()) { string::listAppend(misc_features, "ADX"); }
 		if (supportsSHA()) { string::listAppend(misc_features, "SHA"); }
 		if (supportsSHA512()) { string::listAppend(misc_features, "SHA512"); }
 		if (supportsXOP()) { string::listAppend(misc_features, "supportsXOP"); }
@@ -88,6 +88,11 @@ NAMESPACE_SOUP
 			return (feature_flags_ecx >> 20) & 1;
 		}
 
+		[[nodiscard]] bool supportsPOPCNT() const noexcept
+		{
+			return (feature_flags_ecx >> 23) & 1;
+		}
+
 		[[nodiscard]] bool supportsAESNI() const noexcept
 		{
 			return (feature_flags_ecx >> 25) & 1;
@@ -108,6 +113,11 @@ NAMESPACE_SOUP
 			return (extended_features_0_ebx >> 5) & 1;
 		}
 
+		[[nodiscard]] bool supportsBMI2() const noexcept
+		{
+			return (extended_features_0_ebx >> 8) & 1;
+		}
+
 		[[nodiscard]] bool supportsAVX512F() const noexcept
 		{
 			return (extended_features_0_ebx >> 16) & 1;
@@ -118,6 +128,11 @@ NAMESPACE_SOUP
 			return (extended_features_0_ebx >> 18) & 1;
 		}
 
+		[[nodiscard]] bool supportsADX() const noexcept
+		{
+			return (extended_features_0_ebx >> 19) & 1;
+		}
+
 		[[nodiscard]] bool supportsSHA() const noexcept
 		{
 			return (extended_features_0_ebx >> 29) & 1;
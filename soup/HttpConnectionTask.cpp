@@ -0,0 +1,1002 @@
+#include "HttpConnectionTask.hpp"
+
+#if !SOUP_WASM
+
+#include <algorithm> // sort
+
+#include "ObfusString.hpp"
+#include "Scheduler.hpp"
+#include "Socket.hpp"
+#include "string.hpp"
+#include "time.hpp"
+#include "urlenc.hpp"
+
+NAMESPACE_SOUP
+{
+	enum Http2FrameType : uint8_t
+	{
+		H2_DATA = 0x0,
+		H2_HEADERS = 0x1,
+		H2_PRIORITY = 0x2,
+		H2_RST_STREAM = 0x3,
+		H2_SETTINGS = 0x4,
+		H2_PUSH_PROMISE = 0x5,
+		H2_PING = 0x6,
+		H2_GOAWAY = 0x7,
+		H2_WINDOW_UPDATE = 0x8,
+		H2_CONTINUATION = 0x9,
+	};
+
+	enum Http2Flags : uint8_t
+	{
+		H2_FLAG_END_STREAM = 0x1,
+		H2_FLAG_ACK = 0x1,
+		H2_FLAG_END_HEADERS = 0x4,
+		H2_FLAG_PADDED = 0x8,
+		H2_FLAG_PRIORITY = 0x20,
+	};
+
+	enum Http2Settings : uint16_t
+	{
+		H2_SETTINGS_HEADER_TABLE_SIZE = 0x1,
+		H2_SETTINGS_ENABLE_PUSH = 0x2,
+		H2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+		H2_SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+		H2_SETTINGS_MAX_FRAME_SIZE = 0x5,
+	};
+
+	enum Http2ErrorCode : uint32_t
+	{
+		H2_NO_ERROR = 0x0,
+		H2_PROTOCOL_ERROR = 0x1,
+		H2_FRAME_SIZE_ERROR = 0x6,
+		H2_REFUSED_STREAM = 0x7,
+	};
+
+	static constexpr uint32_t H2_MAX_FRAME_SIZE = 0x4000; // We don't ask for bigger frames than the default.
+	static constexpr uint32_t H2_STREAM_WINDOW = 0x100000;
+	static constexpr uint32_t H2_CONN_WINDOW = 0x1000000;
+
+	[[nodiscard]] static uint32_t h2_readU32(const char* p) noexcept
+	{
+		return (static_cast<uint32_t>(static_cast<uint8_t>(p[0])) << 24)
+			| (static_cast<uint32_t>(static_cast<uint8_t>(p[1])) << 16)
+			| (static_cast<uint32_t>(static_cast<uint8_t>(p[2])) << 8)
+			| static_cast<uint32_t>(static_cast<uint8_t>(p[3]))
+			;
+	}
+
+	static void h2_writeU32(char* p, uint32_t v) noexcept
+	{
+		p[0] = static_cast<char>(v >> 24);
+		p[1] = static_cast<char>(v >> 16);
+		p[2] = static_cast<char>(v >> 8);
+		p[3] = static_cast<char>(v);
+	}
+
+	HttpConnectionTask::HttpConnectionTask(ConnectionPool::Key key) SOUP_EXCAL
+		: key(std::move(key)), last_activity(time::unixSeconds())
+	{
+	}
+
+	SharedPtr<HttpConnectionTask> HttpConnectionTask::get(Scheduler& sched, const ConnectionPool::Key& key) SOUP_EXCAL
+	{
+		auto& conn = sched.connection_pool.multiplexed[key];
+		if (!conn
+			|| conn->state == CLOSED
+			)
+		{
+			conn = sched.add<HttpConnectionTask>(key);
+		}
+		return conn;
+	}
+
+	void HttpConnectionTask::submit(HttpRequest&& hr, callback_t callback, Capture&& cap) SOUP_EXCAL
+	{
+		if (state == CLOSED)
+		{
+			callback(std::nullopt, std::move(cap));
+			return;
+		}
+		queue.emplace_back(Request{ std::move(hr), callback, std::move(cap) });
+		if (state == ACTIVE)
+		{
+			flush();
+		}
+	}
+
+	void HttpConnectionTask::onTick()
+	{
+		switch (state)
+		{
+		case CONNECTING:
+			if (!connector.has_value())
+			{
+				connector.emplace(key.host, key.port, prefer_ipv6);
+			}
+			if (connector->tickUntilDone())
+			{
+				if (!connector->wasSuccessful())
+				{
+					connector.reset();
+					onConnectionLost();
+					return;
+				}
+				sock = connector->getSocket();
+				connector.reset();
+				last_activity = time::unixSeconds();
+				if (key.tls)
+				{
+					state = HANDSHAKING;
+					sock->enableCryptoClient(key.host, [](Socket& s, Capture&& cap) SOUP_EXCAL
+					{
+						auto& self = *cap.get<HttpConnectionTask*>();
+						self.protocol = HTTP_1_1;
+						if (s.custom_data.isStructInMap(TlsAlpnProtocol)
+							&& s.custom_data.getStructFromMapConst(TlsAlpnProtocol) == "h2"
+							)
+						{
+							self.protocol = HTTP_2;
+						}
+						self.onConnected();
+					}, this, {}, { "h2", "http/1.1" });
+				}
+				else
+				{
+					protocol = (http2_prior_knowledge ? HTTP_2 : HTTP_1_1);
+					onConnected();
+				}
+			}
+			break;
+
+		case HANDSHAKING:
+		case ACTIVE:
+			if (sock->isWorkDoneOrClosed())
+			{
+				onConnectionLost();
+			}
+			else if (state == HANDSHAKING || in_flight.size() + streams.size() != 0)
+			{
+				if (time::unixSecondsSince(last_activity) > response_timeout)
+				{
+					onConnectionLost();
+				}
+			}
+			else if (queue.empty()
+				&& time::unixSecondsSince(last_activity) > idle_timeout
+				)
+			{
+				close();
+			}
+			break;
+
+		case CLOSED:
+			break;
+		}
+	}
+
+	void HttpConnectionTask::onConnected() SOUP_EXCAL
+	{
+		state = ACTIVE;
+		connect_attempts = 0;
+		last_activity = time::unixSeconds();
+		if (protocol == HTTP_2)
+		{
+			h2_start();
+		}
+		recvLoop();
+		flush();
+	}
+
+	void HttpConnectionTask::recvLoop() SOUP_EXCAL
+	{
+		sock->recv([](Socket& s, std::string&& data, Capture&& cap) SOUP_EXCAL
+		{
+			auto& self = *cap.get<HttpConnectionTask*>();
+			self.onData(std::move(data));
+			if (self.state == ACTIVE
+				&& self.sock.get() == &s
+				)
+			{
+				self.recvLoop();
+			}
+		}, this);
+	}
+
+	void HttpConnectionTask::onData(std::string&& data) SOUP_EXCAL
+	{
+		last_activity = time::unixSeconds();
+		if (protocol == HTTP_2)
+		{
+			recv_buf.append(data);
+			h2_onData();
+		}
+		else
+		{
+			parser.feed(std::move(data));
+			h1_onData();
+		}
+	}
+
+	void HttpConnectionTask::flush() SOUP_EXCAL
+	{
+		if (protocol == HTTP_2)
+		{
+			h2_flush();
+		}
+		else
+		{
+			h1_flush();
+		}
+	}
+
+	void HttpConnectionTask::complete(Request& req, Optional<HttpResponse>&& resp) SOUP_EXCAL
+	{
+		if (resp.has_value())
+		{
+			resp->decode();
+		}
+		req.callback(std::move(resp), std::move(req.cap));
+	}
+
+	void HttpConnectionTask::onConnectionLost() SOUP_EXCAL
+	{
+		const bool was_active = (state == ACTIVE);
+		state = CONNECTING; // Anything submitted from a callback will now be queued.
+		if (sock)
+		{
+			if (sock->hasConnection())
+			{
+				sock->close();
+			}
+			sock.reset();
+		}
+
+		std::vector<Request> lost{};
+		if (protocol == HTTP_1_1)
+		{
+			if (!in_flight.empty()
+				&& parser.finish() == HttpResponseParser::COMPLETE
+				)
+			{
+				// The response was delimited by the connection closing.
+				lost.emplace_back(std::move(in_flight.front()));
+				in_flight.pop_front();
+				Optional<HttpResponse> resp = std::move(parser.resp);
+				complete(lost.back(), std::move(resp));
+				lost.clear();
+			}
+			for (auto& req : in_flight)
+			{
+				lost.emplace_back(std::move(req));
+			}
+			in_flight.clear();
+		}
+		else if (protocol == HTTP_2)
+		{
+			std::vector<uint32_t> ids{};
+			for (const auto& e : streams)
+			{
+				ids.emplace_back(e.first);
+			}
+			std::sort(ids.begin(), ids.end());
+			for (const auto& id : ids)
+			{
+				lost.emplace_back(std::move(streams.at(id).req));
+			}
+			streams.clear();
+		}
+		resetProtocolState();
+
+		// Re-queue in reverse so the requests end up at the front of the queue in their original order.
+		for (auto i = lost.rbegin(); i != lost.rend(); ++i)
+		{
+			retryOrFail(std::move(*i));
+		}
+
+		if (!was_active
+			&& ++connect_attempts >= 2
+			)
+		{
+			while (!queue.empty())
+			{
+				auto req = std::move(queue.front());
+				queue.pop_front();
+				complete(req, std::nullopt);
+			}
+		}
+		if (queue.empty())
+		{
+			close();
+		}
+	}
+
+	void HttpConnectionTask::retryOrFail(Request&& req) SOUP_EXCAL
+	{
+		if (isRetryable(req.hr)
+			&& ++req.attempts < 2
+			)
+		{
+			queue.emplace_front(std::move(req));
+		}
+		else
+		{
+			complete(req, std::nullopt);
+		}
+	}
+
+	void HttpConnectionTask::close() SOUP_EXCAL
+	{
+		if (sock)
+		{
+			if (protocol == HTTP_2
+				&& state == ACTIVE
+				)
+			{
+				h2_goaway(H2_NO_ERROR);
+			}
+			if (sock->hasConnection())
+			{
+				sock->close();
+			}
+			sock.reset();
+		}
+		state = CLOSED;
+		auto& multiplexed = Scheduler::get()->connection_pool.multiplexed;
+		if (auto e = multiplexed.find(key); e != multiplexed.end() && e->second.get() == this)
+		{
+			multiplexed.erase(e);
+		}
+		while (!queue.empty())
+		{
+			auto req = std::move(queue.front());
+			queue.pop_front();
+			complete(req, std::nullopt);
+		}
+		setWorkDone();
+	}
+
+	void HttpConnectionTask::resetProtocolState() SOUP_EXCAL
+	{
+		protocol = UNKNOWN;
+		parser = HttpResponseParser{};
+		recv_buf.clear();
+		header_block.clear();
+		header_block_stream_id = 0;
+		hpack_encoder = HpackEncoder{};
+		hpack_decoder = HpackDecoder{};
+		send_buf.clear();
+		next_stream_id = 1;
+		goaway_last_stream_id = 0;
+		goaway_received = false;
+		peer_max_concurrent_streams = 100;
+		peer_max_frame_size = 0x4000;
+		peer_initial_window_size = 0xFFFF;
+		conn_send_window = 0xFFFF;
+		conn_recv_unacked = 0;
+	}
+
+	bool HttpConnectionTask::isRetryable(const HttpRequest& hr) noexcept
+	{
+		return hr.method == "GET"
+			|| hr.method == "HEAD"
+			|| hr.method == "OPTIONS"
+			;
+	}
+
+	void HttpConnectionTask::h1_onData() SOUP_EXCAL
+	{
+		while (!in_flight.empty())
+		{
+			const auto status = parser.parse(in_flight.front().hr.method == "HEAD");
+			if (status == HttpResponseParser::NEED_MORE_DATA)
+			{
+				break;
+			}
+			if (status != HttpResponseParser::COMPLETE)
+			{
+				onConnectionLost();
+				return;
+			}
+			auto req = std::move(in_flight.front());
+			in_flight.pop_front();
+			const bool keep_alive = parser.isKeepAlive();
+			Optional<HttpResponse> resp = std::move(parser.resp);
+			parser.consume();
+			complete(req, std::move(resp));
+			if (state != ACTIVE)
+			{
+				return;
+			}
+			if (!keep_alive)
+			{
+				onConnectionLost();
+				return;
+			}
+		}
+		if (in_flight.empty()
+			&& !parser.buf.empty()
+			)
+		{
+			// The server sent something we didn't ask for.
+			onConnectionLost();
+			return;
+		}
+		h1_flush();
+	}
+
+	void HttpConnectionTask::h1_flush() SOUP_EXCAL
+	{
+		std::string out{};
+		const bool was_waiting = !in_flight.empty();
+		while (!queue.empty()
+			&& in_flight.size() < max_pipeline_depth
+			)
+		{
+			// Requests that are not safe to retry are never pipelined, so nothing depends on their fate.
+			if (!in_flight.empty()
+				&& (!isRetryable(queue.front().hr) || !isRetryable(in_flight.back().hr))
+				)
+			{
+				break;
+			}
+			auto& req = queue.front();
+			req.hr.setKeepAlive();
+			out.append(req.hr.getDataToSend());
+			in_flight.emplace_back(std::move(req));
+			queue.pop_front();
+		}
+		if (!out.empty())
+		{
+			if (!was_waiting)
+			{
+				last_activity = time::unixSeconds();
+			}
+			sock->send(out);
+		}
+	}
+
+	void HttpConnectionTask::h2_start() SOUP_EXCAL
+	{
+		std::string out = ObfusString("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n").str();
+
+		char settings[12];
+		settings[0] = 0;
+		settings[1] = H2_SETTINGS_ENABLE_PUSH;
+		h2_writeU32(&settings[2], 0);
+		settings[6] = 0;
+		settings[7] = H2_SETTINGS_INITIAL_WINDOW_SIZE;
+		h2_writeU32(&settings[8], H2_STREAM_WINDOW);
+		h2_appendFrame(out, H2_SETTINGS, 0, 0, settings, sizeof(settings));
+
+		char increment[4];
+		h2_writeU32(increment, H2_CONN_WINDOW - 0xFFFF);
+		h2_appendFrame(out, H2_WINDOW_UPDATE, 0, 0, increment, sizeof(increment));
+
+		sock->send(out);
+	}
+
+	void HttpConnectionTask::h2_onData() SOUP_EXCAL
+	{
+		size_t offset = 0;
+		while (recv_buf.size() - offset >= 9)
+		{
+			const char* const frame = recv_buf.data() + offset;
+			const uint32_t length = (h2_readU32(frame) >> 8);
+			if (length > H2_MAX_FRAME_SIZE)
+			{
+				h2_goaway(H2_FRAME_SIZE_ERROR);
+				onConnectionLost();
+				return;
+			}
+			if (recv_buf.size() - offset < 9 + length)
+			{
+				break;
+			}
+			offset += 9 + length;
+			if (!h2_onFrame(static_cast<uint8_t>(frame[3]), static_cast<uint8_t>(frame[4]), h2_readU32(frame + 5) & 0x7FFFFFFF, frame + 9, length))
+			{
+				h2_goaway(H2_PROTOCOL_ERROR);
+				onConnectionLost();
+				return;
+			}
+			if (state != ACTIVE)
+			{
+				return;
+			}
+		}
+		recv_buf.erase(0, offset);
+		h2_flush();
+	}
+
+	bool HttpConnectionTask::h2_onFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, uint32_t length) SOUP_EXCAL
+	{
+		if (header_block_stream_id != 0)
+		{
+			// A header block must be continued without any other frames in between.
+			if (type != H2_CONTINUATION
+				|| stream_id != header_block_stream_id
+				)
+			{
+				return false;
+			}
+			if (header_block.size() + length > hpack_decoder.max_header_list_size)
+			{
+				// The headers would be too big to be accepted anyway, so don't keep buffering CONTINUATION frames (CVE-2024-27316).
+				return false;
+			}
+			header_block.append(payload, length);
+			if (flags & H2_FLAG_END_HEADERS)
+			{
+				header_block_stream_id = 0;
+				return h2_onHeaderBlock(stream_id, header_block_ends_stream);
+			}
+			return true;
+		}
+
+		switch (type)
+		{
+		case H2_DATA:
+			{
+				if (stream_id == 0)
+				{
+					return false;
+				}
+				const uint32_t flow_controlled_length = length;
+				if (flags & H2_FLAG_PADDED)
+				{
+					if (length == 0
+						|| static_cast<uint8_t>(payload[0]) >= length
+						)
+					{
+						return false;
+					}
+					length -= 1 + static_cast<uint8_t>(payload[0]);
+					++payload;
+				}
+				conn_recv_unacked += flow_controlled_length;
+				if (conn_recv_unacked >= H2_CONN_WINDOW / 2)
+				{
+					char increment[4];
+					h2_writeU32(increment, conn_recv_unacked);
+					h2_appendFrame(send_buf, H2_WINDOW_UPDATE, 0, 0, increment, sizeof(increment));
+					conn_recv_unacked = 0;
+				}
+				if (auto e = streams.find(stream_id); e != streams.end())
+				{
+					if (!e->second.got_final_headers)
+					{
+						return false;
+					}
+					e->second.resp.body.append(payload, length);
+					if (flags & H2_FLAG_END_STREAM)
+					{
+						h2_completeStream(stream_id);
+					}
+					else if (e->second.recv_unacked += flow_controlled_length; e->second.recv_unacked >= H2_STREAM_WINDOW / 2)
+					{
+						char increment[4];
+						h2_writeU32(increment, e->second.recv_unacked);
+						h2_appendFrame(send_buf, H2_WINDOW_UPDATE, 0, stream_id, increment, sizeof(increment));
+						e->second.recv_unacked = 0;
+					}
+				}
+			}
+			return true;
+
+		case H2_HEADERS:
+			if (stream_id == 0)
+			{
+				return false;
+			}
+			if (flags & H2_FLAG_PADDED)
+			{
+				if (length == 0
+					|| static_cast<uint8_t>(payload[0]) >= length
+					)
+				{
+					return false;
+				}
+				length -= 1 + static_cast<uint8_t>(payload[0]);
+				++payload;
+			}
+			if (flags & H2_FLAG_PRIORITY)
+			{
+				if (length < 5)
+				{
+					return false;
+				}
+				length -= 5;
+				payload += 5;
+			}
+			if (length > hpack_decoder.max_header_list_size)
+			{
+				return false;
+			}
+			header_block.assign(payload, length);
+			if (flags & H2_FLAG_END_HEADERS)
+			{
+				return h2_onHeaderBlock(stream_id, flags & H2_FLAG_END_STREAM);
+			}
+			header_block_stream_id = stream_id;
+			header_block_ends_stream = (flags & H2_FLAG_END_STREAM);
+			return true;
+
+		case H2_PRIORITY:
+			return true;
+
+		case H2_RST_STREAM:
+			if (stream_id == 0
+				|| length != 4
+				)
+			{
+				return false;
+			}
+			if (auto e = streams.find(stream_id); e != streams.end())
+			{
+				auto req = std::move(e->second.req);
+				streams.erase(e);
+				if (h2_readU32(payload) == H2_REFUSED_STREAM)
+				{
+					// The server guarantees it did not process the request.
+					queue.emplace_front(std::move(req));
+				}
+				else
+				{
+					complete(req, std::nullopt);
+				}
+			}
+			return true;
+
+		case H2_SETTINGS:
+			if (stream_id != 0)
+			{
+				return false;
+			}
+			if (flags & H2_FLAG_ACK)
+			{
+				return length == 0;
+			}
+			if (length % 6 != 0)
+			{
+				return false;
+			}
+			for (uint32_t i = 0; i != length; i += 6)
+			{
+				const uint16_t id = (static_cast<uint8_t>(payload[i]) << 8) | static_cast<uint8_t>(payload[i + 1]);
+				const uint32_t value = h2_readU32(payload + i + 2);
+				switch (id)
+				{
+				case H2_SETTINGS_HEADER_TABLE_SIZE:
+					hpack_encoder.setMaxTableSize(value);
+					break;
+
+				case H2_SETTINGS_MAX_CONCURRENT_STREAMS:
+					peer_max_concurrent_streams = value;
+					break;
+
+				case H2_SETTINGS_INITIAL_WINDOW_SIZE:
+					if (value > 0x7FFFFFFF)
+					{
+						return false;
+					}
+					for (auto& e : streams)
+					{
+						e.second.send_window += static_cast<int64_t>(value) - peer_initial_window_size;
+					}
+					peer_initial_window_size = value;
+					break;
+
+				case H2_SETTINGS_MAX_FRAME_SIZE:
+					if (value < 0x4000 || value > 0xFFFFFF)
+					{
+						return false;
+					}
+					peer_max_frame_size = value;
+					break;
+				}
+			}
+			h2_appendFrame(send_buf, H2_SETTINGS, H2_FLAG_ACK, 0, nullptr, 0);
+			return true;
+
+		case H2_PUSH_PROMISE:
+			return false; // We've disabled server push.
+
+		case H2_PING:
+			if (stream_id != 0
+				|| length != 8
+				)
+			{
+				return false;
+			}
+			if (!(flags & H2_FLAG_ACK))
+			{
+				h2_appendFrame(send_buf, H2_PING, H2_FLAG_ACK, 0, payload, length);
+			}
+			return true;
+
+		case H2_GOAWAY:
+			if (stream_id != 0
+				|| length < 8
+				)
+			{
+				return false;
+			}
+			goaway_received = true;
+			goaway_last_stream_id = (h2_readU32(payload) & 0x7FFFFFFF);
+			{
+				// Streams the server did not process can safely be sent again on a new connection.
+				std::vector<uint32_t> ids{};
+				for (const auto& e : streams)
+				{
+					if (e.first > goaway_last_stream_id)
+					{
+						ids.emplace_back(e.first);
+					}
+				}
+				std::sort(ids.begin(), ids.end());
+				for (auto i = ids.rbegin(); i != ids.rend(); ++i)
+				{
+					queue.emplace_front(std::move(streams.at(*i).req));
+					streams.erase(*i);
+				}
+			}
+			return true;
+
+		case H2_WINDOW_UPDATE:
+			{
+				if (length != 4)
+				{
+					return false;
+				}
+				const uint32_t increment = (h2_readU32(payload) & 0x7FFFFFFF);
+				if (increment == 0)
+				{
+					return false;
+				}
+				if (stream_id == 0)
+				{
+					conn_send_window += increment;
+				}
+				else if (auto e = streams.find(stream_id); e != streams.end())
+				{
+					e->second.send_window += increment;
+				}
+			}
+			return true;
+
+		case H2_CONTINUATION:
+			return false; // Not preceded by HEADERS
+		}
+		return true; // Unknown frame types are to be ignored.
+	}
+
+	bool HttpConnectionTask::h2_onHeaderBlock(uint32_t stream_id, bool end_stream) SOUP_EXCAL
+	{
+		// Even if we don't care about the stream anymore, the block must be decoded to keep the dynamic table in sync.
+		std::vector<hpack::header_t> headers{};
+		if (!hpack_decoder.decode(header_block, headers))
+		{
+			return false;
+		}
+		header_block.clear();
+
+		auto e = streams.find(stream_id);
+		if (e == streams.end())
+		{
+			return true;
+		}
+		auto& stream = e->second;
+		if (!stream.got_final_headers)
+		{
+			uint16_t status = 0;
+			for (const auto& h : headers)
+			{
+				if (h.first == ":status")
+				{
+					status = string::toInt<uint16_t>(h.second, 0);
+				}
+			}
+			if (status < 100 || status > 999)
+			{
+				return false;
+			}
+			if (status / 100 == 1)
+			{
+				return true; // Interim response
+			}
+			stream.resp.status_code = status;
+			stream.got_final_headers = true;
+			for (auto& h : headers)
+			{
+				if (h.first.c_str()[0] != ':')
+				{
+					stream.resp.header_fields.emplace(MimeMessage::normaliseHeaderCasing(h.first), std::move(h.second));
+				}
+			}
+		}
+		// else: Trailers, which we don't expose.
+		if (end_stream)
+		{
+			h2_completeStream(stream_id);
+		}
+		return true;
+	}
+
+	void HttpConnectionTask::h2_completeStream(uint32_t stream_id) SOUP_EXCAL
+	{
+		auto e = streams.find(stream_id);
+		if (e->second.body_sent != e->second.req.hr.body.size())
+		{
+			// The server responded before we sent the entire body, so we can stop sending it.
+			char error_code[4];
+			h2_writeU32(error_code, H2_NO_ERROR);
+			h2_appendFrame(send_buf, H2_RST_STREAM, 0, stream_id, error_code, sizeof(error_code));
+		}
+		auto req = std::move(e->second.req);
+		Optional<HttpResponse> resp = std::move(e->second.resp);
+		streams.erase(e);
+		complete(req, std::move(resp));
+	}
+
+	void HttpConnectionTask::h2_flush() SOUP_EXCAL
+	{
+		if (state != ACTIVE)
+		{
+			return;
+		}
+		const bool was_waiting = !streams.empty();
+		while (!queue.empty()
+			&& !goaway_received
+			&& streams.size() < peer_max_concurrent_streams
+			)
+		{
+			if (next_stream_id > 0x7FFFFFFF)
+			{
+				// Out of stream ids; new requests will have to go over a new connection.
+				goaway_received = true;
+				break;
+			}
+			auto req = std::move(queue.front());
+			queue.pop_front();
+			const uint32_t stream_id = next_stream_id;
+			next_stream_id += 2;
+
+			std::vector<hpack::header_t> headers{};
+			headers.reserve(4 + req.hr.header_fields.size());
+			headers.emplace_back(":method", req.hr.method);
+			headers.emplace_back(":scheme", key.tls ? "https" : "http");
+			headers.emplace_back(":authority", req.hr.getHost());
+			headers.emplace_back(":path", req.hr.path_is_encoded ? req.hr.path : urlenc::encodePathWithQuery(req.hr.path));
+			bool have_content_length = false;
+			for (const auto& field : req.hr.header_fields)
+			{
+				std::string name = field.first;
+				string::lower(name);
+				if (name == "host"
+					|| name == "connection"
+					|| name == "keep-alive"
+					|| name == "proxy-connection"
+					|| name == "transfer-encoding"
+					|| name == "upgrade"
+					)
+				{
+					continue; // Connection-specific, not allowed in HTTP/2.
+				}
+				have_content_length |= (name == "content-length");
+				headers.emplace_back(std::move(name), field.second);
+			}
+			const bool has_body = !req.hr.body.empty();
+			if (has_body && !have_content_length)
+			{
+				headers.emplace_back("content-length", std::to_string(req.hr.body.size()));
+			}
+
+			const std::string block = hpack_encoder.encode(headers);
+			size_t offset = 0;
+			do
+			{
+				const size_t chunk = std::min<size_t>(block.size() - offset, peer_max_frame_size);
+				uint8_t flags = 0;
+				if (offset + chunk == block.size())
+				{
+					flags |= H2_FLAG_END_HEADERS;
+				}
+				if (offset == 0 && !has_body)
+				{
+					flags |= H2_FLAG_END_STREAM;
+				}
+				h2_appendFrame(send_buf, offset == 0 ? H2_HEADERS : H2_CONTINUATION, flags, stream_id, block.data() + offset, chunk);
+				offset += chunk;
+			} while (offset != block.size());
+
+			streams.emplace(stream_id, Stream{ std::move(req), {}, false, 0, peer_initial_window_size });
+		}
+		for (auto& e : streams)
+		{
+			if (e.second.body_sent != e.second.req.hr.body.size())
+			{
+				h2_sendBody(send_buf, e.first, e.second);
+			}
+		}
+		if (!send_buf.empty())
+		{
+			if (!was_waiting)
+			{
+				last_activity = time::unixSeconds();
+			}
+			sock->send(send_buf);
+			send_buf.clear();
+		}
+		if (goaway_received
+			&& streams.empty()
+			)
+		{
+			// The server won't take any more requests on this connection.
+			onConnectionLost();
+		}
+	}
+
+	void HttpConnectionTask::h2_sendBody(std::string& out, uint32_t stream_id, Stream& stream) SOUP_EXCAL
+	{
+		const auto& body = stream.req.hr.body;
+		while (stream.body_sent != body.size())
+		{
+			const int64_t window = std::min(conn_send_window, stream.send_window);
+			if (window <= 0)
+			{
+				break;
+			}
+			const size_t chunk = std::min<size_t>({ body.size() - stream.body_sent, peer_max_frame_size, static_cast<size_t>(window) });
+			const bool last = (stream.body_sent + chunk == body.size());
+			h2_appendFrame(out, H2_DATA, last ? H2_FLAG_END_STREAM : 0, stream_id, body.data() + stream.body_sent, chunk);
+			stream.body_sent += chunk;
+			conn_send_window -= chunk;
+			stream.send_window -= chunk;
+		}
+	}
+
+	void HttpConnectionTask::h2_goaway(uint32_t error_code) SOUP_EXCAL
+	{
+		char payload[8];
+		h2_writeU32(&payload[0], 0); // We don't accept streams initiated by the server.
+		h2_writeU32(&payload[4], error_code);
+		h2_appendFrame(send_buf, H2_GOAWAY, 0, 0, payload, sizeof(payload));
+		sock->send(send_buf);
+		send_buf.clear();
+	}
+
+	void HttpConnectionTask::h2_appendFrame(std::string& out, uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, size_t length) SOUP_EXCAL
+	{
+		char header[9];
+		h2_writeU32(&header[0], static_cast<uint32_t>(length << 8));
+		header[3] = static_cast<char>(type);
+		header[4] = static_cast<char>(flags);
+		h2_writeU32(&header[5], stream_id);
+		out.append(header, sizeof(header));
+		out.append(payload, length);
+	}
+
+	std::string HttpConnectionTask::toString() const SOUP_EXCAL
+	{
+		std::string str = ObfusString("HttpConnectionTask").str();
+		str.push_back('(');
+		str.append(key.host);
+		str.push_back(':');
+		str.append(std::to_string(key.port));
+		str.append("): ");
+		switch (state)
+		{
+		case CONNECTING: str.append(ObfusString("CONNECTING").str()); break;
+		case HANDSHAKING: str.append(ObfusString("HANDSHAKING").str()); break;
+		case ACTIVE: str.append(protocol == HTTP_2 ? ObfusString("ACTIVE (HTTP/2)").str() : ObfusString("ACTIVE (HTTP/1.1)").str()); break;
+		case CLOSED: str.append(ObfusString("CLOSED").str()); break;
+		}
+		str.append(", ");
+		str.append(std::to_string(getNumPending()));
+		str.append(" pending");
+		return str;
+	}
+}
+
+#endif
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "base.hpp"
+#if !SOUP_WASM
+
+#include <deque>
+#include <unordered_map>
+
+#include "Task.hpp"
+
+#include "ConnectionPool.hpp"
+#include "hpack.hpp"
+#include "HttpRequest.hpp"
+#include "HttpResponse.hpp"
+#include "HttpResponseParser.hpp"
+#include "netConnectTask.hpp"
+#include "Optional.hpp"
+#include "SharedPtr.hpp"
+
+NAMESPACE_SOUP
+{
+	// Maintains a connection to a remote over which many requests can be in flight at once.
+	// HTTP/2 is used if the server selects it via ALPN (or http2_prior_knowledge is set for non-TLS connections), otherwise requests are pipelined over HTTP/1.1.
+	// Only GET, HEAD & OPTIONS requests are pipelined or retried on a new connection if the connection is lost before they're answered.
+	class HttpConnectionTask : public Task
+	{
+	public:
+		using callback_t = void(*)(Optional<HttpResponse>&&, Capture&&) SOUP_EXCAL;
+
+		enum State : uint8_t
+		{
+			CONNECTING,
+			HANDSHAKING,
+			ACTIVE,
+			CLOSED,
+		};
+
+		enum Protocol : uint8_t
+		{
+			UNKNOWN,
+			HTTP_1_1,
+			HTTP_2,
+		};
+
+		ConnectionPool::Key key;
+		bool prefer_ipv6 = false;
+		bool http2_prior_knowledge = false;
+		size_t max_pipeline_depth = 16;
+		unsigned int idle_timeout = 60; // Seconds without requests after which the connection is closed.
+		unsigned int response_timeout = 30; // Seconds without receiving anything while waiting for responses after which the connection is considered lost.
+		State state = CONNECTING;
+		Protocol protocol = UNKNOWN;
+
+	protected:
+		struct Request
+		{
+			HttpRequest hr;
+			callback_t callback;
+			Capture cap;
+			uint8_t attempts = 0;
+		};
+
+		struct Stream
+		{
+			Request req;
+			HttpResponse resp{};
+			bool got_final_headers = false;
+			size_t body_sent = 0;
+			int64_t send_window;
+			uint32_t recv_unacked = 0;
+		};
+
+		std::deque<Request> queue{}; // Requests that have not been sent yet.
+		Optional<netConnectTask> connector;
+		SharedPtr<Socket> sock;
+		std::time_t last_activity;
+		uint8_t connect_attempts = 0;
+
+		// HTTP/1.1
+		std::deque<Request> in_flight{};
+		HttpResponseParser parser{};
+
+		// HTTP/2
+		std::unordered_map<uint32_t, Stream> streams{};
+		std::string recv_buf{};
+		std::string header_block{}; // For a HEADERS frame followed by CONTINUATION frames. Never bigger than hpack_decoder.max_header_list_size.
+		uint32_t header_block_stream_id = 0;
+		bool header_block_ends_stream = false;
+		HpackEncoder hpack_encoder{};
+		HpackDecoder hpack_decoder{};
+		std::string send_buf{};
+		uint32_t next_stream_id = 1;
+		uint32_t goaway_last_stream_id = 0;
+		bool goaway_received = false;
+		uint32_t peer_max_concurrent_streams = 100; // Assumed until the server's SETTINGS say otherwise.
+		uint32_t peer_max_frame_size = 0x4000;
+		uint32_t peer_initial_window_size = 0xFFFF;
+		int64_t conn_send_window = 0xFFFF;
+		uint32_t conn_recv_unacked = 0;
+
+	public:
+		HttpConnectionTask(ConnectionPool::Key key) SOUP_EXCAL;
+
+		// Returns the connection to the remote that is shared via the scheduler's connection pool, creating it if needed.
+		[[nodiscard]] static SharedPtr<HttpConnectionTask> get(Scheduler& sched, const ConnectionPool::Key& key) SOUP_EXCAL;
+
+		// The callback is always invoked exactly once, with nothing if the request failed.
+		void submit(HttpRequest&& hr, callback_t callback, Capture&& cap = {}) SOUP_EXCAL;
+
+		[[nodiscard]] size_t getNumPending() const noexcept { return queue.size() + in_flight.size() + streams.size(); }
+
+	protected:
+		void onTick() final;
+
+		void onConnected() SOUP_EXCAL;
+		void recvLoop() SOUP_EXCAL;
+		void onData(std::string&& data) SOUP_EXCAL;
+		void flush() SOUP_EXCAL;
+		void complete(Request& req, Optional<HttpResponse>&& resp) SOUP_EXCAL;
+		void onConnectionLost() SOUP_EXCAL; // Retries what can be retried on a new connection and fails the rest.
+		void retryOrFail(Request&& req) SOUP_EXCAL;
+		void close() SOUP_EXCAL;
+		void resetProtocolState() SOUP_EXCAL;
+		[[nodiscard]] static bool isRetryable(const HttpRequest& hr) noexcept;
+
+		void h1_onData() SOUP_EXCAL;
+		void h1_flush() SOUP_EXCAL;
+
+		void h2_start() SOUP_EXCAL;
+		void h2_onData() SOUP_EXCAL;
+		[[nodiscard]] bool h2_onFrame(uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, uint32_t length) SOUP_EXCAL;
+		[[nodiscard]] bool h2_onHeaderBlock(uint32_t stream_id, bool end_stream) SOUP_EXCAL;
+		void h2_completeStream(uint32_t stream_id) SOUP_EXCAL;
+		void h2_flush() SOUP_EXCAL;
+		void h2_sendBody(std::string& out, uint32_t stream_id, Stream& stream) SOUP_EXCAL;
+		void h2_goaway(uint32_t error_code) SOUP_EXCAL;
+		static void h2_appendFrame(std::string& out, uint8_t type, uint8_t flags, uint32_t stream_id, const char* payload, size_t length) SOUP_EXCAL;
+
+	public:
+		[[nodiscard]] std::string toString() const SOUP_EXCAL final;
+	};
+}
+
+#endif
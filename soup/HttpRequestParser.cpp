@@ -0,0 +1,403 @@
+#include "HttpRequestParser.hpp"
+
+#include <cstring> // memmove
+
+#include "HttpRequest.hpp"
+#include "string.hpp"
+
+NAMESPACE_SOUP
+{
+	void HttpRequestParser::feed(std::string&& data) SOUP_EXCAL
+	{
+		if (buf.empty())
+		{
+			buf = std::move(data);
+		}
+		else
+		{
+			buf.append(data);
+		}
+	}
+
+	void HttpRequestParser::feed(const char* data, size_t size) SOUP_EXCAL
+	{
+		buf.append(data, size);
+	}
+
+	HttpRequestParser::Status HttpRequestParser::parse() SOUP_EXCAL
+	{
+		switch (state)
+		{
+		case HEAD:
+			if (auto status = parseHead(); status != COMPLETE)
+			{
+				return status;
+			}
+			if (state == DONE)
+			{
+				return COMPLETE;
+			}
+			if (state != BODY_FIXED)
+			{
+				return parseChunkedBody();
+			}
+			[[fallthrough]];
+		case BODY_FIXED:
+			if (buf.size() < body_end)
+			{
+				return NEED_MORE_DATA;
+			}
+			request_end = body_end;
+			state = DONE;
+			return COMPLETE;
+
+		case CHUNK_SIZE:
+		case CHUNK_DATA:
+		case CHUNK_DATA_END:
+		case CHUNK_TRAILERS:
+			return parseChunkedBody();
+
+		case DONE:
+			break;
+		}
+		return COMPLETE;
+	}
+
+	void HttpRequestParser::consume() noexcept
+	{
+		buf.erase(0, request_end);
+		reset();
+	}
+
+	bool HttpRequestParser::findHeader(std::string_view name, std::string_view& value) const noexcept
+	{
+		for (const auto& header : headers)
+		{
+			if (string::equalsIgnoreCase(view(header.name), name))
+			{
+				value = view(header.value);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool HttpRequestParser::isKeepAlive() const noexcept
+	{
+		if (std::string_view connection; findHeader("Connection", connection))
+		{
+			if (string::equalsIgnoreCase(connection, std::string_view("close")))
+			{
+				return false;
+			}
+			if (string::equalsIgnoreCase(connection, std::string_view("keep-alive")))
+			{
+				return true;
+			}
+		}
+		return getVersion() == "HTTP/1.1";
+	}
+
+	HttpRequest HttpRequestParser::toHttpRequest() const SOUP_EXCAL
+	{
+		HttpRequest req{};
+		req.method = getMethod();
+		req.path = getPath();
+		req.header_fields.reserve(headers.size());
+		for (const auto& header : headers)
+		{
+			req.header_fields.emplace(MimeMessage::normaliseHeaderCasing(std::string(view(header.name))), view(header.value));
+		}
+		req.body = getBody();
+		return req;
+	}
+
+	HttpRequestParser::Status HttpRequestParser::parseHead() SOUP_EXCAL
+	{
+		// Robustness: ignore empty lines preceding the request line.
+		while (scan_offset == 0
+			&& buf.compare(0, 2, "\r\n") == 0
+			)
+		{
+			buf.erase(0, 2);
+		}
+
+		// Find the end of the head, only scanning data we haven't seen before.
+		auto head_end = buf.find("\r\n\r\n", scan_offset);
+		if (head_end == std::string::npos)
+		{
+			if (buf.size() > limits.max_header_bytes)
+			{
+				return HEADERS_TOO_LARGE;
+			}
+			scan_offset = (buf.size() > 3 ? buf.size() - 3 : 0);
+			return NEED_MORE_DATA;
+		}
+		if (head_end > limits.max_header_bytes)
+		{
+			return HEADERS_TOO_LARGE;
+		}
+		SOUP_IF_UNLIKELY (buf.size() > UINT32_MAX)
+		{
+			return HEADERS_TOO_LARGE;
+		}
+
+		const char* const data = buf.data();
+		size_t i = 0;
+
+		// Request line: method SP request-target SP HTTP-version CRLF
+		const auto line_end = buf.find("\r\n", i);
+		auto sp1 = buf.find(' ', i);
+		if (sp1 == std::string::npos || sp1 == i || sp1 > line_end)
+		{
+			return MALFORMED;
+		}
+		auto sp2 = buf.find(' ', sp1 + 1);
+		if (sp2 == std::string::npos || sp2 == sp1 + 1 || sp2 > line_end)
+		{
+			return MALFORMED;
+		}
+		method = Span{ static_cast<uint32_t>(i), static_cast<uint32_t>(sp1 - i) };
+		path = Span{ static_cast<uint32_t>(sp1 + 1), static_cast<uint32_t>(sp2 - (sp1 + 1)) };
+		version = Span{ static_cast<uint32_t>(sp2 + 1), static_cast<uint32_t>(line_end - (sp2 + 1)) };
+		if (getVersion().substr(0, 7) != "HTTP/1.")
+		{
+			return MALFORMED;
+		}
+
+		// Header fields: field-name ":" OWS field-value OWS CRLF
+		headers.clear();
+		bool chunked = false;
+		bool have_content_length = false;
+		uint64_t content_length = 0;
+		for (i = line_end + 2; i < head_end + 2; )
+		{
+			const auto field_end = buf.find("\r\n", i);
+			if (data[i] == ' ' || data[i] == '\t') // Obsolete line folding
+			{
+				return MALFORMED;
+			}
+			const auto colon = buf.find(':', i);
+			if (colon == std::string::npos || colon == i || colon > field_end)
+			{
+				return MALFORMED;
+			}
+			if (data[colon - 1] == ' ' || data[colon - 1] == '\t')
+			{
+				return MALFORMED;
+			}
+			size_t value_begin = colon + 1;
+			size_t value_end = field_end;
+			while (value_begin != value_end && (data[value_begin] == ' ' || data[value_begin] == '\t'))
+			{
+				++value_begin;
+			}
+			while (value_end != value_begin && (data[value_end - 1] == ' ' || data[value_end - 1] == '\t'))
+			{
+				--value_end;
+			}
+			if (headers.size() == limits.max_num_headers)
+			{
+				return HEADERS_TOO_LARGE;
+			}
+			headers.emplace_back(HeaderSpans{
+				Span{ static_cast<uint32_t>(i), static_cast<uint32_t>(colon - i) },
+				Span{ static_cast<uint32_t>(value_begin), static_cast<uint32_t>(value_end - value_begin) },
+			});
+
+			const auto name = getHeaderName(headers.size() - 1);
+			const auto value = getHeaderValue(headers.size() - 1);
+			if (string::equalsIgnoreCase(name, std::string_view("Transfer-Encoding")))
+			{
+				if (!string::equalsIgnoreCase(value, std::string_view("chunked")))
+				{
+					return UNSUPPORTED_TRANSFER_ENCODING;
+				}
+				chunked = true;
+			}
+			else if (string::equalsIgnoreCase(name, std::string_view("Content-Length")))
+			{
+				if (value.empty())
+				{
+					return MALFORMED;
+				}
+				uint64_t len = 0;
+				for (const auto c : value)
+				{
+					if (!string::isNumberChar(c))
+					{
+						return MALFORMED;
+					}
+					if (len > limits.max_body_bytes)
+					{
+						return BODY_TOO_LARGE;
+					}
+					len *= 10;
+					len += (c - '0');
+				}
+				if (have_content_length && len != content_length)
+				{
+					return MALFORMED;
+				}
+				have_content_length = true;
+				content_length = len;
+			}
+
+			i = field_end + 2;
+		}
+
+		if (chunked && have_content_length)
+		{
+			// Ambiguous framing is a request smuggling vector.
+			return MALFORMED;
+		}
+
+		body_begin = head_end + 4;
+		body_end = body_begin;
+		if (chunked)
+		{
+			read_offset = body_begin;
+			state = CHUNK_SIZE;
+		}
+		else if (have_content_length)
+		{
+			if (content_length > limits.max_body_bytes)
+			{
+				return BODY_TOO_LARGE;
+			}
+			body_end = body_begin + static_cast<size_t>(content_length);
+			state = BODY_FIXED;
+		}
+		else
+		{
+			request_end = body_begin;
+			state = DONE;
+		}
+		return COMPLETE;
+	}
+
+	HttpRequestParser::Status HttpRequestParser::parseChunkedBody() noexcept
+	{
+		// The body is decoded in place: the data of each chunk is moved back to directly follow the previous one.
+		while (true)
+		{
+			switch (state)
+			{
+			case CHUNK_SIZE:
+				{
+					const auto line_end = buf.find("\r\n", read_offset);
+					if (line_end == std::string::npos)
+					{
+						if (buf.size() - read_offset > limits.max_header_bytes)
+						{
+							return HEADERS_TOO_LARGE;
+						}
+						return NEED_MORE_DATA;
+					}
+					// Parsing by hand so the size is checked against the limit before each digit is added, which also rules out overflow.
+					const size_t max_size = limits.max_body_bytes - (body_end - body_begin);
+					const char* end = buf.c_str() + read_offset;
+					if (!string::isHexDigitChar(*end))
+					{
+						return MALFORMED;
+					}
+					uint64_t size = 0;
+					for (; string::isHexDigitChar(*end); ++end)
+					{
+						if (size > (max_size >> 4))
+						{
+							return BODY_TOO_LARGE;
+						}
+						size <<= 4;
+						size |= (*end <= '9' ? *end - '0' : (*end | 0x20) - 'a' + 10);
+					}
+					if (*end != ';' && *end != '\r')
+					{
+						return MALFORMED;
+					}
+					read_offset = line_end + 2;
+					if (size == 0)
+					{
+						state = CHUNK_TRAILERS;
+						break;
+					}
+					if (size > max_size)
+					{
+						return BODY_TOO_LARGE;
+					}
+					chunk_remaining = size;
+					state = CHUNK_DATA;
+				}
+				break;
+
+			case CHUNK_DATA:
+				{
+					const auto avail = static_cast<size_t>(std::min<uint64_t>(buf.size() - read_offset, chunk_remaining));
+					if (body_end != read_offset)
+					{
+						memmove(&buf[body_end], &buf[read_offset], avail);
+					}
+					body_end += avail;
+					read_offset += avail;
+					chunk_remaining -= avail;
+					if (chunk_remaining != 0)
+					{
+						return NEED_MORE_DATA;
+					}
+					state = CHUNK_DATA_END;
+				}
+				[[fallthrough]];
+			case CHUNK_DATA_END:
+				if (buf.size() - read_offset < 2)
+				{
+					return NEED_MORE_DATA;
+				}
+				if (buf[read_offset] != '\r' || buf[read_offset + 1] != '\n')
+				{
+					return MALFORMED;
+				}
+				read_offset += 2;
+				state = CHUNK_SIZE;
+				break;
+
+			case CHUNK_TRAILERS:
+				{
+					// Trailer fields are not exposed; we just skip to the empty line that ends the message.
+					const auto line_end = buf.find("\r\n", read_offset);
+					if (line_end == std::string::npos)
+					{
+						if (buf.size() - read_offset > limits.max_header_bytes)
+						{
+							return HEADERS_TOO_LARGE;
+						}
+						return NEED_MORE_DATA;
+					}
+					const bool empty_line = (line_end == read_offset);
+					read_offset = line_end + 2;
+					if (empty_line)
+					{
+						request_end = read_offset;
+						state = DONE;
+						return COMPLETE;
+					}
+				}
+				break;
+
+			default:
+				return COMPLETE;
+			}
+		}
+	}
+
+	void HttpRequestParser::reset() noexcept
+	{
+		state = HEAD;
+		scan_offset = 0;
+		headers.clear();
+		body_begin = 0;
+		body_end = 0;
+		read_offset = 0;
+		chunk_remaining = 0;
+		request_end = 0;
+	}
+}
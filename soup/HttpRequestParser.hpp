@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base.hpp"
+#include "fwd.hpp"
+
+NAMESPACE_SOUP
+{
+	// Incremental HTTP/1.x request parser. Data can be fed in arbitrary pieces, and multiple (pipelined) requests may be buffered at once.
+	// The request line, headers and body are only indexed, so accessors return views into the buffer which remain valid until the next feed or consume.
+	class HttpRequestParser
+	{
+	public:
+		enum Status : uint8_t
+		{
+			NEED_MORE_DATA,
+			COMPLETE,
+			MALFORMED,
+			HEADERS_TOO_LARGE,
+			BODY_TOO_LARGE,
+			UNSUPPORTED_TRANSFER_ENCODING,
+		};
+
+		struct Limits
+		{
+			size_t max_header_bytes = 0x4000; // Request line, headers & chunked trailers
+			size_t max_num_headers = 100;
+			size_t max_body_bytes = 0x100000;
+		};
+
+		Limits limits{};
+		std::string buf{}; // Received data that has not been consumed yet.
+
+	protected:
+		struct Span
+		{
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		struct HeaderSpans
+		{
+			Span name;
+			Span value;
+		};
+
+		enum State : uint8_t
+		{
+			HEAD,
+			BODY_FIXED,
+			CHUNK_SIZE,
+			CHUNK_DATA,
+			CHUNK_DATA_END,
+			CHUNK_TRAILERS,
+			DONE,
+		};
+
+		State state = HEAD;
+		size_t scan_offset = 0;
+		Span method{};
+		Span path{};
+		Span version{};
+		std::vector<HeaderSpans> headers{};
+		size_t body_begin = 0;
+		size_t body_end = 0; // For chunked bodies, this is where the next decoded byte will be written.
+		size_t read_offset = 0; // For chunked bodies, this is where the next encoded byte will be read.
+		uint64_t chunk_remaining = 0;
+		size_t request_end = 0;
+
+	public:
+		void feed(std::string&& data) SOUP_EXCAL;
+		void feed(const char* data, size_t size) SOUP_EXCAL;
+
+		// Tries to parse the request at the front of the buffer. Safe to call again after feeding more data.
+		[[nodiscard]] Status parse() SOUP_EXCAL;
+
+		// Removes the completed request from the buffer so the next one can be parsed.
+		void consume() noexcept;
+
+		// The following may only be used after parse returned COMPLETE.
+
+		[[nodiscard]] std::string_view getMethod() const noexcept { return view(method); }
+		[[nodiscard]] std::string_view getPath() const noexcept { return view(path); }
+		[[nodiscard]] std::string_view getVersion() const noexcept { return view(version); }
+		[[nodiscard]] size_t getNumHeaders() const noexcept { return headers.size(); }
+		[[nodiscard]] std::string_view getHeaderName(size_t i) const noexcept { return view(headers[i].name); }
+		[[nodiscard]] std::string_view getHeaderValue(size_t i) const noexcept { return view(headers[i].value); }
+		[[nodiscard]] bool findHeader(std::string_view name, std::string_view& value) const noexcept; // Case-insensitive. Finds the first occurrence.
+		[[nodiscard]] std::string_view getBody() const noexcept { return std::string_view(buf.data() + body_begin, body_end - body_begin); }
+		[[nodiscard]] bool isKeepAlive() const noexcept;
+
+		[[nodiscard]] HttpRequest toHttpRequest() const SOUP_EXCAL;
+
+	protected:
+		[[nodiscard]] std::string_view view(Span span) const noexcept
+		{
+			return std::string_view(buf.data() + span.offset, span.length);
+		}
+
+		[[nodiscard]] Status parseHead() SOUP_EXCAL;
+		[[nodiscard]] Status parseChunkedBody() noexcept;
+		void reset() noexcept;
+	};
+}
@@ -2,10 +2,10 @@
 
 #if !SOUP_WASM
 #include "format.hpp"
+#include "HttpConnectionTask.hpp"
 #include "log.hpp"
 #include "netStatus.hpp"
 #include "ObfusString.hpp"
-#include "ReuseTag.hpp"
 #include "Scheduler.hpp"
 #include "time.hpp"
 #else
@@ -30,41 +30,65 @@ NAMESPACE_SOUP
 	{
 	}
 
+	HttpRequestTask::~HttpRequestTask()
+	{
+		if (pooled)
+		{
+			if (auto sched = Scheduler::get())
+			{
+				if (sock)
+				{
+					// The socket may still be waiting for the response, which must not be delivered to us anymore.
+					sched->connection_pool.discard(*sock);
+					sock->setWorkDone();
+					sock->close();
+				}
+				else
+				{
+					sched->connection_pool.unreserve(getPoolKey());
+				}
+			}
+		}
+	}
+
 	void HttpRequestTask::onTick()
 	{
 		switch (state)
 		{
 		case START:
-			if (!dont_use_reusable_sockets)
+			if (multiplex)
 			{
-				sock = Scheduler::get()->findReusableSocket(hr.getHost(), hr.port, hr.use_tls);
-				if (sock)
+				state = AWAIT_MULTIPLEXED;
+				HttpConnectionTask::get(*Scheduler::get(), getPoolKey())->submit(HttpRequest(hr), [](Optional<HttpResponse>&& res, Capture&& cap) SOUP_EXCAL
 				{
-					if (sock->custom_data.getStructFromMap(ReuseTag).is_busy)
-					{
-						state = WAIT_TO_REUSE;
-					}
-					else
-					{
-						sendRequestOnReusedSocket();
-					}
-					break;
-				}
-				// Another task to the same remote may be in the CONNECTING state at this point,
-				// but it will be faster (or at least the same speed) to just make a one-off socket instead of waiting to resue.
+					cap.get<HttpRequestTask*>()->await_response_finish_reason = netStatusToString(res.has_value() ? NET_OK : NET_FAIL_L7_PREMATURE_END);
+					cap.get<HttpRequestTask*>()->fulfil(std::move(res));
+				}, this);
+				break;
 			}
-			cannotRecycle(); // transition to CONNECTING state
+			if (!dont_use_reusable_sockets
+				&& tryReuse()
+				)
+			{
+				break;
+			}
+			cannotRecycle(); // transition to CONNECTING or WAIT_TO_REUSE state
 			break;
 
 		case WAIT_TO_REUSE:
-			if (sock->isWorkDoneOrClosed())
+			// The connection pool has reached its limit for this remote, so wait for a connection to become idle or for room to make a new one.
+			if (!tryReuse())
 			{
-				sock.reset();
-				cannotRecycle();
-			}
-			else if (!sock->custom_data.getStructFromMap(ReuseTag).is_busy)
-			{
-				sendRequestOnReusedSocket();
+				if (time::unixSecondsSince(waiting_to_reuse_since) >= wait_to_reuse_timeout)
+				{
+					// Waited long enough, make a one-off connection instead.
+					state = CONNECTING;
+					connector.emplace(hr.getHost(), hr.port, prefer_ipv6);
+				}
+				else
+				{
+					cannotRecycle();
+				}
 			}
 			break;
 
@@ -73,21 +97,20 @@ NAMESPACE_SOUP
 			{
 				if (!connector->wasSuccessful())
 				{
+					if (pooled)
+					{
+						pooled = false;
+						Scheduler::get()->connection_pool.unreserve(getPoolKey());
+					}
 					setWorkDone();
 					return;
 				}
 				sock = connector->getSocket();
 				connector.reset();
-				if (dont_make_reusable_sockets == false
-					&& Scheduler::get()->dont_make_reusable_sockets == false
-					)
+				if (pooled)
 				{
-					// Tag socket we just created for reuse, if it's not a one-off.
-					SOUP_IF_LIKELY (!Scheduler::get()->findReusableSocket(hr.getHost(), hr.port, hr.use_tls))
-					{
-						hr.setKeepAlive();
-						sock->custom_data.getStructFromMap(ReuseTag).init(hr.getHost(), hr.port, hr.use_tls);
-					}
+					hr.setKeepAlive();
+					Scheduler::get()->connection_pool.add(getPoolKey(), *sock);
 				}
 				state = AWAIT_RESPONSE;
 				awaiting_response_since = time::unixSeconds();
@@ -113,7 +136,8 @@ NAMESPACE_SOUP
 				{
 					retry_on_broken_pipe = false;
 					//logWriteLine(soup::format("AWAIT_RESPONSE from {} - broken pipe, making a new one", hr.getHost()));
-					cannotRecycle(); // transition to CONNECTING state
+					releaseSocket();
+					cannotRecycle(); // transition to CONNECTING or WAIT_TO_REUSE state
 				}
 				else
 				{
@@ -127,27 +151,45 @@ NAMESPACE_SOUP
 						await_response_finish_reason = netStatusToString(NET_FAIL_L7_PREMATURE_END);
 					}
 					setWorkDone();
+					releaseSocket();
 				}
-				sock->close();
-				sock.reset();
 			}
 			else if (time::unixSecondsSince(awaiting_response_since) > 30)
 			{
 				//logWriteLine(soup::format("AWAIT_RESPONSE from {} - timeout", hr.getHost()));
-				sock->close();
-				sock.reset();
+				releaseSocket();
 				await_response_finish_reason = netStatusToString(NET_FAIL_L7_TIMEOUT);
 				setWorkDone();
 			}
 			break;
+
+		case AWAIT_MULTIPLEXED:
+			// HttpConnectionTask will call back.
+			break;
+		}
+	}
+
+	ConnectionPool::Key HttpRequestTask::getPoolKey() const SOUP_EXCAL
+	{
+		return ConnectionPool::Key{ hr.getHost(), hr.port, hr.use_tls };
+	}
+
+	bool HttpRequestTask::tryReuse() SOUP_EXCAL
+	{
+		sock = Scheduler::get()->connection_pool.checkout(getPoolKey());
+		if (sock)
+		{
+			sendRequestOnReusedSocket();
+			return true;
 		}
+		return false;
 	}
 
 	void HttpRequestTask::sendRequestOnReusedSocket()
 	{
 		state = AWAIT_RESPONSE;
 		retry_on_broken_pipe = true;
-		sock->custom_data.getStructFromMapConst(ReuseTag).is_busy = true;
+		pooled = true;
 		awaiting_response_since = time::unixSeconds();
 		hr.setKeepAlive();
 		hr.send(*sock);
@@ -156,10 +198,41 @@ NAMESPACE_SOUP
 
 	void HttpRequestTask::cannotRecycle()
 	{
+		pooled = false;
+		if (dont_make_reusable_sockets == false
+			&& Scheduler::get()->dont_make_reusable_sockets == false
+			)
+		{
+			if (Scheduler::get()->connection_pool.reserve(getPoolKey()))
+			{
+				pooled = true;
+			}
+			else if (!dont_use_reusable_sockets)
+			{
+				if (state != WAIT_TO_REUSE)
+				{
+					state = WAIT_TO_REUSE;
+					waiting_to_reuse_since = time::unixSeconds();
+				}
+				return;
+			}
+			// else: We're not allowed to wait for an idle connection, so make a one-off.
+		}
 		state = CONNECTING;
 		connector.emplace(hr.getHost(), hr.port, prefer_ipv6);
 	}
 
+	void HttpRequestTask::releaseSocket() SOUP_EXCAL
+	{
+		if (pooled)
+		{
+			pooled = false;
+			Scheduler::get()->connection_pool.discard(*sock);
+		}
+		sock->close();
+		sock.reset();
+	}
+
 	void HttpRequestTask::recvResponse() SOUP_EXCAL
 	{
 		HttpRequest::recvResponse(*sock, [](Socket& s, Optional<HttpResponse>&& res, Capture&& cap) SOUP_EXCAL
@@ -169,12 +242,16 @@ NAMESPACE_SOUP
 				: soup::ObfusString("Protocol Error Or Blocked By Security Solution").str() // could be better if HttpRequest::recvResponse provided a status, but whatever
 				;
 			cap.get<HttpRequestTask*>()->fulfil(std::move(res));
-			if (s.custom_data.isStructInMap(ReuseTag))
+			if (cap.get<HttpRequestTask*>()->pooled)
 			{
-				s.custom_data.getStructFromMap(ReuseTag).is_busy = false;
+				cap.get<HttpRequestTask*>()->pooled = false;
 				if (Scheduler::get()->dont_make_reusable_sockets == false)
 				{
-					s.keepAlive();
+					Scheduler::get()->connection_pool.checkin(cap.get<HttpRequestTask*>()->sock);
+				}
+				else
+				{
+					Scheduler::get()->connection_pool.discard(s);
 				}
 			}
 		}, this);
@@ -202,6 +279,7 @@ NAMESPACE_SOUP
 			break;
 
 		case AWAIT_RESPONSE: str.append(ObfusString("AWAIT_RESPONSE").str()); break;
+		case AWAIT_MULTIPLEXED: str.append(ObfusString("AWAIT_MULTIPLEXED").str()); break;
 		}
 		return str;
 	}
@@ -211,10 +289,12 @@ NAMESPACE_SOUP
 		switch (state)
 		{
 		case CONNECTING: return netStatusToString(connector->getStatus());
-		case AWAIT_RESPONSE: return isWorkDone() ? await_response_finish_reason : netStatusToString(NET_PENDING);
+		case AWAIT_RESPONSE:
+		case AWAIT_MULTIPLEXED:
+			return isWorkDone() ? await_response_finish_reason : netStatusToString(NET_PENDING);
 		default: break; // keep the compiler happy
 		}
-		// Assuming `!isWorkDone()` because the task can only finish during CONNECTING and AWAIT_RESPONSE.
+		// Assuming `!isWorkDone()` because the task can only finish during CONNECTING, AWAIT_RESPONSE and AWAIT_MULTIPLEXED.
 		return netStatusToString(NET_PENDING);
 	}
 #else
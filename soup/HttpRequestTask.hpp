@@ -7,6 +7,7 @@
 #include "HttpResponse.hpp"
 #include "Uri.hpp"
 #if !SOUP_WASM
+#include "ConnectionPool.hpp"
 #include "netConnectTask.hpp"
 #include "Optional.hpp"
 #include "SharedPtr.hpp"
@@ -24,13 +25,17 @@ NAMESPACE_SOUP
 			WAIT_TO_REUSE,
 			CONNECTING,
 			AWAIT_RESPONSE,
+			AWAIT_MULTIPLEXED,
 		};
 
 		State state = START;
 		bool prefer_ipv6 = false; // for funny things like https://api.lovense.com/api/lan/getToys
 		bool dont_use_reusable_sockets = false;
 		bool dont_make_reusable_sockets = false;
+		bool multiplex = false; // Send the request via the remote's HttpConnectionTask, which may pipeline it or use HTTP/2.
 		bool retry_on_broken_pipe = false; // internal
+		bool pooled = false; // internal, whether the socket (or the connection being made) counts towards Scheduler::connection_pool
+		unsigned int wait_to_reuse_timeout = 10; // Seconds to wait for room in the connection pool before making a one-off connection instead.
 		std::string await_response_finish_reason; // internal
 #endif
 		HttpRequest hr;
@@ -38,6 +43,7 @@ NAMESPACE_SOUP
 		Optional<netConnectTask> connector;
 		SharedPtr<Socket> sock;
 		time_t awaiting_response_since;
+		time_t waiting_to_reuse_since;
 #else
 		std::vector<const char*> headers;
 #endif
@@ -47,11 +53,17 @@ NAMESPACE_SOUP
 		HttpRequestTask(std::string host, std::string path);
 
 #if !SOUP_WASM
+		// If the task is destroyed before it's done, e.g. because it threw, what it holds in the connection pool is given back, provided this happens on the scheduler's thread.
+		~HttpRequestTask();
+
 		void onTick() final;
 
 	protected:
+		[[nodiscard]] ConnectionPool::Key getPoolKey() const SOUP_EXCAL;
+		bool tryReuse() SOUP_EXCAL;
 		void sendRequestOnReusedSocket();
 		void cannotRecycle();
+		void releaseSocket() SOUP_EXCAL;
 
 		void recvResponse() SOUP_EXCAL;
 
@@ -0,0 +1,244 @@
+#include "HttpResponseParser.hpp"
+
+#include "string.hpp"
+
+NAMESPACE_SOUP
+{
+	void HttpResponseParser::feed(std::string&& data) SOUP_EXCAL
+	{
+		if (buf.empty())
+		{
+			buf = std::move(data);
+		}
+		else
+		{
+			buf.append(data);
+		}
+	}
+
+	void HttpResponseParser::feed(const char* data, size_t size) SOUP_EXCAL
+	{
+		buf.append(data, size);
+	}
+
+	HttpResponseParser::Status HttpResponseParser::parse(bool head_request) SOUP_EXCAL
+	{
+		while (true)
+		{
+			switch (state)
+			{
+			case HEAD:
+				if (auto status = parseHead(head_request); status != COMPLETE)
+				{
+					return status;
+				}
+				break;
+
+			case BODY_FIXED:
+				if (buf.size() < remaining)
+				{
+					return NEED_MORE_DATA;
+				}
+				resp.body.append(buf, 0, static_cast<size_t>(remaining));
+				buf.erase(0, static_cast<size_t>(remaining));
+				state = DONE;
+				break;
+
+			case BODY_UNTIL_CLOSE:
+				if (resp.body.size() + buf.size() > max_body_bytes)
+				{
+					return TOO_LARGE;
+				}
+				resp.body.append(buf);
+				buf.clear();
+				return NEED_MORE_DATA;
+
+			case CHUNK_SIZE:
+				{
+					const auto line_end = buf.find("\r\n");
+					if (line_end == std::string::npos)
+					{
+						return buf.size() > max_header_bytes ? TOO_LARGE : NEED_MORE_DATA;
+					}
+					const char* end;
+					auto size = string::toIntEx<uint64_t, 16>(buf.c_str(), 0, &end);
+					if (!size.has_value()
+						|| (*end != ';' && *end != '\r' && *end != ' ')
+						)
+					{
+						return MALFORMED;
+					}
+					if (*size > max_body_bytes - resp.body.size())
+					{
+						return TOO_LARGE;
+					}
+					buf.erase(0, line_end + 2);
+					remaining = *size;
+					state = (remaining == 0 ? CHUNK_TRAILERS : CHUNK_DATA);
+				}
+				break;
+
+			case CHUNK_DATA:
+				if (buf.size() < remaining + 2)
+				{
+					return NEED_MORE_DATA;
+				}
+				if (buf[static_cast<size_t>(remaining)] != '\r' || buf[static_cast<size_t>(remaining) + 1] != '\n')
+				{
+					return MALFORMED;
+				}
+				resp.body.append(buf, 0, static_cast<size_t>(remaining));
+				buf.erase(0, static_cast<size_t>(remaining) + 2);
+				state = CHUNK_SIZE;
+				break;
+
+			case CHUNK_TRAILERS:
+				{
+					const auto line_end = buf.find("\r\n");
+					if (line_end == std::string::npos)
+					{
+						return buf.size() > max_header_bytes ? TOO_LARGE : NEED_MORE_DATA;
+					}
+					buf.erase(0, line_end + 2);
+					if (line_end == 0)
+					{
+						state = DONE;
+					}
+				}
+				break;
+
+			case DONE:
+				return COMPLETE;
+			}
+		}
+	}
+
+	HttpResponseParser::Status HttpResponseParser::finish() noexcept
+	{
+		if (state == BODY_UNTIL_CLOSE)
+		{
+			resp.body.append(buf);
+			buf.clear();
+			state = DONE;
+		}
+		return state == DONE ? COMPLETE : MALFORMED;
+	}
+
+	void HttpResponseParser::consume() noexcept
+	{
+		resp = HttpResponse{};
+		state = HEAD;
+		remaining = 0;
+	}
+
+	bool HttpResponseParser::isKeepAlive() const noexcept
+	{
+		if (auto connection = resp.header_fields.find("Connection"); connection != resp.header_fields.end())
+		{
+			return !string::equalsIgnoreCase(connection->second, std::string("close"));
+		}
+		return true;
+	}
+
+	HttpResponseParser::Status HttpResponseParser::parseHead(bool head_request) SOUP_EXCAL
+	{
+		const auto head_end = buf.find("\r\n\r\n");
+		if (head_end == std::string::npos)
+		{
+			return buf.size() > max_header_bytes ? TOO_LARGE : NEED_MORE_DATA;
+		}
+		if (head_end > max_header_bytes)
+		{
+			return TOO_LARGE;
+		}
+
+		// Status line: HTTP-version SP status-code SP [ reason-phrase ] CRLF
+		const auto line_end = buf.find("\r\n");
+		if (buf.compare(0, 7, "HTTP/1.") != 0
+			|| line_end < 12
+			|| buf[8] != ' '
+			|| !string::isNumberChar(buf[9]) || !string::isNumberChar(buf[10]) || !string::isNumberChar(buf[11])
+			|| (line_end > 12 && buf[12] != ' ')
+			)
+		{
+			return MALFORMED;
+		}
+		resp.status_code = static_cast<uint16_t>((buf[9] - '0') * 100 + (buf[10] - '0') * 10 + (buf[11] - '0'));
+		resp.status_text = (line_end > 12 ? buf.substr(13, line_end - 13) : std::string());
+		const bool http_1_0 = (buf[7] == '0');
+
+		resp.header_fields.clear();
+		for (size_t i = line_end + 2; i < head_end + 2; )
+		{
+			const auto field_end = buf.find("\r\n", i);
+			const auto colon = buf.find(':', i);
+			SOUP_IF_UNLIKELY (colon > field_end || colon == i)
+			{
+				return MALFORMED;
+			}
+			size_t value_begin = colon + 1;
+			size_t value_end = field_end;
+			while (value_begin != value_end && (buf[value_begin] == ' ' || buf[value_begin] == '\t'))
+			{
+				++value_begin;
+			}
+			while (value_end != value_begin && (buf[value_end - 1] == ' ' || buf[value_end - 1] == '\t'))
+			{
+				--value_end;
+			}
+			resp.header_fields.emplace(MimeMessage::normaliseHeaderCasing(buf.substr(i, colon - i)), buf.substr(value_begin, value_end - value_begin));
+			i = field_end + 2;
+		}
+		buf.erase(0, head_end + 4);
+
+		if (resp.status_code / 100 == 1)
+		{
+			// Interim response, e.g. 100 Continue. Skip it.
+			resp.header_fields.clear();
+			return COMPLETE;
+		}
+
+		if (head_request
+			|| resp.status_code == 204
+			|| resp.status_code == 304
+			)
+		{
+			state = DONE;
+		}
+		else if (auto te = resp.header_fields.find("Transfer-Encoding"); te != resp.header_fields.end())
+		{
+			if (!string::equalsIgnoreCase(te->second, std::string("chunked"))
+				|| resp.hasHeader("Content-Length") // Ambiguous framing, see RFC 9112 § 6.3.
+				)
+			{
+				return MALFORMED;
+			}
+			state = CHUNK_SIZE;
+		}
+		else if (auto cl = resp.header_fields.find("Content-Length"); cl != resp.header_fields.end())
+		{
+			auto len = string::toIntOpt<uint64_t>(cl->second, string::TI_FULL);
+			if (!len.has_value())
+			{
+				return MALFORMED;
+			}
+			if (*len > max_body_bytes)
+			{
+				return TOO_LARGE;
+			}
+			remaining = *len;
+			state = BODY_FIXED;
+		}
+		else
+		{
+			state = BODY_UNTIL_CLOSE;
+		}
+		if (http_1_0
+			&& !resp.hasHeader("Connection")
+			)
+		{
+			resp.header_fields.emplace("Connection", "close");
+		}
+		return COMPLETE;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "base.hpp"
+
+#include "HttpResponse.hpp"
+
+NAMESPACE_SOUP
+{
+	// Incremental HTTP/1.x response parser. Data can be fed in arbitrary pieces, and whatever follows a response stays buffered for the next one, so pipelined responses can be read off one connection.
+	class HttpResponseParser
+	{
+	public:
+		enum Status : uint8_t
+		{
+			NEED_MORE_DATA,
+			COMPLETE,
+			MALFORMED,
+			TOO_LARGE,
+		};
+
+		size_t max_header_bytes = 0x10000; // Status line, headers & chunked trailers
+		size_t max_body_bytes = 0x4000000;
+
+		std::string buf{}; // Received data that has not been parsed yet.
+		HttpResponse resp{}; // The response, once parse returned COMPLETE.
+
+	protected:
+		enum State : uint8_t
+		{
+			HEAD,
+			BODY_FIXED,
+			BODY_UNTIL_CLOSE,
+			CHUNK_SIZE,
+			CHUNK_DATA,
+			CHUNK_TRAILERS,
+			DONE,
+		};
+
+		State state = HEAD;
+		uint64_t remaining = 0;
+
+	public:
+		void feed(std::string&& data) SOUP_EXCAL;
+		void feed(const char* data, size_t size) SOUP_EXCAL;
+
+		// Tries to parse the response at the front of the buffer. Safe to call again after feeding more data.
+		// A response to a HEAD request has no body, even if it has a Content-Length.
+		[[nodiscard]] Status parse(bool head_request = false) SOUP_EXCAL;
+
+		// To be called when the connection was closed. Completes a response whose body is delimited by the connection closing.
+		[[nodiscard]] Status finish() noexcept;
+
+		// Resets the parser for the next response. The data following the previous response remains buffered.
+		void consume() noexcept;
+
+		[[nodiscard]] bool isKeepAlive() const noexcept; // May only be used after parse returned COMPLETE.
+
+	protected:
+		[[nodiscard]] Status parseHead(bool head_request) SOUP_EXCAL;
+	};
+}
@@ -0,0 +1,891 @@
+#include "InflateStream.hpp"
+
+#include <algorithm> // min
+#include <cstring> // memcpy, memmove, memset
+
+#include "adler32.hpp"
+#include "crc32.hpp"
+#include "Endian.hpp"
+
+NAMESPACE_SOUP
+{
+	// Table entry layout: bits 0-4 = number of bits to consume, bits 5-7 = kind, bits 8-11 = extra bits, bits 16-31 = literal(s) or base.
+	enum : uint32_t
+	{
+		KIND_LITERAL = 1 << 5,
+		KIND_LITERAL2 = 2 << 5, // Two literals decoded in one lookup.
+		KIND_LENGTH = 3 << 5,
+		KIND_END = 4 << 5,
+		KIND_DISTANCE = 5 << 5,
+		KIND_INVALID = 6 << 5,
+
+		KIND_MASK = 7 << 5,
+		NUM_BITS_MASK = 0x1f,
+	};
+
+	[[nodiscard]] static uint32_t makeLitlenEntry(unsigned int sym) noexcept
+	{
+		if (sym < 256)
+		{
+			return KIND_LITERAL | (sym << 16);
+		}
+		if (sym == 256)
+		{
+			return KIND_END;
+		}
+		if (sym < 286)
+		{
+			return KIND_LENGTH | (deflate::length_extra_bits[sym - 257] << 8) | (deflate::length_base[sym - 257] << 16);
+		}
+		return KIND_INVALID;
+	}
+
+	[[nodiscard]] static uint32_t makeDistanceEntry(unsigned int sym) noexcept
+	{
+		if (sym < 30)
+		{
+			return KIND_DISTANCE | (deflate::distance_extra_bits[sym] << 8) | (deflate::distance_base[sym] << 16);
+		}
+		return KIND_INVALID;
+	}
+
+	[[nodiscard]] static uint32_t makeCodeLengthEntry(unsigned int sym) noexcept
+	{
+		return KIND_LITERAL | (sym << 16);
+	}
+
+	[[nodiscard]] static uint64_t loadLittleEndian64(const uint8_t* p) noexcept
+	{
+		uint64_t val;
+		memcpy(&val, p, sizeof(val));
+		if constexpr (ENDIAN_NATIVE == ENDIAN_BIG)
+		{
+			val = Endianness::invert(val);
+		}
+		return val;
+	}
+
+	void InflateStream::feed(const void* data, size_t size) SOUP_EXCAL
+	{
+		// Drop input we're done with, but keep the whole bytes still in the bit buffer as they may be given back by alignToByte.
+		const size_t discard = in_pos - (bitcnt >> 3);
+		if (discard != 0)
+		{
+			in.erase(0, discard);
+			in_pos -= discard;
+			in_discarded += discard;
+		}
+		in.append(static_cast<const char*>(data), size);
+	}
+
+	size_t InflateStream::read(void* out, size_t max) SOUP_EXCAL
+	{
+		if (buf.empty())
+		{
+			buf.resize(BUFFER_SIZE + 32); // Slack for copyMatch to overshoot.
+		}
+		size_t n = 0;
+		while (true)
+		{
+			if (const size_t take = std::min(out_pos - out_read, max - n); take != 0)
+			{
+				memcpy(static_cast<uint8_t*>(out) + n, buf.data() + out_read, take);
+				out_read += take;
+				n += take;
+			}
+			if (n == max
+				|| status != NEED_MORE_DATA
+				)
+			{
+				break;
+			}
+			if (isBufferFull())
+			{
+				// All output has been read, so only the history window needs to be kept.
+				updateChecksum();
+				memmove(buf.data(), buf.data() + out_pos - WINDOW_SIZE, WINDOW_SIZE);
+				out_pos = WINDOW_SIZE;
+				out_read = WINDOW_SIZE;
+				checksum_pos = WINDOW_SIZE;
+			}
+			const auto prev_out_pos = out_pos;
+			decode();
+			if (out_pos == prev_out_pos
+				&& status == NEED_MORE_DATA
+				)
+			{
+				break;
+			}
+		}
+		return n;
+	}
+
+	InflateStream::Status InflateStream::getStatus() const noexcept
+	{
+		if (status == DONE
+			&& out_read != out_pos
+			)
+		{
+			return NEED_MORE_DATA;
+		}
+		return status;
+	}
+
+	void InflateStream::decode() noexcept
+	{
+		while (status == NEED_MORE_DATA)
+		{
+			switch (state)
+			{
+			case STREAM_HEADER:
+				if (!decodeStreamHeader())
+				{
+					return;
+				}
+				state = BLOCK_HEADER;
+				break;
+
+			case BLOCK_HEADER:
+				if (!ensureBits(3))
+				{
+					return;
+				}
+				final_block = takeBits(1);
+				switch (takeBits(2))
+				{
+				case 0:
+					alignToByte();
+					state = STORED_HEADER;
+					break;
+
+				case 1:
+					{
+						uint8_t lens[288];
+						memset(&lens[0], 8, 144);
+						memset(&lens[144], 9, 256 - 144);
+						memset(&lens[256], 7, 280 - 256);
+						memset(&lens[280], 8, 288 - 280);
+						SOUP_UNUSED(buildTable(litlen, lens, 288, &makeLitlenEntry));
+						pairLiterals(litlen);
+						memset(&lens[0], 5, 32);
+						SOUP_UNUSED(buildTable(dist, lens, 32, &makeDistanceEntry));
+					}
+					state = CODES;
+					break;
+
+				case 2:
+					state = DYNAMIC_HEADER;
+					break;
+
+				default:
+					setMalformed();
+					return;
+				}
+				break;
+
+			case STORED_HEADER:
+				{
+					if (in.size() - in_pos < 4)
+					{
+						return;
+					}
+					const auto p = reinterpret_cast<const uint8_t*>(in.data()) + in_pos;
+					const uint16_t len = p[0] | (p[1] << 8);
+					const uint16_t nlen = p[2] | (p[3] << 8);
+					if (len != static_cast<uint16_t>(~nlen))
+					{
+						setMalformed();
+						return;
+					}
+					in_pos += 4;
+					stored_remaining = len;
+					state = STORED_DATA;
+				}
+				[[fallthrough]];
+			case STORED_DATA:
+				{
+					const size_t n = std::min<size_t>(stored_remaining, std::min(BUFFER_SIZE - out_pos, in.size() - in_pos));
+					memcpy(buf.data() + out_pos, in.data() + in_pos, n);
+					out_pos += n;
+					in_pos += n;
+					stored_remaining -= static_cast<uint32_t>(n);
+					if (stored_remaining != 0)
+					{
+						return;
+					}
+					state = (final_block ? TRAILER : BLOCK_HEADER);
+				}
+				break;
+
+			case DYNAMIC_HEADER:
+				if (!decodeDynamicHeader())
+				{
+					return;
+				}
+				state = CODES;
+				break;
+
+			case CODES:
+				decodeCodesFast();
+				if (state == CODES
+					&& !decodeCodesSlow()
+					)
+				{
+					return;
+				}
+				break;
+
+			case TRAILER:
+				if (!decodeTrailer())
+				{
+					return;
+				}
+				break;
+
+			case END:
+				return;
+			}
+		}
+	}
+
+	bool InflateStream::decodeStreamHeader() noexcept
+	{
+		const auto p = reinterpret_cast<const uint8_t*>(in.data()) + in_pos;
+		const size_t avail = in.size() - in_pos;
+		if (format == deflate::AUTO)
+		{
+			if (avail < 2)
+			{
+				return false;
+			}
+			if (p[0] == 0x1f && p[1] == 0x8b)
+			{
+				format = deflate::GZIP;
+			}
+			else if ((p[0] & 0x0f) == 8
+				&& (p[0] >> 4) <= 7
+				&& ((p[0] << 8) | p[1]) % 31 == 0
+				)
+			{
+				format = deflate::ZLIB;
+			}
+			else
+			{
+				format = deflate::RAW;
+			}
+		}
+		size_t i = 0;
+		switch (format)
+		{
+		case deflate::AUTO:
+		case deflate::RAW:
+			break;
+
+		case deflate::ZLIB:
+			if (avail < 2)
+			{
+				return false;
+			}
+			if ((p[0] & 0x0f) != 8
+				|| (p[0] >> 4) > 7
+				|| ((p[0] << 8) | p[1]) % 31 != 0
+				|| (p[1] & 0x20) // Preset dictionaries are not supported.
+				)
+			{
+				setMalformed();
+				return false;
+			}
+			i = 2;
+			checksum_present = true;
+			checksum = adler32::INITIAL;
+			break;
+
+		case deflate::GZIP:
+			{
+				if (avail < 10)
+				{
+					return false;
+				}
+				if (p[0] != 0x1f || p[1] != 0x8b || p[2] != 8
+					|| (p[3] & 0xe0)
+					)
+				{
+					setMalformed();
+					return false;
+				}
+				const uint8_t flags = p[3];
+				i = 10;
+				if (flags & 0x04) // FEXTRA
+				{
+					if (avail < i + 2)
+					{
+						return false;
+					}
+					i += 2 + (p[i] | (p[i + 1] << 8));
+				}
+				for (const uint8_t flag : { 0x08 /* FNAME */, 0x10 /* FCOMMENT */ })
+				{
+					if (flags & flag)
+					{
+						do
+						{
+							if (i >= avail)
+							{
+								return false;
+							}
+						} while (p[i++] != 0);
+					}
+				}
+				if (flags & 0x02) // FHCRC
+				{
+					i += 2;
+				}
+				if (avail < i)
+				{
+					return false;
+				}
+				checksum_present = true;
+				checksum = crc32::INITIAL;
+			}
+			break;
+		}
+		in_pos += i;
+		return true;
+	}
+
+	bool InflateStream::decodeDynamicHeader() noexcept
+	{
+		// The header is decoded in one go; if we run out of data, we start over once more has been fed.
+		const auto saved_in_pos = in_pos;
+		const auto saved_bitbuf = bitbuf;
+		const auto saved_bitcnt = bitcnt;
+		auto restore = [&]
+		{
+			in_pos = saved_in_pos;
+			bitbuf = saved_bitbuf;
+			bitcnt = saved_bitcnt;
+			return false;
+		};
+
+		if (!ensureBits(14))
+		{
+			return restore();
+		}
+		const unsigned int num_litlen = takeBits(5) + 257;
+		const unsigned int num_dist = takeBits(5) + 1;
+		const unsigned int num_codelen = takeBits(4) + 4;
+		if (num_litlen > 286 || num_dist > 30)
+		{
+			setMalformed();
+			return false;
+		}
+
+		static constexpr uint8_t codelen_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+		uint8_t lens[286 + 30] = {};
+		for (unsigned int i = 0; i != num_codelen; ++i)
+		{
+			if (!ensureBits(3))
+			{
+				return restore();
+			}
+			lens[codelen_order[i]] = static_cast<uint8_t>(takeBits(3));
+		}
+		// The distance table is not needed yet, so it's used for the code length code.
+		if (!buildTable(dist, lens, 19, &makeCodeLengthEntry))
+		{
+			setMalformed();
+			return false;
+		}
+
+		memset(lens, 0, sizeof(lens));
+		for (unsigned int i = 0; i != num_litlen + num_dist; )
+		{
+			uint32_t entry;
+			if (!decodeSymbol(dist, entry))
+			{
+				return restore();
+			}
+			skipBits(entry & NUM_BITS_MASK);
+			const unsigned int sym = (entry >> 16);
+			if (sym < 16)
+			{
+				lens[i++] = static_cast<uint8_t>(sym);
+				continue;
+			}
+			uint8_t val = 0;
+			unsigned int rep;
+			if (sym == 16)
+			{
+				if (i == 0)
+				{
+					setMalformed();
+					return false;
+				}
+				if (!ensureBits(2))
+				{
+					return restore();
+				}
+				val = lens[i - 1];
+				rep = 3 + takeBits(2);
+			}
+			else if (sym == 17)
+			{
+				if (!ensureBits(3))
+				{
+					return restore();
+				}
+				rep = 3 + takeBits(3);
+			}
+			else
+			{
+				if (!ensureBits(7))
+				{
+					return restore();
+				}
+				rep = 11 + takeBits(7);
+			}
+			if (i + rep > num_litlen + num_dist)
+			{
+				setMalformed();
+				return false;
+			}
+			memset(&lens[i], val, rep);
+			i += rep;
+		}
+
+		if (lens[256] == 0 // No end-of-block code?
+			|| !buildTable(litlen, lens, num_litlen, &makeLitlenEntry)
+			|| !buildTable(dist, lens + num_litlen, num_dist, &makeDistanceEntry)
+			)
+		{
+			setMalformed();
+			return false;
+		}
+		pairLiterals(litlen);
+		return true;
+	}
+
+	bool InflateStream::decodeCodesSlow() noexcept
+	{
+		// Decodes symbol by symbol with bounds checks. Returns true once the end of the block is reached.
+		uint8_t* const out = reinterpret_cast<uint8_t*>(buf.data());
+		while (!isBufferFull())
+		{
+			const auto saved_in_pos = in_pos;
+			const auto saved_bitbuf = bitbuf;
+			const auto saved_bitcnt = bitcnt;
+
+			uint32_t entry;
+			if (!decodeSymbol(litlen, entry))
+			{
+				return false;
+			}
+			skipBits(entry & NUM_BITS_MASK);
+			switch (entry & KIND_MASK)
+			{
+			case KIND_LITERAL:
+				out[out_pos++] = static_cast<uint8_t>(entry >> 16);
+				break;
+
+			case KIND_LITERAL2:
+				out[out_pos++] = static_cast<uint8_t>(entry >> 16);
+				out[out_pos++] = static_cast<uint8_t>(entry >> 24);
+				break;
+
+			case KIND_LENGTH:
+				{
+					const unsigned int len_extra = ((entry >> 8) & 0xf);
+					uint32_t dist_entry;
+					if (!ensureBits(len_extra))
+					{
+						goto _need_more_data;
+					}
+					const unsigned int len = (entry >> 16) + takeBits(len_extra);
+					if (!decodeSymbol(dist, dist_entry))
+					{
+						if (status != NEED_MORE_DATA)
+						{
+							return false;
+						}
+						goto _need_more_data;
+					}
+					skipBits(dist_entry & NUM_BITS_MASK);
+					if ((dist_entry & KIND_MASK) != KIND_DISTANCE)
+					{
+						setMalformed();
+						return false;
+					}
+					const unsigned int dist_extra = ((dist_entry >> 8) & 0xf);
+					if (!ensureBits(dist_extra))
+					{
+						goto _need_more_data;
+					}
+					const unsigned int distance = (dist_entry >> 16) + takeBits(dist_extra);
+					if (distance > out_pos)
+					{
+						setMalformed();
+						return false;
+					}
+					out_pos = (copyMatch(out + out_pos, len, distance) - out);
+				}
+				break;
+
+			case KIND_END:
+				state = (final_block ? TRAILER : BLOCK_HEADER);
+				return true;
+
+			default:
+				setMalformed();
+				return false;
+			}
+			continue;
+
+		_need_more_data:
+			in_pos = saved_in_pos;
+			bitbuf = saved_bitbuf;
+			bitcnt = saved_bitcnt;
+			return false;
+		}
+		return false;
+	}
+
+	void InflateStream::decodeCodesFast() noexcept
+	{
+		// Each iteration decodes at most a length, a distance & their extra bits, which are at most 48 bits,
+		// so a single branchless refill to at least 56 bits per iteration suffices, as long as 8 bytes of input are readable.
+		// Everything is kept in locals because the output writes could otherwise alias any member.
+		if (in.size() - in_pos < 8)
+		{
+			return;
+		}
+		uint8_t* const out = reinterpret_cast<uint8_t*>(buf.data());
+		uint8_t* op = out + out_pos;
+		uint8_t* const op_limit = out + BUFFER_SIZE - 258;
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(in.data()) + in_pos;
+		const uint8_t* const p_limit = reinterpret_cast<const uint8_t*>(in.data()) + in.size() - 8;
+		const uint32_t* const litlen_fast = litlen.fast;
+		const uint32_t* const dist_fast = dist.fast;
+		uint64_t bb = bitbuf;
+		unsigned int bc = bitcnt;
+		while (p <= p_limit
+			&& op <= op_limit
+			)
+		{
+			// Bits above bc may be set after this, but they are always the bits of the next input byte, so OR-ing them in again is harmless.
+			bb |= (loadLittleEndian64(p) << bc);
+			p += ((63 - bc) >> 3);
+			bc |= 56;
+
+			uint32_t entry = litlen_fast[bb & ((1 << TABLE_BITS) - 1)];
+			if (entry == 0)
+			{
+				entry = decodeSlow(litlen, bb, 15);
+				if (entry == 0)
+				{
+					setMalformed();
+					break;
+				}
+			}
+			bb >>= (entry & NUM_BITS_MASK);
+			bc -= (entry & NUM_BITS_MASK);
+
+			if ((entry & KIND_MASK) == KIND_LITERAL)
+			{
+				*op++ = static_cast<uint8_t>(entry >> 16);
+				continue;
+			}
+			if ((entry & KIND_MASK) == KIND_LITERAL2)
+			{
+				op[0] = static_cast<uint8_t>(entry >> 16);
+				op[1] = static_cast<uint8_t>(entry >> 24);
+				op += 2;
+				continue;
+			}
+			if ((entry & KIND_MASK) != KIND_LENGTH)
+			{
+				if ((entry & KIND_MASK) == KIND_END)
+				{
+					state = (final_block ? TRAILER : BLOCK_HEADER);
+				}
+				else
+				{
+					setMalformed();
+				}
+				break;
+			}
+			const unsigned int len_extra = ((entry >> 8) & 0xf);
+			const unsigned int len = (entry >> 16) + static_cast<unsigned int>(bb & ((1u << len_extra) - 1));
+			bb >>= len_extra;
+			bc -= len_extra;
+
+			entry = dist_fast[bb & ((1 << TABLE_BITS) - 1)];
+			if (entry == 0)
+			{
+				entry = decodeSlow(dist, bb, 15);
+			}
+			if ((entry & KIND_MASK) != KIND_DISTANCE)
+			{
+				setMalformed();
+				break;
+			}
+			bb >>= (entry & NUM_BITS_MASK);
+			bc -= (entry & NUM_BITS_MASK);
+			const unsigned int dist_extra = ((entry >> 8) & 0xf);
+			const unsigned int distance = (entry >> 16) + static_cast<unsigned int>(bb & ((1u << dist_extra) - 1));
+			bb >>= dist_extra;
+			bc -= dist_extra;
+			if (distance > static_cast<size_t>(op - out))
+			{
+				setMalformed();
+				break;
+			}
+			op = copyMatch(op, len, distance);
+		}
+		out_pos = (op - out);
+		in_pos = (p - reinterpret_cast<const uint8_t*>(in.data()));
+		bitbuf = (bb & ((1ull << bc) - 1));
+		bitcnt = bc;
+	}
+
+	bool InflateStream::decodeTrailer() noexcept
+	{
+		alignToByte();
+		updateChecksum();
+		const auto p = reinterpret_cast<const uint8_t*>(in.data()) + in_pos;
+		const size_t avail = in.size() - in_pos;
+		switch (format)
+		{
+		case deflate::AUTO:
+		case deflate::RAW:
+			break;
+
+		case deflate::ZLIB:
+			if (avail < 4)
+			{
+				return false;
+			}
+			checksum_mismatch = (checksum != ((static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]));
+			in_pos += 4;
+			break;
+
+		case deflate::GZIP:
+			if (avail < 8)
+			{
+				return false;
+			}
+			checksum_mismatch = (checksum != (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24))
+				|| total_out != (p[4] | (p[5] << 8) | (p[6] << 16) | (static_cast<uint32_t>(p[7]) << 24))
+				);
+			in_pos += 8;
+			break;
+		}
+		compressed_size = in_discarded + in_pos;
+		status = DONE;
+		state = END;
+		return true;
+	}
+
+	bool InflateStream::buildTable(HuffmanTable& table, const uint8_t* lens, unsigned int num_symbols, uint32_t(*make_entry)(unsigned int sym)) noexcept
+	{
+		table.make_entry = make_entry;
+		memset(table.count, 0, sizeof(table.count));
+		for (unsigned int sym = 0; sym != num_symbols; ++sym)
+		{
+			++table.count[lens[sym]];
+		}
+		table.count[0] = 0;
+
+		int left = 1;
+		for (unsigned int len = 1; len != 16; ++len)
+		{
+			left <<= 1;
+			left -= table.count[len];
+			if (left < 0) // Over-subscribed
+			{
+				return false;
+			}
+		}
+		// Incomplete codes are allowed here; lookups of unused codes will fail.
+
+		uint16_t offsets[16];
+		offsets[1] = 0;
+		for (unsigned int len = 1; len != 15; ++len)
+		{
+			offsets[len + 1] = offsets[len] + table.count[len];
+		}
+		for (unsigned int sym = 0; sym != num_symbols; ++sym)
+		{
+			if (lens[sym] != 0)
+			{
+				table.symbols[offsets[lens[sym]]++] = static_cast<uint16_t>(sym);
+			}
+		}
+
+		memset(table.fast, 0, sizeof(table.fast));
+		unsigned int code = 0;
+		unsigned int i = 0;
+		for (unsigned int len = 1; len <= TABLE_BITS; ++len)
+		{
+			for (unsigned int n = 0; n != table.count[len]; ++n)
+			{
+				const uint32_t entry = make_entry(table.symbols[i++]) | len;
+				unsigned int rev = 0;
+				for (unsigned int b = 0; b != len; ++b)
+				{
+					rev |= ((code >> b) & 1) << (len - 1 - b);
+				}
+				for (; rev < (1u << TABLE_BITS); rev += (1u << len))
+				{
+					table.fast[rev] = entry;
+				}
+				++code;
+			}
+			code <<= 1;
+		}
+		return true;
+	}
+
+	void InflateStream::pairLiterals(HuffmanTable& table) noexcept
+	{
+		// Where a literal's code leaves enough room in the lookup for the entire code of another literal, decode both at once.
+		// Going backwards, as entries are only combined with entries at lower indices.
+		for (unsigned int i = (1 << TABLE_BITS); i-- != 0; )
+		{
+			const uint32_t first = table.fast[i];
+			if ((first & KIND_MASK) != KIND_LITERAL)
+			{
+				continue;
+			}
+			const unsigned int first_bits = (first & NUM_BITS_MASK);
+			const uint32_t second = table.fast[i >> first_bits];
+			if ((second & KIND_MASK) == KIND_LITERAL
+				&& first_bits + (second & NUM_BITS_MASK) <= TABLE_BITS
+				)
+			{
+				table.fast[i] = KIND_LITERAL2 | (first_bits + (second & NUM_BITS_MASK)) | (first & 0xff0000) | ((second & 0xff0000) << 8);
+			}
+		}
+	}
+
+	bool InflateStream::decodeSymbol(const HuffmanTable& table, uint32_t& entry) noexcept
+	{
+		refill();
+		entry = table.fast[bitbuf & ((1 << TABLE_BITS) - 1)];
+		if (entry != 0)
+		{
+			return (entry & NUM_BITS_MASK) <= bitcnt;
+		}
+		entry = decodeSlow(table, bitbuf, std::min(bitcnt, 15u));
+		if (entry == 0)
+		{
+			if (bitcnt >= 15)
+			{
+				setMalformed();
+			}
+			return false;
+		}
+		return true;
+	}
+
+	uint32_t InflateStream::decodeSlow(const HuffmanTable& table, uint64_t bits, unsigned int avail) noexcept
+	{
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for (unsigned int len = 1; len <= avail; ++len)
+		{
+			code |= (bits & 1);
+			bits >>= 1;
+			const int count = table.count[len];
+			if (code - count < first)
+			{
+				return table.make_entry(table.symbols[index + (code - first)]) | len;
+			}
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+		return 0;
+	}
+
+	void InflateStream::refill() noexcept
+	{
+		while (bitcnt < 56
+			&& in_pos != in.size()
+			)
+		{
+			bitbuf |= (static_cast<uint64_t>(static_cast<uint8_t>(in[in_pos++])) << bitcnt);
+			bitcnt += 8;
+		}
+	}
+
+	void InflateStream::alignToByte() noexcept
+	{
+		skipBits(bitcnt & 7);
+		in_pos -= (bitcnt >> 3);
+		bitbuf = 0;
+		bitcnt = 0;
+	}
+
+	uint8_t* InflateStream::copyMatch(uint8_t* dst, unsigned int len, unsigned int distance) noexcept
+	{
+		uint8_t* const ret = dst + len;
+		const uint8_t* src = dst - distance;
+		if (distance >= 16)
+		{
+			// May write up to 15 bytes past the end of the match, which is fine due to the slack at the end of the buffer.
+			const uint8_t* const end = dst + len;
+			do
+			{
+				memcpy(dst, src, 16);
+				dst += 16;
+				src += 16;
+			} while (dst < end);
+		}
+		else if (distance == 1)
+		{
+			memset(dst, *src, len);
+		}
+		else if (distance >= 8)
+		{
+			const uint8_t* const end = dst + len;
+			do
+			{
+				memcpy(dst, src, 8);
+				dst += 8;
+				src += 8;
+			} while (dst < end);
+		}
+		else
+		{
+			do
+			{
+				*dst++ = *src++;
+			} while (--len);
+		}
+		return ret;
+	}
+
+	void InflateStream::updateChecksum() noexcept
+	{
+		const auto data = reinterpret_cast<const uint8_t*>(buf.data()) + checksum_pos;
+		const size_t size = out_pos - checksum_pos;
+		if (format == deflate::GZIP)
+		{
+			checksum = crc32::hash(data, size, checksum);
+		}
+		else if (format == deflate::ZLIB)
+		{
+			checksum = adler32::hash(data, size, checksum);
+		}
+		total_out += static_cast<uint32_t>(size);
+		checksum_pos = out_pos;
+	}
+
+	void InflateStream::setMalformed() noexcept
+	{
+		status = MALFORMED;
+		state = END;
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "base.hpp"
+#include "deflate.hpp"
+
+NAMESPACE_SOUP
+{
+	// Resumable DEFLATE decompressor. Compressed data can be fed in arbitrary pieces and the output is pulled into a caller-provided buffer,
+	// so only the 32 KiB history window (plus some slack) is held in memory, regardless of how large the decompressed data is.
+	class InflateStream
+	{
+	public:
+		enum Status : uint8_t
+		{
+			NEED_MORE_DATA,
+			DONE,
+			MALFORMED,
+		};
+
+		static constexpr size_t WINDOW_SIZE = 0x8000;
+
+	protected:
+		enum State : uint8_t
+		{
+			STREAM_HEADER,
+			BLOCK_HEADER,
+			STORED_HEADER,
+			STORED_DATA,
+			DYNAMIC_HEADER,
+			CODES,
+			TRAILER,
+			END,
+		};
+
+		static constexpr unsigned int TABLE_BITS = 11;
+		static constexpr size_t BUFFER_SIZE = WINDOW_SIZE * 8;
+
+		// A table entry for the first TABLE_BITS bits of a code, with symbols (e.g. two literals) and bases pre-resolved.
+		// Entries of 0 are codes longer than TABLE_BITS (or invalid), which are decoded the canonical way using count & symbols.
+		struct HuffmanTable
+		{
+			uint32_t fast[1 << TABLE_BITS];
+			uint16_t count[16];
+			uint16_t symbols[288];
+			uint32_t(*make_entry)(unsigned int sym);
+		};
+
+		deflate::Format format;
+		Status status = NEED_MORE_DATA;
+		State state = STREAM_HEADER;
+		bool final_block = false;
+		bool checksum_present = false;
+		bool checksum_mismatch = false;
+
+		std::string in{};
+		size_t in_pos = 0;
+		size_t in_discarded = 0;
+		uint64_t bitbuf = 0;
+		unsigned int bitcnt = 0;
+
+		std::string buf{}; // History window followed by new output.
+		size_t out_pos = 0;
+		size_t out_read = 0;
+		size_t checksum_pos = 0;
+		uint32_t checksum = 0;
+		uint32_t total_out = 0; // Modulo 2^32, for gzip's ISIZE.
+		uint32_t stored_remaining = 0;
+		size_t compressed_size = 0;
+
+		HuffmanTable litlen;
+		HuffmanTable dist;
+
+	public:
+		InflateStream(deflate::Format format = deflate::AUTO) noexcept
+			: format(format)
+		{
+		}
+
+		void feed(const void* data, size_t size) SOUP_EXCAL;
+		void feed(const std::string& data) SOUP_EXCAL { feed(data.data(), data.size()); }
+
+		// Returns how many bytes were written to out. If this is less than max, check getStatus to see if more data needs to be fed.
+		[[nodiscard]] size_t read(void* out, size_t max) SOUP_EXCAL;
+
+		[[nodiscard]] Status getStatus() const noexcept;
+		[[nodiscard]] bool isChecksumPresent() const noexcept { return checksum_present; }
+		[[nodiscard]] bool isChecksumMismatch() const noexcept { return checksum_mismatch; }
+		[[nodiscard]] size_t getCompressedSize() const noexcept { return compressed_size; } // Only valid once DONE; includes headers & trailers.
+
+	protected:
+		void decode() noexcept;
+		[[nodiscard]] bool decodeStreamHeader() noexcept;
+		[[nodiscard]] bool decodeDynamicHeader() noexcept;
+		[[nodiscard]] bool decodeCodesSlow() noexcept;
+		void decodeCodesFast() noexcept;
+		[[nodiscard]] bool decodeTrailer() noexcept;
+
+		[[nodiscard]] static bool buildTable(HuffmanTable& table, const uint8_t* lens, unsigned int num_symbols, uint32_t(*make_entry)(unsigned int sym)) noexcept;
+		static void pairLiterals(HuffmanTable& table) noexcept;
+		[[nodiscard]] bool decodeSymbol(const HuffmanTable& table, uint32_t& entry) noexcept;
+		[[nodiscard]] static uint32_t decodeSlow(const HuffmanTable& table, uint64_t bits, unsigned int avail) noexcept;
+
+		void refill() noexcept;
+		[[nodiscard]] bool ensureBits(unsigned int n) noexcept
+		{
+			refill();
+			return bitcnt >= n;
+		}
+		[[nodiscard]] uint32_t takeBits(unsigned int n) noexcept
+		{
+			const auto val = static_cast<uint32_t>(bitbuf & ((1ull << n) - 1));
+			bitbuf >>= n;
+			bitcnt -= n;
+			return val;
+		}
+		void skipBits(unsigned int n) noexcept
+		{
+			bitbuf >>= n;
+			bitcnt -= n;
+		}
+		void alignToByte() noexcept;
+
+		[[nodiscard]] static uint8_t* copyMatch(uint8_t* dst, unsigned int len, unsigned int distance) noexcept; // Returns the end of the match.
+		void updateChecksum() noexcept;
+		[[nodiscard]] bool isBufferFull() const noexcept { return out_pos + 258 > BUFFER_SIZE; }
+		void setMalformed() noexcept;
+	};
+}
@@ -79,6 +79,16 @@ NAMESPACE_SOUP
 			return m_capacity;
 		}
 
+		[[nodiscard]] T* data() noexcept
+		{
+			return m_data;
+		}
+
+		[[nodiscard]] const T* data() const noexcept
+		{
+			return m_data;
+		}
+
 		[[nodiscard]] SOUP_FORCEINLINE T& operator[](size_t idx) noexcept
 		{
 			return m_data[idx];
@@ -167,6 +177,21 @@ NAMESPACE_SOUP
 			memcpy(&m_data[0], &m_data[num], m_size * sizeof(T));
 		}
 
+		// New elements are zero-initialised.
+		void resize(size_t size) SOUP_EXCAL
+		{
+			if (size > m_capacity)
+			{
+				m_capacity = size;
+				m_data = reinterpret_cast<T*>(soup::realloc(m_data, m_capacity * sizeof(T)));
+			}
+			if (size > m_size)
+			{
+				memset(&m_data[m_size], 0, (size - m_size) * sizeof(T));
+			}
+			m_size = size;
+		}
+
 		void preallocate() SOUP_EXCAL
 		{
 			if (m_capacity == 0)
@@ -44,6 +44,8 @@ NAMESPACE_SOUP
 		{
 		}
 
+		IpAddr& operator=(const IpAddr& b) noexcept = default;
+
 		explicit IpAddr(const uint32_t* ints) noexcept
 		{
 			for (auto i = 0; i != 4; ++i)
@@ -47,6 +47,11 @@ NAMESPACE_SOUP
 		++c;
 	}
 
+	JsonObject::~JsonObject() noexcept
+	{
+		delete index.load();
+	}
+
 	void JsonObject::encodeAndAppendTo(std::string& str) const SOUP_EXCAL
 	{
 		str.push_back('{');
@@ -123,54 +128,36 @@ NAMESPACE_SOUP
 
 	JsonNode* JsonObject::find(std::string k) const noexcept
 	{
-		return find(JsonString(std::move(k)));
+		const auto pos = findPos(std::string_view(k));
+		return pos != children.size() ? children[pos].second.get() : nullptr;
 	}
 
 	JsonNode* JsonObject::find(const JsonNode& k) const noexcept
 	{
-		for (const auto& child : children)
-		{
-			if (*child.first == k)
-			{
-				return child.second.get();
-			}
-		}
-		return nullptr;
+		const auto pos = findPos(k);
+		return pos != children.size() ? children[pos].second.get() : nullptr;
 	}
 
 	UniquePtr<JsonNode>* JsonObject::findUp(std::string k) noexcept
 	{
-		return findUp(JsonString(std::move(k)));
+		const auto pos = findPos(std::string_view(k));
+		return pos != children.size() ? &children[pos].second : nullptr;
 	}
 
 	UniquePtr<JsonNode>* JsonObject::findUp(const JsonNode& k) noexcept
 	{
-		for (auto& child : children)
-		{
-			if (*child.first == k)
-			{
-				return &child.second;
-			}
-		}
-		return nullptr;
+		const auto pos = findPos(k);
+		return pos != children.size() ? &children[pos].second : nullptr;
 	}
 
 	Container::iterator JsonObject::findIt(std::string k) noexcept
 	{
-		return findIt(JsonString(std::move(k)));
+		return children.begin() + findPos(std::string_view(k));
 	}
 
 	Container::iterator JsonObject::findIt(const JsonNode& k) noexcept
 	{
-		auto it = children.begin();
-		for (; it != children.end(); ++it)
-		{
-			if (*it->first == k)
-			{
-				break;
-			}
-		}
-		return it;
+		return children.begin() + findPos(k);
 	}
 
 	bool JsonObject::contains(const JsonNode& k) const noexcept
@@ -201,34 +188,47 @@ NAMESPACE_SOUP
 
 	void JsonObject::erase(const JsonNode& k) noexcept
 	{
-		for (auto i = children.begin(); i != children.end(); ++i)
+		if (auto it = findIt(k); it != children.end())
 		{
-			if (*i->first == k)
-			{
-				children.erase(i);
-				break;
-			}
+			erase(it);
 		}
 	}
 
 	void JsonObject::erase(std::string k) noexcept
 	{
-		return erase(JsonString(std::move(k)));
+		if (auto it = findIt(std::move(k)); it != children.end())
+		{
+			erase(it);
+		}
 	}
 
 	void JsonObject::erase(Container::const_iterator it) noexcept
 	{
+		invalidateIndex(); // Positions after it shift.
 		children.erase(it);
 	}
 
 	void JsonObject::clear() noexcept
 	{
+		invalidateIndex();
 		children.clear();
 	}
 
 	void JsonObject::add(UniquePtr<JsonNode>&& k, UniquePtr<JsonNode>&& v)
 	{
 		children.emplace_back(std::move(k), std::move(v));
+		if (Index* idx = index.load())
+		{
+			// Keep the index up-to-date instead of rebuilding it from scratch.
+			SOUP_TRY
+			{
+				indexKey(*idx, children.size() - 1);
+			}
+			SOUP_CATCH_ANY
+			{
+				invalidateIndex();
+			}
+		}
 	}
 
 	void JsonObject::add(std::string k, std::string v)
@@ -275,4 +275,113 @@ NAMESPACE_SOUP
 	{
 		add(soup::make_unique<JsonString>(std::move(k)), soup::make_unique<JsonFloat>(v));
 	}
+
+	void JsonObject::buildIndex() SOUP_EXCAL
+	{
+		delete index.exchange(createIndex().release());
+	}
+
+	void JsonObject::invalidateIndex() noexcept
+	{
+		delete index.exchange(nullptr);
+	}
+
+	UniquePtr<JsonObject::Index> JsonObject::createIndex() const SOUP_EXCAL
+	{
+		auto idx = soup::make_unique<Index>();
+		idx->positions.reserve(children.size());
+		for (size_t i = 0; i != children.size(); ++i)
+		{
+			indexKey(*idx, i);
+		}
+		return idx;
+	}
+
+	const JsonObject::Index* JsonObject::getIndex() const noexcept
+	{
+		Index* idx = index.load(std::memory_order_acquire);
+		if (idx == nullptr
+			&& children.size() >= index_threshold
+			)
+		{
+			SOUP_TRY
+			{
+				auto created = createIndex();
+				if (index.compare_exchange_strong(idx, created.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+				{
+					idx = created.release();
+				}
+				// Otherwise, another lookup beat us to it and idx now points to its index.
+			}
+			SOUP_CATCH_ANY
+			{
+				// Lookups will just be linear.
+			}
+		}
+		return idx;
+	}
+
+	void JsonObject::indexKey(Index& idx, size_t pos) const SOUP_EXCAL
+	{
+		const auto& key = *children[pos].first;
+		if (key.isStr()
+			&& idx.positions.find(key.reinterpretAsStr().value) == idx.positions.end() // Duplicate keys resolve to the first member, same as a linear search.
+			)
+		{
+			idx.positions.emplace(idx.keys.emplace_back(key.reinterpretAsStr().value), pos);
+		}
+	}
+
+	size_t JsonObject::findPos(std::string_view k) const noexcept
+	{
+		if (const Index* idx = getIndex())
+		{
+			SOUP_TRY
+			{
+				const auto it = idx->positions.find(k);
+				if (it == idx->positions.end())
+				{
+					return children.size();
+				}
+				// Cheap sanity check in case children were modified without invalidating the index.
+				if (it->second < children.size())
+				{
+					const auto& key = *children[it->second].first;
+					if (key.isStr() && key.reinterpretAsStr().value == k)
+					{
+						return it->second;
+					}
+				}
+			}
+			SOUP_CATCH_ANY
+			{
+			}
+		}
+		for (size_t i = 0; i != children.size(); ++i)
+		{
+			if (children[i].first->isStr()
+				&& children[i].first->reinterpretAsStr().value == k
+				)
+			{
+				return i;
+			}
+		}
+		return children.size();
+	}
+
+	size_t JsonObject::findPos(const JsonNode& k) const noexcept
+	{
+		if (k.isStr())
+		{
+			return findPos(std::string_view(k.reinterpretAsStr().value));
+		}
+		for (size_t i = 0; i != children.size(); ++i)
+		{
+			if (*children[i].first == k)
+			{
+				return i;
+			}
+		}
+		return children.size();
+	}
 }
@@ -2,6 +2,10 @@
 
 #include "JsonNode.hpp"
 
+#include <atomic>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -10,14 +14,19 @@
 NAMESPACE_SOUP
 {
 	// Note that per JSON spec, object keys must be strings, but for convenience, Soup allows any JSON type as a valid object key type.
+	// Once an object has index_threshold members, the first lookup builds a hash index over its string keys. Lookups are still safe to do concurrently.
+	// add, erase & clear keep the index up-to-date. After modifying children directly, call invalidateIndex or buildIndex.
 	struct JsonObject : public JsonNode
 	{
 		using Container = std::vector<std::pair<UniquePtr<JsonNode>, UniquePtr<JsonNode>>>;
 
+		static constexpr size_t index_threshold = 16;
+
 		Container children{};
 
 		explicit JsonObject() noexcept;
 		explicit JsonObject(const char*& c) noexcept;
+		~JsonObject() noexcept;
 
 		void encodeAndAppendTo(std::string& str) const SOUP_EXCAL final;
 		void encodePrettyAndAppendTo(std::string& str, unsigned depth = 0) const SOUP_EXCAL;
@@ -38,6 +47,8 @@ NAMESPACE_SOUP
 		void erase(std::string k) noexcept;
 		void erase(Container::const_iterator it) noexcept;
 		void clear() noexcept;
+		void buildIndex() SOUP_EXCAL;
+		void invalidateIndex() noexcept;
 		[[nodiscard]] auto begin() noexcept { return children.begin(); }
 		[[nodiscard]] auto end() noexcept { return children.end(); }
 		[[nodiscard]] auto begin() const noexcept { return children.begin(); }
@@ -59,5 +70,20 @@ NAMESPACE_SOUP
 		{
 			add(soup::make_unique<JsonString>(std::move(k)), std::move(v));
 		}
+
+	protected:
+		struct Index
+		{
+			std::deque<std::string> keys; // Copies of the keys, so the index can't dangle if children are modified behind its back.
+			std::unordered_map<std::string_view, size_t> positions; // Views into keys.
+		};
+
+		mutable std::atomic<Index*> index{ nullptr }; // Lookups that race to build it publish it with a CAS; the losers discard theirs.
+
+		[[nodiscard]] UniquePtr<Index> createIndex() const SOUP_EXCAL;
+		[[nodiscard]] const Index* getIndex() const noexcept; // Returns nullptr if the object is too small to bother.
+		void indexKey(Index& idx, size_t pos) const SOUP_EXCAL;
+		[[nodiscard]] size_t findPos(std::string_view k) const noexcept; // Returns children.size() if not found.
+		[[nodiscard]] size_t findPos(const JsonNode& k) const noexcept;
 	};
 }
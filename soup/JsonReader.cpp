@@ -0,0 +1,368 @@
+#include "JsonReader.hpp"
+
+#include <algorithm> // min
+#include <cerrno>
+#include <cstdlib> // strtod, strtoll
+#include <cstring> // memchr
+
+#include "JsonArray.hpp"
+#include "JsonBool.hpp"
+#include "JsonFloat.hpp"
+#include "JsonInt.hpp"
+#include "JsonNull.hpp"
+#include "JsonObject.hpp"
+#include "JsonString.hpp"
+#include "Reader.hpp"
+
+NAMESPACE_SOUP
+{
+	JsonReader::JsonReader(Reader& r, size_t chunk_size, size_t max_token_size)
+		: r(r), chunk_size(chunk_size), max_token_size(max_token_size), remaining(r.getRemainingBytes())
+	{
+	}
+
+	JsonReader::Event JsonReader::next() SOUP_EXCAL
+	{
+		if (state == FAILED)
+		{
+			return MALFORMED;
+		}
+		if (!skipSpace())
+		{
+			return state == DONE ? END_OF_DOCUMENT : fail();
+		}
+		char c = buf[pos];
+		switch (state)
+		{
+		case DONE:
+			return fail();
+
+		case ARRAY_COMMA_OR_END:
+		case OBJECT_COMMA_OR_END:
+			if (c == ',')
+			{
+				++pos;
+				state = (state == ARRAY_COMMA_OR_END ? VALUE : KEY_AFTER_COMMA);
+				if (!skipSpace())
+				{
+					return fail();
+				}
+				c = buf[pos];
+				break;
+			}
+			[[fallthrough]];
+		case FIRST_VALUE_OR_END:
+		case FIRST_KEY_OR_END:
+			if (c == ((state == FIRST_VALUE_OR_END || state == ARRAY_COMMA_OR_END) ? ']' : '}'))
+			{
+				++pos;
+				stack.pop_back();
+				setStateAfterValue();
+				return c == ']' ? ARRAY_END : OBJECT_END;
+			}
+			if (state == ARRAY_COMMA_OR_END || state == OBJECT_COMMA_OR_END)
+			{
+				return fail();
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (state == FIRST_KEY_OR_END || state == KEY_AFTER_COMMA)
+		{
+			if (c != '"'
+				|| !readString()
+				|| !skipSpace()
+				|| buf[pos] != ':'
+				)
+			{
+				return fail();
+			}
+			++pos;
+			state = VALUE;
+			return KEY;
+		}
+
+		switch (c)
+		{
+		case '{':
+		case '[':
+			SOUP_IF_UNLIKELY (stack.size() == max_depth)
+			{
+				return fail();
+			}
+			++pos;
+			stack.push_back(c);
+			state = (c == '[' ? FIRST_VALUE_OR_END : FIRST_KEY_OR_END);
+			return c == '[' ? ARRAY_BEGIN : OBJECT_BEGIN;
+
+		case '"':
+			if (!readString())
+			{
+				return fail();
+			}
+			setStateAfterValue();
+			return STRING;
+		}
+
+		const Event e = readScalar();
+		if (e == MALFORMED)
+		{
+			return fail();
+		}
+		setStateAfterValue();
+		return e;
+	}
+
+	bool JsonReader::skip() SOUP_EXCAL
+	{
+		const size_t depth = stack.size();
+		while (stack.size() >= depth)
+		{
+			const Event e = next();
+			if (e == MALFORMED || e == END_OF_DOCUMENT)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	UniquePtr<JsonNode> JsonReader::readNode(Event e) SOUP_EXCAL
+	{
+		switch (e)
+		{
+		case OBJECT_BEGIN:
+			{
+				auto obj = soup::make_unique<JsonObject>();
+				while (true)
+				{
+					const Event k = next();
+					if (k == OBJECT_END)
+					{
+						break;
+					}
+					if (k != KEY)
+					{
+						return {};
+					}
+					auto key = soup::make_unique<JsonString>(std::move(str));
+					auto value = readNode(next());
+					if (!value)
+					{
+						return {};
+					}
+					obj->children.emplace_back(std::move(key), std::move(value));
+				}
+				return obj;
+			}
+
+		case ARRAY_BEGIN:
+			{
+				auto arr = soup::make_unique<JsonArray>();
+				UniquePtr<JsonNode> elm;
+				while (nextElement(elm))
+				{
+					arr->children.emplace_back(std::move(elm));
+				}
+				if (isMalformed())
+				{
+					return {};
+				}
+				return arr;
+			}
+
+		case STRING: return soup::make_unique<JsonString>(std::move(str));
+		case INT: return soup::make_unique<JsonInt>(i);
+		case FLOAT: return soup::make_unique<JsonFloat>(f);
+		case BOOL: return soup::make_unique<JsonBool>(b);
+		case NULL_VALUE: return soup::make_unique<JsonNull>();
+
+		default:
+			break;
+		}
+		return {};
+	}
+
+	bool JsonReader::nextElement(UniquePtr<JsonNode>& out) SOUP_EXCAL
+	{
+		const Event e = next();
+		if (e == ARRAY_END
+			|| e == MALFORMED
+			)
+		{
+			return false;
+		}
+		out = readNode(e);
+		return static_cast<bool>(out);
+	}
+
+	bool JsonReader::fill() SOUP_EXCAL
+	{
+		if (remaining == 0)
+		{
+			return false;
+		}
+		if (pos != 0)
+		{
+			buf.erase(0, pos);
+			pos = 0;
+		}
+		const size_t len = std::min(chunk_size, remaining);
+		const size_t size = buf.size();
+		buf.resize(size + len);
+		SOUP_IF_UNLIKELY (!r.raw(buf.data() + size, len))
+		{
+			buf.resize(size);
+			remaining = 0;
+			return false;
+		}
+		remaining -= len;
+		return true;
+	}
+
+	bool JsonReader::skipSpace() SOUP_EXCAL
+	{
+		do
+		{
+			for (; pos != buf.size(); ++pos)
+			{
+				const char c = buf[pos];
+				if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+				{
+					return true;
+				}
+			}
+		} while (fill());
+		return false;
+	}
+
+	bool JsonReader::readString() SOUP_EXCAL
+	{
+		// buf[pos] is the opening quote. Offsets are relative to pos because fill() moves the data.
+		size_t k = 1;
+		bool escapes = false;
+		while (true)
+		{
+			const char* begin = buf.data() + pos + k;
+			const char* quote = reinterpret_cast<const char*>(memchr(begin, '"', buf.size() - (pos + k)));
+			const char* backslash = reinterpret_cast<const char*>(memchr(begin, '\\', (quote ? quote : buf.data() + buf.size()) - begin));
+			if (backslash != nullptr)
+			{
+				escapes = true;
+				k = (backslash - buf.data()) - pos + 2; // Skip the escaped character.
+				if (pos + k > buf.size()
+					&& !fill()
+					)
+				{
+					return false;
+				}
+				continue;
+			}
+			if (quote != nullptr)
+			{
+				k = (quote - buf.data()) - pos;
+				break;
+			}
+			k = (buf.size() - pos);
+			if (k > max_token_size
+				|| !fill()
+				)
+			{
+				return false;
+			}
+		}
+		if (escapes)
+		{
+			const char* c = buf.data() + pos + 1;
+			JsonString unescaped(c); // Stops at the closing quote.
+			str = std::move(unescaped.value);
+		}
+		else
+		{
+			str.assign(buf, pos + 1, k - 1);
+		}
+		pos += (k + 1);
+		return true;
+	}
+
+	JsonReader::Event JsonReader::readScalar() SOUP_EXCAL
+	{
+		size_t k = 0;
+		while (true)
+		{
+			if (pos + k == buf.size())
+			{
+				if (!fill())
+				{
+					break;
+				}
+				continue;
+			}
+			const char c = buf[pos + k];
+			if (c == ' ' || c == '\t' || c == '\n' || c == '\r'
+				|| c == ',' || c == ']' || c == '}' || c == ':'
+				)
+			{
+				break;
+			}
+			SOUP_IF_UNLIKELY (++k > max_token_size)
+			{
+				return MALFORMED;
+			}
+		}
+		const std::string token = buf.substr(pos, k);
+		pos += k;
+
+		if (token == "true" || token == "false")
+		{
+			b = (token.size() == 4);
+			return BOOL;
+		}
+		if (token == "null")
+		{
+			return NULL_VALUE;
+		}
+
+		if (token.empty()
+			|| (token[0] != '-' && (token[0] < '0' || token[0] > '9'))
+			|| token.find_first_not_of("0123456789+-.eE") != std::string::npos
+			)
+		{
+			return MALFORMED;
+		}
+		char* end;
+		if (token.find_first_of(".eE") == std::string::npos)
+		{
+			errno = 0;
+			i = std::strtoll(token.c_str(), &end, 10);
+			if (*end == 0 && errno == 0)
+			{
+				return INT;
+			}
+			// Doesn't fit into an int64, so fall back to a float.
+		}
+		f = std::strtod(token.c_str(), &end);
+		return *end == 0 ? FLOAT : MALFORMED;
+	}
+
+	JsonReader::Event JsonReader::fail() noexcept
+	{
+		state = FAILED;
+		return MALFORMED;
+	}
+
+	void JsonReader::setStateAfterValue() noexcept
+	{
+		if (stack.empty())
+		{
+			state = DONE;
+		}
+		else
+		{
+			state = (stack.back() == '[' ? ARRAY_COMMA_OR_END : OBJECT_COMMA_OR_END);
+		}
+	}
+}
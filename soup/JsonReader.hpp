@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "base.hpp"
+#include "fwd.hpp"
+
+#include "UniquePtr.hpp"
+
+NAMESPACE_SOUP
+{
+	// Pull-based JSON reader, so documents larger than memory can be processed as a series of events.
+	// Only a window of the input is buffered: chunk_size bytes plus the token currently being read, which may not exceed max_token_size.
+	class JsonReader
+	{
+	public:
+		enum Event : uint8_t
+		{
+			OBJECT_BEGIN,
+			OBJECT_END,
+			ARRAY_BEGIN,
+			ARRAY_END,
+			KEY, // str
+			STRING, // str
+			INT, // i
+			FLOAT, // f
+			BOOL, // b
+			NULL_VALUE,
+			END_OF_DOCUMENT,
+			MALFORMED,
+		};
+
+		static constexpr size_t max_depth = 1024;
+
+		Reader& r;
+		size_t chunk_size;
+		size_t max_token_size;
+
+		std::string str{};
+		int64_t i = 0;
+		double f = 0.0;
+		bool b = false;
+
+	protected:
+		enum State : uint8_t
+		{
+			VALUE,
+			FIRST_VALUE_OR_END,
+			ARRAY_COMMA_OR_END,
+			FIRST_KEY_OR_END,
+			KEY_AFTER_COMMA,
+			OBJECT_COMMA_OR_END,
+			DONE,
+			FAILED,
+		};
+
+		std::string buf{};
+		size_t pos = 0;
+		size_t remaining; // Bytes left in the Reader.
+		std::string stack{}; // '[' or '{' for every open container.
+		State state = VALUE;
+
+	public:
+		JsonReader(Reader& r, size_t chunk_size = 0x10000, size_t max_token_size = 0x1000000);
+
+		[[nodiscard]] Event next() SOUP_EXCAL;
+
+		[[nodiscard]] size_t getDepth() const noexcept { return stack.size(); }
+		[[nodiscard]] bool isMalformed() const noexcept { return state == FAILED; }
+
+		// After OBJECT_BEGIN or ARRAY_BEGIN, consumes everything up to and including the matching end.
+		bool skip() SOUP_EXCAL;
+
+		// Builds a JsonNode from the event that next() just returned, consuming the entire container in case of OBJECT_BEGIN or ARRAY_BEGIN.
+		// Returns nullptr if the event is not the start of a value or the container is malformed.
+		[[nodiscard]] UniquePtr<JsonNode> readNode(Event e) SOUP_EXCAL;
+
+		// Reads the next element of the array that is currently open, e.g. after the first next() returned ARRAY_BEGIN.
+		// Returns false at the end of the array or if the input is malformed.
+		[[nodiscard]] bool nextElement(UniquePtr<JsonNode>& out) SOUP_EXCAL;
+
+	protected:
+		[[nodiscard]] bool fill() SOUP_EXCAL;
+		[[nodiscard]] bool skipSpace() SOUP_EXCAL;
+		[[nodiscard]] bool readString() SOUP_EXCAL;
+		[[nodiscard]] Event readScalar() SOUP_EXCAL;
+		[[nodiscard]] Event fail() noexcept;
+		void setStateAfterValue() noexcept;
+	};
+}
@@ -113,6 +113,11 @@ NAMESPACE_SOUP
 	}
 
 	void JsonString::encodeAndAppendTo(std::string& str) const SOUP_EXCAL
+	{
+		encodeAndAppendTo(str, value);
+	}
+
+	void JsonString::encodeAndAppendTo(std::string& str, std::string_view value) SOUP_EXCAL
 	{
 		str.reserve(str.size() + value.size() + 2);
 		str.push_back('"');
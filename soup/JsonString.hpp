@@ -3,6 +3,7 @@
 #include "JsonNode.hpp"
 
 #include <string>
+#include <string_view>
 
 NAMESPACE_SOUP
 {
@@ -17,6 +18,7 @@ NAMESPACE_SOUP
 		bool operator ==(const JsonNode& b) const noexcept final;
 
 		void encodeAndAppendTo(std::string& str) const SOUP_EXCAL final;
+		static void encodeAndAppendTo(std::string& str, std::string_view value) SOUP_EXCAL; // Appends value as a quoted & escaped JSON string.
 		bool binaryEncode(Writer& w) const final;
 
 		operator std::string& () noexcept
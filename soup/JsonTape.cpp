@@ -0,0 +1,695 @@
+#include "JsonTape.hpp"
+
+#include <cstdlib> // strtod
+#include <cstring> // memcpy, memchr
+
+#if SOUP_X86 && SOUP_BITS == 64
+	#include <emmintrin.h>
+#endif
+
+#include "bitutil.hpp"
+#include "Exception.hpp"
+#include "JsonArray.hpp"
+#include "JsonBool.hpp"
+#include "JsonFloat.hpp"
+#include "JsonInt.hpp"
+#include "JsonNull.hpp"
+#include "JsonObject.hpp"
+#include "JsonString.hpp"
+
+// The structural indexing follows "Parsing Gigabytes of JSON per Second" (Langdale & Lemire, 2019):
+// Each 64-byte block is classified into bitmasks, from which the string regions are derived via a prefix XOR of the unescaped quotes.
+
+NAMESPACE_SOUP
+{
+	struct JsonBlockMasks
+	{
+		uint64_t quote = 0;
+		uint64_t backslash = 0;
+		uint64_t op = 0; // {}[]:,
+		uint64_t ws = 0;
+		uint64_t ctrl = 0; // < 0x20
+	};
+
+	static void classifyJsonBlock(JsonBlockMasks& m, const char* block) noexcept
+	{
+#if SOUP_X86 && SOUP_BITS == 64
+		for (int k = 0; k != 4; ++k)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + k * 16));
+			const __m128i v_lower = _mm_or_si128(v, _mm_set1_epi8(0x20)); // '[' -> '{', ']' -> '}'
+			const __m128i op = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v_lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(v_lower, _mm_set1_epi8('}'))),
+				_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(',')))
+			);
+			const __m128i ws = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+				_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')))
+			);
+			const __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+			const auto shift = (k * 16);
+			m.quote |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))))) << shift;
+			m.backslash |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))))) << shift;
+			m.op |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(op))) << shift;
+			m.ws |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ws))) << shift;
+			m.ctrl |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(ctrl))) << shift;
+		}
+#else
+		for (int k = 0; k != 64; ++k)
+		{
+			const uint64_t bit = (uint64_t(1) << k);
+			switch (block[k])
+			{
+			case '"': m.quote |= bit; break;
+			case '\\': m.backslash |= bit; break;
+			case '{': case '}': case '[': case ']': case ':': case ',': m.op |= bit; break;
+			case ' ': case '\n': case '\r': m.ws |= bit; break;
+			case '\t': m.ws |= bit; m.ctrl |= bit; break;
+			default:
+				if (static_cast<uint8_t>(block[k]) < 0x20)
+				{
+					m.ctrl |= bit;
+				}
+				break;
+			}
+		}
+#endif
+	}
+
+	[[nodiscard]] static unsigned long ctz64(uint64_t mask) noexcept
+	{
+#if SOUP_BITS >= 64
+		return bitutil::getLeastSignificantSetBit(mask);
+#else
+		return static_cast<uint32_t>(mask) != 0
+			? bitutil::getLeastSignificantSetBit(static_cast<uint32_t>(mask))
+			: 32 + bitutil::getLeastSignificantSetBit(static_cast<uint32_t>(mask >> 32))
+			;
+#endif
+	}
+
+	[[nodiscard]] static uint64_t prefixXor(uint64_t x) noexcept
+	{
+		x ^= (x << 1);
+		x ^= (x << 2);
+		x ^= (x << 4);
+		x ^= (x << 8);
+		x ^= (x << 16);
+		x ^= (x << 32);
+		return x;
+	}
+
+	[[nodiscard]] static bool isJsonTokenBoundary(const char* data, size_t size, size_t i) noexcept
+	{
+		if (i == size)
+		{
+			return true;
+		}
+		switch (data[i])
+		{
+		case ' ': case '\t': case '\n': case '\r':
+		case '{': case '}': case '[': case ']': case ':': case ',':
+			return true;
+		}
+		return false;
+	}
+
+	bool JsonTape::parse(const char* data, size_t size) SOUP_EXCAL
+	{
+		src = data;
+		tape.clear();
+		return size <= 0xFFFFFFFF
+			&& indexStructurals(data, size)
+			&& buildTape(data, size)
+			;
+	}
+
+	bool JsonTape::indexStructurals(const char* data, size_t size) SOUP_EXCAL
+	{
+		structurals.clear();
+		structurals.reserve(size / 6);
+
+		uint64_t prev_escaped = 0; // Is the first character of the next block escaped?
+		uint64_t prev_in_string = 0; // All bits set if the previous block ended inside of a string.
+		uint64_t prev_scalar = 0;
+		uint64_t error = 0;
+		uint64_t backslashes = 0;
+		for (size_t base = 0; base < size; base += 64)
+		{
+			const char* block = data + base;
+			char last_block[64];
+			if (size - base < 64)
+			{
+				memset(last_block, ' ', sizeof(last_block));
+				memcpy(last_block, block, size - base);
+				block = last_block;
+			}
+
+			JsonBlockMasks m;
+			classifyJsonBlock(m, block);
+			backslashes |= m.backslash;
+
+			// Backslashes are rare, so they're simply walked.
+			uint64_t escaped = prev_escaped;
+			uint64_t backslash = m.backslash & ~prev_escaped;
+			prev_escaped = 0;
+			while (backslash != 0)
+			{
+				const auto i = ctz64(backslash);
+				if (i == 63)
+				{
+					prev_escaped = 1;
+				}
+				else
+				{
+					escaped |= (uint64_t(2) << i);
+					backslash &= ~(uint64_t(2) << i);
+				}
+				bitutil::unsetLeastSignificantSetBit(backslash);
+			}
+
+			const uint64_t quotes = (m.quote & ~escaped);
+			const uint64_t in_string = (prefixXor(quotes) ^ prev_in_string); // From the opening quote up to, but not including, the closing quote.
+			prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+			const uint64_t string_tail = (in_string ^ quotes); // Contents & closing quote
+
+			const uint64_t scalar = ~(m.op | m.ws);
+			const uint64_t follows_scalar = ((scalar << 1) | prev_scalar);
+			prev_scalar = (scalar >> 63);
+
+			uint64_t bits = (((m.op | (scalar & ~follows_scalar)) & ~string_tail) | quotes);
+			error |= (m.ctrl & string_tail);
+
+			while (bits != 0)
+			{
+				structurals.emplace_back(static_cast<uint32_t>(base + ctz64(bits)));
+				bitutil::unsetLeastSignificantSetBit(bits);
+			}
+		}
+		any_backslashes = (backslashes != 0);
+		return error == 0
+			&& prev_in_string == 0
+			;
+	}
+
+	bool JsonTape::buildTape(const char* data, size_t size) SOUP_EXCAL
+	{
+		enum State : uint8_t
+		{
+			VALUE,
+			FIRST_VALUE_OR_END,
+			ARRAY_COMMA_OR_END,
+			FIRST_KEY_OR_END,
+			KEY,
+			COLON,
+			OBJECT_COMMA_OR_END,
+			DONE,
+		};
+
+		struct Scope
+		{
+			uint32_t begin;
+			uint32_t count;
+		};
+
+		tape.reserve(structurals.size() + (structurals.size() / 2));
+		std::vector<Scope> stack{};
+		State state = VALUE;
+		for (size_t k = 0; k != structurals.size(); ++k)
+		{
+			const uint32_t off = structurals[k];
+			const char c = data[off];
+
+			if (state == COLON)
+			{
+				if (c != ':')
+				{
+					return false;
+				}
+				state = VALUE;
+				continue;
+			}
+			if (state == ARRAY_COMMA_OR_END || state == OBJECT_COMMA_OR_END)
+			{
+				if (c == ',')
+				{
+					state = (state == ARRAY_COMMA_OR_END ? VALUE : KEY);
+					continue;
+				}
+			}
+			if (state == FIRST_VALUE_OR_END || state == ARRAY_COMMA_OR_END || state == FIRST_KEY_OR_END || state == OBJECT_COMMA_OR_END)
+			{
+				if (c == (state <= ARRAY_COMMA_OR_END ? ']' : '}'))
+				{
+					const Scope scope = stack.back();
+					stack.pop_back();
+					const auto end = static_cast<uint32_t>(tape.size());
+					tape[scope.begin] |= (static_cast<uint64_t>(scope.count < 0xFFFFFF ? scope.count : 0xFFFFFF) << 32) | (end + 1);
+					tape.emplace_back((static_cast<uint64_t>(c) << 56) | scope.begin);
+					if (stack.empty())
+					{
+						state = DONE;
+					}
+					else
+					{
+						state = ((tape[stack.back().begin] >> 56) == TAG_ARRAY_BEGIN ? ARRAY_COMMA_OR_END : OBJECT_COMMA_OR_END);
+					}
+					continue;
+				}
+				if (state == ARRAY_COMMA_OR_END || state == OBJECT_COMMA_OR_END)
+				{
+					return false;
+				}
+				// FIRST_VALUE_OR_END falls through as VALUE, FIRST_KEY_OR_END as KEY.
+			}
+			if (state == DONE)
+			{
+				return false;
+			}
+
+			const bool is_key = (state == KEY || state == FIRST_KEY_OR_END);
+			if (is_key && c != '"')
+			{
+				return false;
+			}
+			if (!stack.empty()
+				&& (is_key || (tape[stack.back().begin] >> 56) == TAG_ARRAY_BEGIN)
+				)
+			{
+				++stack.back().count;
+			}
+
+			switch (c)
+			{
+			case '{':
+			case '[':
+				SOUP_IF_UNLIKELY (stack.size() == max_depth)
+				{
+					return false;
+				}
+				stack.emplace_back(Scope{ static_cast<uint32_t>(tape.size()), 0 });
+				tape.emplace_back(static_cast<uint64_t>(c) << 56);
+				state = (c == '[' ? FIRST_VALUE_OR_END : FIRST_KEY_OR_END);
+				continue;
+
+			case '"':
+				{
+					// Both quotes of a string are structurals, so the closing one is next.
+					const uint32_t close = structurals[++k];
+					SOUP_ASSUME(data[close] == '"');
+					if (!isJsonTokenBoundary(data, size, close + 1))
+					{
+						return false;
+					}
+					const uint32_t len = (close - off - 1);
+					const bool has_escapes = (any_backslashes && memchr(data + off + 1, '\\', len) != nullptr);
+					tape.emplace_back((static_cast<uint64_t>(TAG_STRING) << 56) | (off + 1));
+					tape.emplace_back((static_cast<uint64_t>(has_escapes) << 63) | len);
+				}
+				break;
+
+			case 't':
+				if (size - off < 4 || memcmp(data + off, "true", 4) != 0 || !isJsonTokenBoundary(data, size, off + 4))
+				{
+					return false;
+				}
+				tape.emplace_back(static_cast<uint64_t>(TAG_TRUE) << 56);
+				break;
+
+			case 'f':
+				if (size - off < 5 || memcmp(data + off, "false", 5) != 0 || !isJsonTokenBoundary(data, size, off + 5))
+				{
+					return false;
+				}
+				tape.emplace_back(static_cast<uint64_t>(TAG_FALSE) << 56);
+				break;
+
+			case 'n':
+				if (size - off < 4 || memcmp(data + off, "null", 4) != 0 || !isJsonTokenBoundary(data, size, off + 4))
+				{
+					return false;
+				}
+				tape.emplace_back(static_cast<uint64_t>(TAG_NULL) << 56);
+				break;
+
+			default:
+				if (!parseNumber(data, size, off))
+				{
+					return false;
+				}
+				break;
+			}
+
+			if (is_key)
+			{
+				state = COLON;
+			}
+			else if (stack.empty())
+			{
+				state = DONE;
+			}
+			else
+			{
+				state = ((tape[stack.back().begin] >> 56) == TAG_ARRAY_BEGIN ? ARRAY_COMMA_OR_END : OBJECT_COMMA_OR_END);
+			}
+		}
+		return state == DONE;
+	}
+
+	bool JsonTape::parseNumber(const char* data, size_t size, uint32_t offset) SOUP_EXCAL
+	{
+		// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+		size_t i = offset;
+		const bool negative = (data[i] == '-');
+		if (negative)
+		{
+			++i;
+		}
+		const size_t int_begin = i;
+		uint64_t mantissa = 0;
+		for (; i != size && data[i] >= '0' && data[i] <= '9'; ++i)
+		{
+			mantissa = (mantissa * 10) + (data[i] - '0');
+		}
+		const size_t int_digits = (i - int_begin);
+		if (int_digits == 0
+			|| (int_digits > 1 && data[int_begin] == '0')
+			)
+		{
+			return false;
+		}
+		bool is_float = false;
+		size_t frac_begin = i;
+		size_t frac_digits = 0;
+		if (i != size && data[i] == '.')
+		{
+			is_float = true;
+			frac_begin = ++i;
+			while (i != size && data[i] >= '0' && data[i] <= '9')
+			{
+				++i;
+			}
+			frac_digits = (i - frac_begin);
+			if (frac_digits == 0)
+			{
+				return false;
+			}
+		}
+		int exp10 = 0;
+		if (i != size && (data[i] == 'e' || data[i] == 'E'))
+		{
+			is_float = true;
+			++i;
+			const bool exp_negative = (i != size && data[i] == '-');
+			if (i != size && (data[i] == '+' || data[i] == '-'))
+			{
+				++i;
+			}
+			const size_t exp_begin = i;
+			while (i != size && data[i] >= '0' && data[i] <= '9')
+			{
+				if (exp10 < 10000)
+				{
+					exp10 = (exp10 * 10) + (data[i] - '0');
+				}
+				++i;
+			}
+			if (i == exp_begin)
+			{
+				return false;
+			}
+			if (exp_negative)
+			{
+				exp10 = -exp10;
+			}
+		}
+		if (!isJsonTokenBoundary(data, size, i))
+		{
+			return false;
+		}
+
+		// 19 digits may overflow int64, so those are checked precisely.
+		if (!is_float
+			&& (int_digits < 19 || (int_digits == 19 && mantissa <= (negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX)) && mantissa >= 1000000000000000000ull))
+			)
+		{
+			tape.emplace_back(static_cast<uint64_t>(TAG_INT) << 56);
+			tape.emplace_back(negative ? (~mantissa + 1) : mantissa);
+			return true;
+		}
+
+		// If the digits & the power of 10 are exactly representable, a single multiplication or division is correctly rounded (Clinger's fast path).
+		if (int_digits + frac_digits <= 15)
+		{
+			uint64_t digits = mantissa;
+			for (size_t j = frac_begin; j != frac_begin + frac_digits; ++j)
+			{
+				digits = (digits * 10) + (data[j] - '0');
+			}
+			exp10 -= static_cast<int>(frac_digits);
+			if (exp10 >= -22 && exp10 <= 22)
+			{
+				static constexpr double powers[] = {
+					1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+					1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+				};
+				double val = static_cast<double>(digits);
+				val = (exp10 < 0 ? val / powers[-exp10] : val * powers[exp10]);
+				if (negative)
+				{
+					val = -val;
+				}
+				uint64_t bits;
+				memcpy(&bits, &val, sizeof(bits));
+				tape.emplace_back(static_cast<uint64_t>(TAG_FLOAT) << 56);
+				tape.emplace_back(bits);
+				return true;
+			}
+		}
+
+		// strtod needs a terminator, which the source might not have right after the number.
+		const size_t len = (i - offset);
+		char buf[64];
+		std::string long_buf;
+		const char* str;
+		if (len < sizeof(buf))
+		{
+			memcpy(buf, data + offset, len);
+			buf[len] = 0;
+			str = buf;
+		}
+		else
+		{
+			long_buf.assign(data + offset, len);
+			str = long_buf.c_str();
+		}
+		const double val = std::strtod(str, nullptr);
+		uint64_t bits;
+		memcpy(&bits, &val, sizeof(bits));
+		tape.emplace_back(static_cast<uint64_t>(TAG_FLOAT) << 56);
+		tape.emplace_back(bits);
+		return true;
+	}
+
+	JsonNodeType JsonTape::Value::getType() const noexcept
+	{
+		switch (getTag())
+		{
+		case TAG_OBJECT_BEGIN: return JSON_OBJECT;
+		case TAG_ARRAY_BEGIN: return JSON_ARRAY;
+		case TAG_STRING: return JSON_STRING;
+		case TAG_INT: return JSON_INT;
+		case TAG_FLOAT: return JSON_FLOAT;
+		case TAG_TRUE: case TAG_FALSE: return JSON_BOOL;
+		default: break;
+		}
+		return JSON_NULL;
+	}
+
+	void JsonTape::Value::expect(Tag tag) const
+	{
+		SOUP_IF_UNLIKELY (getTag() != tag)
+		{
+			SOUP_THROW(Exception("JSON value has unexpected type"));
+		}
+	}
+
+	bool JsonTape::Value::getBool() const
+	{
+		SOUP_IF_UNLIKELY (!isBool())
+		{
+			SOUP_THROW(Exception("JSON value has unexpected type"));
+		}
+		return getTag() == TAG_TRUE;
+	}
+
+	int64_t JsonTape::Value::getInt() const
+	{
+		expect(TAG_INT);
+		return static_cast<int64_t>(tape->tape[i + 1]);
+	}
+
+	double JsonTape::Value::getFloat() const
+	{
+		if (isInt())
+		{
+			return static_cast<double>(static_cast<int64_t>(tape->tape[i + 1]));
+		}
+		expect(TAG_FLOAT);
+		double val;
+		memcpy(&val, &tape->tape[i + 1], sizeof(val));
+		return val;
+	}
+
+	std::string_view JsonTape::Value::getRawString() const
+	{
+		expect(TAG_STRING);
+		return std::string_view(tape->src + (tape->tape[i] & 0xFFFFFFFFFFFFFF), static_cast<uint32_t>(tape->tape[i + 1]));
+	}
+
+	bool JsonTape::Value::hasEscapes() const
+	{
+		expect(TAG_STRING);
+		return tape->tape[i + 1] >> 63;
+	}
+
+	std::string JsonTape::Value::getString() const SOUP_EXCAL
+	{
+		const auto raw = getRawString();
+		if (!hasEscapes())
+		{
+			return std::string(raw);
+		}
+		const char* c = raw.data();
+		JsonString str(c); // Stops at the closing quote.
+		return std::move(str.value);
+	}
+
+	size_t JsonTape::Value::size() const
+	{
+		SOUP_IF_UNLIKELY (!isArr() && !isObj())
+		{
+			SOUP_THROW(Exception("JSON value has unexpected type"));
+		}
+		size_t count = ((tape->tape[i] >> 32) & 0xFFFFFF);
+		if (count == 0xFFFFFF)
+		{
+			count = 0;
+			for (ElementIterator it{ tape, i + 1 }; it.i != getEnd() - 1; ++it)
+			{
+				++count;
+			}
+			if (isObj())
+			{
+				count /= 2;
+			}
+		}
+		return count;
+	}
+
+	Optional<JsonTape::Value> JsonTape::Value::find(std::string_view key) const SOUP_EXCAL
+	{
+		expect(TAG_OBJECT_BEGIN);
+		for (const auto& member : members())
+		{
+			if (member.key.hasEscapes()
+				? member.key.getString() == key
+				: member.key.getRawString() == key
+				)
+			{
+				return member.value;
+			}
+		}
+		return std::nullopt;
+	}
+
+	JsonTape::Value JsonTape::Value::at(std::string_view key) const SOUP_EXCAL
+	{
+		if (auto val = find(key))
+		{
+			return *val;
+		}
+		std::string err = "JSON object has no member with key ";
+		err.append(key);
+		SOUP_THROW(Exception(std::move(err)));
+	}
+
+	JsonTape::Value JsonTape::Value::at(size_t index) const
+	{
+		for (const auto& elm : elements())
+		{
+			if (index-- == 0)
+			{
+				return elm;
+			}
+		}
+		SOUP_THROW(Exception("JSON array index out of range"));
+	}
+
+	JsonTape::Value JsonTape::Value::next() const noexcept
+	{
+		switch (getTag())
+		{
+		case TAG_OBJECT_BEGIN:
+		case TAG_ARRAY_BEGIN:
+			return Value{ tape, getEnd() };
+
+		case TAG_STRING:
+		case TAG_INT:
+		case TAG_FLOAT:
+			return Value{ tape, i + 2 };
+
+		default:
+			break;
+		}
+		return Value{ tape, i + 1 };
+	}
+
+	JsonTape::Range<JsonTape::ElementIterator> JsonTape::Value::elements() const
+	{
+		expect(TAG_ARRAY_BEGIN);
+		return { ElementIterator{ tape, i + 1 }, ElementIterator{ tape, getEnd() - 1 } };
+	}
+
+	JsonTape::Range<JsonTape::MemberIterator> JsonTape::Value::members() const
+	{
+		expect(TAG_OBJECT_BEGIN);
+		return { MemberIterator{ tape, i + 1 }, MemberIterator{ tape, getEnd() - 1 } };
+	}
+
+	UniquePtr<JsonNode> JsonTape::Value::toNode() const SOUP_EXCAL
+	{
+		switch (getTag())
+		{
+		case TAG_OBJECT_BEGIN:
+			{
+				auto obj = soup::make_unique<JsonObject>();
+				obj->children.reserve(size());
+				for (const auto& member : members())
+				{
+					obj->children.emplace_back(member.key.toNode(), member.value.toNode());
+				}
+				return obj;
+			}
+
+		case TAG_ARRAY_BEGIN:
+			{
+				auto arr = soup::make_unique<JsonArray>();
+				arr->children.reserve(size());
+				for (const auto& elm : elements())
+				{
+					arr->children.emplace_back(elm.toNode());
+				}
+				return arr;
+			}
+
+		case TAG_STRING: return soup::make_unique<JsonString>(getString());
+		case TAG_INT: return soup::make_unique<JsonInt>(getInt());
+		case TAG_FLOAT: return soup::make_unique<JsonFloat>(getFloat());
+		case TAG_TRUE: return soup::make_unique<JsonBool>(true);
+		case TAG_FALSE: return soup::make_unique<JsonBool>(false);
+		default: break;
+		}
+		return soup::make_unique<JsonNull>();
+	}
+}
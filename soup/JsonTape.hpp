@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "base.hpp"
+#include "fwd.hpp"
+
+#include "JsonNodeType.hpp"
+#include "Optional.hpp"
+#include "UniquePtr.hpp"
+
+NAMESPACE_SOUP
+{
+	// A JSON parser that doesn't build a tree. The document is indexed into a flat tape of 64-bit words that refer back into the source,
+	// so strings without escape sequences can be used in-place, and object members are only looked up when asked for.
+	// The source must outlive the tape. Unlike json::decode, this is strict: Comments, trailing commas & non-string keys are rejected.
+	class JsonTape
+	{
+	public:
+		enum Tag : uint8_t
+		{
+			TAG_OBJECT_BEGIN = '{', // payload: index after the matching end (low 32 bits), number of members (high 24 bits, saturating)
+			TAG_OBJECT_END = '}', // payload: index of the begin
+			TAG_ARRAY_BEGIN = '[',
+			TAG_ARRAY_END = ']',
+			TAG_STRING = '"', // payload: offset of the contents in the source; next word: length, with the top bit set if it contains escape sequences
+			TAG_INT = 'l', // next word: the value
+			TAG_FLOAT = 'd', // next word: the value's bits
+			TAG_TRUE = 't',
+			TAG_FALSE = 'f',
+			TAG_NULL = 'n',
+		};
+
+		static constexpr size_t max_depth = 1024;
+
+		struct ElementIterator;
+		struct MemberIterator;
+		template <typename It> struct Range;
+
+		class Value
+		{
+		public:
+			const JsonTape* tape;
+			uint32_t i;
+
+			[[nodiscard]] Tag getTag() const noexcept { return static_cast<Tag>(tape->tape[i] >> 56); }
+			[[nodiscard]] JsonNodeType getType() const noexcept;
+
+			[[nodiscard]] bool isArr() const noexcept { return getTag() == TAG_ARRAY_BEGIN; }
+			[[nodiscard]] bool isBool() const noexcept { return getTag() == TAG_TRUE || getTag() == TAG_FALSE; }
+			[[nodiscard]] bool isFloat() const noexcept { return getTag() == TAG_FLOAT; }
+			[[nodiscard]] bool isInt() const noexcept { return getTag() == TAG_INT; }
+			[[nodiscard]] bool isNull() const noexcept { return getTag() == TAG_NULL; }
+			[[nodiscard]] bool isObj() const noexcept { return getTag() == TAG_OBJECT_BEGIN; }
+			[[nodiscard]] bool isStr() const noexcept { return getTag() == TAG_STRING; }
+
+			// These will throw if the value is of a different type.
+			[[nodiscard]] bool getBool() const;
+			[[nodiscard]] int64_t getInt() const;
+			[[nodiscard]] double getFloat() const; // valid for int & float
+			[[nodiscard]] std::string_view getRawString() const; // The contents as they appear in the source, so escape sequences are not resolved.
+			[[nodiscard]] bool hasEscapes() const;
+			[[nodiscard]] std::string getString() const SOUP_EXCAL; // Resolves escape sequences.
+
+			[[nodiscard]] size_t size() const; // Number of elements or members. Only valid for arrays & objects.
+
+			// Objects
+			[[nodiscard]] Optional<Value> find(std::string_view key) const SOUP_EXCAL;
+			[[nodiscard]] Value at(std::string_view key) const SOUP_EXCAL; // Throws if not found.
+			[[nodiscard]] bool contains(std::string_view key) const SOUP_EXCAL { return find(key).has_value(); }
+
+			// Arrays
+			[[nodiscard]] Value at(size_t index) const;
+
+			[[nodiscard]] UniquePtr<JsonNode> toNode() const SOUP_EXCAL;
+
+			[[nodiscard]] Value next() const noexcept; // The value following this one in the tape.
+
+			[[nodiscard]] Range<ElementIterator> elements() const; // Only valid for arrays.
+			[[nodiscard]] Range<MemberIterator> members() const; // Only valid for objects.
+
+		protected:
+			void expect(Tag tag) const;
+			[[nodiscard]] uint32_t getEnd() const noexcept { return static_cast<uint32_t>(tape->tape[i]); }
+		};
+
+		struct ElementIterator
+		{
+			const JsonTape* tape;
+			uint32_t i;
+
+			[[nodiscard]] Value operator*() const noexcept { return Value{ tape, i }; }
+			ElementIterator& operator++() noexcept { i = Value{ tape, i }.next().i; return *this; }
+			[[nodiscard]] bool operator!=(const ElementIterator& b) const noexcept { return i != b.i; }
+		};
+
+		struct Member
+		{
+			Value key;
+			Value value;
+		};
+
+		struct MemberIterator
+		{
+			const JsonTape* tape;
+			uint32_t i;
+
+			[[nodiscard]] Member operator*() const noexcept { return Member{ Value{ tape, i }, Value{ tape, i + 2 } }; }
+			MemberIterator& operator++() noexcept { i = Value{ tape, i + 2 }.next().i; return *this; }
+			[[nodiscard]] bool operator!=(const MemberIterator& b) const noexcept { return i != b.i; }
+		};
+
+		template <typename It>
+		struct Range
+		{
+			It b, e;
+
+			[[nodiscard]] It begin() const noexcept { return b; }
+			[[nodiscard]] It end() const noexcept { return e; }
+		};
+
+		const char* src = nullptr;
+		std::vector<uint32_t> structurals{}; // Offsets of structural characters, quotes & the first character of other scalars.
+		std::vector<uint64_t> tape{};
+
+		// Returns false if the input is not valid JSON.
+		[[nodiscard]] bool parse(const std::string& data) SOUP_EXCAL { return parse(data.data(), data.size()); }
+		[[nodiscard]] bool parse(const char* data, size_t size) SOUP_EXCAL;
+
+		[[nodiscard]] Value root() const noexcept { return Value{ this, 0 }; }
+
+	protected:
+		bool any_backslashes = false; // If not, no string needs to be checked for escape sequences.
+
+		[[nodiscard]] bool indexStructurals(const char* data, size_t size) SOUP_EXCAL;
+		[[nodiscard]] bool buildTape(const char* data, size_t size) SOUP_EXCAL;
+		[[nodiscard]] bool parseNumber(const char* data, size_t size, uint32_t offset) SOUP_EXCAL;
+	};
+}
@@ -0,0 +1,140 @@
+#include "JsonWriter.hpp"
+
+#include "JsonNode.hpp"
+#include "JsonString.hpp"
+#include "string.hpp"
+#include "Writer.hpp"
+
+NAMESPACE_SOUP
+{
+	JsonWriter::JsonWriter(Writer& w, size_t flush_threshold)
+		: w(w), flush_threshold(flush_threshold)
+	{
+	}
+
+	JsonWriter::~JsonWriter()
+	{
+		flush();
+	}
+
+	void JsonWriter::beginObject() SOUP_EXCAL
+	{
+		beginValue();
+		buf.push_back('{');
+		stack.push_back('{');
+		first = true;
+	}
+
+	void JsonWriter::endObject() SOUP_EXCAL
+	{
+		SOUP_ASSERT(!stack.empty() && stack.back() == '{' && !after_key);
+		stack.pop_back();
+		buf.push_back('}');
+		endValue();
+	}
+
+	void JsonWriter::beginArray() SOUP_EXCAL
+	{
+		beginValue();
+		buf.push_back('[');
+		stack.push_back('[');
+		first = true;
+	}
+
+	void JsonWriter::endArray() SOUP_EXCAL
+	{
+		SOUP_ASSERT(!stack.empty() && stack.back() == '[');
+		stack.pop_back();
+		buf.push_back(']');
+		endValue();
+	}
+
+	void JsonWriter::key(std::string_view k) SOUP_EXCAL
+	{
+		SOUP_ASSERT(!stack.empty() && stack.back() == '{' && !after_key);
+		if (!first)
+		{
+			buf.push_back(',');
+		}
+		JsonString::encodeAndAppendTo(buf, k);
+		buf.push_back(':');
+		after_key = true;
+	}
+
+	void JsonWriter::string(std::string_view v) SOUP_EXCAL
+	{
+		beginValue();
+		JsonString::encodeAndAppendTo(buf, v);
+		endValue();
+	}
+
+	void JsonWriter::integer(int64_t v) SOUP_EXCAL
+	{
+		beginValue();
+		buf.append(std::to_string(v));
+		endValue();
+	}
+
+	void JsonWriter::number(double v) SOUP_EXCAL
+	{
+		beginValue();
+		buf.append(string::fdecimal(v));
+		endValue();
+	}
+
+	void JsonWriter::boolean(bool v) SOUP_EXCAL
+	{
+		beginValue();
+		buf.append(v ? "true" : "false");
+		endValue();
+	}
+
+	void JsonWriter::null() SOUP_EXCAL
+	{
+		beginValue();
+		buf.append("null");
+		endValue();
+	}
+
+	void JsonWriter::node(const JsonNode& v) SOUP_EXCAL
+	{
+		beginValue();
+		v.encodeAndAppendTo(buf);
+		endValue();
+	}
+
+	bool JsonWriter::flush() noexcept
+	{
+		if (!buf.empty())
+		{
+			ok &= w.raw(buf.data(), buf.size());
+			buf.clear();
+		}
+		return ok;
+	}
+
+	void JsonWriter::beginValue() SOUP_EXCAL
+	{
+		if (!stack.empty())
+		{
+			if (stack.back() == '{')
+			{
+				SOUP_ASSERT(after_key);
+			}
+			else if (!first)
+			{
+				buf.push_back(',');
+			}
+		}
+	}
+
+	void JsonWriter::endValue() noexcept
+	{
+		first = false;
+		after_key = false;
+		if (buf.size() >= flush_threshold)
+		{
+			flush();
+		}
+	}
+}
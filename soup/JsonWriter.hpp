@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "base.hpp"
+#include "fwd.hpp"
+
+NAMESPACE_SOUP
+{
+	// Push-based JSON writer, so documents larger than memory can be produced incrementally.
+	// Commas & colons are inserted automatically. Output is buffered & handed to the Writer in chunks of about flush_threshold bytes.
+	class JsonWriter
+	{
+	public:
+		Writer& w;
+		size_t flush_threshold;
+
+	protected:
+		std::string buf{};
+		std::string stack{}; // '[' or '{' for every open container.
+		bool first = true; // No value has been written in the current container yet?
+		bool after_key = false;
+		bool ok = true;
+
+	public:
+		JsonWriter(Writer& w, size_t flush_threshold = 0x10000);
+		~JsonWriter();
+
+		void beginObject() SOUP_EXCAL;
+		void endObject() SOUP_EXCAL;
+		void beginArray() SOUP_EXCAL;
+		void endArray() SOUP_EXCAL;
+
+		void key(std::string_view k) SOUP_EXCAL;
+
+		void string(std::string_view v) SOUP_EXCAL;
+		void integer(int64_t v) SOUP_EXCAL;
+		void number(double v) SOUP_EXCAL;
+		void boolean(bool v) SOUP_EXCAL;
+		void null() SOUP_EXCAL;
+		void node(const JsonNode& v) SOUP_EXCAL; // Writes an entire tree, e.g. one element of a large array.
+
+		[[nodiscard]] size_t getDepth() const noexcept { return stack.size(); }
+
+		// Hands all buffered output to the Writer. Returns false if the Writer has failed at any point.
+		bool flush() noexcept;
+
+	protected:
+		void beginValue() SOUP_EXCAL;
+		void endValue() noexcept;
+	};
+}
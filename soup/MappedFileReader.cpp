@@ -0,0 +1,54 @@
+#include "MappedFileReader.hpp"
+
+#if !SOUP_WINDOWS
+#include <sys/mman.h>
+#endif
+
+#include "filesystem.hpp"
+
+NAMESPACE_SOUP
+{
+	MappedFileReader::MappedFileReader(const std::filesystem::path& path) noexcept
+		: Reader()
+	{
+		SOUP_TRY
+		{
+			data = reinterpret_cast<const uint8_t*>(filesystem::createFileMapping(path, size));
+		}
+		SOUP_CATCH_ANY
+		{
+		}
+		if (data == nullptr)
+		{
+			size = 0;
+		}
+	}
+
+	MappedFileReader::~MappedFileReader()
+	{
+		if (data != nullptr)
+		{
+			filesystem::destroyFileMapping(const_cast<uint8_t*>(data), size);
+		}
+	}
+
+	void MappedFileReader::adviseSequential() noexcept
+	{
+#if !SOUP_WINDOWS
+		if (size != 0)
+		{
+			madvise(const_cast<uint8_t*>(data), size, MADV_SEQUENTIAL);
+		}
+#endif
+	}
+
+	void MappedFileReader::adviseRandom() noexcept
+	{
+#if !SOUP_WINDOWS
+		if (size != 0)
+		{
+			madvise(const_cast<uint8_t*>(data), size, MADV_RANDOM);
+		}
+#endif
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Reader.hpp"
+
+#include <cstring> // memcpy
+#include <filesystem>
+
+NAMESPACE_SOUP
+{
+	// Reads a file through a read-only memory mapping, so reads don't go through iostreams and getSpan provides zero-copy access.
+	class MappedFileReader final : public Reader
+	{
+	public:
+		const uint8_t* data = nullptr;
+		size_t size = 0;
+		size_t offset = 0;
+
+		MappedFileReader(const std::filesystem::path& path) noexcept;
+		~MappedFileReader() final;
+
+		MappedFileReader(const MappedFileReader&) = delete;
+		MappedFileReader& operator=(const MappedFileReader&) = delete;
+
+		[[nodiscard]] bool isOpen() const noexcept { return data != nullptr; }
+
+		// Hints for the kernel's read-ahead. No-op where unsupported.
+		void adviseSequential() noexcept;
+		void adviseRandom() noexcept;
+
+		bool hasMore() noexcept final
+		{
+			return offset < size;
+		}
+
+		bool raw(void* out, size_t len) noexcept final
+		{
+			SOUP_IF_UNLIKELY (offset > size || len > size - offset)
+			{
+				return false;
+			}
+			memcpy(out, data + offset, len);
+			offset += len;
+			return true;
+		}
+
+		[[nodiscard]] size_t getPosition() noexcept final
+		{
+			return offset;
+		}
+
+		void seek(size_t pos) noexcept final
+		{
+			offset = pos;
+		}
+
+		void seekEnd() noexcept final
+		{
+			offset = size;
+		}
+
+		[[nodiscard]] const uint8_t* getSpan(size_t pos, size_t len) noexcept final
+		{
+			SOUP_IF_UNLIKELY (pos > size || len > size - pos)
+			{
+				return nullptr;
+			}
+			return data + pos;
+		}
+	};
+}
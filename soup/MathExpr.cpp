@@ -1,7 +1,7 @@
 #include "MathExpr.hpp"
 
+#include "irBytecodeVm.hpp"
 #include "irModule.hpp"
-#include "irVm.hpp"
 #include "laMathFrontend.hpp"
 
 NAMESPACE_SOUP
@@ -11,8 +11,8 @@ NAMESPACE_SOUP
 		laMathFrontend f;
 		auto m = f.parse(str);
 		auto memory = m.getContiguousMemory();
-		irVm vm(memory);
-		auto ret = vm.execute(m, m.func_exports.at(0));
+		irBytecodeVm vm(memory);
+		auto ret = vm.execute(irBytecode::compile(m), 0);
 		if (!ret.empty())
 		{
 			return ret.at(0).value.i64;
@@ -58,5 +58,14 @@ NAMESPACE_SOUP
 		{
 			offset = size;
 		}
+
+		[[nodiscard]] const uint8_t* getSpan(size_t pos, size_t len) noexcept final
+		{
+			SOUP_IF_UNLIKELY (pos > size || len > size - pos)
+			{
+				return nullptr;
+			}
+			return data + pos;
+		}
 	};
 }
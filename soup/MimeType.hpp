@@ -11,5 +11,7 @@ NAMESPACE_SOUP
 
 		inline static const char* IMAGE_PNG = "image/png";
 		inline static const char* IMAGE_SVG = "image/svg+xml";
+
+		inline static const char* APPLICATION_OCTET_STREAM = "application/octet-stream";
 	};
 }
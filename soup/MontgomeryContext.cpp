@@ -0,0 +1,392 @@
+#include "MontgomeryContext.hpp"
+
+#include <cstring> // memcpy, memset
+
+#include "CpuInfo.hpp"
+#include "Exception.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+#if SOUP_X86 && SOUP_BITS == 64 && (defined(__GNUC__) || defined(__clang__))
+#define MONTGOMERY_ADX true
+#else
+#define MONTGOMERY_ADX false
+#endif
+
+NAMESPACE_SOUP
+{
+	using limb_t = MontgomeryContext::limb_t;
+	using row_fn_t = limb_t(*)(limb_t* p, limb_t x, const limb_t* y, size_t n);
+
+	// Returns the low limb of a * b + c + d and stores the high limb in hi. This can't overflow.
+	[[nodiscard]] static SOUP_FORCEINLINE limb_t montgomery_mulAdd2(limb_t a, limb_t b, limb_t c, limb_t d, limb_t& hi) noexcept
+	{
+#if SOUP_BITS == 32
+		const uint64_t res = static_cast<uint64_t>(a) * b + c + d;
+		hi = static_cast<limb_t>(res >> 32);
+		return static_cast<limb_t>(res);
+#elif defined(_MSC_VER) && !defined(__clang__)
+	#if SOUP_X86
+		limb_t h;
+		limb_t lo = _umul128(a, b, &h);
+	#else
+		limb_t h = __umulh(a, b);
+		limb_t lo = a * b;
+	#endif
+		lo += c;
+		h += (lo < c);
+		lo += d;
+		h += (lo < d);
+		hi = h;
+		return lo;
+#else
+		const unsigned __int128 res = static_cast<unsigned __int128>(a) * b + c + d;
+		hi = static_cast<limb_t>(res >> 64);
+		return static_cast<limb_t>(res);
+#endif
+	}
+
+	// p[0..n) += x * y[0..n), returns the carry limb.
+	static limb_t montgomery_mulAddRow(limb_t* p, limb_t x, const limb_t* y, size_t n) noexcept
+	{
+		limb_t carry = 0;
+		for (size_t j = 0; j != n; ++j)
+		{
+			p[j] = montgomery_mulAdd2(x, y[j], p[j], carry, carry);
+		}
+		return carry;
+	}
+
+#if MONTGOMERY_ADX
+	// Same as montgomery_mulAddRow, but uses two independent carry chains: adox to add the previous high limb and adcx to add p[j].
+	static limb_t montgomery_mulAddRowAdx(limb_t* p, limb_t x, const limb_t* y, size_t n) noexcept
+	{
+		limb_t carry, lo, hi;
+		__asm__ volatile (
+			"xorl %k[carry], %k[carry]\n\t" // also clears CF & OF
+			"1:\n\t"
+			"jrcxz 2f\n\t"
+			"mulx (%[y]), %[lo], %[hi]\n\t"
+			"adox %[carry], %[lo]\n\t"
+			"adcx (%[p]), %[lo]\n\t"
+			"movq %[lo], (%[p])\n\t"
+			"movq %[hi], %[carry]\n\t"
+			"leaq 8(%[y]), %[y]\n\t"
+			"leaq 8(%[p]), %[p]\n\t"
+			"leaq -1(%%rcx), %%rcx\n\t"
+			"jmp 1b\n\t"
+			"2:\n\t"
+			"movl $0, %k[lo]\n\t"
+			"adox %[lo], %[carry]\n\t"
+			"adcx %[lo], %[carry]\n\t"
+			: [carry] "=&r" (carry), [lo] "=&r" (lo), [hi] "=&r" (hi), [p] "+r" (p), [y] "+r" (y), "+c" (n)
+			: "d" (x)
+			: "cc", "memory"
+		);
+		return carry;
+	}
+#endif
+
+	// Montgomery reduction of the 2n-limb t (which is modified), writing t * R^-1 mod m to out.
+	template <size_t N, row_fn_t row>
+	static void montgomery_reduce(limb_t* out, limb_t* t, const limb_t* m, limb_t m_inv, size_t n) noexcept
+	{
+		if constexpr (N != 0)
+		{
+			n = N;
+		}
+
+		limb_t top = 0;
+		for (size_t i = 0; i != n; ++i)
+		{
+			const limb_t c = row(t + i, t[i] * m_inv, m, n);
+			limb_t s = t[i + n] + c;
+			limb_t s_carry = (s < c);
+			s += top;
+			s_carry += (s < top);
+			t[i + n] = s;
+			top = s_carry;
+		}
+
+		// The result, top:t[n..2n), is less than 2m. Subtract m unless that borrows more than top, selecting without branching.
+		limb_t borrow = 0;
+		for (size_t j = 0; j != n; ++j)
+		{
+			const limb_t a = t[n + j];
+			const limb_t d = a - m[j];
+			const limb_t b1 = (a < m[j]);
+			out[j] = d - borrow;
+			borrow = b1 | (d < borrow);
+		}
+		const limb_t keep = static_cast<limb_t>(0) - ((top ^ 1) & borrow);
+		for (size_t j = 0; j != n; ++j)
+		{
+			out[j] = (t[n + j] & keep) | (out[j] & ~keep);
+		}
+	}
+
+	template <size_t N, row_fn_t row>
+	static void montgomery_multiply(limb_t* out, const limb_t* a, const limb_t* b, const limb_t* m, limb_t m_inv, size_t n) noexcept
+	{
+		if constexpr (N != 0)
+		{
+			n = N;
+		}
+
+		limb_t t[2 * MontgomeryContext::MAX_LIMBS];
+		memset(t, 0, n * sizeof(limb_t));
+		for (size_t i = 0; i != n; ++i)
+		{
+			t[i + n] = row(t + i, a[i], b, n);
+		}
+		montgomery_reduce<N, row>(out, t, m, m_inv, n);
+	}
+
+	template <size_t N, row_fn_t row>
+	static void montgomery_square(limb_t* out, const limb_t* a, const limb_t* m, limb_t m_inv, size_t n) noexcept
+	{
+		if constexpr (N != 0)
+		{
+			n = N;
+		}
+
+		// Sum a[i] * a[j] for i < j, double it, then add the a[i]^2 terms.
+		limb_t t[2 * MontgomeryContext::MAX_LIMBS];
+		memset(t, 0, (n + 1) * sizeof(limb_t));
+		for (size_t i = 0; i != n; ++i)
+		{
+			t[i + n] = row(t + 2 * i + 1, a[i], a + i + 1, n - i - 1);
+		}
+		limb_t shifted_out = 0;
+		for (size_t i = 0; i != 2 * n; ++i)
+		{
+			const limb_t v = t[i];
+			t[i] = (v << 1) | shifted_out;
+			shifted_out = v >> (MontgomeryContext::BITS_PER_LIMB - 1);
+		}
+		limb_t carry = 0;
+		for (size_t i = 0; i != n; ++i)
+		{
+			limb_t hi;
+			t[2 * i] = montgomery_mulAdd2(a[i], a[i], t[2 * i], carry, hi);
+			t[2 * i + 1] += hi;
+			carry = (t[2 * i + 1] < hi);
+		}
+		montgomery_reduce<N, row>(out, t, m, m_inv, n);
+	}
+
+	MontgomeryContext::MontgomeryContext(const Bigint& _m) SOUP_EXCAL
+		: modulus(_m), num_limbs((_m.getBitLength() + BITS_PER_LIMB - 1) / BITS_PER_LIMB)
+	{
+		SOUP_ASSERT(isSupportedModulus(_m));
+
+		m.resize(num_limbs);
+		toLimbs(m.data(), modulus);
+
+		// Newton's iteration doubles the number of correct low bits each step, and m * m = 1 (mod 8) for odd m.
+		limb_t inv = m[0];
+		for (int i = 0; i != 5; ++i)
+		{
+			inv *= 2 - m[0] * inv;
+		}
+		m_inv = static_cast<limb_t>(0) - inv;
+
+		one.resize(num_limbs);
+		toLimbs(one.data(), Bigint::_2pow(num_limbs * BITS_PER_LIMB).modUnsigned(modulus));
+		r2.resize(num_limbs);
+		toLimbs(r2.data(), Bigint::_2pow(num_limbs * BITS_PER_LIMB * 2).modUnsigned(modulus));
+
+#if MONTGOMERY_ADX
+		use_adx = (CpuInfo::get().supportsBMI2() && CpuInfo::get().supportsADX());
+#endif
+	}
+
+	bool MontgomeryContext::isSupportedModulus(const Bigint& m) noexcept
+	{
+		return m.isOdd()
+			&& !m.isNegative()
+			&& m.getBitLength() <= MAX_BITS
+			;
+	}
+
+	Bigint MontgomeryContext::modPow(const Bigint& base, const Bigint& e) const SOUP_EXCAL
+	{
+		const size_t n = num_limbs;
+		limb_t res[MAX_LIMBS];
+		limb_t x[MAX_LIMBS];
+		if (base >= modulus)
+		{
+			toLimbs(x, base.modUnsigned(modulus));
+		}
+		else
+		{
+			toLimbs(x, base);
+		}
+		enter(x, x);
+
+		const size_t bits = e.getBitLength();
+		if (bits <= 32)
+		{
+			// Short exponents are usually public, so a simple left-to-right binary method will do.
+			memcpy(res, one.data(), n * sizeof(limb_t));
+			for (size_t i = bits; i-- != 0; )
+			{
+				square(res, res);
+				if (e.getBit(i))
+				{
+					multiply(res, res, x);
+				}
+			}
+		}
+		else
+		{
+			// Fixed window, always multiplying by a table entry that is selected by scanning the whole table, so the timing doesn't depend on the exponent.
+			const size_t w = (bits > 512 ? 5 : 4);
+			const size_t table_size = (static_cast<size_t>(1) << w);
+			std::vector<limb_t> table(table_size * n);
+			memcpy(&table[0], one.data(), n * sizeof(limb_t));
+			memcpy(&table[n], x, n * sizeof(limb_t));
+			for (size_t i = 2; i != table_size; ++i)
+			{
+				multiply(&table[i * n], &table[(i - 1) * n], x);
+			}
+
+			limb_t entry[MAX_LIMBS];
+			for (size_t window = (bits + w - 1) / w; window-- != 0; )
+			{
+				size_t idx = 0;
+				for (size_t j = w; j-- != 0; )
+				{
+					idx <<= 1;
+					idx |= e.getBit(window * w + j);
+				}
+
+				memset(entry, 0, n * sizeof(limb_t));
+				for (size_t i = 0; i != table_size; ++i)
+				{
+					const limb_t diff = static_cast<limb_t>(i ^ idx);
+					const limb_t mask = ((diff | (static_cast<limb_t>(0) - diff)) >> (BITS_PER_LIMB - 1)) - 1;
+					for (size_t j = 0; j != n; ++j)
+					{
+						entry[j] |= (table[i * n + j] & mask);
+					}
+				}
+
+				if (window == (bits + w - 1) / w - 1)
+				{
+					memcpy(res, entry, n * sizeof(limb_t));
+				}
+				else
+				{
+					for (size_t j = 0; j != w; ++j)
+					{
+						square(res, res);
+					}
+					multiply(res, res, entry);
+				}
+			}
+		}
+
+		leave(res, res);
+		return fromLimbs(res);
+	}
+
+	Bigint MontgomeryContext::modMul(const Bigint& a, const Bigint& b) const SOUP_EXCAL
+	{
+		limb_t x[MAX_LIMBS];
+		limb_t y[MAX_LIMBS];
+		toLimbs(x, a);
+		toLimbs(y, b);
+		multiply(x, x, y); // a * b * R^-1
+		multiply(x, x, r2.data()); // a * b
+		return fromLimbs(x);
+	}
+
+	void MontgomeryContext::toLimbs(limb_t* out, const Bigint& x) const noexcept
+	{
+		constexpr size_t chunks_per_limb = sizeof(limb_t) / sizeof(Bigint::chunk_t);
+		for (size_t i = 0; i != num_limbs; ++i)
+		{
+			limb_t limb = 0;
+			for (size_t j = 0; j != chunks_per_limb; ++j)
+			{
+				limb |= (static_cast<limb_t>(x.getChunk(i * chunks_per_limb + j)) << (j * Bigint::getBitsPerChunk()));
+			}
+			out[i] = limb;
+		}
+	}
+
+	Bigint MontgomeryContext::fromLimbs(const limb_t* x) const SOUP_EXCAL
+	{
+		constexpr size_t chunks_per_limb = sizeof(limb_t) / sizeof(Bigint::chunk_t);
+		Bigint res;
+		for (size_t i = 0; i != num_limbs; ++i)
+		{
+			for (size_t j = 0; j != chunks_per_limb; ++j)
+			{
+				res.setChunk(i * chunks_per_limb + j, static_cast<Bigint::chunk_t>(x[i] >> (j * Bigint::getBitsPerChunk())));
+			}
+		}
+		res.shrink();
+		return res;
+	}
+
+	void MontgomeryContext::enter(limb_t* out, const limb_t* x) const noexcept
+	{
+		multiply(out, x, r2.data());
+	}
+
+	void MontgomeryContext::leave(limb_t* out, const limb_t* x) const noexcept
+	{
+		limb_t t[2 * MAX_LIMBS];
+		memcpy(t, x, num_limbs * sizeof(limb_t));
+		memset(t + num_limbs, 0, num_limbs * sizeof(limb_t));
+#if MONTGOMERY_ADX
+		if (use_adx)
+		{
+			return montgomery_reduce<0, &montgomery_mulAddRowAdx>(out, t, m.data(), m_inv, num_limbs);
+		}
+#endif
+		montgomery_reduce<0, &montgomery_mulAddRow>(out, t, m.data(), m_inv, num_limbs);
+	}
+
+	void MontgomeryContext::multiply(limb_t* out, const limb_t* a, const limb_t* b) const noexcept
+	{
+#if MONTGOMERY_ADX
+		if (use_adx)
+		{
+			return montgomery_multiply<0, &montgomery_mulAddRowAdx>(out, a, b, m.data(), m_inv, num_limbs);
+		}
+#endif
+		switch (num_limbs)
+		{
+		case 1024 / BITS_PER_LIMB: return montgomery_multiply<1024 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, b, m.data(), m_inv, num_limbs);
+		case 1536 / BITS_PER_LIMB: return montgomery_multiply<1536 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, b, m.data(), m_inv, num_limbs);
+		case 2048 / BITS_PER_LIMB: return montgomery_multiply<2048 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, b, m.data(), m_inv, num_limbs);
+		case 3072 / BITS_PER_LIMB: return montgomery_multiply<3072 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, b, m.data(), m_inv, num_limbs);
+		case 4096 / BITS_PER_LIMB: return montgomery_multiply<4096 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, b, m.data(), m_inv, num_limbs);
+		}
+		montgomery_multiply<0, &montgomery_mulAddRow>(out, a, b, m.data(), m_inv, num_limbs);
+	}
+
+	void MontgomeryContext::square(limb_t* out, const limb_t* a) const noexcept
+	{
+#if MONTGOMERY_ADX
+		if (use_adx)
+		{
+			return montgomery_square<0, &montgomery_mulAddRowAdx>(out, a, m.data(), m_inv, num_limbs);
+		}
+#endif
+		switch (num_limbs)
+		{
+		case 1024 / BITS_PER_LIMB: return montgomery_square<1024 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, m.data(), m_inv, num_limbs);
+		case 1536 / BITS_PER_LIMB: return montgomery_square<1536 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, m.data(), m_inv, num_limbs);
+		case 2048 / BITS_PER_LIMB: return montgomery_square<2048 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, m.data(), m_inv, num_limbs);
+		case 3072 / BITS_PER_LIMB: return montgomery_square<3072 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, m.data(), m_inv, num_limbs);
+		case 4096 / BITS_PER_LIMB: return montgomery_square<4096 / BITS_PER_LIMB, &montgomery_mulAddRow>(out, a, m.data(), m_inv, num_limbs);
+		}
+		montgomery_square<0, &montgomery_mulAddRow>(out, a, m.data(), m_inv, num_limbs);
+	}
+}
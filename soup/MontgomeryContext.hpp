@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "base.hpp"
+#include "Bigint.hpp"
+
+NAMESPACE_SOUP
+{
+	// Montgomery arithmetic modulo a fixed odd modulus on arrays of machine-word limbs, so exponentiation doesn't allocate per multiplication.
+	// Common RSA sizes have kernels specialised for their limb count, and x86-64 CPUs with BMI2 & ADX use a mulx/adcx/adox kernel.
+	class MontgomeryContext
+	{
+	public:
+#if SOUP_BITS == 64
+		using limb_t = uint64_t;
+#else
+		using limb_t = uint32_t;
+#endif
+
+		static constexpr size_t BITS_PER_LIMB = sizeof(limb_t) * 8;
+		static constexpr size_t MAX_BITS = 8192;
+		static constexpr size_t MAX_LIMBS = MAX_BITS / BITS_PER_LIMB;
+
+	protected:
+		Bigint modulus{};
+		size_t num_limbs = 0;
+		limb_t m_inv = 0; // -m^-1 mod 2^BITS_PER_LIMB
+		std::vector<limb_t> m{};
+		std::vector<limb_t> one{}; // R mod m, i.e. 1 in Montgomery form
+		std::vector<limb_t> r2{}; // R^2 mod m
+		bool use_adx = false;
+
+	public:
+		MontgomeryContext() noexcept = default;
+		MontgomeryContext(const Bigint& m) SOUP_EXCAL; // m must be a supported modulus.
+
+		[[nodiscard]] static bool isSupportedModulus(const Bigint& m) noexcept; // Odd, positive & at most MAX_BITS bits.
+
+		[[nodiscard]] const Bigint& getModulus() const noexcept { return modulus; }
+		[[nodiscard]] size_t getNumLimbs() const noexcept { return num_limbs; }
+
+		[[nodiscard]] Bigint modPow(const Bigint& base, const Bigint& e) const SOUP_EXCAL; // base must not be negative.
+		[[nodiscard]] Bigint modMul(const Bigint& a, const Bigint& b) const SOUP_EXCAL; // a and b must be less than the modulus.
+
+		// The following operate on arrays of getNumLimbs() limbs holding values less than the modulus. Outputs may alias inputs.
+
+		void toLimbs(limb_t* out, const Bigint& x) const noexcept;
+		[[nodiscard]] Bigint fromLimbs(const limb_t* x) const SOUP_EXCAL;
+		void enter(limb_t* out, const limb_t* x) const noexcept; // out = x * R mod m
+		void leave(limb_t* out, const limb_t* x) const noexcept; // out = x * R^-1 mod m
+		void multiply(limb_t* out, const limb_t* a, const limb_t* b) const noexcept; // out = a * b * R^-1 mod m
+		void square(limb_t* out, const limb_t* a) const noexcept; // out = a * a * R^-1 mod m
+	};
+}
@@ -0,0 +1,117 @@
+#include "PreadFileReader.hpp"
+
+#if SOUP_WINDOWS
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+NAMESPACE_SOUP
+{
+	PreadFileReader::PreadFileReader(const std::filesystem::path& path) noexcept
+		: Reader()
+	{
+#if SOUP_WINDOWS
+		h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (h != INVALID_HANDLE_VALUE)
+		{
+			LARGE_INTEGER liSize;
+			if (GetFileSizeEx(h, &liSize))
+			{
+				size = static_cast<size_t>(liSize.QuadPart);
+			}
+		}
+#else
+		fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd != -1)
+		{
+			struct stat st;
+			if (fstat(fd, &st) != -1)
+			{
+				size = static_cast<size_t>(st.st_size);
+			}
+		}
+#endif
+	}
+
+	PreadFileReader::~PreadFileReader()
+	{
+		if (isOpen())
+		{
+#if SOUP_WINDOWS
+			CloseHandle(h);
+#else
+			::close(fd);
+#endif
+		}
+	}
+
+	bool PreadFileReader::isOpen() const noexcept
+	{
+#if SOUP_WINDOWS
+		return h != INVALID_HANDLE_VALUE;
+#else
+		return fd != -1;
+#endif
+	}
+
+	void PreadFileReader::adviseSequential() noexcept
+	{
+#if SOUP_LINUX
+		if (isOpen())
+		{
+			posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+		}
+#endif
+	}
+
+	void PreadFileReader::adviseRandom() noexcept
+	{
+#if SOUP_LINUX
+		if (isOpen())
+		{
+			posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+		}
+#endif
+	}
+
+	bool PreadFileReader::raw(void* data, size_t len) noexcept
+	{
+		SOUP_IF_UNLIKELY (offset > size || len > size - offset)
+		{
+			return false;
+		}
+		auto out = reinterpret_cast<uint8_t*>(data);
+		while (len != 0)
+		{
+#if SOUP_WINDOWS
+			OVERLAPPED ov{};
+			ov.Offset = static_cast<DWORD>(static_cast<uint64_t>(offset));
+			ov.OffsetHigh = static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32);
+			DWORD chunk = (len > 0x40000000 ? 0x40000000 : static_cast<DWORD>(len));
+			DWORD read;
+			SOUP_IF_UNLIKELY (!ReadFile(h, out, chunk, &read, &ov) || read == 0)
+			{
+				return false;
+			}
+#else
+			const ssize_t read = ::pread(fd, out, len, static_cast<off_t>(offset));
+			SOUP_IF_UNLIKELY (read <= 0)
+			{
+				if (read == -1 && errno == EINTR)
+				{
+					continue;
+				}
+				return false;
+			}
+#endif
+			out += read;
+			offset += read;
+			len -= read;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Reader.hpp"
+
+#include <filesystem>
+
+NAMESPACE_SOUP
+{
+	// Reads a file with positional reads (pread on POSIX, ReadFile with an offset on Windows), so seeking is free and iostreams are not involved.
+	// Unlike MappedFileReader, this doesn't need address space for the whole file.
+	class PreadFileReader final : public Reader
+	{
+	public:
+#if SOUP_WINDOWS
+		void* h; // HANDLE
+#else
+		int fd;
+#endif
+		size_t size = 0;
+		size_t offset = 0;
+
+		PreadFileReader(const std::filesystem::path& path) noexcept;
+		~PreadFileReader() final;
+
+		PreadFileReader(const PreadFileReader&) = delete;
+		PreadFileReader& operator=(const PreadFileReader&) = delete;
+
+		[[nodiscard]] bool isOpen() const noexcept;
+
+		// Hints for the kernel's read-ahead. No-op where unsupported.
+		void adviseSequential() noexcept;
+		void adviseRandom() noexcept;
+
+		bool hasMore() noexcept final
+		{
+			return offset < size;
+		}
+
+		bool raw(void* data, size_t len) noexcept final;
+
+		[[nodiscard]] size_t getPosition() noexcept final
+		{
+			return offset;
+		}
+
+		void seek(size_t pos) noexcept final
+		{
+			offset = pos;
+		}
+
+		void seekEnd() noexcept final
+		{
+			offset = size;
+		}
+	};
+}
@@ -5,6 +5,12 @@
 
 #include "base.hpp"
 
+#include "bitutil.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__) && SOUP_X86
+#include <xmmintrin.h>
+#endif
+
 NAMESPACE_SOUP
 {
 	template <typename K, typename V>
@@ -19,6 +25,12 @@ NAMESPACE_SOUP
 
 		std::vector<Entry> data;
 
+		// Lower bounds in Eytzinger (BFS) order, 1-based, starting at index_offset so that element 0 is cache-line aligned.
+		// Built by freeze(), discarded when the data is modified through this class.
+		std::vector<K> index;
+		std::vector<uint32_t> index_order; // Eytzinger position -> position in data
+		size_t index_offset = 0;
+
 		void reserve(size_t i)
 		{
 			data.reserve(i);
@@ -26,6 +38,7 @@ NAMESPACE_SOUP
 
 		V& emplace(K begin, K end, V val)
 		{
+			unfreeze();
 			return data.emplace_back(Entry{ std::move(begin), std::move(end), std::move(val) }).data;
 		}
 
@@ -35,10 +48,47 @@ NAMESPACE_SOUP
 			{
 				return a.lower < b.lower;
 			});
+			freeze();
+		}
+
+		// Builds the lookup index. The data must be sorted and must not be modified directly while the index is in use.
+		void freeze()
+		{
+			unfreeze();
+			SOUP_IF_UNLIKELY (data.empty() || data.size() >= 0x7fffffff)
+			{
+				return;
+			}
+			constexpr size_t per_line = (sizeof(K) < 64 ? 64 / sizeof(K) : 1);
+			index.resize(data.size() + 1 + per_line);
+			index_offset = (per_line - ((reinterpret_cast<uintptr_t>(index.data()) / sizeof(K)) % per_line)) % per_line;
+			if ((reinterpret_cast<uintptr_t>(index.data()) % sizeof(K)) != 0)
+			{
+				index_offset = 0;
+			}
+			index_order.resize(data.size() + 1);
+			index_order[0] = static_cast<uint32_t>(data.size());
+			uint32_t pos = 0;
+			buildIndex(pos, 1);
+		}
+
+		void unfreeze() noexcept
+		{
+			index.clear();
+			index_order.clear();
+		}
+
+		[[nodiscard]] bool isFrozen() const noexcept
+		{
+			return !index_order.empty() && index_order.size() == data.size() + 1;
 		}
 
 		[[nodiscard]] V* find(const K& k)
 		{
+			if (isFrozen())
+			{
+				return findIndexed(k);
+			}
 			if (data.empty())
 			{
 				return nullptr;
@@ -73,10 +123,114 @@ NAMESPACE_SOUP
 			return const_cast<RangeMap<K, V>*>(this)->find(k);
 		}
 
+		// Looks up many keys at once, interleaving the searches so their cache misses overlap.
+		void findMany(const K* keys, V** out, size_t count)
+		{
+			if (!isFrozen())
+			{
+				for (size_t j = 0; j != count; ++j)
+				{
+					out[j] = find(keys[j]);
+				}
+				return;
+			}
+			constexpr size_t lanes = 8;
+			const uint32_t n = static_cast<uint32_t>(data.size());
+			const K* const b = &index[index_offset];
+			for (; count != 0; )
+			{
+				const size_t batch = (count < lanes ? count : lanes);
+				uint32_t is[lanes];
+				for (size_t l = 0; l != batch; ++l)
+				{
+					is[l] = 1;
+				}
+				for (bool more = true; more; )
+				{
+					more = false;
+					for (size_t l = 0; l != batch; ++l)
+					{
+						if (is[l] <= n)
+						{
+							prefetch(b + static_cast<size_t>(is[l]) * prefetch_stride);
+							is[l] = 2 * is[l] + !(keys[l] < b[is[l]]);
+							more = true;
+						}
+					}
+				}
+				for (size_t l = 0; l != batch; ++l)
+				{
+					out[l] = resolveIndexed(keys[l], is[l]);
+				}
+				keys += batch;
+				out += batch;
+				count -= batch;
+			}
+		}
+
+		void findMany(const K* keys, const V** out, size_t count) const
+		{
+			const_cast<RangeMap<K, V>*>(this)->findMany(keys, const_cast<V**>(out), count);
+		}
+
 		void clear() noexcept
 		{
 			data.clear();
 			data.shrink_to_fit();
+			index.clear();
+			index.shrink_to_fit();
+			index_order.clear();
+			index_order.shrink_to_fit();
+		}
+
+	protected:
+		static constexpr size_t prefetch_stride = (sizeof(K) < 64 ? 64 / sizeof(K) : 1);
+
+		void buildIndex(uint32_t& pos, uint32_t i)
+		{
+			if (i <= data.size())
+			{
+				buildIndex(pos, 2 * i);
+				index[index_offset + i] = data[pos].lower;
+				index_order[i] = pos++;
+				buildIndex(pos, 2 * i + 1);
+			}
+		}
+
+		[[nodiscard]] V* findIndexed(const K& k)
+		{
+			const uint32_t n = static_cast<uint32_t>(data.size());
+			const K* const b = &index[index_offset];
+			uint32_t i = 1;
+			while (i <= n)
+			{
+				prefetch(b + static_cast<size_t>(i) * prefetch_stride);
+				i = 2 * i + !(k < b[i]);
+			}
+			return resolveIndexed(k, i);
+		}
+
+		[[nodiscard]] V* resolveIndexed(const K& k, uint32_t i)
+		{
+			// The search went right at every level after the last left turn; undo those to find the first lower bound greater than k.
+			i >>= bitutil::getLeastSignificantSetBit(~i) + 1;
+			const uint32_t j = index_order[i];
+			if (j != 0 && !(data[j - 1].upper < k))
+			{
+				return &data[j - 1].data;
+			}
+			return nullptr;
+		}
+
+		static SOUP_FORCEINLINE void prefetch(const void* p) noexcept
+		{
+#if defined(_MSC_VER) && !defined(__clang__)
+	#if SOUP_X86
+			_mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0);
+	#endif
+#else
+			__builtin_prefetch(p);
+#endif
 		}
 	};
 }
@@ -18,6 +18,9 @@ NAMESPACE_SOUP
 		void seekBegin() { seek(0); }
 		virtual void seekEnd() = 0;
 
+		// Zero-copy access for readers that are backed by memory. Returns nullptr if unsupported or out of bounds. Does not change the position.
+		[[nodiscard]] virtual const uint8_t* getSpan(size_t, size_t) noexcept { return nullptr; }
+
 		[[nodiscard]] size_t getRemainingBytes()
 		{
 			const size_t pos = getPosition();
@@ -93,15 +96,15 @@ NAMESPACE_SOUP
 			while (u8(byte))
 			{
 				v |= (static_cast<Int>(byte & 0x7F) << shift);
+				shift += 7;
 				if (!(byte & 0x80))
 				{
 					if (shift < (sizeof(Int) * 8) && (byte & 0x40))
 					{
-						v |= (~0 << shift);
+						v |= static_cast<Int>(~uint64_t(0) << shift);
 					}
 					return true;
 				}
-				shift += 7;
 			}
 			return false;
 		}
@@ -205,8 +205,34 @@ NAMESPACE_SOUP
 	RegexMatchResult Regex::search(const char* it, const char* end) const noexcept
 	{
 		RegexMatcher m(*this, it, end);
+		if (dfa.isSupported())
+		{
+			// The DFA tells us where the leftmost match starts, so we only need to run the matcher once to get the groups.
+			const char* match_begin = dfa.findLeftmostStart(it, end);
+			if (match_begin == nullptr
+				|| match_begin == end
+				)
+			{
+				return {};
+			}
+			auto res = match(m, match_begin);
+			if (res.isSuccess())
+			{
+				return res;
+			}
+			m.reset(*this);
+			it = match_begin + 1;
+		}
 		for (; it != end; ++it)
 		{
+			if (!dfa.prefix.empty())
+			{
+				it = dfa.findPrefix(it, end);
+				if (it == end)
+				{
+					break;
+				}
+			}
 #if REGEX_DEBUG_MATCH
 			std::cout << "--- Attempting match with " << std::distance(m.begin, it) << " byte offset ---\r\n";
 #endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "RegexDfa.hpp"
 #include "RegexFlags.hpp"
 #include "RegexGroup.hpp"
 #include "RegexMatchResult.hpp"
@@ -9,6 +10,7 @@ NAMESPACE_SOUP
 	struct Regex
 	{
 		RegexGroup group;
+		RegexDfa dfa;
 
 		Regex(const std::string& pattern, const char* flags)
 			: Regex(pattern.data(), &pattern.data()[pattern.size()], parseFlags(flags))
@@ -21,7 +23,7 @@ NAMESPACE_SOUP
 		}
 
 		Regex(const char* it, const char* end, uint16_t flags)
-			: group(it, end, flags)
+			: group(it, end, flags), dfa(group)
 		{
 		}
 
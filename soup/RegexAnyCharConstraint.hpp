@@ -58,6 +58,24 @@ NAMESPACE_SOUP
 			}
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			if constexpr (unicode)
+			{
+				return DFA_UNSUPPORTED;
+			}
+			auto& set = bytes.emplace_back();
+			for (uint16_t i = 0; i != 0x100; ++i)
+			{
+				set.enable(i);
+			}
+			if constexpr (!dotall)
+			{
+				set.disable('\n');
+			}
+			return DFA_BYTES;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 1;
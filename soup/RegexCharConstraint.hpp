@@ -50,6 +50,12 @@ NAMESPACE_SOUP
 			return str;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			bytes.emplace_back().enable(static_cast<unsigned char>(c));
+			return DFA_BYTES;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 1;
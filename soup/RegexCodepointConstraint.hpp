@@ -42,6 +42,15 @@ NAMESPACE_SOUP
 			set |= RE_UNICODE;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			for (const auto& b : c)
+			{
+				bytes.emplace_back().enable(static_cast<unsigned char>(b));
+			}
+			return DFA_BYTES;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 1;
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include "fwd.hpp"
 
+#include "BigBitset.hpp"
 #include "Exception.hpp"
 
 NAMESPACE_SOUP
@@ -14,6 +16,20 @@ NAMESPACE_SOUP
 		inline static RegexConstraint* ROLLBACK_TO_SUCCESS = reinterpret_cast<RegexConstraint*>(0b100);
 		inline static uintptr_t MASK = 0b11;
 
+		enum DfaKind : uint8_t
+		{
+			DFA_UNSUPPORTED,
+			DFA_EPSILON, // Always matches without consuming anything.
+			DFA_BYTES, // Consumes one byte per set appended to 'bytes'.
+			DFA_ASSERT_START, // \A, or ^ without multi_line
+			DFA_ASSERT_START_LINE, // ^ with multi_line
+			DFA_ASSERT_END, // \z, or $ with dollar_endonly
+			DFA_ASSERT_END_LINE, // $ with multi_line
+			DFA_ASSERT_END_OR_FINAL_NEWLINE, // \Z, or $
+			DFA_ASSERT_WORD_BOUNDARY,
+			DFA_ASSERT_NOT_WORD_BOUNDARY,
+		};
+
 		RegexConstraint* success_transition = nullptr;
 		RegexConstraint* rollback_transition = nullptr;
 		const RegexGroup* group = nullptr;
@@ -68,5 +84,11 @@ NAMESPACE_SOUP
 		[[nodiscard]] virtual std::string toString() const noexcept = 0;
 
 		virtual void getFlags(uint16_t& set, uint16_t& unset) const noexcept {}
+
+		// Describes this constraint for RegexDfa. Constraints that depend on captures or move the cursor elsewhere can't be compiled.
+		[[nodiscard]] virtual DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>&) const SOUP_EXCAL
+		{
+			return DFA_UNSUPPORTED;
+		}
 	};
 }
@@ -0,0 +1,654 @@
+#include "RegexDfa.hpp"
+
+#include <algorithm> // fill, sort
+#include <cstring> // memchr, memcmp, memcpy
+#include <unordered_map>
+
+#include "RegexGroup.hpp"
+#include "string.hpp"
+
+NAMESPACE_SOUP
+{
+	// Symbols are bytes, plus the boundaries of the input and a '\n' that is the last byte of the input, which $ treats specially.
+	static constexpr uint16_t REGEXDFA_SYM_BOUNDARY = 0x100;
+	static constexpr uint16_t REGEXDFA_SYM_FINAL_NEWLINE = 0x101;
+	static constexpr uint16_t REGEXDFA_NUM_SYMS = 0x102;
+
+	static constexpr size_t REGEXDFA_MAX_STATES = 1000;
+	static constexpr uint32_t REGEXDFA_UNKNOWN = -1;
+	static constexpr uint32_t REGEXDFA_GROUP_END = -1;
+
+	// What assertions need to know about the byte on either side of a position.
+	enum RegexDfaInfo : uint8_t
+	{
+		REGEXDFA_BOUNDARY = (1 << 0),
+		REGEXDFA_NEWLINE = (1 << 1),
+		REGEXDFA_WORD = (1 << 2),
+		REGEXDFA_FINAL_NEWLINE = (1 << 3),
+	};
+
+	[[nodiscard]] static uint16_t regexdfa_symbol(const char* p, const char* end) noexcept
+	{
+		if (p == end)
+		{
+			return REGEXDFA_SYM_BOUNDARY;
+		}
+		if (*p == '\n' && p + 1 == end)
+		{
+			return REGEXDFA_SYM_FINAL_NEWLINE;
+		}
+		return static_cast<uint8_t>(*p);
+	}
+
+	[[nodiscard]] static uint8_t regexdfa_info(uint16_t sym) noexcept
+	{
+		if (sym == REGEXDFA_SYM_BOUNDARY)
+		{
+			return REGEXDFA_BOUNDARY;
+		}
+		if (sym == REGEXDFA_SYM_FINAL_NEWLINE)
+		{
+			return REGEXDFA_NEWLINE | REGEXDFA_FINAL_NEWLINE;
+		}
+		uint8_t info = 0;
+		if (sym == '\n')
+		{
+			info |= REGEXDFA_NEWLINE;
+		}
+		if (string::isWordChar(static_cast<char>(sym)))
+		{
+			info |= REGEXDFA_WORD;
+		}
+		return info;
+	}
+
+	[[nodiscard]] static bool regexdfa_assert(uint8_t kind, uint8_t prev, uint8_t next) noexcept
+	{
+		switch (kind)
+		{
+		case RegexConstraint::DFA_ASSERT_START: return prev & REGEXDFA_BOUNDARY;
+		case RegexConstraint::DFA_ASSERT_START_LINE: return prev & (REGEXDFA_BOUNDARY | REGEXDFA_NEWLINE);
+		case RegexConstraint::DFA_ASSERT_END: return next & REGEXDFA_BOUNDARY;
+		case RegexConstraint::DFA_ASSERT_END_LINE: return next & (REGEXDFA_BOUNDARY | REGEXDFA_NEWLINE);
+		case RegexConstraint::DFA_ASSERT_END_OR_FINAL_NEWLINE: return next & (REGEXDFA_BOUNDARY | REGEXDFA_FINAL_NEWLINE);
+		case RegexConstraint::DFA_ASSERT_WORD_BOUNDARY:
+		case RegexConstraint::DFA_ASSERT_NOT_WORD_BOUNDARY:
+			{
+				bool boundary = true;
+				if (((prev | next) & REGEXDFA_BOUNDARY) == 0)
+				{
+					boundary = ((prev & REGEXDFA_WORD) != (next & REGEXDFA_WORD));
+				}
+				return boundary == (kind == RegexConstraint::DFA_ASSERT_WORD_BOUNDARY);
+			}
+		}
+		return false;
+	}
+
+	[[nodiscard]] static bool regexdfa_isWithinLookaround(const RegexConstraint* c) noexcept
+	{
+		for (auto g = c->group; g; g = g->parent)
+		{
+			if (g->lookahead_or_lookbehind)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	[[nodiscard]] static int regexdfa_getSingleByte(const BigBitset<0x100 / 8>& set) noexcept
+	{
+		int res = -1;
+		for (uint16_t i = 0; i != 0x100; ++i)
+		{
+			if (set.get(i))
+			{
+				if (res != -1)
+				{
+					return -1;
+				}
+				res = i;
+			}
+		}
+		return res;
+	}
+
+	// A DFA state is a list of groups of NFA nodes, ordered by the position that their threads started matching at, with a node only kept in the earliest group it's in.
+	// When searching forwards, a new group is added at every position until something matches; groups after the one that matched are then dropped, as the leftmost match can't be in them.
+	// When searching backwards, there's only one group and we just look for the last position that reaches the accepting node.
+	struct RegexDfaCache
+	{
+		enum KeyFlags : uint8_t
+		{
+			ADDING = (1 << 0), // A new group for the initial node is added at every position.
+			MARKED = (1 << 1), // The last group has matched.
+		};
+
+		enum StateProperties : uint8_t
+		{
+			DEAD = (1 << 0),
+			DONE = (1 << 1), // Only the group that matched is left.
+			SKIPPABLE = (1 << 2), // Nothing but the initial node at this position.
+		};
+
+		const std::vector<std::vector<RegexDfa::Edge>>& graph;
+		const std::vector<BigBitset<0x100 / 8>>& sets;
+		const uint32_t start;
+		const uint32_t accept;
+		const bool reverse;
+
+		std::unordered_map<std::string, uint32_t> map{};
+		std::vector<std::string> keys{};
+		std::vector<uint8_t> properties{};
+		std::vector<uint32_t> transitions{};
+
+		std::vector<uint32_t> visited;
+		std::vector<uint32_t> seen;
+		uint32_t epoch = 0;
+		std::vector<uint32_t> stack{};
+		std::vector<std::vector<uint32_t>> groups{};
+
+		RegexDfaCache(const RegexDfa& dfa, bool reverse) SOUP_EXCAL
+			: graph(reverse ? dfa.backward : dfa.forward), sets(dfa.sets), start(reverse ? RegexDfa::ACCEPT : dfa.initial), accept(reverse ? dfa.initial : RegexDfa::ACCEPT), reverse(reverse),
+			visited(graph.size(), 0), seen(graph.size(), 0)
+		{
+		}
+
+		[[nodiscard]] uint32_t getStartState(uint8_t info) SOUP_EXCAL
+		{
+			std::string key(2, '\0');
+			key[0] = (reverse ? 0 : ADDING);
+			key[1] = info;
+			appendNode(key, start);
+			appendNode(key, REGEXDFA_GROUP_END);
+			return getState(std::move(key));
+		}
+
+		// Returns the next state shifted left by 1, with the lowest bit set if the accepting node was reached before consuming sym.
+		[[nodiscard]] uint32_t step(uint32_t& s, uint16_t sym) SOUP_EXCAL
+		{
+			const uint32_t t = transitions[s * REGEXDFA_NUM_SYMS + sym];
+			if (t != REGEXDFA_UNKNOWN)
+			{
+				return t;
+			}
+			return compute(s, sym);
+		}
+
+		[[nodiscard]] uint8_t getProperties(uint32_t s) const noexcept
+		{
+			return properties[s];
+		}
+
+	protected:
+		static void appendNode(std::string& key, uint32_t node) SOUP_EXCAL
+		{
+			key.append(reinterpret_cast<const char*>(&node), sizeof(node));
+		}
+
+		[[nodiscard]] uint32_t getState(std::string&& key) SOUP_EXCAL
+		{
+			if (auto e = map.find(key); e != map.end())
+			{
+				return e->second;
+			}
+
+			// Work out the properties of the new state.
+			const uint8_t flags = key[0];
+			size_t num_groups = 0;
+			size_t num_nodes = 0;
+			bool only_start = true;
+			for (size_t i = 2; i != key.size(); i += sizeof(uint32_t))
+			{
+				uint32_t node;
+				memcpy(&node, &key[i], sizeof(node));
+				if (node == REGEXDFA_GROUP_END)
+				{
+					++num_groups;
+				}
+				else
+				{
+					++num_nodes;
+					only_start &= (node == start);
+				}
+			}
+			uint8_t props = 0;
+			if (num_nodes == 0 && !(flags & MARKED))
+			{
+				props |= DEAD;
+			}
+			if ((flags & MARKED) && num_groups == 1)
+			{
+				props |= DONE;
+			}
+			if ((flags & ADDING) && num_groups == 1 && num_nodes == 1 && only_start)
+			{
+				props |= SKIPPABLE;
+			}
+
+			const auto s = static_cast<uint32_t>(keys.size());
+			map.emplace(key, s);
+			keys.emplace_back(std::move(key));
+			properties.emplace_back(props);
+			transitions.resize(transitions.size() + REGEXDFA_NUM_SYMS, REGEXDFA_UNKNOWN);
+			return s;
+		}
+
+		[[nodiscard]] uint32_t compute(uint32_t& s, uint16_t sym) SOUP_EXCAL
+		{
+			const std::string cur = keys[s];
+			uint8_t flags = cur[0];
+			const uint8_t ctx = cur[1];
+			const uint8_t info = regexdfa_info(sym);
+			const uint8_t prev = (reverse ? info : ctx);
+			const uint8_t next = (reverse ? ctx : info);
+			const int byte = (sym < 0x100 ? sym : (sym == REGEXDFA_SYM_FINAL_NEWLINE ? '\n' : -1));
+
+			SOUP_IF_UNLIKELY (++epoch == 0)
+			{
+				std::fill(visited.begin(), visited.end(), 0);
+				std::fill(seen.begin(), seen.end(), 0);
+				epoch = 1;
+			}
+			groups.clear();
+			size_t matched_group = -1;
+			size_t i = 2;
+			while (i != cur.size())
+			{
+				auto& out = groups.emplace_back();
+				for (; ; i += sizeof(uint32_t))
+				{
+					uint32_t node;
+					memcpy(&node, &cur[i], sizeof(node));
+					if (node == REGEXDFA_GROUP_END)
+					{
+						i += sizeof(uint32_t);
+						break;
+					}
+					if (visited[node] != epoch)
+					{
+						visited[node] = epoch;
+						stack.emplace_back(node);
+					}
+				}
+				bool matched = false;
+				while (!stack.empty())
+				{
+					const uint32_t node = stack.back();
+					stack.pop_back();
+					if (node == accept)
+					{
+						matched = true;
+					}
+					for (const auto& e : graph[node])
+					{
+						if (e.kind == RegexConstraint::DFA_BYTES)
+						{
+							if (byte != -1
+								&& sets[e.set].get(byte)
+								&& seen[e.target] != epoch
+								)
+							{
+								seen[e.target] = epoch;
+								out.emplace_back(e.target);
+							}
+						}
+						else if (visited[e.target] != epoch
+							&& (e.kind == RegexConstraint::DFA_EPSILON || regexdfa_assert(e.kind, prev, next))
+							)
+						{
+							visited[e.target] = epoch;
+							stack.emplace_back(e.target);
+						}
+					}
+				}
+				if (matched)
+				{
+					matched_group = groups.size() - 1;
+					if (!reverse)
+					{
+						// Threads that started later don't matter anymore.
+						flags |= MARKED;
+						flags &= ~ADDING;
+						break;
+					}
+				}
+			}
+
+			std::string key(2, '\0');
+			key[1] = regexdfa_info(sym);
+			for (size_t g = 0; g != groups.size(); ++g)
+			{
+				const bool is_marker = ((flags & MARKED) && g + 1 == groups.size());
+				if (groups[g].empty() && !is_marker)
+				{
+					continue;
+				}
+				std::sort(groups[g].begin(), groups[g].end());
+				for (const auto& node : groups[g])
+				{
+					appendNode(key, node);
+				}
+				appendNode(key, REGEXDFA_GROUP_END);
+			}
+			if ((flags & ADDING) && seen[start] != epoch)
+			{
+				appendNode(key, start);
+				appendNode(key, REGEXDFA_GROUP_END);
+			}
+			key[0] = flags;
+
+			if (keys.size() >= REGEXDFA_MAX_STATES && map.find(key) == map.end())
+			{
+				// Cache is full, start over with just the current state.
+				map.clear();
+				keys.clear();
+				properties.clear();
+				transitions.clear();
+				s = getState(std::string(cur));
+			}
+			const uint32_t t = (getState(std::move(key)) << 1) | (matched_group != static_cast<size_t>(-1));
+			transitions[s * REGEXDFA_NUM_SYMS + sym] = t;
+			return t;
+		}
+	};
+
+	struct RegexDfaCaches
+	{
+		RegexDfaCache forward;
+		RegexDfaCache backward;
+
+		RegexDfaCaches(const RegexDfa& dfa) SOUP_EXCAL
+			: forward(dfa, false), backward(dfa, true)
+		{
+		}
+	};
+
+	RegexDfa::RegexDfa() noexcept = default;
+
+	RegexDfa::RegexDfa(RegexDfa&& b) noexcept
+		: forward(std::move(b.forward)), backward(std::move(b.backward)), sets(std::move(b.sets)), initial(b.initial), prefix(std::move(b.prefix)), supported(b.supported)
+	{
+	}
+
+	RegexDfa::~RegexDfa() noexcept = default;
+
+	RegexDfa::RegexDfa(const RegexGroup& g) SOUP_EXCAL
+	{
+		const auto initial_raw = reinterpret_cast<uintptr_t>(g.initial);
+		if ((initial_raw & ~RegexConstraint::MASK) == 0)
+		{
+			return;
+		}
+
+		std::vector<BigBitset<0x100 / 8>> bytes;
+
+		// Find the literal prefix by following the graph as long as there is only one way to go.
+		if ((initial_raw & 0b1) == 0)
+		{
+			auto c = reinterpret_cast<const RegexConstraint*>(initial_raw & ~RegexConstraint::MASK);
+			for (size_t steps = 0; steps != 0x100; ++steps)
+			{
+				if (c->rollback_transition
+					|| regexdfa_isWithinLookaround(c)
+					)
+				{
+					break;
+				}
+				bytes.clear();
+				const auto kind = c->getDfaKind(bytes);
+				if (kind == RegexConstraint::DFA_BYTES)
+				{
+					bool all_single = true;
+					for (const auto& set : bytes)
+					{
+						const int b = regexdfa_getSingleByte(set);
+						if (b == -1)
+						{
+							all_single = false;
+							break;
+						}
+						prefix.push_back(static_cast<char>(b));
+					}
+					if (!all_single)
+					{
+						break;
+					}
+				}
+				else if (kind != RegexConstraint::DFA_EPSILON)
+				{
+					break;
+				}
+				const auto next = reinterpret_cast<uintptr_t>(c->success_transition);
+				if ((next & 0b1)
+					|| (next & ~RegexConstraint::MASK) == 0
+					|| (next & ~RegexConstraint::MASK) == reinterpret_cast<uintptr_t>(RegexConstraint::SUCCESS_TO_FAIL)
+					)
+				{
+					break;
+				}
+				c = reinterpret_cast<const RegexConstraint*>(next & ~RegexConstraint::MASK);
+			}
+		}
+
+		// Compile the graph into an NFA.
+		std::unordered_map<const RegexConstraint*, uint32_t> ids{};
+		std::vector<std::pair<const RegexConstraint*, uint32_t>> queue{};
+		forward.emplace_back(); // ACCEPT
+		bool ok = true;
+		auto get_id = [&](uintptr_t raw, bool is_rollback) -> uint32_t
+		{
+			const uintptr_t target = (raw & ~RegexConstraint::MASK);
+			if (raw & 0b1) // Checkpoints are only used for lookaheads.
+			{
+				ok = false;
+				return ACCEPT;
+			}
+			if (target == 0)
+			{
+				return ACCEPT;
+			}
+			if (target == reinterpret_cast<uintptr_t>(RegexConstraint::SUCCESS_TO_FAIL))
+			{
+				// As a rollback transition, this means success. As a success transition, it's used for negative lookarounds.
+				ok &= is_rollback;
+				return ACCEPT;
+			}
+			const auto c = reinterpret_cast<const RegexConstraint*>(target);
+			if (auto e = ids.find(c); e != ids.end())
+			{
+				return e->second;
+			}
+			const auto id = static_cast<uint32_t>(forward.size());
+			forward.emplace_back();
+			ids.emplace(c, id);
+			queue.emplace_back(c, id);
+			return id;
+		};
+		initial = get_id(initial_raw, false);
+		for (size_t i = 0; ok && i != queue.size(); ++i)
+		{
+			const auto c = queue[i].first;
+			const auto id = queue[i].second;
+			if (regexdfa_isWithinLookaround(c))
+			{
+				ok = false;
+				break;
+			}
+			if (c->rollback_transition)
+			{
+				const auto target = get_id(reinterpret_cast<uintptr_t>(c->rollback_transition), true);
+				forward[id].emplace_back(Edge{ target, 0, RegexConstraint::DFA_EPSILON });
+			}
+			bytes.clear();
+			const auto kind = c->getDfaKind(bytes);
+			if (kind == RegexConstraint::DFA_UNSUPPORTED)
+			{
+				ok = false;
+				break;
+			}
+			const auto target = get_id(reinterpret_cast<uintptr_t>(c->success_transition), false);
+			if (kind == RegexConstraint::DFA_BYTES)
+			{
+				// Chain a node per byte.
+				uint32_t from = id;
+				for (size_t j = 0; j != bytes.size(); ++j)
+				{
+					uint32_t to = target;
+					if (j + 1 != bytes.size())
+					{
+						to = static_cast<uint32_t>(forward.size());
+						forward.emplace_back();
+					}
+					forward[from].emplace_back(Edge{ to, static_cast<uint32_t>(sets.size()), RegexConstraint::DFA_BYTES });
+					sets.emplace_back(bytes[j]);
+					from = to;
+				}
+			}
+			else
+			{
+				forward[id].emplace_back(Edge{ target, 0, static_cast<uint8_t>(kind) });
+			}
+		}
+		if (!ok)
+		{
+			forward.clear();
+			sets.clear();
+			initial = ACCEPT;
+			return;
+		}
+
+		backward.resize(forward.size());
+		for (uint32_t from = 0; from != forward.size(); ++from)
+		{
+			for (const auto& e : forward[from])
+			{
+				backward[e.target].emplace_back(Edge{ from, e.set, e.kind });
+			}
+		}
+		supported = true;
+	}
+
+	const char* RegexDfa::findPrefix(const char* it, const char* end) const noexcept
+	{
+		const size_t len = prefix.size();
+		while (static_cast<size_t>(end - it) >= len)
+		{
+			auto p = static_cast<const char*>(memchr(it, prefix[0], (end - it) - len + 1));
+			if (p == nullptr)
+			{
+				break;
+			}
+			if (memcmp(p + 1, prefix.data() + 1, len - 1) == 0)
+			{
+				return p;
+			}
+			it = p + 1;
+		}
+		return end;
+	}
+
+	const char* RegexDfa::findLeftmostStart(const char* begin, const char* end) const SOUP_EXCAL
+	{
+		struct CachesLease
+		{
+			std::atomic_bool* in_use = nullptr;
+			UniquePtr<RegexDfaCaches> local{};
+
+			~CachesLease()
+			{
+				if (in_use)
+				{
+					in_use->store(false, std::memory_order_release);
+				}
+			}
+		};
+		CachesLease lease;
+		RegexDfaCaches* caches;
+		if (!caches_in_use.exchange(true, std::memory_order_acquire))
+		{
+			lease.in_use = &caches_in_use;
+			if (!this->caches)
+			{
+				this->caches = soup::make_unique<RegexDfaCaches>(*this);
+			}
+			caches = this->caches.get();
+		}
+		else
+		{
+			lease.local = soup::make_unique<RegexDfaCaches>(*this);
+			caches = lease.local.get();
+		}
+
+		// Find where the leftmost match ends.
+		const char* match_end = nullptr;
+		{
+			RegexDfaCache& cache = caches->forward;
+			const char* it = begin;
+			if (!prefix.empty())
+			{
+				it = findPrefix(it, end);
+				if (it == end)
+				{
+					return nullptr;
+				}
+			}
+			uint32_t s = cache.getStartState(it == begin ? static_cast<uint8_t>(REGEXDFA_BOUNDARY) : regexdfa_info(static_cast<uint8_t>(it[-1])));
+			while (true)
+			{
+				if ((cache.getProperties(s) & RegexDfaCache::SKIPPABLE) && !prefix.empty())
+				{
+					const char* skip = findPrefix(it, end);
+					if (skip == end)
+					{
+						break;
+					}
+					if (skip != it)
+					{
+						it = skip;
+						s = cache.getStartState(regexdfa_info(static_cast<uint8_t>(it[-1])));
+					}
+				}
+				const uint32_t t = cache.step(s, regexdfa_symbol(it, end));
+				if (t & 1)
+				{
+					match_end = it;
+				}
+				s = (t >> 1);
+				if ((cache.getProperties(s) & (RegexDfaCache::DONE | RegexDfaCache::DEAD))
+					|| it == end
+					)
+				{
+					break;
+				}
+				++it;
+			}
+		}
+		if (match_end == nullptr)
+		{
+			return nullptr;
+		}
+
+		// Go backwards from there to find where it starts.
+		RegexDfaCache& cache = caches->backward;
+		uint32_t s = cache.getStartState(regexdfa_info(regexdfa_symbol(match_end, end)));
+		const char* match_start = nullptr;
+		for (const char* it = match_end; ; --it)
+		{
+			const uint32_t t = cache.step(s, it == begin ? REGEXDFA_SYM_BOUNDARY : regexdfa_symbol(it - 1, end));
+			if (t & 1)
+			{
+				match_start = it;
+			}
+			s = (t >> 1);
+			if (it == begin
+				|| (cache.getProperties(s) & RegexDfaCache::DEAD)
+				)
+			{
+				break;
+			}
+		}
+		return match_start;
+	}
+}
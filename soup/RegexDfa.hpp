@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "base.hpp"
+#include "fwd.hpp"
+
+#include "BigBitset.hpp"
+#include "UniquePtr.hpp"
+
+NAMESPACE_SOUP
+{
+	struct RegexDfaCaches;
+
+	// The constraint graph of a RegexGroup compiled into an NFA, which is searched by lazily building DFA states, so the time taken is linear in the length of the input.
+	// Patterns with backreferences, lookarounds or UTF-8-aware dots can't be compiled, but their literal prefix is still available to skip ahead.
+	struct RegexDfa
+	{
+		struct Edge
+		{
+			uint32_t target;
+			uint32_t set; // Index into 'sets' if kind is DFA_BYTES.
+			uint8_t kind; // RegexConstraint::DfaKind
+		};
+
+		static constexpr uint32_t ACCEPT = 0;
+
+		std::vector<std::vector<Edge>> forward{};
+		std::vector<std::vector<Edge>> backward{};
+		std::vector<BigBitset<0x100 / 8>> sets{};
+		uint32_t initial = ACCEPT;
+		std::string prefix{}; // Every match starts with these bytes.
+		bool supported = false;
+
+		// The DFA states built by searches are kept around for the next one, and thrown away whenever there are too many of them.
+		// A search that finds them in use by another thread builds its own instead.
+		mutable UniquePtr<RegexDfaCaches> caches{};
+		mutable std::atomic_bool caches_in_use = false;
+
+		RegexDfa() noexcept;
+		RegexDfa(const RegexGroup& g) SOUP_EXCAL;
+		RegexDfa(RegexDfa&& b) noexcept; // The caches are not taken over, since they refer to b.
+		~RegexDfa() noexcept;
+
+		[[nodiscard]] bool isSupported() const noexcept
+		{
+			return supported;
+		}
+
+		// Returns the first position in [it, end) where the prefix occurs, or end.
+		[[nodiscard]] const char* findPrefix(const char* it, const char* end) const noexcept;
+
+		// Returns the start of the leftmost match in [begin, end], or nullptr if there is none. Requires isSupported.
+		[[nodiscard]] const char* findLeftmostStart(const char* begin, const char* end) const SOUP_EXCAL;
+	};
+}
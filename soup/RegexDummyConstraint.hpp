@@ -22,5 +22,10 @@ NAMESPACE_SOUP
 		{
 			return true;
 		}
+
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			return DFA_EPSILON;
+		}
 	};
 }
@@ -65,6 +65,15 @@ NAMESPACE_SOUP
 			}
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			if constexpr (multi_line)
+			{
+				return DFA_ASSERT_END_LINE;
+			}
+			return end_only ? DFA_ASSERT_END : DFA_ASSERT_END_OR_FINAL_NEWLINE;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 0;
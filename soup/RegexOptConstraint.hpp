@@ -21,6 +21,11 @@ NAMESPACE_SOUP
 			return true;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			return DFA_EPSILON;
+		}
+
 		[[nodiscard]] std::string toString() const noexcept final
 		{
 			std::string str = constraint->toString();
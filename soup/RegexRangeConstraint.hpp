@@ -373,6 +373,16 @@ NAMESPACE_SOUP
 			return str;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			auto& set = bytes.emplace_back();
+			for (uint16_t i = 0; i != 0x100; ++i)
+			{
+				set.set(i, mask.get(i) != inverted);
+			}
+			return DFA_BYTES;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 1;
@@ -18,6 +18,11 @@ NAMESPACE_SOUP
 			return true;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			return DFA_EPSILON;
+		}
+
 		[[nodiscard]] RegexConstraint* getEntrypoint() noexcept final
 		{
 			return constraints.at(0)->getEntrypoint();
@@ -22,6 +22,11 @@ NAMESPACE_SOUP
 			return true;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			return DFA_EPSILON;
+		}
+
 		[[nodiscard]] virtual RegexConstraint* getEntrypoint() noexcept final
 		{
 			return constraint->getEntrypoint();
@@ -45,6 +45,11 @@ NAMESPACE_SOUP
 			}
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			return multi_line ? DFA_ASSERT_START_LINE : DFA_ASSERT_START;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 0;
@@ -33,6 +33,11 @@ NAMESPACE_SOUP
 			return inverted ? "\\B" : "\\b";
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			return inverted ? DFA_ASSERT_NOT_WORD_BOUNDARY : DFA_ASSERT_WORD_BOUNDARY;
+		}
+
 		[[nodiscard]] size_t getCursorAdvancement() const final
 		{
 			return 0;
@@ -12,9 +12,23 @@ NAMESPACE_SOUP
 	{
 		[[nodiscard]] bool matches(RegexMatcher& m) const noexcept final
 		{
+			if (m.it == m.end)
+			{
+				return false;
+			}
 			return string::isWordChar(*m.it++) ^ inverted;
 		}
 
+		[[nodiscard]] DfaKind getDfaKind(std::vector<BigBitset<0x100 / 8>>& bytes) const SOUP_EXCAL final
+		{
+			auto& set = bytes.emplace_back();
+			for (uint16_t i = 0; i != 0x100; ++i)
+			{
+				set.set(i, string::isWordChar(static_cast<char>(i)) ^ inverted);
+			}
+			return DFA_BYTES;
+		}
+
 		[[nodiscard]] std::string toString() const noexcept final
 		{
 			return inverted ? "\\W" : "\\w";
@@ -4,18 +4,12 @@
 
 NAMESPACE_SOUP
 {
+	// Attached to a Socket's custom_data by ConnectionPool.
 	struct ReuseTag
 	{
 		std::string host;
 		uint16_t port;
 		bool tls;
 		bool is_busy = true;
-
-		void init(const std::string& host, uint16_t port, bool tls)
-		{
-			this->host = host;
-			this->port = port;
-			this->tls = tls;
-		}
 	};
 }
@@ -4,10 +4,18 @@
 #include <netinet/tcp.h> // TCP_NODELAY
 #endif
 
+#if !SOUP_WINDOWS && !SOUP_WASM
+#include <fcntl.h>
+#include <unistd.h> // close, pipe, read, write
+#endif
+
+#if SOUP_LINUX
+#include <sys/eventfd.h>
+#endif
+
 #include "log.hpp"
 #include "os.hpp"
 #include "Promise.hpp"
-#include "ReuseTag.hpp"
 #include "Socket.hpp"
 #include "Task.hpp"
 #include "time.hpp"
@@ -21,10 +29,46 @@
 
 NAMESPACE_SOUP
 {
+	Scheduler::~Scheduler()
+	{
+#if SOUP_LINUX
+		if (epoll_fd != -1)
+		{
+			::close(epoll_fd);
+		}
+#endif
+#if !SOUP_WINDOWS && !SOUP_WASM
+		if (wakeup_fds[0] != -1)
+		{
+			::close(wakeup_fds[0]);
+			if (wakeup_fds[1] != wakeup_fds[0])
+			{
+				::close(wakeup_fds[1]);
+			}
+		}
+#endif
+	}
+
 	void Scheduler::addWorker(SharedPtr<Worker>&& w)
 	{
 		SOUP_ASSERT(w); // SharedPtr must hold a pointer
 		pending_workers.emplace_front(std::move(w));
+#if !SOUP_WINDOWS && !SOUP_WASM
+		if (wakeup_fds[1] != -1
+			&& this_thread_running_scheduler != this
+			)
+		{
+#if SOUP_LINUX
+			const uint64_t one = 1;
+#else
+			const char one = 1;
+#endif
+			if (::write(wakeup_fds[1], &one, sizeof(one)) != sizeof(one))
+			{
+				// Only fails if the counter or pipe is already full, in which case the scheduler is going to wake up anyway.
+			}
+		}
+#endif
 	}
 
 #if !SOUP_WASM
@@ -45,6 +89,108 @@ NAMESPACE_SOUP
 	}
 #endif
 
+	bool Scheduler::useEpoll() noexcept
+	{
+#if SOUP_LINUX
+		if (epoll_fd == -1)
+		{
+			epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+			if (epoll_fd == -1)
+			{
+				return false;
+			}
+			epoll_events.resize(1024);
+			epollRegisterWakeup();
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool Scheduler::enableAddWorkerWakeup() noexcept
+	{
+#if SOUP_WINDOWS || SOUP_WASM
+		return false;
+#else
+		if (wakeup_fds[0] == -1)
+		{
+#if SOUP_LINUX
+			const int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+			if (fd == -1)
+			{
+				return false;
+			}
+			wakeup_fds[0] = fd;
+			wakeup_fds[1] = fd;
+			if (epoll_fd != -1)
+			{
+				epollRegisterWakeup();
+			}
+#else
+			int fds[2];
+			if (::pipe(fds) != 0)
+			{
+				return false;
+			}
+			for (int fd : fds)
+			{
+				::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+				::fcntl(fd, F_SETFD, FD_CLOEXEC);
+			}
+			wakeup_fds[0] = fds[0];
+			wakeup_fds[1] = fds[1];
+#endif
+		}
+		return true;
+#endif
+	}
+
+	void Scheduler::armDeadline(Worker& w, unsigned int ms, on_deadline_t callback) SOUP_EXCAL
+	{
+		const auto at = time::millis() + ms;
+		if (hasDeadline(w))
+		{
+			auto& d = deadlines[w.deadline_index];
+			const auto prev_at = d.at;
+			d.at = at;
+			d.callback = callback;
+			if (at < prev_at)
+			{
+				deadlineSiftUp(w.deadline_index);
+			}
+			else
+			{
+				deadlineSiftDown(w.deadline_index);
+			}
+			return;
+		}
+		deadlines.emplace_back(Deadline{ at, &w, callback });
+		w.deadline_index = static_cast<uint32_t>(deadlines.size() - 1);
+		deadlineSiftUp(w.deadline_index);
+	}
+
+	void Scheduler::cancelDeadline(Worker& w) noexcept
+	{
+		if (!hasDeadline(w))
+		{
+			return;
+		}
+		const size_t i = w.deadline_index;
+		const size_t last = deadlines.size() - 1;
+		if (i != last)
+		{
+			deadlineSwap(i, last);
+		}
+		deadlines.pop_back();
+		w.deadline_index = -1;
+		if (i != last)
+		{
+			deadlineSiftUp(i);
+			deadlineSiftDown(i);
+		}
+	}
+
 	void Scheduler::run()
 	{
 		const auto prev_scheduler = this_thread_running_scheduler;
@@ -129,15 +275,40 @@ NAMESPACE_SOUP
 				{
 					auto worker = pending_workers.pop_back();
 					workers.emplace_back(std::move(*worker));
+#if SOUP_LINUX
+					if (num_parked_sockets != 0)
+					{
+						// Keep the parked sockets at the back.
+						auto first_parked = workers.end() - (num_parked_sockets + 1);
+						std::swap(*first_parked, workers.back());
+						static_cast<Socket*>(workers.back().get())->epoll_parked_index = static_cast<uint32_t>(workers.size() - 1);
+					}
+#endif
 				} while (--num_pending_workers);
 			}
 		}
 
+		if (!deadlines.empty())
+		{
+			processExpiredDeadlines();
+		}
+
+#if !SOUP_WASM
+		if (connection_pool.getNumIdle() != 0)
+		{
+			connection_pool.closeExpired();
+		}
+#endif
+
 		// Process workers
 #if !SOUP_WASM
 		pollfds.reserve(workers.size());
 #endif
+#if SOUP_LINUX
+		for (auto i = workers.begin(); i != workers.end() - num_parked_sockets; )
+#else
 		for (auto i = workers.begin(); i != workers.end(); )
+#endif
 		{
 			if ((*i)->type == WORKER_TYPE_SOCKET)
 			{
@@ -150,16 +321,102 @@ NAMESPACE_SOUP
 			}
 			SOUP_IF_UNLIKELY ((*i)->holdup_type == Worker::NONE)
 			{
+#if !SOUP_WASM
+				if ((*i)->type == WORKER_TYPE_SOCKET
+					&& static_cast<Socket*>(i->get())->hasPendingSend()
+					&& static_cast<Socket*>(i->get())->fd != -1
+					&& !static_cast<Socket*>(i->get())->remote_closed
+					)
+				{
+					// Keep the socket around until its send queue has been flushed.
+					// Only once it has been closed and nothing more is being produced for it, it's lingering, which may not take longer than linger_timeout_ms.
+					auto& s = *static_cast<Socket*>(i->get());
+					if (s.close_after_flush
+						&& s.send_refill == nullptr
+						&& !hasLingerDeadline(s) // Checking the deadline itself since it might have been replaced while the socket had work again.
+						)
+					{
+						s.lingering = true;
+						armDeadline(s, linger_timeout_ms, &onLingerTimeout);
+					}
+					tickFlushingSocket(pollfds, s);
+#if SOUP_LINUX
+					if (s.epoll_events != 0)
+					{
+						epollPark(i);
+						continue;
+					}
+#endif
+					++i;
+					continue;
+				}
+#endif
 				if (on_work_done)
 				{
 					on_work_done(*i->get(), *this);
 				}
+				cancelDeadline(**i);
+#if SOUP_LINUX
+				if ((*i)->type == WORKER_TYPE_SOCKET)
+				{
+					epollUnregister(*static_cast<Socket*>(i->get()));
+				}
+				if (num_parked_sockets != 0)
+				{
+					// Fill the gap from the end of the active range and the slot freed there with the last parked socket, so parked indices stay valid.
+					// The worker is only released once that's done since its destructor might cause a socket to be unparked.
+					SharedPtr<Worker> removed = std::move(*i);
+					auto last_active = workers.end() - (num_parked_sockets + 1);
+					if (i != last_active)
+					{
+						*i = std::move(*last_active);
+					}
+					*last_active = std::move(workers.back());
+					static_cast<Socket*>(last_active->get())->epoll_parked_index = static_cast<uint32_t>(last_active - workers.begin());
+					workers.pop_back();
+					continue;
+				}
+#endif
 				i = workers.erase(i);
 				continue;
 			}
+#if !SOUP_WASM
+			SOUP_IF_UNLIKELY ((*i)->type == WORKER_TYPE_SOCKET
+				&& static_cast<Socket*>(i->get())->lingering
+				)
+			{
+				// The socket has work again, so it has to linger anew once that's done.
+				stopLingering(*static_cast<Socket*>(i->get()));
+			}
+#endif
 			tickWorker(pollfds, workload_flags, **i);
+#if SOUP_LINUX
+			if ((*i)->holdup_type == Worker::SOCKET
+				&& static_cast<Socket*>(i->get())->epoll_events != 0
+				)
+			{
+				// Nothing to do for this socket until epoll reports it.
+				epollPark(i);
+				continue;
+			}
+#endif
 			++i;
 		}
+#if !SOUP_WINDOWS && !SOUP_WASM
+		if (wakeup_fds[0] != -1
+#if SOUP_LINUX
+			&& epoll_fd == -1
+#endif
+			)
+		{
+			// Comes after the entries of the workers, so processPollResults knows where to find it.
+			pollfds.emplace_back(pollfd{
+				wakeup_fds[0],
+				POLLIN,
+				0
+			});
+		}
+#endif
 	}
 
 	void Scheduler::tickWorker(std::vector<pollfd>& pollfds, uint8_t& workload_flags, Worker& w)
@@ -167,20 +424,53 @@ NAMESPACE_SOUP
 #if !SOUP_WASM
 		if (w.holdup_type == Worker::SOCKET)
 		{
+			auto& s = static_cast<Socket&>(w);
+#if SOUP_LINUX
+			if (epoll_fd != -1)
+			{
+				epollUpdateInterest(s, EPOLLIN | (s.hasPendingSend() ? uint32_t(EPOLLOUT) : 0));
+				return;
+			}
+#endif
 			pollfds.emplace_back(pollfd{
-				static_cast<Socket&>(w).fd,
-				POLLIN
+				s.fd,
+				static_cast<short>(POLLIN | (s.hasPendingSend() ? POLLOUT : 0)),
+				0
 			});
 		}
 		else
 #endif
 		{
 #if !SOUP_WASM
-			pollfds.emplace_back(pollfd{
-				(Socket::fd_t)-1,
-				0
-			});
+			if (w.type == WORKER_TYPE_SOCKET
+				&& static_cast<Socket&>(w).hasPendingSend()
+				)
+			{
+				tickFlushingSocket(pollfds, static_cast<Socket&>(w));
+			}
+			else
+#endif
+			{
+#if SOUP_LINUX
+				if (epoll_fd != -1)
+				{
+					if (w.type == WORKER_TYPE_SOCKET)
+					{
+						epollUpdateInterest(static_cast<Socket&>(w), 0);
+					}
+				}
+				else
 #endif
+				{
+#if !SOUP_WASM
+					pollfds.emplace_back(pollfd{
+						(Socket::fd_t)-1,
+						0,
+						0
+					});
+#endif
+				}
+			}
 
 			int dispo = Worker::NEUTRAL;
 
@@ -241,6 +531,10 @@ NAMESPACE_SOUP
 			timeout = -1;
 		}
 #endif
+		if (!deadlines.empty())
+		{
+			timeout = getMillisUntilNextDeadline(timeout);
+		}
 		if (poll(pollfds, timeout) > 0)
 		{
 			processPollResults(pollfds);
@@ -251,6 +545,13 @@ NAMESPACE_SOUP
 #if !SOUP_WASM
 	int Scheduler::poll(std::vector<pollfd>& pollfds, int timeout)
 	{
+#if SOUP_LINUX
+		if (epoll_fd != -1)
+		{
+			num_epoll_events = ::epoll_wait(epoll_fd, epoll_events.data(), static_cast<int>(epoll_events.size()), timeout);
+			return num_epoll_events;
+		}
+#endif
 #if SOUP_WINDOWS
 		return ::WSAPoll(pollfds.data(), static_cast<ULONG>(pollfds.size()), timeout);
 #else
@@ -260,24 +561,188 @@ NAMESPACE_SOUP
 
 	void Scheduler::processPollResults(const std::vector<pollfd>& pollfds)
 	{
-		for (auto i = pollfds.begin(); i != pollfds.end(); ++i)
+#if SOUP_LINUX
+		if (epoll_fd != -1)
+		{
+			return processEpollResults();
+		}
+#endif
+		auto end = pollfds.end();
+#if !SOUP_WINDOWS
+		if (wakeup_fds[0] != -1)
+		{
+			--end;
+			if (end->revents != 0)
+			{
+				drainWakeup();
+			}
+		}
+#endif
+		for (auto i = pollfds.begin(); i != end; ++i)
 		{
 			if (i->revents != 0
 				&& i->fd != -1
 				)
 			{
 				auto workers_i = workers.begin() + (i - pollfds.begin());
-				if (i->revents & ~POLLIN)
+				auto& s = *static_cast<Socket*>(workers_i->get());
+				if (i->revents & ~(POLLIN | POLLOUT))
 				{
-					static_cast<Socket*>(workers_i->get())->remote_closed = true;
-					processClosedSocket(*static_cast<Socket*>(workers_i->get()));
+					s.remote_closed = true;
+					processClosedSocket(s);
 				}
-				else
+				else if (!(i->revents & POLLOUT) || processWritableSocket(s))
+				{
+					if ((i->revents & POLLIN) && s.holdup_type == Worker::SOCKET)
+					{
+						fireHoldupCallback(s);
+					}
+				}
+			}
+		}
+	}
+#endif
+
+#if !SOUP_WINDOWS && !SOUP_WASM
+	void Scheduler::drainWakeup() noexcept
+	{
+#if SOUP_LINUX
+		uint64_t count;
+		if (::read(wakeup_fds[0], &count, sizeof(count)) != sizeof(count))
+		{
+			// Someone else drained it already.
+		}
+#else
+		char buf[64];
+		while (::read(wakeup_fds[0], buf, sizeof(buf)) > 0)
+		{
+		}
+#endif
+	}
+#endif
+
+#if SOUP_LINUX
+	void Scheduler::processEpollResults()
+	{
+		for (int i = 0; i < num_epoll_events; ++i)
+		{
+			if (epoll_events[i].data.ptr == nullptr)
+			{
+				drainWakeup();
+				continue;
+			}
+			auto& s = *static_cast<Socket*>(epoll_events[i].data.ptr);
+			epollUnpark(s); // Dispatching may change the socket's interest, so have it ticked again.
+			if (s.fd == -1
+				|| (s.holdup_type != Worker::SOCKET && !s.hasPendingSend())
+				)
+			{
+				// Interest will be updated on the next tick.
+				continue;
+			}
+			if (epoll_events[i].events & ~(EPOLLIN | EPOLLOUT))
+			{
+				s.remote_closed = true;
+				processClosedSocket(s);
+			}
+			else if (!(epoll_events[i].events & EPOLLOUT) || processWritableSocket(s))
+			{
+				if ((epoll_events[i].events & EPOLLIN) && s.holdup_type == Worker::SOCKET)
 				{
-					fireHoldupCallback(**workers_i);
+					fireHoldupCallback(s);
 				}
 			}
 		}
+		num_epoll_events = 0;
+	}
+
+	void Scheduler::epollUpdateInterest(Socket& s, uint32_t events) noexcept
+	{
+		if (s.epoll_events == events)
+		{
+			return;
+		}
+		if (events == 0)
+		{
+			// Deregistering rather than clearing the event mask because EPOLLHUP & EPOLLERR are always reported.
+			return epollUnregister(s);
+		}
+		if (s.fd == -1)
+		{
+			return;
+		}
+		epoll_event ev;
+		ev.events = events;
+		ev.data.ptr = &s;
+		if (s.epoll_events != 0)
+		{
+			if (::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s.fd, &ev) == 0)
+			{
+				s.epoll_events = events;
+			}
+		}
+		else if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s.fd, &ev) == 0
+			|| (errno == EEXIST && ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, s.fd, &ev) == 0)
+			)
+		{
+			s.epoll_events = events;
+			s.epoll_owner = epoll_fd;
+		}
+	}
+
+	void Scheduler::epollUnregister(Socket& s) noexcept
+	{
+		if (s.epoll_events != 0)
+		{
+			if (s.fd != -1)
+			{
+				::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s.fd, nullptr);
+			}
+			s.epoll_events = 0;
+			s.epoll_owner = -1;
+		}
+	}
+
+	void Scheduler::epollRegisterWakeup() noexcept
+	{
+		if (wakeup_fds[0] != -1)
+		{
+			epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.ptr = nullptr; // Sockets are never at nullptr, so processEpollResults can tell this apart.
+			::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fds[0], &ev);
+		}
+	}
+
+	void Scheduler::epollPark(std::vector<SharedPtr<Worker>>::iterator i) noexcept
+	{
+		// The worker that was at the end of the active range takes its place, so the caller should not advance i.
+		auto last_active = workers.end() - (num_parked_sockets + 1);
+		if (i != last_active)
+		{
+			std::swap(*i, *last_active);
+		}
+		static_cast<Socket*>(last_active->get())->epoll_parked_index = static_cast<uint32_t>(last_active - workers.begin());
+		++num_parked_sockets;
+	}
+
+	void Scheduler::epollUnpark(Socket& s) noexcept
+	{
+		const size_t i = s.epoll_parked_index;
+		if (i < workers.size()
+			&& workers[i].get() == &s
+			)
+		{
+			// Move it to the end of the active range.
+			const size_t first_parked = workers.size() - num_parked_sockets;
+			if (i != first_parked)
+			{
+				std::swap(workers[i], workers[first_parked]);
+				static_cast<Socket*>(workers[i].get())->epoll_parked_index = static_cast<uint32_t>(i);
+			}
+			s.epoll_parked_index = -1;
+			--num_parked_sockets;
+		}
 	}
 #endif
 
@@ -301,7 +766,162 @@ NAMESPACE_SOUP
 #endif
 	}
 
+	void Scheduler::processExpiredDeadlines()
+	{
+		const auto now = time::millis();
+		while (!deadlines.empty()
+			&& deadlines.front().at <= now
+			)
+		{
+			Worker& w = *deadlines.front().w;
+			const auto callback = deadlines.front().callback;
+			cancelDeadline(w);
+#if SOUP_LINUX
+			if (w.type == WORKER_TYPE_SOCKET)
+			{
+				epollUnpark(static_cast<Socket&>(w));
+			}
+#endif
+#if defined(_DEBUG) || !SOUP_EXCEPTIONS
+			callback(w, *this);
+#else
+			try
+			{
+				callback(w, *this);
+			}
+			catch (const std::exception& e)
+			{
+				if (on_exception)
+				{
+					on_exception(w, e, *this);
+				}
+				w.holdup_type = Worker::NONE;
+			}
+#endif
+		}
+	}
+
+	int Scheduler::getMillisUntilNextDeadline(int max) const noexcept
+	{
+		auto ms = time::millisUntil(deadlines.front().at);
+		if (ms < 0)
+		{
+			ms = 0;
+		}
+		if (max != -1
+			&& ms > max
+			)
+		{
+			ms = max;
+		}
+		return static_cast<int>(ms);
+	}
+
+	void Scheduler::deadlineSwap(size_t a, size_t b) noexcept
+	{
+		std::swap(deadlines[a], deadlines[b]);
+		deadlines[a].w->deadline_index = static_cast<uint32_t>(a);
+		deadlines[b].w->deadline_index = static_cast<uint32_t>(b);
+	}
+
+	void Scheduler::deadlineSiftUp(size_t i) noexcept
+	{
+		while (i != 0)
+		{
+			const size_t parent = (i - 1) / 2;
+			if (deadlines[parent].at <= deadlines[i].at)
+			{
+				break;
+			}
+			deadlineSwap(i, parent);
+			i = parent;
+		}
+	}
+
+	void Scheduler::deadlineSiftDown(size_t i) noexcept
+	{
+		while (true)
+		{
+			size_t smallest = i;
+			const size_t left = (i * 2) + 1;
+			const size_t right = left + 1;
+			if (left < deadlines.size()
+				&& deadlines[left].at < deadlines[smallest].at
+				)
+			{
+				smallest = left;
+			}
+			if (right < deadlines.size()
+				&& deadlines[right].at < deadlines[smallest].at
+				)
+			{
+				smallest = right;
+			}
+			if (smallest == i)
+			{
+				break;
+			}
+			deadlineSwap(i, smallest);
+			i = smallest;
+		}
+	}
+
 #if !SOUP_WASM
+	void Scheduler::onLingerTimeout(Worker& w, Scheduler&)
+	{
+		static_cast<Socket&>(w).discardSendQueue();
+		static_cast<Socket&>(w).transport_close();
+	}
+
+	void Scheduler::stopLingering(Socket& s) noexcept
+	{
+		s.lingering = false;
+		if (hasLingerDeadline(s))
+		{
+			cancelDeadline(s);
+		}
+	}
+
+	bool Scheduler::hasLingerDeadline(const Socket& s) const noexcept
+	{
+		return hasDeadline(s)
+			&& deadlines[s.deadline_index].callback == &onLingerTimeout
+			;
+	}
+
+	void Scheduler::tickFlushingSocket(std::vector<pollfd>& pollfds, Socket& s)
+	{
+#if SOUP_LINUX
+		if (epoll_fd != -1)
+		{
+			epollUpdateInterest(s, EPOLLOUT);
+			return;
+		}
+#endif
+		pollfds.emplace_back(pollfd{
+			s.fd,
+			POLLOUT,
+			0
+		});
+	}
+
+	bool Scheduler::processWritableSocket(Socket& s)
+	{
+		if (s.transport_flush())
+		{
+			if (s.close_after_flush
+				&& !s.hasPendingSend()
+				)
+			{
+				s.transport_close();
+			}
+			return true;
+		}
+		s.remote_closed = true;
+		processClosedSocket(s);
+		return false;
+	}
+
 	void Scheduler::processClosedSocket(Socket& s)
 	{
 		if (on_connection_lost)
@@ -367,51 +987,9 @@ NAMESPACE_SOUP
 	}
 
 #if !SOUP_WASM
-	SharedPtr<Socket> Scheduler::findReusableSocket(const std::string& host, uint16_t port, bool tls)
-	{
-		for (const auto& w : workers)
-		{
-			if (w->type == WORKER_TYPE_SOCKET
-				&& static_cast<Socket*>(w.get())->custom_data.isStructInMap(ReuseTag)
-				&& static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).host == host
-				&& static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).port == port
-				&& static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).tls == tls
-				)
-			{
-				return w;
-			}
-		}
-
-		// Iterating over the AtomicDeque is fine here because this function should only be called on the scheduler thread, which is the same one that would pop.
-		for (auto node = pending_workers.head.load(); node != nullptr; node = node->next.load())
-		{
-			const SharedPtr<Socket>& w = node->data;
-			if (w->type == WORKER_TYPE_SOCKET
-				&& static_cast<Socket*>(w.get())->custom_data.isStructInMap(ReuseTag)
-				&& static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).host == host
-				&& static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).port == port
-				&& static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).tls == tls
-				)
-			{
-				return w;
-			}
-		}
-
-		return {};
-	}
-
 	void Scheduler::closeReusableSockets() SOUP_EXCAL
 	{
-		for (const auto& w : workers)
-		{
-			if (w->type == WORKER_TYPE_SOCKET
-				&& static_cast<Socket*>(w.get())->custom_data.isStructInMap(ReuseTag)
-				&& !static_cast<Socket*>(w.get())->custom_data.getStructFromMapConst(ReuseTag).is_busy
-				)
-			{
-				static_cast<Socket*>(w.get())->close();
-			}
-		}
+		connection_pool.closeIdle();
 	}
 #endif
 
@@ -2,6 +2,7 @@
 
 #include "base.hpp"
 
+#include <ctime>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -12,7 +13,15 @@
 #include <poll.h>
 #endif
 
+#if SOUP_LINUX
+#include <sys/epoll.h>
+#endif
+
 #include "AtomicDeque.hpp"
+#if !SOUP_WASM
+#include "ConnectionPool.hpp"
+#endif
+#include "PrimitiveRaii.hpp"
 #include "SharedPtr.hpp"
 #include "Worker.hpp"
 
@@ -32,14 +41,26 @@ NAMESPACE_SOUP
 		uint8_t default_workload_flags = 0;
 #if !SOUP_WASM
 		bool dont_make_reusable_sockets = false;
+		ConnectionPool connection_pool{}; // Used by HttpRequestTask. Idle connections that expire are closed as the scheduler ticks.
+		unsigned int linger_timeout_ms = 10'000; // How long a socket that was closed while data was still queued may take to flush it before it is closed regardless.
 #endif
 	private:
 #if SOUP_WINDOWS
 		bool add_worker_can_wait_forever_for_all_i_care = false;
 #endif
+#if SOUP_LINUX
+		PrimitiveRaii<int, -1> epoll_fd{};
+		std::vector<epoll_event> epoll_events{};
+		int num_epoll_events = 0;
+		size_t num_parked_sockets = 0; // Sockets at the back of workers that are only waiting for epoll to report them, so ticks don't have to visit them.
+#endif
+#if !SOUP_WINDOWS && !SOUP_WASM
+		int wakeup_fds[2] = { -1, -1 }; // Read & write end. On Linux, both are the same eventfd.
+#endif
 
 	public:
 		using on_work_done_t = void(*)(Worker&, Scheduler&);
+		using on_deadline_t = void(*)(Worker&, Scheduler&);
 		using on_connection_lost_t = void(*)(Socket&, Scheduler&);
 #if SOUP_EXCEPTIONS
 		using on_exception_t = void(*)(Worker&, const std::exception&, Scheduler&);
@@ -51,7 +72,7 @@ NAMESPACE_SOUP
 		on_exception_t on_exception = &on_exception_log;
 #endif
 
-		virtual ~Scheduler() = default;
+		virtual ~Scheduler();
 
 		virtual void addWorker(SharedPtr<Worker>&& w);
 
@@ -102,6 +123,30 @@ NAMESPACE_SOUP
 			default_workload_flags |= HAS_HIGH_FREQUENCY_TASKS;
 		}
 
+		// Lets addWorker calls from other threads interrupt the wait for socket activity, so the worker is started right away instead of after up to 50ms.
+		// Returns false if this is not supported on the platform.
+		bool enableAddWorkerWakeup() noexcept;
+
+		// On Linux, sockets can be registered with an epoll instance once instead of rebuilding a pollfd vector every tick.
+		// Sockets whose interest is up-to-date are parked until epoll reports them, a deadline expires or they are changed from elsewhere, so ticks only visit sockets with something to do.
+		// Returns false if epoll is not available, in which case poll will continue to be used.
+		bool useEpoll() noexcept;
+		[[nodiscard]] bool isUsingEpoll() const noexcept
+		{
+#if SOUP_LINUX
+			return epoll_fd != -1;
+#else
+			return false;
+#endif
+		}
+
+		// Calls the callback once the given amount of milliseconds have passed, unless the deadline is cancelled or the worker is removed first.
+		// A worker can only have one deadline armed at a time, so this replaces any previously armed deadline.
+		// The worker must belong to this scheduler, and arming, cancelling & expiry are O(log n) in the number of armed deadlines.
+		void armDeadline(Worker& w, unsigned int ms, on_deadline_t callback) SOUP_EXCAL;
+		void cancelDeadline(Worker& w) noexcept;
+		[[nodiscard]] static bool hasDeadline(const Worker& w) noexcept { return w.deadline_index != (uint32_t)-1; }
+
 		void run();
 		void runFor(unsigned int ms);
 		[[nodiscard]] bool shouldKeepRunning() const noexcept;
@@ -113,6 +158,14 @@ NAMESPACE_SOUP
 			HAS_HIGH_FREQUENCY_TASKS = 1 << 1,
 		};
 
+		struct Deadline
+		{
+			std::time_t at;
+			Worker* w;
+			on_deadline_t callback;
+		};
+		std::vector<Deadline> deadlines{}; // Min-heap on Deadline::at; Worker::deadline_index points back into it.
+
 		void tick(std::vector<pollfd>& pollfds, uint8_t& workload_flags);
 		void tickWorker(std::vector<pollfd>& pollfds, uint8_t& workload_flags, Worker& w);
 		void yieldBusyspin(std::vector<pollfd>& pollfds, uint8_t workload_flags);
@@ -120,9 +173,29 @@ NAMESPACE_SOUP
 #if !SOUP_WASM
 		int poll(std::vector<pollfd>& pollfds, int timeout);
 		void processPollResults(const std::vector<pollfd>& pollfds);
+#endif
+#if !SOUP_WINDOWS && !SOUP_WASM
+		void drainWakeup() noexcept;
+#endif
+#if SOUP_LINUX
+		void epollUpdateInterest(Socket& s, uint32_t events) noexcept; // 0 = not interested
+		void epollUnregister(Socket& s) noexcept;
+		void epollRegisterWakeup() noexcept;
+		void epollPark(std::vector<SharedPtr<Worker>>::iterator i) noexcept;
+		void processEpollResults();
 #endif
 		void fireHoldupCallback(Worker& w);
+		void processExpiredDeadlines();
+		[[nodiscard]] int getMillisUntilNextDeadline(int max) const noexcept;
+		void deadlineSwap(size_t a, size_t b) noexcept;
+		void deadlineSiftUp(size_t i) noexcept;
+		void deadlineSiftDown(size_t i) noexcept;
 #if !SOUP_WASM
+		static void onLingerTimeout(Worker& w, Scheduler&);
+		void stopLingering(Socket& s) noexcept;
+		[[nodiscard]] bool hasLingerDeadline(const Socket& s) const noexcept;
+		void tickFlushingSocket(std::vector<pollfd>& pollfds, Socket& s);
+		bool processWritableSocket(Socket& s);
 		void processClosedSocket(Socket& s);
 #endif
 
@@ -134,9 +207,11 @@ NAMESPACE_SOUP
 		[[nodiscard]] size_t getNumSockets() const;
 
 		[[nodiscard]] SharedPtr<Worker> getShared(const Worker& w) const;
+#if SOUP_LINUX
+		void epollUnpark(Socket& s) noexcept; // Used by Socket::epollMarkDirty.
+#endif
 #if !SOUP_WASM
-		[[nodiscard]] SharedPtr<Socket> findReusableSocket(const std::string& host, uint16_t port, bool tls);
-		void closeReusableSockets() SOUP_EXCAL;
+		void closeReusableSockets() SOUP_EXCAL; // Closes idle connections in the connection pool.
 #endif
 
 		static void on_exception_log(Worker& w, const std::exception& e, Scheduler&);
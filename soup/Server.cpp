@@ -7,9 +7,40 @@
 #include "ServerServiceUdp.hpp"
 #include "SharedPtr.hpp"
 #include "Socket.hpp"
+#include "Task.hpp"
 
 NAMESPACE_SOUP
 {
+	template <typename CaptureT>
+	struct ServerAcceptHandoffTask : public Task
+	{
+		Socket sock;
+		CaptureT cap;
+
+		ServerAcceptHandoffTask(Socket&& sock, const CaptureT& cap, Server* target)
+			: sock(std::move(sock)), cap(cap)
+		{
+			this->cap.server = target;
+		}
+
+		void onTick() final
+		{
+			cap.processAccept(std::move(sock));
+			setWorkDone();
+		}
+	};
+
+	template <typename CaptureT>
+	[[nodiscard]] static bool handOffAccept(Socket& sock, const CaptureT& cap)
+	{
+		if (auto target = cap.server->getAcceptTarget(); target != cap.server)
+		{
+			target->template add<ServerAcceptHandoffTask<CaptureT>>(std::move(sock), cap, target);
+			return true;
+		}
+		return false;
+	}
+
 	struct CaptureServerPort
 	{
 		Server* server;
@@ -22,7 +53,9 @@ NAMESPACE_SOUP
 
 		void processAccept(Socket&& sock) const
 		{
-			if (sock.hasConnection())
+			if (sock.hasConnection()
+				&& !handOffAccept(sock, *this)
+				)
 			{
 				auto s = server->addSocket(std::move(sock));
 				if (service->on_connection_established)
@@ -46,7 +79,9 @@ NAMESPACE_SOUP
 
 		void processAccept(Socket&& sock) const
 		{
-			if (sock.hasConnection())
+			if (sock.hasConnection()
+				&& !handOffAccept(sock, *this)
+				)
 			{
 				auto s = server->addSocket(std::move(sock));
 				if (service->on_connection_established)
@@ -55,9 +90,9 @@ NAMESPACE_SOUP
 				}
 				s->enableCryptoServer(certstore, [](Socket& s, Capture&& _cap)
 				{
-					CaptureServerPortCrypto& cap = *_cap.get<CaptureServerPortCrypto*>();
+					CaptureServerPortCrypto& cap = _cap.get<CaptureServerPortCrypto>();
 					cap.service->on_tunnel_established(s, *cap.service, *cap.server);
-				}, this, on_client_hello);
+				}, CaptureServerPortCrypto(*this), on_client_hello);
 			}
 		}
 	};
@@ -71,7 +106,9 @@ NAMESPACE_SOUP
 
 		void processAccept(Socket&& sock) const
 		{
-			if (sock.hasConnection())
+			if (sock.hasConnection()
+				&& !handOffAccept(sock, *this)
+				)
 			{
 				auto s = server->addSocket(std::move(sock));
 				if (service->on_connection_established)
@@ -81,29 +118,54 @@ NAMESPACE_SOUP
 				s->transport_recv([](Socket& s, std::string&& data, Capture&& _cap)
 				{
 					s.transport_unrecv(data);
-					CaptureServerPortOptCrypto& cap = *_cap.get<CaptureServerPortOptCrypto*>();
+					CaptureServerPortOptCrypto& cap = _cap.get<CaptureServerPortOptCrypto>();
 					if (data.size() > 2 && data.at(0) == 22 && data.at(1) == 3) // TLS?
 					{
-						s.enableCryptoServer(cap.certstore, [](Socket& s, Capture&& _cap)
+						auto certstore = cap.certstore;
+						auto on_client_hello = cap.on_client_hello;
+						s.enableCryptoServer(std::move(certstore), [](Socket& s, Capture&& _cap)
 						{
-							CaptureServerPortOptCrypto& cap = *_cap.get<CaptureServerPortOptCrypto*>();
+							CaptureServerPortOptCrypto& cap = _cap.get<CaptureServerPortOptCrypto>();
 							cap.service->on_tunnel_established(s, *cap.service, *cap.server);
-						}, &cap, cap.on_client_hello);
+						}, std::move(cap), on_client_hello);
 					}
 					else
 					{
 						cap.service->on_tunnel_established(s, *cap.service, *cap.server);
 					}
-				}, this);
+				}, CaptureServerPortOptCrypto(*this));
 				
 			}
 		}
 	};
 
+	bool Server::setReusePort() noexcept
+	{
+#ifdef SO_REUSEPORT
+		reuse_port = true;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	Server* Server::getAcceptTarget() noexcept
+	{
+		if (accept_handoff_targets.empty())
+		{
+			return this;
+		}
+		if (accept_handoff_next >= accept_handoff_targets.size())
+		{
+			accept_handoff_next = 0;
+		}
+		return accept_handoff_targets[accept_handoff_next++];
+	}
+
 	bool Server::bind(uint16_t port, ServerService* service) SOUP_EXCAL
 	{
 		Socket sock6{};
-		if (!sock6.bind6(port))
+		if (!bindStream6(sock6, port, {}))
 		{
 			return false;
 		}
@@ -113,7 +175,7 @@ NAMESPACE_SOUP
 
 #if SOUP_WINDOWS
 		Socket sock4{};
-		if (!sock4.bind4(port))
+		if (!bindStream4(sock4, port, {}))
 		{
 			return false;
 		}
@@ -132,13 +194,13 @@ NAMESPACE_SOUP
 		if (!ip.isV4())
 #endif
 		{
-			SOUP_RETHROW_FALSE(sock.bind6(SOCK_STREAM, port, ip));
+			SOUP_RETHROW_FALSE(bindStream6(sock, port, ip));
 			setDataAvailableHandler6(sock);
 		}
 #if SOUP_WINDOWS
 		else
 		{
-			SOUP_RETHROW_FALSE(sock.bind4(SOCK_STREAM, port, ip));
+			SOUP_RETHROW_FALSE(bindStream4(sock, port, ip));
 			setDataAvailableHandler4(sock);
 		}
 #endif
@@ -150,7 +212,7 @@ NAMESPACE_SOUP
 	bool Server::bindCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello) SOUP_EXCAL
 	{
 		Socket sock6{};
-		if (!sock6.bind6(port))
+		if (!bindStream6(sock6, port, {}))
 		{
 			return false;
 		}
@@ -160,7 +222,7 @@ NAMESPACE_SOUP
 
 #if SOUP_WINDOWS
 		Socket sock4{};
-		if (!sock4.bind4(port))
+		if (!bindStream4(sock4, port, {}))
 		{
 			return false;
 		}
@@ -175,7 +237,7 @@ NAMESPACE_SOUP
 	bool Server::bindOptCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello) SOUP_EXCAL
 	{
 		Socket sock6{};
-		if (!sock6.bind6(port))
+		if (!bindStream6(sock6, port, {}))
 		{
 			return false;
 		}
@@ -185,7 +247,7 @@ NAMESPACE_SOUP
 
 #if SOUP_WINDOWS
 		Socket sock4{};
-		if (!sock4.bind4(port))
+		if (!bindStream4(sock4, port, {}))
 		{
 			return false;
 		}
@@ -267,6 +329,34 @@ NAMESPACE_SOUP
 		return true;
 	}
 
+	bool Server::bindStream6(Socket& sock, uint16_t port, const IpAddr& ip) noexcept
+	{
+#ifdef SO_REUSEPORT
+		if (reuse_port
+			&& (!sock.init(AF_INET6, SOCK_STREAM) || !sock.setOpt<int>(SOL_SOCKET, SO_REUSEPORT, 1))
+			)
+		{
+			return false;
+		}
+#endif
+		return sock.bind6(SOCK_STREAM, port, ip);
+	}
+
+#if SOUP_WINDOWS
+	bool Server::bindStream4(Socket& sock, uint16_t port, const IpAddr& ip) noexcept
+	{
+#ifdef SO_REUSEPORT
+		if (reuse_port
+			&& (!sock.init(AF_INET, SOCK_STREAM) || !sock.setOpt<int>(SOL_SOCKET, SO_REUSEPORT, 1))
+			)
+		{
+			return false;
+		}
+#endif
+		return sock.bind4(SOCK_STREAM, port, ip);
+	}
+#endif
+
 	void Server::setDataAvailableHandler6(Socket& s) noexcept
 	{
 		s.holdup_type = Worker::SOCKET;
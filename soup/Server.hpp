@@ -3,6 +3,8 @@
 #include "Scheduler.hpp"
 #if !SOUP_WASM
 
+#include <vector>
+
 #include "fwd.hpp"
 #include "type.hpp"
 
@@ -13,6 +15,16 @@ NAMESPACE_SOUP
 	public:
 		using udp_callback_t = void(*)(Socket&, SocketAddr&&, std::string&&) SOUP_EXCAL;
 
+		bool reuse_port = false;
+		std::vector<Server*> accept_handoff_targets{}; // If not empty, accepted connections are handed off round-robin to these servers via their pending_workers.
+		size_t accept_handoff_next = 0;
+
+		// Allows multiple servers to bind the same TCP port so the kernel can shard incoming connections between them.
+		// Returns false if the platform does not support SO_REUSEPORT.
+		bool setReusePort() noexcept;
+
+		[[nodiscard]] Server* getAcceptTarget() noexcept;
+
 		bool bind(uint16_t port, ServerService* service) SOUP_EXCAL;
 		bool bind(const IpAddr& ip, uint16_t port, ServerService* service) SOUP_EXCAL;
 		bool bindCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello = nullptr) SOUP_EXCAL;
@@ -22,6 +34,11 @@ NAMESPACE_SOUP
 		bool bindUdp(uint16_t port, ServerServiceUdp* service) SOUP_EXCAL;
 		bool bindUdp(const IpAddr& addr, uint16_t port, ServerServiceUdp* service) SOUP_EXCAL;
 	protected:
+		bool bindStream6(Socket& sock, uint16_t port, const IpAddr& ip) noexcept;
+#if SOUP_WINDOWS
+		bool bindStream4(Socket& sock, uint16_t port, const IpAddr& ip) noexcept;
+#endif
+
 		static void setDataAvailableHandler6(Socket& s) noexcept;
 		static void setDataAvailableHandlerCrypto6(Socket& s) noexcept;
 		static void setDataAvailableHandlerOptCrypto6(Socket& s) noexcept;
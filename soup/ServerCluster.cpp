@@ -0,0 +1,175 @@
+#include "ServerCluster.hpp"
+#if !SOUP_WASM
+
+#include <atomic>
+#include <thread>
+
+#include "CertStore.hpp"
+#include "ObfusString.hpp"
+#include "Task.hpp"
+#include "Thread.hpp"
+
+NAMESPACE_SOUP
+{
+	// Keeps a loop that has no listening sockets of its own alive while the accepting loop is still running.
+	struct ServerClusterKeepaliveTask : public Task
+	{
+		const std::atomic_bool& accepting;
+
+		ServerClusterKeepaliveTask(const std::atomic_bool& accepting) noexcept
+			: accepting(accepting)
+		{
+		}
+
+		void onTick() final
+		{
+			if (!accepting.load())
+			{
+				setWorkDone();
+			}
+		}
+
+		int getSchedulingDisposition() const noexcept final
+		{
+			return LOW_FREQUENCY;
+		}
+
+		std::string toString() const SOUP_EXCAL final
+		{
+			return ObfusString("ServerClusterKeepaliveTask").str();
+		}
+	};
+
+	ServerCluster::ServerCluster(unsigned int num_loops, bool reuse_port)
+	{
+		if (num_loops == 0)
+		{
+			num_loops = std::thread::hardware_concurrency();
+			if (num_loops == 0)
+			{
+				num_loops = 1;
+			}
+		}
+		loops.reserve(num_loops);
+		for (unsigned int i = 0; i != num_loops; ++i)
+		{
+			loops.emplace_back(soup::make_unique<Server>());
+		}
+		if (reuse_port)
+		{
+			for (auto& loop : loops)
+			{
+				if (!loop->setReusePort())
+				{
+					break;
+				}
+			}
+		}
+		if (shouldHandOffAccepts())
+		{
+			for (auto& loop : loops)
+			{
+				loops.at(0)->accept_handoff_targets.emplace_back(loop.get());
+				if (loop.get() != loops.at(0).get())
+				{
+					// The other loops are likely waiting for socket activity when a connection is handed off to them.
+					loop->enableAddWorkerWakeup();
+				}
+			}
+		}
+	}
+
+	void ServerCluster::setOnWorkDone(Scheduler::on_work_done_t on_work_done) noexcept
+	{
+		for (auto& loop : loops)
+		{
+			loop->on_work_done = on_work_done;
+		}
+	}
+
+	void ServerCluster::setOnConnectionLost(Scheduler::on_connection_lost_t on_connection_lost) noexcept
+	{
+		for (auto& loop : loops)
+		{
+			loop->on_connection_lost = on_connection_lost;
+		}
+	}
+
+	bool ServerCluster::useEpoll() noexcept
+	{
+		bool all = true;
+		for (auto& loop : loops)
+		{
+			all &= loop->useEpoll();
+		}
+		return all;
+	}
+
+	bool ServerCluster::bind(uint16_t port, ServerService* service) SOUP_EXCAL
+	{
+		if (shouldHandOffAccepts())
+		{
+			return loops.at(0)->bind(port, service);
+		}
+		for (auto& loop : loops)
+		{
+			SOUP_RETHROW_FALSE(loop->bind(port, service));
+		}
+		return true;
+	}
+
+	bool ServerCluster::bindCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello) SOUP_EXCAL
+	{
+		if (shouldHandOffAccepts())
+		{
+			return loops.at(0)->bindCrypto(port, service, std::move(certstore), on_client_hello);
+		}
+		for (auto& loop : loops)
+		{
+			SOUP_RETHROW_FALSE(loop->bindCrypto(port, service, certstore, on_client_hello));
+		}
+		return true;
+	}
+
+	bool ServerCluster::bindOptCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello) SOUP_EXCAL
+	{
+		if (shouldHandOffAccepts())
+		{
+			return loops.at(0)->bindOptCrypto(port, service, std::move(certstore), on_client_hello);
+		}
+		for (auto& loop : loops)
+		{
+			SOUP_RETHROW_FALSE(loop->bindOptCrypto(port, service, certstore, on_client_hello));
+		}
+		return true;
+	}
+
+	void ServerCluster::run()
+	{
+		std::atomic_bool accepting = true;
+		std::vector<UniquePtr<Thread>> threads{};
+		for (size_t i = 1; i < loops.size(); ++i)
+		{
+			if (shouldHandOffAccepts())
+			{
+				loops[i]->add<ServerClusterKeepaliveTask>(accepting);
+			}
+			threads.emplace_back(soup::make_unique<Thread>([](Capture&& cap)
+			{
+				cap.get<Server*>()->run();
+			}, loops[i].get()));
+		}
+		loops.at(0)->run();
+		accepting = false;
+		Thread::awaitCompletion(threads);
+	}
+
+	bool ServerCluster::shouldHandOffAccepts() const noexcept
+	{
+		return loops.size() > 1
+			&& !loops.at(0)->reuse_port
+			;
+	}
+}
+
+#endif
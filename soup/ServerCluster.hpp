@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Server.hpp"
+#if !SOUP_WASM
+
+#include <vector>
+
+#include "UniquePtr.hpp"
+
+NAMESPACE_SOUP
+{
+	// Runs a Server on each of multiple threads, each with its own scheduler loop.
+	// Where SO_REUSEPORT is available, every loop gets its own listening socket and the kernel shards incoming connections between them.
+	// Otherwise, the first loop accepts all connections and hands them off round-robin to the loops' pending_workers, waking the receiving loop up where possible.
+	class ServerCluster
+	{
+	public:
+		std::vector<UniquePtr<Server>> loops{};
+
+		// num_loops = 0 means one loop per hardware thread. Without reuse_port, the accept handoff is used even where SO_REUSEPORT is available.
+		ServerCluster(unsigned int num_loops = 0, bool reuse_port = true);
+
+		[[nodiscard]] size_t getNumLoops() const noexcept { return loops.size(); }
+		[[nodiscard]] Server& getLoop(size_t i) noexcept { return *loops.at(i); }
+
+		// The callbacks will be invoked on the thread of the loop they concern.
+		void setOnWorkDone(Scheduler::on_work_done_t on_work_done) noexcept;
+		void setOnConnectionLost(Scheduler::on_connection_lost_t on_connection_lost) noexcept;
+
+		// Returns false if epoll is not available on any of the loops, in which case those will continue to use poll.
+		bool useEpoll() noexcept;
+
+		bool bind(uint16_t port, ServerService* service) SOUP_EXCAL;
+		bool bindCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello = nullptr) SOUP_EXCAL;
+		bool bindOptCrypto(uint16_t port, ServerService* service, SharedPtr<CertStore> certstore, tls_server_on_client_hello_t on_client_hello = nullptr) SOUP_EXCAL;
+
+		// Posts a worker to a specific loop. This is safe to call from any thread.
+		template <typename T, typename...Args>
+		SharedPtr<T> add(size_t loop, Args&&...args) SOUP_EXCAL
+		{
+			return loops.at(loop)->template add<T>(std::forward<Args>(args)...);
+		}
+
+		// Runs the first loop on the calling thread and all others on their own threads. Returns once all loops are done.
+		void run();
+
+	protected:
+		[[nodiscard]] bool shouldHandOffAccepts() const noexcept;
+	};
+}
+
+#endif
@@ -2,10 +2,31 @@
 
 #if !SOUP_WASM
 
+#include <cstdlib> // strtod
+
+#if SOUP_WINDOWS
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if SOUP_LINUX
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#include "deflate.hpp"
 #include "HttpRequest.hpp"
+#include "HttpRequestParser.hpp"
 #include "MimeType.hpp"
+#include "Scheduler.hpp"
 #include "Socket.hpp"
+#include "string.hpp"
 #include "StringWriter.hpp"
+#include "time.hpp"
+#include "UniquePtr.hpp"
 #include "WebSocket.hpp"
 #include "WebSocketFrameType.hpp"
 #include "WebSocketMessage.hpp"
@@ -15,6 +36,111 @@ NAMESPACE_SOUP
 	struct WebServerClientData
 	{
 		bool keep_alive = false;
+		bool sending_file = false;
+		ServerWebService* recv_after_file = nullptr;
+	};
+
+	struct WebServerFileTransfer
+	{
+		static constexpr uint64_t window_granularity = 0x10000; // 64 KiB, the allocation granularity on Windows and a multiple of the page size elsewhere
+		static constexpr uint64_t max_window_len = 0x1000000; // 16 MiB
+
+		uint64_t offset;
+		uint64_t end;
+#if SOUP_WINDOWS
+		HANDLE file_mapping = NULL;
+#else
+		int fd = -1; // for sendfile or mapping windows of the file
+		bool use_sendfile = false;
+#endif
+		// Only a window of the file is mapped at a time, so large files don't take up an equally large amount of address space.
+		void* window = nullptr;
+		size_t window_len = 0;
+		uint64_t window_offset = 0;
+
+		~WebServerFileTransfer()
+		{
+			unmapWindow();
+#if SOUP_WINDOWS
+			if (file_mapping != NULL)
+			{
+				CloseHandle(file_mapping);
+			}
+#else
+			if (fd != -1)
+			{
+				::close(fd);
+			}
+#endif
+		}
+
+		// Opens the file and checks that it still has at least 'end' bytes.
+		[[nodiscard]] bool open(const std::filesystem::path& path) noexcept
+		{
+#if SOUP_WINDOWS
+			HANDLE f = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+			if (f == INVALID_HANDLE_VALUE)
+			{
+				return false;
+			}
+			LARGE_INTEGER liSize;
+			if (GetFileSizeEx(f, &liSize)
+				&& static_cast<uint64_t>(liSize.QuadPart) >= end
+				)
+			{
+				file_mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, NULL);
+			}
+			CloseHandle(f);
+			return file_mapping != NULL;
+#else
+			fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (fd == -1)
+			{
+				return false;
+			}
+			struct stat st;
+			return ::fstat(fd, &st) == 0
+				&& static_cast<uint64_t>(st.st_size) >= end // File was truncated since we stat'd it
+				;
+#endif
+		}
+
+		// Maps the window containing 'offset', unless it already is.
+		[[nodiscard]] bool mapWindow() noexcept
+		{
+			if (window != nullptr
+				&& offset < window_offset + window_len
+				)
+			{
+				return true;
+			}
+			unmapWindow();
+			window_offset = offset & ~(window_granularity - 1);
+			window_len = static_cast<size_t>(std::min(end - window_offset, max_window_len));
+#if SOUP_WINDOWS
+			window = MapViewOfFile(file_mapping, FILE_MAP_READ, static_cast<DWORD>(window_offset >> 32), static_cast<DWORD>(window_offset), window_len);
+#else
+			window = ::mmap(nullptr, window_len, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(window_offset));
+			if (window == MAP_FAILED)
+			{
+				window = nullptr;
+			}
+#endif
+			return window != nullptr;
+		}
+
+		void unmapWindow() noexcept
+		{
+			if (window != nullptr)
+			{
+#if SOUP_WINDOWS
+				UnmapViewOfFile(window);
+#else
+				::munmap(window, window_len);
+#endif
+				window = nullptr;
+			}
+		}
 	};
 
 	ServerWebService::ServerWebService(handle_request_t handle_request)
@@ -52,7 +178,9 @@ NAMESPACE_SOUP
 	{
 		resp.setContentLength();
 		resp.setContentType();
-		sendResponse(s, status, resp.toString());
+		auto body = std::move(resp.body);
+		resp.body.clear();
+		sendResponse(s, status, resp.toString(), body);
 	}
 
 	void ServerWebService::sendHtml(Socket& s, const std::string& body)
@@ -68,7 +196,7 @@ NAMESPACE_SOUP
 	void ServerWebService::sendData(Socket& s, const char* mime_type, const std::string& body, bool is_private)
 	{
 		std::string data;
-		data.reserve(body.size() + 120);
+		data.reserve(120);
 		if (is_private)
 		{
 			data.append("Cache-Control: private");
@@ -80,8 +208,38 @@ NAMESPACE_SOUP
 		data.append("\r\nContent-Type: ").append(mime_type);
 		data.append("\r\nContent-Length: ").append(std::to_string(body.size()));
 		data.append("\r\n\r\n");
-		data.append(body);
-		sendResponse(s, "200", data);
+		sendResponse(s, "200", data, body);
+	}
+
+	void ServerWebService::sendData(Socket& s, const HttpRequest& req, const char* mime_type, const std::string& body, bool is_private)
+	{
+		// Tiny bodies aren't worth it; the gzip header & trailer alone are 18 bytes.
+		if (body.size() >= 256
+			&& acceptsGzip(req)
+			)
+		{
+			std::string compressed = deflate::compress(body, 6, deflate::GZIP);
+			if (compressed.size() < body.size())
+			{
+				std::string data;
+				data.reserve(160);
+				if (is_private)
+				{
+					data.append("Cache-Control: private");
+				}
+				else
+				{
+					data.append("Access-Control-Allow-Origin: *");
+				}
+				data.append("\r\nContent-Type: ").append(mime_type);
+				data.append("\r\nContent-Encoding: gzip\r\nVary: Accept-Encoding");
+				data.append("\r\nContent-Length: ").append(std::to_string(compressed.size()));
+				data.append("\r\n\r\n");
+				sendResponse(s, "200", data, compressed);
+				return;
+			}
+		}
+		sendData(s, mime_type, body, is_private);
 	}
 
 	void ServerWebService::sendRedirect(Socket& s, const std::string& location)
@@ -115,9 +273,293 @@ NAMESPACE_SOUP
 		cont.append(s.custom_data.getStructFromMap(WebServerClientData).keep_alive ? "keep-alive" : "close");
 		cont.append("\r\n");
 		cont.append(headers_and_body);
-		s.send(std::move(cont));
+		s.send(cont);
+	}
+
+	void ServerWebService::sendResponse(Socket& s, const char* status, const std::string& headers, const std::string& body)
+	{
+		std::string cont = "HTTP/1.0 ";
+		cont.append(status);
+		cont.append("\r\nServer: Soup\r\nConnection: ");
+		cont.append(s.custom_data.getStructFromMap(WebServerClientData).keep_alive ? "keep-alive" : "close");
+		cont.append("\r\n");
+		cont.append(headers);
+		Socket::SendSlice slices[] = {
+			std::move(cont),
+			body,
+		};
+		s.send(slices);
 	}
 	
+	bool ServerWebService::sendFile(Socket& s, const HttpRequest& req, const std::filesystem::path& path, const char* mime_type, bool is_private)
+	{
+		uint64_t size;
+		std::time_t mtime;
+		{
+#if SOUP_WINDOWS
+			struct _stat64 st;
+			if (_wstat64(path.c_str(), &st) != 0
+				|| !(st.st_mode & _S_IFREG)
+				)
+			{
+				return false;
+			}
+#else
+			struct stat st;
+			if (::stat(path.c_str(), &st) != 0
+				|| !S_ISREG(st.st_mode)
+				)
+			{
+				return false;
+			}
+#endif
+			size = static_cast<uint64_t>(st.st_size);
+			mtime = st.st_mtime;
+		}
+
+		std::string etag = "\"";
+		etag.append(string::hexLower(size));
+		etag.push_back('-');
+		etag.append(string::hexLower(static_cast<uint64_t>(mtime)));
+		etag.push_back('"');
+		const std::string last_modified = time::toRfc2822(mtime);
+
+		std::string headers = is_private ? "Cache-Control: private" : "Access-Control-Allow-Origin: *";
+		headers.append("\r\nETag: ").append(etag);
+		headers.append("\r\nLast-Modified: ").append(last_modified);
+		headers.append("\r\nAccept-Ranges: bytes\r\n");
+
+		// Conditional requests
+		if (auto if_none_match = req.findHeader("If-None-Match"))
+		{
+			if (*if_none_match == "*"
+				|| if_none_match->find(etag) != std::string::npos
+				)
+			{
+				headers.append("\r\n");
+				sendResponse(s, "304", headers);
+				return true;
+			}
+		}
+		else if (auto if_modified_since = req.findHeader("If-Modified-Since"))
+		{
+			auto since = Datetime::fromRfc2822(if_modified_since->c_str());
+			if (since.has_value()
+				&& mtime <= since->toTimestamp()
+				)
+			{
+				headers.append("\r\n");
+				sendResponse(s, "304", headers);
+				return true;
+			}
+		}
+
+		const char* status = "200";
+		uint64_t first = 0;
+		uint64_t end = size;
+		if (auto range = req.findHeader("Range"))
+		{
+			auto if_range = req.findHeader("If-Range");
+			if (!if_range
+				|| *if_range == etag
+				|| *if_range == last_modified
+				)
+			{
+				uint64_t last;
+				switch (parseRange(*range, size, first, last))
+				{
+				case RANGE_NONE:
+					first = 0;
+					break;
+
+				case RANGE_OK:
+					status = "206";
+					end = last + 1;
+					headers.append("Content-Range: bytes ");
+					headers.append(std::to_string(first)).push_back('-');
+					headers.append(std::to_string(last)).push_back('/');
+					headers.append(std::to_string(size)).append("\r\n");
+					break;
+
+				case RANGE_UNSATISFIABLE:
+					headers.append("Content-Range: bytes */");
+					headers.append(std::to_string(size));
+					headers.append("\r\nContent-Length: 0\r\n\r\n");
+					sendResponse(s, "416", headers);
+					return true;
+				}
+			}
+		}
+
+		headers.append("Content-Type: ").append(mime_type);
+		headers.append("\r\nContent-Length: ").append(std::to_string(end - first));
+		headers.append("\r\n\r\n");
+
+		if (req.method == "HEAD"
+			|| first == end
+			)
+		{
+			sendResponse(s, status, headers);
+			return true;
+		}
+
+		auto transfer = soup::make_unique<WebServerFileTransfer>();
+		transfer->offset = first;
+		transfer->end = end;
+		if (!transfer->open(path))
+		{
+			return false;
+		}
+#if SOUP_LINUX
+		transfer->use_sendfile = !s.isEncrypted();
+#endif
+
+		sendResponse(s, status, headers);
+
+		// The body is produced as the socket becomes writable, so only a bounded amount of it is ever buffered.
+		// Receiving the next request on a keep-alive connection is deferred until the file has been sent.
+		s.custom_data.getStructFromMap(WebServerClientData).sending_file = true;
+		s.setSendRefill([](Socket& s, Capture& cap) SOUP_EXCAL
+		{
+			constexpr uint64_t max_bytes_per_refill = 0x40000; // 256 KiB
+
+			auto& transfer = *cap.get<UniquePtr<WebServerFileTransfer>>();
+			const auto bytes = std::min(transfer.end - transfer.offset, max_bytes_per_refill);
+#if SOUP_LINUX
+			if (transfer.use_sendfile)
+			{
+				off_t off = static_cast<off_t>(transfer.offset);
+				const auto ret = ::sendfile(s.fd, transfer.fd, &off, static_cast<size_t>(bytes));
+				if (ret == -1)
+				{
+					if (errno == EAGAIN || errno == EWOULDBLOCK)
+					{
+						return true;
+					}
+					s.transport_close();
+					return false;
+				}
+				if (ret == 0) // File was truncated
+				{
+					s.transport_close();
+					return false;
+				}
+				transfer.offset += static_cast<uint64_t>(ret);
+			}
+			else
+#endif
+			{
+				if (!transfer.mapWindow())
+				{
+					s.transport_close();
+					return false;
+				}
+				const auto window_bytes = std::min(bytes, transfer.window_offset + transfer.window_len - transfer.offset);
+				if (!s.send(reinterpret_cast<const char*>(transfer.window) + (transfer.offset - transfer.window_offset), static_cast<size_t>(window_bytes)))
+				{
+					s.transport_close();
+					return false;
+				}
+				transfer.offset += window_bytes;
+			}
+			if (transfer.offset != transfer.end)
+			{
+				return true;
+			}
+
+			auto& client_data = s.custom_data.getStructFromMap(WebServerClientData);
+			client_data.sending_file = false;
+			if (client_data.recv_after_file)
+			{
+				auto srv = client_data.recv_after_file;
+				client_data.recv_after_file = nullptr;
+				srv->httpProcess(s);
+			}
+			return false;
+		}, std::move(transfer));
+		return true;
+	}
+
+	bool ServerWebService::acceptsGzip(const HttpRequest& req)
+	{
+		if (auto accept_encoding = req.findHeader("Accept-Encoding"))
+		{
+			for (auto coding : string::explode(*accept_encoding, ','))
+			{
+				string::trim(coding);
+				string::lower(coding);
+				if (coding.compare(0, 4, "gzip") == 0
+					&& (coding.length() == 4 || coding[4] == ';' || coding[4] == ' ')
+					)
+				{
+					// "gzip;q=0" means the client explicitly doesn't want it.
+					const auto q = coding.find("q=");
+					return q == std::string::npos
+						|| std::strtod(coding.c_str() + q + 2, nullptr) > 0.0
+						;
+				}
+			}
+		}
+		return false;
+	}
+
+	ServerWebService::RangeResult ServerWebService::parseRange(const std::string& value, uint64_t size, uint64_t& first, uint64_t& last) noexcept
+	{
+		if (value.compare(0, 6, "bytes=") != 0
+			|| value.find(',') != std::string::npos // We don't do multipart/byteranges.
+			)
+		{
+			return RANGE_NONE;
+		}
+		const char* it = value.c_str() + 6;
+		if (*it == '-')
+		{
+			// Suffix range
+			auto suffix_len = string::toIntEx<uint64_t>(it + 1, string::TI_FULL);
+			if (!suffix_len.has_value())
+			{
+				return RANGE_NONE;
+			}
+			if (*suffix_len == 0
+				|| size == 0
+				)
+			{
+				return RANGE_UNSATISFIABLE;
+			}
+			first = size - std::min(*suffix_len, size);
+			last = size - 1;
+			return RANGE_OK;
+		}
+		auto first_opt = string::toIntEx<uint64_t>(it, 0, &it);
+		if (!first_opt.has_value()
+			|| *it != '-'
+			)
+		{
+			return RANGE_NONE;
+		}
+		first = *first_opt;
+		last = size - 1;
+		if (*++it != '\0')
+		{
+			auto last_opt = string::toIntEx<uint64_t>(it, string::TI_FULL);
+			if (!last_opt.has_value()
+				|| *last_opt < first
+				)
+			{
+				return RANGE_NONE;
+			}
+			if (*last_opt < last)
+			{
+				last = *last_opt;
+			}
+		}
+		if (first >= size)
+		{
+			return RANGE_UNSATISFIABLE;
+		}
+		return RANGE_OK;
+	}
+
 	void ServerWebService::wsSendText(Socket& s, const std::string& data)
 	{
 		wsSend(s, WebSocketFrameType::TEXT, data);
@@ -176,84 +618,138 @@ NAMESPACE_SOUP
 
 	void ServerWebService::httpRecv(Socket& s)
 	{
-		s.recv([](Socket& s, std::string&& data, Capture&& cap)
+		if (idle_timeout_ms != 0)
 		{
-			HttpRequest req{};
-			auto method_end = data.find(' ');
-			if (method_end == std::string::npos)
+			if (auto sched = Scheduler::get())
 			{
-			_bad_request:
-				s.send("HTTP/1.0 400\r\n\r\n");
-				s.close();
-				return;
+				sched->armDeadline(s, idle_timeout_ms, [](Worker& w, Scheduler&)
+				{
+					static_cast<Socket&>(w).close();
+				});
 			}
-			req.method = data.substr(0, method_end);
-			method_end += 1;
-			auto path_end = data.find(' ', method_end);
-			if (path_end == std::string::npos)
+		}
+		s.recv([](Socket& s, std::string&& data, Capture&& cap)
+		{
+			if (auto sched = Scheduler::get())
 			{
-				goto _bad_request;
+				sched->cancelDeadline(s);
 			}
-			req.path = data.substr(method_end, path_end - method_end);
-			path_end += 1;
-			auto message_start = data.find("\r\n", path_end);
-			if (message_start == std::string::npos)
+
+			s.custom_data.getStructFromMap(HttpRequestParser).feed(std::move(data));
+			cap.get<ServerWebService*>()->httpProcess(s);
+		}, this);
+	}
+
+	void ServerWebService::httpProcess(Socket& s)
+	{
+		auto& parser = s.custom_data.getStructFromMap(HttpRequestParser);
+		parser.limits = request_limits;
+		while (true)
+		{
+			switch (parser.parse())
 			{
-				goto _bad_request;
-			}
-			message_start += 2;
-			req.loadMessage(data.substr(message_start));
+			case HttpRequestParser::NEED_MORE_DATA:
+				httpRecv(s);
+				return;
 
-			ServerWebService& srv = *cap.get<ServerWebService*>();
+			case HttpRequestParser::COMPLETE:
+				break;
 
-			if (auto upgrade_value = req.findHeader("Upgrade"))
+			case HttpRequestParser::MALFORMED:
+				s.send("HTTP/1.0 400\r\n\r\n");
+				s.close();
+				return;
+
+			case HttpRequestParser::HEADERS_TOO_LARGE:
+				s.send("HTTP/1.0 431\r\n\r\n");
+				s.close();
+				return;
+
+			case HttpRequestParser::BODY_TOO_LARGE:
+				s.send("HTTP/1.0 413\r\n\r\n");
+				s.close();
+				return;
+
+			case HttpRequestParser::UNSUPPORTED_TRANSFER_ENCODING:
+				s.send("HTTP/1.0 501\r\n\r\n");
+				s.close();
+				return;
+			}
+
+			if (std::string_view upgrade_value; parser.findHeader("Upgrade", upgrade_value))
 			{
-				if (*upgrade_value == "websocket")
+				if (upgrade_value == "websocket")
 				{
-					if (auto key_value = req.findHeader("Sec-WebSocket-Key"))
+					if (std::string_view key_value; parser.findHeader("Sec-WebSocket-Key", key_value))
 					{
-						if (srv.should_accept_websocket_connection
-							&& srv.should_accept_websocket_connection(s, req, srv)
+						const auto req = parser.toHttpRequest();
+						if (should_accept_websocket_connection
+							&& should_accept_websocket_connection(s, req, *this)
 							)
 						{
 							// Firefox throws a SkillIssueException if we say HTTP/1.0
 							std::string cont = "HTTP/1.1 101\r\nConnection: Upgrade\r\nUpgrade: websocket\r\nServer: Soup\r\nSec-WebSocket-Accept: ";
-							cont.append(WebSocket::hashKey(*key_value));
+							cont.append(WebSocket::hashKey(std::string(key_value)));
 							cont.append("\r\n\r\n");
 							s.send(cont);
 
+							// Anything the client sent after the upgrade request belongs to the WebSocket stream.
+							parser.consume();
+							if (!parser.buf.empty())
+							{
+								s.transport_unrecv(parser.buf);
+							}
+							s.custom_data.removeStructFromMap(HttpRequestParser);
 							s.custom_data.removeStructFromMap(WebServerClientData);
 
-							if (srv.on_websocket_connection_established)
+							if (on_websocket_connection_established)
 							{
-								srv.on_websocket_connection_established(s, req, srv);
+								on_websocket_connection_established(s, req, *this);
 							}
 
-							srv.wsRecv(s);
+							wsRecv(s);
 						}
 					}
 				}
 				return;
 			}
 
-			if (srv.handle_request)
+			if (!handle_request
+				&& !handle_parsed_request
+				)
 			{
-				if (auto connection_entry = req.header_fields.find("Connection"); connection_entry != req.header_fields.end())
-				{
-					if (connection_entry->second == "keep-alive")
-					{
-						s.custom_data.getStructFromMap(WebServerClientData).keep_alive = true;
-					}
-				}
+				return;
+			}
 
-				srv.handle_request(s, std::move(req), srv);
+			s.custom_data.getStructFromMap(WebServerClientData).keep_alive = parser.isKeepAlive();
 
-				if (s.custom_data.getStructFromMap(WebServerClientData).keep_alive)
-				{
-					srv.httpRecv(s);
-				}
+			if (handle_parsed_request)
+			{
+				handle_parsed_request(s, parser, *this);
+				parser.consume();
 			}
-		}, this);
+			else
+			{
+				auto req = parser.toHttpRequest();
+				parser.consume();
+				handle_request(s, std::move(req), *this);
+			}
+
+			auto& client_data = s.custom_data.getStructFromMap(WebServerClientData);
+			if (!client_data.keep_alive
+				|| !s.hasConnection()
+				|| s.close_after_flush // The handler closed the connection, but data is still being flushed.
+				)
+			{
+				return;
+			}
+			if (client_data.sending_file)
+			{
+				// Any pipelined requests will be processed once the file has been sent.
+				client_data.recv_after_file = this;
+				return;
+			}
+		}
 	}
 
 	void ServerWebService::wsRecv(Socket& s)
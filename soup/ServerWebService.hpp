@@ -5,6 +5,9 @@
 #include "fwd.hpp"
 #include "type.hpp"
 
+#include <filesystem>
+
+#include "HttpRequestParser.hpp"
 #include "ServerService.hpp"
 
 NAMESPACE_SOUP
@@ -13,15 +16,22 @@ NAMESPACE_SOUP
 	{
 	public:
 		using handle_request_t = void(*)(Socket&, HttpRequest&&, ServerWebService&);
+		using handle_parsed_request_t = void(*)(Socket&, const HttpRequestParser&, ServerWebService&);
 		using should_accept_websocket_connection_t = bool(*)(Socket&, const HttpRequest&, ServerWebService&);
 		using on_websocket_connection_established_t = void(*)(Socket&, const HttpRequest&, ServerWebService&);
 		using on_websocket_message_t = void(*)(WebSocketMessage&, Socket&, ServerWebService&);
 
 		handle_request_t handle_request = nullptr;
+		handle_parsed_request_t handle_parsed_request = nullptr; // If set, used instead of handle_request, so no HttpRequest needs to be materialised.
 		should_accept_websocket_connection_t should_accept_websocket_connection = nullptr;
 		on_websocket_connection_established_t on_websocket_connection_established = nullptr;
 		on_websocket_message_t on_websocket_message = nullptr;
 
+		// If not 0, connections that are idle while waiting for a (keep-alive) request will be closed after this many milliseconds.
+		unsigned int idle_timeout_ms = 0;
+
+		HttpRequestParser::Limits request_limits{};
+
 		ServerWebService(handle_request_t handle_request = nullptr);
 
 		// HTTP
@@ -33,11 +43,27 @@ NAMESPACE_SOUP
 		static void sendHtml(Socket& s, const std::string& body);
 		static void sendText(Socket& s, const std::string& body);
 		static void sendData(Socket& s, const char* mime_type, const std::string& body, bool is_private = true);
+		static void sendData(Socket& s, const HttpRequest& req, const char* mime_type, const std::string& body, bool is_private = true); // Gzips the body if the client accepts it and it makes it smaller.
 		static void sendRedirect(Socket& s, const std::string& location);
 		static void send204(Socket& s);
 		static void send400(Socket& s);
 		static void send404(Socket& s);
 		static void sendResponse(Socket& s, const char* status, const std::string& headers_and_body);
+		static void sendResponse(Socket& s, const char* status, const std::string& headers, const std::string& body); // The body is sent without being copied into the header buffer.
+
+		// Streams a file without reading it into memory: via sendfile on plaintext sockets on Linux, otherwise in chunks from a memory mapping.
+		// Handles HEAD, Range (single ranges), If-Range, If-None-Match and If-Modified-Since.
+		// Returns false without sending anything if the file can't be opened, in which case you may want to send404.
+		static bool sendFile(Socket& s, const HttpRequest& req, const std::filesystem::path& path, const char* mime_type, bool is_private = false);
+
+		enum RangeResult : uint8_t
+		{
+			RANGE_NONE, // The header should be ignored and the entire file sent.
+			RANGE_OK,
+			RANGE_UNSATISFIABLE,
+		};
+		[[nodiscard]] static RangeResult parseRange(const std::string& value, uint64_t size, uint64_t& first, uint64_t& last) noexcept; // 'last' is inclusive.
+		[[nodiscard]] static bool acceptsGzip(const HttpRequest& req);
 
 		// WebSocket
 		static void wsSendText(Socket& s, const std::string& data);
@@ -47,6 +73,7 @@ NAMESPACE_SOUP
 
 	protected:
 		void httpRecv(Socket& s);
+		void httpProcess(Socket& s); // Handles all buffered (pipelined) requests, then waits for more.
 		void wsRecv(Socket& s);
 	};
 }
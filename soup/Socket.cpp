@@ -7,10 +7,15 @@
 #include <unistd.h> // close
 #include <poll.h>
 #include <sys/resource.h>
+#include <sys/uio.h> // writev
 
 #include "signal.hpp"
 #endif
 
+#if SOUP_LINUX
+#include <sys/epoll.h>
+#endif
+
 #include "aes.hpp"
 #include "Buffer.hpp"
 #include "BufferRefWriter.hpp"
@@ -22,6 +27,7 @@
 #include "netConfig.hpp"
 #include "ObfusString.hpp"
 #include "rand.hpp"
+#include "Scheduler.hpp"
 #include "sha1.hpp"
 #include "sha256.hpp"
 #include "SocketTlsHandshaker.hpp"
@@ -35,9 +41,11 @@
 #include "TlsEncryptedPreMasterSecret.hpp"
 #include "TlsExtensionType.hpp"
 #include "TlsHandshake.hpp"
+#include "TlsNewSessionTicket.hpp"
 #include "TlsRecord.hpp"
 #include "TlsServerHello.hpp"
 #include "TlsServerKeyExchange.hpp"
+#include "TlsSessionCache.hpp"
 #include "TlsSignatureScheme.hpp"
 #include "TrustStore.hpp"
 
@@ -90,6 +98,8 @@ NAMESPACE_SOUP
 	Socket::~Socket() noexcept
 	{
 		close();
+		discardSendQueue();
+		transport_close();
 #if SOUP_WINDOWS
 		if (--wsa_consumers == 0)
 		{
@@ -98,6 +108,42 @@ NAMESPACE_SOUP
 #endif
 	}
 
+	Socket& Socket::operator =(Socket&& b) noexcept
+	{
+#if SOUP_LINUX
+		// epoll would keep reporting b's connection to b. This socket is registered again once its Scheduler ticks it.
+		for (Socket* s : { this, &b })
+		{
+			if (s->epoll_events != 0)
+			{
+				::epoll_ctl(s->epoll_owner, EPOLL_CTL_DEL, s->fd, nullptr);
+				s->epoll_events = 0;
+				s->epoll_owner = -1;
+			}
+			s->epollMarkDirty();
+		}
+#endif
+		const auto deadline_index = this->deadline_index;
+		Worker::operator =(std::move(b));
+		this->deadline_index = deadline_index;
+		fd = std::move(b.fd);
+		peer = std::move(b.peer);
+		custom_data = std::move(b.custom_data);
+		remote_closed = b.remote_closed;
+		dispatched_connection_lost = b.dispatched_connection_lost;
+		callback_recv_on_close = b.callback_recv_on_close;
+		unrecv_buf = std::move(b.unrecv_buf);
+		send_queue = std::move(b.send_queue);
+		send_queue_offset = b.send_queue_offset;
+		send_refill = b.send_refill;
+		send_refill_cap = std::move(b.send_refill_cap);
+		close_after_flush = b.close_after_flush;
+		lingering = b.lingering;
+		tls_encrypter_send = std::move(b.tls_encrypter_send);
+		tls_encrypter_recv = std::move(b.tls_encrypter_recv);
+		return *this;
+	}
+
 	bool Socket::init(int af, int type)
 	{
 		if (fd == -1)
@@ -389,7 +435,7 @@ NAMESPACE_SOUP
 		bool sha256;
 	};
 
-	void Socket::enableCryptoClient(std::string server_name, void(*callback)(Socket&, Capture&&) SOUP_EXCAL, Capture&& cap, std::string&& initial_application_data) SOUP_EXCAL
+	void Socket::enableCryptoClient(std::string server_name, void(*callback)(Socket&, Capture&&) SOUP_EXCAL, Capture&& cap, std::string&& initial_application_data, const std::vector<std::string>& alpn_protocols) SOUP_EXCAL
 	{
 		auto handshaker = make_unique<SocketTlsHandshaker>(
 			callback,
@@ -397,6 +443,13 @@ NAMESPACE_SOUP
 		);
 		handshaker->server_name = std::move(server_name);
 		handshaker->initial_application_data = std::move(initial_application_data);
+		if (!handshaker->server_name.empty())
+		{
+			// Without a name, we can't tell remotes apart well enough to resume sessions with them.
+			handshaker->session_cache_key = handshaker->server_name;
+			handshaker->session_cache_key.push_back(':');
+			handshaker->session_cache_key.append(std::to_string(peer.getPort()));
+		}
 
 		TlsClientHello hello;
 		hello.random.time = static_cast<uint32_t>(time::unixSeconds());
@@ -432,6 +485,20 @@ NAMESPACE_SOUP
 		);
 		hello.compression_methods = { 0 };
 
+		if (!handshaker->session_cache_key.empty())
+		{
+			if (auto session = TlsSessionCache::client().find(handshaker->session_cache_key); session.has_value())
+			{
+				// When offering a ticket, we make up a session id, which the server echoes if it accepts the ticket. (RFC 5077 § 3.4)
+				if (!session->ticket.empty())
+				{
+					session->session_id = rand.binstr(32);
+				}
+				hello.session_id = session->session_id;
+				handshaker->session = std::move(*session);
+			}
+		}
+
 		if (!handshaker->server_name.empty())
 		{
 			TlsClientHelloExtServerName ext_server_name{};
@@ -476,6 +543,21 @@ NAMESPACE_SOUP
 
 		hello.extensions.add(TlsExtensionType::extended_master_secret, {});
 
+		hello.extensions.add(TlsExtensionType::session_ticket, std::string(handshaker->session.ticket));
+
+		if (!alpn_protocols.empty())
+		{
+			std::string list{};
+			for (const auto& protocol : alpn_protocols)
+			{
+				list.push_back(static_cast<char>(protocol.size()));
+				list.append(protocol);
+			}
+			StringWriter sw;
+			sw.str_lp<u16be_t>(std::move(list));
+			hello.extensions.add(TlsExtensionType::application_layer_protocol_negotiation, std::move(sw.data));
+		}
+
 		// We support only TLS 1.2. Not particularly useful to provide this extension, but in the future we may support TLS 1.3 and then
 		// this would defend against downgrade attacks.
 		// For now, we can use it to defend against JA3 fingerprinting. :^)
@@ -502,6 +584,44 @@ NAMESPACE_SOUP
 				handshaker->cipher_suite = shello.cipher_suite;
 				handshaker->server_random = shello.random.toBinaryString();
 				handshaker->extended_master_secret = shello.extensions.contains(TlsExtensionType::extended_master_secret);
+				for (const auto& ext : shello.extensions.extensions)
+				{
+					if (ext.id == TlsExtensionType::application_layer_protocol_negotiation)
+					{
+						// ProtocolNameList with exactly one name
+						SOUP_IF_UNLIKELY (ext.data.size() < 3
+							|| static_cast<uint8_t>(ext.data[2]) != ext.data.size() - 3
+							)
+						{
+							s.tls_close(TlsAlertDescription::decode_error);
+							return;
+						}
+						s.custom_data.getStructFromMap(TlsAlpnProtocol) = ext.data.substr(3);
+					}
+				}
+				handshaker->session_ticket = shello.extensions.contains(TlsExtensionType::session_ticket);
+
+				if (!shello.session_id.empty()
+					&& !handshaker->session.master_secret.empty()
+					&& shello.session_id == handshaker->session.session_id
+					)
+				{
+					// Server accepted our session, so the server's ChangeCipherSpec & Finished follow.
+					SOUP_IF_UNLIKELY (handshaker->cipher_suite != handshaker->session.cipher_suite
+						|| handshaker->extended_master_secret != handshaker->session.extended_master_secret // RFC 7627 § 5.3
+						)
+					{
+						TlsSessionCache::client().erase(handshaker->session_cache_key);
+						s.tls_close(TlsAlertDescription::handshake_failure);
+						return;
+					}
+					handshaker->resumed = true;
+					handshaker->master_secret = handshaker->session.master_secret;
+					s.enableCryptoClientRecvServerFinished(std::move(handshaker));
+					return;
+				}
+				handshaker->session = TlsSession{};
+				handshaker->session.session_id = std::move(shello.session_id);
 
 				s.tls_recvHandshake(std::move(handshaker), [](Socket& s, UniquePtr<SocketTlsHandshaker>&& handshaker, TlsHandshakeType_t handshake_type, std::string&& data) SOUP_EXCAL
 				{
@@ -871,31 +991,97 @@ NAMESPACE_SOUP
 					tls_sendRecordEncrypted(TlsContentType::application_data, handshaker->initial_application_data);
 				}
 
-				tls_recvRecord(TlsContentType::change_cipher_spec, [](Socket& s, std::string&& data, Capture&& cap) SOUP_EXCAL
+				enableCryptoClientRecvServerFinished(std::move(handshaker));
+			}
+		}
+	}
+
+	void Socket::enableCryptoClientRecvServerFinished(UniquePtr<SocketTlsHandshaker>&& handshaker) SOUP_EXCAL
+	{
+		if (handshaker->session_ticket)
+		{
+			handshaker->session_ticket = false;
+			tls_recvHandshake(std::move(handshaker), [](Socket& s, UniquePtr<SocketTlsHandshaker>&& handshaker, TlsHandshakeType_t handshake_type, std::string&& data) SOUP_EXCAL
+			{
+				if (handshake_type != TlsHandshake::new_session_ticket)
 				{
-					UniquePtr<SocketTlsHandshaker> handshaker = std::move(cap.get<UniquePtr<SocketTlsHandshaker>>());
+					s.tls_close(TlsAlertDescription::unexpected_message);
+					return;
+				}
+				TlsNewSessionTicket nst;
+				if (!nst.fromBinary(data))
+				{
+					s.tls_close(TlsAlertDescription::decode_error);
+					return;
+				}
+				handshaker->session.ticket = std::move(nst.ticket);
+				s.enableCryptoClientRecvServerFinished(std::move(handshaker));
+			});
+			return;
+		}
 
-					s.tls_encrypter_recv = std::move(handshaker->pending_recv_encrypter);
+		tls_recvRecord(TlsContentType::change_cipher_spec, [](Socket& s, std::string&& data, Capture&& cap) SOUP_EXCAL
+		{
+			UniquePtr<SocketTlsHandshaker> handshaker = std::move(cap.get<UniquePtr<SocketTlsHandshaker>>());
 
-					handshaker->expected_finished_verify_data = handshaker->getServerFinishVerifyData();
+			if (handshaker->resumed)
+			{
+				// In an abbreviated handshake, the server's Finished comes first.
+				handshaker->getKeys(
+					handshaker->pending_send_encrypter.mac_key,
+					handshaker->pending_recv_encrypter.mac_key,
+					handshaker->pending_send_encrypter.cipher_key,
+					handshaker->pending_recv_encrypter.cipher_key,
+					handshaker->pending_send_encrypter.implicit_iv,
+					handshaker->pending_recv_encrypter.implicit_iv
+				);
+			}
+
+			s.tls_encrypter_recv = std::move(handshaker->pending_recv_encrypter);
 
-					s.tls_recvHandshake(std::move(handshaker), [](Socket& s, UniquePtr<SocketTlsHandshaker>&& handshaker, TlsHandshakeType_t handshake_type, std::string&& data) SOUP_EXCAL
+			handshaker->expected_finished_verify_data = handshaker->getServerFinishVerifyData();
+
+			s.tls_recvHandshake(std::move(handshaker), [](Socket& s, UniquePtr<SocketTlsHandshaker>&& handshaker, TlsHandshakeType_t handshake_type, std::string&& data) SOUP_EXCAL
+			{
+				if (handshake_type != TlsHandshake::finished)
+				{
+					s.tls_close(TlsAlertDescription::unexpected_message);
+					return;
+				}
+				if (data != handshaker->expected_finished_verify_data)
+				{
+					if (handshaker->resumed)
 					{
-						if (handshake_type != TlsHandshake::finished)
-						{
-							s.tls_close(TlsAlertDescription::unexpected_message);
-							return;
-						}
-						if (data != handshaker->expected_finished_verify_data)
-						{
-							s.tls_close(TlsAlertDescription::decrypt_error);
-							return;
-						}
-						handshaker->callback(s, std::move(handshaker->callback_capture));
-					});
-				}, std::move(handshaker));
-			}
-		}
+						TlsSessionCache::client().erase(handshaker->session_cache_key);
+					}
+					s.tls_close(TlsAlertDescription::decrypt_error);
+					return;
+				}
+				if (handshaker->resumed)
+				{
+					if (!s.tls_sendRecord(TlsContentType::change_cipher_spec, "\1"))
+					{
+						return;
+					}
+					s.tls_encrypter_send = std::move(handshaker->pending_send_encrypter);
+					if (!s.tls_sendHandshake(handshaker, TlsHandshake::finished, handshaker->getClientFinishVerifyData()))
+					{
+						return;
+					}
+					if (!handshaker->initial_application_data.empty())
+					{
+						s.tls_sendRecordEncrypted(TlsContentType::application_data, handshaker->initial_application_data);
+					}
+					++TlsSessionCache::client().num_resumed_handshakes;
+				}
+				else
+				{
+					++TlsSessionCache::client().num_full_handshakes;
+				}
+				handshaker->storeClientSession();
+				handshaker->callback(s, std::move(handshaker->callback_capture));
+			});
+		}, std::move(handshaker));
 	}
 
 	[[nodiscard]] static bool tls_serverSupportsCipherSuite(uint16_t cs) noexcept
@@ -934,6 +1120,7 @@ NAMESPACE_SOUP
 			}
 
 			const CertStore::Entry* rsa_data;
+			std::string session_id;
 
 			{
 				TlsClientHello hello;
@@ -952,6 +1139,7 @@ NAMESPACE_SOUP
 				}
 
 				std::string server_name{};
+				std::string ticket{};
 				for (const auto& ext : hello.extensions.extensions)
 				{
 					if (ext.id == TlsExtensionType::server_name)
@@ -966,8 +1154,14 @@ NAMESPACE_SOUP
 					{
 						handshaker->extended_master_secret = true;
 					}
+					else if (ext.id == TlsExtensionType::session_ticket)
+					{
+						handshaker->session_ticket = true;
+						ticket = ext.data;
+					}
 				}
 				rsa_data = handshaker->certstore->findEntryForDomain(server_name);
+				handshaker->session.server_name = server_name;
 				if (!rsa_data)
 				{
 					s.tls_close(TlsAlertDescription::unrecognized_name);
@@ -976,6 +1170,36 @@ NAMESPACE_SOUP
 
 				handshaker->client_random = hello.random.toBinaryString();
 
+				// Resumption requires the client to have sent a session id, which we echo to signal it. (RFC 5077 § 3.4)
+				if (!hello.session_id.empty())
+				{
+					Optional<TlsSession> session;
+					if (!ticket.empty())
+					{
+						session = handshaker->certstore->sessions.openTicket(ticket);
+					}
+					else
+					{
+						session = handshaker->certstore->sessions.find(hello.session_id);
+					}
+					if (session.has_value()
+						&& session->server_name == server_name // RFC 6066 § 3
+						&& session->extended_master_secret == handshaker->extended_master_secret // RFC 7627 § 5.3
+						&& std::find(hello.cipher_suites.begin(), hello.cipher_suites.end(), session->cipher_suite) != hello.cipher_suites.end()
+						)
+					{
+						handshaker->resumed = true;
+						handshaker->session = std::move(*session);
+						handshaker->cipher_suite = handshaker->session.cipher_suite;
+						handshaker->master_secret = handshaker->session.master_secret;
+						session_id = hello.session_id;
+					}
+				}
+				if (!handshaker->resumed)
+				{
+					session_id = rand.binstr(32);
+				}
+
 				if (handshaker->on_client_hello)
 				{
 					handshaker->on_client_hello(s, std::move(hello));
@@ -987,6 +1211,7 @@ NAMESPACE_SOUP
 				shello.random.time = static_cast<uint32_t>(time::unixSeconds());
 				rand.fill(shello.random.random);
 				handshaker->server_random = shello.random.toBinaryString();
+				shello.session_id = session_id;
 				shello.cipher_suite = handshaker->cipher_suite;
 				shello.compression_method = 0;
 
@@ -995,12 +1220,25 @@ NAMESPACE_SOUP
 					shello.extensions.add(TlsExtensionType::extended_master_secret, {});
 				}
 
+				if (handshaker->session_ticket
+					&& !handshaker->resumed
+					)
+				{
+					shello.extensions.add(TlsExtensionType::session_ticket, {});
+				}
+
 				if (!s.tls_sendHandshake(handshaker, TlsHandshake::server_hello, shello.toBinaryString()))
 				{
 					return;
 				}
 			}
 
+			if (handshaker->resumed)
+			{
+				s.enableCryptoServerResume(std::move(handshaker));
+				return;
+			}
+
 			{
 				TlsCertificate tcert;
 				tcert.asn1_certs.reserve(rsa_data->chain.certs.size());
@@ -1020,6 +1258,7 @@ NAMESPACE_SOUP
 			}
 
 			handshaker->private_key = &rsa_data->private_key;
+			handshaker->session.session_id = std::move(session_id);
 
 			s.tls_recvHandshake(std::move(handshaker), [](Socket& s, UniquePtr<SocketTlsHandshaker>&& handshaker, TlsHandshakeType_t handshake_type, std::string&& data)
 			{
@@ -1047,11 +1286,6 @@ NAMESPACE_SOUP
 
 				s.tls_recvRecord(TlsContentType::change_cipher_spec, [](Socket& s, std::string&& data, Capture&& cap)
 				{
-					if (!s.tls_sendRecord(TlsContentType::change_cipher_spec, "\1"))
-					{
-						return;
-					}
-
 					UniquePtr<SocketTlsHandshaker> handshaker = std::move(cap.get<UniquePtr<SocketTlsHandshaker>>());
 
 					auto* p = &handshaker->promise;
@@ -1064,11 +1298,11 @@ NAMESPACE_SOUP
 
 						handshaker->getKeys(
 							s.tls_encrypter_recv.mac_key,
-							s.tls_encrypter_send.mac_key,
+							handshaker->pending_send_encrypter.mac_key,
 							s.tls_encrypter_recv.cipher_key,
-							s.tls_encrypter_send.cipher_key,
+							handshaker->pending_send_encrypter.cipher_key,
 							s.tls_encrypter_recv.implicit_iv,
-							s.tls_encrypter_send.implicit_iv
+							handshaker->pending_send_encrypter.implicit_iv
 						);
 
 						handshaker->expected_finished_verify_data = handshaker->getClientFinishVerifyData();
@@ -1087,8 +1321,33 @@ NAMESPACE_SOUP
 								return;
 							}
 
+							auto& sessions = handshaker->certstore->sessions;
+							handshaker->session.master_secret = handshaker->getMasterSecret();
+							handshaker->session.cipher_suite = handshaker->cipher_suite;
+							handshaker->session.extended_master_secret = handshaker->extended_master_secret;
+							handshaker->session.created = time::unixSeconds();
+							if (handshaker->session_ticket)
+							{
+								TlsNewSessionTicket nst;
+								nst.ticket_lifetime_hint = sessions.lifetime;
+								nst.ticket = sessions.sealTicket(handshaker->session);
+								if (!s.tls_sendHandshake(handshaker, TlsHandshake::new_session_ticket, nst.toBinaryString()))
+								{
+									return;
+								}
+							}
+
+							if (!s.tls_sendRecord(TlsContentType::change_cipher_spec, "\1"))
+							{
+								return;
+							}
+							s.tls_encrypter_send = std::move(handshaker->pending_send_encrypter);
+
 							if (s.tls_sendHandshake(handshaker, TlsHandshake::finished, handshaker->getServerFinishVerifyData()))
 							{
+								++sessions.num_full_handshakes;
+								const std::string key = handshaker->session.session_id;
+								sessions.store(key, std::move(handshaker->session));
 								handshaker->callback(s, std::move(handshaker->callback_capture));
 							}
 						});
@@ -1098,6 +1357,54 @@ NAMESPACE_SOUP
 		});
 	}
 
+	void Socket::enableCryptoServerResume(UniquePtr<SocketTlsHandshaker>&& handshaker)
+	{
+		handshaker->getKeys(
+			handshaker->pending_recv_encrypter.mac_key,
+			handshaker->pending_send_encrypter.mac_key,
+			handshaker->pending_recv_encrypter.cipher_key,
+			handshaker->pending_send_encrypter.cipher_key,
+			handshaker->pending_recv_encrypter.implicit_iv,
+			handshaker->pending_send_encrypter.implicit_iv
+		);
+		if (!tls_sendRecord(TlsContentType::change_cipher_spec, "\1"))
+		{
+			return;
+		}
+		tls_encrypter_send = std::move(handshaker->pending_send_encrypter);
+		if (!tls_sendHandshake(handshaker, TlsHandshake::finished, handshaker->getServerFinishVerifyData()))
+		{
+			return;
+		}
+
+		tls_recvRecord(TlsContentType::change_cipher_spec, [](Socket& s, std::string&&, Capture&& cap)
+		{
+			UniquePtr<SocketTlsHandshaker> handshaker = std::move(cap.get<UniquePtr<SocketTlsHandshaker>>());
+
+			s.tls_encrypter_recv = std::move(handshaker->pending_recv_encrypter);
+
+			handshaker->expected_finished_verify_data = handshaker->getClientFinishVerifyData();
+
+			s.tls_recvHandshake(std::move(handshaker), [](Socket& s, UniquePtr<SocketTlsHandshaker>&& handshaker, TlsHandshakeType_t handshake_type, std::string&& data)
+			{
+				if (handshake_type != TlsHandshake::finished)
+				{
+					s.tls_close(TlsAlertDescription::unexpected_message);
+					return;
+				}
+
+				if (data != handshaker->expected_finished_verify_data)
+				{
+					s.tls_close(TlsAlertDescription::decrypt_error);
+					return;
+				}
+
+				++handshaker->certstore->sessions.num_resumed_handshakes;
+				handshaker->callback(s, std::move(handshaker->callback_capture));
+			});
+		}, std::move(handshaker));
+	}
+
 	bool Socket::isEncrypted() const noexcept
 	{
 		return tls_encrypter_send.isActive();
@@ -1109,7 +1416,16 @@ NAMESPACE_SOUP
 		{
 			return tls_sendRecordEncrypted(TlsContentType::application_data, data, size);
 		}
-		return transport_send(data, static_cast<int>(size));
+		return transport_send(data, size);
+	}
+
+	bool Socket::send(SendSlice* slices, size_t num_slices) SOUP_EXCAL
+	{
+		if (tls_encrypter_send.isActive())
+		{
+			return tls_sendRecordEncrypted(TlsContentType::application_data, slices, num_slices);
+		}
+		return transport_send(slices, num_slices);
 	}
 
 	bool Socket::initUdpBroadcast4()
@@ -1215,6 +1531,7 @@ NAMESPACE_SOUP
 	void Socket::udpRecv(void(*callback)(Socket&, SocketAddr&&, std::string&&, Capture&&), Capture&& cap) noexcept
 	{
 		holdup_type = SOCKET;
+		epollMarkDirty();
 		holdup_callback.set([](Worker& w, Capture&& _cap) SOUP_EXCAL
 		{
 			w.holdup_type = Worker::NONE;
@@ -1274,9 +1591,11 @@ NAMESPACE_SOUP
 			TlsRecord record{};
 			record.content_type = content_type;
 			record.length = static_cast<uint16_t>(content.size());
-			auto data = record.toBinaryString();
-			data.append(content);
-			return transport_send(data);
+			SendSlice slices[] = {
+				record.toBinaryString(),
+				content,
+			};
+			return transport_send(slices, 2);
 		}
 
 		return tls_sendRecordEncrypted(content_type, content);
@@ -1289,18 +1608,54 @@ NAMESPACE_SOUP
 
 	bool Socket::tls_sendRecordEncrypted(TlsContentType_t content_type, const void* data, size_t size) SOUP_EXCAL
 	{
-		auto body = tls_encrypter_send.encrypt(content_type, data, size);
+		SendSlice slice(data, size);
+		return tls_sendRecordEncrypted(content_type, &slice, 1);
+	}
+
+	bool Socket::tls_sendRecordEncrypted(TlsContentType_t content_type, SendSlice* slices, size_t num_slices) SOUP_EXCAL
+	{
+		constexpr size_t max_fragment_size = 0x4000; // 2^14 as per RFC 5246
+
+		const auto headroom = tls_encrypter_send.getRecordHeadroom();
+		const auto tailroom = tls_encrypter_send.getMaxRecordTailroom();
+
+		size_t remaining = 0;
+		for (size_t i = 0; i != num_slices; ++i)
+		{
+			remaining += slices[i].size();
+		}
 
-		TlsRecord record{};
-		record.content_type = content_type;
-		record.length = static_cast<uint16_t>(body.size());
+		std::vector<SendSlice> records{};
+		records.reserve((remaining / max_fragment_size) + 1);
+		size_t slice_i = 0;
+		size_t slice_offset = 0;
+		do
+		{
+			const auto fragment_size = std::min(remaining, max_fragment_size);
+			const auto record_end = headroom + fragment_size;
+
+			// Gather the plaintext straight into the buffer that will be encrypted and sent, so it's only copied once.
+			std::string record;
+			record.reserve(record_end + tailroom);
+			record.append(headroom, '\0');
+			while (record.size() != record_end)
+			{
+				const auto chunk = std::min(slices[slice_i].size() - slice_offset, record_end - record.size());
+				record.append(slices[slice_i].data() + slice_offset, chunk);
+				slice_offset += chunk;
+				if (slice_offset == slices[slice_i].size())
+				{
+					++slice_i;
+					slice_offset = 0;
+				}
+			}
+			remaining -= fragment_size;
 
-		Buffer header(5);
-		BufferRefWriter bw(header);
-		record.write(bw);
+			tls_encrypter_send.encryptRecordInPlace(content_type, record);
+			records.emplace_back(std::move(record));
+		} while (remaining != 0);
 
-		body.prepend(header.data(), header.size());
-		return transport_send(body);
+		return transport_send(records.data(), records.size());
 	}
 
 	struct CaptureSocketTlsRecvHandshake
@@ -1554,17 +1909,16 @@ NAMESPACE_SOUP
 
 						auto ad = s.tls_encrypter_recv.calculateMacBytes(cap.content_type, data.size());
 
-						if (aes::gcmDecrypt(
-							(uint8_t*)data.data(), data.size(),
-							(const uint8_t*)ad.data(), ad.size(),
-							s.tls_encrypter_recv.cipher_key.data(), s.tls_encrypter_recv.cipher_key.size(),
-							iv.data(), iv.size(),
-							(const uint8_t*)tag.data()
-						) != true)
+						auto& ctx = s.tls_encrypter_recv.getGcmContext();
+						ctx.start(iv.data(), iv.size());
+						ctx.aad((const uint8_t*)ad.data(), ad.size());
+						ctx.authenticate((const uint8_t*)data.data(), data.size());
+						if (!ctx.verify((const uint8_t*)tag.data()))
 						{
 							s.tls_close(TlsAlertDescription::bad_record_mac);
 							return;
 						}
+						ctx.applyKeystream((uint8_t*)data.data(), data.size());
 					}
 				}
 				cap.prev.callback(s, cap.content_type, std::move(data), std::move(cap.prev.cap));
@@ -1618,19 +1972,182 @@ NAMESPACE_SOUP
 		return ::recv(fd, &buf, 1, MSG_PEEK) == 1;
 	}
 
-	bool Socket::transport_send(const Buffer& buf) const noexcept
+	bool Socket::transport_send(const Buffer& buf) SOUP_EXCAL
+	{
+		return transport_send(buf.data(), buf.size());
+	}
+
+	bool Socket::transport_send(const std::string& data) SOUP_EXCAL
+	{
+		return transport_send(data.data(), data.size());
+	}
+
+	bool Socket::transport_send(const void* data, size_t size) SOUP_EXCAL
+	{
+		SendSlice slice(data, size);
+		return transport_send(&slice, 1);
+	}
+
+#if SOUP_WINDOWS
+	using socket_iovec_t = WSABUF;
+#else
+	using socket_iovec_t = struct iovec;
+#endif
+
+	static constexpr size_t SOCKET_MAX_IOVECS = 64;
+
+	static void socket_iovec_set(socket_iovec_t& vec, const char* data, size_t size) noexcept
+	{
+#if SOUP_WINDOWS
+		vec.buf = const_cast<char*>(data);
+		vec.len = static_cast<ULONG>(size);
+#else
+		vec.iov_base = const_cast<char*>(data);
+		vec.iov_len = size;
+#endif
+	}
+
+	// Returns the number of bytes sent, 0 if the kernel's send buffer is full, or -1 on error.
+	[[nodiscard]] static intptr_t socket_writev(Socket::fd_t fd, socket_iovec_t* vecs, size_t num_vecs) noexcept
+	{
+#if SOUP_WINDOWS
+		DWORD sent;
+		if (::WSASend(fd, vecs, static_cast<DWORD>(num_vecs), &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+		{
+			return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+		}
+		return static_cast<intptr_t>(sent);
+#else
+		auto sent = ::writev(fd, vecs, static_cast<int>(num_vecs));
+		if (sent == -1)
+		{
+			return (errno == EWOULDBLOCK || errno == EAGAIN) ? 0 : -1;
+		}
+		return sent;
+#endif
+	}
+
+	bool Socket::transport_send(SendSlice* slices, size_t num_slices) SOUP_EXCAL
 	{
-		return transport_send(buf.data(), static_cast<int>(buf.size()));
+		size_t i = 0;
+		size_t offset = 0; // into slices[i]
+		if (send_queue.empty())
+		{
+			while (i != num_slices)
+			{
+				socket_iovec_t vecs[SOCKET_MAX_IOVECS];
+				size_t num_vecs = 0;
+				size_t batch_size = 0;
+				for (; i + num_vecs != num_slices && num_vecs != SOCKET_MAX_IOVECS; ++num_vecs)
+				{
+					socket_iovec_set(vecs[num_vecs], slices[i + num_vecs].data(), slices[i + num_vecs].size());
+					batch_size += slices[i + num_vecs].size();
+				}
+				const auto sent = socket_writev(fd, vecs, num_vecs);
+				SOUP_IF_UNLIKELY (sent < 0)
+				{
+					return false;
+				}
+				const auto batch_end = i + num_vecs;
+				offset = static_cast<size_t>(sent);
+				while (i != batch_end && offset >= slices[i].size())
+				{
+					offset -= slices[i].size();
+					++i;
+				}
+				if (static_cast<size_t>(sent) != batch_size)
+				{
+					break;
+				}
+				offset = 0;
+			}
+		}
+		if (i == num_slices)
+		{
+			return true;
+		}
+
+		// The kernel's send buffer is full, so queue whatever is left to be flushed when the socket becomes writable.
+		if (slices[i].isOwned() && send_queue.empty())
+		{
+			send_queue.emplace_back(std::move(slices[i].owned));
+			send_queue_offset = offset;
+		}
+		else
+		{
+			send_queue.emplace_back(slices[i].data() + offset, slices[i].size() - offset);
+		}
+		for (++i; i != num_slices; ++i)
+		{
+			if (slices[i].isOwned())
+			{
+				send_queue.emplace_back(std::move(slices[i].owned));
+			}
+			else
+			{
+				send_queue.emplace_back(slices[i].data(), slices[i].size());
+			}
+		}
+		epollMarkDirty();
+		return true;
 	}
 
-	bool Socket::transport_send(const std::string& data) const noexcept
+	bool Socket::transport_flush() SOUP_EXCAL
 	{
-		return transport_send(data.data(), static_cast<int>(data.size()));
+		while (!send_queue.empty())
+		{
+			socket_iovec_t vecs[SOCKET_MAX_IOVECS];
+			size_t num_vecs = 0;
+			size_t batch_size = 0;
+			for (; num_vecs != send_queue.size() && num_vecs != SOCKET_MAX_IOVECS; ++num_vecs)
+			{
+				const auto offset = (num_vecs == 0 ? send_queue_offset : 0);
+				socket_iovec_set(vecs[num_vecs], send_queue[num_vecs].data() + offset, send_queue[num_vecs].size() - offset);
+				batch_size += send_queue[num_vecs].size() - offset;
+			}
+			const auto sent = socket_writev(fd, vecs, num_vecs);
+			SOUP_IF_UNLIKELY (sent < 0)
+			{
+				discardSendQueue();
+				return false;
+			}
+			size_t consumed = 0;
+			size_t offset = send_queue_offset + static_cast<size_t>(sent);
+			while (consumed != num_vecs && offset >= send_queue[consumed].size())
+			{
+				offset -= send_queue[consumed].size();
+				++consumed;
+			}
+			send_queue.erase(send_queue.begin(), send_queue.begin() + consumed);
+			send_queue_offset = offset;
+			if (static_cast<size_t>(sent) != batch_size)
+			{
+				return true;
+			}
+		}
+		if (send_refill)
+		{
+			// Taking the refill out while it runs so it may replace itself.
+			auto refill = send_refill;
+			Capture cap = std::move(send_refill_cap);
+			send_refill = nullptr;
+			if (refill(*this, cap)
+				&& send_refill == nullptr
+				)
+			{
+				send_refill = refill;
+				send_refill_cap = std::move(cap);
+			}
+		}
+		return true;
 	}
 
-	bool Socket::transport_send(const void* data, int size) const noexcept
+	void Socket::discardSendQueue() noexcept
 	{
-		return ::send(fd, (const char*)data, size, 0) == size;
+		send_queue.clear();
+		send_queue_offset = 0;
+		send_refill = nullptr;
+		send_refill_cap.reset();
 	}
 
 	std::string Socket::transport_recvCommon(int max_bytes) SOUP_EXCAL
@@ -1689,6 +2206,7 @@ NAMESPACE_SOUP
 			}
 		}
 		holdup_type = SOCKET;
+		epollMarkDirty();
 		holdup_callback.set([](Worker& w, Capture&& _cap) // 'excal' as long as callback is
 		{
 			w.holdup_type = Worker::NONE;
@@ -1727,6 +2245,7 @@ NAMESPACE_SOUP
 			}
 		}
 		holdup_type = SOCKET;
+		epollMarkDirty();
 		holdup_callback.set([](Worker& w, Capture&& _cap) // 'excal' as long as callback is
 		{
 			w.holdup_type = Worker::NONE;
@@ -1744,15 +2263,38 @@ NAMESPACE_SOUP
 	{
 		if (hasConnection())
 		{
+			epollMarkDirty();
+			if (hasPendingSend() && !remote_closed)
+			{
+				close_after_flush = true;
+				holdup_type = NONE;
+				return;
+			}
+			discardSendQueue();
 #if SOUP_WINDOWS
 			::closesocket(fd);
 #else
 			::close(fd);
 #endif
 			fd = -1;
+			close_after_flush = false;
+#if SOUP_LINUX
+			epoll_events = 0; // Closing the fd removes it from any epoll instances.
+			epoll_owner = -1;
+#endif
 		}
 	}
 
+#if SOUP_LINUX
+	void Socket::epollMarkDirtyImpl() noexcept
+	{
+		if (auto sched = Scheduler::get())
+		{
+			sched->epollUnpark(*this);
+		}
+	}
+#endif
+
 	bool Socket::isWorkDoneOrClosed() const noexcept
 	{
 		return isWorkDone()
@@ -1769,6 +2311,26 @@ NAMESPACE_SOUP
 		});
 	}
 
+	bool Socket::isIdleConnectionUsable() const noexcept
+	{
+		if (isWorkDoneOrClosed()
+			|| !unrecv_buf.empty()
+			)
+		{
+			return false;
+		}
+		char buf;
+		if (::recv(fd, &buf, 1, MSG_PEEK) != -1) // 0 if the remote closed the connection, 1 if it sent something.
+		{
+			return false;
+		}
+#if SOUP_WINDOWS
+		return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+		return errno == EWOULDBLOCK || errno == EAGAIN;
+#endif
+	}
+
 	std::string Socket::toString() const SOUP_EXCAL
 	{
 		return peer.toString();
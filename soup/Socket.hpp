@@ -5,6 +5,9 @@
 #include "fwd.hpp"
 #include "type.hpp"
 
+#include <string>
+#include <vector>
+
 #include "Worker.hpp"
 
 #if SOUP_WINDOWS
@@ -25,6 +28,35 @@ NAMESPACE_SOUP
 	class Socket : public Worker
 	{
 	public:
+		// A slice of data for vectored sends.
+		// Borrowed slices only need to stay valid for the duration of the send call; they are copied if they need to be queued.
+		// Owned slices are moved into the socket's send queue without copying if the kernel's send buffer is full.
+		struct SendSlice
+		{
+			const void* borrowed_data = nullptr;
+			size_t borrowed_size = 0;
+			std::string owned{};
+
+			SendSlice(const void* data, size_t size) noexcept
+				: borrowed_data(data), borrowed_size(size)
+			{
+			}
+
+			SendSlice(const std::string& data) noexcept
+				: SendSlice(data.data(), data.size())
+			{
+			}
+
+			SendSlice(std::string&& data) noexcept
+				: owned(std::move(data))
+			{
+			}
+
+			[[nodiscard]] bool isOwned() const noexcept { return borrowed_data == nullptr; }
+			[[nodiscard]] const char* data() const noexcept { return isOwned() ? owned.data() : reinterpret_cast<const char*>(borrowed_data); }
+			[[nodiscard]] size_t size() const noexcept { return isOwned() ? owned.size() : borrowed_size; }
+		};
+
 #if SOUP_WINDOWS
 		inline static size_t wsa_consumers = 0;
 #else
@@ -42,9 +74,26 @@ NAMESPACE_SOUP
 		bool remote_closed = false;
 		bool dispatched_connection_lost = false;
 		bool callback_recv_on_close = false;
+#if SOUP_LINUX
+		uint32_t epoll_events = 0; // Managed by the Scheduler. 0 if not registered.
+		int epoll_owner = -1; // Managed by the Scheduler. The epoll instance the socket is registered with.
+		uint32_t epoll_parked_index = -1; // Managed by the Scheduler. Index into Scheduler::workers while the socket is only waiting for epoll to report it.
+#endif
 
 		std::string unrecv_buf{};
 
+		std::vector<std::string> send_queue{}; // Data that could not be sent yet because the kernel's send buffer was full. Flushed by the Scheduler.
+		size_t send_queue_offset = 0; // How many bytes of send_queue.front() have already been sent.
+
+		// Invoked by transport_flush whenever the send queue has been drained, so large responses can be produced incrementally.
+		// It should send a bounded amount of data and return true if it wants to be invoked again.
+		// Nothing else should be sent on the socket while a refill is set.
+		using send_refill_t = bool(*)(Socket&, Capture&) SOUP_EXCAL;
+		send_refill_t send_refill = nullptr;
+		Capture send_refill_cap{};
+		bool close_after_flush = false; // Set by transport_close if data was still queued. The connection is closed once the queue has been flushed.
+		bool lingering = false; // Managed by the Scheduler. Set while the socket is closed after flushing and a deadline for that is armed. Cleared if it gets a holdup again.
+
 		SocketTlsEncrypter tls_encrypter_send;
 		SocketTlsEncrypter tls_encrypter_recv;
 
@@ -67,7 +116,8 @@ NAMESPACE_SOUP
 
 		void operator =(const Socket&) = delete;
 
-		Socket& operator =(Socket&& b) noexcept = default;
+		// The Scheduler keeps track of sockets by address, so the epoll registration and deadline stay with the objects rather than following the connection.
+		Socket& operator =(Socket&& b) noexcept;
 
 		[[nodiscard]] constexpr bool hasConnection() const noexcept
 		{
@@ -112,13 +162,19 @@ NAMESPACE_SOUP
 		static bool certchain_validator_none(const X509Certchain&, const std::string&, StructMap&) SOUP_EXCAL; // Accepts everything.
 		static bool certchain_validator_default(const X509Certchain&, const std::string&, StructMap&) SOUP_EXCAL;
 
-		void enableCryptoClient(std::string server_name, void(*callback)(Socket&, Capture&&) SOUP_EXCAL, Capture&& cap = {}, std::string&& initial_application_data = {}) SOUP_EXCAL;
+		// If alpn_protocols are given, the one selected by the server will be in custom_data as TlsAlpnProtocol by the time the callback is invoked.
+		void enableCryptoClient(std::string server_name, void(*callback)(Socket&, Capture&&) SOUP_EXCAL, Capture&& cap = {}, std::string&& initial_application_data = {}, const std::vector<std::string>& alpn_protocols = {}) SOUP_EXCAL;
 	protected:
 		void enableCryptoClientRecvServerHelloDone(UniquePtr<SocketTlsHandshaker>&& handshaker) SOUP_EXCAL;
 		void enableCryptoClientProcessServerHelloDone(UniquePtr<SocketTlsHandshaker>&& handshaker) SOUP_EXCAL;
+		void enableCryptoClientRecvServerFinished(UniquePtr<SocketTlsHandshaker>&& handshaker) SOUP_EXCAL;
 
 	public:
 		void enableCryptoServer(SharedPtr<CertStore> certstore, void(*callback)(Socket&, Capture&&), Capture&& cap = {}, tls_server_on_client_hello_t on_client_hello = nullptr);
+	protected:
+		void enableCryptoServerResume(UniquePtr<SocketTlsHandshaker>&& handshaker) SOUP_EXCAL;
+
+	public:
 
 		// Application Layer
 
@@ -126,6 +182,9 @@ NAMESPACE_SOUP
 
 		bool send(const std::string& data) SOUP_EXCAL { return send(data.data(), data.size()); }
 		bool send(const void* data, size_t size) SOUP_EXCAL;
+		bool send(SendSlice* slices, size_t num_slices) SOUP_EXCAL; // Owned slices are moved from.
+		template <size_t N>
+		bool send(SendSlice(&slices)[N]) SOUP_EXCAL { return send(slices, N); }
 
 		bool initUdpBroadcast4();
 
@@ -170,6 +229,7 @@ NAMESPACE_SOUP
 		bool tls_sendRecord(TlsContentType_t content_type, const std::string& content) SOUP_EXCAL;
 		bool tls_sendRecordEncrypted(TlsContentType_t content_type, const std::string& content) SOUP_EXCAL;
 		bool tls_sendRecordEncrypted(TlsContentType_t content_type, const void* data, size_t size) SOUP_EXCAL;
+		bool tls_sendRecordEncrypted(TlsContentType_t content_type, SendSlice* slices, size_t num_slices) SOUP_EXCAL; // Split into as many records as needed, each encrypted in place.
 
 		void tls_recvHandshake(UniquePtr<SocketTlsHandshaker>&& handshaker, void(*callback)(Socket&, UniquePtr<SocketTlsHandshaker>&&, TlsHandshakeType_t, std::string&&), std::string&& pre = {});
 		void tls_recvRecord(TlsContentType_t expected_content_type, void(*callback)(Socket&, std::string&&, Capture&&), Capture&& cap = {}); // 'excal' as long as callback is
@@ -181,9 +241,33 @@ NAMESPACE_SOUP
 
 		// Transport Layer
 
-		bool transport_send(const Buffer& buf) const noexcept;
-		bool transport_send(const std::string& data) const noexcept;
-		bool transport_send(const void* data, int size) const noexcept;
+		// If the kernel's send buffer is full, the remaining data is added to the send queue, so these only return false on hard errors.
+		bool transport_send(const Buffer& buf) SOUP_EXCAL;
+		bool transport_send(const std::string& data) SOUP_EXCAL;
+		bool transport_send(const void* data, size_t size) SOUP_EXCAL;
+		bool transport_send(SendSlice* slices, size_t num_slices) SOUP_EXCAL; // Coalesced into a single writev/WSASend where possible. Owned slices are moved from.
+
+		[[nodiscard]] bool hasPendingSend() const noexcept { return !send_queue.empty() || send_refill != nullptr; }
+		void setSendRefill(send_refill_t refill, Capture&& cap = {}) noexcept { send_refill = refill; send_refill_cap = std::move(cap); epollMarkDirty(); }
+		bool transport_flush() SOUP_EXCAL; // Sends as much of the send queue as the kernel will take. Returns false on hard errors, in which case the queue is dropped.
+		void discardSendQueue() noexcept;
+
+		// If the socket is parked by the Scheduler of this thread, it's ticked again so its interest gets updated.
+		// Called automatically when data is queued, a receive is armed or the socket is closed, but needs to be called when changing its holdup type by other means.
+		void epollMarkDirty() noexcept
+		{
+#if SOUP_LINUX
+			if (epoll_parked_index != (uint32_t)-1)
+			{
+				epollMarkDirtyImpl();
+			}
+#endif
+		}
+	protected:
+#if SOUP_LINUX
+		void epollMarkDirtyImpl() noexcept;
+#endif
+	public:
 
 		using transport_recv_callback_t = void(*)(Socket&, std::string&&, Capture&&);
 
@@ -198,7 +282,7 @@ NAMESPACE_SOUP
 
 		void transport_unrecv(const std::string& data) SOUP_EXCAL;
 
-		void transport_close() noexcept;
+		void transport_close() noexcept; // If data is still queued, this only marks the socket as done, and the Scheduler closes it after flushing. Use discardSendQueue first to close right away.
 
 		// Utils
 
@@ -206,10 +290,16 @@ NAMESPACE_SOUP
 
 		void keepAlive() SOUP_EXCAL;
 
+		// Non-blocking check that the connection is still open and has no unread data, such as a close notify, so a new request can be sent on it.
+		[[nodiscard]] bool isIdleConnectionUsable() const noexcept;
+
 		[[nodiscard]] std::string toString() const SOUP_EXCAL;
 	};
 
 	// MAY be found in Socket::custom_data. See also: Socket::remote_closed.
 	using SocketCloseReason = std::string;
+
+	// MAY be found in Socket::custom_data after a TLS handshake in which the server selected an application protocol, e.g. "h2".
+	using TlsAlpnProtocol = std::string;
 }
 #endif
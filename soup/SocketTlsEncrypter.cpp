@@ -5,9 +5,19 @@
 #include "sha1.hpp"
 #include "sha256.hpp"
 #include "TlsMac.hpp"
+#include "TlsRecord.hpp"
 
 NAMESPACE_SOUP
 {
+	aes::GcmContext& SocketTlsEncrypter::getGcmContext() SOUP_EXCAL
+	{
+		if (!gcm)
+		{
+			gcm = soup::make_unique<aes::GcmContext>(cipher_key.data(), cipher_key.size());
+		}
+		return *gcm;
+	}
+
 	size_t SocketTlsEncrypter::getMacLength() const noexcept
 	{
 		return mac_key.size();
@@ -85,13 +95,11 @@ NAMESPACE_SOUP
 			buf.append(data, size);
 
 			uint8_t tag[cipher_bytes];
-			aes::gcmEncrypt(
-				buf.data(), buf.size(),
-				(const uint8_t*)ad.data(), ad.size(),
-				cipher_key.data(), cipher_key.size(),
-				iv.data(), iv.size(),
-				tag
-			);
+			auto& ctx = getGcmContext();
+			ctx.start(iv.data(), iv.size());
+			ctx.aad((const uint8_t*)ad.data(), ad.size());
+			ctx.encrypt(buf.data(), buf.size());
+			ctx.finish(tag);
 
 			buf.append(tag, cipher_bytes);
 			buf.prepend(nonce_explicit.data(), nonce_explicit.size());
@@ -99,10 +107,82 @@ NAMESPACE_SOUP
 		}
 	}
 
+	size_t SocketTlsEncrypter::getRecordHeadroom() const noexcept
+	{
+		return 5 + (isAead() ? 8 : 16); // record header + explicit nonce or record IV
+	}
+
+	size_t SocketTlsEncrypter::getMaxRecordTailroom() const noexcept
+	{
+		return isAead()
+			? 16 // tag
+			: getMacLength() + 32 // MAC + padding
+			;
+	}
+
+	void SocketTlsEncrypter::encryptRecordInPlace(TlsContentType_t content_type, std::string& record) SOUP_EXCAL
+	{
+		constexpr auto cipher_bytes = 16;
+
+		const auto headroom = getRecordHeadroom();
+		const auto size = record.size() - headroom;
+
+		if (!isAead()) // AES-CBC
+		{
+			constexpr auto record_iv_length = 16;
+
+			auto mac = calculateMac(content_type, &record[headroom], size);
+			auto cont_with_mac_size = (size + mac.size());
+			auto aligned_in_len = ((((cont_with_mac_size + 1) / cipher_bytes) + 1) * cipher_bytes);
+			auto pad_len = static_cast<char>(aligned_in_len - cont_with_mac_size);
+
+			record.append(mac);
+			record.append((size_t)pad_len, (pad_len - 1));
+
+			auto iv = rand.vec_u8(record_iv_length);
+			memcpy(&record[5], iv.data(), iv.size());
+			aes::cbcEncrypt(
+				reinterpret_cast<uint8_t*>(&record[headroom]), record.size() - headroom,
+				cipher_key.data(), cipher_key.size(),
+				iv.data()
+			);
+		}
+		else // AES-GCM
+		{
+			constexpr auto record_iv_length = 8;
+
+			auto nonce_explicit = rand.vec_u8(record_iv_length);
+			auto iv = implicit_iv;
+			iv.insert(iv.end(), nonce_explicit.begin(), nonce_explicit.end());
+
+			auto ad = calculateMacBytes(content_type, size);
+
+			uint8_t tag[cipher_bytes];
+			auto& ctx = getGcmContext();
+			ctx.start(iv.data(), iv.size());
+			ctx.aad((const uint8_t*)ad.data(), ad.size());
+			ctx.encrypt(reinterpret_cast<uint8_t*>(&record[headroom]), size);
+			ctx.finish(tag);
+
+			record.append(reinterpret_cast<const char*>(tag), cipher_bytes);
+			memcpy(&record[5], nonce_explicit.data(), nonce_explicit.size());
+		}
+
+		TlsRecord header{};
+		header.content_type = content_type;
+		header.length = static_cast<uint16_t>(record.size() - 5);
+		record[0] = static_cast<char>(header.content_type);
+		record[1] = static_cast<char>(header.version.major);
+		record[2] = static_cast<char>(header.version.minor);
+		record[3] = static_cast<char>(header.length >> 8);
+		record[4] = static_cast<char>(header.length & 0xFF);
+	}
+
 	void SocketTlsEncrypter::reset() noexcept
 	{
 		seq_num = 0;
 		cipher_key.clear();
 		mac_key.clear();
+		gcm.reset();
 	}
 }
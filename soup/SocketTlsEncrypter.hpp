@@ -6,7 +6,9 @@
 #include "base.hpp"
 #include "type.hpp"
 
+#include "aes.hpp"
 #include "Buffer.hpp"
+#include "UniquePtr.hpp"
 
 NAMESPACE_SOUP
 {
@@ -16,6 +18,7 @@ NAMESPACE_SOUP
 		std::vector<uint8_t> cipher_key;
 		std::string mac_key;
 		std::vector<uint8_t> implicit_iv;
+		UniquePtr<aes::GcmContext> gcm{}; // Created from cipher_key on first use, so the key schedule & GHASH tables are computed once per connection.
 
 		[[nodiscard]] bool isActive() const noexcept
 		{
@@ -27,6 +30,8 @@ NAMESPACE_SOUP
 			return !implicit_iv.empty();
 		}
 
+		[[nodiscard]] aes::GcmContext& getGcmContext() SOUP_EXCAL;
+
 		[[nodiscard]] size_t getMacLength() const noexcept;
 		[[nodiscard]] std::string calculateMacBytes(TlsContentType_t content_type, size_t content_length) SOUP_EXCAL;
 		[[nodiscard]] std::string calculateMac(TlsContentType_t content_type, const std::string& content) SOUP_EXCAL { return calculateMac(content_type, content.data(), content.size()); }
@@ -34,6 +39,12 @@ NAMESPACE_SOUP
 
 		[[nodiscard]] Buffer encrypt(TlsContentType_t content_type, const void* data, size_t size) SOUP_EXCAL;
 
+		// To encrypt a record in place, it should consist of getRecordHeadroom() bytes followed by the plaintext,
+		// with at least getMaxRecordTailroom() bytes of extra capacity reserved so it doesn't need to be reallocated.
+		[[nodiscard]] size_t getRecordHeadroom() const noexcept;
+		[[nodiscard]] size_t getMaxRecordTailroom() const noexcept;
+		void encryptRecordInPlace(TlsContentType_t content_type, std::string& record) SOUP_EXCAL;
+
 		void reset() noexcept;
 	};
 }
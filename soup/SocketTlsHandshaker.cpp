@@ -6,6 +6,7 @@
 #include "sha256.hpp"
 #include "sha384.hpp"
 #include "TlsHandshake.hpp"
+#include "time.hpp"
 
 NAMESPACE_SOUP
 {
@@ -55,6 +56,30 @@ NAMESPACE_SOUP
 		return master_secret;
 	}
 
+	void SocketTlsHandshaker::storeClientSession() SOUP_EXCAL
+	{
+		if (session_cache_key.empty())
+		{
+			return;
+		}
+		if (session.session_id.empty()
+			&& session.ticket.empty()
+			)
+		{
+			// The server doesn't support resumption.
+			TlsSessionCache::client().erase(session_cache_key);
+			return;
+		}
+		if (!resumed)
+		{
+			session.master_secret = getMasterSecret();
+			session.cipher_suite = cipher_suite;
+			session.extended_master_secret = extended_master_secret;
+			session.created = time::unixSeconds();
+		}
+		TlsSessionCache::client().store(session_cache_key, std::move(session));
+	}
+
 	void SocketTlsHandshaker::getKeys(std::string& client_write_mac, std::string& server_write_mac, std::vector<uint8_t>& client_write_key, std::vector<uint8_t>& server_write_key, std::vector<uint8_t>& client_write_iv, std::vector<uint8_t>& server_write_iv) SOUP_EXCAL
 	{
 		size_t mac_key_length = 20; // SHA1 = 20, SHA256 = 32
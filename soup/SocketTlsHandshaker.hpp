@@ -11,6 +11,7 @@
 #include "SharedPtr.hpp"
 #include "SocketTlsEncrypter.hpp"
 #include "TlsCipherSuite.hpp"
+#include "TlsSessionCache.hpp"
 #include "X509Certchain.hpp"
 #include "X509Certificate.hpp"
 
@@ -32,13 +33,20 @@ NAMESPACE_SOUP
 		std::string pre_master_secret{};
 		std::string master_secret{};
 		std::string expected_finished_verify_data{};
+		TlsSession session{}; // client: the session offered for resumption, then the one established. server: the session being resumed.
+		bool resumed = false;
+		bool session_ticket = false; // client: the server will send a NewSessionTicket. server: the client supports session tickets.
+		SocketTlsEncrypter pending_send_encrypter; // Keys derived before our ChangeCipherSpec is sent.
+		SocketTlsEncrypter pending_recv_encrypter;
 
 		// client
 		X509Certchain certchain{};
 		std::string server_name{};
+		std::string session_cache_key{}; // Empty if the session is not to be cached.
 		std::string ecdhe_public_key{};
 		std::string initial_application_data{};
-		SocketTlsEncrypter pending_recv_encrypter;
+
+		void storeClientSession() SOUP_EXCAL;
 
 		// server
 		SharedPtr<CertStore> certstore;
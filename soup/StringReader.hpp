@@ -61,6 +61,15 @@ NAMESPACE_SOUP
 			offset = data.size();
 		}
 
+		[[nodiscard]] const uint8_t* getSpan(size_t pos, size_t len) noexcept final
+		{
+			SOUP_IF_UNLIKELY (pos > data.size() || len > data.size() - pos)
+			{
+				return nullptr;
+			}
+			return reinterpret_cast<const uint8_t*>(data.data()) + pos;
+		}
+
 		// Faster alternative to std::stringstream + std::getline
 		bool getLine(std::string& line) SOUP_EXCAL final
 		{
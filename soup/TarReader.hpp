@@ -18,10 +18,20 @@ NAMESPACE_SOUP
 
 		[[nodiscard]] std::string getFileContents(const TarIndexedFile& file) const SOUP_EXCAL
 		{
+			if (const uint8_t* data = getFileData(file))
+			{
+				return std::string(reinterpret_cast<const char*>(data), file.size);
+			}
 			r.seek(file.offset);
 			std::string res(file.size, '\0');
 			r.raw(res.data(), file.size);
 			return res;
 		}
+
+		// Zero-copy access to a file's contents, if the Reader is backed by memory, e.g. MappedFileReader. Returns nullptr otherwise.
+		[[nodiscard]] const uint8_t* getFileData(const TarIndexedFile& file) const noexcept
+		{
+			return r.getSpan(file.offset, file.size);
+		}
 	};
 }
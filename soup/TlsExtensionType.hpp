@@ -12,7 +12,9 @@ NAMESPACE_SOUP
 		elliptic_curves = 10,
 		ec_point_formats = 11,
 		signature_algorithms = 13,
+		application_layer_protocol_negotiation = 16,
 		extended_master_secret = 23,
+		session_ticket = 35,
 		supported_versions = 43,
 	);
 
@@ -12,6 +12,7 @@ NAMESPACE_SOUP
 			hello_request = 0,
 			client_hello = 1,
 			server_hello = 2,
+			new_session_ticket = 4,
 			certificate = 11,
 			server_key_exchange = 12,
 			certificate_request = 13,
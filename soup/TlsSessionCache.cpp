@@ -0,0 +1,152 @@
+#include "TlsSessionCache.hpp"
+
+#include <mutex> // lock_guard
+
+#include "aes.hpp"
+#include "HardwareRng.hpp"
+#include "StringReader.hpp"
+#include "StringWriter.hpp"
+#include "time.hpp"
+
+NAMESPACE_SOUP
+{
+	static constexpr size_t TICKET_IV_SIZE = 12;
+	static constexpr size_t TICKET_TAG_SIZE = 16;
+
+	TlsSessionCache::TlsSessionCache() noexcept
+	{
+		FastHardwareRng::generate(ticket_key, sizeof(ticket_key));
+	}
+
+	TlsSessionCache& TlsSessionCache::client() noexcept
+	{
+		static TlsSessionCache inst;
+		return inst;
+	}
+
+	void TlsSessionCache::store(const std::string& key, TlsSession&& session) SOUP_EXCAL
+	{
+		std::lock_guard lock(mutex);
+		if (auto e = map.find(key); e != map.end())
+		{
+			e->second->second = std::move(session);
+			lru.splice(lru.begin(), lru, e->second);
+			return;
+		}
+		if (max_entries == 0)
+		{
+			return;
+		}
+		while (map.size() >= max_entries)
+		{
+			map.erase(lru.back().first);
+			lru.pop_back();
+		}
+		lru.emplace_front(key, std::move(session));
+		map.emplace(key, lru.begin());
+	}
+
+	Optional<TlsSession> TlsSessionCache::find(const std::string& key) SOUP_EXCAL
+	{
+		std::lock_guard lock(mutex);
+		if (auto e = map.find(key); e != map.end())
+		{
+			if (isExpired(e->second->second))
+			{
+				lru.erase(e->second);
+				map.erase(e);
+				return std::nullopt;
+			}
+			lru.splice(lru.begin(), lru, e->second);
+			return e->second->second;
+		}
+		return std::nullopt;
+	}
+
+	void TlsSessionCache::erase(const std::string& key) noexcept
+	{
+		std::lock_guard lock(mutex);
+		if (auto e = map.find(key); e != map.end())
+		{
+			lru.erase(e->second);
+			map.erase(e);
+		}
+	}
+
+	void TlsSessionCache::clear() noexcept
+	{
+		std::lock_guard lock(mutex);
+		map.clear();
+		lru.clear();
+	}
+
+	size_t TlsSessionCache::size() noexcept
+	{
+		std::lock_guard lock(mutex);
+		return map.size();
+	}
+
+	std::string TlsSessionCache::sealTicket(const TlsSession& session) const SOUP_EXCAL
+	{
+		StringWriter w;
+		uint16_t cipher_suite = session.cipher_suite;
+		uint8_t extended_master_secret = session.extended_master_secret;
+		uint64_t created = static_cast<uint64_t>(session.created);
+		w.u16be(cipher_suite);
+		w.u8(extended_master_secret);
+		w.u64be(created);
+		w.str_lp<u16be_t>(session.server_name);
+		w.str(session.master_secret.size(), session.master_secret);
+
+		uint8_t iv[TICKET_IV_SIZE];
+		FastHardwareRng::generate(iv, sizeof(iv));
+		uint8_t tag[TICKET_TAG_SIZE];
+		aes::gcmEncrypt(reinterpret_cast<uint8_t*>(w.data.data()), w.data.size(), nullptr, 0, ticket_key, sizeof(ticket_key), iv, sizeof(iv), tag);
+
+		std::string ticket(reinterpret_cast<const char*>(iv), sizeof(iv));
+		ticket.append(w.data);
+		ticket.append(reinterpret_cast<const char*>(tag), sizeof(tag));
+		return ticket;
+	}
+
+	Optional<TlsSession> TlsSessionCache::openTicket(const std::string& ticket) const SOUP_EXCAL
+	{
+		SOUP_IF_UNLIKELY (ticket.size() < TICKET_IV_SIZE + 2 + 1 + 8 + 2 + TICKET_TAG_SIZE)
+		{
+			return std::nullopt;
+		}
+		std::string data = ticket.substr(TICKET_IV_SIZE, ticket.size() - TICKET_IV_SIZE - TICKET_TAG_SIZE);
+		if (!aes::gcmDecrypt(reinterpret_cast<uint8_t*>(data.data()), data.size(), nullptr, 0, ticket_key, sizeof(ticket_key), reinterpret_cast<const uint8_t*>(ticket.data()), TICKET_IV_SIZE, reinterpret_cast<const uint8_t*>(ticket.data() + ticket.size() - TICKET_TAG_SIZE)))
+		{
+			return std::nullopt;
+		}
+
+		TlsSession session;
+		StringReader r(std::move(data));
+		uint16_t cipher_suite = 0;
+		uint8_t extended_master_secret = 0;
+		uint64_t created = 0;
+		if (!r.u16be(cipher_suite)
+			|| !r.u8(extended_master_secret)
+			|| !r.u64be(created)
+			|| !r.str_lp<u16be_t>(session.server_name)
+			)
+		{
+			return std::nullopt;
+		}
+		r.str(r.getRemainingBytes(), session.master_secret);
+		session.cipher_suite = cipher_suite;
+		session.extended_master_secret = extended_master_secret;
+		session.created = static_cast<std::time_t>(created);
+		if (isExpired(session))
+		{
+			return std::nullopt;
+		}
+		return session;
+	}
+
+	bool TlsSessionCache::isExpired(const TlsSession& session) const noexcept
+	{
+		return time::unixSecondsSince(session.created) > lifetime;
+	}
+}
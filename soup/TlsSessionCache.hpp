@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <ctime>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "base.hpp"
+#include "type.hpp"
+
+#include "Mutex.hpp"
+#include "Optional.hpp"
+
+NAMESPACE_SOUP
+{
+	struct TlsSession
+	{
+		std::string session_id{}; // As assigned by the server. May be empty if only a ticket was issued.
+		std::string ticket{}; // Client-side: The session ticket issued by the server, if any.
+		std::string master_secret{};
+		std::string server_name{}; // Server-side: The SNI the session was established for. It may not be resumed for another. (RFC 6066 § 3)
+		TlsCipherSuite_t cipher_suite = 0;
+		bool extended_master_secret = false;
+		std::time_t created = 0;
+	};
+
+	// A bounded store of TLS sessions that can be resumed to skip the key exchange. Safe to share between threads.
+	// When max_entries is reached, the least recently used session is evicted.
+	class TlsSessionCache
+	{
+	public:
+		size_t max_entries = 1000;
+		unsigned int lifetime = 60 * 60 * 12; // Seconds after which a session is no longer resumed.
+
+		std::atomic<uint64_t> num_full_handshakes{ 0 };
+		std::atomic<uint64_t> num_resumed_handshakes{ 0 };
+
+	protected:
+		using list_t = std::list<std::pair<std::string, TlsSession>>;
+
+		Mutex mutex;
+		list_t lru{}; // Most recently used first.
+		std::unordered_map<std::string, list_t::iterator> map{};
+		uint8_t ticket_key[32];
+
+	public:
+		TlsSessionCache() noexcept;
+
+		// Used by Socket::enableCryptoClient, keyed by server name & port. Servers use the cache in their CertStore, keyed by session id.
+		[[nodiscard]] static TlsSessionCache& client() noexcept;
+
+		void store(const std::string& key, TlsSession&& session) SOUP_EXCAL;
+		[[nodiscard]] Optional<TlsSession> find(const std::string& key) SOUP_EXCAL; // Expired sessions are not returned.
+		void erase(const std::string& key) noexcept;
+		void clear() noexcept;
+		[[nodiscard]] size_t size() noexcept;
+
+		// Server-side: Session tickets (RFC 5077) hold the session encrypted with a key only known to this cache, so the server doesn't need to store it.
+		[[nodiscard]] std::string sealTicket(const TlsSession& session) const SOUP_EXCAL;
+		[[nodiscard]] Optional<TlsSession> openTicket(const std::string& ticket) const SOUP_EXCAL;
+
+	protected:
+		[[nodiscard]] bool isExpired(const TlsSession& session) const noexcept;
+	};
+}
@@ -0,0 +1,830 @@
+#include "WasmJit.hpp"
+
+#include <cstddef> // offsetof
+#include <cstring> // memcpy
+
+#include "CpuInfo.hpp"
+#include "memGuard.hpp"
+#include "wasm.hpp"
+#include "WasmOp.hpp"
+#include "x64.hpp"
+#include "x64Emitter.hpp"
+
+NAMESPACE_SOUP
+{
+#if SOUP_X86 && SOUP_BITS == 64
+#if SOUP_WINDOWS
+	static constexpr x64Register wasm_jit_args[] = { RC, RD, R8 };
+	static constexpr uint8_t wasm_jit_shadow_space = 0x20;
+#else
+	static constexpr x64Register wasm_jit_args[] = { DI, SI, RD };
+	static constexpr uint8_t wasm_jit_shadow_space = 0;
+#endif
+
+	// rbx = frame pointer, r12 = WasmScript*, r13 = WasmJit::Context*
+	static constexpr x64Register WASM_JIT_FP = RB;
+	static constexpr x64Register WASM_JIT_SCRIPT = R12;
+	static constexpr x64Register WASM_JIT_CTX = R13;
+
+	[[nodiscard]] static constexpr int32_t wasmJitSlot(uint32_t height) noexcept
+	{
+		return static_cast<int32_t>(height * sizeof(uint64_t));
+	}
+
+	[[nodiscard]] static uint8_t wasmJitAccessSize(uint16_t op) noexcept
+	{
+		switch (op)
+		{
+		case WASM_OP_I64_LOAD: case WASM_OP_F64_LOAD:
+		case WASM_OP_I64_STORE: case WASM_OP_F64_STORE:
+			return 8;
+
+		case WASM_OP_I32_LOAD: case WASM_OP_F32_LOAD: case WASM_OP_I64_LOAD32_S: case WASM_OP_I64_LOAD32_U:
+		case WASM_OP_I32_STORE: case WASM_OP_F32_STORE:
+			return 4;
+
+		case WASM_OP_I32_LOAD16_S: case WASM_OP_I32_LOAD16_U: case WASM_OP_I64_LOAD16_S: case WASM_OP_I64_LOAD16_U:
+		case WASM_OP_I32_STORE16:
+			return 2;
+		}
+		return 1;
+	}
+#endif
+
+	WasmJit::WasmJit(WasmScript& script) SOUP_EXCAL
+		: script(script)
+	{
+		entrypoints.resize(script.compiled.size(), NOT_COMPILED);
+#if SOUP_X86 && SOUP_BITS == 64
+		std::vector<uint8_t> out{};
+		std::vector<std::pair<uint32_t, uint32_t>> call_fixups{};
+		for (uint32_t i = 0; i != script.compiled.size(); ++i)
+		{
+			if (canCompile(i))
+			{
+				entrypoints[i] = 0;
+			}
+		}
+		for (uint32_t i = 0; i != script.compiled.size(); ++i)
+		{
+			if (entrypoints[i] != NOT_COMPILED)
+			{
+				entrypoints[i] = static_cast<uint32_t>(out.size());
+				SOUP_IF_UNLIKELY (!compileFunction(out, i, call_fixups))
+				{
+					// Other functions may already call this one directly, so give up on the whole script.
+					entrypoints.assign(entrypoints.size(), NOT_COMPILED);
+					return;
+				}
+			}
+		}
+		if (out.empty())
+		{
+			return;
+		}
+		x64Emitter a{ out };
+		for (const auto& fixup : call_fixups)
+		{
+			a.patch(fixup.first, entrypoints[fixup.second]);
+		}
+		code = memGuard::alloc(out.size(), memGuard::ACC_READ | memGuard::ACC_WRITE);
+		SOUP_IF_UNLIKELY (code == nullptr)
+		{
+			entrypoints.assign(entrypoints.size(), NOT_COMPILED);
+			return;
+		}
+		code_size = out.size();
+		memcpy(code, out.data(), out.size());
+		memGuard::setAllowedAccess(code, code_size, memGuard::ACC_READ | memGuard::ACC_EXEC);
+#endif
+	}
+
+	WasmJit::~WasmJit() noexcept
+	{
+		if (code != nullptr)
+		{
+			memGuard::free(code, code_size);
+		}
+	}
+
+	bool WasmJit::isSupported() noexcept
+	{
+#if SOUP_X86 && SOUP_BITS == 64
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	size_t WasmJit::getNumCompiledFunctions() const noexcept
+	{
+		size_t count = 0;
+		for (const auto& entrypoint : entrypoints)
+		{
+			count += (entrypoint != NOT_COMPILED);
+		}
+		return count;
+	}
+
+	bool WasmJit::canCompile(uint32_t function_index) const noexcept
+	{
+		const auto& fn = script.compiled[function_index];
+		if (fn.insns.empty())
+		{
+			return false;
+		}
+#if SOUP_X86
+		if (!CpuInfo::get().supportsPOPCNT())
+		{
+			for (const auto& insn : fn.insns)
+			{
+				if (insn.op == WASM_OP_I32_POPCNT)
+				{
+					return false;
+				}
+			}
+		}
+#endif
+		return true;
+	}
+
+	bool WasmJit::compileFunction(std::vector<uint8_t>& out, uint32_t function_index, std::vector<std::pair<uint32_t, uint32_t>>& call_fixups) const SOUP_EXCAL
+	{
+#if SOUP_X86 && SOUP_BITS == 64
+		constexpr uint32_t UNKNOWN = -1;
+
+		const auto& fn = script.compiled[function_index];
+		const auto script_memory = static_cast<int32_t>(reinterpret_cast<uintptr_t>(&script.memory) - reinterpret_cast<uintptr_t>(&script));
+		const auto script_memory_size = static_cast<int32_t>(reinterpret_cast<uintptr_t>(&script.memory_size) - reinterpret_cast<uintptr_t>(&script));
+		const auto num_imports = static_cast<uint32_t>(script.function_imports.size());
+
+		x64Emitter a{ out };
+		std::vector<uint32_t> insn_pos(fn.insns.size(), UNKNOWN);
+		std::vector<uint32_t> target_height(fn.insns.size(), UNKNOWN);
+		std::vector<std::pair<uint32_t, uint32_t>> branch_fixups{}; // rel32 position -> instruction index
+		std::vector<uint32_t> fail_fixups{};
+		std::vector<uint32_t> ret_fixups{};
+
+		auto setTarget = [&](uint32_t pc, uint32_t height) -> bool
+		{
+			SOUP_IF_UNLIKELY (pc >= fn.insns.size())
+			{
+				return false;
+			}
+			if (target_height[pc] == UNKNOWN)
+			{
+				target_height[pc] = height;
+				return true;
+			}
+			return target_height[pc] == height;
+		};
+		auto jumpTo = [&](uint32_t pc)
+		{
+			branch_fixups.emplace_back(a.jmp(), pc);
+		};
+		auto jumpToIf = [&](uint8_t cc, uint32_t pc)
+		{
+			branch_fixups.emplace_back(a.jcc(cc), pc);
+		};
+		auto failIf = [&](uint8_t cc)
+		{
+			fail_fixups.emplace_back(a.jcc(cc));
+		};
+		auto load = [&](x64Register reg, uint32_t height, bool w = true)
+		{
+			a.mem(0, w, 0x8B, reg, WASM_JIT_FP, wasmJitSlot(height)); // mov reg, [rbx + slot]
+		};
+		auto store = [&](x64Register reg, uint32_t height)
+		{
+			a.mem(0, true, 0x89, reg, WASM_JIT_FP, wasmJitSlot(height)); // mov [rbx + slot], reg
+		};
+		auto copy = [&](uint32_t from, uint32_t to, uint32_t n)
+		{
+			if (from != to)
+			{
+				for (uint32_t i = 0; i != n; ++i)
+				{
+					load(RA, from + i);
+					store(RA, to + i);
+				}
+			}
+		};
+		auto emitHelperCall = [&](const void* f, uint32_t height, uint64_t arg)
+		{
+			a.rr(0, true, 0x89, WASM_JIT_CTX, wasm_jit_args[0]); // mov arg0, r13
+			a.mem(0, true, 0x8D, wasm_jit_args[1], WASM_JIT_FP, wasmJitSlot(height)); // lea arg1, [rbx + slot]
+			a.movImm(wasm_jit_args[2], arg);
+			a.callAbs(f);
+			a.rr(0, false, 0x84, RA, RA); // test al, al
+			failIf(CC_E);
+		};
+		auto loadAddress = [&](uint32_t height, uint64_t offset, uint8_t size)
+		{
+			load(RA, height, script.memory64);
+			if (offset != 0)
+			{
+				if (offset <= 0x7FFF'FFFF)
+				{
+					a.rr(0, true, 0x81, 0, RA); a.u32(static_cast<uint32_t>(offset)); // add rax, imm32
+				}
+				else
+				{
+					a.movImm(RC, offset);
+					a.rr(0, true, 0x01, RC, RA); // add rax, rcx
+				}
+			}
+			if (!script.memory_guarded)
+			{
+				// Same bounds check as WasmScript::getMemory
+				a.mem(0, true, 0x8D, RC, RA, size); // lea rcx, [rax + size]
+				a.mem(0, true, 0x3B, RC, WASM_JIT_SCRIPT, script_memory_size); // cmp rcx, [r12 + memory_size]
+				failIf(CC_A);
+			}
+			a.mem(0, true, 0x03, RA, WASM_JIT_SCRIPT, script_memory); // add rax, [r12 + memory]
+		};
+
+		// Prologue
+		a.u8(0x53); // push rbx
+		a.u8(0x41); a.u8(0x54); // push r12
+		a.u8(0x41); a.u8(0x55); // push r13
+		if (wasm_jit_shadow_space != 0)
+		{
+			a.rr(0, true, 0x83, 5, SP); a.u8(wasm_jit_shadow_space); // sub rsp, imm8
+		}
+		a.rr(0, true, 0x89, wasm_jit_args[0], WASM_JIT_FP); // mov rbx, arg0
+		a.rr(0, true, 0x89, wasm_jit_args[1], WASM_JIT_CTX); // mov r13, arg1
+		a.mem(0, true, 0x8B, WASM_JIT_SCRIPT, WASM_JIT_CTX, offsetof(Context, script)); // mov r12, [r13 + script]
+		a.mem(0, true, 0x83, 5, WASM_JIT_CTX, offsetof(Context, depth_left)); a.u8(1); // sub qword [r13 + depth_left], 1
+		failIf(CC_B);
+		a.mem(0, true, 0x8D, RA, WASM_JIT_FP, wasmJitSlot(fn.max_height)); // lea rax, [rbx + max_height]
+		a.mem(0, true, 0x3B, RA, WASM_JIT_CTX, offsetof(Context, stack_end)); // cmp rax, [r13 + stack_end]
+		failIf(CC_A);
+		if (fn.num_locals != fn.num_params)
+		{
+			a.rr(0, false, 0x31, RA, RA); // xor eax, eax
+			if (fn.num_locals - fn.num_params <= 16)
+			{
+				for (uint32_t i = fn.num_params; i != fn.num_locals; ++i)
+				{
+					store(RA, i);
+				}
+			}
+			else
+			{
+				a.mem(0, true, 0x8D, RC, WASM_JIT_FP, wasmJitSlot(fn.num_params)); // lea rcx, [rbx + first]
+				a.mem(0, true, 0x8D, RD, WASM_JIT_FP, wasmJitSlot(fn.num_locals)); // lea rdx, [rbx + end]
+				const auto loop = a.pos();
+				a.mem(0, true, 0x89, RA, RC, 0); // mov [rcx], rax
+				a.rr(0, true, 0x83, 0, RC); a.u8(8); // add rcx, 8
+				a.rr(0, true, 0x39, RD, RC); // cmp rcx, rdx
+				a.patch(a.jcc(CC_B), loop);
+			}
+		}
+
+		// Body
+		uint32_t h = fn.num_locals;
+		bool reachable = true;
+		for (uint32_t pc = 0; pc != fn.insns.size(); ++pc)
+		{
+			if (target_height[pc] != UNKNOWN)
+			{
+				SOUP_IF_UNLIKELY (reachable && h != target_height[pc])
+				{
+					return false;
+				}
+				h = target_height[pc];
+				reachable = true;
+			}
+			insn_pos[pc] = a.pos();
+			if (!reachable)
+			{
+				continue;
+			}
+			target_height[pc] = h; // so backward branches can be checked
+
+			const auto& insn = fn.insns[pc];
+			switch (insn.op)
+			{
+			default:
+				return false;
+
+			case WASM_OP_UNREACHABLE:
+				fail_fixups.emplace_back(a.jmp());
+				reachable = false;
+				break;
+
+			case WASM_OP_JMP:
+				SOUP_RETHROW_FALSE(setTarget(insn.a, h));
+				jumpTo(insn.a);
+				reachable = false;
+				break;
+
+			case WASM_OP_BR:
+				SOUP_RETHROW_FALSE(setTarget(insn.a, static_cast<uint32_t>(insn.b) + insn.arity));
+				copy(h - insn.arity, static_cast<uint32_t>(insn.b), insn.arity);
+				jumpTo(insn.a);
+				reachable = false;
+				break;
+
+			case WASM_OP_BR_IF:
+				--h;
+				SOUP_RETHROW_FALSE(setTarget(insn.a, h));
+				load(RA, h, false);
+				a.rr(0, false, 0x85, RA, RA); // test eax, eax
+				jumpToIf(CC_NE, insn.a);
+				break;
+
+			case WASM_OP_BR_IF_ADJUST:
+				{
+					--h;
+					SOUP_RETHROW_FALSE(setTarget(insn.a, static_cast<uint32_t>(insn.b) + insn.arity));
+					load(RA, h, false);
+					a.rr(0, false, 0x85, RA, RA); // test eax, eax
+					const auto skip = a.jcc(CC_E);
+					copy(h - insn.arity, static_cast<uint32_t>(insn.b), insn.arity);
+					jumpTo(insn.a);
+					a.patch(skip, a.pos());
+				}
+				break;
+
+			case WASM_OP_BR_TABLE:
+				{
+					--h;
+					const auto default_index = static_cast<uint32_t>(insn.b);
+					load(RA, h, false);
+					a.u8(0x3D); a.u32(default_index); // cmp eax, imm32
+					a.u8(0x72); a.u8(5); // jb +5
+					a.u8(0xB8); a.u32(default_index); // mov eax, imm32
+					a.u8(0x48); a.u8(0x8D); a.u8(0x0D); // lea rcx, [rip + table]
+					const auto lea_disp = a.pos();
+					a.u32(0);
+					a.u8(0x48); a.u8(0x63); a.u8(0x04); a.u8(0x81); // movsxd rax, dword [rcx + rax * 4]
+					a.u8(0x48); a.u8(0x01); a.u8(0xC8); // add rax, rcx
+					a.u8(0xFF); a.u8(0xE0); // jmp rax
+					const auto table = a.pos();
+					a.patch(lea_disp, table);
+					for (uint32_t i = 0; i <= default_index; ++i)
+					{
+						a.u32(0);
+					}
+					for (uint32_t i = 0; i <= default_index; ++i)
+					{
+						const auto& bt = fn.br_tables[insn.a + i];
+						const auto stub = a.pos() - table;
+						memcpy(&out[table + i * 4], &stub, 4);
+						SOUP_RETHROW_FALSE(setTarget(bt.pc, bt.height + bt.arity));
+						copy(h - bt.arity, bt.height, bt.arity);
+						jumpTo(bt.pc);
+					}
+					reachable = false;
+				}
+				break;
+
+			case WASM_OP_IF:
+				--h;
+				SOUP_RETHROW_FALSE(setTarget(insn.a, h));
+				load(RA, h, false);
+				a.rr(0, false, 0x85, RA, RA); // test eax, eax
+				jumpToIf(CC_E, insn.a);
+				break;
+
+			case WASM_OP_RETURN:
+				copy(h - fn.num_results, 0, fn.num_results);
+				ret_fixups.emplace_back(a.jmp());
+				reachable = false;
+				break;
+
+			case WASM_OP_CALL:
+				{
+					const auto& type = script.types[script.functions[insn.a]];
+					if (entrypoints[insn.a] != NOT_COMPILED)
+					{
+						a.mem(0, true, 0x8D, wasm_jit_args[0], WASM_JIT_FP, wasmJitSlot(h - type.num_parameters)); // lea arg0, [rbx + slot]
+						a.rr(0, true, 0x89, WASM_JIT_CTX, wasm_jit_args[1]); // mov arg1, r13
+						a.u8(0xE8); a.u32(0); // call rel32
+						call_fixups.emplace_back(a.pos() - 4, insn.a);
+						a.rr(0, false, 0x84, RA, RA); // test al, al
+						failIf(CC_E);
+					}
+					else
+					{
+						emitHelperCall(reinterpret_cast<const void*>(&WasmJit::callHelper), h, insn.a + num_imports);
+					}
+					h = h - type.num_parameters + type.num_results;
+				}
+				break;
+
+			case WASM_OP_CALL_IMPORT:
+				{
+					const auto& type = script.types[script.function_imports[insn.a].type_index];
+					emitHelperCall(reinterpret_cast<const void*>(&WasmJit::callHelper), h, insn.a);
+					h = h - type.num_parameters + type.num_results;
+				}
+				break;
+
+			case WASM_OP_CALL_INDIRECT:
+				{
+					const auto& type = script.types[insn.a];
+					emitHelperCall(reinterpret_cast<const void*>(&WasmJit::callIndirectHelper), h, insn.a);
+					h = h - 1 - type.num_parameters + type.num_results;
+				}
+				break;
+
+			case WASM_OP_DROP:
+				--h;
+				break;
+
+			case WASM_OP_SELECT:
+				h -= 2;
+				load(RC, h + 1, false);
+				load(RA, h - 1);
+				load(RD, h);
+				a.rr(0, false, 0x85, RC, RC); // test ecx, ecx
+				a.rr(0, true, 0x0F'44, RA, RD); // cmovz rax, rdx
+				store(RA, h - 1);
+				break;
+
+			case WASM_OP_LOCAL_GET:
+				load(RA, insn.a);
+				store(RA, h);
+				++h;
+				break;
+
+			case WASM_OP_LOCAL_SET:
+				--h;
+				load(RA, h);
+				store(RA, insn.a);
+				break;
+
+			case WASM_OP_LOCAL_TEE:
+				load(RA, h - 1);
+				store(RA, insn.a);
+				break;
+
+			case WASM_OP_GLOBAL_GET:
+				a.movImm(RA, reinterpret_cast<uintptr_t>(&script.globals[insn.a]));
+				a.mem(0, false, 0x8B, RA, RA, 0); // mov eax, [rax]
+				store(RA, h);
+				++h;
+				break;
+
+			case WASM_OP_GLOBAL_SET:
+				--h;
+				load(RC, h, false);
+				a.movImm(RA, reinterpret_cast<uintptr_t>(&script.globals[insn.a]));
+				a.mem(0, false, 0x89, RC, RA, 0); // mov [rax], ecx
+				break;
+
+			case WASM_OP_CONST:
+				if (static_cast<int64_t>(insn.b) == static_cast<int32_t>(insn.b))
+				{
+					a.mem(0, true, 0xC7, 0, WASM_JIT_FP, wasmJitSlot(h)); a.u32(static_cast<uint32_t>(insn.b)); // mov qword [rbx + slot], imm32
+				}
+				else
+				{
+					a.movImm(RA, insn.b);
+					store(RA, h);
+				}
+				++h;
+				break;
+
+			case WASM_OP_MEMORY_SIZE:
+				a.mem(0, true, 0x8B, RA, WASM_JIT_SCRIPT, script_memory_size); // mov rax, [r12 + memory_size]
+				a.rr(0, true, 0xC1, 5, RA); a.u8(16); // shr rax, 16
+				store(RA, h);
+				++h;
+				break;
+
+			case WASM_OP_MEMORY_GROW:
+				emitHelperCall(reinterpret_cast<const void*>(&WasmJit::memoryGrowHelper), h, 0);
+				break;
+
+			case WASM_OP_I32_LOAD: case WASM_OP_F32_LOAD: case WASM_OP_I64_LOAD32_U:
+			case WASM_OP_I64_LOAD: case WASM_OP_F64_LOAD:
+			case WASM_OP_I32_LOAD8_S: case WASM_OP_I32_LOAD8_U: case WASM_OP_I64_LOAD8_U:
+			case WASM_OP_I32_LOAD16_S: case WASM_OP_I32_LOAD16_U: case WASM_OP_I64_LOAD16_U:
+			case WASM_OP_I64_LOAD8_S: case WASM_OP_I64_LOAD16_S: case WASM_OP_I64_LOAD32_S:
+				loadAddress(h - 1, insn.b, wasmJitAccessSize(insn.op));
+				switch (insn.op)
+				{
+				case WASM_OP_I32_LOAD: case WASM_OP_F32_LOAD: case WASM_OP_I64_LOAD32_U: a.mem(0, false, 0x8B, RA, RA, 0); break; // mov eax, [rax]
+				case WASM_OP_I64_LOAD: case WASM_OP_F64_LOAD: a.mem(0, true, 0x8B, RA, RA, 0); break; // mov rax, [rax]
+				case WASM_OP_I32_LOAD8_S: a.mem(0, false, 0x0F'BE, RA, RA, 0); break; // movsx eax, byte [rax]
+				case WASM_OP_I32_LOAD8_U: case WASM_OP_I64_LOAD8_U: a.mem(0, false, 0x0F'B6, RA, RA, 0); break; // movzx eax, byte [rax]
+				case WASM_OP_I32_LOAD16_S: a.mem(0, false, 0x0F'BF, RA, RA, 0); break; // movsx eax, word [rax]
+				case WASM_OP_I32_LOAD16_U: case WASM_OP_I64_LOAD16_U: a.mem(0, false, 0x0F'B7, RA, RA, 0); break; // movzx eax, word [rax]
+				case WASM_OP_I64_LOAD8_S: a.mem(0, true, 0x0F'BE, RA, RA, 0); break; // movsx rax, byte [rax]
+				case WASM_OP_I64_LOAD16_S: a.mem(0, true, 0x0F'BF, RA, RA, 0); break; // movsx rax, word [rax]
+				case WASM_OP_I64_LOAD32_S: a.mem(0, true, 0x63, RA, RA, 0); break; // movsxd rax, dword [rax]
+				}
+				store(RA, h - 1);
+				break;
+
+			case WASM_OP_I32_STORE: case WASM_OP_F32_STORE:
+			case WASM_OP_I64_STORE: case WASM_OP_F64_STORE:
+			case WASM_OP_I32_STORE8: case WASM_OP_I32_STORE16:
+				loadAddress(h - 2, insn.b, wasmJitAccessSize(insn.op));
+				load(RC, h - 1);
+				switch (insn.op)
+				{
+				case WASM_OP_I32_STORE: case WASM_OP_F32_STORE: a.mem(0, false, 0x89, RC, RA, 0); break; // mov [rax], ecx
+				case WASM_OP_I64_STORE: case WASM_OP_F64_STORE: a.mem(0, true, 0x89, RC, RA, 0); break; // mov [rax], rcx
+				case WASM_OP_I32_STORE8: a.mem(0, false, 0x88, RC, RA, 0); break; // mov [rax], cl
+				case WASM_OP_I32_STORE16: a.mem(0x66, false, 0x89, RC, RA, 0); break; // mov [rax], cx
+				}
+				h -= 2;
+				break;
+
+			case WASM_OP_I32_EQZ:
+			case WASM_OP_I64_EQZ:
+				load(RA, h - 1, insn.op == WASM_OP_I64_EQZ);
+				a.rr(0, insn.op == WASM_OP_I64_EQZ, 0x85, RA, RA); // test rax, rax
+				a.setcc(CC_E, RA);
+				a.rr(0, false, 0x0F'B6, RA, RA); // movzx eax, al
+				store(RA, h - 1);
+				break;
+
+			case WASM_OP_I32_POPCNT:
+				a.mem(0xF3, false, 0x0F'B8, RA, WASM_JIT_FP, wasmJitSlot(h - 1)); // popcnt eax, [rbx + slot]
+				store(RA, h - 1);
+				break;
+
+			case WASM_OP_I32_WRAP_I64:
+			case WASM_OP_I64_EXTEND_I32_U:
+				load(RA, h - 1, false);
+				store(RA, h - 1);
+				break;
+
+			case WASM_OP_I64_EXTEND_I32_S:
+				a.mem(0, true, 0x63, RA, WASM_JIT_FP, wasmJitSlot(h - 1)); // movsxd rax, dword [rbx + slot]
+				store(RA, h - 1);
+				break;
+
+#define WASM_JIT_ARITH(name, w, opcode) case WASM_OP_##name: --h; load(RA, h - 1, w); a.mem(0, w, opcode, RA, WASM_JIT_FP, wasmJitSlot(h)); store(RA, h - 1); break;
+			WASM_JIT_ARITH(I32_ADD, false, 0x03)
+			WASM_JIT_ARITH(I32_SUB, false, 0x2B)
+			WASM_JIT_ARITH(I32_MUL, false, 0x0F'AF)
+			WASM_JIT_ARITH(I32_AND, false, 0x23)
+			WASM_JIT_ARITH(I32_OR, false, 0x0B)
+			WASM_JIT_ARITH(I32_XOR, false, 0x33)
+			WASM_JIT_ARITH(I64_ADD, true, 0x03)
+			WASM_JIT_ARITH(I64_SUB, true, 0x2B)
+			WASM_JIT_ARITH(I64_MUL, true, 0x0F'AF)
+			WASM_JIT_ARITH(I64_AND, true, 0x23)
+			WASM_JIT_ARITH(I64_OR, true, 0x0B)
+			WASM_JIT_ARITH(I64_XOR, true, 0x33)
+#undef WASM_JIT_ARITH
+
+#define WASM_JIT_COMPARE(name, w, cc) case WASM_OP_##name: --h; load(RA, h - 1, w); a.mem(0, w, 0x3B, RA, WASM_JIT_FP, wasmJitSlot(h)); a.setcc(cc, RA); a.rr(0, false, 0x0F'B6, RA, RA); store(RA, h - 1); break;
+			WASM_JIT_COMPARE(I32_EQ, false, CC_E)
+			WASM_JIT_COMPARE(I32_NE, false, CC_NE)
+			WASM_JIT_COMPARE(I32_LT_S, false, CC_L)
+			WASM_JIT_COMPARE(I32_LT_U, false, CC_B)
+			WASM_JIT_COMPARE(I32_GT_S, false, CC_G)
+			WASM_JIT_COMPARE(I32_GT_U, false, CC_A)
+			WASM_JIT_COMPARE(I32_LE_S, false, CC_LE)
+			WASM_JIT_COMPARE(I32_LE_U, false, CC_BE)
+			WASM_JIT_COMPARE(I32_GE_S, false, CC_GE)
+			WASM_JIT_COMPARE(I32_GE_U, false, CC_AE)
+			WASM_JIT_COMPARE(I64_EQ, true, CC_E)
+			WASM_JIT_COMPARE(I64_NE, true, CC_NE)
+			WASM_JIT_COMPARE(I64_LT_S, true, CC_L)
+			WASM_JIT_COMPARE(I64_LT_U, true, CC_B)
+			WASM_JIT_COMPARE(I64_GT_S, true, CC_G)
+			WASM_JIT_COMPARE(I64_GT_U, true, CC_A)
+			WASM_JIT_COMPARE(I64_LE_S, true, CC_LE)
+			WASM_JIT_COMPARE(I64_LE_U, true, CC_BE)
+			WASM_JIT_COMPARE(I64_GE_S, true, CC_GE)
+			WASM_JIT_COMPARE(I64_GE_U, true, CC_AE)
+#undef WASM_JIT_COMPARE
+
+#define WASM_JIT_SHIFT(name, w, ext) case WASM_OP_##name: --h; load(RC, h, false); load(RA, h - 1, w); a.rr(0, w, 0xD3, ext, RA); store(RA, h - 1); break;
+			WASM_JIT_SHIFT(I32_SHL, false, 4)
+			WASM_JIT_SHIFT(I32_SHR_U, false, 5)
+			WASM_JIT_SHIFT(I32_SHR_S, false, 7)
+			WASM_JIT_SHIFT(I64_SHL, true, 4)
+			WASM_JIT_SHIFT(I64_SHR_U, true, 5)
+			WASM_JIT_SHIFT(I64_SHR_S, true, 7)
+#undef WASM_JIT_SHIFT
+
+			case WASM_OP_I32_DIV_S: case WASM_OP_I32_DIV_U: case WASM_OP_I32_REM_S: case WASM_OP_I32_REM_U:
+			case WASM_OP_I64_DIV_S: case WASM_OP_I64_DIV_U: case WASM_OP_I64_REM_S: case WASM_OP_I64_REM_U:
+				{
+					const bool w = (insn.op >= WASM_OP_I64_DIV_S);
+					const bool is_signed = (insn.op == WASM_OP_I32_DIV_S || insn.op == WASM_OP_I32_REM_S || insn.op == WASM_OP_I64_DIV_S || insn.op == WASM_OP_I64_REM_S);
+					const bool is_rem = (insn.op == WASM_OP_I32_REM_S || insn.op == WASM_OP_I32_REM_U || insn.op == WASM_OP_I64_REM_S || insn.op == WASM_OP_I64_REM_U);
+					--h;
+					load(RA, h - 1, w);
+					load(RC, h, w);
+					a.rr(0, w, 0x85, RC, RC); // test rcx, rcx
+					failIf(CC_E);
+					if (is_signed)
+					{
+						a.rr(0, w, 0x83, 7, RC); a.u8(0xFF); // cmp rcx, -1
+						const auto not_minus_one = a.jcc8(CC_NE);
+						uint32_t done = UNKNOWN;
+						if (is_rem)
+						{
+							// INT_MIN % -1 would fault, but the result is 0 for any dividend.
+							a.rr(0, false, 0x31, RD, RD); // xor edx, edx
+							done = a.jmp8();
+						}
+						else
+						{
+							// INT_MIN / -1 overflows, which is a trap in Wasm.
+							if (w)
+							{
+								a.movImm(RD, 0x8000'0000'0000'0000);
+								a.rr(0, true, 0x39, RD, RA); // cmp rax, rdx
+							}
+							else
+							{
+								a.u8(0x3D); a.u32(0x8000'0000); // cmp eax, imm32
+							}
+							failIf(CC_E);
+						}
+						a.patch8(not_minus_one);
+						if (w)
+						{
+							a.u8(0x48);
+						}
+						a.u8(0x99); // cdq/cqo
+						a.rr(0, w, 0xF7, 7, RC); // idiv rcx
+						if (done != UNKNOWN)
+						{
+							a.patch8(done);
+						}
+					}
+					else
+					{
+						a.rr(0, false, 0x31, RD, RD); // xor edx, edx
+						a.rr(0, w, 0xF7, 6, RC); // div rcx
+					}
+					store(is_rem ? RD : RA, h - 1);
+				}
+				break;
+
+#define WASM_JIT_FLOAT_ARITH(name, prefix, opcode) case WASM_OP_##name: --h; a.mem(prefix, false, 0x0F'10, 0, WASM_JIT_FP, wasmJitSlot(h - 1)); a.mem(prefix, false, opcode, 0, WASM_JIT_FP, wasmJitSlot(h)); a.mem(prefix, false, 0x0F'11, 0, WASM_JIT_FP, wasmJitSlot(h - 1)); break;
+			WASM_JIT_FLOAT_ARITH(F32_ADD, 0xF3, 0x0F'58)
+			WASM_JIT_FLOAT_ARITH(F32_SUB, 0xF3, 0x0F'5C)
+			WASM_JIT_FLOAT_ARITH(F32_MUL, 0xF3, 0x0F'59)
+			WASM_JIT_FLOAT_ARITH(F32_DIV, 0xF3, 0x0F'5E)
+			WASM_JIT_FLOAT_ARITH(F64_ADD, 0xF2, 0x0F'58)
+			WASM_JIT_FLOAT_ARITH(F64_SUB, 0xF2, 0x0F'5C)
+			WASM_JIT_FLOAT_ARITH(F64_MUL, 0xF2, 0x0F'59)
+			WASM_JIT_FLOAT_ARITH(F64_DIV, 0xF2, 0x0F'5E)
+#undef WASM_JIT_FLOAT_ARITH
+
+			case WASM_OP_F32_EQ: case WASM_OP_F32_NE: case WASM_OP_F32_LT: case WASM_OP_F32_GT: case WASM_OP_F32_LE: case WASM_OP_F32_GE:
+			case WASM_OP_F64_EQ: case WASM_OP_F64_NE: case WASM_OP_F64_LT: case WASM_OP_F64_GT: case WASM_OP_F64_LE: case WASM_OP_F64_GE:
+				{
+					const bool f64 = (insn.op >= WASM_OP_F64_EQ);
+					const uint16_t cmp = (f64 ? insn.op - WASM_OP_F64_EQ : insn.op - WASM_OP_F32_EQ); // eq, ne, lt, gt, le, ge
+					--h;
+					// ucomiss sets CF for "below", so lt and le are done as gt and ge with swapped operands.
+					const bool swap = (cmp == 2 || cmp == 4);
+					a.mem(f64 ? 0xF2 : 0xF3, false, 0x0F'10, 0, WASM_JIT_FP, wasmJitSlot(swap ? h : h - 1)); // movss xmm0, [x]
+					a.mem(f64 ? 0x66 : 0, false, 0x0F'2E, 0, WASM_JIT_FP, wasmJitSlot(swap ? h - 1 : h)); // ucomiss xmm0, [y]
+					switch (cmp)
+					{
+					case 0: // eq: ZF=1 and PF=0
+						a.setcc(CC_E, RA);
+						a.setcc(CC_NP, RC);
+						a.rr(0, false, 0x20, RC, RA); // and al, cl
+						break;
+
+					case 1: // ne: ZF=0 or PF=1
+						a.setcc(CC_NE, RA);
+						a.setcc(CC_P, RC);
+						a.rr(0, false, 0x08, RC, RA); // or al, cl
+						break;
+
+					case 2: case 3: // lt, gt
+						a.setcc(CC_A, RA);
+						break;
+
+					case 4: case 5: // le, ge
+						a.setcc(CC_AE, RA);
+						break;
+					}
+					a.rr(0, false, 0x0F'B6, RA, RA); // movzx eax, al
+					store(RA, h - 1);
+				}
+				break;
+			}
+
+			SOUP_IF_UNLIKELY (reachable && (h < fn.num_locals || h > fn.max_height))
+			{
+				return false;
+			}
+		}
+
+		// Epilogue
+		const auto ret = a.pos();
+		a.u8(0xB8); a.u32(1); // mov eax, 1
+		const auto common = a.jmp8();
+		const auto fail = a.pos();
+		a.rr(0, false, 0x31, RA, RA); // xor eax, eax
+		a.patch8(common);
+		a.mem(0, true, 0x83, 0, WASM_JIT_CTX, offsetof(Context, depth_left)); a.u8(1); // add qword [r13 + depth_left], 1
+		if (wasm_jit_shadow_space != 0)
+		{
+			a.rr(0, true, 0x83, 0, SP); a.u8(wasm_jit_shadow_space); // add rsp, imm8
+		}
+		a.u8(0x41); a.u8(0x5D); // pop r13
+		a.u8(0x41); a.u8(0x5C); // pop r12
+		a.u8(0x5B); // pop rbx
+		a.u8(0xC3); // ret
+
+		for (const auto& fixup : branch_fixups)
+		{
+			SOUP_IF_UNLIKELY (insn_pos[fixup.second] == UNKNOWN)
+			{
+				return false;
+			}
+			a.patch(fixup.first, insn_pos[fixup.second]);
+		}
+		for (const auto& fixup : fail_fixups)
+		{
+			a.patch(fixup, fail);
+		}
+		for (const auto& fixup : ret_fixups)
+		{
+			a.patch(fixup, ret);
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool WasmJit::callHelper(Context* ctx, WasmValue* sp, uint64_t function_index) noexcept
+	{
+		SOUP_TRY
+		{
+			WasmScript& script = *ctx->script;
+			uint32_t type_index;
+			if (function_index < script.function_imports.size())
+			{
+				SOUP_IF_UNLIKELY (script.function_imports[function_index].ptr == nullptr)
+				{
+					return false;
+				}
+				type_index = script.function_imports[function_index].type_index;
+			}
+			else
+			{
+				type_index = script.functions[function_index - script.function_imports.size()];
+			}
+			return ctx->vm->callViaStack(sp, type_index, static_cast<uint32_t>(function_index));
+		}
+		SOUP_CATCH_ANY
+		{
+		}
+		return false;
+	}
+
+	bool WasmJit::callIndirectHelper(Context* ctx, WasmValue* sp, uint64_t type_index) noexcept
+	{
+		SOUP_TRY
+		{
+			WasmScript& script = *ctx->script;
+			--sp;
+			const auto element_index = static_cast<uint32_t>(sp->i32);
+			SOUP_IF_UNLIKELY (element_index >= script.elements.size())
+			{
+				return false;
+			}
+			uint32_t function_index = script.elements[element_index];
+			SOUP_IF_UNLIKELY (function_index < script.function_imports.size())
+			{
+				return false;
+			}
+			function_index -= static_cast<uint32_t>(script.function_imports.size());
+			SOUP_IF_UNLIKELY (function_index >= script.functions.size()
+				|| script.functions[function_index] != type_index
+				)
+			{
+				return false;
+			}
+			if (script.jit && script.jit->isCompiled(function_index))
+			{
+				return script.jit->getFunction(function_index)(sp - script.types[type_index].num_parameters, ctx);
+			}
+			return ctx->vm->callViaStack(sp, static_cast<uint32_t>(type_index), function_index + static_cast<uint32_t>(script.function_imports.size()));
+		}
+		SOUP_CATCH_ANY
+		{
+		}
+		return false;
+	}
+
+	bool WasmJit::memoryGrowHelper(Context* ctx, WasmValue* sp, uint64_t) noexcept
+	{
+		WasmScript& script = *ctx->script;
+		const size_t delta = (script.memory64 ? static_cast<uint64_t>(sp[-1].i64) : static_cast<uint32_t>(sp[-1].i32));
+		const size_t res = script.growMemory(delta);
+		sp[-1] = (script.memory64 ? WasmValue(static_cast<uint64_t>(res)) : WasmValue(static_cast<uint32_t>(res)));
+		return true;
+	}
+}
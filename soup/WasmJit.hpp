@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef> // size_t
+#include <cstdint>
+#include <utility> // pair
+#include <vector>
+
+#include "base.hpp"
+
+NAMESPACE_SOUP
+{
+	union WasmValue;
+	struct WasmScript;
+	class WasmVm;
+
+	// Single-pass baseline compiler from the pre-decoded functions of a WasmScript to x86-64 machine code.
+	// Every Wasm stack slot lives in memory at a statically known offset from the frame pointer, so no register allocation is needed.
+	// Functions it can't translate are left to the interpreter.
+	class WasmJit
+	{
+	public:
+		struct Context
+		{
+			WasmScript* script;
+			WasmVm* vm;
+			const WasmValue* stack_end;
+			size_t depth_left;
+		};
+
+		// Parameters are expected in fp[0..num_params), results are left in fp[0..num_results).
+		using func_t = bool(*)(WasmValue* fp, Context* ctx);
+
+		static constexpr uint32_t NOT_COMPILED = -1;
+		static constexpr size_t MAX_CALL_DEPTH = 0x1'000;
+
+		WasmScript& script;
+		void* code = nullptr;
+		size_t code_size = 0;
+		std::vector<uint32_t> entrypoints{}; // parallel to script.code; offset into code, or NOT_COMPILED
+
+		// Compiles all functions in script.compiled it can. This is a no-op on anything but x86-64.
+		WasmJit(WasmScript& script) SOUP_EXCAL;
+		~WasmJit() noexcept;
+
+		WasmJit(const WasmJit&) = delete;
+		WasmJit& operator=(const WasmJit&) = delete;
+
+		[[nodiscard]] static bool isSupported() noexcept;
+
+		[[nodiscard]] bool isCompiled(uint32_t function_index) const noexcept
+		{
+			return function_index < entrypoints.size() && entrypoints[function_index] != NOT_COMPILED;
+		}
+
+		[[nodiscard]] func_t getFunction(uint32_t function_index) const noexcept
+		{
+			return reinterpret_cast<func_t>(reinterpret_cast<uintptr_t>(code) + entrypoints[function_index]);
+		}
+
+		[[nodiscard]] size_t getNumCompiledFunctions() const noexcept;
+
+	protected:
+		[[nodiscard]] bool canCompile(uint32_t function_index) const noexcept;
+		[[nodiscard]] bool compileFunction(std::vector<uint8_t>& out, uint32_t function_index, std::vector<std::pair<uint32_t, uint32_t>>& call_fixups) const SOUP_EXCAL;
+
+		// Called from generated code, so these must not throw.
+		static bool callHelper(Context* ctx, WasmValue* sp, uint64_t function_index) noexcept;
+		static bool callIndirectHelper(Context* ctx, WasmValue* sp, uint64_t type_index) noexcept;
+		static bool memoryGrowHelper(Context* ctx, WasmValue* sp, uint64_t) noexcept;
+	};
+}
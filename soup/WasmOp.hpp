@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+
+#include "base.hpp"
+
+// Instructions of WasmScript::CompiledFunction. The numeric and memory ones map 1:1 to a Wasm opcode.
+#define WASM_CONTROL_OPS(X) \
+	X(UNREACHABLE) \
+	X(JMP) \
+	X(BR) \
+	X(BR_IF) \
+	X(BR_IF_ADJUST) \
+	X(BR_TABLE) \
+	X(IF) \
+	X(RETURN) \
+	X(CALL) \
+	X(CALL_IMPORT) \
+	X(CALL_INDIRECT) \
+	X(DROP) \
+	X(SELECT) \
+	X(LOCAL_GET) \
+	X(LOCAL_SET) \
+	X(LOCAL_TEE) \
+	X(GLOBAL_GET) \
+	X(GLOBAL_SET) \
+	X(CONST) \
+	X(MEMORY_SIZE) \
+	X(MEMORY_GROW)
+
+#define WASM_LOAD_OPS(X) \
+	X(I32_LOAD, 0x28) \
+	X(I64_LOAD, 0x29) \
+	X(F32_LOAD, 0x2a) \
+	X(F64_LOAD, 0x2b) \
+	X(I32_LOAD8_S, 0x2c) \
+	X(I32_LOAD8_U, 0x2d) \
+	X(I32_LOAD16_S, 0x2e) \
+	X(I32_LOAD16_U, 0x2f) \
+	X(I64_LOAD8_S, 0x30) \
+	X(I64_LOAD8_U, 0x31) \
+	X(I64_LOAD16_S, 0x32) \
+	X(I64_LOAD16_U, 0x33) \
+	X(I64_LOAD32_S, 0x34) \
+	X(I64_LOAD32_U, 0x35)
+
+#define WASM_STORE_OPS(X) \
+	X(I32_STORE, 0x36) \
+	X(I64_STORE, 0x37) \
+	X(F32_STORE, 0x38) \
+	X(F64_STORE, 0x39) \
+	X(I32_STORE8, 0x3a) \
+	X(I32_STORE16, 0x3b)
+
+#define WASM_UNARY_OPS(X) \
+	X(I32_EQZ, 0x45) \
+	X(I64_EQZ, 0x50) \
+	X(I32_POPCNT, 0x69) \
+	X(I32_WRAP_I64, 0xa7) \
+	X(I64_EXTEND_I32_S, 0xac) \
+	X(I64_EXTEND_I32_U, 0xad)
+
+#define WASM_BINARY_OPS(X) \
+	X(I32_EQ, 0x46) \
+	X(I32_NE, 0x47) \
+	X(I32_LT_S, 0x48) \
+	X(I32_LT_U, 0x49) \
+	X(I32_GT_S, 0x4a) \
+	X(I32_GT_U, 0x4b) \
+	X(I32_LE_S, 0x4c) \
+	X(I32_LE_U, 0x4d) \
+	X(I32_GE_S, 0x4e) \
+	X(I32_GE_U, 0x4f) \
+	X(I64_EQ, 0x51) \
+	X(I64_NE, 0x52) \
+	X(I64_LT_S, 0x53) \
+	X(I64_LT_U, 0x54) \
+	X(I64_GT_S, 0x55) \
+	X(I64_GT_U, 0x56) \
+	X(I64_LE_S, 0x57) \
+	X(I64_LE_U, 0x58) \
+	X(I64_GE_S, 0x59) \
+	X(I64_GE_U, 0x5a) \
+	X(F32_EQ, 0x5b) \
+	X(F32_NE, 0x5c) \
+	X(F32_LT, 0x5d) \
+	X(F32_GT, 0x5e) \
+	X(F32_LE, 0x5f) \
+	X(F32_GE, 0x60) \
+	X(F64_EQ, 0x61) \
+	X(F64_NE, 0x62) \
+	X(F64_LT, 0x63) \
+	X(F64_GT, 0x64) \
+	X(F64_LE, 0x65) \
+	X(F64_GE, 0x66) \
+	X(I32_ADD, 0x6a) \
+	X(I32_SUB, 0x6b) \
+	X(I32_MUL, 0x6c) \
+	X(I32_DIV_S, 0x6d) \
+	X(I32_DIV_U, 0x6e) \
+	X(I32_REM_S, 0x6f) \
+	X(I32_REM_U, 0x70) \
+	X(I32_AND, 0x71) \
+	X(I32_OR, 0x72) \
+	X(I32_XOR, 0x73) \
+	X(I32_SHL, 0x74) \
+	X(I32_SHR_S, 0x75) \
+	X(I32_SHR_U, 0x76) \
+	X(I64_ADD, 0x7c) \
+	X(I64_SUB, 0x7d) \
+	X(I64_MUL, 0x7e) \
+	X(I64_DIV_S, 0x7f) \
+	X(I64_DIV_U, 0x80) \
+	X(I64_REM_S, 0x81) \
+	X(I64_REM_U, 0x82) \
+	X(I64_AND, 0x83) \
+	X(I64_OR, 0x84) \
+	X(I64_XOR, 0x85) \
+	X(I64_SHL, 0x86) \
+	X(I64_SHR_S, 0x87) \
+	X(I64_SHR_U, 0x88) \
+	X(F32_ADD, 0x92) \
+	X(F32_SUB, 0x93) \
+	X(F32_MUL, 0x94) \
+	X(F32_DIV, 0x95) \
+	X(F64_ADD, 0xa0) \
+	X(F64_SUB, 0xa1) \
+	X(F64_MUL, 0xa2) \
+	X(F64_DIV, 0xa3)
+
+#define WASM_ALL_OPS(X) WASM_CONTROL_OPS(X) WASM_LOAD_OPS(X) WASM_STORE_OPS(X) WASM_UNARY_OPS(X) WASM_BINARY_OPS(X)
+
+NAMESPACE_SOUP
+{
+	enum WasmOp : uint16_t
+	{
+#define WASM_OP_ENUM(name, ...) WASM_OP_##name,
+		WASM_ALL_OPS(WASM_OP_ENUM)
+#undef WASM_OP_ENUM
+	};
+}
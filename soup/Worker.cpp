@@ -17,6 +17,12 @@ NAMESPACE_SOUP
 			holdup_type = PROMISE_BASE;
 			holdup_callback.set(f, std::move(cap));
 			holdup_data = p;
+#if SOUP_LINUX
+			if (type == WORKER_TYPE_SOCKET)
+			{
+				static_cast<Socket*>(this)->epollMarkDirty();
+			}
+#endif
 		}
 	}
 
@@ -31,6 +37,12 @@ NAMESPACE_SOUP
 			holdup_type = PROMISE_VOID;
 			holdup_callback.set(f, std::move(cap));
 			holdup_data = p;
+#if SOUP_LINUX
+			if (type == WORKER_TYPE_SOCKET)
+			{
+				static_cast<Socket*>(this)->epollMarkDirty();
+			}
+#endif
 		}
 	}
 
@@ -40,6 +40,7 @@ NAMESPACE_SOUP
 		uint8_t type;
 		uint8_t recursions = 0;
 		HoldupType holdup_type = NONE;
+		uint32_t deadline_index = -1; // Managed by the Scheduler. A worker must not be moved while it has a deadline armed.
 		Callback<void(Worker&)> holdup_callback;
 		void* holdup_data;
 
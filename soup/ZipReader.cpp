@@ -1,5 +1,7 @@
 #include "ZipReader.hpp"
 
+#include <cstring> // memcmp
+
 #include "deflate.hpp"
 #include "Exception.hpp"
 #include "Reader.hpp"
@@ -20,14 +22,25 @@ NAMESPACE_SOUP
 			return 0;
 		}
 		size_t eocd_offset = (length - 22);
-		for (; eocd_offset != 0; --eocd_offset)
+		if (const uint8_t* data = is.getSpan(0, length))
 		{
-			is.seek(eocd_offset);
-			std::string bytes;
-			is.str(4, bytes);
-			if (bytes == "\x50\x4b\x05\x06")
+			while (eocd_offset != 0 && memcmp(data + eocd_offset, "\x50\x4b\x05\x06", 4) != 0)
 			{
-				break;
+				--eocd_offset;
+			}
+			is.seek(eocd_offset + 4);
+		}
+		else
+		{
+			for (; eocd_offset != 0; --eocd_offset)
+			{
+				is.seek(eocd_offset);
+				std::string bytes;
+				is.str(4, bytes);
+				if (bytes == "\x50\x4b\x05\x06")
+				{
+					break;
+				}
 			}
 		}
 		if (eocd_offset != 0)
@@ -126,7 +139,14 @@ NAMESPACE_SOUP
 				if (lfh.common.compression_method == 0)
 				{
 					// Store
-					is.str(lfh.common.compressed_size, ret);
+					if (const uint8_t* data = is.getSpan(is.getPosition(), lfh.common.compressed_size))
+					{
+						ret.assign(reinterpret_cast<const char*>(data), lfh.common.compressed_size);
+					}
+					else
+					{
+						is.str(lfh.common.compressed_size, ret);
+					}
 				}
 				else if (lfh.common.compression_method == 8)
 				{
@@ -141,8 +161,15 @@ NAMESPACE_SOUP
 						}
 						lfh.common.compressed_size = compressed_size;
 					}
-					is.str(lfh.common.compressed_size, ret);
-					ret = deflate::decompress(ret, lfh.common.uncompressed_size).decompressed;
+					if (const uint8_t* data = is.getSpan(is.getPosition(), lfh.common.compressed_size))
+					{
+						ret = deflate::decompress(data, lfh.common.compressed_size, lfh.common.uncompressed_size, deflate::RAW).decompressed;
+					}
+					else
+					{
+						is.str(lfh.common.compressed_size, ret);
+						ret = deflate::decompress(ret.data(), ret.size(), lfh.common.uncompressed_size, deflate::RAW).decompressed;
+					}
 					if (ret.length() != lfh.common.uncompressed_size)
 					{
 						if (ret.empty())
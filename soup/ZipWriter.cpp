@@ -1,6 +1,7 @@
 #include "ZipWriter.hpp"
 
 #include "crc32.hpp"
+#include "deflate.hpp"
 #include "Writer.hpp"
 #include "ZipCentralDirectoryFile.hpp"
 #include "ZipEndOfCentralDirectory.hpp"
@@ -37,6 +38,16 @@ NAMESPACE_SOUP
 		return addFile(std::move(name), contents, 0, contents);
 	}
 
+	ZipIndexedFile ZipWriter::addFileCompressed(std::string name, const std::string& contents, int level) const
+	{
+		std::string compressed = deflate::compress(contents, level, deflate::RAW);
+		if (compressed.size() >= contents.size())
+		{
+			return addFileUncompressed(std::move(name), contents);
+		}
+		return addFile(std::move(name), contents, 8, compressed);
+	}
+
 	ZipIndexedFile ZipWriter::addFileAnticompressed(std::string name, const std::string& contents_uncompressed) const
 	{
 		std::string anti_compressed{};
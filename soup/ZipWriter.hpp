@@ -21,6 +21,7 @@ NAMESPACE_SOUP
 		ZipIndexedFile addFile(std::string name, const std::string& contents_uncompressed, uint16_t compression_method, const std::string& contents_compressed) const;
 	public:
 		ZipIndexedFile addFileUncompressed(std::string name, const std::string& contents) const;
+		ZipIndexedFile addFileCompressed(std::string name, const std::string& contents, int level = 6) const; // Falls back to storing if DEFLATE doesn't make it smaller.
 		ZipIndexedFile addFileAnticompressed(std::string name, const std::string& contents_uncompressed) const;
 
 		void finalise(const std::vector<ZipIndexedFile>& files) const;
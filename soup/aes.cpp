@@ -438,56 +438,24 @@ NAMESPACE_SOUP
 
 	void aes::gcmEncrypt(uint8_t* data, size_t data_len, const uint8_t* aadata, size_t aadata_len, const uint8_t* key, size_t key_len, const uint8_t* iv, size_t iv_len, uint8_t tag[16]) noexcept
 	{
-		const auto Nr = getNrFromKeyLen(key_len);
-		alignas(16) uint8_t roundKeys[240];
-		aes::expandKey(roundKeys, key, key_len);
-
-		uint8_t h[16];
-		calcH(h, roundKeys, Nr);
-
-		uint8_t j0[16];
-		calcJ0(j0, h, iv, iv_len);
-
-		// encrypt
-		{
-			uint8_t icb[16];
-			memcpy(icb, j0, 16);
-			inc32(icb);
-
-			gctr(data, data_len, roundKeys, Nr, icb);
-		}
-
-		calcGcmTag(tag, data, data_len, aadata, aadata_len, roundKeys, Nr, h, j0);
+		GcmContext ctx(key, key_len);
+		ctx.start(iv, iv_len);
+		ctx.aad(aadata, aadata_len);
+		ctx.encrypt(data, data_len);
+		ctx.finish(tag);
 	}
 
 	bool aes::gcmDecrypt(uint8_t* data, size_t data_len, const uint8_t* aadata, size_t aadata_len, const uint8_t* key, size_t key_len, const uint8_t* iv, size_t iv_len, const uint8_t tag[16]) noexcept
 	{
-		const auto Nr = getNrFromKeyLen(key_len);
-		alignas(16) uint8_t roundKeys[240];
-		aes::expandKey(roundKeys, key, key_len);
-
-		uint8_t h[16];
-		calcH(h, roundKeys, Nr);
-
-		uint8_t j0[16];
-		calcJ0(j0, h, iv, iv_len);
-
-		uint8_t ctag[16];
-		calcGcmTag(ctag, data, data_len, aadata, aadata_len, roundKeys, Nr, h, j0);
-		if (memcmp(ctag, tag, 16) != 0)
+		GcmContext ctx(key, key_len);
+		ctx.start(iv, iv_len);
+		ctx.aad(aadata, aadata_len);
+		ctx.authenticate(data, data_len);
+		if (!ctx.verify(tag))
 		{
 			return false;
 		}
-
-		// decrypt
-		{
-			uint8_t icb[16];
-			memcpy(icb, j0, 16);
-			inc32(icb);
-
-			gctr(data, data_len, roundKeys, Nr, icb);
-		}
-
+		ctx.applyKeystream(data, data_len);
 		return true;
 	}
 
@@ -1039,4 +1007,276 @@ NAMESPACE_SOUP
 		memcpy(tmp, res, 16);
 		mulBlocks(res, tmp, h);
 	}
+
+	// Reduction of the 4 bits shifted out per step, for the table-driven multiplication. (Shoup's method, as in "The Galois/Counter Mode of Operation", § 4.1)
+	static constexpr uint16_t gcm_last4[16] = {
+		0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+		0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+	};
+
+	aes::GcmContext::GcmContext(const uint8_t* key, size_t key_len) noexcept
+		: Nr(getNrFromKeyLen(key_len))
+	{
+		expandKey(round_keys, key, key_len);
+
+		alignas(16) uint8_t h[16]{};
+		encryptBlock(h, h, round_keys, Nr);
+
+#if AES_USE_INTRIN && SOUP_X86
+		clmul = (CpuInfo::get().supportsAESNI() && CpuInfo::get().supportsPCLMULQDQ() && CpuInfo::get().supportsSSSE3());
+		if (clmul)
+		{
+			intrin::gcm_init(h_powers, h);
+			return;
+		}
+#else
+		clmul = false;
+#endif
+
+		uint64_t vh = Endianness::invert(*reinterpret_cast<const uint64_t*>(&h[0])); static_assert(ENDIAN_NATIVE == ENDIAN_LITTLE);
+		uint64_t vl = Endianness::invert(*reinterpret_cast<const uint64_t*>(&h[8]));
+		h_table_hi[0] = 0;
+		h_table_lo[0] = 0;
+		h_table_hi[8] = vh;
+		h_table_lo[8] = vl;
+		for (int i = 4; i != 0; i >>= 1)
+		{
+			const uint64_t t = (vl & 1) * 0xe100000000000000;
+			vl = (vh << 63) | (vl >> 1);
+			vh = (vh >> 1) ^ t;
+			h_table_hi[i] = vh;
+			h_table_lo[i] = vl;
+		}
+		for (int i = 2; i <= 8; i *= 2)
+		{
+			for (int j = 1; j != i; ++j)
+			{
+				h_table_hi[i + j] = h_table_hi[i] ^ h_table_hi[j];
+				h_table_lo[i + j] = h_table_lo[i] ^ h_table_lo[j];
+			}
+		}
+	}
+
+	void aes::GcmContext::start(const uint8_t* iv, size_t iv_len) noexcept
+	{
+		memset(x, 0, 16);
+		ghash_buf_len = 0;
+		if (iv_len == 12)
+		{
+			memcpy(j0, iv, 12);
+			j0[12] = 0;
+			j0[13] = 0;
+			j0[14] = 0;
+			j0[15] = 1;
+		}
+		else
+		{
+			ghashBlocks(iv, iv_len / 16);
+			if (iv_len % 16)
+			{
+				memset(ghash_buf, 0, 16);
+				memcpy(ghash_buf, iv + (iv_len - (iv_len % 16)), iv_len % 16);
+				ghashBlocks(ghash_buf, 1);
+			}
+			memset(ghash_buf, 0, 8);
+			*reinterpret_cast<uint64_t*>(&ghash_buf[8]) = Endianness::invert(static_cast<uint64_t>(iv_len) * 8);
+			ghashBlocks(ghash_buf, 1);
+			memcpy(j0, x, 16);
+			memset(x, 0, 16);
+		}
+		memcpy(counter, j0, 16);
+		inc32(counter);
+		keystream_offset = 16;
+		aad_done = false;
+		aad_len = 0;
+		data_len = 0;
+	}
+
+	void aes::GcmContext::aad(const uint8_t* data, size_t size) noexcept
+	{
+		SOUP_DEBUG_ASSERT(!aad_done);
+		aad_len += size;
+		if (ghash_buf_len != 0)
+		{
+			while (ghash_buf_len != 16 && size != 0)
+			{
+				ghash_buf[ghash_buf_len++] = *data++;
+				--size;
+			}
+			if (ghash_buf_len != 16)
+			{
+				return;
+			}
+			ghashBlocks(ghash_buf, 1);
+			ghash_buf_len = 0;
+		}
+		ghashBlocks(data, size / 16);
+		memcpy(ghash_buf, data + (size - (size % 16)), size % 16);
+		ghash_buf_len = static_cast<uint8_t>(size % 16);
+	}
+
+	void aes::GcmContext::encrypt(uint8_t* data, size_t size) noexcept
+	{
+		// Working in chunks keeps the data in L1 between the two passes.
+		while (size != 0)
+		{
+			const size_t chunk = (size < 0x1000 ? size : 0x1000);
+			applyKeystream(data, chunk);
+			authenticate(data, chunk);
+			data += chunk;
+			size -= chunk;
+		}
+	}
+
+	void aes::GcmContext::decrypt(uint8_t* data, size_t size) noexcept
+	{
+		while (size != 0)
+		{
+			const size_t chunk = (size < 0x1000 ? size : 0x1000);
+			authenticate(data, chunk);
+			applyKeystream(data, chunk);
+			data += chunk;
+			size -= chunk;
+		}
+	}
+
+	void aes::GcmContext::finish(uint8_t tag[16]) noexcept
+	{
+		if (!aad_done)
+		{
+			padGhash();
+			aad_done = true;
+		}
+		padGhash();
+		*reinterpret_cast<uint64_t*>(&ghash_buf[0]) = Endianness::invert(aad_len * 8);
+		*reinterpret_cast<uint64_t*>(&ghash_buf[8]) = Endianness::invert(data_len * 8);
+		ghashBlocks(ghash_buf, 1);
+
+		encryptBlock(j0, tag, round_keys, Nr);
+		xorBlocks(tag, x);
+	}
+
+	bool aes::GcmContext::verify(const uint8_t tag[16]) noexcept
+	{
+		uint8_t ctag[16];
+		finish(ctag);
+		uint8_t diff = 0;
+		for (int i = 0; i != 16; ++i)
+		{
+			diff |= (ctag[i] ^ tag[i]);
+		}
+		return diff == 0;
+	}
+
+	void aes::GcmContext::authenticate(const uint8_t* ciphertext, size_t size) noexcept
+	{
+		if (!aad_done)
+		{
+			padGhash();
+			aad_done = true;
+		}
+		data_len += size;
+		if (ghash_buf_len != 0)
+		{
+			while (ghash_buf_len != 16 && size != 0)
+			{
+				ghash_buf[ghash_buf_len++] = *ciphertext++;
+				--size;
+			}
+			if (ghash_buf_len != 16)
+			{
+				return;
+			}
+			ghashBlocks(ghash_buf, 1);
+			ghash_buf_len = 0;
+		}
+		ghashBlocks(ciphertext, size / 16);
+		memcpy(ghash_buf, ciphertext + (size - (size % 16)), size % 16);
+		ghash_buf_len = static_cast<uint8_t>(size % 16);
+	}
+
+	void aes::GcmContext::applyKeystream(uint8_t* data, size_t size) noexcept
+	{
+		while (keystream_offset != 16 && size != 0)
+		{
+			*data++ ^= keystream[keystream_offset++];
+			--size;
+		}
+		if (const size_t num_blocks = size / 16; num_blocks != 0)
+		{
+#if AES_USE_INTRIN && SOUP_X86
+			if (clmul)
+			{
+				intrin::gcm_ctr(data, num_blocks, round_keys, Nr, counter);
+			}
+			else
+#endif
+			{
+				for (size_t i = 0; i != num_blocks; ++i)
+				{
+					encryptBlock(counter, keystream, round_keys, Nr);
+					xorBlocks(&data[i * 16], keystream);
+					inc32(counter);
+				}
+			}
+			data += num_blocks * 16;
+			size %= 16;
+		}
+		if (size != 0)
+		{
+			encryptBlock(counter, keystream, round_keys, Nr);
+			inc32(counter);
+			xorBlocks(data, keystream, static_cast<unsigned int>(size));
+			keystream_offset = static_cast<uint8_t>(size);
+		}
+	}
+
+	void aes::GcmContext::ghashBlocks(const uint8_t* data, size_t num_blocks) noexcept
+	{
+#if AES_USE_INTRIN && SOUP_X86
+		if (clmul)
+		{
+			if (num_blocks != 0)
+			{
+				intrin::gcm_ghash(x, h_powers, data, num_blocks);
+			}
+			return;
+		}
+#endif
+		for (; num_blocks != 0; --num_blocks, data += 16)
+		{
+			xorBlocks(x, data);
+
+			uint64_t zh = h_table_hi[x[15] & 0xf];
+			uint64_t zl = h_table_lo[x[15] & 0xf];
+			for (int i = 15; i >= 0; --i)
+			{
+				if (i != 15)
+				{
+					const auto rem = (zl & 0xf);
+					zl = (zh << 60) | (zl >> 4);
+					zh = (zh >> 4) ^ (static_cast<uint64_t>(gcm_last4[rem]) << 48);
+					zh ^= h_table_hi[x[i] & 0xf];
+					zl ^= h_table_lo[x[i] & 0xf];
+				}
+				const auto rem = (zl & 0xf);
+				zl = (zh << 60) | (zl >> 4);
+				zh = (zh >> 4) ^ (static_cast<uint64_t>(gcm_last4[rem]) << 48);
+				zh ^= h_table_hi[x[i] >> 4];
+				zl ^= h_table_lo[x[i] >> 4];
+			}
+			*reinterpret_cast<uint64_t*>(&x[0]) = Endianness::invert(zh);
+			*reinterpret_cast<uint64_t*>(&x[8]) = Endianness::invert(zl);
+		}
+	}
+
+	void aes::GcmContext::padGhash() noexcept
+	{
+		if (ghash_buf_len != 0)
+		{
+			memset(&ghash_buf[ghash_buf_len], 0, 16 - ghash_buf_len);
+			ghashBlocks(ghash_buf, 1);
+			ghash_buf_len = 0;
+		}
+	}
 }
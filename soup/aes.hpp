@@ -88,5 +88,46 @@ NAMESPACE_SOUP
 
 			void transform() noexcept;
 		};
+
+		// Reusable AES-GCM state for one key. The round keys and GHASH multiplication tables are computed once,
+		// and messages can be processed incrementally: start, aad (any number of times), encrypt/decrypt (any number of times), then finish or verify.
+		// Uses AES-NI & PCLMULQDQ where available.
+		struct GcmContext
+		{
+			alignas(16) uint8_t round_keys[240];
+			int Nr;
+			bool clmul;
+			alignas(16) uint8_t h_powers[8][16]; // clmul: H^1 to H^8, byte-reflected
+			uint64_t h_table_hi[16]; // otherwise: multiples of H for 4-bit lookups
+			uint64_t h_table_lo[16];
+
+			alignas(16) uint8_t j0[16];
+			alignas(16) uint8_t counter[16];
+			alignas(16) uint8_t x[16]; // GHASH accumulator
+			uint8_t ghash_buf[16];
+			uint8_t ghash_buf_len;
+			uint8_t keystream[16];
+			uint8_t keystream_offset; // 16 if no unused keystream bytes are left
+			bool aad_done;
+			uint64_t aad_len;
+			uint64_t data_len;
+
+			GcmContext(const uint8_t* key, size_t key_len) noexcept;
+
+			void start(const uint8_t* iv, size_t iv_len) noexcept;
+			void aad(const uint8_t* data, size_t size) noexcept;
+			void encrypt(uint8_t* data, size_t size) noexcept;
+			void decrypt(uint8_t* data, size_t size) noexcept;
+			void finish(uint8_t tag[16]) noexcept;
+			[[nodiscard]] bool verify(const uint8_t tag[16]) noexcept; // Constant-time comparison with the computed tag.
+
+			// Building blocks of encrypt & decrypt, e.g. to authenticate a message before decrypting it.
+			void authenticate(const uint8_t* ciphertext, size_t size) noexcept;
+			void applyKeystream(uint8_t* data, size_t size) noexcept;
+
+		protected:
+			void ghashBlocks(const uint8_t* data, size_t num_blocks) noexcept;
+			void padGhash() noexcept;
+		};
 	};
 }
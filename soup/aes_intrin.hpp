@@ -5,7 +5,11 @@
 #include <cstdint>
 
 #if SOUP_X86
+	#include <cstring> // memcpy
 	#include <wmmintrin.h>
+	#include <tmmintrin.h>
+
+	#include "Endian.hpp"
 #elif SOUP_ARM
 	#include <arm_neon.h>
 #endif
@@ -13,6 +17,7 @@
 // x86:
 // - https://gist.github.com/acapola/d5b940da024080dfaf5f
 // - https://www.intel.com/content/dam/doc/white-paper/advanced-encryption-standard-new-instructions-set-paper.pdf
+// - https://www.intel.com/content/dam/develop/external/us/en/documents/clmul-wp-rev-2-02-2014-04-20.pdf
 // ARM:
 // - https://blog.michaelbrase.com/2018/06/04/optimizing-x86-aes-intrinsics-on-armv8-a/
 
@@ -148,7 +153,7 @@ NAMESPACE_SOUP
 	#endif
 		void aes_encrypt_block_128(const uint8_t in[16], uint8_t out[16], const uint8_t roundKeys[176]) noexcept
 		{
-			__m128i data = *reinterpret_cast<const __m128i*>(in);
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
 			data = _mm_xor_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[0]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[1]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[2]);
@@ -160,7 +165,7 @@ NAMESPACE_SOUP
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[8]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[9]);
 			data = _mm_aesenclast_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[10]);
-			*reinterpret_cast<__m128i*>(out) = data;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), data);
 		}
 
 	#if defined(__GNUC__) || defined(__clang__)
@@ -168,7 +173,7 @@ NAMESPACE_SOUP
 	#endif
 		void aes_encrypt_block_192(const uint8_t in[16], uint8_t out[16], const uint8_t roundKeys[208]) noexcept
 		{
-			__m128i data = *reinterpret_cast<const __m128i*>(in);
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
 			data = _mm_xor_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[0]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[1]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[2]);
@@ -182,7 +187,7 @@ NAMESPACE_SOUP
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[10]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[11]);
 			data = _mm_aesenclast_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[12]);
-			*reinterpret_cast<__m128i*>(out) = data;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), data);
 		}
 
 	#if defined(__GNUC__) || defined(__clang__)
@@ -190,7 +195,7 @@ NAMESPACE_SOUP
 	#endif
 		void aes_encrypt_block_256(const uint8_t in[16], uint8_t out[16], const uint8_t roundKeys[240]) noexcept
 		{
-			__m128i data = *reinterpret_cast<const __m128i*>(in);
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
 			data = _mm_xor_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[0]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[1]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[2]);
@@ -206,7 +211,7 @@ NAMESPACE_SOUP
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[12]);
 			data = _mm_aesenc_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[13]);
 			data = _mm_aesenclast_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[14]);
-			*reinterpret_cast<__m128i*>(out) = data;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), data);
 		}
 
 	#if defined(__GNUC__) || defined(__clang__)
@@ -268,7 +273,7 @@ NAMESPACE_SOUP
 	#endif
 		void aes_decrypt_block_128(const uint8_t in[16], uint8_t out[16], const uint8_t roundKeys[176]) noexcept
 		{
-			__m128i data = *reinterpret_cast<const __m128i*>(in);
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
 			data = _mm_xor_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[10]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[9]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[8]);
@@ -280,7 +285,7 @@ NAMESPACE_SOUP
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[2]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[1]);
 			data = _mm_aesdeclast_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[0]);
-			*reinterpret_cast<__m128i*>(out) = data;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), data);
 		}
 
 	#if defined(__GNUC__) || defined(__clang__)
@@ -288,7 +293,7 @@ NAMESPACE_SOUP
 	#endif
 		void aes_decrypt_block_192(const uint8_t in[16], uint8_t out[16], const uint8_t roundKeys[208]) noexcept
 		{
-			__m128i data = *reinterpret_cast<const __m128i*>(in);
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
 			data = _mm_xor_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[12]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[11]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[10]);
@@ -302,7 +307,7 @@ NAMESPACE_SOUP
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[2]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[1]);
 			data = _mm_aesdeclast_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[0]);
-			*reinterpret_cast<__m128i*>(out) = data;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), data);
 		}
 
 	#if defined(__GNUC__) || defined(__clang__)
@@ -310,7 +315,7 @@ NAMESPACE_SOUP
 	#endif
 		void aes_decrypt_block_256(const uint8_t in[16], uint8_t out[16], const uint8_t roundKeys[240]) noexcept
 		{
-			__m128i data = *reinterpret_cast<const __m128i*>(in);
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
 			data = _mm_xor_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[14]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[13]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[12]);
@@ -326,7 +331,181 @@ NAMESPACE_SOUP
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[2]);
 			data = _mm_aesdec_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[1]);
 			data = _mm_aesdeclast_si128(data, reinterpret_cast<const __m128i*>(roundKeys)[0]);
-			*reinterpret_cast<__m128i*>(out) = data;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), data);
+		}
+
+		// GCM: GHASH operates on byte-reflected blocks so that PCLMULQDQ can be used directly.
+
+	#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("ssse3")))
+	#endif
+		[[nodiscard]] static __m128i gcm_load_reflected(const uint8_t* p) noexcept
+		{
+			return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+		}
+
+	#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("ssse3")))
+	#endif
+		static void gcm_store_reflected(uint8_t* p, __m128i v) noexcept
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_shuffle_epi8(v, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)));
+		}
+
+		// Adds the 256-bit carry-less product of a & b to lo & hi.
+	#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("pclmul")))
+	#endif
+		static void gcm_clmul(__m128i a, __m128i b, __m128i& lo, __m128i& hi) noexcept
+		{
+			const __m128i mid = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+			lo = _mm_xor_si128(lo, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x00), _mm_slli_si128(mid, 8)));
+			hi = _mm_xor_si128(hi, _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x11), _mm_srli_si128(mid, 8)));
+		}
+
+		// Reduces a 256-bit product modulo the GCM polynomial, accounting for the bit reflection.
+		[[nodiscard]] static __m128i gcm_reduce(__m128i lo, __m128i hi) noexcept
+		{
+			__m128i t1 = _mm_srli_epi32(lo, 31);
+			__m128i t2 = _mm_srli_epi32(hi, 31);
+			lo = _mm_slli_epi32(lo, 1);
+			hi = _mm_slli_epi32(hi, 1);
+			const __m128i t3 = _mm_srli_si128(t1, 12);
+			t2 = _mm_slli_si128(t2, 4);
+			t1 = _mm_slli_si128(t1, 4);
+			lo = _mm_or_si128(lo, t1);
+			hi = _mm_or_si128(_mm_or_si128(hi, t2), t3);
+
+			t1 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+			t2 = _mm_srli_si128(t1, 4);
+			lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 12));
+			t1 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+			lo = _mm_xor_si128(lo, _mm_xor_si128(t1, t2));
+			return _mm_xor_si128(hi, lo);
+		}
+
+	#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("pclmul,ssse3")))
+	#endif
+		void gcm_init(uint8_t h_powers[8][16], const uint8_t h[16]) noexcept
+		{
+			const __m128i h1 = gcm_load_reflected(h);
+			__m128i hn = h1;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(h_powers[0]), hn);
+			for (int i = 1; i != 8; ++i)
+			{
+				__m128i lo = _mm_setzero_si128();
+				__m128i hi = _mm_setzero_si128();
+				gcm_clmul(hn, h1, lo, hi);
+				hn = gcm_reduce(lo, hi);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(h_powers[i]), hn);
+			}
+		}
+
+		// Aggregated reduction: Up to 8 blocks are multiplied by descending powers of H and only the sum is reduced.
+	#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("pclmul,ssse3")))
+	#endif
+		void gcm_ghash(uint8_t x[16], const uint8_t h_powers[8][16], const uint8_t* data, size_t num_blocks) noexcept
+		{
+			__m128i acc = gcm_load_reflected(x);
+			for (; num_blocks >= 8; num_blocks -= 8, data += 8 * 16)
+			{
+				__m128i lo = _mm_setzero_si128();
+				__m128i hi = _mm_setzero_si128();
+				gcm_clmul(_mm_xor_si128(gcm_load_reflected(data), acc), _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers[7])), lo, hi);
+				for (int i = 1; i != 8; ++i)
+				{
+					gcm_clmul(gcm_load_reflected(data + i * 16), _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers[7 - i])), lo, hi);
+				}
+				acc = gcm_reduce(lo, hi);
+			}
+			if (num_blocks != 0)
+			{
+				const size_t n = num_blocks;
+				__m128i lo = _mm_setzero_si128();
+				__m128i hi = _mm_setzero_si128();
+				gcm_clmul(_mm_xor_si128(gcm_load_reflected(data), acc), _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers[n - 1])), lo, hi);
+				for (size_t i = 1; i != n; ++i)
+				{
+					gcm_clmul(gcm_load_reflected(data + i * 16), _mm_loadu_si128(reinterpret_cast<const __m128i*>(h_powers[n - 1 - i])), lo, hi);
+				}
+				acc = gcm_reduce(lo, hi);
+			}
+			gcm_store_reflected(x, acc);
+		}
+
+		// Puts the big-endian counter into the last 32-bit lane, without needing SSE4.1.
+		[[nodiscard]] static __m128i gcm_counter_block(__m128i v, uint32_t x) noexcept
+		{
+			return _mm_or_si128(v, _mm_slli_si128(_mm_cvtsi32_si128(static_cast<int>(x)), 12));
+		}
+
+		// Counter mode with 8 blocks in flight, so the latency of AESENC is hidden.
+	#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("aes")))
+	#endif
+		void gcm_ctr(uint8_t* data, size_t num_blocks, const uint8_t* roundKeys, const int Nr, uint8_t counter[16]) noexcept
+		{
+			__m128i rk[15];
+			for (int r = 0; r <= Nr; ++r)
+			{
+				rk[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys) + r);
+			}
+			uint32_t iv[3];
+			memcpy(iv, counter, 12);
+			uint32_t ctr;
+			memcpy(&ctr, counter + 12, 4);
+			ctr = Endianness::invert(ctr); static_assert(ENDIAN_NATIVE == ENDIAN_LITTLE);
+
+			const __m128i iv_words = _mm_set_epi32(0, static_cast<int>(iv[2]), static_cast<int>(iv[1]), static_cast<int>(iv[0]));
+			for (; num_blocks >= 8; num_blocks -= 8, data += 8 * 16, ctr += 8)
+			{
+				// Spelt out so the compiler keeps all 8 blocks in registers.
+				__m128i b0 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 0)), rk[0]);
+				__m128i b1 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 1)), rk[0]);
+				__m128i b2 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 2)), rk[0]);
+				__m128i b3 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 3)), rk[0]);
+				__m128i b4 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 4)), rk[0]);
+				__m128i b5 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 5)), rk[0]);
+				__m128i b6 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 6)), rk[0]);
+				__m128i b7 = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr + 7)), rk[0]);
+				for (int r = 1; r != Nr; ++r)
+				{
+					const __m128i k = rk[r];
+					b0 = _mm_aesenc_si128(b0, k);
+					b1 = _mm_aesenc_si128(b1, k);
+					b2 = _mm_aesenc_si128(b2, k);
+					b3 = _mm_aesenc_si128(b3, k);
+					b4 = _mm_aesenc_si128(b4, k);
+					b5 = _mm_aesenc_si128(b5, k);
+					b6 = _mm_aesenc_si128(b6, k);
+					b7 = _mm_aesenc_si128(b7, k);
+				}
+				const __m128i k = rk[Nr];
+				__m128i* const out = reinterpret_cast<__m128i*>(data);
+				_mm_storeu_si128(out + 0, _mm_xor_si128(_mm_aesenclast_si128(b0, k), _mm_loadu_si128(out + 0)));
+				_mm_storeu_si128(out + 1, _mm_xor_si128(_mm_aesenclast_si128(b1, k), _mm_loadu_si128(out + 1)));
+				_mm_storeu_si128(out + 2, _mm_xor_si128(_mm_aesenclast_si128(b2, k), _mm_loadu_si128(out + 2)));
+				_mm_storeu_si128(out + 3, _mm_xor_si128(_mm_aesenclast_si128(b3, k), _mm_loadu_si128(out + 3)));
+				_mm_storeu_si128(out + 4, _mm_xor_si128(_mm_aesenclast_si128(b4, k), _mm_loadu_si128(out + 4)));
+				_mm_storeu_si128(out + 5, _mm_xor_si128(_mm_aesenclast_si128(b5, k), _mm_loadu_si128(out + 5)));
+				_mm_storeu_si128(out + 6, _mm_xor_si128(_mm_aesenclast_si128(b6, k), _mm_loadu_si128(out + 6)));
+				_mm_storeu_si128(out + 7, _mm_xor_si128(_mm_aesenclast_si128(b7, k), _mm_loadu_si128(out + 7)));
+			}
+			for (; num_blocks != 0; --num_blocks, data += 16, ++ctr)
+			{
+				__m128i b = _mm_xor_si128(gcm_counter_block(iv_words, Endianness::invert(ctr)), rk[0]);
+				for (int r = 1; r != Nr; ++r)
+				{
+					b = _mm_aesenc_si128(b, rk[r]);
+				}
+				b = _mm_aesenclast_si128(b, rk[Nr]);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(data), _mm_xor_si128(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data))));
+			}
+
+			ctr = Endianness::invert(ctr);
+			memcpy(counter + 12, &ctr, 4);
 		}
 #elif SOUP_ARM
 	#if defined(__GNUC__) || defined(__clang__)
@@ -1,1004 +1,807 @@
 #include "deflate.hpp"
 
+#include <algorithm> // min, sort
 #include <cstring> // memcpy
-
-#include "base.hpp"
+#include <vector>
 
 #include "adler32.hpp"
+#include "bitutil.hpp"
 #include "crc32.hpp"
 #include "Endian.hpp"
-
-/*
-Original source: https://github.com/Artexety/inflatecpp
-Original licence follows.
-
-Copyright (c) 2020 Artexety
-
-Permission is hereby granted, free of charge, to any person obtaining a copy
-of this software and associated documentation files (the "Software"), to deal
-in the Software without restriction, including without limitation the rights
-to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
-copies of the Software, and to permit persons to whom the Software is
-furnished to do so, subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
-FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
-AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
-LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
-OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
-SOFTWARE.
-*/
-
-#if SOUP_BITS >= 64
-#define X64BIT_SHIFTER
-#endif
+#include "InflateStream.hpp"
 
 NAMESPACE_SOUP
 {
-#ifdef X64BIT_SHIFTER
-	using shifter_t = uint64_t;
-#else
-	using shifter_t = uint32_t;
-#endif
-
-	#define MATCHLEN_PAIR(__base,__dispbits) ((__base) | ((__dispbits) << 16) | 0x8000)
-	#define OFFSET_PAIR(__base,__dispbits) ((__base) | ((__dispbits) << 16))
-
-	constexpr auto kCodeLenBits = 3;
-	constexpr auto kLiteralSyms = 288;
-	constexpr auto kEODMarkerSym = 256;
-	constexpr auto kMatchLenSymStart = 257;
-	constexpr auto kMatchLenSyms = 29;
-	constexpr auto kOffsetSyms = 32;
-	constexpr auto kMinMatchSize = 3;
-
-	constexpr unsigned int kMatchLenCode[kMatchLenSyms] = {
-	   MATCHLEN_PAIR(kMinMatchSize + 0, 0), MATCHLEN_PAIR(kMinMatchSize + 1, 0), MATCHLEN_PAIR(kMinMatchSize + 2, 0), MATCHLEN_PAIR(kMinMatchSize + 3, 0), MATCHLEN_PAIR(kMinMatchSize + 4, 0),
-	   MATCHLEN_PAIR(kMinMatchSize + 5, 0), MATCHLEN_PAIR(kMinMatchSize + 6, 0), MATCHLEN_PAIR(kMinMatchSize + 7, 0), MATCHLEN_PAIR(kMinMatchSize + 8, 1), MATCHLEN_PAIR(kMinMatchSize + 10, 1),
-	   MATCHLEN_PAIR(kMinMatchSize + 12, 1), MATCHLEN_PAIR(kMinMatchSize + 14, 1), MATCHLEN_PAIR(kMinMatchSize + 16, 2), MATCHLEN_PAIR(kMinMatchSize + 20, 2), MATCHLEN_PAIR(kMinMatchSize + 24, 2),
-	   MATCHLEN_PAIR(kMinMatchSize + 28, 2), MATCHLEN_PAIR(kMinMatchSize + 32, 3), MATCHLEN_PAIR(kMinMatchSize + 40, 3), MATCHLEN_PAIR(kMinMatchSize + 48, 3), MATCHLEN_PAIR(kMinMatchSize + 56, 3),
-	   MATCHLEN_PAIR(kMinMatchSize + 64, 4), MATCHLEN_PAIR(kMinMatchSize + 80, 4), MATCHLEN_PAIR(kMinMatchSize + 96, 4), MATCHLEN_PAIR(kMinMatchSize + 112, 4), MATCHLEN_PAIR(kMinMatchSize + 128, 5),
-	   MATCHLEN_PAIR(kMinMatchSize + 160, 5), MATCHLEN_PAIR(kMinMatchSize + 192, 5), MATCHLEN_PAIR(kMinMatchSize + 224, 5), MATCHLEN_PAIR(kMinMatchSize + 255, 0),
-	};
+	using DecompressResult = deflate::DecompressResult;
 
-	constexpr unsigned int kOffsetCode[kOffsetSyms] = {
-	   OFFSET_PAIR(1, 0), OFFSET_PAIR(2, 0), OFFSET_PAIR(3, 0), OFFSET_PAIR(4, 0), OFFSET_PAIR(5, 1), OFFSET_PAIR(7, 1), OFFSET_PAIR(9, 2), OFFSET_PAIR(13, 2), OFFSET_PAIR(17, 3), OFFSET_PAIR(25, 3),
-	   OFFSET_PAIR(33, 4), OFFSET_PAIR(49, 4), OFFSET_PAIR(65, 5), OFFSET_PAIR(97, 5), OFFSET_PAIR(129, 6), OFFSET_PAIR(193, 6), OFFSET_PAIR(257, 7), OFFSET_PAIR(385, 7), OFFSET_PAIR(513, 8), OFFSET_PAIR(769, 8),
-	   OFFSET_PAIR(1025, 9), OFFSET_PAIR(1537, 9), OFFSET_PAIR(2049, 10), OFFSET_PAIR(3073, 10), OFFSET_PAIR(4097, 11), OFFSET_PAIR(6145, 11), OFFSET_PAIR(8193, 12), OFFSET_PAIR(12289, 12), OFFSET_PAIR(16385, 13), OFFSET_PAIR(24577, 13),
-	};
+	DecompressResult deflate::decompress(const std::string& compressed_data)
+	{
+		return decompress(compressed_data.data(), compressed_data.size());
+	}
 
-	class DeflateBitReader
+	DecompressResult deflate::decompress(const std::string& compressed_data, size_t max_decompressed_size)
 	{
-	private:
-		int shifter_bit_count_ = 0;
-		shifter_t shifter_data_ = 0;
-		unsigned char* in_block_;
-		unsigned char* in_block_end_;
-		unsigned char* in_block_start_;
+		return decompress(compressed_data.data(), compressed_data.size(), max_decompressed_size);
+	}
 
-	public:
-		/**
-		 * Initialize bit reader
-		 *
-		 * @param in_block pointer to the start of the compressed block
-		 * @param in_block_end pointer to the end of the compressed block + 1
-		 */
-		explicit DeflateBitReader(unsigned char* in_block, unsigned char* in_block_end)
-			: in_block_(in_block), in_block_end_(in_block_end), in_block_start_(in_block)
-		{
-		}
+	DecompressResult deflate::decompress(const void* compressed_data, size_t compressed_data_size)
+	{
+		return decompress(compressed_data, compressed_data_size, compressed_data_size * 29);
+	}
+
+	DecompressResult deflate::decompress(const void* compressed_data, size_t compressed_data_size, size_t max_decompressed_size, Format format)
+	{
+		InflateStream inflater(format);
+		inflater.feed(compressed_data, compressed_data_size);
 
-		/** Refill 32 bits at a time if the architecture allows it, otherwise do nothing. */
-		void refill32()
+		DecompressResult res{};
+		res.decompressed.resize(std::min(max_decompressed_size, compressed_data_size * 4 + 0x1000));
+		size_t len = 0;
+		while (true)
 		{
-#if SOUP_BITS == 64
-			if (this->shifter_bit_count_ <= 32 && (this->in_block_ + 4) <= this->in_block_end_)
+			len += inflater.read(&res.decompressed[len], res.decompressed.size() - len);
+			if (len != res.decompressed.size())
 			{
-				if constexpr (ENDIAN_NATIVE == ENDIAN_LITTLE)
-				{
-					this->shifter_data_ |= (((shifter_t)(*((unsigned int*)this->in_block_))) << this->shifter_bit_count_);
-					this->shifter_bit_count_ += 32;
-					this->in_block_ += 4;
-				}
-				else
+				break;
+			}
+			if (len == max_decompressed_size)
+			{
+				char c;
+				if (inflater.read(&c, 1) != 0)
 				{
-					this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-					this->shifter_bit_count_ += 8;
-					this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-					this->shifter_bit_count_ += 8;
-					this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-					this->shifter_bit_count_ += 8;
-					this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-					this->shifter_bit_count_ += 8;
+					return {};
 				}
+				break;
 			}
-#endif
+			res.decompressed.resize(std::min(max_decompressed_size, len * 2));
 		}
-
-		/**
-		 * Consume variable bit-length value, after reading it with PeekBits()
-		 *
-		 * @param n size of value to consume, in bits
-		 */
-		void consumeBits(const int n)
+		if (inflater.getStatus() != InflateStream::DONE)
 		{
-			this->shifter_data_ >>= n;
-			this->shifter_bit_count_ -= n;
+			return {};
 		}
+		res.decompressed.resize(len);
+		res.compressed_size = inflater.getCompressedSize();
+		res.checksum_present = inflater.isChecksumPresent();
+		res.checksum_mismatch = inflater.isChecksumMismatch();
+		return res;
+	}
 
-		void modifyInBlock(const int v)
-		{
-			this->in_block_ += v;
-		}
+	struct DeflateLevelConfig
+	{
+		uint16_t good_length; // Once the previous match is this long, search less for a better one.
+		uint16_t max_lazy; // Don't look for a better match once the previous match is this long. For greedy levels, the longest match whose positions are all hashed.
+		uint16_t nice_length; // Stop searching once a match is this long.
+		uint16_t max_chain;
+	};
 
-		/**
-		 * Read variable bit-length value
-		 *
-		 * @param n size of value in bits (number of bits to read), 0..16
-		 *
-		 * @return value, or -1 for failure
-		 */
-		unsigned int getBits(const int n)
-		{
-			if (this->shifter_bit_count_ < n)
-			{
-				SOUP_IF_LIKELY (this->in_block_ < this->in_block_end_)
-				{
-					this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-					this->shifter_bit_count_ += 8;
+	static constexpr DeflateLevelConfig deflate_level_configs[10] = {
+		{ 0, 0, 0, 0 },
+		{ 4, 4, 8, 4 },
+		{ 4, 5, 16, 8 },
+		{ 4, 6, 32, 32 },
+		{ 4, 4, 16, 16 },
+		{ 8, 16, 32, 32 },
+		{ 8, 16, 128, 128 },
+		{ 8, 32, 128, 256 },
+		{ 32, 128, 258, 1024 },
+		{ 32, 258, 258, 4096 },
+	};
 
-					if (this->in_block_ < this->in_block_end_)
-					{
-						this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-						this->shifter_bit_count_ += 8;
-					}
-				}
-				else
-				{
-					return -1;
-				}
-			}
+	struct DeflateBitWriter
+	{
+		std::string& out;
+		uint64_t bitbuf = 0;
+		unsigned int bitcnt = 0;
 
-			unsigned int value = this->shifter_data_ & ((1 << n) - 1);
-			this->shifter_data_ >>= n;
-			this->shifter_bit_count_ -= n;
-			return value;
+		DeflateBitWriter(std::string& out) noexcept
+			: out(out)
+		{
 		}
 
-		/**
-		 * Peek at a 16-bit value in the bitstream (lookahead)
-		 *
-		 * @return value
-		 */
-		unsigned int peekBits()
+		void write(uint32_t bits, unsigned int n) SOUP_EXCAL
 		{
-			if (this->shifter_bit_count_ < 16)
-			{
-				if (this->in_block_ < this->in_block_end_)
-				{
-					this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-					if (this->in_block_ < this->in_block_end_)
-						this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << (this->shifter_bit_count_ + 8));
-					this->shifter_bit_count_ += 16;
-				}
+			bitbuf |= (static_cast<uint64_t>(bits) << bitcnt);
+			bitcnt += n;
+			if (bitcnt >= 32)
+			{
+				const char bytes[4] = {
+					static_cast<char>(bitbuf),
+					static_cast<char>(bitbuf >> 8),
+					static_cast<char>(bitbuf >> 16),
+					static_cast<char>(bitbuf >> 24),
+				};
+				out.append(bytes, 4);
+				bitbuf >>= 32;
+				bitcnt -= 32;
 			}
-
-			return this->shifter_data_ & 0xffff;
 		}
 
-		/** Re-align bitstream on a byte */
-		bool alignToByte()
+		void alignToByte() SOUP_EXCAL
 		{
-			while (this->shifter_bit_count_ >= 8) {
-				this->shifter_bit_count_ -= 8;
-				this->in_block_--;
-				if (this->in_block_ < this->in_block_start_)
-				{
-					return false;
-				}
+			while (bitcnt != 0)
+			{
+				out.push_back(static_cast<char>(bitbuf));
+				bitbuf >>= 8;
+				bitcnt = (bitcnt > 8 ? bitcnt - 8 : 0);
 			}
-
-			this->shifter_bit_count_ = 0;
-			this->shifter_data_ = 0;
-			return true;
 		}
-
-		unsigned char* getInBlock() { return this->in_block_; };
-		unsigned char* getInBlockEnd() { return this->in_block_end_; };
-		unsigned char* getInBlockStart() { return this->in_block_start_; };
 	};
 
-	constexpr auto kMaxSymbols = 288;
-	constexpr auto kCodeLenSyms = 19;
-	constexpr auto kFastSymbolBits = 10;
-
-	class HuffmanDecoder
+	// Computes the lengths of a length-limited Huffman code for the given frequencies.
+	static void deflateBuildCodeLengths(const uint32_t* freq, unsigned int num_symbols, unsigned int max_len, uint8_t* lens) noexcept
 	{
-	private:
-		unsigned int fast_symbol_[1 << kFastSymbolBits];
-		unsigned int start_index_[16];
-		unsigned int symbols_;
-		int num_sorted_;
-		int starting_pos_[16];
-
-	public:
-		/**
-		 * Prepare huffman tables
-		 *
-		 * @param rev_symbol_table array of 2 * symbols entries for storing the reverse lookup table
-		 * @param code_length codeword lengths table
-		 */
-		bool prepareTable(unsigned int* rev_symbol_table, const int read_symbols, const int symbols, unsigned char* code_length)
+		uint16_t syms[288];
+		uint32_t a[288];
+		unsigned int n = 0;
+		for (unsigned int sym = 0; sym != num_symbols; ++sym)
 		{
-			int num_symbols_per_len[16];
-			int i;
-
-			if (read_symbols < 0 || read_symbols > kMaxSymbols || symbols < 0 || symbols > kMaxSymbols || read_symbols > symbols)
+			lens[sym] = 0;
+			if (freq[sym] != 0)
 			{
-				return false;
+				syms[n++] = static_cast<uint16_t>(sym);
 			}
-			this->symbols_ = symbols;
-
-
-			for (i = 0; i < 16; ++i)
-				num_symbols_per_len[i] = 0;
-
-			for (i = 0; i < read_symbols; ++i)
+		}
+		if (n < 2)
+		{
+			// Some decoders require at least two codes.
+			lens[0] = 1;
+			lens[1] = 1;
+			if (n == 1 && syms[0] > 1)
 			{
-				if (code_length[i] >= 16)
-				{
-					return false;
-				}
-				num_symbols_per_len[code_length[i]]++;
+				lens[0] = 0;
+				lens[syms[0]] = 1;
 			}
+			return;
+		}
+		std::sort(&syms[0], &syms[n], [freq](uint16_t a, uint16_t b)
+		{
+			return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+		});
+		for (unsigned int i = 0; i != n; ++i)
+		{
+			a[i] = freq[syms[i]];
+		}
 
-			this->starting_pos_[0] = 0;
-			this->num_sorted_ = 0;
-			for (i = 1; i != 16; ++i)
+		// In-place computation of minimum-redundancy code lengths (Moffat & Katajainen).
+		a[0] += a[1];
+		unsigned int root = 0;
+		unsigned int leaf = 2;
+		for (unsigned int next = 1; next < n - 1; ++next)
+		{
+			if (leaf >= n || a[root] < a[leaf])
 			{
-				this->starting_pos_[i] = this->num_sorted_;
-				this->num_sorted_ += num_symbols_per_len[i];
+				a[next] = a[root];
+				a[root++] = next;
 			}
-
-			for (i = 0; i < symbols; ++i)
-				rev_symbol_table[i] = -1;
-
-			for (i = 0; i < read_symbols; ++i)
+			else
 			{
-				if (code_length[i])
-					rev_symbol_table[this->starting_pos_[code_length[i]]++] = i;
+				a[next] = a[leaf++];
 			}
-
-			return true;
-		}
-
-		/**
-		 * Finalize huffman codewords for decoding
-		 *
-		 * @param rev_symbol_table array of 2 * symbols entries that contains the reverse lookup table
-		 */
-		bool finaliseTable(unsigned int* rev_symbol_table)
-		{
-			const int symbols = this->symbols_;
-			unsigned int canonical_code_word = 0;
-			unsigned int* rev_code_length_table = rev_symbol_table + symbols;
-			int canonical_length = 1;
-			int i;
-
-			for (i = 0; i != (1 << kFastSymbolBits); ++i)
+			if (leaf >= n || (root < next && a[root] < a[leaf]))
 			{
-				this->fast_symbol_[i] = 0;
+				a[next] += a[root];
+				a[root++] = next;
 			}
-			for (i = 0; i != 16; ++i)
+			else
 			{
-				this->start_index_[i] = 0;
+				a[next] += a[leaf++];
 			}
-
-			i = 0;
-			while (i < this->num_sorted_)
-			{
-				if (canonical_length >= 16)
+		}
+		a[n - 2] = 0;
+		for (int next = static_cast<int>(n) - 3; next >= 0; --next)
+		{
+			a[next] = a[a[next]] + 1;
+		}
+		{
+			int avbl = 1;
+			int used = 0;
+			uint32_t depth = 0;
+			int r = static_cast<int>(n) - 2;
+			int next = static_cast<int>(n) - 1;
+			while (avbl > 0)
+			{
+				while (r >= 0 && a[r] == depth)
 				{
-					return false;
+					++used;
+					--r;
 				}
-				this->start_index_[canonical_length] = i - canonical_code_word;
-
-				while (i < this->starting_pos_[canonical_length])
+				while (avbl > used)
 				{
-					if (i >= symbols)
-					{
-						return false;
-					}
-					rev_code_length_table[i] = canonical_length;
-
-					if (canonical_code_word >= (1U << canonical_length))
-					{
-						return false;
-					}
-
-					if (canonical_length <= kFastSymbolBits)
-					{
-						unsigned int rev_word;
-
-						/* Get upside down codeword (branchless method by Eric Biggers) */
-						rev_word = ((canonical_code_word & 0x5555) << 1) | ((canonical_code_word & 0xaaaa) >> 1);
-						rev_word = ((rev_word & 0x3333) << 2) | ((rev_word & 0xcccc) >> 2);
-						rev_word = ((rev_word & 0x0f0f) << 4) | ((rev_word & 0xf0f0) >> 4);
-						rev_word = ((rev_word & 0x00ff) << 8) | ((rev_word & 0xff00) >> 8);
-						rev_word = rev_word >> (16 - canonical_length);
-
-						int slots = 1 << (kFastSymbolBits - canonical_length);
-						while (slots)
-						{
-							this->fast_symbol_[rev_word] = (rev_symbol_table[i] & 0xffffff) | (canonical_length << 24);
-							rev_word += (1 << canonical_length);
-							slots--;
-						}
-					}
-
-					i++;
-					canonical_code_word++;
+					a[next--] = depth;
+					--avbl;
 				}
-				canonical_length++;
-				canonical_code_word <<= 1;
+				avbl = 2 * used;
+				++depth;
+				used = 0;
 			}
-
-			while (i < symbols)
-			{
-				rev_symbol_table[i] = -1;
-				rev_code_length_table[i++] = 0;
-			}
-
-			return true;
 		}
 
-		/**
-		 * Read fixed bit size code lengths
-		 *
-		 * @param len_bits number of bits per code length
-		 * @param read_symbols number of symbols actually read
-		 * @param symbols number of symbols to build codes for
-		 * @param code_length output code lengths table
-		 * @param bit_reader bit reader context
-		 */
-		static bool readRawLengths(const int len_bits, const int read_symbols, const int symbols, unsigned char* code_length, DeflateBitReader& bit_reader)
+		// Limit the code lengths by moving codes down the tree until the Kraft sum is 1 again.
+		uint32_t num_per_len[16] = {};
+		for (unsigned int i = 0; i != n; ++i)
 		{
-			const unsigned char code_len_syms[kCodeLenSyms] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
-			int i;
-
-			if (read_symbols < 0 || read_symbols > kMaxSymbols || symbols < 0 || symbols > kMaxSymbols || read_symbols > symbols)
-				return false;
-
-			i = 0;
-			while (i < read_symbols)
-			{
-				unsigned int length = bit_reader.getBits(len_bits);
-				if (length == -1)
-					return false;
-
-				code_length[code_len_syms[i++]] = length;
-			}
-
-			while (i < symbols)
-			{
-				code_length[code_len_syms[i++]] = 0;
-			}
-
-			return true;
+			++num_per_len[std::min<uint32_t>(a[i], max_len)];
 		}
-
-		/**
-		 * Read huffman-encoded code lengths
-		 *
-		 * @param tables_rev_symbol_table reverse lookup table for code lengths
-		 * @param read_symbols number of symbols actually read
-		 * @param symbols number of symbols to build codes for
-		 * @param code_length output code lengths table
-		 * @param bit_reader bit reader context
-		 */
-		bool readLength(const unsigned int* tables_rev_symbol_table, const int read_symbols, const int symbols, unsigned char* code_length, DeflateBitReader& bit_reader)
+		uint32_t total = 0;
+		for (unsigned int len = 1; len <= max_len; ++len)
 		{
-			int i;
-			if (read_symbols < 0 || symbols < 0 || read_symbols > symbols)
-				return false;
-
-			i = 0;
-			unsigned int previous_length = 0;
-
-			while (i < read_symbols)
+			total += (num_per_len[len] << (max_len - len));
+		}
+		while (total != (1u << max_len))
+		{
+			--num_per_len[max_len];
+			for (unsigned int len = max_len - 1; len != 0; --len)
 			{
-				unsigned int length = this->readValue(tables_rev_symbol_table, bit_reader);
-				if (length == -1)
-					return false;
-
-				if (length < 16)
-				{
-					previous_length = length;
-					code_length[i++] = previous_length;
-				}
-				else
+				if (num_per_len[len] != 0)
 				{
-					unsigned int run_length = 0;
-
-					if (length == 16)
-					{
-						int extra_run_length = bit_reader.getBits(2);
-						if (extra_run_length == -1)
-							return false;
-						run_length = 3 + extra_run_length;
-					}
-					else if (length == 17)
-					{
-						int extra_run_length = bit_reader.getBits(3);
-						if (extra_run_length == -1)
-							return false;
-						previous_length = 0;
-						run_length = 3 + extra_run_length;
-					}
-					else if (length == 18)
-					{
-						int extra_run_length = bit_reader.getBits(7);
-						if (extra_run_length == -1)
-							return false;
-						previous_length = 0;
-						run_length = 11 + extra_run_length;
-					}
-
-					while (run_length && i < read_symbols)
-					{
-						code_length[i++] = previous_length;
-						run_length--;
-					}
+					--num_per_len[len];
+					num_per_len[len + 1] += 2;
+					break;
 				}
 			}
-
-			while (i < symbols)
-				code_length[i++] = 0;
-			return true;
+			--total;
 		}
 
-		/**
-		 * Decode next symbol
-		 *
-		 * @param rev_symbol_table reverse lookup table
-		 * @param bit_reader bit reader context
-		 *
-		 * @return symbol, or -1 for error
-		 */
-		unsigned int readValue(const unsigned int* rev_symbol_table, DeflateBitReader& bit_reader)
+		// Least frequent symbols get the longest codes.
+		unsigned int i = 0;
+		for (unsigned int len = max_len; len != 0; --len)
 		{
-			unsigned int stream = bit_reader.peekBits();
-			unsigned int fast_sym_bits = this->fast_symbol_[stream & ((1 << kFastSymbolBits) - 1)];
-			if (fast_sym_bits)
+			for (uint32_t k = 0; k != num_per_len[len]; ++k)
 			{
-				bit_reader.consumeBits(fast_sym_bits >> 24);
-				return fast_sym_bits & 0xffffff;
+				lens[syms[i++]] = static_cast<uint8_t>(len);
 			}
-			const unsigned int* rev_code_length_table = rev_symbol_table + this->symbols_;
-			unsigned int code_word = 0;
-			int bits = 1;
+		}
+	}
 
-			do
+	// Computes canonical codes, bit-reversed as DEFLATE writes them starting with the least significant bit.
+	static void deflateBuildCodes(const uint8_t* lens, unsigned int num_symbols, uint16_t* codes) noexcept
+	{
+		uint16_t num_per_len[16] = {};
+		for (unsigned int sym = 0; sym != num_symbols; ++sym)
+		{
+			++num_per_len[lens[sym]];
+		}
+		num_per_len[0] = 0;
+		uint16_t next_code[16];
+		uint16_t code = 0;
+		for (unsigned int len = 1; len != 16; ++len)
+		{
+			code = (code + num_per_len[len - 1]) << 1;
+			next_code[len] = code;
+		}
+		for (unsigned int sym = 0; sym != num_symbols; ++sym)
+		{
+			if (const auto len = lens[sym]; len != 0)
 			{
-				code_word |= (stream & 1);
-
-				unsigned int table_index = this->start_index_[bits] + code_word;
-				if (table_index < this->symbols_)
+				const uint16_t c = next_code[len]++;
+				uint16_t rev = 0;
+				for (unsigned int b = 0; b != len; ++b)
 				{
-					if (bits == rev_code_length_table[table_index])
-					{
-						bit_reader.consumeBits(bits);
-						return rev_symbol_table[table_index];
-					}
+					rev |= ((c >> b) & 1) << (len - 1 - b);
 				}
-				code_word <<= 1;
-				stream >>= 1;
-				bits++;
-			} while (bits < 16);
-
-			return -1;
+				codes[sym] = rev;
+			}
 		}
-	};
-
+	}
 
-	unsigned int copyStored(DeflateBitReader& bit_reader, unsigned char* out, size_t out_offset, size_t block_size_max)
+	[[nodiscard]] static unsigned int deflateGetLengthIndex(unsigned int len) noexcept
 	{
-		SOUP_IF_UNLIKELY (!bit_reader.alignToByte())
-		{
-			return -1;
-		}
-
-		SOUP_IF_UNLIKELY ((bit_reader.getInBlock() + 4) > bit_reader.getInBlockEnd())
+		if (len == 258)
 		{
-			return -1;
+			return 28;
 		}
-
-		uint16_t stored_length = ((unsigned short)bit_reader.getInBlock()[0]) | (((unsigned short)bit_reader.getInBlock()[1]) << 8);
-		bit_reader.modifyInBlock(2);
-
-		uint16_t neg_stored_length = ((unsigned short)bit_reader.getInBlock()[0]) | (((unsigned short)bit_reader.getInBlock()[1]) << 8);
-		bit_reader.modifyInBlock(2);
-
-		SOUP_IF_UNLIKELY (stored_length != (uint16_t)~neg_stored_length)
+		const unsigned int x = len - 3;
+		if (x < 8)
 		{
-			return -1;
+			return x;
 		}
+		const unsigned int msb = bitutil::getMostSignificantSetBit(x);
+		return ((msb - 1) * 4) + ((x >> (msb - 2)) & 3);
+	}
 
-		SOUP_IF_UNLIKELY (stored_length > block_size_max)
+	[[nodiscard]] static unsigned int deflateGetDistanceIndex(unsigned int distance) noexcept
+	{
+		const unsigned int x = distance - 1;
+		if (x < 4)
 		{
-			return -1;
+			return x;
 		}
-
-		memcpy(out + out_offset, bit_reader.getInBlock(), stored_length);
-		bit_reader.modifyInBlock(stored_length);
-
-		return stored_length;
+		const unsigned int msb = bitutil::getMostSignificantSetBit(x);
+		return (msb * 2) + ((x >> (msb - 1)) & 1);
 	}
 
-	unsigned int decompressBlock(DeflateBitReader& br, bool dynamic_block, unsigned char* out, size_t out_offset, size_t block_size_max)
+	struct DeflateCompressor
 	{
-		HuffmanDecoder literals_decoder;
-		HuffmanDecoder offset_decoder;
-		unsigned int literals_rev_sym_table[kLiteralSyms * 2];
-		unsigned int offset_rev_sym_table[kLiteralSyms * 2];
-		int i;
-
-		if (dynamic_block)
+		static constexpr size_t WINDOW_SIZE = 0x8000;
+		static constexpr unsigned int HASH_BITS = 15;
+		static constexpr size_t NONE = SIZE_MAX;
+		static constexpr size_t MAX_BLOCK_SYMBOLS = 0x4000;
+
+		const uint8_t* const data;
+		const size_t size;
+		const DeflateLevelConfig config;
+		const bool lazy;
+		DeflateBitWriter bw;
+
+		std::vector<size_t> head;
+		std::vector<size_t> prev;
+
+		size_t block_start = 0;
+		std::vector<uint32_t> syms; // Literal, or length | (distance << 16)
+		uint32_t litlen_freq[286];
+		uint32_t dist_freq[30];
+		size_t extra_bits = 0;
+
+		DeflateCompressor(const void* data, size_t size, int level, std::string& out)
+			: data(static_cast<const uint8_t*>(data)), size(size), config(deflate_level_configs[level]), lazy(level >= 4), bw(out)
 		{
-			HuffmanDecoder tables_decoder;
-			unsigned char code_length[kLiteralSyms + kOffsetSyms];
-			unsigned int tables_rev_sym_table[kCodeLenSyms * 2];
+			resetBlock();
+		}
 
-			unsigned int literal_syms = br.getBits(5);
-			SOUP_IF_UNLIKELY (literal_syms == -1)
-			{
-				return -1;
-			}
-			literal_syms += 257;
-			SOUP_IF_UNLIKELY (literal_syms > kLiteralSyms)
+		void run() SOUP_EXCAL
+		{
+			if (config.max_chain == 0)
 			{
-				return -1;
+				emitStored(size, true);
+				return;
 			}
-
-			unsigned int offset_syms = br.getBits(5);
-			SOUP_IF_UNLIKELY (offset_syms == -1)
+			head.resize(1 << HASH_BITS, NONE);
+			prev.resize(WINDOW_SIZE);
+			syms.reserve(MAX_BLOCK_SYMBOLS);
+			if (lazy)
 			{
-				return -1;
+				compressLazy();
 			}
-			offset_syms += 1;
-			SOUP_IF_UNLIKELY (offset_syms > kOffsetSyms)
+			else
 			{
-				return -1;
+				compressGreedy();
 			}
+		}
 
-			unsigned int code_len_syms = br.getBits(4);
-			SOUP_IF_UNLIKELY (code_len_syms == -1)
-			{
-				return -1;
-			}
-			code_len_syms += 4;
-			SOUP_IF_UNLIKELY (code_len_syms > kCodeLenSyms)
-			{
-				return -1;
-			}
+		void resetBlock() noexcept
+		{
+			memset(litlen_freq, 0, sizeof(litlen_freq));
+			memset(dist_freq, 0, sizeof(dist_freq));
+			syms.clear();
+			extra_bits = 0;
+		}
 
-			SOUP_IF_UNLIKELY (!HuffmanDecoder::readRawLengths(kCodeLenBits, code_len_syms, kCodeLenSyms, code_length, br))
-			{
-				return -1;
-			}
-			SOUP_IF_UNLIKELY (!tables_decoder.prepareTable(tables_rev_sym_table, kCodeLenSyms, kCodeLenSyms, code_length))
-			{
-				return -1;
-			}
-			SOUP_IF_UNLIKELY (!tables_decoder.finaliseTable(tables_rev_sym_table))
-			{
-				return -1;
-			}
+		[[nodiscard]] uint32_t hash(size_t pos) const noexcept
+		{
+			const uint32_t v = (data[pos] << 16) | (data[pos + 1] << 8) | data[pos + 2];
+			return (v * 0x9E3779B1u) >> (32 - HASH_BITS);
+		}
 
-			SOUP_IF_UNLIKELY (!tables_decoder.readLength(tables_rev_sym_table, literal_syms + offset_syms, kLiteralSyms + kOffsetSyms, code_length, br))
-			{
-				return -1;
-			}
-			SOUP_IF_UNLIKELY (!literals_decoder.prepareTable(literals_rev_sym_table, literal_syms, kLiteralSyms, code_length))
-			{
-				return -1;
-			}
-			SOUP_IF_UNLIKELY (!offset_decoder.prepareTable(offset_rev_sym_table, offset_syms, kOffsetSyms, code_length + literal_syms))
+		void insert(size_t pos) noexcept
+		{
+			if (pos + 3 <= size)
 			{
-				return -1;
+				const auto h = hash(pos);
+				prev[pos & (WINDOW_SIZE - 1)] = head[h];
+				head[h] = pos;
 			}
 		}
-		else
-		{
-			unsigned char fixed_literal_code_len[kLiteralSyms];
-			unsigned char fixed_offset_code_len[kOffsetSyms];
-
-			for (i = 0; i < 144; i++)
-				fixed_literal_code_len[i] = 8;
-			for (; i < 256; i++)
-				fixed_literal_code_len[i] = 9;
-			for (; i < 280; i++)
-				fixed_literal_code_len[i] = 7;
-			for (; i < kLiteralSyms; i++)
-				fixed_literal_code_len[i] = 8;
-
-			for (i = 0; i < kOffsetSyms; i++)
-				fixed_offset_code_len[i] = 5;
 
-			SOUP_IF_UNLIKELY (!literals_decoder.prepareTable(literals_rev_sym_table, kLiteralSyms, kLiteralSyms, fixed_literal_code_len))
+		[[nodiscard]] unsigned int matchLength(const uint8_t* a, const uint8_t* b, unsigned int max_len) const noexcept
+		{
+			unsigned int len = 0;
+			if constexpr (ENDIAN_NATIVE == ENDIAN_LITTLE)
 			{
-				return -1;
+				for (; len + 8 <= max_len; len += 8)
+				{
+					uint64_t x, y;
+					memcpy(&x, a + len, 8);
+					memcpy(&y, b + len, 8);
+					if (x != y)
+					{
+						return len + static_cast<unsigned int>(bitutil::getLeastSignificantSetBit(x ^ y) / 8);
+					}
+				}
 			}
-			SOUP_IF_UNLIKELY (!offset_decoder.prepareTable(offset_rev_sym_table, kOffsetSyms, kOffsetSyms, fixed_offset_code_len))
+			while (len != max_len && a[len] == b[len])
 			{
-				return -1;
+				++len;
 			}
+			return len;
 		}
 
-		for (i = 0; i < kOffsetSyms; i++)
+		// Returns the length of the longest match at pos that is longer than prev_len, or 0.
+		[[nodiscard]] unsigned int findMatch(size_t pos, unsigned int prev_len, unsigned int chain, unsigned int& out_distance) const noexcept
 		{
-			unsigned int n = offset_rev_sym_table[i];
-			if (n < kOffsetSyms)
+			const unsigned int max_len = static_cast<unsigned int>(std::min<size_t>(258, size - pos));
+			if (max_len < 3 || prev_len >= max_len)
 			{
-				offset_rev_sym_table[i] = kOffsetCode[n];
+				return 0;
 			}
-		}
-
-		for (i = 0; i < kLiteralSyms; i++)
-		{
-			unsigned int n = literals_rev_sym_table[i];
-			if (n >= kMatchLenSymStart && n < kLiteralSyms)
+			unsigned int best = std::max(prev_len, 2u);
+			const unsigned int initial_best = best;
+			const uint8_t* const cur = data + pos;
+			for (size_t cand = head[hash(pos)]; cand != NONE && pos - cand <= WINDOW_SIZE && chain-- != 0; )
 			{
-				literals_rev_sym_table[i] = kMatchLenCode[n - kMatchLenSymStart];
+				const uint8_t* const m = data + cand;
+				if (m[best] == cur[best]
+					&& m[0] == cur[0]
+					&& m[1] == cur[1]
+					)
+				{
+					const auto len = matchLength(m, cur, max_len);
+					if (len > best)
+					{
+						best = len;
+						out_distance = static_cast<unsigned int>(pos - cand);
+						if (len >= config.nice_length || len == max_len)
+						{
+							break;
+						}
+					}
+				}
+				const size_t next = prev[cand & (WINDOW_SIZE - 1)];
+				if (next >= cand)
+				{
+					break;
+				}
+				cand = next;
 			}
+			return best != initial_best ? best : 0;
 		}
 
-		SOUP_IF_UNLIKELY (!literals_decoder.finaliseTable(literals_rev_sym_table)
-			|| !offset_decoder.finaliseTable(offset_rev_sym_table)
-			)
+		void emitLiteral(uint8_t c) SOUP_EXCAL
 		{
-			return -1;
+			syms.emplace_back(c);
+			++litlen_freq[c];
 		}
 
-		unsigned char* current_out = out + out_offset;
-		const unsigned char* out_end = current_out + block_size_max;
-		const unsigned char* out_fast_end = out_end - 15;
-
-		while (true)
+		void emitMatch(unsigned int len, unsigned int distance) SOUP_EXCAL
 		{
-			br.refill32();
+			syms.emplace_back(len | (distance << 16));
+			const auto li = deflateGetLengthIndex(len);
+			const auto di = deflateGetDistanceIndex(distance);
+			++litlen_freq[257 + li];
+			++dist_freq[di];
+			extra_bits += deflate::length_extra_bits[li] + deflate::distance_extra_bits[di];
+		}
 
-			unsigned int literals_code_word = literals_decoder.readValue(literals_rev_sym_table, br);
-			if (literals_code_word < 256)
-			{
-				SOUP_IF_UNLIKELY (current_out >= out_end)
-				{
-					return -1;
-				}
-				*current_out++ = literals_code_word;
-			}
-			else
+		void compressGreedy() SOUP_EXCAL
+		{
+			size_t pos = 0;
+			while (pos < size)
 			{
-				if (literals_code_word == kEODMarkerSym)
-				{
-					break;
-				}
-
-				SOUP_IF_UNLIKELY (literals_code_word == -1)
+				unsigned int len = 0;
+				unsigned int distance = 0;
+				if (size - pos >= 3)
 				{
-					return -1;
+					len = findMatch(pos, 0, config.max_chain, distance);
+					if (len == 3 && distance > 4096)
+					{
+						len = 0;
+					}
+					insert(pos);
 				}
-
-				unsigned int match_length = br.getBits((literals_code_word >> 16) & 15);
-				SOUP_IF_UNLIKELY (match_length == -1)
+				if (len != 0)
 				{
-					return -1;
+					emitMatch(len, distance);
+					if (len <= config.max_lazy)
+					{
+						for (size_t i = pos + 1; i != pos + len; ++i)
+						{
+							insert(i);
+						}
+					}
+					pos += len;
 				}
-
-				match_length += (literals_code_word & 0x7fff);
-
-				unsigned int offset_code_word = offset_decoder.readValue(offset_rev_sym_table, br);
-				SOUP_IF_UNLIKELY (offset_code_word == -1)
+				else
 				{
-					return -1;
+					emitLiteral(data[pos]);
+					++pos;
 				}
-
-				unsigned int match_offset = br.getBits((offset_code_word >> 16) & 15);
-				SOUP_IF_UNLIKELY (match_offset == -1)
+				if (syms.size() >= MAX_BLOCK_SYMBOLS)
 				{
-					return -1;
+					flushBlock(pos, false);
 				}
+			}
+			flushBlock(size, true);
+		}
 
-				match_offset += (offset_code_word & 0x7fff);
-
-				const unsigned char* src = current_out - match_offset;
-				SOUP_IF_UNLIKELY (src < out)
+		void compressLazy() SOUP_EXCAL
+		{
+			// A match is only emitted once we know the match starting at the next position isn't longer.
+			size_t pos = 0;
+			unsigned int prev_len = 0;
+			unsigned int prev_distance = 0;
+			bool literal_pending = false;
+			while (pos < size)
+			{
+				unsigned int len = 0;
+				unsigned int distance = 0;
+				if (size - pos >= 3)
 				{
-					return -1;
+					if (prev_len < config.max_lazy)
+					{
+						len = findMatch(pos, prev_len, prev_len >= config.good_length ? (config.max_chain >> 2) : config.max_chain, distance);
+						if (len == 3 && distance > 4096)
+						{
+							len = 0;
+						}
+					}
+					insert(pos);
 				}
-
-				if (match_offset >= 16 && (current_out + match_length) <= out_fast_end)
+				if (prev_len >= 3 && len == 0)
 				{
-					const unsigned char* copy_src = src;
-					unsigned char* copy_dst = current_out;
-					const unsigned char* copy_end_dst = current_out + match_length;
-
-					do
+					emitMatch(prev_len, prev_distance);
+					const size_t end = pos - 1 + prev_len;
+					for (size_t i = pos + 1; i < end; ++i)
 					{
-						memcpy(copy_dst, copy_src, 16);
-						copy_src += 16;
-						copy_dst += 16;
-					} while (copy_dst < copy_end_dst);
-
-					current_out += match_length;
+						insert(i);
+					}
+					pos = end;
+					prev_len = 0;
+					literal_pending = false;
 				}
 				else
 				{
-					SOUP_IF_UNLIKELY ((current_out + match_length) > out_end)
-					{
-						return -1;
-					}
-
-					while (match_length--)
+					if (literal_pending)
 					{
-						*current_out++ = *src++;
+						emitLiteral(data[pos - 1]);
 					}
+					literal_pending = true;
+					prev_len = len;
+					prev_distance = distance;
+					++pos;
+				}
+				if (syms.size() >= MAX_BLOCK_SYMBOLS)
+				{
+					flushBlock(pos - literal_pending, false);
 				}
 			}
+			if (literal_pending)
+			{
+				emitLiteral(data[pos - 1]);
+			}
+			flushBlock(size, true);
 		}
 
-		return (unsigned int)(current_out - (out + out_offset));
-	}
-
-	enum class checksum_type : uint8_t
-	{
-		NONE = 0,
-		GZIP,
-		ZLIB
-	};
-
-	using DecompressResult = deflate::DecompressResult;
-
-	DecompressResult deflate::decompress(const std::string& compressed_data)
-	{
-		return decompress(compressed_data.data(), compressed_data.size());
-	}
-
-	DecompressResult deflate::decompress(const std::string& compressed_data, size_t max_decompressed_size)
-	{
-		return decompress(compressed_data.data(), compressed_data.size(), max_decompressed_size);
-	}
-
-	DecompressResult deflate::decompress(const void* compressed_data, size_t compressed_data_size)
-	{
-		return decompress(compressed_data, compressed_data_size, compressed_data_size * 29);
-	}
-
-	DecompressResult deflate::decompress(const void* compressed_data, size_t compressed_data_size, size_t max_decompressed_size)
-	{
-		uint8_t* current_compressed_data = (unsigned char*)compressed_data;
-		uint8_t* end_compressed_data = current_compressed_data + compressed_data_size;
-
-		DecompressResult res{};
-
-		checksum_type checksum_type = checksum_type::NONE;
-
-		if ((current_compressed_data + 2) > end_compressed_data)
+		void flushBlock(size_t block_end, bool final) SOUP_EXCAL
 		{
-			return {};
-		}
+			static constexpr uint8_t codelen_order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
 
-		if (current_compressed_data[0] == 0x1f && current_compressed_data[1] == 0x8b) // gzip magic
-		{
-			current_compressed_data += 2;
-			if ((current_compressed_data + 8) > end_compressed_data || current_compressed_data[0] != 0x08)
+			litlen_freq[256] = 1;
+			uint8_t lens[286 + 30];
+			uint8_t* const litlen_lens = &lens[0];
+			uint8_t dist_lens[30];
+			deflateBuildCodeLengths(litlen_freq, 286, 15, litlen_lens);
+			deflateBuildCodeLengths(dist_freq, 30, 15, dist_lens);
+			unsigned int num_litlen = 286;
+			while (litlen_lens[num_litlen - 1] == 0)
 			{
-				return {};
+				--num_litlen;
 			}
-
-			current_compressed_data++;
-
-			unsigned char flags = *current_compressed_data++;
-			current_compressed_data += 6;
-
-			if (flags & 0x02)
+			unsigned int num_dist = 30;
+			while (num_dist > 1 && dist_lens[num_dist - 1] == 0)
 			{
-				if ((current_compressed_data + 2) > end_compressed_data)
-				{
-					return {};
-				}
-
-				current_compressed_data += 2;
+				--num_dist;
 			}
+			memcpy(&lens[num_litlen], dist_lens, num_dist);
 
-			if (flags & 0x04)
+			// Run-length encode the code lengths.
+			uint8_t rle_syms[286 + 30];
+			uint8_t rle_extra[286 + 30];
+			unsigned int num_rle = 0;
+			uint32_t codelen_freq[19] = {};
+			for (unsigned int i = 0; i != num_litlen + num_dist; )
 			{
-				if ((current_compressed_data + 2) > end_compressed_data)
+				const uint8_t len = lens[i];
+				unsigned int run = 1;
+				while (i + run != num_litlen + num_dist && lens[i + run] == len)
 				{
-					return {};
+					++run;
 				}
-
-				unsigned short extra_field_len = ((unsigned short)current_compressed_data[0]) | (((unsigned short)current_compressed_data[1]) << 8);
-				current_compressed_data += 2;
-
-				if ((current_compressed_data + extra_field_len) > end_compressed_data)
+				i += run;
+				if (len == 0)
 				{
-					return {};
+					while (run >= 11)
+					{
+						const auto n = std::min(run, 138u);
+						rle_syms[num_rle] = 18;
+						rle_extra[num_rle++] = static_cast<uint8_t>(n - 11);
+						run -= n;
+					}
+					if (run >= 3)
+					{
+						rle_syms[num_rle] = 17;
+						rle_extra[num_rle++] = static_cast<uint8_t>(run - 3);
+						run = 0;
+					}
 				}
-
-				current_compressed_data += extra_field_len;
-			}
-
-			if (flags & 0x08)
-			{
-				do
+				else
 				{
-					if (current_compressed_data >= end_compressed_data)
+					rle_syms[num_rle] = len;
+					rle_extra[num_rle++] = 0;
+					--run;
+					while (run >= 3)
 					{
-						return {};
+						const auto n = std::min(run, 6u);
+						rle_syms[num_rle] = 16;
+						rle_extra[num_rle++] = static_cast<uint8_t>(n - 3);
+						run -= n;
 					}
-
-					current_compressed_data++;
-				} while (current_compressed_data[-1]);
+				}
+				while (run-- != 0)
+				{
+					rle_syms[num_rle] = len;
+					rle_extra[num_rle++] = 0;
+				}
 			}
-
-			if (flags & 0x10)
+			for (unsigned int i = 0; i != num_rle; ++i)
 			{
-				do
-				{
-					if (current_compressed_data >= end_compressed_data)
-					{
-						return {};
-					}
-
-					current_compressed_data++;
-				} while (current_compressed_data[-1]);
+				++codelen_freq[rle_syms[i]];
 			}
-
-			if (flags & 0x20)
+			uint8_t codelen_lens[19];
+			deflateBuildCodeLengths(codelen_freq, 19, 7, codelen_lens);
+			unsigned int num_codelen = 19;
+			while (num_codelen > 4 && codelen_lens[codelen_order[num_codelen - 1]] == 0)
 			{
-				return {};
+				--num_codelen;
 			}
 
-			res.checksum_present = true;
-			checksum_type = checksum_type::GZIP;
-		}
-		else if ((current_compressed_data[0] & 0x0f) == 0x08)
-		{
-			unsigned char CMF = current_compressed_data[0];
-			unsigned char FLG = current_compressed_data[1];
-			unsigned short check = FLG | (((unsigned short)CMF) << 8);
+			// Pick the cheapest block type.
+			size_t dynamic_bits = 3 + 5 + 5 + 4 + (3 * num_codelen) + extra_bits;
+			for (unsigned int sym = 0; sym != 19; ++sym)
+			{
+				dynamic_bits += codelen_freq[sym] * codelen_lens[sym];
+			}
+			dynamic_bits += (codelen_freq[16] * 2) + (codelen_freq[17] * 3) + (codelen_freq[18] * 7);
+			size_t fixed_bits = 3 + extra_bits;
+			for (unsigned int sym = 0; sym != 286; ++sym)
+			{
+				dynamic_bits += litlen_freq[sym] * litlen_lens[sym];
+				fixed_bits += litlen_freq[sym] * (sym < 144 ? 8 : sym < 256 ? 9 : sym < 280 ? 7 : 8);
+			}
+			for (unsigned int sym = 0; sym != 30; ++sym)
+			{
+				dynamic_bits += dist_freq[sym] * dist_lens[sym];
+				fixed_bits += dist_freq[sym] * 5;
+			}
+			const size_t raw_size = block_end - block_start;
+			const size_t stored_bits = (raw_size * 8) + (((raw_size / 0xffff) + 1) * 40);
 
-			if ((CMF >> 4) <= 7 && (check % 31) == 0)
+			if (stored_bits <= fixed_bits && stored_bits <= dynamic_bits)
+			{
+				emitStored(block_end, final);
+			}
+			else if (fixed_bits <= dynamic_bits)
+			{
+				uint8_t fixed_lens[288 + 30];
+				std::fill(&fixed_lens[0], &fixed_lens[144], 8);
+				std::fill(&fixed_lens[144], &fixed_lens[256], 9);
+				std::fill(&fixed_lens[256], &fixed_lens[280], 7);
+				std::fill(&fixed_lens[280], &fixed_lens[288], 8);
+				std::fill(&fixed_lens[288], &fixed_lens[288 + 30], 5);
+				bw.write(final, 1);
+				bw.write(1, 2);
+				emitSymbols(&fixed_lens[0], 288, &fixed_lens[288]);
+			}
+			else
 			{
-				current_compressed_data += 2;
-				if (FLG & 0x20)
+				bw.write(final, 1);
+				bw.write(2, 2);
+				bw.write(num_litlen - 257, 5);
+				bw.write(num_dist - 1, 5);
+				bw.write(num_codelen - 4, 4);
+				for (unsigned int i = 0; i != num_codelen; ++i)
+				{
+					bw.write(codelen_lens[codelen_order[i]], 3);
+				}
+				uint16_t codelen_codes[19];
+				deflateBuildCodes(codelen_lens, 19, codelen_codes);
+				for (unsigned int i = 0; i != num_rle; ++i)
 				{
-					if ((current_compressed_data + 4) > end_compressed_data)
+					bw.write(codelen_codes[rle_syms[i]], codelen_lens[rle_syms[i]]);
+					switch (rle_syms[i])
 					{
-						return {};
+					case 16: bw.write(rle_extra[i], 2); break;
+					case 17: bw.write(rle_extra[i], 3); break;
+					case 18: bw.write(rle_extra[i], 7); break;
 					}
-					current_compressed_data += 4;
 				}
+				emitSymbols(litlen_lens, num_litlen, dist_lens);
 			}
 
-			res.checksum_present = true;
-			checksum_type = checksum_type::ZLIB;
+			block_start = block_end;
+			resetBlock();
 		}
 
-		uint32_t check_sum = crc32::INITIAL;
-		if (checksum_type == checksum_type::ZLIB)
+		// Only the first num_litlen lengths are used, as the fixed code has 288 of them while a dynamic block is followed by its distance lengths.
+		void emitSymbols(const uint8_t* litlen_lens, unsigned int num_litlen, const uint8_t* dist_lens) SOUP_EXCAL
 		{
-			check_sum = adler32::INITIAL;
+			uint16_t litlen_codes[288];
+			uint16_t dist_codes[30];
+			deflateBuildCodes(litlen_lens, num_litlen, litlen_codes);
+			deflateBuildCodes(dist_lens, 30, dist_codes);
+			for (const auto sym : syms)
+			{
+				const unsigned int distance = (sym >> 16);
+				if (distance == 0)
+				{
+					bw.write(litlen_codes[sym], litlen_lens[sym]);
+					continue;
+				}
+				const unsigned int len = (sym & 0xffff);
+				const auto li = deflateGetLengthIndex(len);
+				bw.write(litlen_codes[257 + li], litlen_lens[257 + li]);
+				bw.write(len - deflate::length_base[li], deflate::length_extra_bits[li]);
+				const auto di = deflateGetDistanceIndex(distance);
+				bw.write(dist_codes[di], dist_lens[di]);
+				bw.write(distance - deflate::distance_base[di], deflate::distance_extra_bits[di]);
+			}
+			bw.write(litlen_codes[256], litlen_lens[256]);
 		}
 
-		DeflateBitReader br(current_compressed_data, end_compressed_data);
-
-		res.decompressed = std::string(max_decompressed_size, '\0');
-		auto out = reinterpret_cast<uint8_t*>(&res.decompressed[0]);
-		size_t current_out_offset = 0;
-		while (true)
+		void emitStored(size_t block_end, bool final) SOUP_EXCAL
 		{
-			bool final_block = br.getBits(1);
-			auto block_type = br.getBits(2);
-
-			unsigned int block_result;
-			switch (block_type)
-			{
-			case 0:
-				block_result = copyStored(br, out, current_out_offset, max_decompressed_size - current_out_offset);
-				break;
-
-			case 1:
-				block_result = decompressBlock(br, false, out, current_out_offset, max_decompressed_size - current_out_offset);
-				break;
-
-			case 2:
-				block_result = decompressBlock(br, true, out, current_out_offset, max_decompressed_size - current_out_offset);
-				break;
-
-			default:
-				return {};
-			}
-
-			if (block_result == -1)
-			{
-				return {};
-			}
-
-			switch (checksum_type)
-			{
-			case checksum_type::NONE:
-				break;
-
-			case checksum_type::GZIP:
-				check_sum = crc32::hash(out + current_out_offset, block_result, check_sum);
-				break;
-
-			case checksum_type::ZLIB:
-				check_sum = adler32::hash(out + current_out_offset, block_result, check_sum);
-				break;
-			}
-
-			current_out_offset += block_result;
-
-			if (final_block)
+			do
 			{
-				break;
-			}
+				const auto len = static_cast<uint16_t>(std::min<size_t>(block_end - block_start, 0xffff));
+				bw.write(final && block_start + len == block_end, 1);
+				bw.write(0, 2);
+				bw.alignToByte();
+				bw.write(len, 16);
+				bw.write(static_cast<uint16_t>(~len), 16);
+				bw.out.append(reinterpret_cast<const char*>(data + block_start), len);
+				block_start += len;
+			} while (block_start != block_end);
 		}
+	};
 
-		res.decompressed.resize(current_out_offset);
-
-		br.alignToByte();
-		current_compressed_data = br.getInBlock();
+	std::string deflate::compress(const std::string& data, int level, Format format)
+	{
+		return compress(data.data(), data.size(), level, format);
+	}
 
-		unsigned int stored_check_sum;
+	std::string deflate::compress(const void* data, size_t size, int level, Format format)
+	{
+		level = std::clamp(level, 0, 9);
 
-		switch (checksum_type)
+		std::string out;
+		out.reserve(std::min<size_t>(size, 0x100000) / 2 + 32);
+		if (format == ZLIB)
 		{
-		case checksum_type::NONE:
-			break;
-
-		case checksum_type::GZIP:
-			if ((current_compressed_data + 4) > end_compressed_data)
-			{
-				return {};
-			}
-
-			stored_check_sum = ((unsigned int)current_compressed_data[0]);
-			stored_check_sum |= ((unsigned int)current_compressed_data[1]) << 8;
-			stored_check_sum |= ((unsigned int)current_compressed_data[2]) << 16;
-			stored_check_sum |= ((unsigned int)current_compressed_data[3]) << 24;
-
-			res.checksum_mismatch |= (stored_check_sum != check_sum);
+			const uint8_t cmf = 0x78; // 32K window
+			uint8_t flg = ((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+			flg += 31 - (((cmf << 8) | flg) % 31);
+			out.push_back(static_cast<char>(cmf));
+			out.push_back(static_cast<char>(flg));
+		}
+		else if (format == GZIP)
+		{
+			out.append("\x1f\x8b\x08\x00\x00\x00\x00\x00", 8);
+			out.push_back(level == 9 ? 2 : level == 1 ? 4 : 0);
+			out.push_back('\xff'); // Unknown OS
+		}
 
-			current_compressed_data += 4;
-			break;
+		DeflateCompressor compressor(data, size, level, out);
+		compressor.run();
+		compressor.bw.alignToByte();
 
-		case checksum_type::ZLIB:
-			if ((current_compressed_data + 4) > end_compressed_data)
+		if (format == ZLIB)
+		{
+			const uint32_t checksum = adler32::hash(static_cast<const uint8_t*>(data), size);
+			out.push_back(static_cast<char>(checksum >> 24));
+			out.push_back(static_cast<char>(checksum >> 16));
+			out.push_back(static_cast<char>(checksum >> 8));
+			out.push_back(static_cast<char>(checksum));
+		}
+		else if (format == GZIP)
+		{
+			const uint32_t checksum = crc32::hash(static_cast<const uint8_t*>(data), size);
+			const auto isize = static_cast<uint32_t>(size);
+			for (const uint32_t val : { checksum, isize })
 			{
-				return {};
+				out.push_back(static_cast<char>(val));
+				out.push_back(static_cast<char>(val >> 8));
+				out.push_back(static_cast<char>(val >> 16));
+				out.push_back(static_cast<char>(val >> 24));
 			}
-
-			stored_check_sum = ((unsigned int)current_compressed_data[0]) << 24;
-			stored_check_sum |= ((unsigned int)current_compressed_data[1]) << 16;
-			stored_check_sum |= ((unsigned int)current_compressed_data[2]) << 8;
-			stored_check_sum |= ((unsigned int)current_compressed_data[3]);
-
-			res.checksum_mismatch |= (stored_check_sum != check_sum);
-
-			current_compressed_data += 4;
-			break;
 		}
-
-		res.compressed_size = (current_compressed_data - (unsigned char*)compressed_data);
-
-		return res;
+		return out;
 	}
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "base.hpp"
@@ -9,6 +10,19 @@ NAMESPACE_SOUP
 {
 	struct deflate
 	{
+		static constexpr uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr uint8_t length_extra_bits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static constexpr uint8_t distance_extra_bits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		enum Format : uint8_t
+		{
+			AUTO, // Only valid for decompression: detects gzip & zlib headers, otherwise assumes raw DEFLATE.
+			RAW,
+			ZLIB,
+			GZIP,
+		};
+
 		struct DecompressResult
 		{
 			std::string decompressed{};
@@ -21,6 +35,10 @@ NAMESPACE_SOUP
 		static DecompressResult decompress(const std::string& compressed_data);
 		static DecompressResult decompress(const std::string& compressed_data, size_t max_decompressed_size);
 		static DecompressResult decompress(const void* compressed_data, size_t compressed_data_size);
-		static DecompressResult decompress(const void* compressed_data, size_t compressed_data_size, size_t max_decompressed_size);
+		static DecompressResult decompress(const void* compressed_data, size_t compressed_data_size, size_t max_decompressed_size, Format format = AUTO);
+
+		// Level 0 only emits stored blocks, 1-3 use greedy matching, and 4-9 use lazy matching with increasingly long hash chains.
+		[[nodiscard]] static std::string compress(const std::string& data, int level = 6, Format format = RAW);
+		[[nodiscard]] static std::string compress(const void* data, size_t size, int level = 6, Format format = RAW);
 	};
 }
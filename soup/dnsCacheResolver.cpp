@@ -1,5 +1,8 @@
 #include "dnsCacheResolver.hpp"
 
+#include <algorithm> // min
+#include <mutex> // lock_guard
+
 #include "ObfusString.hpp"
 #include "time.hpp"
 
@@ -12,14 +15,26 @@
 
 NAMESPACE_SOUP
 {
+	[[nodiscard]] static std::vector<UniquePtr<dnsRecord>> copyRecords(const std::vector<UniquePtr<dnsRecord>>& records)
+	{
+		std::vector<UniquePtr<dnsRecord>> res;
+		res.reserve(records.size());
+		for (const auto& record : records)
+		{
+			res.emplace_back(record->copy());
+		}
+		return res;
+	}
+
 	Optional<std::vector<UniquePtr<dnsRecord>>> dnsCacheResolver::lookup(dnsType qtype, const std::string& name) const
 	{
 		auto res = findInCache(qtype, name);
-		if (res.empty())
+		if (!res.has_value())
 		{
-			if (underlying->lookup(qtype, name).consume(res))
+			res = underlying->lookup(qtype, name);
+			if (res.has_value())
 			{
-				addToCache(res);
+				addToCache(qtype, name, *res);
 			}
 		}
 		return res;
@@ -28,30 +43,45 @@ NAMESPACE_SOUP
 	struct dnsLookupAndCacheTask : public dnsLookupTask
 	{
 		const dnsCacheResolver& resolver;
-		UniquePtr<dnsLookupTask> underlying;
+		dnsType qtype;
+		std::string name;
+		SharedPtr<dnsCacheInflightLookup> inflight;
 
-		dnsLookupAndCacheTask(const dnsCacheResolver& resolver, UniquePtr<dnsLookupTask>&& underlying)
-			: resolver(resolver), underlying(std::move(underlying))
+		dnsLookupAndCacheTask(const dnsCacheResolver& resolver, dnsType qtype, const std::string& name, SharedPtr<dnsCacheInflightLookup>&& inflight)
+			: resolver(resolver), qtype(qtype), name(name), inflight(std::move(inflight))
 		{
 		}
 
 		void onTick() final
 		{
-			if (underlying->tickUntilDone())
+			if (inflight->mutex.tryLock())
 			{
-				result = std::move(underlying->result);
-				if (result)
+				bool done = inflight->task->isWorkDone();
+				if (!done
+					&& inflight->task->tickUntilDone()
+					)
 				{
-					resolver.addToCache(*result);
+					done = true;
+					resolver.finishInflightLookup(qtype, name, inflight->task->result);
 				}
-				setWorkDone();
+				if (done)
+				{
+					if (inflight->task->result.has_value())
+					{
+						result = copyRecords(*inflight->task->result);
+					}
+					inflight->mutex.unlock();
+					setWorkDone();
+					return;
+				}
+				inflight->mutex.unlock();
 			}
 		}
 
 		std::string toString() const SOUP_EXCAL final
 		{
 			std::string str = ObfusString("dnsLookupAndCacheTask: [");
-			str.append(underlying->toString());
+			str.append(inflight->task->toString());
 			str.push_back(']');
 			return str;
 		}
@@ -59,59 +89,155 @@ NAMESPACE_SOUP
 
 	UniquePtr<dnsLookupTask> dnsCacheResolver::makeLookupTask(dnsType qtype, const std::string& name) const
 	{
-		if (auto res = findInCache(qtype, name); !res.empty())
+		Key key{ qtype, name };
+		auto& shard = getShard(key);
+		SharedPtr<dnsCacheInflightLookup> inflight;
 		{
-			return dnsCachedResultTask::make(std::move(res));
+			std::lock_guard lock(shard.mutex);
+			if (auto res = findInShard(shard, key, time::unixSeconds()); res.has_value())
+			{
+				return dnsCachedResultTask::make(std::move(*res));
+			}
+			if (auto it = shard.inflight.find(key); it != shard.inflight.end())
+			{
+#if LOGGING
+				logWriteLine(format("[DNS Cache] {}@{} joining inflight lookup", dnsTypeToString(qtype), name));
+#endif
+				inflight = it->second;
+			}
+			else
+			{
+				inflight = soup::make_shared<dnsCacheInflightLookup>(underlying->makeLookupTask(qtype, name));
+				shard.inflight.emplace(std::move(key), inflight);
+			}
 		}
-		return soup::make_unique<dnsLookupAndCacheTask>(*this, underlying->makeLookupTask(qtype, name));
+		return soup::make_unique<dnsLookupAndCacheTask>(*this, qtype, name, std::move(inflight));
 	}
 
-	std::vector<UniquePtr<dnsRecord>> dnsCacheResolver::findInCache(dnsType qtype, const std::string& name) const
+	Optional<std::vector<UniquePtr<dnsRecord>>> dnsCacheResolver::findInCache(dnsType qtype, const std::string& name) const
 	{
-		std::vector<UniquePtr<dnsRecord>> res;
-		for (auto i = cache.begin(); i != cache.end(); )
+		Key key{ qtype, name };
+		auto& shard = getShard(key);
+		std::lock_guard lock(shard.mutex);
+		return findInShard(shard, key, time::unixSeconds());
+	}
+
+	void dnsCacheResolver::addToCache(dnsType qtype, const std::string& name, const std::vector<UniquePtr<dnsRecord>>& records) const
+	{
+		const auto now = time::unixSeconds();
+		uint32_t ttl = (records.empty() ? negative_ttl : UINT32_MAX);
+		for (const auto& record : records)
+		{
+			ttl = std::min(ttl, record->ttl);
+		}
+		if (ttl == 0)
+		{
+			return;
+		}
+
+		Key key{ qtype, name };
+		auto& shard = getShard(key);
+		std::lock_guard lock(shard.mutex);
+		removeExpired(shard, now);
+		if (auto it = shard.index.find(key); it != shard.index.end())
+		{
+			erase(shard, it->second);
+		}
+		const size_t max_shard_entries = std::max<size_t>(1, max_entries / NUM_SHARDS);
+		while (shard.lru.size() >= max_shard_entries)
 		{
-			if (i->getExpiry() < time::unixSeconds())
-			{
-				i = cache.erase(i);				
 #if LOGGING
-				logWriteLine(format("[DNS Cache] {}@{} expired", dnsTypeToString(i->record->type), i->record->name));
+			logWriteLine(format("[DNS Cache] {}@{} evicted", dnsTypeToString(shard.lru.back().key.qtype), shard.lru.back().key.name));
 #endif
-				continue;
-			}
-			if (i->record->type == qtype
-				&& i->record->name == name
-				)
-			{
-				res.emplace_back(i->record->copy());
-			}
-			++i;
+			erase(shard, std::prev(shard.lru.end()));
 		}
 #if LOGGING
-		if (res.empty())
+		logWriteLine(format("[DNS Cache] {}@{} added for {} seconds", dnsTypeToString(qtype), name, ttl));
+#endif
+		shard.lru.emplace_front(Entry{ key, copyRecords(records), now + ttl, {} });
+		shard.lru.front().expiry_it = shard.expiries.emplace(now + ttl, shard.lru.begin());
+		shard.index.emplace(std::move(key), shard.lru.begin());
+	}
+
+	size_t dnsCacheResolver::getNumEntries() const noexcept
+	{
+		size_t num = 0;
+		for (auto& shard : shards)
+		{
+			std::lock_guard lock(shard.mutex);
+			num += shard.lru.size();
+		}
+		return num;
+	}
+
+	void dnsCacheResolver::clear() noexcept
+	{
+		for (auto& shard : shards)
 		{
-			logWriteLine(format("[DNS Cache] {}@{} miss", dnsTypeToString(qtype), name));
+			std::lock_guard lock(shard.mutex);
+			shard.index.clear();
+			shard.expiries.clear();
+			shard.lru.clear();
 		}
-		else
+	}
+
+	void dnsCacheResolver::finishInflightLookup(dnsType qtype, const std::string& name, const Optional<std::vector<UniquePtr<dnsRecord>>>& result) const
+	{
+		if (result.has_value())
 		{
-			logWriteLine(format("[DNS Cache] {}@{} hit", dnsTypeToString(qtype), name));
+			addToCache(qtype, name, *result);
 		}
+		Key key{ qtype, name };
+		auto& shard = getShard(key);
+		std::lock_guard lock(shard.mutex);
+		shard.inflight.erase(key);
+	}
+
+	dnsCacheResolver::Shard& dnsCacheResolver::getShard(const Key& key) const noexcept
+	{
+		return shards[KeyHash{}(key) % NUM_SHARDS];
+	}
+
+	void dnsCacheResolver::removeExpired(Shard& shard, time_t now) noexcept
+	{
+		while (!shard.expiries.empty()
+			&& shard.expiries.begin()->first <= now
+			)
+		{
+#if LOGGING
+			logWriteLine(format("[DNS Cache] {}@{} expired", dnsTypeToString(shard.expiries.begin()->second->key.qtype), shard.expiries.begin()->second->key.name));
 #endif
-		return res;
+			erase(shard, shard.expiries.begin()->second);
+		}
+	}
+
+	void dnsCacheResolver::erase(Shard& shard, std::list<Entry>::iterator it) noexcept
+	{
+		shard.index.erase(it->key);
+		shard.expiries.erase(it->expiry_it);
+		shard.lru.erase(it);
 	}
 
-	void dnsCacheResolver::addToCache(const std::vector<UniquePtr<dnsRecord>>& records) const
+	Optional<std::vector<UniquePtr<dnsRecord>>> dnsCacheResolver::findInShard(Shard& shard, const Key& key, time_t now)
 	{
-		if (!records.empty())
+		removeExpired(shard, now);
+		auto it = shard.index.find(key);
+		if (it == shard.index.end())
 		{
-			const auto t = time::unixSeconds();
-			for (const auto& record : records)
-			{
 #if LOGGING
-				logWriteLine(format("[DNS Cache] {}@{} added", dnsTypeToString(record->type), record->name));
+			logWriteLine(format("[DNS Cache] {}@{} miss", dnsTypeToString(key.qtype), key.name));
 #endif
-				cache.emplace_back(CachedRecord{ record->copy(), t });
-			}
+			return {};
+		}
+#if LOGGING
+		logWriteLine(format("[DNS Cache] {}@{} hit", dnsTypeToString(key.qtype), key.name));
+#endif
+		shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+		auto res = copyRecords(it->second->records);
+		for (auto& record : res)
+		{
+			record->ttl = static_cast<uint32_t>(it->second->expiry - now);
 		}
+		return res;
 	}
 }
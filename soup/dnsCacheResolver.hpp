@@ -2,27 +2,76 @@
 
 #include "dnsResolver.hpp"
 
+#include <list>
+#include <map>
+#include <unordered_map>
 #include <vector>
 
+#include "Mutex.hpp"
+#include "SharedPtr.hpp"
 #include "UniquePtr.hpp"
 
 NAMESPACE_SOUP
 {
+	// Shared by all tasks waiting for the same (qtype, name), so only one lookup is made. Whichever waiter gets the lock ticks the underlying task.
+	struct dnsCacheInflightLookup
+	{
+		Mutex mutex;
+		UniquePtr<dnsLookupTask> task;
+
+		dnsCacheInflightLookup(UniquePtr<dnsLookupTask>&& task) noexcept
+			: task(std::move(task))
+		{
+		}
+	};
+
+	// Caches the results of lookups by (qtype, name) until the smallest TTL in the answer expires.
+	// Answers without records (e.g. NXDOMAIN) are cached for negative_ttl seconds. Failed lookups are not cached.
+	// Safe to share between threads; the cache is split into shards that are locked independently.
 	struct dnsCacheResolver : public dnsResolver
 	{
-		struct CachedRecord
+		static constexpr size_t NUM_SHARDS = 16;
+
+		struct Key
 		{
-			UniquePtr<dnsRecord> record;
-			time_t obtained_at;
+			dnsType qtype;
+			std::string name;
 
-			[[nodiscard]] time_t getExpiry() const noexcept
+			[[nodiscard]] bool operator==(const Key& b) const noexcept
 			{
-				return obtained_at + record->ttl;
+				return qtype == b.qtype && name == b.name;
 			}
 		};
 
+		struct KeyHash
+		{
+			[[nodiscard]] size_t operator()(const Key& key) const noexcept
+			{
+				return std::hash<std::string>{}(key.name) ^ (static_cast<size_t>(key.qtype) * 0x9e3779b9);
+			}
+		};
+
+		struct Entry
+		{
+			Key key;
+			std::vector<UniquePtr<dnsRecord>> records;
+			time_t expiry;
+			std::multimap<time_t, std::list<Entry>::iterator>::iterator expiry_it;
+		};
+
+		struct Shard
+		{
+			Mutex mutex;
+			std::list<Entry> lru; // Most recently used first.
+			std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+			std::multimap<time_t, std::list<Entry>::iterator> expiries;
+			std::unordered_map<Key, SharedPtr<dnsCacheInflightLookup>, KeyHash> inflight;
+		};
+
 		UniquePtr<dnsResolver> underlying;
-		mutable std::vector<CachedRecord> cache;
+		size_t max_entries = 4096; // Per resolver; when exceeded, the least recently used entries are evicted.
+		uint32_t negative_ttl = 60;
+		mutable Shard shards[NUM_SHARDS];
 
 		dnsCacheResolver(UniquePtr<dnsResolver>&& underlying)
 			: underlying(std::move(underlying))
@@ -32,7 +81,19 @@ NAMESPACE_SOUP
 		[[nodiscard]] Optional<std::vector<UniquePtr<dnsRecord>>> lookup(dnsType qtype, const std::string& name) const final;
 		[[nodiscard]] UniquePtr<dnsLookupTask> makeLookupTask(dnsType qtype, const std::string& name) const final;
 
-		[[nodiscard]] std::vector<UniquePtr<dnsRecord>> findInCache(dnsType qtype, const std::string& name) const;
-		void addToCache(const std::vector<UniquePtr<dnsRecord>>& records) const;
+		// Returns an empty Optional on miss, and an empty vector for a cached negative answer.
+		[[nodiscard]] Optional<std::vector<UniquePtr<dnsRecord>>> findInCache(dnsType qtype, const std::string& name) const;
+		void addToCache(dnsType qtype, const std::string& name, const std::vector<UniquePtr<dnsRecord>>& records) const;
+
+		[[nodiscard]] size_t getNumEntries() const noexcept;
+		void clear() noexcept;
+
+		void finishInflightLookup(dnsType qtype, const std::string& name, const Optional<std::vector<UniquePtr<dnsRecord>>>& result) const;
+
+	protected:
+		[[nodiscard]] Shard& getShard(const Key& key) const noexcept;
+		static void removeExpired(Shard& shard, time_t now) noexcept;
+		static void erase(Shard& shard, std::list<Entry>::iterator it) noexcept;
+		[[nodiscard]] static Optional<std::vector<UniquePtr<dnsRecord>>> findInShard(Shard& shard, const Key& key, time_t now);
 	};
 }
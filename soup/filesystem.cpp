@@ -134,6 +134,10 @@ NAMESPACE_SOUP
 			{
 				out_len = st.st_size;
 				addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, f, 0);
+				if (addr == MAP_FAILED)
+				{
+					addr = nullptr;
+				}
 			}
 			::close(f);
 		}
@@ -19,7 +19,7 @@ NAMESPACE_SOUP
 		[[nodiscard]] static std::filesystem::path tempfile(const std::string& ext = {});
 		[[nodiscard]] static std::filesystem::path getProgramData() SOUP_EXCAL;
 
-		[[nodiscard]] static void* createFileMapping(const std::filesystem::path& path, size_t& out_len);
+		[[nodiscard]] static void* createFileMapping(const std::filesystem::path& path, size_t& out_len); // returns nullptr on error
 		static void destroyFileMapping(void* addr, size_t len);
 	};
 }
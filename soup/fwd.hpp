@@ -40,8 +40,12 @@ NAMESPACE_SOUP
 	struct JsonBool;
 	struct JsonFloat;
 	struct JsonInt;
+	struct JsonNode;
 	struct JsonObject;
+	class JsonReader;
 	struct JsonString;
+	class JsonTape;
+	class JsonWriter;
 
 	// data.reflection
 	class drData;
@@ -80,6 +84,9 @@ NAMESPACE_SOUP
 	class Writer;
 	class StringWriter;
 
+	// lang
+	struct WasmScript;
+
 	// lang.compiler
 	struct astBlock;
 	struct astNode;
@@ -144,6 +151,7 @@ NAMESPACE_SOUP
 	class IpAddr;
 	struct netConfig;
 	class netIntel;
+	class netIntelSnapshot;
 	enum netStatus : uint8_t;
 	class Server;
 	struct ServerService;
@@ -162,6 +170,7 @@ NAMESPACE_SOUP
 	struct TlsClientHello;
 
 	// net.web
+	class HttpConnectionTask;
 	class HttpRequest;
 	class HttpRequestTask;
 	struct HttpResponse;
@@ -0,0 +1,559 @@
+#include "hpack.hpp"
+
+#include <cstring> // memcmp
+
+NAMESPACE_SOUP
+{
+	struct HuffmanCode
+	{
+		uint32_t code;
+		uint8_t bits;
+	};
+
+	// RFC 7541, Appendix B. Symbol 256 is EOS.
+	static constexpr HuffmanCode huffman_codes[257] = {
+		{ 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 }, { 0xfffffe4, 28 }, { 0xfffffe5, 28 }, { 0xfffffe6, 28 }, { 0xfffffe7, 28 },
+		{ 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 }, { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 },
+		{ 0xfffffed, 28 }, { 0xfffffee, 28 }, { 0xfffffef, 28 }, { 0xffffff0, 28 }, { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+		{ 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 }, { 0xffffff8, 28 }, { 0xffffff9, 28 }, { 0xffffffa, 28 }, { 0xffffffb, 28 },
+		{ 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 }, { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 },
+		{ 0x3fa, 10 }, { 0x3fb, 10 }, { 0xf9, 8 }, { 0x7fb, 11 }, { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+		{ 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 }, { 0x1a, 6 }, { 0x1b, 6 }, { 0x1c, 6 }, { 0x1d, 6 },
+		{ 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 }, { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 },
+		{ 0x1ffa, 13 }, { 0x21, 6 }, { 0x5d, 7 }, { 0x5e, 7 }, { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+		{ 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 }, { 0x67, 7 }, { 0x68, 7 }, { 0x69, 7 }, { 0x6a, 7 },
+		{ 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 }, { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 },
+		{ 0xfc, 8 }, { 0x73, 7 }, { 0xfd, 8 }, { 0x1ffb, 13 }, { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+		{ 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 }, { 0x24, 6 }, { 0x5, 5 }, { 0x25, 6 }, { 0x26, 6 },
+		{ 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 }, { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 },
+		{ 0x2b, 6 }, { 0x76, 7 }, { 0x2c, 6 }, { 0x8, 5 }, { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+		{ 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 }, { 0x7fc, 11 }, { 0x3ffd, 14 }, { 0x1ffd, 13 }, { 0xffffffc, 28 },
+		{ 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 }, { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 },
+		{ 0x3fffd6, 22 }, { 0x7fffda, 23 }, { 0x7fffdb, 23 }, { 0x7fffdc, 23 }, { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+		{ 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 }, { 0xffffee, 24 }, { 0x7fffe1, 23 }, { 0x7fffe2, 23 }, { 0x7fffe3, 23 },
+		{ 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 }, { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 },
+		{ 0x3fffda, 22 }, { 0x1fffdd, 21 }, { 0xfffe9, 20 }, { 0x3fffdb, 22 }, { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+		{ 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 }, { 0x1fffdf, 21 }, { 0x3fffdf, 22 }, { 0x7fffeb, 23 }, { 0x7fffec, 23 },
+		{ 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 }, { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 },
+		{ 0xfffea, 20 }, { 0x3fffe2, 22 }, { 0x3fffe3, 22 }, { 0x3fffe4, 22 }, { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+		{ 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 }, { 0x3fffe7, 22 }, { 0x7ffff2, 23 }, { 0x3fffe8, 22 }, { 0x1ffffec, 25 },
+		{ 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 }, { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 },
+		{ 0x7fff2, 19 }, { 0x1fffe3, 21 }, { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 }, { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+		{ 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 }, { 0xffffffd, 28 }, { 0x7ffffe3, 27 }, { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 },
+		{ 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 }, { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 },
+		{ 0x3fffea, 22 }, { 0x3fffeb, 22 }, { 0x1ffffee, 25 }, { 0x1ffffef, 25 }, { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+		{ 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 }, { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 }, { 0x7ffffe9, 27 }, { 0x7ffffea, 27 },
+		{ 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 }, { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 },
+		{ 0x3fffffff, 30 },
+	};
+
+	// The code is canonical, so for each length we only need the range of (left-aligned) codes it covers and where its symbols start in code order.
+	struct HuffmanDecodeTable
+	{
+		uint64_t limit[31]; // Left-aligned codes of this length are less than this.
+		uint32_t first_code[31]; // Left-aligned
+		uint16_t first_index[31];
+		uint16_t symbols[257];
+
+		HuffmanDecodeTable() noexcept
+		{
+			uint16_t n = 0;
+			uint64_t code = 0;
+			for (uint8_t len = 1; len != 31; ++len)
+			{
+				first_index[len] = n;
+				first_code[len] = static_cast<uint32_t>(code << (32 - len));
+				for (uint16_t sym = 0; sym != 257; ++sym)
+				{
+					if (huffman_codes[sym].bits == len)
+					{
+						symbols[n++] = sym;
+						++code;
+					}
+				}
+				limit[len] = code << (32 - len);
+				code <<= 1;
+			}
+		}
+	};
+
+	static const HuffmanDecodeTable& getHuffmanDecodeTable() noexcept
+	{
+		static HuffmanDecodeTable table;
+		return table;
+	}
+
+	size_t hpack::getHuffmanEncodedSize(const std::string& str) noexcept
+	{
+		size_t bits = 0;
+		for (const auto& c : str)
+		{
+			bits += huffman_codes[static_cast<uint8_t>(c)].bits;
+		}
+		return (bits + 7) / 8;
+	}
+
+	void hpack::huffmanEncode(std::string& out, const std::string& str) SOUP_EXCAL
+	{
+		uint64_t acc = 0;
+		uint8_t acc_bits = 0;
+		for (const auto& c : str)
+		{
+			const auto& hc = huffman_codes[static_cast<uint8_t>(c)];
+			acc = (acc << hc.bits) | hc.code;
+			acc_bits += hc.bits;
+			while (acc_bits >= 8)
+			{
+				acc_bits -= 8;
+				out.push_back(static_cast<char>(acc >> acc_bits));
+			}
+		}
+		if (acc_bits != 0)
+		{
+			// Pad with the most significant bits of EOS, which are all 1.
+			out.push_back(static_cast<char>((acc << (8 - acc_bits)) | (0xFF >> acc_bits)));
+		}
+	}
+
+	bool hpack::huffmanDecode(std::string& out, const uint8_t* data, size_t size) SOUP_EXCAL
+	{
+		const auto& table = getHuffmanDecodeTable();
+		uint64_t acc = 0;
+		uint8_t acc_bits = 0;
+		const uint8_t* const end = data + size;
+		while (true)
+		{
+			while (acc_bits <= 56 && data != end)
+			{
+				acc |= static_cast<uint64_t>(*data++) << (56 - acc_bits);
+				acc_bits += 8;
+			}
+			if (acc_bits == 0)
+			{
+				break;
+			}
+			const auto peek = static_cast<uint32_t>(acc >> 32);
+			uint8_t len = 5;
+			while (len != 31 && peek >= table.limit[len])
+			{
+				++len;
+			}
+			if (len > acc_bits)
+			{
+				// Not enough bits left for a symbol, so what remains must be padding: fewer than 8 bits, all 1.
+				return acc_bits < 8 && peek == (0xFFFFFFFFu << (32 - acc_bits));
+			}
+			SOUP_IF_UNLIKELY (len == 31)
+			{
+				return false;
+			}
+			const auto sym = table.symbols[table.first_index[len] + ((peek - table.first_code[len]) >> (32 - len))];
+			SOUP_IF_UNLIKELY (sym == 256)
+			{
+				return false; // EOS must not appear in a string literal
+			}
+			out.push_back(static_cast<char>(sym));
+			acc <<= len;
+			acc_bits -= len;
+		}
+		return true;
+	}
+
+	void hpack::encodeInteger(std::string& out, uint8_t first_byte_flags, uint8_t prefix_bits, size_t value) SOUP_EXCAL
+	{
+		const size_t max_prefix = (1u << prefix_bits) - 1;
+		if (value < max_prefix)
+		{
+			out.push_back(static_cast<char>(first_byte_flags | value));
+			return;
+		}
+		out.push_back(static_cast<char>(first_byte_flags | max_prefix));
+		value -= max_prefix;
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	bool hpack::decodeInteger(const uint8_t*& it, const uint8_t* end, uint8_t prefix_bits, size_t& value) noexcept
+	{
+		SOUP_IF_UNLIKELY (it == end)
+		{
+			return false;
+		}
+		const size_t max_prefix = (1u << prefix_bits) - 1;
+		value = *it++ & max_prefix;
+		if (value != max_prefix)
+		{
+			return true;
+		}
+		for (uint8_t shift = 0; shift <= 28; shift += 7)
+		{
+			SOUP_IF_UNLIKELY (it == end)
+			{
+				return false;
+			}
+			const uint8_t b = *it++;
+			value += static_cast<size_t>(b & 0x7F) << shift;
+			if (!(b & 0x80))
+			{
+				return true;
+			}
+		}
+		return false; // Larger than we'd ever accept
+	}
+
+	void hpack::encodeString(std::string& out, const std::string& str) SOUP_EXCAL
+	{
+		const auto huffman_size = getHuffmanEncodedSize(str);
+		if (huffman_size < str.size())
+		{
+			encodeInteger(out, 0x80, 7, huffman_size);
+			huffmanEncode(out, str);
+		}
+		else
+		{
+			encodeInteger(out, 0, 7, str.size());
+			out.append(str);
+		}
+	}
+
+	bool hpack::decodeString(const uint8_t*& it, const uint8_t* end, std::string& out) SOUP_EXCAL
+	{
+		SOUP_IF_UNLIKELY (it == end)
+		{
+			return false;
+		}
+		const bool huffman = (*it & 0x80);
+		size_t len;
+		SOUP_IF_UNLIKELY (!decodeInteger(it, end, 7, len)
+			|| len > static_cast<size_t>(end - it)
+			)
+		{
+			return false;
+		}
+		out.clear();
+		if (huffman)
+		{
+			out.reserve(len + (len / 2));
+			SOUP_IF_UNLIKELY (!huffmanDecode(out, it, len))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			out.assign(reinterpret_cast<const char*>(it), len);
+		}
+		it += len;
+		return true;
+	}
+
+	// RFC 7541, Appendix A.
+	static const hpack::header_t static_table[HpackTable::STATIC_TABLE_SIZE] = {
+		{ ":authority", "" },
+		{ ":method", "GET" },
+		{ ":method", "POST" },
+		{ ":path", "/" },
+		{ ":path", "/index.html" },
+		{ ":scheme", "http" },
+		{ ":scheme", "https" },
+		{ ":status", "200" },
+		{ ":status", "204" },
+		{ ":status", "206" },
+		{ ":status", "304" },
+		{ ":status", "400" },
+		{ ":status", "404" },
+		{ ":status", "500" },
+		{ "accept-charset", "" },
+		{ "accept-encoding", "gzip, deflate" },
+		{ "accept-language", "" },
+		{ "accept-ranges", "" },
+		{ "accept", "" },
+		{ "access-control-allow-origin", "" },
+		{ "age", "" },
+		{ "allow", "" },
+		{ "authorization", "" },
+		{ "cache-control", "" },
+		{ "content-disposition", "" },
+		{ "content-encoding", "" },
+		{ "content-language", "" },
+		{ "content-length", "" },
+		{ "content-location", "" },
+		{ "content-range", "" },
+		{ "content-type", "" },
+		{ "cookie", "" },
+		{ "date", "" },
+		{ "etag", "" },
+		{ "expect", "" },
+		{ "expires", "" },
+		{ "from", "" },
+		{ "host", "" },
+		{ "if-match", "" },
+		{ "if-modified-since", "" },
+		{ "if-none-match", "" },
+		{ "if-range", "" },
+		{ "if-unmodified-since", "" },
+		{ "last-modified", "" },
+		{ "link", "" },
+		{ "location", "" },
+		{ "max-forwards", "" },
+		{ "proxy-authenticate", "" },
+		{ "proxy-authorization", "" },
+		{ "range", "" },
+		{ "referer", "" },
+		{ "refresh", "" },
+		{ "retry-after", "" },
+		{ "server", "" },
+		{ "set-cookie", "" },
+		{ "strict-transport-security", "" },
+		{ "transfer-encoding", "" },
+		{ "user-agent", "" },
+		{ "vary", "" },
+		{ "via", "" },
+		{ "www-authenticate", "" },
+	};
+
+	[[nodiscard]] static size_t hpack_entrySize(const hpack::header_t& e) noexcept
+	{
+		return e.first.size() + e.second.size() + 32;
+	}
+
+	const hpack::header_t& HpackTable::getStatic(size_t index) noexcept
+	{
+		return static_table[index - 1];
+	}
+
+	const hpack::header_t* HpackTable::get(size_t index) const noexcept
+	{
+		SOUP_IF_UNLIKELY (index == 0)
+		{
+			return nullptr;
+		}
+		if (index <= STATIC_TABLE_SIZE)
+		{
+			return &static_table[index - 1];
+		}
+		index -= (STATIC_TABLE_SIZE + 1);
+		SOUP_IF_UNLIKELY (index >= dynamic.size())
+		{
+			return nullptr;
+		}
+		return &dynamic[index];
+	}
+
+	void HpackTable::insert(std::string name, std::string value) SOUP_EXCAL
+	{
+		const size_t entry_size = name.size() + value.size() + 32;
+		if (entry_size > capacity)
+		{
+			// An entry larger than the table empties it and is not added.
+			dynamic.clear();
+			size = 0;
+			return;
+		}
+		dynamic.emplace_front(std::move(name), std::move(value));
+		size += entry_size;
+		evict();
+	}
+
+	void HpackTable::setCapacity(size_t capacity) noexcept
+	{
+		this->capacity = capacity;
+		evict();
+	}
+
+	void HpackTable::evict() noexcept
+	{
+		while (size > capacity)
+		{
+			size -= hpack_entrySize(dynamic.back());
+			dynamic.pop_back();
+		}
+	}
+
+	bool HpackDecoder::decode(const std::string& block, std::vector<hpack::header_t>& out) SOUP_EXCAL
+	{
+		const auto* it = reinterpret_cast<const uint8_t*>(block.data());
+		const auto* const end = it + block.size();
+		size_t list_size = 0;
+		bool may_update_size = true;
+		while (it != end)
+		{
+			const uint8_t b = *it;
+			if (b & 0x80)
+			{
+				// Indexed header field
+				size_t index;
+				SOUP_IF_UNLIKELY (!hpack::decodeInteger(it, end, 7, index))
+				{
+					return false;
+				}
+				const auto* e = table.get(index);
+				SOUP_IF_UNLIKELY (!e)
+				{
+					return false;
+				}
+				out.emplace_back(*e);
+			}
+			else if ((b & 0xE0) == 0x20)
+			{
+				// Dynamic table size update, only allowed at the start of a block.
+				size_t capacity;
+				SOUP_IF_UNLIKELY (!may_update_size
+					|| !hpack::decodeInteger(it, end, 5, capacity)
+					|| capacity > max_table_size
+					)
+				{
+					return false;
+				}
+				table.setCapacity(capacity);
+				continue;
+			}
+			else
+			{
+				// Literal header field: with incremental indexing (01), without indexing (0000) or never indexed (0001).
+				const bool indexing = (b & 0x40);
+				size_t index;
+				SOUP_IF_UNLIKELY (!hpack::decodeInteger(it, end, indexing ? 6 : 4, index))
+				{
+					return false;
+				}
+				hpack::header_t h;
+				if (index != 0)
+				{
+					const auto* e = table.get(index);
+					SOUP_IF_UNLIKELY (!e)
+					{
+						return false;
+					}
+					h.first = e->first;
+				}
+				else
+				{
+					SOUP_IF_UNLIKELY (!hpack::decodeString(it, end, h.first))
+					{
+						return false;
+					}
+				}
+				SOUP_IF_UNLIKELY (!hpack::decodeString(it, end, h.second))
+				{
+					return false;
+				}
+				if (indexing)
+				{
+					table.insert(h.first, h.second);
+				}
+				out.emplace_back(std::move(h));
+			}
+			may_update_size = false;
+			list_size += hpack_entrySize(out.back());
+			SOUP_IF_UNLIKELY (list_size > max_header_list_size)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void HpackEncoder::setMaxTableSize(size_t size) noexcept
+	{
+		if (size > hpack::DEFAULT_TABLE_SIZE)
+		{
+			size = hpack::DEFAULT_TABLE_SIZE; // No need for a bigger table than what we'd use by default.
+		}
+		if (size < pending_min_capacity)
+		{
+			pending_min_capacity = size;
+		}
+		pending_capacity = size;
+	}
+
+	std::string HpackEncoder::encode(const std::vector<hpack::header_t>& headers) SOUP_EXCAL
+	{
+		std::string out{};
+		if (pending_capacity != (size_t)-1)
+		{
+			if (pending_min_capacity < pending_capacity)
+			{
+				hpack::encodeInteger(out, 0x20, 5, pending_min_capacity);
+			}
+			hpack::encodeInteger(out, 0x20, 5, pending_capacity);
+			table.setCapacity(pending_capacity);
+			pending_capacity = -1;
+			pending_min_capacity = -1;
+		}
+		for (const auto& h : headers)
+		{
+			// Find the best match in the tables.
+			size_t name_index = 0;
+			size_t full_index = 0;
+			for (size_t i = 0; i != HpackTable::STATIC_TABLE_SIZE; ++i)
+			{
+				if (static_table[i].first == h.first)
+				{
+					if (name_index == 0)
+					{
+						name_index = i + 1;
+					}
+					if (static_table[i].second == h.second)
+					{
+						full_index = i + 1;
+						break;
+					}
+				}
+			}
+			if (full_index == 0)
+			{
+				for (size_t i = 0; i != table.dynamic.size(); ++i)
+				{
+					if (table.dynamic[i].first == h.first)
+					{
+						if (name_index == 0)
+						{
+							name_index = HpackTable::STATIC_TABLE_SIZE + 1 + i;
+						}
+						if (table.dynamic[i].second == h.second)
+						{
+							full_index = HpackTable::STATIC_TABLE_SIZE + 1 + i;
+							break;
+						}
+					}
+				}
+			}
+
+			if (full_index != 0)
+			{
+				hpack::encodeInteger(out, 0x80, 7, full_index);
+				continue;
+			}
+
+			const bool sensitive = (h.first == "authorization" || h.first == "proxy-authorization");
+			const bool index = !sensitive
+				&& h.first != ":path"
+				&& h.first != "content-length"
+				&& hpack_entrySize(h) <= table.capacity / 2
+				;
+			if (index)
+			{
+				hpack::encodeInteger(out, 0x40, 6, name_index);
+			}
+			else
+			{
+				hpack::encodeInteger(out, sensitive ? 0x10 : 0x00, 4, name_index);
+			}
+			if (name_index == 0)
+			{
+				hpack::encodeString(out, h.first);
+			}
+			hpack::encodeString(out, h.second);
+			if (index)
+			{
+				table.insert(h.first, h.second);
+			}
+		}
+		return out;
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base.hpp"
+
+NAMESPACE_SOUP
+{
+	// HPACK (RFC 7541), the header compression used by HTTP/2.
+	// Both sides of a connection keep a dynamic table in sync, so every header block must be processed in the order it's sent or received.
+
+	struct hpack
+	{
+		using header_t = std::pair<std::string, std::string>;
+
+		static constexpr size_t DEFAULT_TABLE_SIZE = 4096;
+
+		[[nodiscard]] static size_t getHuffmanEncodedSize(const std::string& str) noexcept;
+		static void huffmanEncode(std::string& out, const std::string& str) SOUP_EXCAL;
+		[[nodiscard]] static bool huffmanDecode(std::string& out, const uint8_t* data, size_t size) SOUP_EXCAL;
+
+		static void encodeInteger(std::string& out, uint8_t first_byte_flags, uint8_t prefix_bits, size_t value) SOUP_EXCAL;
+		[[nodiscard]] static bool decodeInteger(const uint8_t*& it, const uint8_t* end, uint8_t prefix_bits, size_t& value) noexcept;
+
+		static void encodeString(std::string& out, const std::string& str) SOUP_EXCAL; // Huffman-coded if that's shorter.
+		[[nodiscard]] static bool decodeString(const uint8_t*& it, const uint8_t* end, std::string& out) SOUP_EXCAL;
+	};
+
+	class HpackTable
+	{
+	public:
+		static constexpr size_t STATIC_TABLE_SIZE = 61;
+
+		std::deque<hpack::header_t> dynamic{}; // Newest first.
+		size_t size = 0; // As defined by RFC 7541 § 4.1: 32 bytes overhead per entry.
+		size_t capacity = hpack::DEFAULT_TABLE_SIZE;
+
+		[[nodiscard]] static const hpack::header_t& getStatic(size_t index) noexcept; // 1-based
+
+		[[nodiscard]] const hpack::header_t* get(size_t index) const noexcept; // 1-based, spanning the static & dynamic table.
+		void insert(std::string name, std::string value) SOUP_EXCAL;
+		void setCapacity(size_t capacity) noexcept;
+
+	protected:
+		void evict() noexcept;
+	};
+
+	class HpackDecoder
+	{
+	public:
+		HpackTable table{};
+		size_t max_table_size = hpack::DEFAULT_TABLE_SIZE; // The SETTINGS_HEADER_TABLE_SIZE we advertised.
+		size_t max_header_list_size = 0x10000; // Decoding fails if the headers of a block exceed this, counted as in RFC 7540 § 6.5.2.
+
+		// Appends the headers in the block to 'out'. Returns false on a compression error, after which the connection can't be used anymore.
+		[[nodiscard]] bool decode(const std::string& block, std::vector<hpack::header_t>& out) SOUP_EXCAL;
+	};
+
+	class HpackEncoder
+	{
+	public:
+		HpackTable table{};
+
+	protected:
+		size_t pending_capacity = -1; // A dynamic table size update to signal at the start of the next block.
+		size_t pending_min_capacity = -1;
+
+	public:
+		void setMaxTableSize(size_t size) noexcept; // From the peer's SETTINGS_HEADER_TABLE_SIZE.
+
+		// Names must be lowercase. Headers whose values are sensitive or unlikely to repeat, like :path, are not added to the dynamic table.
+		[[nodiscard]] std::string encode(const std::vector<hpack::header_t>& headers) SOUP_EXCAL;
+	};
+}
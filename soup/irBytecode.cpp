@@ -0,0 +1,727 @@
+#include "irBytecode.hpp"
+
+#include <algorithm> // max
+
+#include "Optional.hpp"
+
+NAMESPACE_SOUP
+{
+	static constexpr uint16_t IR_BC_NO_REG = 0xFFFF;
+
+	struct irBytecodeOperand
+	{
+		bool is_const;
+		uint16_t reg;
+		int64_t value; // sign-extended from the value's type
+
+		[[nodiscard]] static irBytecodeOperand fromReg(uint16_t reg) noexcept
+		{
+			return irBytecodeOperand{ false, reg, 0 };
+		}
+
+		[[nodiscard]] static irBytecodeOperand fromConst(int64_t value) noexcept
+		{
+			return irBytecodeOperand{ true, IR_BC_NO_REG, value };
+		}
+	};
+
+	[[nodiscard]] static bool irBytecodeHasEffects(const irExpression& e) noexcept
+	{
+		switch (e.type)
+		{
+		case IR_LOCAL_SET:
+		case IR_CALL:
+		case IR_IFELSE:
+		case IR_WHILE:
+		case IR_STORE_I8:
+		case IR_STORE_I32:
+		case IR_STORE_I64:
+			return true;
+
+		default:;
+		}
+		for (const auto& child : e.children)
+		{
+			if (irBytecodeHasEffects(*child))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	[[nodiscard]] static Optional<int64_t> irBytecodeFold(irExpressionType type, int64_t a, int64_t b) noexcept
+	{
+		const auto ua = static_cast<uint64_t>(a);
+		const auto ub = static_cast<uint64_t>(b);
+		switch (type)
+		{
+		case IR_ADD_I32: return static_cast<int32_t>(static_cast<uint32_t>(ua + ub));
+		case IR_ADD_I64: case IR_ADD_PTR: return static_cast<int64_t>(ua + ub);
+		case IR_SUB_I32: return static_cast<int32_t>(static_cast<uint32_t>(ua - ub));
+		case IR_SUB_I64: return static_cast<int64_t>(ua - ub);
+		case IR_MUL_I64: return static_cast<int64_t>(ua * ub);
+		case IR_SDIV_I64: if (b == 0) { break; } return b == -1 ? static_cast<int64_t>(0 - ua) : a / b;
+		case IR_UDIV_I64: if (b == 0) { break; } return static_cast<int64_t>(ua / ub);
+		case IR_SMOD_I64: if (b == 0) { break; } return b == -1 ? 0 : a % b;
+		case IR_UMOD_I64: if (b == 0) { break; } return static_cast<int64_t>(ua % ub);
+		case IR_EQUALS_I8: return static_cast<int8_t>(a) == static_cast<int8_t>(b);
+		case IR_EQUALS_I32: return static_cast<int32_t>(a) == static_cast<int32_t>(b);
+		case IR_EQUALS_I64: return a == b;
+		case IR_NOTEQUALS_I8: return static_cast<int8_t>(a) != static_cast<int8_t>(b);
+		case IR_NOTEQUALS_I32: return static_cast<int32_t>(a) != static_cast<int32_t>(b);
+		case IR_NOTEQUALS_I64: return a != b;
+		default:;
+		}
+		return std::nullopt;
+	}
+
+	struct irBytecodeCompiler
+	{
+		const irModule& m;
+		const irFunction& fn;
+		irBytecode::Function& out;
+		std::vector<bool> local_read;
+		uint32_t next_reg;
+
+		irBytecodeCompiler(const irModule& m, const irFunction& fn, irBytecode::Function& out)
+			: m(m), fn(fn), out(out), local_read(fn.parameters.size() + fn.locals.size(), false), next_reg(static_cast<uint32_t>(fn.parameters.size() + fn.locals.size()))
+		{
+			SOUP_ASSERT(next_reg < IR_BC_NO_REG);
+			out.parameters = fn.parameters;
+			out.num_locals = next_reg;
+			out.num_regs = next_reg;
+		}
+
+		irBytecode::Insn& emit(irBytecodeOp op)
+		{
+			return out.insns.emplace_back(irBytecode::Insn{ op, 0, 0, 0, 0, 0 });
+		}
+
+		[[nodiscard]] uint32_t pos() const noexcept
+		{
+			return static_cast<uint32_t>(out.insns.size());
+		}
+
+		[[nodiscard]] uint16_t allocReg()
+		{
+			SOUP_ASSERT(next_reg < IR_BC_NO_REG, "irBytecode: too many registers");
+			out.num_regs = std::max(out.num_regs, next_reg + 1);
+			return static_cast<uint16_t>(next_reg++);
+		}
+
+		[[nodiscard]] uint16_t toReg(const irBytecodeOperand& op)
+		{
+			if (!op.is_const)
+			{
+				return op.reg;
+			}
+			const auto reg = allocReg();
+			auto& insn = emit(IR_BC_CONST);
+			insn.dst = reg;
+			insn.imm = op.value;
+			return reg;
+		}
+
+		void moveTo(uint16_t dst, const irBytecodeOperand& op)
+		{
+			if (op.is_const)
+			{
+				auto& insn = emit(IR_BC_CONST);
+				insn.dst = dst;
+				insn.imm = op.value;
+			}
+			else if (op.reg != dst)
+			{
+				auto& insn = emit(IR_BC_MOV);
+				insn.dst = dst;
+				insn.a = op.reg;
+			}
+		}
+
+		void markReads(const irExpression& e)
+		{
+			if (e.type == IR_LOCAL_GET)
+			{
+				local_read.at(e.local_get.index) = true;
+			}
+			for (const auto& child : e.children)
+			{
+				markReads(*child);
+			}
+		}
+
+		void compileFunction()
+		{
+			for (const auto& insn : fn.insns)
+			{
+				markReads(*insn);
+			}
+			for (const auto& insn : fn.insns)
+			{
+				if (insn->type == IR_RET)
+				{
+					// Instructions after this are never executed, like in irVm.
+					std::vector<irBytecodeOperand> values{};
+					for (const auto& child : insn->children)
+					{
+						for (const auto& value : compileValues(*child))
+						{
+							values.emplace_back(value);
+						}
+						appendResultTypes(*child);
+					}
+					compileReturn(values);
+					return;
+				}
+				compileStatement(*insn);
+			}
+			compileReturn({});
+		}
+
+		// Frontends don't always declare the return types, so they are taken from the values, which is also what irVm does.
+		void appendResultTypes(const irExpression& e)
+		{
+			if (e.type == IR_CALL)
+			{
+				if (e.call.index >= 0)
+				{
+					const auto& callee = m.func_exports.at(e.call.index);
+					out.returns.insert(out.returns.end(), callee.returns.begin(), callee.returns.end());
+				}
+				else
+				{
+					out.returns.emplace_back(IR_I64);
+				}
+			}
+			else if (e.type == IR_DISCARD)
+			{
+				appendResultTypes(*e.children.at(0));
+				out.returns.resize(out.returns.size() - e.discard.count);
+			}
+			else
+			{
+				out.returns.emplace_back(e.getResultType(fn));
+			}
+		}
+
+		void compileReturn(const std::vector<irBytecodeOperand>& values)
+		{
+			uint16_t base;
+			if (values.size() == 1 && !values[0].is_const)
+			{
+				base = values[0].reg;
+			}
+			else
+			{
+				base = static_cast<uint16_t>(next_reg);
+				for (const auto& value : values)
+				{
+					moveTo(allocReg(), value);
+				}
+			}
+			auto& insn = emit(IR_BC_RET);
+			insn.a = base;
+			insn.b = static_cast<uint16_t>(values.size());
+		}
+
+		void compileStatements(const irExpression& e, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i != end; ++i)
+			{
+				compileStatement(*e.children[i]);
+			}
+		}
+
+		void compileStatement(const irExpression& e)
+		{
+			const auto mark = next_reg;
+			switch (e.type)
+			{
+			case IR_LOCAL_SET:
+				if (local_read.at(e.local_set.index))
+				{
+					moveTo(static_cast<uint16_t>(e.local_set.index), compileValue(*e.children.at(0), static_cast<uint16_t>(e.local_set.index)));
+				}
+				else
+				{
+					compileEffects(*e.children.at(0));
+				}
+				break;
+
+			case IR_IFELSE:
+				{
+					const auto has_else = (1 + e.ifelse.ifinsns != e.children.size());
+					bool taken;
+					const auto j = compileJump(*e.children.at(0), false, taken);
+					next_reg = mark;
+					if (!j.has_value())
+					{
+						// The condition is constant.
+						if (taken)
+						{
+							compileStatements(e, 1 + e.ifelse.ifinsns, e.children.size());
+						}
+						else
+						{
+							compileStatements(e, 1, 1 + e.ifelse.ifinsns);
+						}
+						break;
+					}
+					compileStatements(e, 1, 1 + e.ifelse.ifinsns);
+					if (has_else)
+					{
+						const auto j_end = pos();
+						emit(IR_BC_JMP);
+						out.insns[*j].target = pos();
+						compileStatements(e, 1 + e.ifelse.ifinsns, e.children.size());
+						out.insns[j_end].target = pos();
+					}
+					else
+					{
+						out.insns[*j].target = pos();
+					}
+				}
+				break;
+
+			case IR_WHILE:
+				{
+					// The condition goes after the body, so each iteration only takes one branch.
+					const auto j_cond = pos();
+					emit(IR_BC_JMP);
+					const auto body = pos();
+					compileStatements(e, 1, e.children.size());
+					out.insns[j_cond].target = pos();
+					bool taken;
+					const auto j = compileJump(*e.children.at(0), true, taken);
+					if (j.has_value())
+					{
+						out.insns[*j].target = body;
+					}
+					else if (taken)
+					{
+						emit(IR_BC_JMP).target = body;
+					}
+					else
+					{
+						// The body never runs, but the condition is still evaluated once.
+						out.insns.resize(j_cond);
+						next_reg = mark;
+						compileEffects(*e.children.at(0));
+					}
+				}
+				break;
+
+			case IR_STORE_I8:
+			case IR_STORE_I32:
+			case IR_STORE_I64:
+				{
+					int64_t offset = 0;
+					const auto base = toReg(compileAddress(*e.children.at(0), offset));
+					const auto value = toReg(compileValue(*e.children.at(1)));
+					auto& insn = emit(e.type == IR_STORE_I8 ? IR_BC_STORE_I8 : e.type == IR_STORE_I32 ? IR_BC_STORE_I32 : IR_BC_STORE_I64);
+					insn.a = base;
+					insn.b = value;
+					insn.imm = offset;
+				}
+				break;
+
+			default:
+				compileEffects(e);
+				break;
+			}
+			next_reg = mark;
+		}
+
+		// Compiles only what has an effect, for an expression whose value is not used.
+		void compileEffects(const irExpression& e)
+		{
+			if (!irBytecodeHasEffects(e))
+			{
+				return;
+			}
+			switch (e.type)
+			{
+			case IR_CALL:
+				{
+					const auto mark = next_reg;
+					emitCall(e);
+					next_reg = mark;
+				}
+				break;
+
+			case IR_LOCAL_SET:
+			case IR_IFELSE:
+			case IR_WHILE:
+			case IR_STORE_I8:
+			case IR_STORE_I32:
+			case IR_STORE_I64:
+				compileStatement(e);
+				break;
+
+			default:
+				for (const auto& child : e.children)
+				{
+					compileEffects(*child);
+				}
+				break;
+			}
+		}
+
+		// Folds a constant offset in the address into the instruction.
+		[[nodiscard]] irBytecodeOperand compileAddress(const irExpression& e, int64_t& offset)
+		{
+			if (e.type == IR_ADD_PTR)
+			{
+				const auto a = compileValue(*e.children.at(0));
+				const auto b = compileValue(*e.children.at(1));
+				if (a.is_const && b.is_const)
+				{
+					return irBytecodeOperand::fromConst(a.value + b.value);
+				}
+				if (b.is_const)
+				{
+					offset = b.value;
+					return a;
+				}
+				if (a.is_const)
+				{
+					offset = a.value;
+					return b;
+				}
+				const auto dst = allocReg();
+				auto& insn = emit(IR_BC_ADD_I64);
+				insn.dst = dst;
+				insn.a = a.reg;
+				insn.b = b.reg;
+				return irBytecodeOperand::fromReg(dst);
+			}
+			return compileValue(e);
+		}
+
+		[[nodiscard]] static bool isComparison(irExpressionType type) noexcept
+		{
+			return type >= IR_EQUALS_I8 && type <= IR_NOTEQUALS_I64;
+		}
+
+		[[nodiscard]] static bool isEquals(irExpressionType type) noexcept
+		{
+			return type >= IR_EQUALS_I8 && type <= IR_EQUALS_I64;
+		}
+
+		[[nodiscard]] static int getComparisonWidthIndex(irExpressionType type) noexcept
+		{
+			return isEquals(type) ? (type - IR_EQUALS_I8) : (type - IR_NOTEQUALS_I8); // 0 = i8, 1 = i32, 2 = i64
+		}
+
+		// Emits a jump that is taken if cond is true (when = true) or false (when = false), returning its position to patch the target in.
+		// Returns nothing if the condition is constant, in which case taken says whether the jump would always be taken.
+		[[nodiscard]] Optional<uint32_t> compileJump(const irExpression& cond, bool when, bool& taken)
+		{
+			if (isComparison(cond.type))
+			{
+				auto a = compileValue(*cond.children.at(0));
+				auto b = compileValue(*cond.children.at(1));
+				if (a.is_const && b.is_const)
+				{
+					taken = ((irBytecodeFold(cond.type, a.value, b.value).value() != 0) == when);
+					return std::nullopt;
+				}
+				if (a.is_const)
+				{
+					std::swap(a, b);
+				}
+				const bool jump_if_equal = (isEquals(cond.type) == when);
+				const auto width = getComparisonWidthIndex(cond.type);
+				static constexpr irBytecodeOp jeq[] = { IR_BC_JEQ_I8, IR_BC_JEQ_I32, IR_BC_JEQ_I64 };
+				static constexpr irBytecodeOp jne[] = { IR_BC_JNE_I8, IR_BC_JNE_I32, IR_BC_JNE_I64 };
+				static constexpr irBytecodeOp jeq_imm[] = { IR_BC_JEQ_I8_IMM, IR_BC_JEQ_I32_IMM, IR_BC_JEQ_I64_IMM };
+				static constexpr irBytecodeOp jne_imm[] = { IR_BC_JNE_I8_IMM, IR_BC_JNE_I32_IMM, IR_BC_JNE_I64_IMM };
+				const auto at = pos();
+				if (b.is_const)
+				{
+					auto& insn = emit((jump_if_equal ? jeq_imm : jne_imm)[width]);
+					insn.a = a.reg;
+					insn.imm = b.value;
+				}
+				else
+				{
+					auto& insn = emit((jump_if_equal ? jeq : jne)[width]);
+					insn.a = a.reg;
+					insn.b = b.reg;
+				}
+				return at;
+			}
+			const auto value = compileValue(cond);
+			if (value.is_const)
+			{
+				taken = ((value.value != 0) == when);
+				return std::nullopt;
+			}
+			const auto at = pos();
+			emit(when ? IR_BC_JNZ : IR_BC_JZ).a = value.reg;
+			return at;
+		}
+
+		[[nodiscard]] irBytecodeOperand compileValue(const irExpression& e, uint16_t hint = IR_BC_NO_REG)
+		{
+			switch (e.type)
+			{
+			case IR_CONST_BOOL: return irBytecodeOperand::fromConst(e.const_bool.value ? 1 : 0);
+			case IR_CONST_I8: return irBytecodeOperand::fromConst(e.const_i8.value);
+			case IR_CONST_I32: return irBytecodeOperand::fromConst(e.const_i32.value);
+			case IR_CONST_I64: return irBytecodeOperand::fromConst(e.const_i64.value);
+			case IR_CONST_PTR: return irBytecodeOperand::fromConst(static_cast<int64_t>(e.const_ptr.value));
+
+			case IR_LOCAL_GET:
+				// Locals are only set by statements, so the value will have been used before the register could change.
+				SOUP_ASSERT(e.local_get.index < local_read.size());
+				return irBytecodeOperand::fromReg(static_cast<uint16_t>(e.local_get.index));
+
+			case IR_CALL:
+			case IR_DISCARD:
+				{
+					const auto values = compileValues(e);
+					SOUP_ASSERT(values.size() == 1);
+					return values[0];
+				}
+
+			case IR_ADD_I32: case IR_ADD_I64: case IR_ADD_PTR:
+			case IR_SUB_I32: case IR_SUB_I64:
+			case IR_MUL_I64:
+			case IR_SDIV_I64: case IR_UDIV_I64: case IR_SMOD_I64: case IR_UMOD_I64:
+			case IR_EQUALS_I8: case IR_EQUALS_I32: case IR_EQUALS_I64:
+			case IR_NOTEQUALS_I8: case IR_NOTEQUALS_I32: case IR_NOTEQUALS_I64:
+				return compileBinary(e, hint);
+
+			case IR_I64_TO_PTR:
+			case IR_I64_TO_I32:
+			case IR_I64_TO_I8:
+			case IR_I32_TO_I64_SX:
+			case IR_I32_TO_I64_ZX:
+			case IR_I8_TO_I64_SX:
+			case IR_I8_TO_I64_ZX:
+				{
+					const auto a = compileValue(*e.children.at(0));
+					if (a.is_const)
+					{
+						return irBytecodeOperand::fromConst(foldConversion(e.type, a.value));
+					}
+					irBytecodeOp op;
+					switch (e.type)
+					{
+					case IR_I32_TO_I64_SX: op = IR_BC_SX_I32; break;
+					case IR_I32_TO_I64_ZX: op = IR_BC_ZX_I32; break;
+					case IR_I8_TO_I64_SX: op = IR_BC_SX_I8; break;
+					case IR_I8_TO_I64_ZX: op = IR_BC_ZX_I8; break;
+					default: return a; // instructions only look at as many bits as their type has, so truncation is free
+					}
+					auto& insn = emit(op);
+					insn.dst = (hint != IR_BC_NO_REG ? hint : allocReg());
+					insn.a = a.reg;
+					return irBytecodeOperand::fromReg(insn.dst);
+				}
+
+			case IR_LOAD_I8:
+				{
+					int64_t offset = 0;
+					const auto mark = next_reg;
+					const auto base = toReg(compileAddress(*e.children.at(0), offset));
+					next_reg = mark;
+					const auto dst = (hint != IR_BC_NO_REG ? hint : allocReg());
+					auto& insn = emit(IR_BC_LOAD_I8);
+					insn.dst = dst;
+					insn.a = base;
+					insn.imm = offset;
+					return irBytecodeOperand::fromReg(dst);
+				}
+
+			default:;
+			}
+			SOUP_ASSERT_UNREACHABLE;
+		}
+
+		[[nodiscard]] static int64_t foldConversion(irExpressionType type, int64_t a) noexcept
+		{
+			switch (type)
+			{
+			case IR_I64_TO_I32: case IR_I32_TO_I64_SX: return static_cast<int32_t>(a);
+			case IR_I64_TO_I8: case IR_I8_TO_I64_SX: return static_cast<int8_t>(a);
+			case IR_I32_TO_I64_ZX: return static_cast<uint32_t>(a);
+			case IR_I8_TO_I64_ZX: return static_cast<uint8_t>(a);
+			default:;
+			}
+			return a;
+		}
+
+		[[nodiscard]] irBytecodeOperand compileBinary(const irExpression& e, uint16_t hint)
+		{
+			SOUP_ASSERT(e.children.size() == 2);
+			const auto mark = next_reg;
+			auto a = compileValue(*e.children[0]);
+			auto b = compileValue(*e.children[1]);
+			if (a.is_const && b.is_const)
+			{
+				if (auto folded = irBytecodeFold(e.type, a.value, b.value); folded.has_value())
+				{
+					next_reg = mark;
+					return irBytecodeOperand::fromConst(*folded);
+				}
+			}
+
+			const bool commutative = (e.type == IR_ADD_I32 || e.type == IR_ADD_I64 || e.type == IR_ADD_PTR || e.type == IR_MUL_I64 || isComparison(e.type));
+			if (a.is_const && !b.is_const && commutative)
+			{
+				std::swap(a, b);
+			}
+
+			// Identities
+			if (b.is_const)
+			{
+				if (b.value == 0 && (e.type == IR_ADD_I32 || e.type == IR_ADD_I64 || e.type == IR_ADD_PTR || e.type == IR_SUB_I32 || e.type == IR_SUB_I64))
+				{
+					return a;
+				}
+				if (b.value == 1 && (e.type == IR_MUL_I64 || e.type == IR_SDIV_I64 || e.type == IR_UDIV_I64))
+				{
+					return a;
+				}
+				if (b.value == 0 && e.type == IR_MUL_I64)
+				{
+					next_reg = mark;
+					return irBytecodeOperand::fromConst(0);
+				}
+			}
+
+			irBytecodeOp op;
+			bool imm = false;
+			int64_t imm_value = 0;
+			if (b.is_const && !a.is_const)
+			{
+				imm = true;
+				imm_value = b.value;
+				switch (e.type)
+				{
+				case IR_ADD_I32: op = IR_BC_ADD_I32_IMM; break;
+				case IR_SUB_I32: op = IR_BC_ADD_I32_IMM; imm_value = static_cast<int64_t>(0 - static_cast<uint64_t>(imm_value)); break;
+				case IR_ADD_I64: case IR_ADD_PTR: op = IR_BC_ADD_I64_IMM; break;
+				case IR_SUB_I64: op = IR_BC_ADD_I64_IMM; imm_value = static_cast<int64_t>(0 - static_cast<uint64_t>(imm_value)); break;
+				case IR_MUL_I64: op = IR_BC_MUL_I64_IMM; break;
+				case IR_EQUALS_I8: op = IR_BC_EQ_I8_IMM; break;
+				case IR_EQUALS_I32: op = IR_BC_EQ_I32_IMM; break;
+				case IR_EQUALS_I64: op = IR_BC_EQ_I64_IMM; break;
+				case IR_NOTEQUALS_I8: op = IR_BC_NE_I8_IMM; break;
+				case IR_NOTEQUALS_I32: op = IR_BC_NE_I32_IMM; break;
+				case IR_NOTEQUALS_I64: op = IR_BC_NE_I64_IMM; break;
+				default: imm = false; break;
+				}
+			}
+			if (!imm)
+			{
+				switch (e.type)
+				{
+				case IR_ADD_I32: op = IR_BC_ADD_I32; break;
+				case IR_SUB_I32: op = IR_BC_SUB_I32; break;
+				case IR_SUB_I64: op = IR_BC_SUB_I64; break;
+				case IR_MUL_I64: op = IR_BC_MUL_I64; break;
+				case IR_SDIV_I64: op = IR_BC_SDIV_I64; break;
+				case IR_UDIV_I64: op = IR_BC_UDIV_I64; break;
+				case IR_SMOD_I64: op = IR_BC_SMOD_I64; break;
+				case IR_UMOD_I64: op = IR_BC_UMOD_I64; break;
+				case IR_EQUALS_I8: op = IR_BC_EQ_I8; break;
+				case IR_EQUALS_I32: op = IR_BC_EQ_I32; break;
+				case IR_EQUALS_I64: op = IR_BC_EQ_I64; break;
+				case IR_NOTEQUALS_I8: op = IR_BC_NE_I8; break;
+				case IR_NOTEQUALS_I32: op = IR_BC_NE_I32; break;
+				case IR_NOTEQUALS_I64: op = IR_BC_NE_I64; break;
+				default: op = IR_BC_ADD_I64; break;
+				}
+			}
+
+			const auto ra = toReg(a);
+			const auto rb = (imm ? IR_BC_NO_REG : toReg(b));
+			// Operands are read before the result is written, so the result may reuse their registers.
+			next_reg = mark;
+			const auto dst = (hint != IR_BC_NO_REG ? hint : allocReg());
+			auto& insn = emit(op);
+			insn.dst = dst;
+			insn.a = ra;
+			insn.b = rb;
+			insn.imm = imm_value;
+			return irBytecodeOperand::fromReg(dst);
+		}
+
+		// Emits the call, after which its return values are in the registers starting at the next_reg it was called with. Returns the callee.
+		const irFunction& emitCall(const irExpression& e)
+		{
+			const irFunction* callee;
+			if (e.call.index >= 0)
+			{
+				callee = &m.func_exports.at(e.call.index);
+			}
+			else
+			{
+				const auto& imp = m.imports.at(~e.call.index);
+				SOUP_ASSERT(imp.module_name == "posix" && imp.func.name == "write", "irBytecode: unsupported import");
+				callee = &imp.func;
+			}
+			SOUP_ASSERT(e.children.size() == callee->parameters.size());
+
+			// Arguments are placed in consecutive registers, which become the callee's first locals.
+			const auto base = static_cast<uint16_t>(next_reg);
+			for (const auto& child : e.children)
+			{
+				const auto reg = allocReg();
+				moveTo(reg, compileValue(*child, reg));
+				next_reg = reg + 1u;
+			}
+			auto& insn = emit(e.call.index >= 0 ? IR_BC_CALL : IR_BC_CALL_POSIX_WRITE);
+			insn.a = base;
+			insn.b = static_cast<uint16_t>(callee->returns.size());
+			insn.target = static_cast<uint32_t>(e.call.index);
+			next_reg = base;
+			return *callee;
+		}
+
+		// Values produced by e, which stay in their registers until the caller resets next_reg.
+		[[nodiscard]] std::vector<irBytecodeOperand> compileValues(const irExpression& e)
+		{
+			switch (e.type)
+			{
+			case IR_CALL:
+				{
+					const auto& callee = emitCall(e);
+					std::vector<irBytecodeOperand> values{};
+					for (size_t i = 0; i != callee.returns.size(); ++i)
+					{
+						values.emplace_back(irBytecodeOperand::fromReg(allocReg()));
+					}
+					return values;
+				}
+
+			case IR_DISCARD:
+				{
+					auto values = compileValues(*e.children.at(0));
+					SOUP_ASSERT(e.discard.count <= values.size());
+					values.resize(values.size() - e.discard.count);
+					return values;
+				}
+
+			default:;
+			}
+			return { compileValue(e) };
+		}
+	};
+
+	irBytecode irBytecode::compile(const irModule& m)
+	{
+		irBytecode bc;
+		bc.functions.reserve(m.func_exports.size());
+		for (const auto& fn : m.func_exports)
+		{
+			irBytecodeCompiler c(m, fn, bc.functions.emplace_back());
+			c.compileFunction();
+		}
+		return bc;
+	}
+}
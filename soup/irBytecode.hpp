@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "irModule.hpp"
+#include "irType.hpp"
+
+// Instructions of irBytecode::Function. Operands are registers of the current frame unless suffixed with _IMM, in which case the second operand is the immediate.
+#define IR_BC_OPS(X) \
+	X(CONST) \
+	X(MOV) \
+	X(JMP) \
+	X(JZ) \
+	X(JNZ) \
+	X(CALL) \
+	X(CALL_POSIX_WRITE) \
+	X(RET) \
+	X(ADD_I32) \
+	X(ADD_I64) \
+	X(ADD_I32_IMM) \
+	X(ADD_I64_IMM) \
+	X(SUB_I32) \
+	X(SUB_I64) \
+	X(MUL_I64) \
+	X(MUL_I64_IMM) \
+	X(SDIV_I64) \
+	X(UDIV_I64) \
+	X(SMOD_I64) \
+	X(UMOD_I64) \
+	X(EQ_I8) \
+	X(EQ_I32) \
+	X(EQ_I64) \
+	X(NE_I8) \
+	X(NE_I32) \
+	X(NE_I64) \
+	X(EQ_I8_IMM) \
+	X(EQ_I32_IMM) \
+	X(EQ_I64_IMM) \
+	X(NE_I8_IMM) \
+	X(NE_I32_IMM) \
+	X(NE_I64_IMM) \
+	X(JEQ_I8) \
+	X(JEQ_I32) \
+	X(JEQ_I64) \
+	X(JNE_I8) \
+	X(JNE_I32) \
+	X(JNE_I64) \
+	X(JEQ_I8_IMM) \
+	X(JEQ_I32_IMM) \
+	X(JEQ_I64_IMM) \
+	X(JNE_I8_IMM) \
+	X(JNE_I32_IMM) \
+	X(JNE_I64_IMM) \
+	X(SX_I32) \
+	X(ZX_I32) \
+	X(SX_I8) \
+	X(ZX_I8) \
+	X(LOAD_I8) \
+	X(STORE_I8) \
+	X(STORE_I32) \
+	X(STORE_I64)
+
+NAMESPACE_SOUP
+{
+	enum irBytecodeOp : uint16_t
+	{
+#define IR_BC_OP_ENUM(name) IR_BC_##name,
+		IR_BC_OPS(IR_BC_OP_ENUM)
+#undef IR_BC_OP_ENUM
+	};
+
+	// Flat register bytecode for irBytecodeVm, compiled from an irModule.
+	// Every value lives in a 64-bit register of its function's frame, the first ones being the IR locals; the instruction says how to interpret it.
+	struct irBytecode
+	{
+		struct Insn
+		{
+			uint16_t op;
+			uint16_t dst;
+			uint16_t a;
+			uint16_t b; // for CALL/RET: number of values
+			uint32_t target; // instruction index for jumps, function index for calls
+			int64_t imm; // constant operand, or memory offset for loads and stores
+		};
+
+		struct Function
+		{
+			std::vector<Insn> insns{};
+			std::vector<irType> parameters{};
+			std::vector<irType> returns{}; // of the top-level IR_RET, if any
+			uint32_t num_locals = 0; // including parameters
+			uint32_t num_regs = 0;
+		};
+
+		std::vector<Function> functions{}; // parallel to irModule::func_exports
+
+		// Constant expressions are folded, and code that has no effect, can't run, or computes values that are never read is dropped.
+		[[nodiscard]] static irBytecode compile(const irModule& m);
+	};
+}
@@ -0,0 +1,309 @@
+#include "irBytecodeVm.hpp"
+
+#include <cstdio> // fwrite
+#include <cstring> // memcpy
+
+#include "Exception.hpp"
+
+// Computed goto where the compiler supports it, so each handler ends in its own indirect branch.
+#if defined(__GNUC__) || defined(__clang__)
+	#define THREADED_DISPATCH true
+#else
+	#define THREADED_DISPATCH false
+#endif
+
+NAMESPACE_SOUP
+{
+	[[nodiscard]] static uint64_t irBytecodeVmGetArithmeticValue(const irVm::Variable& var) noexcept
+	{
+		switch (var.type)
+		{
+		case IR_BOOL: return var.value.b;
+		case IR_I8: return static_cast<uint64_t>(static_cast<int64_t>(var.value.i8));
+		case IR_I32: return static_cast<uint64_t>(static_cast<int64_t>(var.value.i32));
+		case IR_I64: return static_cast<uint64_t>(var.value.i64);
+		case IR_PTR: return var.value.ptr;
+		}
+		SOUP_UNREACHABLE;
+	}
+
+	std::vector<irVm::Variable> irBytecodeVm::execute(const irBytecode& bc, uint32_t function_index, const std::vector<irVm::Variable>& args)
+	{
+		constexpr size_t max_call_depth = 0x10'000;
+
+		const irBytecode::Function* fn = &bc.functions.at(function_index);
+		SOUP_ASSERT(args.size() == fn->parameters.size());
+		if (regs.size() < fn->num_regs)
+		{
+			regs.resize(fn->num_regs < 0x400 ? 0x400 : fn->num_regs);
+		}
+		call_stack.clear();
+
+		size_t fp = 0;
+		for (size_t i = 0; i != args.size(); ++i)
+		{
+			SOUP_ASSERT(args[i].type == fn->parameters[i]);
+			regs[i] = irBytecodeVmGetArithmeticValue(args[i]);
+		}
+		for (size_t i = args.size(); i != fn->num_locals; ++i)
+		{
+			regs[i] = 0;
+		}
+		uint64_t* r = regs.data();
+		const irBytecode::Insn* ip = fn->insns.data();
+
+#if THREADED_DISPATCH
+		static const void* const dispatch_table[] = {
+#define IR_BC_OP_LABEL(name) &&op_##name,
+			IR_BC_OPS(IR_BC_OP_LABEL)
+#undef IR_BC_OP_LABEL
+		};
+#define DISPATCH() goto *dispatch_table[ip->op]
+#define CASE(name) op_##name:
+		DISPATCH();
+		{
+#else
+#define DISPATCH() continue
+#define CASE(name) case IR_BC_##name:
+		while (true) switch (ip->op)
+		{
+		default:
+			SOUP_UNREACHABLE;
+#endif
+#define NEXT() { ++ip; DISPATCH(); }
+#define JUMP(pc) { ip = fn->insns.data() + (pc); DISPATCH(); }
+#define A (r[ip->a])
+#define B (r[ip->b])
+#define D (r[ip->dst])
+#define I32(x) static_cast<int32_t>(x)
+#define I8(x) static_cast<int8_t>(x)
+#define I64(x) static_cast<int64_t>(x)
+#define ADDRESS(n) \
+	const uint64_t addr = A + static_cast<uint64_t>(ip->imm); \
+	SOUP_IF_UNLIKELY (addr > memory.size() || memory.size() - addr < (n)) \
+	{ \
+		SOUP_THROW(Exception("Out-of-bounds memory access")); \
+	}
+
+		CASE(CONST)
+			D = static_cast<uint64_t>(ip->imm);
+			NEXT();
+
+		CASE(MOV)
+			D = A;
+			NEXT();
+
+		CASE(JMP)
+			JUMP(ip->target);
+
+		CASE(JZ)
+			if (A == 0)
+			{
+				JUMP(ip->target);
+			}
+			NEXT();
+
+		CASE(JNZ)
+			if (A != 0)
+			{
+				JUMP(ip->target);
+			}
+			NEXT();
+
+		CASE(CALL)
+			{
+				SOUP_IF_UNLIKELY (call_stack.size() == max_call_depth)
+				{
+					SOUP_THROW(Exception("Call stack exhausted"));
+				}
+				call_stack.emplace_back(CallFrame{ fn, ip + 1, fp });
+				fp += ip->a;
+				fn = &bc.functions[ip->target];
+				if (regs.size() < fp + fn->num_regs)
+				{
+					regs.resize((fp + fn->num_regs) * 2);
+				}
+				r = regs.data() + fp;
+				for (size_t i = fn->parameters.size(); i != fn->num_locals; ++i)
+				{
+					r[i] = 0;
+				}
+				ip = fn->insns.data();
+			}
+			DISPATCH();
+
+		CASE(CALL_POSIX_WRITE)
+			{
+				SOUP_ASSERT(I32(r[ip->a]) == 1);
+				const uint64_t ptr = r[ip->a + 1];
+				const uint64_t len = r[ip->a + 2];
+				SOUP_IF_UNLIKELY (ptr > memory.size() || memory.size() - ptr < len)
+				{
+					SOUP_THROW(Exception("Out-of-bounds memory access"));
+				}
+				fwrite(memory.data() + ptr, 1, len, stdout);
+				r[ip->a] = len;
+			}
+			NEXT();
+
+		CASE(RET)
+			// The values go to the start of the frame, which is where the caller expects them.
+			for (uint16_t i = 0; i != ip->b; ++i)
+			{
+				r[i] = r[ip->a + i];
+			}
+			if (call_stack.empty())
+			{
+				std::vector<irVm::Variable> ret{};
+				ret.reserve(ip->b);
+				for (uint16_t i = 0; i != ip->b; ++i)
+				{
+					ret.emplace_back(irVm::Variable::fromArithmeticValue(static_cast<int64_t>(r[i]), fn->returns.at(i)));
+				}
+				return ret;
+			}
+			fn = call_stack.back().fn;
+			ip = call_stack.back().ret;
+			fp = call_stack.back().fp;
+			call_stack.pop_back();
+			r = regs.data() + fp;
+			DISPATCH();
+
+		CASE(ADD_I32)
+			D = static_cast<uint64_t>(I64(I32(A + B)));
+			NEXT();
+
+		CASE(ADD_I64)
+			D = A + B;
+			NEXT();
+
+		CASE(ADD_I32_IMM)
+			D = static_cast<uint64_t>(I64(I32(A + static_cast<uint64_t>(ip->imm))));
+			NEXT();
+
+		CASE(ADD_I64_IMM)
+			D = A + static_cast<uint64_t>(ip->imm);
+			NEXT();
+
+		CASE(SUB_I32)
+			D = static_cast<uint64_t>(I64(I32(A - B)));
+			NEXT();
+
+		CASE(SUB_I64)
+			D = A - B;
+			NEXT();
+
+		CASE(MUL_I64)
+			D = A * B;
+			NEXT();
+
+		CASE(MUL_I64_IMM)
+			D = A * static_cast<uint64_t>(ip->imm);
+			NEXT();
+
+		CASE(SDIV_I64)
+			SOUP_IF_UNLIKELY (B == 0)
+			{
+				SOUP_THROW(Exception("Division by zero"));
+			}
+			D = (I64(B) == -1 ? 0 - A : static_cast<uint64_t>(I64(A) / I64(B)));
+			NEXT();
+
+		CASE(UDIV_I64)
+			SOUP_IF_UNLIKELY (B == 0)
+			{
+				SOUP_THROW(Exception("Division by zero"));
+			}
+			D = A / B;
+			NEXT();
+
+		CASE(SMOD_I64)
+			SOUP_IF_UNLIKELY (B == 0)
+			{
+				SOUP_THROW(Exception("Division by zero"));
+			}
+			D = (I64(B) == -1 ? 0 : static_cast<uint64_t>(I64(A) % I64(B)));
+			NEXT();
+
+		CASE(UMOD_I64)
+			SOUP_IF_UNLIKELY (B == 0)
+			{
+				SOUP_THROW(Exception("Division by zero"));
+			}
+			D = A % B;
+			NEXT();
+
+		CASE(EQ_I8) D = (I8(A) == I8(B)); NEXT();
+		CASE(EQ_I32) D = (I32(A) == I32(B)); NEXT();
+		CASE(EQ_I64) D = (A == B); NEXT();
+		CASE(NE_I8) D = (I8(A) != I8(B)); NEXT();
+		CASE(NE_I32) D = (I32(A) != I32(B)); NEXT();
+		CASE(NE_I64) D = (A != B); NEXT();
+		CASE(EQ_I8_IMM) D = (I8(A) == I8(ip->imm)); NEXT();
+		CASE(EQ_I32_IMM) D = (I32(A) == I32(ip->imm)); NEXT();
+		CASE(EQ_I64_IMM) D = (I64(A) == ip->imm); NEXT();
+		CASE(NE_I8_IMM) D = (I8(A) != I8(ip->imm)); NEXT();
+		CASE(NE_I32_IMM) D = (I32(A) != I32(ip->imm)); NEXT();
+		CASE(NE_I64_IMM) D = (I64(A) != ip->imm); NEXT();
+
+		CASE(JEQ_I8) if (I8(A) == I8(B)) { JUMP(ip->target); } NEXT();
+		CASE(JEQ_I32) if (I32(A) == I32(B)) { JUMP(ip->target); } NEXT();
+		CASE(JEQ_I64) if (A == B) { JUMP(ip->target); } NEXT();
+		CASE(JNE_I8) if (I8(A) != I8(B)) { JUMP(ip->target); } NEXT();
+		CASE(JNE_I32) if (I32(A) != I32(B)) { JUMP(ip->target); } NEXT();
+		CASE(JNE_I64) if (A != B) { JUMP(ip->target); } NEXT();
+		CASE(JEQ_I8_IMM) if (I8(A) == I8(ip->imm)) { JUMP(ip->target); } NEXT();
+		CASE(JEQ_I32_IMM) if (I32(A) == I32(ip->imm)) { JUMP(ip->target); } NEXT();
+		CASE(JEQ_I64_IMM) if (I64(A) == ip->imm) { JUMP(ip->target); } NEXT();
+		CASE(JNE_I8_IMM) if (I8(A) != I8(ip->imm)) { JUMP(ip->target); } NEXT();
+		CASE(JNE_I32_IMM) if (I32(A) != I32(ip->imm)) { JUMP(ip->target); } NEXT();
+		CASE(JNE_I64_IMM) if (I64(A) != ip->imm) { JUMP(ip->target); } NEXT();
+
+		CASE(SX_I32) D = static_cast<uint64_t>(I64(I32(A))); NEXT();
+		CASE(ZX_I32) D = static_cast<uint32_t>(A); NEXT();
+		CASE(SX_I8) D = static_cast<uint64_t>(I64(I8(A))); NEXT();
+		CASE(ZX_I8) D = static_cast<uint8_t>(A); NEXT();
+
+		CASE(LOAD_I8)
+			{
+				ADDRESS(1);
+				D = static_cast<uint64_t>(I64(static_cast<int8_t>(memory[addr])));
+			}
+			NEXT();
+
+		CASE(STORE_I8)
+			{
+				ADDRESS(1);
+				memory[addr] = static_cast<char>(B);
+			}
+			NEXT();
+
+		CASE(STORE_I32)
+			{
+				ADDRESS(4);
+				const auto value = I32(B);
+				memcpy(memory.data() + addr, &value, 4);
+			}
+			NEXT();
+
+		CASE(STORE_I64)
+			{
+				ADDRESS(8);
+				const auto value = B;
+				memcpy(memory.data() + addr, &value, 8);
+			}
+			NEXT();
+		}
+#undef DISPATCH
+#undef CASE
+#undef NEXT
+#undef JUMP
+#undef A
+#undef B
+#undef D
+#undef I32
+#undef I8
+#undef I64
+#undef ADDRESS
+	}
+}
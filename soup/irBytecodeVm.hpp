@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "irBytecode.hpp"
+#include "irVm.hpp"
+
+NAMESPACE_SOUP
+{
+	// Runs irBytecode, producing the same results as irVm running the IR it was compiled from, minus the tree-walking.
+	// Non-parameter locals start out as zero rather than random values, and faults like division by zero or out-of-bounds memory accesses throw an Exception.
+	struct irBytecodeVm
+	{
+		std::string& memory;
+
+		irBytecodeVm(std::string& memory) : memory(memory) {}
+
+		std::vector<irVm::Variable> execute(const irBytecode& bc, uint32_t function_index, const std::vector<irVm::Variable>& args = {});
+
+	private:
+		struct CallFrame
+		{
+			const irBytecode::Function* fn;
+			const irBytecode::Insn* ret;
+			size_t fp;
+		};
+
+		std::vector<uint64_t> regs{};
+		std::vector<CallFrame> call_stack{};
+	};
+}
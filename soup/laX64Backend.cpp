@@ -1,201 +1,1021 @@
 #include "laX64Backend.hpp"
 
-#include "string.hpp"
-#include "StringWriter.hpp"
-#include "utility.hpp" // SOUP_MOVE_RETURN
+#include <algorithm> // sort, upper_bound
+#include <cstdio> // fwrite
+#include <cstring> // memcpy
+#include <iterator> // size
+
+#include "x64.hpp"
+#include "x64Emitter.hpp"
 
 NAMESPACE_SOUP
 {
-	std::string laX64Backend::compileFunction(const irModule& m, const irFunction& fn)
+	enum laX64Op : uint8_t
+	{
+		LA_X64_ENTRY, // defines the parameters
+		LA_X64_MOV_IMM,
+		LA_X64_MOV,
+		LA_X64_ADD,
+		LA_X64_SUB,
+		LA_X64_IMUL,
+		LA_X64_SDIV,
+		LA_X64_UDIV,
+		LA_X64_SMOD,
+		LA_X64_UMOD,
+		LA_X64_SETCC, // dst = (a cmp b) satisfies cc
+		LA_X64_MOVSXD,
+		LA_X64_MOV32,
+		LA_X64_MOVSX8,
+		LA_X64_MOVZX8,
+		LA_X64_LOAD8,
+		LA_X64_STORE8,
+		LA_X64_STORE32,
+		LA_X64_STORE64,
+		LA_X64_LABEL,
+		LA_X64_JMP,
+		LA_X64_JZ, // jump if the low byte of a is zero
+		LA_X64_JCC, // jump if (a cmp b) satisfies cc
+		LA_X64_CALL, // imm is the function index, or ~import index
+		LA_X64_RET,
+	};
+
+	static constexpr uint32_t LA_X64_NONE = -1;
+
+	struct laX64Insn
 	{
-		StringWriter w;
-		for (auto i = fn.insns.begin(); i != fn.insns.end(); ++i)
+		laX64Op op;
+		uint8_t width = 64; // of the operation, in bits
+		uint8_t cc = 0;
+		uint32_t dst = LA_X64_NONE;
+		uint32_t a = LA_X64_NONE;
+		uint32_t b = LA_X64_NONE;
+		int64_t imm = 0; // constant, label, or function index
+		std::vector<uint32_t> args{};
+	};
+
+	struct laX64Location
+	{
+		enum Kind : uint8_t
 		{
-			irExpression& insn = **i;
-			int ret = compileExpression(m, w, insn, nullptr);
-			if (insn.type == IR_RET)
-			{
-				break;
-			}
-			discard(w, ret);
-		}
-		if (true)
+			NONE, // never read, so writes may be dropped
+			REG,
+			SLOT,
+		};
+
+		Kind kind = NONE;
+		uint8_t reg = 0;
+		uint32_t slot = 0;
+	};
+
+	// rax, rdx, and r11 are never allocated, so they're free to use as scratch registers.
+#if SOUP_WINDOWS
+	static constexpr x64Register la_x64_args[] = { RC, RD, R8, R9 };
+	static constexpr x64Register la_x64_caller_saved[] = { RC, R8, R9, R10 };
+	static constexpr x64Register la_x64_callee_saved[] = { RB, SI, DI, BP, R12, R13, R14, R15 };
+	static constexpr uint8_t la_x64_shadow_space = 0x20;
+#else
+	static constexpr x64Register la_x64_args[] = { DI, SI, RD, RC, R8, R9 };
+	static constexpr x64Register la_x64_caller_saved[] = { RC, SI, DI, R8, R9, R10 };
+	static constexpr x64Register la_x64_callee_saved[] = { RB, BP, R12, R13, R14, R15 };
+	static constexpr uint8_t la_x64_shadow_space = 0;
+#endif
+
+	static int64_t laX64PosixWrite(int32_t fd, const void* buf, int64_t len) noexcept
+	{
+		// Like irVm, we only support stdout.
+		if (fd != 1)
 		{
-			// It's very likely we generated `push r10` followed directly `pop r10` somewhere, this is a no-op and can be erased.
-			string::replaceAll(w.data, std::string("\x41\x52\x41\x5a", 4), {});
+			return -1;
 		}
-		SOUP_MOVE_RETURN(w.data);
+		return static_cast<int64_t>(fwrite(buf, 1, static_cast<size_t>(len), stdout));
 	}
 
-	int laX64Backend::compileExpression(const irModule& m, StringWriter& w, const irExpression& e, const irExpression* outgoing)
+	struct laX64FunctionCompiler
 	{
-		uint8_t b;
-#if false // stack-based approach
-		switch (e.type)
+		const irModule& m;
+		const irFunction& fn;
+		std::vector<laX64Insn> insns{};
+		uint32_t num_vregs; // the first ones are the IR locals, including parameters
+		uint32_t num_labels = 0;
+		std::vector<std::pair<uint32_t, uint32_t>> loops{}; // positions of the loop head and the jump back to it, innermost first
+
+		std::vector<laX64Location> locs{};
+		uint32_t num_slots = 0;
+		std::vector<x64Register> saved_regs{};
+		uint32_t frame_size = 0;
+
+		laX64FunctionCompiler(const irModule& m, const irFunction& fn)
+			: m(m), fn(fn), num_vregs(static_cast<uint32_t>(fn.parameters.size() + fn.locals.size()))
+		{
+		}
+
+		// IR -> virtual registers
+
+		laX64Insn& add(laX64Op op)
+		{
+			return insns.emplace_back(laX64Insn{ op });
+		}
+
+		[[nodiscard]] uint32_t newVreg() noexcept
+		{
+			return num_vregs++;
+		}
+
+		[[nodiscard]] uint32_t newLabel() noexcept
 		{
-		case IR_LOCAL_GET:
-			// Note: This is for the Windows ABI. Linux places call arguments in different registers.
-			switch (e.local_get.index)
+			return num_labels++;
+		}
+
+		void lowerFunction()
+		{
+			SOUP_ASSERT(fn.parameters.size() <= std::size(la_x64_args), "laX64Backend: too many parameters");
+			SOUP_ASSERT(fn.returns.size() <= 1, "laX64Backend: multiple return values are not supported");
+			add(LA_X64_ENTRY);
+			for (const auto& insn : fn.insns)
 			{
-			case 0: b = 0x51; w.u8(b); break; // push rcx
-			case 1: b = 0x52; w.u8(b); break; // push rdx
-			case 2: b = 0x41; w.u8(b); b = 0x50; w.u8(b); break; // push r8
-			case 3: b = 0x41; w.u8(b); b = 0x51; w.u8(b); break; // push r9
-			// The rest would be on the stack...
-			default: SOUP_ASSERT_UNREACHABLE;
+				if (insn->type == IR_RET)
+				{
+					uint32_t value = LA_X64_NONE;
+					for (const auto& child : insn->children)
+					{
+						for (const auto& v : lower(*child))
+						{
+							SOUP_ASSERT(value == LA_X64_NONE, "laX64Backend: multiple return values are not supported");
+							value = v;
+						}
+					}
+					add(LA_X64_RET).a = value;
+					return;
+				}
+				lower(*insn);
 			}
-			return 1;
+			add(LA_X64_RET);
+		}
+
+		[[nodiscard]] uint32_t lowerOne(const irExpression& e)
+		{
+			auto values = lower(e);
+			SOUP_ASSERT(values.size() == 1);
+			return values[0];
+		}
 
-		case IR_ADD_I64:
+		uint32_t lowerBinary(const irExpression& e, laX64Op op, uint8_t width)
+		{
 			SOUP_ASSERT(e.children.size() == 2);
-			SOUP_ASSERT(compileExpression(m, w, *e.children[0]) == 1);
-			SOUP_ASSERT(compileExpression(m, w, *e.children[1]) == 1);
-			b = 0x41; w.u8(b); b = 0x5b; w.u8(b); // pop r11
-			b = 0x41; w.u8(b); b = 0x5a; w.u8(b); // pop r10
-			b = 0x4d; w.u8(b); b = 0x01; w.u8(b); b = 0xda; w.u8(b); // add r10, r11
-			b = 0x41; w.u8(b); b = 0x52; w.u8(b); // push r10
-			return 1;
-
-		case IR_SUB_I64:
+			const auto a = lowerOne(*e.children[0]);
+			const auto b = lowerOne(*e.children[1]);
+			auto& insn = add(op);
+			insn.width = width;
+			insn.dst = newVreg();
+			insn.a = a;
+			insn.b = b;
+			return insn.dst;
+		}
+
+		uint32_t lowerUnary(const irExpression& e, laX64Op op)
+		{
+			const auto a = lowerOne(*e.children.at(0));
+			auto& insn = add(op);
+			insn.dst = newVreg();
+			insn.a = a;
+			return insn.dst;
+		}
+
+		void lowerStore(const irExpression& e, laX64Op op)
+		{
 			SOUP_ASSERT(e.children.size() == 2);
-			SOUP_ASSERT(compileExpression(m, w, *e.children[0]) == 1);
-			SOUP_ASSERT(compileExpression(m, w, *e.children[1]) == 1);
-			b = 0x41; w.u8(b); b = 0x5b; w.u8(b); // pop r11
-			b = 0x41; w.u8(b); b = 0x5a; w.u8(b); // pop r10
-			b = 0x4d; w.u8(b); b = 0x29; w.u8(b); b = 0xda; w.u8(b); // sub r10, r11
-			b = 0x41; w.u8(b); b = 0x52; w.u8(b); // push r10
-			return 1;
-
-		case IR_RET:
-			SOUP_ASSERT(e.children.size() == 1);
-			SOUP_ASSERT(compileExpression(m, w, *e.children[0]) == 1);
-			b = 0x58; w.u8(b); // pop rax
-			b = 0xc3; w.u8(b); // ret
-			return 1;
-
-		default:
+			const auto a = lowerOne(*e.children[0]);
+			const auto b = lowerOne(*e.children[1]);
+			auto& insn = add(op);
+			insn.a = a;
+			insn.b = b;
+		}
+
+		uint32_t lowerConst(int64_t value)
+		{
+			auto& insn = add(LA_X64_MOV_IMM);
+			insn.dst = newVreg();
+			insn.imm = value;
+			return insn.dst;
+		}
+
+		[[nodiscard]] static uint8_t getComparisonWidth(irExpressionType type) noexcept
+		{
+			switch (type)
+			{
+			case IR_EQUALS_I8: case IR_NOTEQUALS_I8: return 8;
+			case IR_EQUALS_I32: case IR_NOTEQUALS_I32: return 32;
+			default:;
+			}
+			return 64;
+		}
+
+		void lowerBranchIfFalse(const irExpression& cond, uint32_t label)
+		{
+			switch (cond.type)
+			{
+			case IR_EQUALS_I8: case IR_EQUALS_I32: case IR_EQUALS_I64:
+			case IR_NOTEQUALS_I8: case IR_NOTEQUALS_I32: case IR_NOTEQUALS_I64:
+				{
+					SOUP_ASSERT(cond.children.size() == 2);
+					const auto a = lowerOne(*cond.children[0]);
+					const auto b = lowerOne(*cond.children[1]);
+					auto& insn = add(LA_X64_JCC);
+					insn.width = getComparisonWidth(cond.type);
+					insn.cc = (cond.type == IR_EQUALS_I8 || cond.type == IR_EQUALS_I32 || cond.type == IR_EQUALS_I64) ? CC_NE : CC_E;
+					insn.a = a;
+					insn.b = b;
+					insn.imm = label;
+				}
+				break;
+
+			default:
+				{
+					const auto a = lowerOne(cond);
+					auto& insn = add(LA_X64_JZ);
+					insn.a = a;
+					insn.imm = label;
+				}
+				break;
+			}
+		}
+
+		std::vector<uint32_t> lower(const irExpression& e)
+		{
+			switch (e.type)
+			{
+			case IR_CONST_BOOL: return { lowerConst(e.const_bool.value ? 1 : 0) };
+			case IR_CONST_I8: return { lowerConst(e.const_i8.value) };
+			case IR_CONST_I32: return { lowerConst(e.const_i32.value) };
+			case IR_CONST_I64: return { lowerConst(e.const_i64.value) };
+			case IR_CONST_PTR: return { lowerConst(static_cast<int64_t>(e.const_ptr.value)) };
+
+			case IR_LOCAL_GET:
+				// Locals can only be set by statements, so the parent will have consumed this value before the local could change.
+				SOUP_ASSERT(e.local_get.index < fn.parameters.size() + fn.locals.size());
+				return { e.local_get.index };
+
+			case IR_LOCAL_SET:
+				{
+					SOUP_ASSERT(e.local_set.index < fn.parameters.size() + fn.locals.size());
+					const auto value = lowerOne(*e.children.at(0));
+					auto& insn = add(LA_X64_MOV);
+					insn.dst = e.local_set.index;
+					insn.a = value;
+				}
+				return {};
+
+			case IR_CALL:
+				{
+					std::vector<uint32_t> args{};
+					for (const auto& child : e.children)
+					{
+						for (const auto& v : lower(*child))
+						{
+							args.emplace_back(v);
+						}
+					}
+					const irFunction* callee;
+					if (e.call.index >= 0)
+					{
+						callee = &m.func_exports.at(e.call.index);
+						SOUP_ASSERT(callee->returns.size() <= 1, "laX64Backend: multiple return values are not supported");
+					}
+					else
+					{
+						const auto& imp = m.imports.at(~e.call.index);
+						SOUP_ASSERT(imp.module_name == "posix" && imp.func.name == "write", "laX64Backend: unsupported import");
+						callee = &imp.func;
+					}
+					SOUP_ASSERT(args.size() == callee->parameters.size());
+					auto& insn = add(LA_X64_CALL);
+					insn.imm = e.call.index;
+					insn.args = std::move(args);
+					if (callee->returns.empty())
+					{
+						return {};
+					}
+					insn.dst = newVreg();
+					return { insn.dst };
+				}
+
+			case IR_RET:
+				// Only meaningful at the top level of a function; elsewhere, the values are simply discarded, like irVm does.
+				for (const auto& child : e.children)
+				{
+					lower(*child);
+				}
+				return {};
+
+			case IR_IFELSE:
+				{
+					const auto else_label = newLabel();
+					lowerBranchIfFalse(*e.children.at(0), else_label);
+					for (size_t i = 0; i != e.ifelse.ifinsns; ++i)
+					{
+						lower(*e.children[1 + i]);
+					}
+					if (1 + e.ifelse.ifinsns != e.children.size())
+					{
+						const auto end_label = newLabel();
+						add(LA_X64_JMP).imm = end_label;
+						add(LA_X64_LABEL).imm = else_label;
+						for (size_t i = 1 + e.ifelse.ifinsns; i != e.children.size(); ++i)
+						{
+							lower(*e.children[i]);
+						}
+						add(LA_X64_LABEL).imm = end_label;
+					}
+					else
+					{
+						add(LA_X64_LABEL).imm = else_label;
+					}
+				}
+				return {};
+
+			case IR_WHILE:
+				{
+					const auto head_label = newLabel();
+					const auto end_label = newLabel();
+					const auto head = static_cast<uint32_t>(insns.size());
+					add(LA_X64_LABEL).imm = head_label;
+					lowerBranchIfFalse(*e.children.at(0), end_label);
+					for (size_t i = 1; i != e.children.size(); ++i)
+					{
+						lower(*e.children[i]);
+					}
+					loops.emplace_back(head, static_cast<uint32_t>(insns.size()));
+					add(LA_X64_JMP).imm = head_label;
+					add(LA_X64_LABEL).imm = end_label;
+				}
+				return {};
+
+			case IR_DISCARD:
+				{
+					auto values = lower(*e.children.at(0));
+					SOUP_ASSERT(e.discard.count <= values.size());
+					values.resize(values.size() - e.discard.count);
+					return values;
+				}
+
+			case IR_ADD_I32: return { lowerBinary(e, LA_X64_ADD, 32) };
+			case IR_ADD_I64: case IR_ADD_PTR: return { lowerBinary(e, LA_X64_ADD, 64) };
+			case IR_SUB_I32: return { lowerBinary(e, LA_X64_SUB, 32) };
+			case IR_SUB_I64: return { lowerBinary(e, LA_X64_SUB, 64) };
+			case IR_MUL_I64: return { lowerBinary(e, LA_X64_IMUL, 64) };
+			case IR_SDIV_I64: return { lowerBinary(e, LA_X64_SDIV, 64) };
+			case IR_UDIV_I64: return { lowerBinary(e, LA_X64_UDIV, 64) };
+			case IR_SMOD_I64: return { lowerBinary(e, LA_X64_SMOD, 64) };
+			case IR_UMOD_I64: return { lowerBinary(e, LA_X64_UMOD, 64) };
+
+			case IR_EQUALS_I8: case IR_EQUALS_I32: case IR_EQUALS_I64:
+			case IR_NOTEQUALS_I8: case IR_NOTEQUALS_I32: case IR_NOTEQUALS_I64:
+				{
+					const auto dst = lowerBinary(e, LA_X64_SETCC, getComparisonWidth(e.type));
+					insns.back().cc = (e.type == IR_EQUALS_I8 || e.type == IR_EQUALS_I32 || e.type == IR_EQUALS_I64) ? CC_E : CC_NE;
+					return { dst };
+				}
+
+			case IR_I64_TO_PTR: return { lowerUnary(e, LA_X64_MOV) };
+			case IR_I64_TO_I32: case IR_I32_TO_I64_ZX: return { lowerUnary(e, LA_X64_MOV32) };
+			case IR_I64_TO_I8: case IR_I8_TO_I64_ZX: return { lowerUnary(e, LA_X64_MOVZX8) };
+			case IR_I32_TO_I64_SX: return { lowerUnary(e, LA_X64_MOVSXD) };
+			case IR_I8_TO_I64_SX: return { lowerUnary(e, LA_X64_MOVSX8) };
+
+			case IR_LOAD_I8: return { lowerUnary(e, LA_X64_LOAD8) };
+			case IR_STORE_I8: lowerStore(e, LA_X64_STORE8); return {};
+			case IR_STORE_I32: lowerStore(e, LA_X64_STORE32); return {};
+			case IR_STORE_I64: lowerStore(e, LA_X64_STORE64); return {};
+			}
 			SOUP_ASSERT_UNREACHABLE;
 		}
-#else
-		switch (e.type)
+
+		// Register allocation
+
+		struct Interval
 		{
-		case IR_LOCAL_GET:
-			return 0;
+			uint32_t vreg;
+			uint32_t start;
+			uint32_t end;
+			bool crosses_call;
+		};
 
-		case IR_ADD_I64:
+		template <typename F>
+		static void forEachUse(const laX64Insn& insn, F&& f)
+		{
+			if (insn.a != LA_X64_NONE)
 			{
-				SOUP_ASSERT(e.children.size() == 2);
-				x64Register a1_reg = (compileExpression(m, w, *e.children[0], &e) == 0) ? getIncomingRegister(*e.children[0]) : R10;
-				x64Register a2_reg = (compileExpression(m, w, *e.children[1], &e) == 0) ? getIncomingRegister(*e.children[1]) : R11;
-				x64Register res_reg = (outgoing && outgoing->type == IR_RET) ? RA : R10;
-				if (a2_reg == R11)
+				f(insn.a);
+			}
+			if (insn.b != LA_X64_NONE)
+			{
+				f(insn.b);
+			}
+			for (const auto& arg : insn.args)
+			{
+				f(arg);
+			}
+		}
+
+		void allocateRegisters()
+		{
+			constexpr uint32_t UNSEEN = -1;
+			std::vector<uint32_t> start(num_vregs, UNSEEN);
+			std::vector<uint32_t> end(num_vregs, 0);
+			std::vector<bool> used(num_vregs, false);
+			std::vector<uint32_t> calls{};
+			for (uint32_t pos = 0; pos != insns.size(); ++pos)
+			{
+				const auto& insn = insns[pos];
+				auto touch = [&](uint32_t v)
+				{
+					if (start[v] == UNSEEN)
+					{
+						start[v] = pos;
+					}
+					end[v] = pos;
+				};
+				forEachUse(insn, [&](uint32_t v)
+				{
+					touch(v);
+					used[v] = true;
+				});
+				if (insn.dst != LA_X64_NONE)
+				{
+					touch(insn.dst);
+				}
+				if (insn.op == LA_X64_ENTRY)
 				{
-					b = 0x41; w.u8(b); b = 0x5b; w.u8(b); // pop r11
+					for (uint32_t i = 0; i != fn.parameters.size(); ++i)
+					{
+						touch(i);
+					}
 				}
-				if (a1_reg == R10)
+				else if (insn.op == LA_X64_CALL)
 				{
-					b = 0x41; w.u8(b); b = 0x5a; w.u8(b); // pop r10
+					calls.emplace_back(pos);
 				}
+			}
 
-				x64Instruction insn{};
-				insn.setOperationFromOpcode(0x8D); // lea
-				insn.operands[0].reg = res_reg;
-				insn.operands[0].access_type = ACCESS_64;
-				insn.operands[1].reg = OFF;
-				insn.operands[1].off.a = a1_reg;
-				insn.operands[1].off.b = a2_reg;
-				auto bytecode = insn.toBytecode();
-				w.str(bytecode.size(), bytecode.data());
+			// A local may be read in the next iteration of a loop before it is written again, so it has to stay intact for the whole loop.
+			const auto num_locals = static_cast<uint32_t>(fn.parameters.size() + fn.locals.size());
+			for (const auto& loop : loops)
+			{
+				for (uint32_t v = 0; v != num_locals; ++v)
+				{
+					if (used[v] && start[v] <= loop.second && end[v] >= loop.first)
+					{
+						start[v] = std::min(start[v], loop.first);
+						end[v] = std::max(end[v], loop.second);
+					}
+				}
+			}
 
-				if (res_reg == R10)
+			std::vector<Interval> intervals{};
+			for (uint32_t v = 0; v != num_vregs; ++v)
+			{
+				if (used[v])
 				{
-					b = 0x41; w.u8(b); b = 0x52; w.u8(b); // push r10
-					return 1;
+					const auto call = std::upper_bound(calls.begin(), calls.end(), start[v]);
+					intervals.emplace_back(Interval{ v, start[v], end[v], call != calls.end() && *call < end[v] });
 				}
-				return 0;
 			}
+			std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b)
+			{
+				return a.start < b.start;
+			});
 
-		case IR_SUB_I64:
+			locs.resize(num_vregs);
+			bool reg_free[16];
+			std::fill(std::begin(reg_free), std::end(reg_free), true);
+			bool reg_saved[16]{};
+			std::vector<const Interval*> active{}; // sorted by end
+			for (const auto& cur : intervals)
 			{
-				SOUP_ASSERT(e.children.size() == 2);
-				x64Register a1_reg = (compileExpression(m, w, *e.children[0], &e) == 0) ? getIncomingRegister(*e.children[0]) : R10;
-				x64Register a2_reg = (compileExpression(m, w, *e.children[1], &e) == 0) ? getIncomingRegister(*e.children[1]) : R11;
-				x64Register res_reg = (outgoing && outgoing->type == IR_RET) ? RA : R10;
-				if (a2_reg == R11)
+				// An interval that ends where this one starts is only read by the instruction that writes this one, so its register can be reused.
+				while (!active.empty() && active.front()->end <= cur.start)
+				{
+					reg_free[locs[active.front()->vreg].reg] = true;
+					active.erase(active.begin());
+				}
+
+				uint8_t reg = 0xFF;
+				if (!cur.crosses_call)
+				{
+					for (const auto& r : la_x64_caller_saved)
+					{
+						if (reg_free[r])
+						{
+							reg = r;
+							break;
+						}
+					}
+				}
+				if (reg == 0xFF)
+				{
+					for (const auto& r : la_x64_callee_saved)
+					{
+						if (reg_free[r])
+						{
+							reg = r;
+							break;
+						}
+					}
+				}
+
+				if (reg == 0xFF)
 				{
-					b = 0x41; w.u8(b); b = 0x5b; w.u8(b); // pop r11
+					// Spill whichever of the suitable candidates lives the longest.
+					auto victim = active.end();
+					for (auto i = active.begin(); i != active.end(); ++i)
+					{
+						if (!cur.crosses_call || std::find(std::begin(la_x64_callee_saved), std::end(la_x64_callee_saved), locs[(*i)->vreg].reg) != std::end(la_x64_callee_saved))
+						{
+							victim = i;
+						}
+					}
+					if (victim == active.end() || (*victim)->end <= cur.end)
+					{
+						locs[cur.vreg].kind = laX64Location::SLOT;
+						locs[cur.vreg].slot = num_slots++;
+						continue;
+					}
+					reg = locs[(*victim)->vreg].reg;
+					locs[(*victim)->vreg].kind = laX64Location::SLOT;
+					locs[(*victim)->vreg].slot = num_slots++;
+					active.erase(victim);
 				}
-				if (a1_reg == R10)
+
+				reg_free[reg] = false;
+				locs[cur.vreg].kind = laX64Location::REG;
+				locs[cur.vreg].reg = reg;
+				active.insert(std::upper_bound(active.begin(), active.end(), &cur, [](const Interval* a, const Interval* b)
 				{
-					b = 0x41; w.u8(b); b = 0x5a; w.u8(b); // pop r10
+					return a->end < b->end;
+				}), &cur);
+				if (std::find(std::begin(la_x64_callee_saved), std::end(la_x64_callee_saved), reg) != std::end(la_x64_callee_saved)
+					&& !reg_saved[reg]
+					)
+				{
+					reg_saved[reg] = true;
+					saved_regs.emplace_back(static_cast<x64Register>(reg));
 				}
+			}
+
+			// Keep rsp 16-byte aligned at call sites.
+			frame_size = la_x64_shadow_space + num_slots * 8;
+			if ((8 + saved_regs.size() * 8 + frame_size) % 16)
+			{
+				frame_size += 8;
+			}
+		}
+
+		// Machine code
+
+		[[nodiscard]] int32_t getSlotOffset(uint32_t slot) const noexcept
+		{
+			return static_cast<int32_t>(la_x64_shadow_space + slot * 8);
+		}
+
+		static void mov(x64Emitter& a, uint8_t dst, uint8_t src)
+		{
+			if (dst != src)
+			{
+				a.rr(0, true, 0x89, src, dst);
+			}
+		}
+
+		static void movImm(x64Emitter& a, uint8_t reg, int64_t value)
+		{
+			if (value == 0)
+			{
+				a.rr(0, false, 0x31, reg, reg); // xor r32, r32
+			}
+			else if (value < 0 && value >= INT32_MIN)
+			{
+				a.rr(0, true, 0xC7, 0, reg); // mov r64, simm32
+				a.u32(static_cast<uint32_t>(value));
+			}
+			else
+			{
+				a.movImm(reg, static_cast<uint64_t>(value));
+			}
+		}
+
+		// Returns the register holding the value of v, loading it into scratch if it was spilled.
+		[[nodiscard]] uint8_t get(x64Emitter& a, uint32_t v, uint8_t scratch) const
+		{
+			const auto& loc = locs[v];
+			if (loc.kind == laX64Location::REG)
+			{
+				return loc.reg;
+			}
+			SOUP_ASSERT(loc.kind == laX64Location::SLOT);
+			a.mem(0, true, 0x8B, scratch, SP, getSlotOffset(loc.slot)); // mov scratch, [rsp + slot]
+			return scratch;
+		}
 
-				x64Instruction mov_insn{};
-				mov_insn.setOperationFromOpcode(0x89);
-				mov_insn.operands[0].reg = res_reg;
-				mov_insn.operands[0].access_type = ACCESS_64;
-				mov_insn.operands[1].reg = a1_reg;
-				mov_insn.operands[1].access_type = ACCESS_64;
-				auto bytecode = mov_insn.toBytecode();
-				w.str(bytecode.size(), bytecode.data());
+		// Returns the register the value of v should be computed into; call put afterwards.
+		[[nodiscard]] uint8_t target(uint32_t v, uint8_t scratch) const noexcept
+		{
+			return locs[v].kind == laX64Location::REG ? locs[v].reg : scratch;
+		}
+
+		void put(x64Emitter& a, uint32_t v, uint8_t reg) const
+		{
+			const auto& loc = locs[v];
+			if (loc.kind == laX64Location::REG)
+			{
+				mov(a, loc.reg, reg);
+			}
+			else if (loc.kind == laX64Location::SLOT)
+			{
+				a.mem(0, true, 0x89, reg, SP, getSlotOffset(loc.slot)); // mov [rsp + slot], reg
+			}
+		}
 
-				x64Instruction sub_insn{};
-				sub_insn.setOperationFromOpcode(0x29);
-				sub_insn.operands[0].reg = res_reg;
-				sub_insn.operands[0].access_type = ACCESS_64;
-				sub_insn.operands[1].reg = a2_reg;
-				sub_insn.operands[1].access_type = ACCESS_64;
-				bytecode = sub_insn.toBytecode();
-				w.str(bytecode.size(), bytecode.data());
+		static void leaMemory(x64Emitter& a, std::vector<uint32_t>& memory_fixups)
+		{
+			a.u8(0x4C); a.u8(0x8D); a.u8(0x1D); // lea r11, [rip + disp32]
+			memory_fixups.emplace_back(a.pos());
+			a.u32(0);
+		}
 
-				if (res_reg == R10)
+		// Moves registers into registers as if all moves happened at once.
+		static void parallelMove(x64Emitter& a, std::vector<std::pair<uint8_t, uint8_t>>& moves) // (src, dst)
+		{
+			while (!moves.empty())
+			{
+				bool progress = false;
+				for (auto i = moves.begin(); i != moves.end(); ++i)
+				{
+					const auto dst = i->second;
+					if (std::find_if(moves.begin(), moves.end(), [dst](const std::pair<uint8_t, uint8_t>& mv) { return mv.first == dst; }) == moves.end())
+					{
+						mov(a, dst, i->first);
+						moves.erase(i);
+						progress = true;
+						break;
+					}
+				}
+				if (!progress)
 				{
-					b = 0x41; w.u8(b); b = 0x52; w.u8(b); // push r10
-					return 1;
+					// Every remaining destination is still to be read, so they form a cycle. Break it by moving one of them out of the way.
+					const auto dst = moves.front().second;
+					mov(a, R11, dst);
+					for (auto& mv : moves)
+					{
+						if (mv.first == dst)
+						{
+							mv.first = R11;
+						}
+					}
 				}
-				return 0;
 			}
+		}
 
-		case IR_RET:
-			SOUP_ASSERT(e.children.size() == 1);
-			SOUP_ASSERT(compileExpression(m, w, *e.children[0], &e) == 0);
-			b = 0xc3; w.u8(b); // ret
-			return 0;
+		void emitEpilogue(x64Emitter& a) const
+		{
+			if (frame_size != 0)
+			{
+				a.rr(0, true, 0x81, 0, SP); // add rsp, imm32
+				a.u32(frame_size);
+			}
+			for (auto i = saved_regs.rbegin(); i != saved_regs.rend(); ++i)
+			{
+				a.prefixAndRex(0, false, 0, *i);
+				a.u8(0x58 | (*i & 7)); // pop
+			}
+			a.u8(0xC3); // ret
+		}
 
-		default:
-			SOUP_ASSERT_UNREACHABLE;
+		void emitCompare(x64Emitter& a, const laX64Insn& insn) const
+		{
+			const auto ra = get(a, insn.a, RA);
+			const auto rb = get(a, insn.b, RD);
+			if (insn.width == 8)
+			{
+				a.rr8(0, false, 0x38, rb, ra); // cmp ra8, rb8
+			}
+			else
+			{
+				a.rr(0, insn.width == 64, 0x39, rb, ra); // cmp ra, rb
+			}
 		}
-#endif
+
+		void emit(std::vector<uint8_t>& out, std::vector<std::pair<uint32_t, uint32_t>>& call_fixups, std::vector<uint32_t>& memory_fixups) const
+		{
+			x64Emitter a{ out };
+			std::vector<uint32_t> label_positions(num_labels);
+			std::vector<std::pair<uint32_t, uint32_t>> label_fixups{};
+			for (const auto& insn : insns)
+			{
+				switch (insn.op)
+				{
+				case LA_X64_ENTRY:
+					{
+						for (const auto& reg : saved_regs)
+						{
+							a.prefixAndRex(0, false, 0, reg);
+							a.u8(0x50 | (reg & 7)); // push
+						}
+						if (frame_size != 0)
+						{
+							a.rr(0, true, 0x81, 5, SP); // sub rsp, imm32
+							a.u32(frame_size);
+						}
+						std::vector<std::pair<uint8_t, uint8_t>> moves{};
+						for (uint32_t i = 0; i != fn.parameters.size(); ++i)
+						{
+							if (locs[i].kind == laX64Location::REG)
+							{
+								moves.emplace_back(la_x64_args[i], locs[i].reg);
+							}
+							else
+							{
+								put(a, i, la_x64_args[i]);
+							}
+						}
+						parallelMove(a, moves);
+					}
+					break;
+
+				case LA_X64_MOV_IMM:
+					if (locs[insn.dst].kind == laX64Location::SLOT
+						&& insn.imm >= INT32_MIN && insn.imm <= INT32_MAX
+						)
+					{
+						a.mem(0, true, 0xC7, 0, SP, getSlotOffset(locs[insn.dst].slot)); // mov qword [rsp + slot], simm32
+						a.u32(static_cast<uint32_t>(insn.imm));
+					}
+					else if (locs[insn.dst].kind != laX64Location::NONE)
+					{
+						const auto d = target(insn.dst, RA);
+						movImm(a, d, insn.imm);
+						put(a, insn.dst, d);
+					}
+					break;
+
+				case LA_X64_MOV:
+					if (locs[insn.dst].kind != laX64Location::NONE)
+					{
+						put(a, insn.dst, get(a, insn.a, RA));
+					}
+					break;
+
+				case LA_X64_ADD:
+				case LA_X64_SUB:
+				case LA_X64_IMUL:
+					if (locs[insn.dst].kind != laX64Location::NONE)
+					{
+						const bool w = (insn.width == 64);
+						auto op = [&](uint8_t dst, uint8_t src)
+						{
+							switch (insn.op)
+							{
+							case LA_X64_ADD: a.rr(0, w, 0x01, src, dst); break;
+							case LA_X64_SUB: a.rr(0, w, 0x29, src, dst); break;
+							default: a.rr(0, w, 0x0F'AF, dst, src); break; // imul dst, src
+							}
+						};
+						const auto d = target(insn.dst, RA);
+						const auto rb = get(a, insn.b, RD);
+						if (d == rb && !(locs[insn.a].kind == laX64Location::REG && locs[insn.a].reg == d))
+						{
+							if (insn.op == LA_X64_SUB)
+							{
+								mov(a, RA, get(a, insn.a, RA));
+								op(RA, rb);
+								mov(a, d, RA);
+							}
+							else
+							{
+								op(d, get(a, insn.a, R11));
+							}
+						}
+						else
+						{
+							mov(a, d, get(a, insn.a, d));
+							op(d, rb);
+						}
+						put(a, insn.dst, d);
+					}
+					break;
+
+				case LA_X64_SDIV:
+				case LA_X64_UDIV:
+				case LA_X64_SMOD:
+				case LA_X64_UMOD:
+					{
+						const bool is_signed = (insn.op == LA_X64_SDIV || insn.op == LA_X64_SMOD);
+						mov(a, RA, get(a, insn.a, RA));
+						if (is_signed)
+						{
+							a.u8(0x48); a.u8(0x99); // cqo
+						}
+						else
+						{
+							a.rr(0, false, 0x31, RD, RD); // xor edx, edx
+						}
+						a.rr(0, true, 0xF7, is_signed ? 7 : 6, get(a, insn.b, R11)); // idiv/div
+						if (locs[insn.dst].kind != laX64Location::NONE)
+						{
+							put(a, insn.dst, (insn.op == LA_X64_SDIV || insn.op == LA_X64_UDIV) ? RA : RD);
+						}
+					}
+					break;
+
+				case LA_X64_SETCC:
+					if (locs[insn.dst].kind != laX64Location::NONE)
+					{
+						emitCompare(a, insn);
+						const auto d = target(insn.dst, RA);
+						a.setcc(insn.cc, d);
+						a.rr8(0, false, 0x0F'B6, d, d); // movzx d32, d8
+						put(a, insn.dst, d);
+					}
+					break;
+
+				case LA_X64_MOVSXD:
+				case LA_X64_MOV32:
+				case LA_X64_MOVSX8:
+				case LA_X64_MOVZX8:
+					if (locs[insn.dst].kind != laX64Location::NONE)
+					{
+						const auto ra = get(a, insn.a, RA);
+						const auto d = target(insn.dst, RA);
+						switch (insn.op)
+						{
+						case LA_X64_MOVSXD: a.rr(0, true, 0x63, d, ra); break;
+						case LA_X64_MOV32: a.rr(0, false, 0x89, ra, d); break;
+						case LA_X64_MOVSX8: a.rr8(0, true, 0x0F'BE, d, ra); break;
+						default: a.rr8(0, false, 0x0F'B6, d, ra); break;
+						}
+						put(a, insn.dst, d);
+					}
+					break;
+
+				case LA_X64_LOAD8:
+					if (locs[insn.dst].kind != laX64Location::NONE)
+					{
+						const auto rp = get(a, insn.a, RD);
+						leaMemory(a, memory_fixups);
+						a.rr(0, true, 0x01, rp, R11); // add r11, rp
+						const auto d = target(insn.dst, RA);
+						a.mem(0, false, 0x0F'B6, d, R11, 0); // movzx d32, byte [r11]
+						put(a, insn.dst, d);
+					}
+					break;
+
+				case LA_X64_STORE8:
+				case LA_X64_STORE32:
+				case LA_X64_STORE64:
+					{
+						const auto rp = get(a, insn.a, RD);
+						const auto rv = get(a, insn.b, RA);
+						leaMemory(a, memory_fixups);
+						a.rr(0, true, 0x01, rp, R11); // add r11, rp
+						switch (insn.op)
+						{
+						case LA_X64_STORE8: a.mem(0, false, 0x88, rv, R11, 0); break; // the rex prefix for r11 also makes 4-7 mean spl-dil
+						case LA_X64_STORE32: a.mem(0, false, 0x89, rv, R11, 0); break;
+						default: a.mem(0, true, 0x89, rv, R11, 0); break;
+						}
+					}
+					break;
+
+				case LA_X64_LABEL:
+					label_positions[insn.imm] = a.pos();
+					break;
+
+				case LA_X64_JMP:
+					label_fixups.emplace_back(a.jmp(), static_cast<uint32_t>(insn.imm));
+					break;
+
+				case LA_X64_JZ:
+					{
+						const auto rc = get(a, insn.a, RA);
+						a.rr8(0, false, 0x84, rc, rc); // test rc8, rc8
+						label_fixups.emplace_back(a.jcc(CC_E), static_cast<uint32_t>(insn.imm));
+					}
+					break;
+
+				case LA_X64_JCC:
+					emitCompare(a, insn);
+					label_fixups.emplace_back(a.jcc(insn.cc), static_cast<uint32_t>(insn.imm));
+					break;
+
+				case LA_X64_CALL:
+					{
+						// Registers are moved first, since loading spilled arguments may overwrite their sources.
+						std::vector<std::pair<uint8_t, uint8_t>> moves{};
+						for (size_t i = 0; i != insn.args.size(); ++i)
+						{
+							if (locs[insn.args[i]].kind == laX64Location::REG)
+							{
+								moves.emplace_back(locs[insn.args[i]].reg, la_x64_args[i]);
+							}
+						}
+						parallelMove(a, moves);
+						for (size_t i = 0; i != insn.args.size(); ++i)
+						{
+							if (locs[insn.args[i]].kind != laX64Location::REG)
+							{
+								a.mem(0, true, 0x8B, la_x64_args[i], SP, getSlotOffset(locs[insn.args[i]].slot)); // mov arg, [rsp + slot]
+							}
+						}
+						if (insn.imm >= 0)
+						{
+							a.u8(0xE8); // call rel32
+							call_fixups.emplace_back(a.pos(), static_cast<uint32_t>(insn.imm));
+							a.u32(0);
+						}
+						else
+						{
+							// posix.write: turn the pointer into an address
+							leaMemory(a, memory_fixups);
+							a.rr(0, true, 0x01, R11, la_x64_args[1]); // add arg1, r11
+							a.callAbs(reinterpret_cast<const void*>(&laX64PosixWrite));
+						}
+						if (insn.dst != LA_X64_NONE)
+						{
+							put(a, insn.dst, RA);
+						}
+					}
+					break;
+
+				case LA_X64_RET:
+					if (insn.a != LA_X64_NONE)
+					{
+						mov(a, RA, get(a, insn.a, RA));
+					}
+					emitEpilogue(a);
+					break;
+				}
+			}
+			for (const auto& fixup : label_fixups)
+			{
+				a.patch(fixup.first, label_positions[fixup.second]);
+			}
+		}
+	};
+
+	void laX64Backend::linkPosix(irModule&)
+	{
+		// posix.write is bound to a host function by compileModule, so there's nothing to rewrite.
+	}
+
+	std::string laX64Backend::compileModule(const irModule& m) const
+	{
+		std::vector<uint32_t> entrypoints{};
+		size_t memory_offset;
+		return compileModule(m, entrypoints, memory_offset);
 	}
 
-	void laX64Backend::discard(StringWriter& w, int nres)
+	std::string laX64Backend::compileModule(const irModule& m, std::vector<uint32_t>& entrypoints, size_t& memory_offset) const
 	{
-		uint8_t b;
-		while (nres--)
+		std::vector<uint8_t> out{};
+		std::vector<std::pair<uint32_t, uint32_t>> call_fixups{};
+		std::vector<uint32_t> memory_fixups{};
+		entrypoints.clear();
+		for (const auto& fn : m.func_exports)
+		{
+			entrypoints.emplace_back(static_cast<uint32_t>(out.size()));
+			laX64FunctionCompiler c(m, fn);
+			c.lowerFunction();
+			c.allocateRegisters();
+			c.emit(out, call_fixups, memory_fixups);
+		}
+
+		memory_offset = (out.size() + 0xFFF) & ~size_t(0xFFF);
+		x64Emitter a{ out };
+		for (const auto& fixup : call_fixups)
 		{
-			b = 0x41; w.u8(b); b = 0x5a; w.u8(b); // pop r10
+			a.patch(fixup.first, entrypoints.at(fixup.second));
 		}
+		for (const auto& fixup : memory_fixups)
+		{
+			a.patch(fixup, static_cast<uint32_t>(memory_offset));
+		}
+
+		std::string bin(out.begin(), out.end());
+		bin.resize(memory_offset, '\xCC'); // int3
+		bin.append(m.getContiguousMemory());
+		return bin;
 	}
 
-	x64Register laX64Backend::getIncomingRegister(const irExpression& e)
+	laX64Backend::Executable laX64Backend::load(const irModule& m) const
 	{
-		switch (e.type)
+		Executable exe;
+		const auto bin = compileModule(m, exe.entrypoints, exe.memory_offset);
+		exe.memory_size = bin.size() - exe.memory_offset;
+		exe.alloc = soup::make_unique<AllocRaiiVirtual>(std::max<size_t>(bin.size(), 1), memGuard::ACC_READ | memGuard::ACC_WRITE);
+		SOUP_ASSERT(exe.alloc->addr != nullptr);
+		memcpy(exe.alloc->addr, bin.data(), bin.size());
+		if (exe.memory_offset != 0)
 		{
-		case IR_LOCAL_GET:
-			// Note: This is for the Windows ABI. Linux places call arguments in different registers.
-			switch (e.local_get.index)
-			{
-			case 0: return RC;
-			case 1: return RD;
-			case 2: return R8;
-			case 3: return R9;
-			// The rest would be on the stack...
-			default: SOUP_ASSERT_UNREACHABLE;
-			}
-
-		default:
-			break;
+			memGuard::setAllowedAccess(exe.alloc->addr, exe.memory_offset, memGuard::ACC_READ | memGuard::ACC_EXEC);
 		}
-		return R10;
+		return exe;
 	}
 }
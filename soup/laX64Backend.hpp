@@ -2,16 +2,49 @@
 
 #include "laBackend.hpp"
 
-#include "x64.hpp"
+#include "AllocRaiiVirtual.hpp"
+#include "UniquePtr.hpp"
 
 NAMESPACE_SOUP
 {
-	// Work in progress, hence not extending laBackend yet.
-	struct laX64Backend
+	// Compiles IR to x86-64 machine code using the calling convention of the host (Windows x64 or System V).
+	// Each function's expression trees are flattened into instructions on virtual registers, which are then assigned to machine registers by a linear scan, spilling to the stack when they run out.
+	class laX64Backend : public laBackend
 	{
-		[[nodiscard]] static std::string compileFunction(const irModule& m, const irFunction& fn);
-		static int compileExpression(const irModule& m, StringWriter& w, const irExpression& e, const irExpression* outgoing);
-		static void discard(StringWriter& w, int nres);
-		[[nodiscard]] static x64Register getIncomingRegister(const irExpression& e);
+	public:
+		// A compiled module mapped into memory. Functions are called with their IR types as the corresponding C++ integer types; pointers are offsets into the module's memory.
+		struct Executable
+		{
+			UniquePtr<AllocRaiiVirtual> alloc{};
+			std::vector<uint32_t> entrypoints{}; // parallel to irModule::func_exports
+			size_t memory_offset = 0;
+			size_t memory_size = 0;
+
+			[[nodiscard]] void* getFunction(size_t index) const noexcept
+			{
+				return reinterpret_cast<uint8_t*>(alloc->addr) + entrypoints.at(index);
+			}
+
+			[[nodiscard]] uint8_t* getMemory() const noexcept
+			{
+				return reinterpret_cast<uint8_t*>(alloc->addr) + memory_offset;
+			}
+
+			template <typename Ret, typename...Args>
+			Ret call(size_t index, Args...args) const
+			{
+				return reinterpret_cast<Ret(*)(Args...)>(getFunction(index))(args...);
+			}
+		};
+
+		void linkPosix(irModule& m) final;
+
+		// Returns the code for all functions, followed by the module's memory at the next page boundary.
+		// Calls to posix.write refer to a host function by its absolute address, so the result is only meaningful to the current process.
+		[[nodiscard]] std::string compileModule(const irModule& m) const final;
+		[[nodiscard]] std::string compileModule(const irModule& m, std::vector<uint32_t>& entrypoints, size_t& memory_offset) const;
+
+		// Compiles the module and maps it into memory such that its functions can be called directly. This requires an x86-64 host.
+		[[nodiscard]] Executable load(const irModule& m) const;
 	};
 }
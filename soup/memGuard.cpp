@@ -54,16 +54,30 @@ NAMESPACE_SOUP
 	void* memGuard::alloc(size_t len, int allowed_access)
 	{
 #if SOUP_WINDOWS
+		if (allowed_access == 0)
+		{
+			return VirtualAlloc(nullptr, len, MEM_RESERVE, PAGE_NOACCESS);
+		}
 		return VirtualAlloc(nullptr, len, MEM_COMMIT | MEM_RESERVE, allowedAccessToProtect(allowed_access));
 #else
-		return mmap(nullptr, len, allowed_access, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		void* addr = mmap(nullptr, len, allowed_access, MAP_PRIVATE | MAP_ANONYMOUS | (allowed_access == 0 ? MAP_NORESERVE : 0), -1, 0);
+		return addr == MAP_FAILED ? nullptr : addr;
+#endif
+	}
+
+	bool memGuard::commit(void* addr, size_t len, int allowed_access)
+	{
+#if SOUP_WINDOWS
+		return VirtualAlloc(addr, len, MEM_COMMIT, allowedAccessToProtect(allowed_access)) != nullptr;
+#else
+		return mprotect(addr, len, allowed_access) == 0;
 #endif
 	}
 
 	void memGuard::free(void* addr, size_t len)
 	{
 #if SOUP_WINDOWS
-		VirtualFree(addr, len, MEM_DECOMMIT);
+		VirtualFree(addr, 0, MEM_RELEASE);
 #else
 		munmap(addr, len);
 #endif
@@ -25,7 +25,10 @@ NAMESPACE_SOUP
 		[[nodiscard]] static int protectToAllowedAccess(DWORD protect);
 #endif
 
+		// With allowed_access = 0, the address space is only reserved; use commit to make parts of it usable. Returns nullptr on failure.
 		[[nodiscard]] static void* alloc(size_t len, int allowed_access);
+		// Backs reserved pages with zeroed memory.
+		[[nodiscard]] static bool commit(void* addr, size_t len, int allowed_access);
 		static void free(void* addr, size_t len);
 		static void setAllowedAccess(void* addr, size_t len, int allowed_access, int* old_allowed_access = nullptr);
 		static int getAllowedAccess(void* addr);
@@ -23,5 +23,9 @@ NAMESPACE_SOUP
 
 		// Does the AS belong to a hosting provider? Can be used to tell if this is a VPN.
 		[[nodiscard]] bool isHosting(const netIntel& intel) const SOUP_EXCAL;
+		[[nodiscard]] bool isHosting(const netIntelSnapshot& snapshot) const SOUP_EXCAL;
+
+	private:
+		[[nodiscard]] bool isHosting(WasmScript& ws) const SOUP_EXCAL;
 	};
 }
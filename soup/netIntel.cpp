@@ -1,5 +1,8 @@
 #include "netIntel.hpp"
 
+#include <algorithm> // sort
+#include <cstring> // memcpy
+
 #include "bitutil.hpp"
 #include "CidrSubnet4Interface.hpp"
 #include "CidrSubnet6Interface.hpp"
@@ -8,6 +11,7 @@
 #include "FileWriter.hpp"
 #include "Ipv6Maths.hpp"
 #include "netIntelLocationData4OnDisk.hpp"
+#include "netIntelSnapshot.hpp"
 #include "string.hpp"
 #include "StringReader.hpp"
 #include "wasm.hpp"
@@ -163,6 +167,7 @@ NAMESPACE_SOUP
 			}
 			ipv4toas.emplace(begin, end, as);
 		}
+		ipv4toas.freeze();
 	}
 
 	void netIntel::initIpv6ToAs()
@@ -195,6 +200,7 @@ NAMESPACE_SOUP
 			}
 			ipv6toas.emplace(std::move(begin), std::move(end), as);
 		}
+		ipv6toas.freeze();
 	}
 
 	void netIntel::initIpv4ToLocation()
@@ -223,6 +229,7 @@ NAMESPACE_SOUP
 				}
 			);
 		}
+		ipv4tolocation.freeze();
 	}
 
 	void netIntel::initIpv6ToLocation()
@@ -250,6 +257,7 @@ NAMESPACE_SOUP
 				location_pool.emplace(std::move(arr.at(5))),
 			});
 		}
+		ipv6tolocation.freeze();
 	}
 
 	const netAs* netIntel::getAsByNumber(uint32_t number) const noexcept
@@ -410,4 +418,130 @@ NAMESPACE_SOUP
 			}
 		}
 	}
+
+	void netIntel::saveSnapshot(const std::filesystem::path& path) const
+	{
+		std::string strings{};
+		std::unordered_map<const char*, uint32_t> string_offsets{};
+		auto addString = [&](const char* str) -> uint32_t
+		{
+			if (str == nullptr)
+			{
+				return netIntelSnapshot::NO_STRING;
+			}
+			auto e = string_offsets.find(str);
+			if (e == string_offsets.end())
+			{
+				e = string_offsets.emplace(str, static_cast<uint32_t>(strings.size())).first;
+				strings.append(str);
+				strings.push_back('\0');
+			}
+			return e->second;
+		};
+
+		std::vector<const netAs*> as_sorted{};
+		as_sorted.reserve(aslist.size());
+		for (const auto& e : aslist)
+		{
+			as_sorted.emplace_back(e.second.get());
+		}
+		std::sort(as_sorted.begin(), as_sorted.end(), [](const netAs* a, const netAs* b)
+		{
+			return a->number < b->number;
+		});
+		std::unordered_map<const netAs*, uint32_t> as_indices{};
+		std::vector<netIntelSnapshot::AsRecord> as_records{};
+		as_indices.reserve(as_sorted.size());
+		as_records.reserve(as_sorted.size());
+		for (const auto& as : as_sorted)
+		{
+			as_indices.emplace(as, static_cast<uint32_t>(as_records.size()));
+			as_records.emplace_back(netIntelSnapshot::AsRecord{ as->number, addString(as->handle), addString(as->name) });
+		}
+
+		auto makeLocation = [&](const netIntelLocationData& data)
+		{
+			netIntelSnapshot::LocationRecord rec{};
+			memcpy(rec.country_code, data.country_code.data(), 2);
+			rec.state = addString(data.state);
+			rec.city = addString(data.city);
+			return rec;
+		};
+		std::vector<netIntelSnapshot::Ipv4LocationRecord> ipv4tolocation_records{};
+		ipv4tolocation_records.reserve(ipv4tolocation.data.size());
+		for (const auto& e : ipv4tolocation.data)
+		{
+			ipv4tolocation_records.emplace_back(netIntelSnapshot::Ipv4LocationRecord{ e.lower, e.upper, makeLocation(e.data) });
+		}
+		std::vector<netIntelSnapshot::Ipv6LocationRecord> ipv6tolocation_records{};
+		ipv6tolocation_records.reserve(ipv6tolocation.data.size());
+		for (const auto& e : ipv6tolocation.data)
+		{
+			auto& rec = ipv6tolocation_records.emplace_back();
+			memcpy(rec.lower, e.lower.bytes, 16);
+			memcpy(rec.upper, e.upper.bytes, 16);
+			rec.location = makeLocation(e.data);
+		}
+
+		std::vector<netIntelSnapshot::Ipv4AsRecord> ipv4toas_records{};
+		ipv4toas_records.reserve(ipv4toas.data.size());
+		for (const auto& e : ipv4toas.data)
+		{
+			ipv4toas_records.emplace_back(netIntelSnapshot::Ipv4AsRecord{ e.lower, e.upper, as_indices.at(e.data) });
+		}
+		std::vector<netIntelSnapshot::Ipv6AsRecord> ipv6toas_records{};
+		ipv6toas_records.reserve(ipv6toas.data.size());
+		for (const auto& e : ipv6toas.data)
+		{
+			auto& rec = ipv6toas_records.emplace_back();
+			memcpy(rec.lower, e.lower.bytes, 16);
+			memcpy(rec.upper, e.upper.bytes, 16);
+			rec.as = as_indices.at(e.data);
+		}
+
+		SOUP_ASSERT(strings.size() < netIntelSnapshot::NO_STRING);
+
+		netIntelSnapshot::Header header{};
+		header.magic = netIntelSnapshot::MAGIC;
+		header.version = netIntelSnapshot::VERSION;
+		header.byte_order = netIntelSnapshot::BYTE_ORDER_MARK;
+		header.num_sections = netIntelSnapshot::NUM_SECTIONS;
+		const std::pair<const void*, size_t> sections[netIntelSnapshot::NUM_SECTIONS] = {
+			{ strings.data(), strings.size() },
+			{ as_records.data(), as_records.size() * sizeof(netIntelSnapshot::AsRecord) },
+			{ ipv4toas_records.data(), ipv4toas_records.size() * sizeof(netIntelSnapshot::Ipv4AsRecord) },
+			{ ipv6toas_records.data(), ipv6toas_records.size() * sizeof(netIntelSnapshot::Ipv6AsRecord) },
+			{ ipv4tolocation_records.data(), ipv4tolocation_records.size() * sizeof(netIntelSnapshot::Ipv4LocationRecord) },
+			{ ipv6tolocation_records.data(), ipv6tolocation_records.size() * sizeof(netIntelSnapshot::Ipv6LocationRecord) },
+			{ extra_wasm.data(), extra_wasm.size() },
+		};
+		const size_t counts[netIntelSnapshot::NUM_SECTIONS] = {
+			strings.size(),
+			as_records.size(),
+			ipv4toas_records.size(),
+			ipv6toas_records.size(),
+			ipv4tolocation_records.size(),
+			ipv6tolocation_records.size(),
+			extra_wasm.size(),
+		};
+		uint64_t offset = sizeof(header);
+		for (uint8_t s = 0; s != netIntelSnapshot::NUM_SECTIONS; ++s)
+		{
+			offset = (offset + 15) & ~15ull;
+			header.sections[s].offset = offset;
+			header.sections[s].count = counts[s];
+			offset += sections[s].second;
+		}
+
+		FileWriter fw(path);
+		fw.throwIfFailed();
+		fw.raw(&header, sizeof(header));
+		for (uint8_t s = 0; s != netIntelSnapshot::NUM_SECTIONS; ++s)
+		{
+			const char padding[16] = { 0 };
+			fw.raw(const_cast<char*>(padding), header.sections[s].offset - fw.getPosition());
+			fw.raw(const_cast<void*>(sections[s].first), sections[s].second);
+		}
+		SOUP_ASSERT(fw.s.good(), "Failed to write netIntel snapshot");
+	}
 }
@@ -65,5 +65,8 @@ NAMESPACE_SOUP
 
 	public:
 		void locationExport(const std::filesystem::path& dir);
+
+		// Writes everything that has been inited to a file which netIntelSnapshot can open instantly.
+		void saveSnapshot(const std::filesystem::path& path) const;
 	};
 }
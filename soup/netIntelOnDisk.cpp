@@ -9,6 +9,9 @@ NAMESPACE_SOUP
 		ipv4tolocation_fr(dir / "ipv4tolocation.bin"),
 		ipv4tolocation_dr(ipv4tolocation_fr, measurePacket<netIntelLocationData4OnDisk>())
 	{
+		// Lookups are binary searches & string reads at arbitrary offsets, so read-ahead would only waste I/O.
+		location_pool.adviseRandom();
+		ipv4tolocation_fr.adviseRandom();
 	}
 
 	netIntelLocationDataSelfContained netIntelOnDisk::getLocationByIpv4(native_u32_t ip)
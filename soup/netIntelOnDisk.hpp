@@ -5,15 +5,15 @@
 #include <filesystem>
 
 #include "DiskDbReader.hpp"
-#include "FileReader.hpp"
+#include "MappedFileReader.hpp"
 #include "netIntelLocationData.hpp"
 
 NAMESPACE_SOUP
 {
 	struct netIntelOnDisk
 	{
-		FileReader location_pool;
-		FileReader ipv4tolocation_fr;
+		MappedFileReader location_pool;
+		MappedFileReader ipv4tolocation_fr;
 		DiskDbReader ipv4tolocation_dr;
 
 		netIntelOnDisk(const std::filesystem::path& dir);
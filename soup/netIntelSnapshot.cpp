@@ -0,0 +1,211 @@
+#include "netIntelSnapshot.hpp"
+
+#include <cstring> // memcmp
+
+#include "Exception.hpp"
+
+NAMESPACE_SOUP
+{
+	static_assert(sizeof(netIntelSnapshot::Header) == 16 + netIntelSnapshot::NUM_SECTIONS * 16);
+	static_assert(sizeof(netIntelSnapshot::AsRecord) == 12);
+	static_assert(sizeof(netIntelSnapshot::Ipv4AsRecord) == 12);
+	static_assert(sizeof(netIntelSnapshot::Ipv6AsRecord) == 36);
+	static_assert(sizeof(netIntelSnapshot::Ipv4LocationRecord) == 20);
+	static_assert(sizeof(netIntelSnapshot::Ipv6LocationRecord) == 44);
+
+	static constexpr size_t snapshot_record_sizes[netIntelSnapshot::NUM_SECTIONS] = {
+		1,
+		sizeof(netIntelSnapshot::AsRecord),
+		sizeof(netIntelSnapshot::Ipv4AsRecord),
+		sizeof(netIntelSnapshot::Ipv6AsRecord),
+		sizeof(netIntelSnapshot::Ipv4LocationRecord),
+		sizeof(netIntelSnapshot::Ipv6LocationRecord),
+		1,
+	};
+
+	netIntelSnapshot::netIntelSnapshot(const std::filesystem::path& path)
+		: file(path)
+	{
+		SOUP_IF_UNLIKELY (!file.isOpen() || file.size < sizeof(Header))
+		{
+			SOUP_THROW(Exception("Failed to open netIntel snapshot"));
+		}
+		header = reinterpret_cast<const Header*>(file.data);
+		SOUP_IF_UNLIKELY (header->magic != MAGIC || header->byte_order != BYTE_ORDER_MARK)
+		{
+			SOUP_THROW(Exception("Not a netIntel snapshot"));
+		}
+		SOUP_IF_UNLIKELY (header->version != VERSION || header->num_sections != NUM_SECTIONS)
+		{
+			SOUP_THROW(Exception("Unsupported netIntel snapshot version"));
+		}
+		for (uint8_t s = 0; s != NUM_SECTIONS; ++s)
+		{
+			const auto& info = header->sections[s];
+			SOUP_IF_UNLIKELY (info.offset > file.size
+				|| (info.offset % 4) != 0
+				|| info.count > (file.size - info.offset) / snapshot_record_sizes[s]
+				)
+			{
+				SOUP_THROW(Exception("netIntel snapshot is truncated or corrupt"));
+			}
+		}
+		SOUP_IF_UNLIKELY (header->sections[STRINGS].count != 0
+			&& file.data[header->sections[STRINGS].offset + header->sections[STRINGS].count - 1] != 0
+			)
+		{
+			SOUP_THROW(Exception("netIntel snapshot is truncated or corrupt"));
+		}
+		// Lookups are binary searches, so read-ahead would only waste I/O.
+		file.adviseRandom();
+	}
+
+	// Returns the last record whose lower bound is <= k, if k is also within its upper bound.
+	template <typename T, typename K, typename Less>
+	[[nodiscard]] static const T* findSnapshotRange(const T* base, size_t len, const K& k, Less less) noexcept
+	{
+		if (len == 0)
+		{
+			return nullptr;
+		}
+		while (len > 1)
+		{
+			const size_t half = len / 2;
+			if (!less(k, base[half].lower))
+			{
+				base += half;
+			}
+			len -= half;
+		}
+		if (less(k, base->lower) || less(base->upper, k))
+		{
+			return nullptr;
+		}
+		return base;
+	}
+
+	[[nodiscard]] static bool lessIpv4(uint32_t a, uint32_t b) noexcept
+	{
+		return a < b;
+	}
+
+	[[nodiscard]] static bool lessIpv6(const uint8_t* a, const uint8_t* b) noexcept
+	{
+		return memcmp(a, b, 16) < 0;
+	}
+
+	Optional<netAs> netIntelSnapshot::getAsByNumber(uint32_t number) const noexcept
+	{
+		const AsRecord* base = getSection<AsRecord>(AS);
+		size_t len = header->sections[AS].count;
+		while (len != 0)
+		{
+			const size_t half = len / 2;
+			if (base[half].number < number)
+			{
+				base += half + 1;
+				len -= half + 1;
+			}
+			else
+			{
+				len = half;
+			}
+		}
+		if (base != getSection<AsRecord>(AS) + header->sections[AS].count
+			&& base->number == number
+			)
+		{
+			return getAs(static_cast<uint32_t>(base - getSection<AsRecord>(AS)));
+		}
+		return std::nullopt;
+	}
+
+	Optional<netAs> netIntelSnapshot::getAsByIp(const IpAddr& addr) const noexcept
+	{
+		return addr.isV4()
+			? getAsByIpv4(addr.getV4NativeEndian())
+			: getAsByIpv6(addr)
+			;
+	}
+
+	Optional<netAs> netIntelSnapshot::getAsByIpv4(native_u32_t ip) const noexcept
+	{
+		if (auto rec = findSnapshotRange(getSection<Ipv4AsRecord>(IPV4_AS), header->sections[IPV4_AS].count, static_cast<uint32_t>(ip), &lessIpv4))
+		{
+			return getAs(rec->as);
+		}
+		return std::nullopt;
+	}
+
+	Optional<netAs> netIntelSnapshot::getAsByIpv6(const IpAddr& addr) const noexcept
+	{
+		if (auto rec = findSnapshotRange(getSection<Ipv6AsRecord>(IPV6_AS), header->sections[IPV6_AS].count, addr.bytes, &lessIpv6))
+		{
+			return getAs(rec->as);
+		}
+		return std::nullopt;
+	}
+
+	Optional<netIntelLocationData> netIntelSnapshot::getLocationByIp(const IpAddr& addr) const noexcept
+	{
+		return addr.isV4()
+			? getLocationByIpv4(addr.getV4NativeEndian())
+			: getLocationByIpv6(addr)
+			;
+	}
+
+	Optional<netIntelLocationData> netIntelSnapshot::getLocationByIpv4(native_u32_t ip) const noexcept
+	{
+		if (auto rec = findSnapshotRange(getSection<Ipv4LocationRecord>(IPV4_LOCATION), header->sections[IPV4_LOCATION].count, static_cast<uint32_t>(ip), &lessIpv4))
+		{
+			return getLocation(rec->location);
+		}
+		return std::nullopt;
+	}
+
+	Optional<netIntelLocationData> netIntelSnapshot::getLocationByIpv6(const IpAddr& addr) const noexcept
+	{
+		if (auto rec = findSnapshotRange(getSection<Ipv6LocationRecord>(IPV6_LOCATION), header->sections[IPV6_LOCATION].count, addr.bytes, &lessIpv6))
+		{
+			return getLocation(rec->location);
+		}
+		return std::nullopt;
+	}
+
+	std::string_view netIntelSnapshot::getExtraWasm() const noexcept
+	{
+		return std::string_view(getSection<char>(EXTRA_WASM), header->sections[EXTRA_WASM].count);
+	}
+
+	const char* netIntelSnapshot::getString(uint32_t offset) const noexcept
+	{
+		SOUP_IF_UNLIKELY (offset >= header->sections[STRINGS].count) // NO_STRING or corrupt. The section is null-terminated, so any offset within it is fine.
+		{
+			return "";
+		}
+		return getSection<char>(STRINGS) + offset;
+	}
+
+	Optional<netAs> netIntelSnapshot::getAs(uint32_t index) const noexcept
+	{
+		SOUP_IF_UNLIKELY (index >= header->sections[AS].count) // Corrupt
+		{
+			return std::nullopt;
+		}
+		const AsRecord& rec = getSection<AsRecord>(AS)[index];
+		netAs as;
+		as.number = rec.number;
+		as.handle = getString(rec.handle);
+		as.name = getString(rec.name);
+		return as;
+	}
+
+	netIntelLocationData netIntelSnapshot::getLocation(const LocationRecord& rec) const noexcept
+	{
+		netIntelLocationData data;
+		memcpy(data.country_code.data(), rec.country_code, 2);
+		data.state = getString(rec.state);
+		data.city = getString(rec.city);
+		return data;
+	}
+}
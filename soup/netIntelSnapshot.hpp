@@ -0,0 +1,126 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+
+#include "IpAddr.hpp"
+#include "MappedFileReader.hpp"
+#include "netAs.hpp"
+#include "netIntelLocationData.hpp"
+#include "Optional.hpp"
+
+NAMESPACE_SOUP
+{
+	// Read-only view of a file written by netIntel::saveSnapshot.
+	// The file is memory-mapped and used in place, so opening it takes no parsing and the pages are shared between processes.
+	class netIntelSnapshot
+	{
+	public:
+		static constexpr uint32_t MAGIC = 0x494e5053; // "SPNI"
+		static constexpr uint32_t VERSION = 1;
+		static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304; // snapshots are stored in native byte order
+		static constexpr uint32_t NO_STRING = 0xffffffff;
+
+		enum Section : uint8_t
+		{
+			STRINGS = 0, // nul-terminated strings, referenced by offset
+			AS,
+			IPV4_AS,
+			IPV6_AS,
+			IPV4_LOCATION,
+			IPV6_LOCATION,
+			EXTRA_WASM,
+
+			NUM_SECTIONS
+		};
+
+		struct SectionInfo
+		{
+			uint64_t offset;
+			uint64_t count; // number of records, or bytes for STRINGS and EXTRA_WASM
+		};
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t byte_order;
+			uint32_t num_sections;
+			SectionInfo sections[NUM_SECTIONS];
+		};
+
+		struct AsRecord
+		{
+			uint32_t number;
+			uint32_t handle;
+			uint32_t name;
+		};
+
+		struct Ipv4AsRecord
+		{
+			uint32_t lower;
+			uint32_t upper;
+			uint32_t as; // index into the AS section
+		};
+
+		struct Ipv6AsRecord
+		{
+			uint8_t lower[16];
+			uint8_t upper[16];
+			uint32_t as; // index into the AS section
+		};
+
+		struct LocationRecord
+		{
+			char country_code[2];
+			uint16_t reserved;
+			uint32_t state;
+			uint32_t city;
+		};
+
+		struct Ipv4LocationRecord
+		{
+			uint32_t lower;
+			uint32_t upper;
+			LocationRecord location;
+		};
+
+		struct Ipv6LocationRecord
+		{
+			uint8_t lower[16];
+			uint8_t upper[16];
+			LocationRecord location;
+		};
+
+		MappedFileReader file;
+		const Header* header;
+
+		// Throws if the file can't be opened or is not a snapshot of this version.
+		netIntelSnapshot(const std::filesystem::path& path);
+
+		[[nodiscard]] size_t getNumAs() const noexcept { return header->sections[AS].count; }
+
+		[[nodiscard]] Optional<netAs> getAsByNumber(uint32_t number) const noexcept;
+
+		[[nodiscard]] Optional<netAs> getAsByIp(const IpAddr& addr) const noexcept;
+		[[nodiscard]] Optional<netAs> getAsByIpv4(native_u32_t ip) const noexcept;
+		[[nodiscard]] Optional<netAs> getAsByIpv6(const IpAddr& addr) const noexcept;
+
+		[[nodiscard]] Optional<netIntelLocationData> getLocationByIp(const IpAddr& addr) const noexcept;
+		[[nodiscard]] Optional<netIntelLocationData> getLocationByIpv4(native_u32_t ip) const noexcept;
+		[[nodiscard]] Optional<netIntelLocationData> getLocationByIpv6(const IpAddr& addr) const noexcept;
+
+		[[nodiscard]] std::string_view getExtraWasm() const noexcept;
+
+	protected:
+		template <typename T>
+		[[nodiscard]] const T* getSection(Section s) const noexcept
+		{
+			return reinterpret_cast<const T*>(file.data + header->sections[s].offset);
+		}
+
+		[[nodiscard]] const char* getString(uint32_t offset) const noexcept; // Returns an empty string for NO_STRING.
+		[[nodiscard]] Optional<netAs> getAs(uint32_t index) const noexcept; // Returns std::nullopt if the index is out of range.
+		[[nodiscard]] netIntelLocationData getLocation(const LocationRecord& rec) const noexcept;
+	};
+}
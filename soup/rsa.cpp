@@ -105,16 +105,20 @@ NAMESPACE_SOUP
 	// KeyMontgomeryData
 
 	RsaKeyMontgomeryData::RsaKeyMontgomeryData(const Bigint& n)
-		: re(n.montgomeryREFromM()),
-		r(Bigint::montgomeryRFromRE(re)),
-		one_mont(r.modUnsignedNotpowerof2(n))
 	{
-		Bigint::modMulInv2Coprimes(n, r, n_mod_mul_inv, r_mod_mul_inv);
+		if (MontgomeryContext::isSupportedModulus(n))
+		{
+			ctx = MontgomeryContext(n);
+		}
 	}
 
 	Bigint RsaKeyMontgomeryData::modPow(const Bigint& n, const Bigint& e, const Bigint& x) const SOUP_EXCAL
 	{
-		return x.modPowMontgomery(e, re, r, n, r_mod_mul_inv, n_mod_mul_inv, one_mont);
+		if (ctx.getNumLimbs() != 0)
+		{
+			return ctx.modPow(x, e);
+		}
+		return x.modPow(e, n);
 	}
 
 	// PublicKey
@@ -135,7 +139,7 @@ NAMESPACE_SOUP
 
 	Bigint RsaPublicKey::modPow(const Bigint& x) const SOUP_EXCAL
 	{
-		return x.modPowBasic(e, n);
+		return x.modPow(e, n);
 	}
 
 	// LonglivedPublicKey
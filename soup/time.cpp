@@ -1,5 +1,7 @@
 #include "time.hpp"
 
+#include <cstring> // strcmp
+
 #include "base.hpp"
 #include "string.hpp"
 
@@ -105,6 +107,110 @@ NAMESPACE_SOUP
 		return dt;
 	}
 
+	std::optional<Datetime> Datetime::fromRfc2822(const char* str) noexcept
+	{
+		Datetime dt{};
+		if (string::isLetter(*str))
+		{
+			// Day of week is redundant, we only skip it.
+			do
+			{
+				++str;
+			} while (string::isLetter(*str));
+			if (*str != ',')
+			{
+				return std::nullopt;
+			}
+			++str;
+		}
+		while (*str == ' ')
+		{
+			++str;
+		}
+		if (!string::isNumberChar(*str))
+		{
+			return std::nullopt;
+		}
+		for (; string::isNumberChar(*str); ++str)
+		{
+			dt.day *= 10;
+			dt.day += ((*str) - '0');
+		}
+		if (*str != ' ')
+		{
+			return std::nullopt;
+		}
+		++str;
+		for (int i = 0; i != 12; ++i)
+		{
+			if (str[0] == months[i * 3]
+				&& str[1] == months[i * 3 + 1]
+				&& str[2] == months[i * 3 + 2]
+				)
+			{
+				dt.month = i + 1;
+				break;
+			}
+		}
+		if (dt.month == 0
+			|| str[3] != ' '
+			)
+		{
+			return std::nullopt;
+		}
+		str += 4;
+		if (!string::isNumberChar(*str))
+		{
+			return std::nullopt;
+		}
+		for (; string::isNumberChar(*str); ++str)
+		{
+			dt.year *= 10;
+			dt.year += ((*str) - '0');
+		}
+		if (*str != ' ')
+		{
+			return std::nullopt;
+		}
+		++str;
+		for (int* field : { &dt.hour, &dt.minute, &dt.second })
+		{
+			if (field != &dt.hour)
+			{
+				if (*str != ':')
+				{
+					return std::nullopt;
+				}
+				++str;
+			}
+			if (!string::isNumberChar(*str))
+			{
+				return std::nullopt;
+			}
+			for (; string::isNumberChar(*str); ++str)
+			{
+				*field *= 10;
+				*field += ((*str) - '0');
+			}
+		}
+		if (strcmp(str, " GMT") != 0
+			&& strcmp(str, " +0000") != 0
+			)
+		{
+			return std::nullopt;
+		}
+		if (dt.day < 1 || dt.day > 31
+			|| dt.hour > 23
+			|| dt.minute > 59
+			|| dt.second > 60
+			)
+		{
+			return std::nullopt;
+		}
+		dt.setWdayFromDate();
+		return dt;
+	}
+
 	std::time_t Datetime::toTimestamp() const
 	{
 		return time::toUnix(year, month, day, hour, minute, second);
@@ -23,6 +23,7 @@ NAMESPACE_SOUP
 
 		[[nodiscard]] static Datetime fromTm(const struct tm& t) noexcept;
 		[[nodiscard]] static std::optional<Datetime> fromIso8601(const char* str) noexcept;
+		[[nodiscard]] static std::optional<Datetime> fromRfc2822(const char* str) noexcept; // also accepts the HTTP-date format defined in RFC 9110 (ex: "Sun, 06 Nov 1994 08:49:37 GMT")
 
 		[[nodiscard]] std::time_t toTimestamp() const;
 		[[nodiscard]] std::string toString() const; // example: "00:00:00, 1 Jan"
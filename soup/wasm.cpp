@@ -5,7 +5,9 @@
 #include "alloc.hpp"
 #include "bitutil.hpp"
 #include "MemoryRefReader.hpp"
+#include "Optional.hpp"
 #include "Reader.hpp"
+#include "WasmOp.hpp"
 
 #define DEBUG_LOAD false
 #define DEBUG_VM false
@@ -15,17 +17,134 @@
 #include "string.hpp"
 #endif
 
+// Computed goto where the compiler supports it, so each handler has its own indirect branch.
+#if defined(__GNUC__) || defined(__clang__)
+	#define THREADED_DISPATCH true
+#else
+	#define THREADED_DISPATCH false
+#endif
+
+// Out-of-bounds accesses to a 32-bit memory hit unmapped pages, and the resulting signal is turned into a trap.
+#if SOUP_POSIX && SOUP_BITS == 64 && !SOUP_WASM
+	#define WASM_GUARD_PAGES true
+	#include <setjmp.h>
+	#include <signal.h>
+#else
+	#define WASM_GUARD_PAGES false
+#endif
+
 // Good resources:
 // - https://webassembly.github.io/wabt/demo/wat2wasm/
 // - https://github.com/sunfishcode/wasm-reference-manual/blob/master/WebAssembly.md
 
 NAMESPACE_SOUP
 {
+	// A 32-bit memory instruction can address up to 4 GiB + a 4 GiB offset + 8 bytes.
+	[[maybe_unused]] static constexpr uint64_t wasm_memory32_reservation = 0x2'0000'0000 + 0x10'000;
+
+#if WASM_GUARD_PAGES
+	// Innermost WasmVm run on this thread whose memory faults should become traps.
+	struct WasmTrapScope;
+	static thread_local WasmTrapScope* wasm_trap_scope = nullptr;
+
+	struct WasmTrapScope
+	{
+		sigjmp_buf buf;
+		const WasmScript& script;
+		WasmTrapScope* const prev;
+
+		WasmTrapScope(const WasmScript& script) noexcept
+			: script(script), prev(wasm_trap_scope)
+		{
+			wasm_trap_scope = this;
+		}
+
+		~WasmTrapScope() noexcept
+		{
+			wasm_trap_scope = prev;
+		}
+	};
+
+	// Native code, e.g. imported functions, can't be unwound by a trap, so faults there are left alone.
+	struct WasmTrapScopeSuspension
+	{
+		WasmTrapScope* const saved;
+
+		WasmTrapScopeSuspension() noexcept
+			: saved(wasm_trap_scope)
+		{
+			wasm_trap_scope = nullptr;
+		}
+
+		~WasmTrapScopeSuspension() noexcept
+		{
+			wasm_trap_scope = saved;
+		}
+	};
+
+	static struct sigaction wasm_prev_sigsegv;
+	static struct sigaction wasm_prev_sigbus;
+
+	static void wasmTrapHandler(int signum, siginfo_t* si, void* uctx)
+	{
+		if (WasmTrapScope* scope = wasm_trap_scope)
+		{
+			const auto base = reinterpret_cast<uintptr_t>(scope->script.memory);
+			if (scope->script.memory_guarded
+				&& reinterpret_cast<uintptr_t>(si->si_addr) - base < wasm_memory32_reservation
+				)
+			{
+				siglongjmp(scope->buf, 1);
+			}
+		}
+		const struct sigaction& prev = (signum == SIGSEGV ? wasm_prev_sigsegv : wasm_prev_sigbus);
+		if (prev.sa_flags & SA_SIGINFO)
+		{
+			prev.sa_sigaction(signum, si, uctx);
+		}
+		else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN)
+		{
+			prev.sa_handler(signum);
+		}
+		else
+		{
+			// The faulting instruction will run again and now get the default treatment.
+			sigaction(signum, &prev, nullptr);
+		}
+	}
+
+	static void installWasmTrapHandler() noexcept
+	{
+		[[maybe_unused]] static const bool installed = []
+		{
+			struct sigaction sa;
+			sa.sa_sigaction = &wasmTrapHandler;
+			sa.sa_flags = SA_SIGINFO | SA_NODEFER; // no need to restore the signal mask when jumping out
+			sigemptyset(&sa.sa_mask);
+			sigaction(SIGSEGV, &sa, &wasm_prev_sigsegv);
+			sigaction(SIGBUS, &sa, &wasm_prev_sigbus);
+			return true;
+		}();
+	}
+
+	template <typename F>
+	[[nodiscard]] static bool runWithTrapScope(const WasmScript& script, F&& f) SOUP_EXCAL
+	{
+		// Only generated code and WasmVm::runCompiled can be between here and the fault, and neither has anything to destruct.
+		WasmTrapScope scope(script);
+		if (sigsetjmp(scope.buf, 0) != 0)
+		{
+			return false;
+		}
+		return f();
+	}
+#endif
+
 	// WasmScript
 
 	WasmScript::~WasmScript() noexcept
 	{
-		if (memory != nullptr)
+		if (memory != nullptr && !memory_region)
 		{
 			soup::free(memory);
 		}
@@ -125,8 +244,8 @@ NAMESPACE_SOUP
 						uint8_t kind; r.u8(kind);
 						if (kind == 0) // function
 						{
-							size_t type_index; r.oml(type_index);
-							function_imports.emplace_back(FunctionImport{ std::move(module_name), std::move(field_name), nullptr });
+							uint32_t type_index; r.oml(type_index);
+							function_imports.emplace_back(FunctionImport{ std::move(module_name), std::move(field_name), nullptr, type_index });
 						}
 					}
 				}
@@ -159,21 +278,53 @@ NAMESPACE_SOUP
 					}
 					uint8_t flags; r.u8(flags);
 					size_t pages; r.oml(pages);
-					if (flags & 1)
-					{
-						size_t max_pages; r.oml(max_pages);
-					}
 					if (flags & 4)
 					{
 						memory64 = true;
 					}
+					memory_max_pages = (memory64 ? SIZE_MAX / 0x10'000 : 0x10'000);
+					if (flags & 1)
+					{
+						size_t max_pages; r.oml(max_pages);
+						if (max_pages < memory_max_pages)
+						{
+							memory_max_pages = max_pages;
+						}
+					}
 					if (pages == 0)
 					{
 						++pages;
 					}
-					memory = (uint8_t*)soup::malloc(pages * 0x10'000);
+					if (memory_max_pages < pages)
+					{
+						memory_max_pages = pages;
+					}
 					memory_size = pages * 0x10'000;
-					memset(memory, 0, memory_size);
+#if SOUP_BITS == 64
+					if (!memory64 && memory_max_pages <= 0x10'000)
+					{
+						memory_region = soup::make_unique<AllocRaiiVirtual>(wasm_memory32_reservation, 0);
+						if (memory_region->addr != nullptr
+							&& memGuard::commit(memory_region->addr, memory_size, memGuard::ACC_READ | memGuard::ACC_WRITE)
+							)
+						{
+							memory = reinterpret_cast<uint8_t*>(memory_region->addr);
+							memory_guarded = WASM_GUARD_PAGES;
+#if WASM_GUARD_PAGES
+							installWasmTrapHandler();
+#endif
+						}
+						else
+						{
+							memory_region.reset();
+						}
+					}
+#endif
+					if (memory == nullptr)
+					{
+						memory = (uint8_t*)soup::malloc(memory_size);
+						memset(memory, 0, memory_size);
+					}
 #if DEBUG_LOAD
 					std::cout << "Memory consists of " << pages << " pages, totalling " << memory_size << " bytes\n";
 #endif
@@ -328,7 +479,7 @@ NAMESPACE_SOUP
 							return false;
 						}
 						size_t size; r.oml(size);
-						SOUP_IF_UNLIKELY (base + size >= memory_size)
+						SOUP_IF_UNLIKELY (base + size > memory_size)
 						{
 							return false;
 						}
@@ -342,6 +493,7 @@ NAMESPACE_SOUP
 				r.oml(section_size);
 			}
 		}
+		compileFunctions();
 		return true;
 	}
 
@@ -384,7 +536,7 @@ NAMESPACE_SOUP
 
 	bool WasmScript::setMemory(size_t ptr, const void* src, size_t len) noexcept
 	{
-		SOUP_IF_UNLIKELY (ptr + len >= memory_size)
+		SOUP_IF_UNLIKELY (ptr + len > memory_size)
 		{
 			return false;
 		}
@@ -400,6 +552,36 @@ NAMESPACE_SOUP
 			;
 	}
 
+	size_t WasmScript::growMemory(size_t delta_pages) noexcept
+	{
+		const size_t old_pages = memory_size / 0x10'000;
+		SOUP_IF_UNLIKELY (memory == nullptr || delta_pages > memory_max_pages - old_pages)
+		{
+			return -1;
+		}
+		const size_t delta = delta_pages * 0x10'000;
+		if (memory_region)
+		{
+			// Committed pages are zeroed by the OS.
+			SOUP_IF_UNLIKELY (delta != 0 && !memGuard::commit(memory + memory_size, delta, memGuard::ACC_READ | memGuard::ACC_WRITE))
+			{
+				return -1;
+			}
+		}
+		else
+		{
+			auto nmem = (uint8_t*)::realloc(memory, memory_size + delta);
+			if (nmem == nullptr)
+			{
+				return -1;
+			}
+			memset(&nmem[memory_size], 0, delta);
+			memory = nmem;
+		}
+		memory_size += delta;
+		return old_pages;
+	}
+
 	void WasmScript::linkWasiPreview1() noexcept
 	{
 		// Resources:
@@ -487,6 +669,13 @@ NAMESPACE_SOUP
 		}
 	}
 
+	bool WasmScript::enableJit() SOUP_EXCAL
+	{
+		SOUP_RETHROW_FALSE(WasmJit::isSupported());
+		jit = soup::make_unique<WasmJit>(*this);
+		return true;
+	}
+
 	size_t WasmScript::readUPTR(Reader& r) const noexcept
 	{
 		if (memory64)
@@ -500,16 +689,497 @@ NAMESPACE_SOUP
 		return static_cast<size_t>(ptr);
 	}
 
+	void WasmScript::compileFunctions() SOUP_EXCAL
+	{
+		jit.reset();
+		compiled.clear();
+		compiled.resize(code.size());
+		for (size_t i = 0; i != code.size() && i != functions.size(); ++i)
+		{
+			if (!compileFunction(compiled[i], code[i], functions[i]))
+			{
+#if DEBUG_LOAD
+				std::cout << "Function " << i << " could not be compiled, it will be interpreted\n";
+#endif
+				compiled[i] = CompiledFunction{};
+			}
+		}
+	}
+
+	bool WasmScript::compileFunction(CompiledFunction& fn, const std::string& body, uint32_t type_index) SOUP_EXCAL
+	{
+		constexpr uint32_t max_locals = 0x10'000;
+		constexpr uint32_t table_fixup = 0x80000000; // fixup refers to br_tables instead of insns
+
+		struct Block
+		{
+			uint8_t opcode; // 0x02 = block, 0x03 = loop, 0x04 = if, 0x05 = else
+			uint32_t height;
+			uint32_t arity;
+			uint32_t start;
+			uint32_t if_insn;
+			bool unreachable;
+			std::vector<uint32_t> fixups;
+		};
+
+		SOUP_IF_UNLIKELY (type_index >= types.size())
+		{
+			return false;
+		}
+		fn.num_params = types[type_index].num_parameters;
+		fn.num_results = types[type_index].num_results;
+
+		MemoryRefReader r(body);
+		uint32_t num_locals = fn.num_params;
+		uint32_t local_decl_count;
+		SOUP_RETHROW_FALSE(r.oml(local_decl_count));
+		while (local_decl_count--)
+		{
+			uint32_t type_count;
+			uint8_t type;
+			SOUP_RETHROW_FALSE(r.oml(type_count) && r.u8(type));
+			SOUP_IF_UNLIKELY (type_count > max_locals - num_locals)
+			{
+				return false;
+			}
+			num_locals += type_count;
+		}
+		SOUP_IF_UNLIKELY (num_locals > max_locals)
+		{
+			return false;
+		}
+		fn.num_locals = num_locals;
+
+		std::vector<Block> blocks{};
+		blocks.emplace_back(Block{ 0x02, num_locals, fn.num_results, 0, 0, false, {} });
+		uint32_t height = num_locals;
+		fn.max_height = height;
+
+		auto emit = [&fn](uint16_t op, uint32_t a = 0, uint64_t b = 0) -> uint32_t
+		{
+			fn.insns.emplace_back(Insn{ op, 0, a, b });
+			return static_cast<uint32_t>(fn.insns.size() - 1);
+		};
+		auto pop = [&](uint32_t n) -> bool
+		{
+			if (height - blocks.back().height < n)
+			{
+				// After an unconditional branch the stack is polymorphic, so anything may be popped.
+				SOUP_IF_UNLIKELY (!blocks.back().unreachable)
+				{
+					return false;
+				}
+				height = blocks.back().height;
+				return true;
+			}
+			height -= n;
+			return true;
+		};
+		auto push = [&](uint32_t n)
+		{
+			height += n;
+			if (height > fn.max_height)
+			{
+				fn.max_height = height;
+			}
+		};
+		auto setUnreachable = [&]
+		{
+			blocks.back().unreachable = true;
+			height = blocks.back().height;
+		};
+		auto getBranchTarget = [&](uint32_t depth, uint32_t fixup) -> Optional<BranchTarget>
+		{
+			if (depth >= blocks.size())
+			{
+				return std::nullopt;
+			}
+			Block& target = blocks[blocks.size() - 1 - depth];
+			BranchTarget bt{ target.start, target.height, target.opcode == 0x03 ? 0 : target.arity };
+			SOUP_IF_UNLIKELY (height - blocks.back().height < bt.arity && !blocks.back().unreachable)
+			{
+				return std::nullopt;
+			}
+			if (target.opcode != 0x03)
+			{
+				target.fixups.emplace_back(fixup);
+			}
+			return bt;
+		};
+		auto emitBranch = [&](uint16_t plain_op, uint16_t adjust_op, uint32_t depth) -> bool
+		{
+			const uint32_t insn = static_cast<uint32_t>(fn.insns.size());
+			auto bt = getBranchTarget(depth, insn);
+			if (!bt.has_value())
+			{
+				return false;
+			}
+			const bool adjust = (height != bt->height + bt->arity);
+			emit(adjust ? adjust_op : plain_op, bt->pc, bt->height);
+			fn.insns.back().arity = static_cast<uint16_t>(bt->arity);
+			return true;
+		};
+		auto readBlockArity = [&r](uint32_t& arity) -> bool
+		{
+			uint8_t result_type;
+			SOUP_RETHROW_FALSE(r.u8(result_type));
+			switch (result_type)
+			{
+			case 0x40: // void
+				arity = 0;
+				return true;
+
+			case 0x7f: // i32
+			case 0x7e: // i64
+			case 0x7d: // f32
+			case 0x7c: // f64
+				arity = 1;
+				return true;
+			}
+			return false;
+		};
+
+		uint8_t op;
+		while (r.u8(op))
+		{
+			switch (op)
+			{
+			default:
+#if DEBUG_LOAD
+				std::cout << "Can't compile opcode " << string::hex(op) << "\n";
+#endif
+				return false;
+
+			case 0x00: // unreachable
+				emit(WASM_OP_UNREACHABLE);
+				setUnreachable();
+				break;
+
+			case 0x01: // nop
+				break;
+
+			case 0x02: // block
+			case 0x03: // loop
+				{
+					uint32_t arity;
+					SOUP_RETHROW_FALSE(readBlockArity(arity));
+					blocks.emplace_back(Block{ op, height, arity, static_cast<uint32_t>(fn.insns.size()), 0, false, {} });
+				}
+				break;
+
+			case 0x04: // if
+				{
+					uint32_t arity;
+					SOUP_RETHROW_FALSE(readBlockArity(arity) && pop(1));
+					const uint32_t if_insn = emit(WASM_OP_IF);
+					blocks.emplace_back(Block{ op, height, arity, 0, if_insn, false, {} });
+				}
+				break;
+
+			case 0x05: // else
+				{
+					Block& block = blocks.back();
+					SOUP_IF_UNLIKELY (block.opcode != 0x04
+						|| (!block.unreachable && height != block.height + block.arity)
+						)
+					{
+						return false;
+					}
+					block.fixups.emplace_back(emit(WASM_OP_JMP));
+					fn.insns[block.if_insn].a = static_cast<uint32_t>(fn.insns.size());
+					block.opcode = 0x05;
+					block.unreachable = false;
+					height = block.height;
+				}
+				break;
+
+			case 0x0b: // end
+				{
+					Block& block = blocks.back();
+					SOUP_IF_UNLIKELY ((!block.unreachable && height != block.height + block.arity)
+						|| (block.opcode == 0x04 && block.arity != 0)
+						)
+					{
+						return false;
+					}
+					const auto pc = static_cast<uint32_t>(fn.insns.size());
+					if (block.opcode == 0x04)
+					{
+						fn.insns[block.if_insn].a = pc;
+					}
+					for (const auto& fixup : block.fixups)
+					{
+						if (fixup & table_fixup)
+						{
+							fn.br_tables[fixup & ~table_fixup].pc = pc;
+						}
+						else
+						{
+							fn.insns[fixup].a = pc;
+						}
+					}
+					height = block.height + block.arity;
+					blocks.pop_back();
+					if (blocks.empty())
+					{
+						emit(WASM_OP_RETURN);
+						return !r.hasMore();
+					}
+				}
+				break;
+
+			case 0x0c: // br
+				{
+					uint32_t depth;
+					SOUP_RETHROW_FALSE(r.oml(depth) && emitBranch(WASM_OP_JMP, WASM_OP_BR, depth));
+					setUnreachable();
+				}
+				break;
+
+			case 0x0d: // br_if
+				{
+					uint32_t depth;
+					SOUP_RETHROW_FALSE(r.oml(depth) && pop(1) && emitBranch(WASM_OP_BR_IF, WASM_OP_BR_IF_ADJUST, depth));
+				}
+				break;
+
+			case 0x0e: // br_table
+				{
+					uint32_t num_branches;
+					SOUP_RETHROW_FALSE(r.oml(num_branches) && pop(1));
+					SOUP_IF_UNLIKELY (num_branches > body.size())
+					{
+						return false;
+					}
+					const auto first = static_cast<uint32_t>(fn.br_tables.size());
+					for (uint32_t i = 0; i <= num_branches; ++i)
+					{
+						uint32_t depth;
+						SOUP_RETHROW_FALSE(r.oml(depth));
+						auto bt = getBranchTarget(depth, table_fixup | static_cast<uint32_t>(fn.br_tables.size()));
+						SOUP_RETHROW_FALSE(bt.has_value());
+						fn.br_tables.emplace_back(*bt);
+					}
+					emit(WASM_OP_BR_TABLE, first, num_branches);
+					setUnreachable();
+				}
+				break;
+
+			case 0x0f: // return
+				SOUP_RETHROW_FALSE(blocks.back().unreachable || height - num_locals >= fn.num_results);
+				emit(WASM_OP_RETURN);
+				setUnreachable();
+				break;
+
+			case 0x10: // call
+				{
+					uint32_t function_index;
+					SOUP_RETHROW_FALSE(r.oml(function_index));
+					uint32_t callee_type_index;
+					if (function_index < function_imports.size())
+					{
+						callee_type_index = function_imports[function_index].type_index;
+						emit(WASM_OP_CALL_IMPORT, function_index);
+					}
+					else
+					{
+						function_index -= static_cast<uint32_t>(function_imports.size());
+						SOUP_IF_UNLIKELY (function_index >= functions.size() || function_index >= code.size())
+						{
+							return false;
+						}
+						callee_type_index = functions[function_index];
+						emit(WASM_OP_CALL, function_index);
+					}
+					SOUP_IF_UNLIKELY (callee_type_index >= types.size())
+					{
+						return false;
+					}
+					SOUP_RETHROW_FALSE(pop(types[callee_type_index].num_parameters));
+					push(types[callee_type_index].num_results);
+				}
+				break;
+
+			case 0x11: // call_indirect
+				{
+					uint32_t callee_type_index, table_index;
+					SOUP_RETHROW_FALSE(r.oml(callee_type_index) && r.oml(table_index));
+					SOUP_IF_UNLIKELY (table_index != 0 || callee_type_index >= types.size())
+					{
+						return false;
+					}
+					SOUP_RETHROW_FALSE(pop(1) && pop(types[callee_type_index].num_parameters));
+					push(types[callee_type_index].num_results);
+					emit(WASM_OP_CALL_INDIRECT, callee_type_index);
+				}
+				break;
+
+			case 0x1a: // drop
+				SOUP_RETHROW_FALSE(pop(1));
+				emit(WASM_OP_DROP);
+				break;
+
+			case 0x1b: // select
+				SOUP_RETHROW_FALSE(pop(3));
+				push(1);
+				emit(WASM_OP_SELECT);
+				break;
+
+			case 0x20: // local.get
+			case 0x21: // local.set
+			case 0x22: // local.tee
+				{
+					uint32_t local_index;
+					SOUP_RETHROW_FALSE(r.oml(local_index));
+					SOUP_IF_UNLIKELY (local_index >= num_locals)
+					{
+						return false;
+					}
+					if (op == 0x20)
+					{
+						push(1);
+						emit(WASM_OP_LOCAL_GET, local_index);
+					}
+					else
+					{
+						SOUP_RETHROW_FALSE(pop(1));
+						if (op == 0x22)
+						{
+							push(1);
+						}
+						emit(op == 0x21 ? WASM_OP_LOCAL_SET : WASM_OP_LOCAL_TEE, local_index);
+					}
+				}
+				break;
+
+			case 0x23: // global.get
+			case 0x24: // global.set
+				{
+					uint32_t global_index;
+					SOUP_RETHROW_FALSE(r.oml(global_index));
+					SOUP_IF_UNLIKELY (global_index >= globals.size())
+					{
+						return false;
+					}
+					if (op == 0x23)
+					{
+						push(1);
+						emit(WASM_OP_GLOBAL_GET, global_index);
+					}
+					else
+					{
+						SOUP_RETHROW_FALSE(pop(1));
+						emit(WASM_OP_GLOBAL_SET, global_index);
+					}
+				}
+				break;
+
+#define WASM_COMPILE_LOAD(name, opcode) case opcode:
+			WASM_LOAD_OPS(WASM_COMPILE_LOAD)
+				{
+					uint32_t align;
+					SOUP_RETHROW_FALSE(r.oml(align) && pop(1));
+					push(1);
+					emit(op - 0x28 + WASM_OP_I32_LOAD, 0, readUPTR(r));
+				}
+				break;
+#undef WASM_COMPILE_LOAD
+
+#define WASM_COMPILE_STORE(name, opcode) case opcode:
+			WASM_STORE_OPS(WASM_COMPILE_STORE)
+				{
+					uint32_t align;
+					SOUP_RETHROW_FALSE(r.oml(align) && pop(2));
+					emit(op - 0x36 + WASM_OP_I32_STORE, 0, readUPTR(r));
+				}
+				break;
+#undef WASM_COMPILE_STORE
+
+			case 0x3f: // memory.size
+				r.skip(1); // reserved
+				push(1);
+				emit(WASM_OP_MEMORY_SIZE);
+				break;
+
+			case 0x40: // memory.grow
+				r.skip(1); // reserved
+				SOUP_RETHROW_FALSE(pop(1));
+				push(1);
+				emit(WASM_OP_MEMORY_GROW);
+				break;
+
+			case 0x41: // i32.const
+			case 0x42: // i64.const
+			case 0x43: // f32.const
+			case 0x44: // f64.const
+				{
+					WasmValue value;
+					switch (op)
+					{
+					case 0x41: SOUP_RETHROW_FALSE(r.soml(value.i32)); break;
+					case 0x42: SOUP_RETHROW_FALSE(r.soml(value.i64)); break;
+					case 0x43: SOUP_RETHROW_FALSE(r.f32(value.f32)); break;
+					case 0x44: SOUP_RETHROW_FALSE(r.f64(value.f64)); break;
+					}
+					uint64_t bits;
+					memcpy(&bits, &value, sizeof(bits));
+					push(1);
+					emit(WASM_OP_CONST, 0, bits);
+				}
+				break;
+
+#define WASM_COMPILE_UNARY(name, opcode) case opcode: SOUP_RETHROW_FALSE(pop(1)); push(1); emit(WASM_OP_##name); break;
+			WASM_UNARY_OPS(WASM_COMPILE_UNARY)
+#undef WASM_COMPILE_UNARY
+
+#define WASM_COMPILE_BINARY(name, opcode) case opcode: SOUP_RETHROW_FALSE(pop(2)); push(1); emit(WASM_OP_##name); break;
+			WASM_BINARY_OPS(WASM_COMPILE_BINARY)
+#undef WASM_COMPILE_BINARY
+			}
+		}
+		return false; // missing 'end'
+	}
+
 	// WasmVm
 
 	bool WasmVm::run(const std::string& data) SOUP_EXCAL
 	{
+		if (!script.code.empty()
+			&& std::less_equal<const std::string*>()(script.code.data(), &data)
+			&& std::less<const std::string*>()(&data, script.code.data() + script.code.size())
+			)
+		{
+			const auto function_index = static_cast<uint32_t>(&data - script.code.data());
+			if (function_index < script.compiled.size()
+				&& !script.compiled[function_index].insns.empty()
+				&& locals.size() == script.compiled[function_index].num_params
+				)
+			{
+				auto f = [this, function_index]
+				{
+					return (script.jit && script.jit->isCompiled(function_index))
+						? runJit(function_index)
+						: runCompiled(function_index)
+						;
+				};
+#if WASM_GUARD_PAGES
+				if (script.memory_guarded)
+				{
+					return runWithTrapScope(script, f);
+				}
+#endif
+				return f();
+			}
+		}
 		MemoryRefReader r(data);
 		return run(r);
 	}
 
 	bool WasmVm::run(Reader& r) SOUP_EXCAL
 	{
+#if WASM_GUARD_PAGES
+		WasmTrapScopeSuspension suspension;
+#endif
 		size_t local_decl_count;
 		r.oml(local_decl_count);
 		while (local_decl_count--)
@@ -1200,19 +1870,7 @@ NAMESPACE_SOUP
 						delta = static_cast<uint32_t>(stack.top().i32);
 					}
 					stack.pop();
-					delta *= 0x10'000;
-					auto nmem = (uint8_t*)::realloc(script.memory, script.memory_size + delta);
-					if (nmem == nullptr)
-					{
-						pushIPTR(-1);
-					}
-					else
-					{
-						memset(&nmem[script.memory_size], 0, delta);
-						pushIPTR(script.memory_size / 0x10'000);
-						script.memory = nmem;
-						script.memory_size += delta;
-					}
+					pushIPTR(script.growMemory(delta));
 				}
 				break;
 
@@ -2092,6 +2750,436 @@ NAMESPACE_SOUP
 		return true;
 	}
 
+	bool WasmVm::runCompiled(uint32_t function_index) SOUP_EXCAL
+	{
+		constexpr size_t max_stack_size = 0x100'000; // values
+		constexpr size_t max_call_depth = 0x10'000;
+
+		const bool guarded = script.memory_guarded;
+		const WasmScript::CompiledFunction* fn = &script.compiled[function_index];
+		if (value_stack.size() < fn->max_height)
+		{
+			value_stack.resize(fn->max_height < 0x400 ? 0x400 : fn->max_height);
+		}
+		call_stack.clear();
+
+		WasmValue* fp = value_stack.data();
+		for (uint32_t i = 0; i != fn->num_locals; ++i)
+		{
+			fp[i] = (i < locals.size() ? locals[i] : WasmValue());
+		}
+		WasmValue* sp = fp + fn->num_locals;
+		const WasmScript::Insn* ip = fn->insns.data();
+		uint32_t callee_index;
+
+#if THREADED_DISPATCH
+		static const void* const dispatch_table[] = {
+#define WASM_OP_LABEL(name, ...) &&op_##name,
+			WASM_ALL_OPS(WASM_OP_LABEL)
+#undef WASM_OP_LABEL
+		};
+#define DISPATCH() goto *dispatch_table[ip->op]
+#define CASE(name) op_##name:
+		DISPATCH();
+		{
+#else
+#define DISPATCH() continue
+#define CASE(name) case WASM_OP_##name:
+		while (true) switch (ip->op)
+		{
+		default:
+			SOUP_UNREACHABLE;
+#endif
+#define NEXT() { ++ip; DISPATCH(); }
+#define JUMP(pc) { ip = fn->insns.data() + (pc); DISPATCH(); }
+#define BRANCH_ADJUST(height, arity) { WasmValue* const dst = fp + (height); const WasmValue* const src = sp - (arity); for (uint32_t i = 0; i != (arity); ++i) { dst[i] = src[i]; } sp = dst + (arity); }
+
+		CASE(UNREACHABLE)
+#if DEBUG_VM
+			std::cout << "unreachable\n";
+#endif
+			return false;
+
+		CASE(JMP)
+			JUMP(ip->a);
+
+		CASE(BR)
+			BRANCH_ADJUST(ip->b, ip->arity);
+			JUMP(ip->a);
+
+		CASE(BR_IF)
+			if ((--sp)->i32)
+			{
+				JUMP(ip->a);
+			}
+			NEXT();
+
+		CASE(BR_IF_ADJUST)
+			if ((--sp)->i32)
+			{
+				BRANCH_ADJUST(ip->b, ip->arity);
+				JUMP(ip->a);
+			}
+			NEXT();
+
+		CASE(BR_TABLE)
+			{
+				uint64_t index = static_cast<uint32_t>((--sp)->i32);
+				if (index > ip->b)
+				{
+					index = ip->b;
+				}
+				const WasmScript::BranchTarget& bt = fn->br_tables[ip->a + index];
+				BRANCH_ADJUST(bt.height, bt.arity);
+				JUMP(bt.pc);
+			}
+
+		CASE(IF)
+			if ((--sp)->i32 == 0)
+			{
+				JUMP(ip->a);
+			}
+			NEXT();
+
+		CASE(RETURN)
+			{
+				const uint32_t n = fn->num_results;
+				sp -= n;
+				for (uint32_t i = 0; i != n; ++i)
+				{
+					fp[i] = sp[i];
+				}
+				sp = fp + n;
+				if (call_stack.empty())
+				{
+					for (uint32_t i = 0; i != n; ++i)
+					{
+						stack.push(fp[i]);
+					}
+					return true;
+				}
+				const CallFrame& frame = call_stack.back();
+				fn = frame.fn;
+				ip = frame.ret;
+				fp = value_stack.data() + frame.fp;
+				call_stack.pop_back();
+				DISPATCH();
+			}
+
+		CASE(CALL)
+			callee_index = ip->a;
+		do_call:
+			{
+				const WasmScript::CompiledFunction* callee = &script.compiled[callee_index];
+				SOUP_IF_UNLIKELY (callee->insns.empty())
+				{
+					SOUP_RETHROW_FALSE(callViaStack(sp, script.functions[callee_index], callee_index + static_cast<uint32_t>(script.function_imports.size())));
+					NEXT();
+				}
+				SOUP_IF_UNLIKELY (call_stack.size() == max_call_depth)
+				{
+#if DEBUG_VM
+					std::cout << "call: stack overflow\n";
+#endif
+					return false;
+				}
+				call_stack.emplace_back(CallFrame{ fn, ip + 1, static_cast<size_t>(fp - value_stack.data()) });
+				size_t new_fp = (sp - value_stack.data()) - callee->num_params;
+				if (new_fp + callee->max_height > value_stack.size())
+				{
+					SOUP_IF_UNLIKELY (new_fp + callee->max_height > max_stack_size)
+					{
+#if DEBUG_VM
+						std::cout << "call: stack overflow\n";
+#endif
+						return false;
+					}
+					value_stack.resize(std::max(new_fp + callee->max_height, value_stack.size() * 2));
+				}
+				fp = value_stack.data() + new_fp;
+				for (uint32_t i = callee->num_params; i != callee->num_locals; ++i)
+				{
+					fp[i] = WasmValue();
+				}
+				sp = fp + callee->num_locals;
+				fn = callee;
+				ip = fn->insns.data();
+				DISPATCH();
+			}
+
+		CASE(CALL_IMPORT)
+			SOUP_IF_UNLIKELY (script.function_imports[ip->a].ptr == nullptr)
+			{
+#if DEBUG_VM
+				std::cout << "call: function is not imported\n";
+#endif
+				return false;
+			}
+			SOUP_RETHROW_FALSE(callViaStack(sp, script.function_imports[ip->a].type_index, ip->a));
+			NEXT();
+
+		CASE(CALL_INDIRECT)
+			{
+				const auto element_index = static_cast<uint32_t>((--sp)->i32);
+				SOUP_IF_UNLIKELY (element_index >= script.elements.size())
+				{
+#if DEBUG_VM
+					std::cout << "call: element is out-of-bounds\n";
+#endif
+					return false;
+				}
+				callee_index = script.elements[element_index];
+				SOUP_IF_UNLIKELY (callee_index < script.function_imports.size())
+				{
+#if DEBUG_VM
+					std::cout << "indirect call to imported function\n";
+#endif
+					return false;
+				}
+				callee_index -= static_cast<uint32_t>(script.function_imports.size());
+				SOUP_IF_UNLIKELY (callee_index >= script.functions.size()
+					|| callee_index >= script.compiled.size()
+					|| script.functions[callee_index] != ip->a
+					)
+				{
+#if DEBUG_VM
+					std::cout << "call: function type mismatch\n";
+#endif
+					return false;
+				}
+				goto do_call;
+			}
+
+		CASE(DROP)
+			--sp;
+			NEXT();
+
+		CASE(SELECT)
+			sp -= 2;
+			if (sp[1].i32 == 0)
+			{
+				sp[-1] = sp[0];
+			}
+			NEXT();
+
+		CASE(LOCAL_GET)
+			*sp++ = fp[ip->a];
+			NEXT();
+
+		CASE(LOCAL_SET)
+			fp[ip->a] = *--sp;
+			NEXT();
+
+		CASE(LOCAL_TEE)
+			fp[ip->a] = sp[-1];
+			NEXT();
+
+		CASE(GLOBAL_GET)
+			*sp++ = script.globals[ip->a];
+			NEXT();
+
+		CASE(GLOBAL_SET)
+			script.globals[ip->a] = (--sp)->i32;
+			NEXT();
+
+		CASE(CONST)
+			*sp++ = WasmValue(ip->b); // Bits of any type
+			NEXT();
+
+		CASE(MEMORY_SIZE)
+			*sp++ = (script.memory64 ? WasmValue(static_cast<uint64_t>(script.memory_size / 0x10'000)) : WasmValue(static_cast<uint32_t>(script.memory_size / 0x10'000)));
+			NEXT();
+
+		CASE(MEMORY_GROW)
+			{
+				const size_t delta = (script.memory64 ? static_cast<uint64_t>(sp[-1].i64) : static_cast<uint32_t>(sp[-1].i32));
+				const size_t res = script.growMemory(delta);
+				sp[-1] = (script.memory64 ? WasmValue(static_cast<uint64_t>(res)) : WasmValue(static_cast<uint32_t>(res)));
+			}
+			NEXT();
+
+		// With guard pages, the effective address is always within the reservation, and anything beyond memory_size faults.
+#define MEMORY(T, base) T* ptr; if (guarded) { ptr = reinterpret_cast<T*>(script.memory + static_cast<uint32_t>(base.i32) + ip->b); } else { ptr = script.getMemory<T>(base, ip->b); SOUP_IF_UNLIKELY (ptr == nullptr) { return false; } }
+#define LOAD(name, T, R) CASE(name) { MEMORY(T, sp[-1]) T value; memcpy(&value, ptr, sizeof(T)); sp[-1] = WasmValue(static_cast<R>(value)); NEXT(); }
+		LOAD(I32_LOAD, int32_t, int32_t)
+		LOAD(I64_LOAD, int64_t, int64_t)
+		LOAD(F32_LOAD, float, float)
+		LOAD(F64_LOAD, double, double)
+		LOAD(I32_LOAD8_S, int8_t, int32_t)
+		LOAD(I32_LOAD8_U, uint8_t, uint32_t)
+		LOAD(I32_LOAD16_S, int16_t, int32_t)
+		LOAD(I32_LOAD16_U, uint16_t, uint32_t)
+		LOAD(I64_LOAD8_S, int8_t, int64_t)
+		LOAD(I64_LOAD8_U, uint8_t, uint64_t)
+		LOAD(I64_LOAD16_S, int16_t, int64_t)
+		LOAD(I64_LOAD16_U, uint16_t, uint64_t)
+		LOAD(I64_LOAD32_S, int32_t, int64_t)
+		LOAD(I64_LOAD32_U, uint32_t, uint64_t)
+#undef LOAD
+
+#define STORE(name, T, field) CASE(name) { sp -= 2; MEMORY(T, sp[0]) const T value = static_cast<T>(sp[1].field); memcpy(ptr, &value, sizeof(T)); NEXT(); }
+		STORE(I32_STORE, int32_t, i32)
+		STORE(I64_STORE, int64_t, i64)
+		STORE(F32_STORE, float, f32)
+		STORE(F64_STORE, double, f64)
+		STORE(I32_STORE8, int8_t, i32)
+		STORE(I32_STORE16, int16_t, i32)
+#undef STORE
+#undef MEMORY
+
+#define UNARY(name, expr) CASE(name) { const WasmValue a = sp[-1]; sp[-1] = WasmValue(expr); NEXT(); }
+		UNARY(I32_EQZ, a.i32 == 0)
+		UNARY(I64_EQZ, a.i64 == 0)
+		UNARY(I32_POPCNT, static_cast<uint32_t>(bitutil::getNumSetBits(static_cast<uint32_t>(a.i32))))
+		UNARY(I32_WRAP_I64, static_cast<int32_t>(a.i64))
+		UNARY(I64_EXTEND_I32_S, static_cast<int64_t>(a.i32))
+		UNARY(I64_EXTEND_I32_U, static_cast<uint64_t>(static_cast<uint32_t>(a.i32)))
+#undef UNARY
+
+#define BINARY(name, expr) CASE(name) { --sp; const WasmValue a = sp[-1]; const WasmValue b = sp[0]; sp[-1] = WasmValue(expr); NEXT(); }
+#define BINARY_TRAP(name, cond, expr) CASE(name) { --sp; const WasmValue a = sp[-1]; const WasmValue b = sp[0]; SOUP_IF_UNLIKELY (cond) { return false; } sp[-1] = WasmValue(expr); NEXT(); }
+		BINARY(I32_EQ, a.i32 == b.i32)
+		BINARY(I32_NE, a.i32 != b.i32)
+		BINARY(I32_LT_S, a.i32 < b.i32)
+		BINARY(I32_LT_U, static_cast<uint32_t>(a.i32) < static_cast<uint32_t>(b.i32))
+		BINARY(I32_GT_S, a.i32 > b.i32)
+		BINARY(I32_GT_U, static_cast<uint32_t>(a.i32) > static_cast<uint32_t>(b.i32))
+		BINARY(I32_LE_S, a.i32 <= b.i32)
+		BINARY(I32_LE_U, static_cast<uint32_t>(a.i32) <= static_cast<uint32_t>(b.i32))
+		BINARY(I32_GE_S, a.i32 >= b.i32)
+		BINARY(I32_GE_U, static_cast<uint32_t>(a.i32) >= static_cast<uint32_t>(b.i32))
+		BINARY(I64_EQ, a.i64 == b.i64)
+		BINARY(I64_NE, a.i64 != b.i64)
+		BINARY(I64_LT_S, a.i64 < b.i64)
+		BINARY(I64_LT_U, static_cast<uint64_t>(a.i64) < static_cast<uint64_t>(b.i64))
+		BINARY(I64_GT_S, a.i64 > b.i64)
+		BINARY(I64_GT_U, static_cast<uint64_t>(a.i64) > static_cast<uint64_t>(b.i64))
+		BINARY(I64_LE_S, a.i64 <= b.i64)
+		BINARY(I64_LE_U, static_cast<uint64_t>(a.i64) <= static_cast<uint64_t>(b.i64))
+		BINARY(I64_GE_S, a.i64 >= b.i64)
+		BINARY(I64_GE_U, static_cast<uint64_t>(a.i64) >= static_cast<uint64_t>(b.i64))
+		BINARY(F32_EQ, a.f32 == b.f32)
+		BINARY(F32_NE, a.f32 != b.f32)
+		BINARY(F32_LT, a.f32 < b.f32)
+		BINARY(F32_GT, a.f32 > b.f32)
+		BINARY(F32_LE, a.f32 <= b.f32)
+		BINARY(F32_GE, a.f32 >= b.f32)
+		BINARY(F64_EQ, a.f64 == b.f64)
+		BINARY(F64_NE, a.f64 != b.f64)
+		BINARY(F64_LT, a.f64 < b.f64)
+		BINARY(F64_GT, a.f64 > b.f64)
+		BINARY(F64_LE, a.f64 <= b.f64)
+		BINARY(F64_GE, a.f64 >= b.f64)
+		BINARY(I32_ADD, static_cast<uint32_t>(a.i32) + static_cast<uint32_t>(b.i32))
+		BINARY(I32_SUB, static_cast<uint32_t>(a.i32) - static_cast<uint32_t>(b.i32))
+		BINARY(I32_MUL, static_cast<uint32_t>(a.i32) * static_cast<uint32_t>(b.i32))
+		BINARY_TRAP(I32_DIV_S, b.i32 == 0 || (a.i32 == INT32_MIN && b.i32 == -1), a.i32 / b.i32)
+		BINARY_TRAP(I32_DIV_U, b.i32 == 0, static_cast<uint32_t>(a.i32) / static_cast<uint32_t>(b.i32))
+		BINARY_TRAP(I32_REM_S, b.i32 == 0, b.i32 == -1 ? 0 : a.i32 % b.i32)
+		BINARY_TRAP(I32_REM_U, b.i32 == 0, static_cast<uint32_t>(a.i32) % static_cast<uint32_t>(b.i32))
+		BINARY(I32_AND, a.i32 & b.i32)
+		BINARY(I32_OR, a.i32 | b.i32)
+		BINARY(I32_XOR, a.i32 ^ b.i32)
+		BINARY(I32_SHL, static_cast<uint32_t>(a.i32) << (static_cast<uint32_t>(b.i32) % 32))
+		BINARY(I32_SHR_S, a.i32 >> (static_cast<uint32_t>(b.i32) % 32))
+		BINARY(I32_SHR_U, static_cast<uint32_t>(a.i32) >> (static_cast<uint32_t>(b.i32) % 32))
+		BINARY(I64_ADD, static_cast<uint64_t>(a.i64) + static_cast<uint64_t>(b.i64))
+		BINARY(I64_SUB, static_cast<uint64_t>(a.i64) - static_cast<uint64_t>(b.i64))
+		BINARY(I64_MUL, static_cast<uint64_t>(a.i64) * static_cast<uint64_t>(b.i64))
+		BINARY_TRAP(I64_DIV_S, b.i64 == 0 || (a.i64 == INT64_MIN && b.i64 == -1), a.i64 / b.i64)
+		BINARY_TRAP(I64_DIV_U, b.i64 == 0, static_cast<uint64_t>(a.i64) / static_cast<uint64_t>(b.i64))
+		BINARY_TRAP(I64_REM_S, b.i64 == 0, b.i64 == -1 ? 0 : a.i64 % b.i64)
+		BINARY_TRAP(I64_REM_U, b.i64 == 0, static_cast<uint64_t>(a.i64) % static_cast<uint64_t>(b.i64))
+		BINARY(I64_AND, a.i64 & b.i64)
+		BINARY(I64_OR, a.i64 | b.i64)
+		BINARY(I64_XOR, a.i64 ^ b.i64)
+		BINARY(I64_SHL, static_cast<uint64_t>(a.i64) << (static_cast<uint64_t>(b.i64) % 64))
+		BINARY(I64_SHR_S, a.i64 >> (static_cast<uint64_t>(b.i64) % 64))
+		BINARY(I64_SHR_U, static_cast<uint64_t>(a.i64) >> (static_cast<uint64_t>(b.i64) % 64))
+		BINARY(F32_ADD, a.f32 + b.f32)
+		BINARY(F32_SUB, a.f32 - b.f32)
+		BINARY(F32_MUL, a.f32 * b.f32)
+		BINARY(F32_DIV, a.f32 / b.f32)
+		BINARY(F64_ADD, a.f64 + b.f64)
+		BINARY(F64_SUB, a.f64 - b.f64)
+		BINARY(F64_MUL, a.f64 * b.f64)
+		BINARY(F64_DIV, a.f64 / b.f64)
+#undef BINARY
+#undef BINARY_TRAP
+		}
+#undef DISPATCH
+#undef CASE
+#undef NEXT
+#undef JUMP
+#undef BRANCH_ADJUST
+	}
+
+	bool WasmVm::runJit(uint32_t function_index) SOUP_EXCAL
+	{
+		// Generated code keeps pointers into the value stack, so it can't be resized while running.
+		constexpr size_t min_stack_size = 0x10'000; // values
+
+		const WasmScript::CompiledFunction& fn = script.compiled[function_index];
+		const size_t stack_size = (fn.max_height < min_stack_size ? min_stack_size : fn.max_height);
+		if (jit_stack_size < stack_size)
+		{
+			jit_stack.release();
+			jit_stack.addr = soup::malloc(stack_size * sizeof(WasmValue));
+			jit_stack_size = stack_size;
+		}
+		WasmValue* const fp = reinterpret_cast<WasmValue*>(jit_stack.addr);
+		for (uint32_t i = 0; i != fn.num_params; ++i)
+		{
+			fp[i] = locals[i];
+		}
+		WasmJit::Context ctx{ &script, this, fp + jit_stack_size, WasmJit::MAX_CALL_DEPTH };
+		SOUP_RETHROW_FALSE(script.jit->getFunction(function_index)(fp, &ctx));
+		for (uint32_t i = 0; i != fn.num_results; ++i)
+		{
+			stack.push(fp[i]);
+		}
+		return true;
+	}
+
+	bool WasmVm::callViaStack(WasmValue*& sp, uint32_t type_index, uint32_t function_index) SOUP_EXCAL
+	{
+		SOUP_IF_UNLIKELY (type_index >= script.types.size())
+		{
+			return false;
+		}
+		const auto& type = script.types[type_index];
+		const size_t stack_size = stack.size();
+		sp -= type.num_parameters;
+		for (uint32_t i = 0; i != type.num_parameters; ++i)
+		{
+			stack.push(sp[i]);
+		}
+		if (function_index < script.function_imports.size())
+		{
+#if WASM_GUARD_PAGES
+			WasmTrapScopeSuspension suspension;
+#endif
+			script.function_imports[function_index].ptr(*this);
+		}
+		else
+		{
+			SOUP_RETHROW_FALSE(doCall(type_index, function_index - static_cast<uint32_t>(script.function_imports.size())));
+		}
+		SOUP_IF_UNLIKELY (stack.size() != stack_size + type.num_results)
+		{
+#if DEBUG_VM
+			std::cout << "call: unexpected number of values on the stack after return\n";
+#endif
+			return false;
+		}
+		for (uint32_t i = type.num_results; i-- != 0; )
+		{
+			sp[i] = stack.top(); stack.pop();
+		}
+		sp += type.num_results;
+		return true;
+	}
+
 	bool WasmVm::doCall(uint32_t type_index, uint32_t function_index) SOUP_EXCAL
 	{
 		SOUP_IF_UNLIKELY (type_index >= script.types.size())
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "base.hpp"
+#include "AllocRaii.hpp"
+#include "AllocRaiiVirtual.hpp"
 #include "fwd.hpp"
 #include "type_traits.hpp"
+#include "UniquePtr.hpp"
+#include "WasmJit.hpp"
 
 #include <stack>
 #include <string>
@@ -47,10 +51,40 @@ NAMESPACE_SOUP
 			std::string module_name;
 			std::string function_name;
 			wasm_ffi_func_t ptr;
+			uint32_t type_index;
+		};
+
+		// Pre-decoded form of a function body, produced at load time so WasmVm doesn't have to decode LEB128 or search for branch targets while running.
+		struct Insn
+		{
+			uint16_t op;
+			uint16_t arity; // number of values carried by a branch
+			uint32_t a; // instruction index, local/global/function index, etc.
+			uint64_t b; // constant bits, memory offset, or stack height after a branch
+		};
+
+		struct BranchTarget
+		{
+			uint32_t pc;
+			uint32_t height;
+			uint32_t arity;
+		};
+
+		struct CompiledFunction
+		{
+			std::vector<Insn> insns{}; // empty if the function could not be compiled
+			std::vector<BranchTarget> br_tables{};
+			uint32_t num_params = 0;
+			uint32_t num_results = 0;
+			uint32_t num_locals = 0; // including parameters
+			uint32_t max_height = 0; // locals + operand stack
 		};
 
 		uint8_t* memory = nullptr;
 		size_t memory_size = 0;
+		size_t memory_max_pages = 0;
+		UniquePtr<AllocRaiiVirtual> memory_region{}; // if set, memory is at the start of this reservation and grows in place
+		bool memory_guarded = false; // if true, the reservation covers every address a 32-bit memory instruction can form, so WasmVm may skip bounds checks and translate the fault
 		size_t last_alloc = -1;
 		std::vector<uint32_t> functions{}; // (function_index - function_imports.size()) -> type_index
 		std::vector<FunctionType> types{};
@@ -58,8 +92,10 @@ NAMESPACE_SOUP
 		std::vector<int32_t> globals{};
 		std::unordered_map<std::string, uint32_t> export_map{};
 		std::vector<std::string> code{};
+		std::vector<CompiledFunction> compiled{}; // parallel to code
 		std::vector<uint32_t> elements{};
 		bool memory64 = false;
+		UniquePtr<WasmJit> jit{};
 
 		~WasmScript() noexcept;
 
@@ -74,7 +110,7 @@ NAMESPACE_SOUP
 		template <typename T>
 		[[nodiscard]] T* getMemory(size_t ptr) noexcept
 		{
-			SOUP_IF_UNLIKELY (ptr + sizeof(T) >= memory_size)
+			SOUP_IF_UNLIKELY (ptr + sizeof(T) > memory_size)
 			{
 				return nullptr;
 			}
@@ -94,9 +130,19 @@ NAMESPACE_SOUP
 		bool setMemory(size_t ptr, const void* src, size_t len) noexcept;
 		bool setMemory(WasmValue ptr, const void* src, size_t len) noexcept;
 
+		// Returns the previous size in pages, or -1 on failure.
+		[[nodiscard]] size_t growMemory(size_t delta_pages) noexcept;
+
 		void linkWasiPreview1() noexcept;
 
 		[[nodiscard]] size_t readUPTR(Reader& r) const noexcept;
+
+		// Compiles the loaded functions to machine code, which WasmVm will then prefer. Returns false if unsupported on this platform.
+		bool enableJit() SOUP_EXCAL;
+
+	protected:
+		void compileFunctions() SOUP_EXCAL;
+		[[nodiscard]] bool compileFunction(CompiledFunction& fn, const std::string& body, uint32_t type_index) SOUP_EXCAL;
 	};
 
 	class WasmVm
@@ -111,6 +157,7 @@ NAMESPACE_SOUP
 		{
 		}
 
+		// If data is a function body of the script that was compiled at load time, the pre-decoded form is executed.
 		bool run(const std::string& data) SOUP_EXCAL;
 		bool run(Reader& r) SOUP_EXCAL;
 
@@ -121,6 +168,24 @@ NAMESPACE_SOUP
 			size_t stack_size;
 		};
 
+		friend class WasmJit;
+
+		struct CallFrame
+		{
+			const WasmScript::CompiledFunction* fn;
+			const WasmScript::Insn* ret;
+			size_t fp;
+		};
+
+		std::vector<WasmValue> value_stack{};
+		std::vector<CallFrame> call_stack{};
+		AllocRaii jit_stack{}; // not initialised, so untouched pages never need to be committed
+		size_t jit_stack_size = 0; // in values
+
+		[[nodiscard]] bool runCompiled(uint32_t function_index) SOUP_EXCAL;
+		[[nodiscard]] bool runJit(uint32_t function_index) SOUP_EXCAL;
+		[[nodiscard]] bool callViaStack(WasmValue*& sp, uint32_t type_index, uint32_t function_index) SOUP_EXCAL;
+
 		bool skipOverBranch(Reader& r, uint32_t depth = 0) SOUP_EXCAL;
 		[[nodiscard]] bool doBranch(Reader& r, uint32_t depth, std::stack<CtrlFlowEntry>& ctrlflow) SOUP_EXCAL;
 		[[nodiscard]] bool doCall(uint32_t type_index, uint32_t function_index) SOUP_EXCAL;
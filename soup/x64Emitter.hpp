@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring> // memcpy
+#include <vector>
+
+#include "x64.hpp"
+
+NAMESPACE_SOUP
+{
+	enum x64Condition : uint8_t
+	{
+		CC_B = 0x2,
+		CC_AE = 0x3,
+		CC_E = 0x4,
+		CC_NE = 0x5,
+		CC_BE = 0x6,
+		CC_A = 0x7,
+		CC_P = 0xA,
+		CC_NP = 0xB,
+		CC_L = 0xC,
+		CC_GE = 0xD,
+		CC_LE = 0xE,
+		CC_G = 0xF,
+	};
+
+	// Appends x86-64 machine code to a byte vector. Only covers what our code generators need.
+	struct x64Emitter
+	{
+		std::vector<uint8_t>& c;
+
+		[[nodiscard]] uint32_t pos() const noexcept
+		{
+			return static_cast<uint32_t>(c.size());
+		}
+
+		void u8(uint8_t b)
+		{
+			c.emplace_back(b);
+		}
+
+		void u32(uint32_t v)
+		{
+			for (uint8_t i = 0; i != 4; ++i)
+			{
+				c.emplace_back(static_cast<uint8_t>(v >> (i * 8)));
+			}
+		}
+
+		void u64(uint64_t v)
+		{
+			u32(static_cast<uint32_t>(v));
+			u32(static_cast<uint32_t>(v >> 32));
+		}
+
+		void opcode(uint32_t op)
+		{
+			if (op > 0xFFFF)
+			{
+				u8(static_cast<uint8_t>(op >> 16));
+			}
+			if (op > 0xFF)
+			{
+				u8(static_cast<uint8_t>(op >> 8));
+			}
+			u8(static_cast<uint8_t>(op));
+		}
+
+		void prefixAndRex(uint8_t prefix, bool w, uint8_t reg, uint8_t rm)
+		{
+			if (prefix != 0)
+			{
+				u8(prefix);
+			}
+			const uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+			if (rex != 0x40)
+			{
+				u8(rex);
+			}
+		}
+
+		// op reg, [base + disp]
+		void mem(uint8_t prefix, bool w, uint32_t op, uint8_t reg, uint8_t base, int32_t disp)
+		{
+			prefixAndRex(prefix, w, reg, base);
+			opcode(op);
+			const uint8_t r = (reg & 7) << 3;
+			const uint8_t b = (base & 7);
+			if (disp == 0 && b != BP)
+			{
+				u8(0x00 | r | b);
+				if (b == SP)
+				{
+					u8(0x24);
+				}
+			}
+			else if (disp >= -128 && disp <= 127)
+			{
+				u8(0x40 | r | b);
+				if (b == SP)
+				{
+					u8(0x24);
+				}
+				u8(static_cast<uint8_t>(disp));
+			}
+			else
+			{
+				u8(0x80 | r | b);
+				if (b == SP)
+				{
+					u8(0x24);
+				}
+				u32(static_cast<uint32_t>(disp));
+			}
+		}
+
+		// op rm, reg (or op reg, rm, depending on the opcode)
+		void rr(uint8_t prefix, bool w, uint32_t op, uint8_t reg, uint8_t rm)
+		{
+			prefixAndRex(prefix, w, reg, rm);
+			opcode(op);
+			u8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+		}
+
+		void movImm(uint8_t reg, uint64_t val)
+		{
+			if (val <= 0xFFFF'FFFF)
+			{
+				prefixAndRex(0, false, 0, reg);
+				u8(0xB8 | (reg & 7)); // mov r32, imm32
+				u32(static_cast<uint32_t>(val));
+			}
+			else
+			{
+				prefixAndRex(0, true, 0, reg);
+				u8(0xB8 | (reg & 7)); // mov r64, imm64
+				u64(val);
+			}
+		}
+
+		// op rm8, reg8 (or op reg, rm8); forces a REX prefix where needed so 4-7 mean spl/bpl/sil/dil rather than ah/ch/dh/bh.
+		void rr8(uint8_t prefix, bool w, uint32_t op, uint8_t reg, uint8_t rm)
+		{
+			if (prefix != 0)
+			{
+				u8(prefix);
+			}
+			const uint8_t rex = 0x40 | (w << 3) | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+			if (rex != 0x40 || (reg >= SP && reg <= DI) || (rm >= SP && rm <= DI))
+			{
+				u8(rex);
+			}
+			opcode(op);
+			u8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+		}
+
+		void setcc(uint8_t cc, uint8_t reg)
+		{
+			rr8(0, false, 0x0F'90 | cc, 0, reg);
+		}
+
+		// Returns the position of the rel32 to patch.
+		[[nodiscard]] uint32_t jcc(uint8_t cc)
+		{
+			u8(0x0F);
+			u8(0x80 | cc);
+			u32(0);
+			return pos() - 4;
+		}
+
+		[[nodiscard]] uint32_t jmp()
+		{
+			u8(0xE9);
+			u32(0);
+			return pos() - 4;
+		}
+
+		[[nodiscard]] uint32_t jcc8(uint8_t cc)
+		{
+			u8(0x70 | cc);
+			u8(0);
+			return pos() - 1;
+		}
+
+		[[nodiscard]] uint32_t jmp8()
+		{
+			u8(0xEB);
+			u8(0);
+			return pos() - 1;
+		}
+
+		void patch(uint32_t at, uint32_t target) noexcept
+		{
+			const auto rel = static_cast<uint32_t>(target - (at + 4));
+			memcpy(&c[at], &rel, 4);
+		}
+
+		void patch8(uint32_t at) noexcept
+		{
+			c[at] = static_cast<uint8_t>(pos() - (at + 1));
+		}
+
+		void callAbs(const void* f)
+		{
+			movImm(RA, reinterpret_cast<uintptr_t>(f));
+			u8(0xFF); u8(0xD0); // call rax
+		}
+	};
+}